@@ -34,6 +34,18 @@
 
 #define TAG CHANNELS_TAG("drdynvc.client")
 
+/* drdynvc message queue ids */
+#define DRDYNVC_MSG_PDU 0  /* wParam is a DVC PDU */
+#define DRDYNVC_MSG_DATA 1 /* wParam is the complete data of channel lParam, NULL if broken */
+
+/* DATA_FIRST and DATA payload of a channel being reassembled */
+typedef struct
+{
+	UINT32 channel_id;
+	UINT32 length;
+	wStream* data;
+} DVCMAN_FRAGMENTS;
+
 static void dvcman_channel_free(DVCMAN_CHANNEL* channel);
 static UINT dvcman_channel_close(DVCMAN_CHANNEL* channel, BOOL perRequest, BOOL fromHashTableFn);
 static void dvcman_free(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pChannelMgr);
@@ -387,9 +399,6 @@ static void dvcman_channel_free(DVCMAN_CHANNEL* channel)
 	if (!channel)
 		return;
 
-	if (channel->dvc_data)
-		Stream_Release(channel->dvc_data);
-
 	DeleteCriticalSection(&(channel->lock));
 	free(channel->channel_name);
 	free(channel);
@@ -797,77 +806,6 @@ out:
 	return error;
 }
 
-/**
- * Function description
- *
- * @return 0 on success, otherwise a Win32 error code
- */
-static UINT dvcman_receive_channel_data_first(DVCMAN_CHANNEL* channel, UINT32 length)
-{
-	WINPR_ASSERT(channel);
-	WINPR_ASSERT(channel->dvcman);
-	if (channel->dvc_data)
-		Stream_Release(channel->dvc_data);
-
-	channel->dvc_data = StreamPool_Take(channel->dvcman->pool, length);
-
-	if (!channel->dvc_data)
-	{
-		drdynvcPlugin* drdynvc = channel->dvcman->drdynvc;
-		WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
-		return CHANNEL_RC_NO_MEMORY;
-	}
-
-	channel->dvc_data_length = length;
-	return CHANNEL_RC_OK;
-}
-
-/**
- * Function description
- *
- * @return 0 on success, otherwise a Win32 error code
- */
-static UINT dvcman_receive_channel_data(DVCMAN_CHANNEL* channel, wStream* data,
-                                        WINPR_ATTR_UNUSED UINT32 ThreadingFlags)
-{
-	UINT status = CHANNEL_RC_OK;
-	size_t dataSize = Stream_GetRemainingLength(data);
-
-	WINPR_ASSERT(channel);
-	WINPR_ASSERT(channel->dvcman);
-	if (channel->dvc_data)
-	{
-		drdynvcPlugin* drdynvc = channel->dvcman->drdynvc;
-
-		/* Fragmented data */
-		if (Stream_GetPosition(channel->dvc_data) + dataSize > channel->dvc_data_length)
-		{
-			WLog_Print(drdynvc->log, WLOG_ERROR, "data exceeding declared length!");
-			Stream_Release(channel->dvc_data);
-			channel->dvc_data = NULL;
-			status = ERROR_INVALID_DATA;
-			goto out;
-		}
-
-		Stream_Copy(data, channel->dvc_data, dataSize);
-
-		if (Stream_GetPosition(channel->dvc_data) >= channel->dvc_data_length)
-		{
-			Stream_SealLength(channel->dvc_data);
-			Stream_SetPosition(channel->dvc_data, 0);
-
-			status = dvcman_call_on_receive(channel, channel->dvc_data);
-			Stream_Release(channel->dvc_data);
-			channel->dvc_data = NULL;
-		}
-	}
-	else
-		status = dvcman_call_on_receive(channel, data);
-
-out:
-	return status;
-}
-
 static UINT8 drdynvc_write_variable_uint(wStream* s, UINT32 val)
 {
 	UINT8 cb = 0;
@@ -892,22 +830,24 @@ static UINT8 drdynvc_write_variable_uint(wStream* s, UINT32 val)
 }
 
 /**
- * Function description
+ * Send \b length bytes of \b s starting at \b offset, one reference of \b s is consumed
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
+static UINT drdynvc_send_slice(drdynvcPlugin* drdynvc, wStream* s, size_t offset, size_t length)
 {
 	UINT status = 0;
 
+	WINPR_ASSERT(offset + length <= Stream_Capacity(s));
+
 	if (!drdynvc)
 		status = CHANNEL_RC_BAD_CHANNEL_HANDLE;
 	else
 	{
 		WINPR_ASSERT(drdynvc->channelEntryPoints.pVirtualChannelWriteEx);
 		status = drdynvc->channelEntryPoints.pVirtualChannelWriteEx(
-		    drdynvc->InitHandle, drdynvc->OpenHandle, Stream_Buffer(s),
-		    (UINT32)Stream_GetPosition(s), s);
+		    drdynvc->InitHandle, drdynvc->OpenHandle, Stream_Buffer(s) + offset,
+		    WINPR_ASSERTING_INT_CAST(UINT32, length), s);
 	}
 
 	switch (status)
@@ -933,6 +873,16 @@ static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
 	}
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
+{
+	return drdynvc_send_slice(drdynvc, s, 0, Stream_GetPosition(s));
+}
+
 /**
  * Function description
  *
@@ -942,10 +892,7 @@ static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const B
                                UINT32 dataSize, BOOL* close)
 {
 	wStream* data_out = NULL;
-	size_t pos = 0;
-	UINT8 cbChId = 0;
-	UINT8 cbLen = 0;
-	UINT status = CHANNEL_RC_BAD_INIT_HANDLE;
+	UINT status = CHANNEL_RC_OK;
 	DVCMAN* dvcman = NULL;
 
 	if (!drdynvc)
@@ -956,83 +903,57 @@ static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const B
 
 	WLog_Print(drdynvc->log, WLOG_TRACE, "write_data: ChannelId=%" PRIu32 " size=%" PRIu32 "",
 	           ChannelId, dataSize);
-	data_out = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
-
-	if (!data_out)
-	{
-		WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
-		return CHANNEL_RC_NO_MEMORY;
-	}
-
-	Stream_SetPosition(data_out, 1);
-	cbChId = drdynvc_write_variable_uint(data_out, ChannelId);
-	pos = Stream_GetPosition(data_out);
 
 	if (dataSize == 0)
 	{
 		/* TODO: shall treat that case with write(0) that do a close */
 		*close = TRUE;
-		Stream_Release(data_out);
+		return CHANNEL_RC_BAD_INIT_HANDLE;
 	}
-	else if (dataSize <= CHANNEL_CHUNK_LENGTH - pos)
+
+	/* All PDUs are framed in a single buffer and sent as slices of it, every slice holds a
+	 * reference that is released on write completion. Headers take at most 9 bytes. */
+	const size_t chunks = dataSize / (CHANNEL_CHUNK_LENGTH - 9) + 1;
+	data_out = StreamPool_Take(dvcman->pool, dataSize + 9ull * chunks);
+
+	if (!data_out)
 	{
-		Stream_SetPosition(data_out, 0);
-		Stream_Write_UINT8(data_out, (DATA_PDU << 4) | cbChId);
-		Stream_SetPosition(data_out, pos);
-		Stream_Write(data_out, data, dataSize);
-		status = drdynvc_send(drdynvc, data_out);
+		WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
+		return CHANNEL_RC_NO_MEMORY;
 	}
-	else
-	{
-		/* Fragment the data */
-		cbLen = drdynvc_write_variable_uint(data_out, dataSize);
-		pos = Stream_GetPosition(data_out);
-		Stream_SetPosition(data_out, 0);
 
-		const INT32 pdu = (DATA_FIRST_PDU << 4) | cbChId | (cbLen << 2);
-		Stream_Write_UINT8(data_out, WINPR_ASSERTING_INT_CAST(UINT8, pdu));
-		Stream_SetPosition(data_out, pos);
+	BOOL first = TRUE;
+	while ((status == CHANNEL_RC_OK) && (dataSize > 0))
+	{
+		const size_t start = Stream_GetPosition(data_out);
+		UINT8 cbLen = 0;
+		UINT8 cmd = DATA_PDU;
 
+		Stream_Seek(data_out, 1);
+		const UINT8 cbChId = drdynvc_write_variable_uint(data_out, ChannelId);
+		if (first && (dataSize > CHANNEL_CHUNK_LENGTH - (Stream_GetPosition(data_out) - start)))
 		{
-			WINPR_ASSERT(pos <= CHANNEL_CHUNK_LENGTH);
-			const uint32_t chunkLength =
-			    CHANNEL_CHUNK_LENGTH - WINPR_ASSERTING_INT_CAST(uint32_t, pos);
-			Stream_Write(data_out, data, chunkLength);
-
-			data += chunkLength;
-			dataSize -= chunkLength;
+			/* Fragment the data */
+			cmd = DATA_FIRST_PDU;
+			cbLen = drdynvc_write_variable_uint(data_out, dataSize);
 		}
-		status = drdynvc_send(drdynvc, data_out);
-
-		while (status == CHANNEL_RC_OK && dataSize > 0)
-		{
-			data_out = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
-
-			if (!data_out)
-			{
-				WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
-				return CHANNEL_RC_NO_MEMORY;
-			}
-
-			Stream_SetPosition(data_out, 1);
-			cbChId = drdynvc_write_variable_uint(data_out, ChannelId);
-			pos = Stream_GetPosition(data_out);
-			Stream_SetPosition(data_out, 0);
-			Stream_Write_UINT8(data_out, (DATA_PDU << 4) | cbChId);
-			Stream_SetPosition(data_out, pos);
+		first = FALSE;
 
-			uint32_t chunkLength = dataSize;
+		const size_t pos = Stream_GetPosition(data_out);
+		Stream_SetPosition(data_out, start);
+		Stream_Write_UINT8(data_out, (UINT8)((cmd << 4) | (cbLen << 2) | cbChId));
+		Stream_SetPosition(data_out, pos);
 
-			WINPR_ASSERT(pos <= CHANNEL_CHUNK_LENGTH);
-			if (chunkLength > CHANNEL_CHUNK_LENGTH - pos)
-				chunkLength = CHANNEL_CHUNK_LENGTH - WINPR_ASSERTING_INT_CAST(uint32_t, pos);
+		WINPR_ASSERT(pos - start <= CHANNEL_CHUNK_LENGTH);
+		const UINT32 chunkLength = (UINT32)MIN(dataSize, CHANNEL_CHUNK_LENGTH - (pos - start));
+		Stream_Write(data_out, data, chunkLength);
+		data += chunkLength;
+		dataSize -= chunkLength;
 
-			Stream_Write(data_out, data, chunkLength);
-			data += chunkLength;
-			dataSize -= chunkLength;
-			status = drdynvc_send(drdynvc, data_out);
-		}
+		Stream_AddRef(data_out);
+		status = drdynvc_send_slice(drdynvc, data_out, start, Stream_GetPosition(data_out) - start);
 	}
+	Stream_Release(data_out);
 
 	if (status != CHANNEL_RC_OK)
 	{
@@ -1269,78 +1190,32 @@ static UINT drdynvc_process_create_request(drdynvcPlugin* drdynvc, UINT8 Sp, UIN
 	return status;
 }
 
-/**
- * Function description
- *
- * @return 0 on success, otherwise a Win32 error code
- */
-static UINT drdynvc_process_data_first(drdynvcPlugin* drdynvc, int Sp, int cbChId, wStream* s,
-                                       UINT32 ThreadingFlags)
+/* statistics are updated by the receive thread and the worker thread */
+static void drdynvc_count(LONGLONG volatile* counter, size_t value)
 {
-	UINT status = CHANNEL_RC_OK;
-	UINT32 Length = 0;
-	UINT32 ChannelId = 0;
-	DVCMAN_CHANNEL* channel = NULL;
+	LONGLONG current = *counter;
 
-	WINPR_ASSERT(drdynvc);
-	if (!Stream_CheckAndLogRequiredLength(
-	        TAG, s, drdynvc_cblen_to_bytes(cbChId) + drdynvc_cblen_to_bytes(Sp)))
-		return ERROR_INVALID_DATA;
-
-	ChannelId = drdynvc_read_variable_uint(s, cbChId);
-	Length = drdynvc_read_variable_uint(s, Sp);
-	WLog_Print(drdynvc->log, WLOG_TRACE,
-	           "process_data_first: Sp=%d cbChId=%d, ChannelId=%" PRIu32 " Length=%" PRIu32 "", Sp,
-	           cbChId, ChannelId, Length);
-
-	channel = dvcman_get_channel_by_id(drdynvc->channel_mgr, ChannelId, TRUE);
-	if (!channel)
+	for (;;)
 	{
-		/**
-		 * Windows Server 2012 R2 can send some messages over
-		 * Microsoft::Windows::RDS::Geometry::v08.01 even if the dynamic virtual channel wasn't
-		 * registered on our side. Ignoring it works.
-		 */
-		WLog_Print(drdynvc->log, WLOG_ERROR, "ChannelId %" PRIu32 " not found!", ChannelId);
-		return CHANNEL_RC_OK;
+		const LONGLONG previous =
+		    InterlockedCompareExchange64(counter, current + (LONGLONG)value, current);
+		if (previous == current)
+			break;
+		current = previous;
 	}
-
-	if (channel->state != DVC_CHANNEL_RUNNING)
-		goto out;
-
-	status = dvcman_receive_channel_data_first(channel, Length);
-
-	if (status == CHANNEL_RC_OK)
-		status = dvcman_receive_channel_data(channel, s, ThreadingFlags);
-
-	if (status != CHANNEL_RC_OK)
-		status = dvcman_channel_close(channel, FALSE, FALSE);
-
-out:
-	dvcman_channel_unref(channel);
-	return status;
 }
 
 /**
- * Function description
+ * Deliver the complete data of a channel, \b s is \b NULL if the fragments were broken
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT drdynvc_process_data(drdynvcPlugin* drdynvc, int Sp, int cbChId, wStream* s,
-                                 UINT32 ThreadingFlags)
+static UINT drdynvc_process_channel_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, wStream* s)
 {
-	UINT32 ChannelId = 0;
 	DVCMAN_CHANNEL* channel = NULL;
-	UINT status = CHANNEL_RC_OK;
+	UINT status = ERROR_INVALID_DATA;
 
 	WINPR_ASSERT(drdynvc);
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, drdynvc_cblen_to_bytes(cbChId)))
-		return ERROR_INVALID_DATA;
-
-	ChannelId = drdynvc_read_variable_uint(s, cbChId);
-	WLog_Print(drdynvc->log, WLOG_TRACE, "process_data: Sp=%d cbChId=%d, ChannelId=%" PRIu32 "", Sp,
-	           cbChId, ChannelId);
-
 	channel = dvcman_get_channel_by_id(drdynvc->channel_mgr, ChannelId, TRUE);
 	if (!channel)
 	{
@@ -1354,9 +1229,16 @@ static UINT drdynvc_process_data(drdynvcPlugin* drdynvc, int Sp, int cbChId, wSt
 	}
 
 	if (channel->state != DVC_CHANNEL_RUNNING)
+	{
+		status = CHANNEL_RC_OK;
 		goto out;
+	}
 
-	status = dvcman_receive_channel_data(channel, s, ThreadingFlags);
+	if (s)
+	{
+		drdynvc_count(&drdynvc->bytesDelivered, Stream_GetRemainingLength(s));
+		status = dvcman_call_on_receive(channel, s);
+	}
 	if (status != CHANNEL_RC_OK)
 		status = dvcman_channel_close(channel, FALSE, FALSE);
 
@@ -1398,11 +1280,12 @@ static UINT drdynvc_process_close_request(drdynvcPlugin* drdynvc, int Sp, int cb
 }
 
 /**
- * Function description
+ * Process a DVC PDU, data PDUs are reassembled on receipt by drdynvc_receive_pdu
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT drdynvc_order_recv(drdynvcPlugin* drdynvc, wStream* s, UINT32 ThreadingFlags)
+static UINT drdynvc_order_recv(drdynvcPlugin* drdynvc, wStream* s,
+                               WINPR_ATTR_UNUSED UINT32 ThreadingFlags)
 {
 	UINT8 value = 0;
 
@@ -1425,19 +1308,245 @@ static UINT drdynvc_order_recv(drdynvcPlugin* drdynvc, wStream* s, UINT32 Thread
 		case CREATE_REQUEST_PDU:
 			return drdynvc_process_create_request(drdynvc, Sp, cbChId, s);
 
-		case DATA_FIRST_PDU:
-			return drdynvc_process_data_first(drdynvc, Sp, cbChId, s, ThreadingFlags);
+		case CLOSE_REQUEST_PDU:
+			return drdynvc_process_close_request(drdynvc, Sp, cbChId, s);
+
+		default:
+			WLog_Print(drdynvc->log, WLOG_ERROR, "unknown drdynvc cmd 0x%x", Cmd);
+			return ERROR_INTERNAL_ERROR;
+	}
+}
+
+static wStream* drdynvc_copy_stream(drdynvcPlugin* drdynvc, wStream* s)
+{
+	DVCMAN* mgr = (DVCMAN*)drdynvc->channel_mgr;
+	const size_t length = Stream_GetRemainingLength(s);
+	wStream* copy = StreamPool_Take(mgr->pool, length);
+
+	if (!copy)
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
+		return NULL;
+	}
 
+	Stream_Write(copy, Stream_ConstPointer(s), length);
+	drdynvc_count(&drdynvc->bytesCopied, length);
+	Stream_SealLength(copy);
+	Stream_SetPosition(copy, 0);
+	return copy;
+}
+
+/**
+ * Hand the data of a channel to the plugin, \b s is consumed if \b owned and only valid
+ * during the call otherwise.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_deliver_channel_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, wStream* s,
+                                         BOOL owned)
+{
+	UINT status = CHANNEL_RC_OK;
+
+	if (!drdynvc->async)
+	{
+		status = drdynvc_process_channel_data(drdynvc, ChannelId, s);
+		if (owned && s)
+			Stream_Release(s);
+		return status;
+	}
+
+	if (s && !owned)
+	{
+		s = drdynvc_copy_stream(drdynvc, s);
+		if (!s)
+			return CHANNEL_RC_NO_MEMORY;
+	}
+
+	if (!MessageQueue_Post(drdynvc->queue, NULL, DRDYNVC_MSG_DATA, s, (void*)(UINT_PTR)ChannelId))
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "MessageQueue_Post failed!");
+		if (s)
+			Stream_Release(s);
+		return ERROR_INTERNAL_ERROR;
+	}
+
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Reassemble DATA_FIRST and DATA PDUs. The payload of a fragment is copied once into the
+ * buffer of the complete message, unfragmented data is passed on as is.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_receive_data(drdynvcPlugin* drdynvc, UINT8 Cmd, UINT8 Sp, UINT8 cbChId,
+                                 wStream* s, BOOL owned)
+{
+	UINT status = ERROR_INVALID_DATA;
+	UINT32 Length = 0;
+	DVCMAN* mgr = (DVCMAN*)drdynvc->channel_mgr;
+
+	size_t required = drdynvc_cblen_to_bytes(cbChId);
+	if (Cmd == DATA_FIRST_PDU)
+		required += drdynvc_cblen_to_bytes(Sp);
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, required))
+		goto fail;
+
+	const UINT32 ChannelId = drdynvc_read_variable_uint(s, cbChId);
+	if (Cmd == DATA_FIRST_PDU)
+		Length = drdynvc_read_variable_uint(s, Sp);
+	const size_t size = Stream_GetRemainingLength(s);
+	WLog_Print(drdynvc->log, WLOG_TRACE,
+	           "receive_data: Cmd=%s Sp=%" PRIu8 " cbChId=%" PRIu8 ", ChannelId=%" PRIu32
+	           " Length=%" PRIu32 " size=%" PRIuz,
+	           drdynvc_get_packet_type(Cmd), Sp, cbChId, ChannelId, Length, size);
+
+	DVCMAN_FRAGMENTS* fragments = HashTable_GetItemValue(drdynvc->fragments, &ChannelId);
+	if (Cmd == DATA_FIRST_PDU)
+	{
+		/* a new message replaces an unfinished one */
+		if (fragments)
+			HashTable_Remove(drdynvc->fragments, &ChannelId);
+		fragments = NULL;
+
+		if (size > Length)
+		{
+			WLog_Print(drdynvc->log, WLOG_ERROR, "data exceeding declared length!");
+			status = drdynvc_deliver_channel_data(drdynvc, ChannelId, NULL, FALSE);
+			goto fail;
+		}
+
+		if (size < Length)
+		{
+			fragments = calloc(1, sizeof(DVCMAN_FRAGMENTS));
+			if (!fragments)
+				goto fail_nomem;
+
+			fragments->channel_id = ChannelId;
+			fragments->length = Length;
+			fragments->data = StreamPool_Take(mgr->pool, Length);
+			if (!fragments->data || !HashTable_Insert(drdynvc->fragments,
+			                                          &fragments->channel_id, fragments))
+			{
+				if (fragments->data)
+					Stream_Release(fragments->data);
+				free(fragments);
+				goto fail_nomem;
+			}
+		}
+	}
+
+	if (!fragments)
+		return drdynvc_deliver_channel_data(drdynvc, ChannelId, s, owned);
+
+	if (Stream_GetPosition(fragments->data) + size > fragments->length)
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "data exceeding declared length!");
+		HashTable_Remove(drdynvc->fragments, &ChannelId);
+		status = drdynvc_deliver_channel_data(drdynvc, ChannelId, NULL, FALSE);
+		goto fail;
+	}
+
+	Stream_Write(fragments->data, Stream_ConstPointer(s), size);
+	drdynvc_count(&drdynvc->bytesCopied, size);
+	if (owned)
+		Stream_Release(s);
+
+	if (Stream_GetPosition(fragments->data) < fragments->length)
+		return CHANNEL_RC_OK;
+
+	wStream* data = fragments->data;
+	fragments->data = NULL;
+	HashTable_Remove(drdynvc->fragments, &ChannelId);
+
+	Stream_SealLength(data);
+	Stream_SetPosition(data, 0);
+	return drdynvc_deliver_channel_data(drdynvc, ChannelId, data, TRUE);
+
+fail_nomem:
+	WLog_Print(drdynvc->log, WLOG_ERROR, "StreamPool_Take failed!");
+	status = CHANNEL_RC_NO_MEMORY;
+fail:
+	if (owned)
+		Stream_Release(s);
+	return status;
+}
+
+/**
+ * Process a complete DVC PDU. \b s is consumed if \b owned, otherwise it is only valid during
+ * the call and copied if it needs to be queued.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_receive_pdu(drdynvcPlugin* drdynvc, wStream* s, BOOL owned)
+{
+	UINT error = CHANNEL_RC_OK;
+
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
+	{
+		if (owned)
+			Stream_Release(s);
+		return ERROR_INVALID_DATA;
+	}
+
+	BYTE value = 0;
+	Stream_Peek_UINT8(s, value);
+	const UINT8 Cmd = (value & 0xf0) >> 4;
+	const UINT8 Sp = (value & 0x0c) >> 2;
+	const UINT8 cbChId = (value & 0x03) >> 0;
+
+	switch (Cmd)
+	{
+		case DATA_FIRST_PDU:
 		case DATA_PDU:
-			return drdynvc_process_data(drdynvc, Sp, cbChId, s, ThreadingFlags);
+			Stream_Seek(s, 1);
+			return drdynvc_receive_data(drdynvc, Cmd, Sp, cbChId, s, owned);
 
 		case CLOSE_REQUEST_PDU:
-			return drdynvc_process_close_request(drdynvc, Sp, cbChId, s);
+			if (Stream_GetRemainingLength(s) > drdynvc_cblen_to_bytes(cbChId))
+			{
+				const size_t pos = Stream_GetPosition(s);
+				Stream_Seek(s, 1);
+				const UINT32 ChannelId = drdynvc_read_variable_uint(s, cbChId);
+				Stream_SetPosition(s, pos);
+				HashTable_Remove(drdynvc->fragments, &ChannelId);
+			}
+			break;
 
 		default:
-			WLog_Print(drdynvc->log, WLOG_ERROR, "unknown drdynvc cmd 0x%x", Cmd);
+			break;
+	}
+
+	if (drdynvc->async)
+	{
+		if (!owned)
+		{
+			s = drdynvc_copy_stream(drdynvc, s);
+			if (!s)
+				return CHANNEL_RC_NO_MEMORY;
+		}
+
+		if (!MessageQueue_Post(drdynvc->queue, NULL, DRDYNVC_MSG_PDU, (void*)s, NULL))
+		{
+			WLog_Print(drdynvc->log, WLOG_ERROR, "MessageQueue_Post failed!");
+			Stream_Release(s);
 			return ERROR_INTERNAL_ERROR;
+		}
 	}
+	else
+	{
+		error = drdynvc_order_recv(drdynvc, s, TRUE);
+		if (owned)
+			Stream_Release(s);
+
+		if (error)
+		{
+			WLog_Print(drdynvc->log, WLOG_WARN, "drdynvc_order_recv failed with error %" PRIu32 "!",
+			           error);
+		}
+	}
+
+	return CHANNEL_RC_OK;
 }
 
 /**
@@ -1457,6 +1566,18 @@ static UINT drdynvc_virtual_channel_event_data_received(drdynvcPlugin* drdynvc,
 		return CHANNEL_RC_OK;
 	}
 
+	/* a PDU in a single chunk is processed in place */
+	if ((dataFlags & CHANNEL_FLAG_FIRST) && (dataFlags & CHANNEL_FLAG_LAST))
+	{
+		wStream sbuffer = { 0 };
+		wStream* s = Stream_StaticConstInit(&sbuffer, pData, dataLength);
+
+		if (drdynvc->data_in)
+			Stream_Release(drdynvc->data_in);
+		drdynvc->data_in = NULL;
+		return drdynvc_receive_pdu(drdynvc, s, FALSE);
+	}
+
 	if (dataFlags & CHANNEL_FLAG_FIRST)
 	{
 		DVCMAN* mgr = (DVCMAN*)drdynvc->channel_mgr;
@@ -1481,6 +1602,7 @@ static UINT drdynvc_virtual_channel_event_data_received(drdynvcPlugin* drdynvc,
 	}
 
 	Stream_Write(data_in, pData, dataLength);
+	drdynvc_count(&drdynvc->bytesCopied, dataLength);
 
 	if (dataFlags & CHANNEL_FLAG_LAST)
 	{
@@ -1495,26 +1617,7 @@ static UINT drdynvc_virtual_channel_event_data_received(drdynvcPlugin* drdynvc,
 		drdynvc->data_in = NULL;
 		Stream_SealLength(data_in);
 		Stream_SetPosition(data_in, 0);
-
-		if (drdynvc->async)
-		{
-			if (!MessageQueue_Post(drdynvc->queue, NULL, 0, (void*)data_in, NULL))
-			{
-				WLog_Print(drdynvc->log, WLOG_ERROR, "MessageQueue_Post failed!");
-				return ERROR_INTERNAL_ERROR;
-			}
-		}
-		else
-		{
-			UINT error = drdynvc_order_recv(drdynvc, data_in, TRUE);
-			Stream_Release(data_in);
-
-			if (error)
-			{
-				WLog_Print(drdynvc->log, WLOG_WARN,
-				           "drdynvc_order_recv failed with error %" PRIu32 "!", error);
-			}
-		}
+		return drdynvc_receive_pdu(drdynvc, data_in, TRUE);
 	}
 
 	return CHANNEL_RC_OK;
@@ -1598,7 +1701,7 @@ static DWORD WINAPI drdynvc_virtual_channel_client_thread(LPVOID arg)
 		if (message.id == WMQ_QUIT)
 			break;
 
-		if (message.id == 0)
+		if (message.id == DRDYNVC_MSG_PDU)
 		{
 			UINT32 ThreadingFlags = TRUE;
 			data = (wStream*)message.wParam;
@@ -1611,6 +1714,20 @@ static DWORD WINAPI drdynvc_virtual_channel_client_thread(LPVOID arg)
 
 			Stream_Release(data);
 		}
+		else if (message.id == DRDYNVC_MSG_DATA)
+		{
+			const UINT32 ChannelId = (UINT32)(UINT_PTR)message.lParam;
+			data = (wStream*)message.wParam;
+
+			if ((error = drdynvc_process_channel_data(drdynvc, ChannelId, data)))
+			{
+				WLog_Print(drdynvc->log, WLOG_WARN,
+				           "drdynvc_process_channel_data failed with error %" PRIu32 "!", error);
+			}
+
+			if (data)
+				Stream_Release(data);
+		}
 	}
 
 	{
@@ -1635,7 +1752,7 @@ static void drdynvc_queue_object_free(void* obj)
 	wStream* s = NULL;
 	wMessage* msg = (wMessage*)obj;
 
-	if (!msg || (msg->id != 0))
+	if (!msg || ((msg->id != DRDYNVC_MSG_PDU) && (msg->id != DRDYNVC_MSG_DATA)))
 		return;
 
 	s = (wStream*)msg->wParam;
@@ -1644,6 +1761,18 @@ static void drdynvc_queue_object_free(void* obj)
 		Stream_Release(s);
 }
 
+static void drdynvc_fragments_free(void* obj)
+{
+	DVCMAN_FRAGMENTS* fragments = obj;
+
+	if (!fragments)
+		return;
+
+	if (fragments->data)
+		Stream_Release(fragments->data);
+	free(fragments);
+}
+
 static UINT drdynvc_virtual_channel_event_initialized(drdynvcPlugin* drdynvc, LPVOID pData,
                                                       UINT32 dataLength)
 {
@@ -1664,6 +1793,20 @@ static UINT drdynvc_virtual_channel_event_initialized(drdynvcPlugin* drdynvc, LP
 
 	obj = MessageQueue_Object(drdynvc->queue);
 	obj->fnObjectFree = drdynvc_queue_object_free;
+
+	drdynvc->fragments = HashTable_New(FALSE);
+	if (!drdynvc->fragments)
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "HashTable_New failed!");
+		goto error;
+	}
+
+	HashTable_SetHashFunction(drdynvc->fragments, channelIdHash);
+	obj = HashTable_KeyObject(drdynvc->fragments);
+	obj->fnObjectEquals = channelIdMatch;
+	obj = HashTable_ValueObject(drdynvc->fragments);
+	obj->fnObjectFree = drdynvc_fragments_free;
+
 	drdynvc->channel_mgr = dvcman_new(drdynvc);
 
 	if (!drdynvc->channel_mgr)
@@ -1821,6 +1964,11 @@ static UINT drdynvc_virtual_channel_event_disconnected(drdynvcPlugin* drdynvc)
 		drdynvc->data_in = NULL;
 	}
 
+	HashTable_Clear(drdynvc->fragments);
+	WLog_Print(drdynvc->log, WLOG_DEBUG,
+	           "%" PRId64 " bytes of channel data delivered, %" PRId64 " bytes copied",
+	           InterlockedCompareExchange64(&drdynvc->bytesDelivered, 0, 0),
+	           InterlockedCompareExchange64(&drdynvc->bytesCopied, 0, 0));
 	return status;
 }
 
@@ -1837,6 +1985,10 @@ static UINT drdynvc_virtual_channel_event_terminated(drdynvcPlugin* drdynvc)
 	MessageQueue_Free(drdynvc->queue);
 	drdynvc->queue = NULL;
 
+	/* pending fragments hold streams of the channel manager pool */
+	HashTable_Free(drdynvc->fragments);
+	drdynvc->fragments = NULL;
+
 	if (drdynvc->channel_mgr)
 	{
 		dvcman_free(drdynvc, drdynvc->channel_mgr);
@@ -89,8 +89,6 @@ typedef struct
 	char* channel_name;
 	IWTSVirtualChannelCallback* channel_callback;
 
-	wStream* dvc_data;
-	UINT32 dvc_data_length;
 	CRITICAL_SECTION lock;
 } DVCMAN_CHANNEL;
 
@@ -113,6 +111,9 @@ struct drdynvc_plugin
 	HANDLE thread;
 	BOOL async;
 	wStream* data_in;
+	wHashTable* fragments; /* DATA_FIRST reassembly by channel id, owned by the receive thread */
+	LONGLONG volatile bytesDelivered;
+	LONGLONG volatile bytesCopied;
 	void* InitHandle;
 	DWORD OpenHandle;
 	wMessageQueue* queue;
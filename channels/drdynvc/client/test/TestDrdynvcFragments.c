@@ -0,0 +1,385 @@
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/synch.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/addin.h>
+#include <freerdp/client/channels.h>
+#include <freerdp/channels/drdynvc.h>
+
+#include "drdynvc_main.h"
+
+#define TEST_CHANNEL "testdvc"
+#define TEST_CHANNEL_ID 7
+#define TEST_MESSAGE 5000
+#define TEST_SMALL_MESSAGE 100
+
+BOOL VCAPITYPE drdynvc_VirtualChannelEntryEx(PCHANNEL_ENTRY_POINTS_EX pEntryPoints,
+                                             PVOID pInitHandle);
+
+typedef struct
+{
+	CRITICAL_SECTION lock;
+	drdynvcPlugin* drdynvc;
+	PCHANNEL_INIT_EVENT_EX_FN initEvent;
+	PCHANNEL_OPEN_EVENT_EX_FN openEvent;
+
+	/* channel data the client sent on the test channel */
+	wStream* sent;
+	size_t slices;
+	UINT32 firstLength;
+	BOOL oversized;
+
+	/* channel data the test plugin received */
+	IWTSVirtualChannel* channel;
+	wStream* received;
+	size_t messages;
+	HANDLE receivedEvent;
+} TestServer;
+
+static TestServer* server = NULL;
+
+static UINT VCAPITYPE test_init(LPVOID lpUserParam, LPVOID clientContext, LPVOID pInitHandle,
+                               PCHANNEL_DEF pChannel, INT channelCount, ULONG versionRequested,
+                               PCHANNEL_INIT_EVENT_EX_FN pChannelInitEventProcEx)
+{
+	WINPR_UNUSED(clientContext);
+	WINPR_UNUSED(pInitHandle);
+	WINPR_UNUSED(pChannel);
+	WINPR_UNUSED(channelCount);
+	WINPR_UNUSED(versionRequested);
+
+	server->drdynvc = lpUserParam;
+	server->initEvent = pChannelInitEventProcEx;
+	return CHANNEL_RC_OK;
+}
+
+static UINT VCAPITYPE test_open(LPVOID pInitHandle, LPDWORD pOpenHandle, PCHAR pChannelName,
+                               PCHANNEL_OPEN_EVENT_EX_FN pChannelOpenEventProcEx)
+{
+	WINPR_UNUSED(pInitHandle);
+	WINPR_UNUSED(pChannelName);
+
+	*pOpenHandle = 1;
+	server->openEvent = pChannelOpenEventProcEx;
+	return CHANNEL_RC_OK;
+}
+
+static UINT VCAPITYPE test_close(LPVOID pInitHandle, DWORD openHandle)
+{
+	WINPR_UNUSED(pInitHandle);
+	WINPR_UNUSED(openHandle);
+	return CHANNEL_RC_OK;
+}
+
+static UINT32 read_variable_uint(wStream* s, UINT8 cb)
+{
+	switch (cb)
+	{
+		case 0:
+			return Stream_Get_UINT8(s);
+		case 1:
+			return Stream_Get_UINT16(s);
+		default:
+			return Stream_Get_UINT32(s);
+	}
+}
+
+/* record the data PDUs of the test channel, every slice is completed right away */
+static UINT VCAPITYPE test_write(LPVOID pInitHandle, DWORD openHandle, LPVOID pData,
+                                ULONG dataLength, LPVOID pUserData)
+{
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, pData, dataLength);
+
+	WINPR_UNUSED(pInitHandle);
+
+	EnterCriticalSection(&server->lock);
+	if (dataLength > CHANNEL_CHUNK_LENGTH)
+		server->oversized = TRUE;
+
+	const UINT8 value = Stream_Get_UINT8(s);
+	const UINT8 cmd = (value & 0xF0) >> 4;
+	const UINT8 Sp = (value & 0x0C) >> 2;
+	const UINT8 cbChId = value & 0x03;
+
+	if ((cmd == DATA_FIRST_PDU) || (cmd == DATA_PDU))
+	{
+		const UINT32 ChannelId = read_variable_uint(s, cbChId);
+		if (cmd == DATA_FIRST_PDU)
+		{
+			if (server->slices != 0)
+				server->oversized = TRUE;
+			server->firstLength = read_variable_uint(s, Sp);
+		}
+
+		if ((ChannelId == TEST_CHANNEL_ID) &&
+		    Stream_EnsureRemainingCapacity(server->sent, Stream_GetRemainingLength(s)))
+		{
+			Stream_Write(server->sent, Stream_ConstPointer(s), Stream_GetRemainingLength(s));
+			server->slices++;
+		}
+	}
+	LeaveCriticalSection(&server->lock);
+
+	server->openEvent(server->drdynvc, openHandle, CHANNEL_EVENT_WRITE_COMPLETE, pUserData,
+	                  sizeof(wStream*), sizeof(wStream*), 0);
+	return CHANNEL_RC_OK;
+}
+
+static UINT test_on_data_received(IWTSVirtualChannelCallback* pChannelCallback, wStream* data)
+{
+	WINPR_UNUSED(pChannelCallback);
+
+	EnterCriticalSection(&server->lock);
+	const BOOL rc =
+	    Stream_EnsureRemainingCapacity(server->received, Stream_GetRemainingLength(data));
+	if (rc)
+	{
+		Stream_Write(server->received, Stream_ConstPointer(data),
+		             Stream_GetRemainingLength(data));
+		server->messages++;
+		(void)SetEvent(server->receivedEvent);
+	}
+	LeaveCriticalSection(&server->lock);
+
+	return rc ? CHANNEL_RC_OK : CHANNEL_RC_NO_MEMORY;
+}
+
+static IWTSVirtualChannelCallback channelCallback = { test_on_data_received, NULL, NULL, NULL };
+
+static UINT test_on_new_channel_connection(IWTSListenerCallback* pListenerCallback,
+                                           IWTSVirtualChannel* pChannel, BYTE* Data,
+                                           BOOL* pbAccept,
+                                           IWTSVirtualChannelCallback** ppCallback)
+{
+	WINPR_UNUSED(pListenerCallback);
+	WINPR_UNUSED(Data);
+
+	server->channel = pChannel;
+	*pbAccept = TRUE;
+	*ppCallback = &channelCallback;
+	return CHANNEL_RC_OK;
+}
+
+static IWTSListenerCallback listenerCallback = { test_on_new_channel_connection };
+
+static UINT test_plugin_initialize(IWTSPlugin* pPlugin, IWTSVirtualChannelManager* pChannelMgr)
+{
+	WINPR_UNUSED(pPlugin);
+	return pChannelMgr->CreateListener(pChannelMgr, TEST_CHANNEL, 0, &listenerCallback, NULL);
+}
+
+static IWTSPlugin plugin = { test_plugin_initialize };
+
+static UINT VCAPITYPE test_dvc_entry(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
+{
+	return pEntryPoints->RegisterPlugin(pEntryPoints, TEST_CHANNEL, &plugin);
+}
+
+static PVIRTUALCHANNELENTRY test_addin_provider(LPCSTR pszName, LPCSTR pszSubsystem,
+                                               LPCSTR pszType, DWORD dwFlags)
+{
+	WINPR_UNUSED(pszSubsystem);
+	WINPR_UNUSED(pszType);
+
+	if ((strcmp(pszName, TEST_CHANNEL) == 0) && (dwFlags & FREERDP_ADDIN_CHANNEL_DYNAMIC))
+	{
+		PDVC_PLUGIN_ENTRY entry = test_dvc_entry;
+		return WINPR_FUNC_PTR_CAST(entry, PVIRTUALCHANNELENTRY);
+	}
+	return NULL;
+}
+
+/* pass a PDU to the client in static channel chunks of at most chunkLength bytes */
+static void feed(const BYTE* pdu, size_t length, size_t chunkLength)
+{
+	for (size_t offset = 0; offset < length; offset += chunkLength)
+	{
+		const size_t size = MIN(chunkLength, length - offset);
+		UINT32 flags = 0;
+
+		if (offset == 0)
+			flags |= CHANNEL_FLAG_FIRST;
+		if (offset + size == length)
+			flags |= CHANNEL_FLAG_LAST;
+
+		server->openEvent(server->drdynvc, 1, CHANNEL_EVENT_DATA_RECEIVED, (LPVOID)&pdu[offset],
+		                  (UINT32)size, (UINT32)length, flags);
+	}
+}
+
+static size_t data_pdu(BYTE* pdu, UINT8 cmd, const BYTE* data, size_t length, UINT32 total)
+{
+	size_t header = 2;
+
+	pdu[0] = (BYTE)(cmd << 4);
+	pdu[1] = TEST_CHANNEL_ID;
+	if (cmd == DATA_FIRST_PDU)
+	{
+		/* one byte channel id, two byte length */
+		pdu[0] |= 0x04;
+		pdu[2] = (BYTE)(total & 0xFF);
+		pdu[3] = (BYTE)(total >> 8);
+		header = 4;
+	}
+	memcpy(&pdu[header], data, length);
+	return header + length;
+}
+
+static BOOL wait_for_messages(size_t count)
+{
+	for (size_t x = 0; x < 50; x++)
+	{
+		EnterCriticalSection(&server->lock);
+		const size_t messages = server->messages;
+		(void)ResetEvent(server->receivedEvent);
+		LeaveCriticalSection(&server->lock);
+
+		if (messages >= count)
+			return TRUE;
+		(void)WaitForSingleObject(server->receivedEvent, 100);
+	}
+	return FALSE;
+}
+
+static BOOL run(rdpContext* context, BOOL synchronous)
+{
+	BOOL rc = FALSE;
+	TestServer test = { 0 };
+	CHANNEL_ENTRY_POINTS_FREERDP_EX entryPoints = { 0 };
+	const BYTE capabilities[] = { 0x50, 0x00, 0x01, 0x00 };
+	const BYTE create[] = { 0x10, TEST_CHANNEL_ID, 't', 'e', 's', 't', 'd', 'v', 'c', '\0' };
+	BYTE message[TEST_MESSAGE + TEST_SMALL_MESSAGE] = { 0 };
+	BYTE pdu[TEST_MESSAGE] = { 0 };
+	size_t length = 0;
+
+	if (!freerdp_settings_set_bool(context->settings, FreeRDP_SynchronousDynamicChannels,
+	                               synchronous))
+		return FALSE;
+
+	server = &test;
+	InitializeCriticalSection(&test.lock);
+	test.sent = Stream_New(NULL, TEST_MESSAGE);
+	test.received = Stream_New(NULL, TEST_MESSAGE);
+	test.receivedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!test.sent || !test.received || !test.receivedEvent)
+		goto fail;
+
+	entryPoints.cbSize = sizeof(entryPoints);
+	entryPoints.protocolVersion = VIRTUAL_CHANNEL_VERSION_WIN2000;
+	entryPoints.pVirtualChannelInitEx = test_init;
+	entryPoints.pVirtualChannelOpenEx = test_open;
+	entryPoints.pVirtualChannelCloseEx = test_close;
+	entryPoints.pVirtualChannelWriteEx = test_write;
+	entryPoints.MagicNumber = FREERDP_CHANNEL_MAGIC_NUMBER;
+	entryPoints.context = context;
+
+	if (!drdynvc_VirtualChannelEntryEx((PCHANNEL_ENTRY_POINTS_EX)&entryPoints, &test))
+		goto fail;
+
+	test.initEvent(test.drdynvc, &test, CHANNEL_EVENT_INITIALIZED, NULL, 0);
+	test.initEvent(test.drdynvc, &test, CHANNEL_EVENT_CONNECTED, NULL, 0);
+	if (!test.openEvent)
+		goto fail;
+
+	feed(capabilities, sizeof(capabilities), sizeof(capabilities));
+	feed(create, sizeof(create), sizeof(create));
+
+	winpr_RAND(message, sizeof(message));
+
+	/* DATA_FIRST split over two static channel chunks, a DATA in one chunk and the last
+	 * DATA split over three chunks, then an unfragmented message */
+	length = data_pdu(pdu, DATA_FIRST_PDU, message, 1000, TEST_MESSAGE);
+	feed(pdu, length, 600);
+	length = data_pdu(pdu, DATA_PDU, &message[1000], 1600, 0);
+	feed(pdu, length, length);
+	length = data_pdu(pdu, DATA_PDU, &message[2600], TEST_MESSAGE - 2600, 0);
+	feed(pdu, length, 1000);
+	length = data_pdu(pdu, DATA_PDU, &message[TEST_MESSAGE], TEST_SMALL_MESSAGE, 0);
+	feed(pdu, length, length);
+
+	if (!wait_for_messages(2))
+	{
+		printf("[%s] channel data was not delivered\n", synchronous ? "sync" : "async");
+		goto fail;
+	}
+
+	if ((test.messages != 2) || (Stream_GetPosition(test.received) != sizeof(message)) ||
+	    (memcmp(Stream_Buffer(test.received), message, sizeof(message)) != 0))
+	{
+		printf("[%s] %" PRIuz " messages, reassembled data differs\n",
+		       synchronous ? "sync" : "async", test.messages);
+		goto fail;
+	}
+
+	if (InterlockedCompareExchange64(&test.drdynvc->bytesDelivered, 0, 0) != sizeof(message))
+	{
+		printf("[%s] delivered byte count is wrong\n", synchronous ? "sync" : "async");
+		goto fail;
+	}
+
+	/* a write larger than a chunk goes out as DATA_FIRST and DATA slices */
+	if (!test.channel ||
+	    (test.channel->Write(test.channel, TEST_MESSAGE, message, NULL) != CHANNEL_RC_OK))
+		goto fail;
+
+	if (test.oversized || (test.slices < 2) || (test.firstLength != TEST_MESSAGE) ||
+	    (Stream_GetPosition(test.sent) != TEST_MESSAGE) ||
+	    (memcmp(Stream_Buffer(test.sent), message, TEST_MESSAGE) != 0))
+	{
+		printf("[%s] %" PRIuz " slices, first length %" PRIu32 ", sent data differs\n",
+		       synchronous ? "sync" : "async", test.slices, test.firstLength);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	if (test.initEvent)
+	{
+		test.initEvent(test.drdynvc, &test, CHANNEL_EVENT_DISCONNECTED, NULL, 0);
+		test.initEvent(test.drdynvc, &test, CHANNEL_EVENT_TERMINATED, NULL, 0);
+	}
+	if (test.receivedEvent)
+		(void)CloseHandle(test.receivedEvent);
+	Stream_Free(test.received, TRUE);
+	Stream_Free(test.sent, TRUE);
+	DeleteCriticalSection(&test.lock);
+	server = NULL;
+	return rc;
+}
+
+int TestDrdynvcFragments(int argc, char* argv[])
+{
+	int rc = -1;
+	char* args[] = { TEST_CHANNEL };
+	FREERDP_LOAD_CHANNEL_ADDIN_ENTRY_FN provider = freerdp_get_current_addin_provider();
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	freerdp* instance = freerdp_new();
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	ADDIN_ARGV* addin = freerdp_addin_argv_new(ARRAYSIZE(args), (const char**)args);
+	if (!addin)
+		goto fail;
+	if (!freerdp_dynamic_channel_collection_add(instance->context->settings, addin))
+	{
+		freerdp_addin_argv_free(addin);
+		goto fail;
+	}
+
+	freerdp_register_addin_provider(test_addin_provider, 0);
+	if (!run(instance->context, TRUE) || !run(instance->context, FALSE))
+		goto fail;
+
+	rc = 0;
+fail:
+	freerdp_register_addin_provider(provider, 0);
+	if (instance)
+		freerdp_context_free(instance);
+	freerdp_free(instance);
+	return rc;
+}
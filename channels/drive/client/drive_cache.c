@@ -0,0 +1,853 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel, directory and attribute cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/file.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
+
+#include <freerdp/types.h>
+
+#include "drive_file.h"
+#include "drive_cache.h"
+
+#if defined(FREERDP_HAVE_SYS_INOTIFY_H)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <winpr/handle.h>
+#define DRIVE_CACHE_INOTIFY
+#endif
+
+#define DRIVE_CACHE_MAX_LISTINGS 64
+#define DRIVE_CACHE_MAX_ATTRIBUTES 4096
+
+/* unwatched entries may miss changes, keep them only for bursts of requests */
+#define DRIVE_CACHE_TTL_MS 2000
+#define DRIVE_CACHE_WATCHED_TTL_MS 60000
+
+struct s_drive_directory_listing
+{
+	volatile LONG refs;
+	char* key;
+	char* directory;
+	UINT64 timestamp;
+	UINT64 lastUsed;
+	BOOL watched;
+	UINT32 watchEpoch;
+	DWORD error;
+	size_t count;
+	DRIVE_FILE_ENTRY* entries;
+	WCHAR* names;
+};
+
+typedef struct
+{
+	DRIVE_FILE_ATTRIBUTES attributes;
+	UINT64 timestamp;
+	UINT32 watchEpoch;
+	BOOL watched;
+} DRIVE_CACHE_ATTRIBUTES;
+
+typedef struct
+{
+	int wd;
+	char* directory;
+} DRIVE_CACHE_WATCH;
+
+struct s_drive_cache
+{
+	CRITICAL_SECTION lock;
+	UINT64 generation;
+	UINT32 watchEpoch;
+	wHashTable* attributes;
+	wHashTable* openFiles;
+	DRIVE_DIRECTORY_LISTING* listings[DRIVE_CACHE_MAX_LISTINGS];
+	size_t listingCount;
+
+#if defined(DRIVE_CACHE_INOTIFY)
+	int inotify;
+	HANDLE inotifyEvent;
+	HANDLE stopEvent;
+	HANDLE thread;
+	DRIVE_CACHE_WATCH watches[DRIVE_CACHE_MAX_LISTINGS];
+	size_t watchCount;
+#endif
+};
+
+static char* drive_cache_key(const WCHAR* path)
+{
+	if (!path)
+		return NULL;
+	return ConvertWCharToUtf8Alloc(path, NULL);
+}
+
+static char* drive_cache_parent(const char* key)
+{
+	const char* slash = strrchr(key, '/');
+	const char* backslash = strrchr(key, '\\');
+
+	if (!slash || (backslash && (backslash > slash)))
+		slash = backslash;
+	if (!slash)
+		return NULL;
+
+	/* keep the separator for the root directory */
+	const size_t len = MAX(1, WINPR_ASSERTING_INT_CAST(size_t, slash - key));
+	char* parent = malloc(len + 1);
+	if (!parent)
+		return NULL;
+	memcpy(parent, key, len);
+	parent[len] = '\0';
+	return parent;
+}
+
+static void drive_listing_free(DRIVE_DIRECTORY_LISTING* listing)
+{
+	if (!listing)
+		return;
+
+	free(listing->key);
+	free(listing->directory);
+	free(listing->entries);
+	free(listing->names);
+	free(listing);
+}
+
+void drive_directory_listing_release(DRIVE_DIRECTORY_LISTING* listing)
+{
+	if (!listing)
+		return;
+
+	if (InterlockedDecrement(&listing->refs) == 0)
+		drive_listing_free(listing);
+}
+
+const DRIVE_FILE_ENTRY* drive_directory_listing_entry(const DRIVE_DIRECTORY_LISTING* listing,
+                                                      size_t index)
+{
+	if (!listing || (index >= listing->count))
+		return NULL;
+	return &listing->entries[index];
+}
+
+#if defined(DRIVE_CACHE_INOTIFY)
+static DRIVE_CACHE_WATCH* drive_cache_find_watch(DRIVE_CACHE* cache, const char* directory,
+                                                 int wd)
+{
+	for (size_t x = 0; x < cache->watchCount; x++)
+	{
+		DRIVE_CACHE_WATCH* watch = &cache->watches[x];
+		if (directory && (strcmp(watch->directory, directory) == 0))
+			return watch;
+		if (!directory && (watch->wd == wd))
+			return watch;
+	}
+	return NULL;
+}
+
+static void drive_cache_remove_watch(DRIVE_CACHE* cache, DRIVE_CACHE_WATCH* watch, BOOL active)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(watch);
+
+	if (active)
+		(void)inotify_rm_watch(cache->inotify, watch->wd);
+	free(watch->directory);
+
+	*watch = cache->watches[cache->watchCount - 1];
+	cache->watchCount--;
+
+	/* attributes relying on the watch fall back to the short lifetime */
+	cache->watchEpoch++;
+}
+
+static BOOL drive_cache_has_listing(DRIVE_CACHE* cache, const char* directory)
+{
+	for (size_t x = 0; x < cache->listingCount; x++)
+	{
+		if (strcmp(cache->listings[x]->directory, directory) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* remove watches of directories without cached listings */
+static void drive_cache_prune_watches(DRIVE_CACHE* cache)
+{
+	for (size_t x = 0; x < cache->watchCount;)
+	{
+		DRIVE_CACHE_WATCH* watch = &cache->watches[x];
+		if (!drive_cache_has_listing(cache, watch->directory))
+			drive_cache_remove_watch(cache, watch, TRUE);
+		else
+			x++;
+	}
+}
+#endif
+
+static BOOL drive_cache_is_watched(DRIVE_CACHE* cache, const char* directory)
+{
+#if defined(DRIVE_CACHE_INOTIFY)
+	if (directory && drive_cache_find_watch(cache, directory, -1))
+		return TRUE;
+#else
+	WINPR_UNUSED(cache);
+	WINPR_UNUSED(directory);
+#endif
+	return FALSE;
+}
+
+static BOOL drive_cache_watch(DRIVE_CACHE* cache, const char* directory)
+{
+#if defined(DRIVE_CACHE_INOTIFY)
+	if (!directory || (cache->inotify < 0))
+		return FALSE;
+	if (drive_cache_find_watch(cache, directory, -1))
+		return TRUE;
+	if (cache->watchCount >= ARRAYSIZE(cache->watches))
+		drive_cache_prune_watches(cache);
+	if (cache->watchCount >= ARRAYSIZE(cache->watches))
+		return FALSE;
+
+	const int wd = inotify_add_watch(cache->inotify, directory,
+	                                 IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM |
+	                                     IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+	                                     IN_ONLYDIR);
+	if (wd < 0)
+		return FALSE;
+
+	/* the kernel returns the existing descriptor for directories watched twice */
+	if (drive_cache_find_watch(cache, NULL, wd))
+		return TRUE;
+
+	char* dup = _strdup(directory);
+	if (!dup)
+	{
+		(void)inotify_rm_watch(cache->inotify, wd);
+		return FALSE;
+	}
+
+	DRIVE_CACHE_WATCH* watch = &cache->watches[cache->watchCount++];
+	watch->wd = wd;
+	watch->directory = dup;
+	return TRUE;
+#else
+	WINPR_UNUSED(cache);
+	WINPR_UNUSED(directory);
+	return FALSE;
+#endif
+}
+
+static void drive_cache_unwatch(DRIVE_CACHE* cache, const char* directory)
+{
+#if defined(DRIVE_CACHE_INOTIFY)
+	if (!directory || drive_cache_has_listing(cache, directory))
+		return;
+
+	DRIVE_CACHE_WATCH* watch = drive_cache_find_watch(cache, directory, -1);
+	if (watch)
+		drive_cache_remove_watch(cache, watch, TRUE);
+#else
+	WINPR_UNUSED(cache);
+	WINPR_UNUSED(directory);
+#endif
+}
+
+static void drive_cache_remove_listing(DRIVE_CACHE* cache, size_t index, BOOL unwatch)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(index < cache->listingCount);
+
+	DRIVE_DIRECTORY_LISTING* listing = cache->listings[index];
+	cache->listings[index] = cache->listings[cache->listingCount - 1];
+	cache->listingCount--;
+
+	if (unwatch)
+		drive_cache_unwatch(cache, listing->directory);
+	drive_directory_listing_release(listing);
+}
+
+/* drop the listings of directory, the watch is kept as the directory is still of interest */
+static void drive_cache_drop_directory(DRIVE_CACHE* cache, const char* directory)
+{
+	if (!directory)
+		return;
+
+	for (size_t x = 0; x < cache->listingCount;)
+	{
+		if (strcmp(cache->listings[x]->directory, directory) == 0)
+			drive_cache_remove_listing(cache, x, FALSE);
+		else
+			x++;
+	}
+}
+
+static void drive_cache_drop_all(DRIVE_CACHE* cache)
+{
+	while (cache->listingCount > 0)
+		drive_cache_remove_listing(cache, cache->listingCount - 1, FALSE);
+	HashTable_Clear(cache->attributes);
+}
+
+static void drive_cache_drop_path(DRIVE_CACHE* cache, const char* key, BOOL recursive)
+{
+	cache->generation++;
+
+	if (recursive)
+	{
+		drive_cache_drop_all(cache);
+		return;
+	}
+
+	char* parent = drive_cache_parent(key);
+	(void)HashTable_Remove(cache->attributes, key);
+	if (parent)
+		(void)HashTable_Remove(cache->attributes, parent);
+	drive_cache_drop_directory(cache, parent);
+	free(parent);
+}
+
+#if defined(DRIVE_CACHE_INOTIFY)
+static void drive_cache_handle_event(DRIVE_CACHE* cache, const struct inotify_event* event)
+{
+	if (event->mask & IN_Q_OVERFLOW)
+	{
+		cache->generation++;
+		drive_cache_drop_all(cache);
+		return;
+	}
+
+	DRIVE_CACHE_WATCH* watch = drive_cache_find_watch(cache, NULL, event->wd);
+	if (!watch)
+		return;
+
+	if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+	{
+		/* paths below the directory changed */
+		cache->generation++;
+		drive_cache_drop_all(cache);
+		if (event->mask & IN_IGNORED)
+			drive_cache_remove_watch(cache, watch, FALSE);
+		return;
+	}
+
+	if ((event->mask & IN_ISDIR) && (event->mask & (IN_DELETE | IN_MOVED_FROM)))
+	{
+		cache->generation++;
+		drive_cache_drop_all(cache);
+		return;
+	}
+
+	if (event->len == 0)
+	{
+		drive_cache_drop_path(cache, watch->directory, FALSE);
+		return;
+	}
+
+	char* child = NULL;
+	size_t len = 0;
+	winpr_asprintf(&child, &len, "%s/%s", watch->directory, event->name);
+	if (!child)
+	{
+		cache->generation++;
+		drive_cache_drop_all(cache);
+		return;
+	}
+
+	drive_cache_drop_path(cache, child, FALSE);
+	free(child);
+}
+
+static DWORD WINAPI drive_cache_thread(LPVOID arg)
+{
+	DRIVE_CACHE* cache = (DRIVE_CACHE*)arg;
+	WINPR_ASSERT(cache);
+
+	HANDLE events[] = { cache->stopEvent, cache->inotifyEvent };
+
+	while (WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, INFINITE) ==
+	       WAIT_OBJECT_0 + 1)
+	{
+		union
+		{
+			struct inotify_event event;
+			char data[4096];
+		} buffer = { 0 };
+
+		while (1)
+		{
+			const ssize_t rc = read(cache->inotify, buffer.data, sizeof(buffer.data));
+			if (rc <= 0)
+			{
+				if ((rc < 0) && (errno == EINTR))
+					continue;
+				break;
+			}
+
+			EnterCriticalSection(&cache->lock);
+			for (size_t pos = 0; pos + sizeof(struct inotify_event) <= (size_t)rc;)
+			{
+				const struct inotify_event* event =
+				    (const struct inotify_event*)&buffer.data[pos];
+				drive_cache_handle_event(cache, event);
+				pos += sizeof(struct inotify_event) + event->len;
+			}
+			LeaveCriticalSection(&cache->lock);
+		}
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+static void drive_cache_inotify_init(DRIVE_CACHE* cache)
+{
+	cache->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (cache->inotify < 0)
+	{
+		char ebuffer[256] = { 0 };
+		WLog_DBG(TAG, "inotify_init1 failed with %s, using time based expiry only",
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		return;
+	}
+
+	cache->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	cache->inotifyEvent =
+	    CreateFileDescriptorEvent(NULL, FALSE, FALSE, cache->inotify, WINPR_FD_READ);
+	if (cache->stopEvent && cache->inotifyEvent)
+		cache->thread = CreateThread(NULL, 0, drive_cache_thread, cache, 0, NULL);
+
+	if (!cache->thread)
+	{
+		WLog_WARN(TAG, "failed to start the inotify thread, using time based expiry only");
+		(void)close(cache->inotify);
+		cache->inotify = -1;
+	}
+}
+
+static void drive_cache_inotify_free(DRIVE_CACHE* cache)
+{
+	if (cache->thread)
+	{
+		(void)SetEvent(cache->stopEvent);
+		(void)WaitForSingleObject(cache->thread, INFINITE);
+		(void)CloseHandle(cache->thread);
+	}
+	if (cache->inotifyEvent)
+		(void)CloseHandle(cache->inotifyEvent);
+	if (cache->stopEvent)
+		(void)CloseHandle(cache->stopEvent);
+	if (cache->inotify >= 0)
+		(void)close(cache->inotify);
+
+	for (size_t x = 0; x < cache->watchCount; x++)
+		free(cache->watches[x].directory);
+}
+#endif
+
+static void drive_cache_open_files_free(void* obj)
+{
+	ArrayList_Free((wArrayList*)obj);
+}
+
+DRIVE_CACHE* drive_cache_new(void)
+{
+	DRIVE_CACHE* cache = (DRIVE_CACHE*)calloc(1, sizeof(DRIVE_CACHE));
+	if (!cache)
+		return NULL;
+
+	InitializeCriticalSection(&cache->lock);
+#if defined(DRIVE_CACHE_INOTIFY)
+	cache->inotify = -1;
+#endif
+
+	cache->attributes = HashTable_New(FALSE);
+	if (!cache->attributes || !HashTable_SetupForStringData(cache->attributes, FALSE))
+		goto fail;
+
+	wObject* obj = HashTable_ValueObject(cache->attributes);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = free;
+
+	cache->openFiles = HashTable_New(FALSE);
+	if (!cache->openFiles || !HashTable_SetupForStringData(cache->openFiles, FALSE))
+		goto fail;
+
+	obj = HashTable_ValueObject(cache->openFiles);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = drive_cache_open_files_free;
+
+#if defined(DRIVE_CACHE_INOTIFY)
+	drive_cache_inotify_init(cache);
+#endif
+	return cache;
+
+fail:
+	drive_cache_free(cache);
+	return NULL;
+}
+
+void drive_cache_free(DRIVE_CACHE* cache)
+{
+	if (!cache)
+		return;
+
+#if defined(DRIVE_CACHE_INOTIFY)
+	drive_cache_inotify_free(cache);
+#endif
+
+	for (size_t x = 0; x < cache->listingCount; x++)
+		drive_directory_listing_release(cache->listings[x]);
+	HashTable_Free(cache->attributes);
+	HashTable_Free(cache->openFiles);
+	DeleteCriticalSection(&cache->lock);
+	free(cache);
+}
+
+static BOOL drive_cache_fresh(UINT64 now, UINT64 timestamp, BOOL watched)
+{
+	const UINT64 ttl = watched ? DRIVE_CACHE_WATCHED_TTL_MS : DRIVE_CACHE_TTL_MS;
+	return (now - timestamp) <= ttl;
+}
+
+static DRIVE_DIRECTORY_LISTING* drive_listing_enumerate(const WCHAR* pattern)
+{
+	WIN32_FIND_DATAW data = { 0 };
+	size_t capacity = 0;
+	size_t namesCapacity = 0;
+	size_t namesLength = 0;
+	DRIVE_DIRECTORY_LISTING* listing =
+	    (DRIVE_DIRECTORY_LISTING*)calloc(1, sizeof(DRIVE_DIRECTORY_LISTING));
+
+	if (!listing)
+		return NULL;
+
+	HANDLE find = FindFirstFileW(pattern, &data);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		listing->error = GetLastError();
+		return listing;
+	}
+
+	do
+	{
+		const size_t length = _wcsnlen(data.cFileName, ARRAYSIZE(data.cFileName));
+
+		if (listing->count >= capacity)
+		{
+			capacity = MAX(64, capacity * 2);
+			DRIVE_FILE_ENTRY* tmp = realloc(listing->entries, capacity * sizeof(DRIVE_FILE_ENTRY));
+			if (!tmp)
+				goto fail;
+			listing->entries = tmp;
+		}
+
+		if (namesLength + length + 1 > namesCapacity)
+		{
+			namesCapacity = MAX(4096, MAX(namesCapacity * 2, namesLength + length + 1));
+			WCHAR* tmp = realloc(listing->names, namesCapacity * sizeof(WCHAR));
+			if (!tmp)
+				goto fail;
+			listing->names = tmp;
+		}
+
+		DRIVE_FILE_ENTRY* entry = &listing->entries[listing->count++];
+		entry->dwFileAttributes = data.dwFileAttributes;
+		entry->ftCreationTime = data.ftCreationTime;
+		entry->ftLastAccessTime = data.ftLastAccessTime;
+		entry->ftLastWriteTime = data.ftLastWriteTime;
+		entry->nFileSizeHigh = data.nFileSizeHigh;
+		entry->nFileSizeLow = data.nFileSizeLow;
+		/* the pool may still move, store the offset until it is complete */
+		entry->name = (const WCHAR*)(uintptr_t)namesLength;
+		entry->nameLength = length * sizeof(WCHAR);
+
+		memcpy(&listing->names[namesLength], data.cFileName, length * sizeof(WCHAR));
+		namesLength += length;
+		listing->names[namesLength++] = '\0';
+	} while (FindNextFileW(find, &data));
+
+	FindClose(find);
+
+	for (size_t x = 0; x < listing->count; x++)
+	{
+		DRIVE_FILE_ENTRY* entry = &listing->entries[x];
+		entry->name = &listing->names[(uintptr_t)entry->name];
+	}
+	listing->error = ERROR_NO_MORE_FILES;
+	return listing;
+
+fail:
+	FindClose(find);
+	drive_listing_free(listing);
+	return NULL;
+}
+
+DRIVE_DIRECTORY_LISTING* drive_cache_get_listing(DRIVE_CACHE* cache, const WCHAR* pattern)
+{
+	DRIVE_DIRECTORY_LISTING* listing = NULL;
+
+	if (!cache || !pattern)
+		return NULL;
+
+	char* key = drive_cache_key(pattern);
+	char* directory = key ? drive_cache_parent(key) : NULL;
+	if (!key)
+		goto fail;
+
+	const UINT64 now = GetTickCount64();
+
+	EnterCriticalSection(&cache->lock);
+	for (size_t x = 0; x < cache->listingCount; x++)
+	{
+		DRIVE_DIRECTORY_LISTING* cur = cache->listings[x];
+		if (strcmp(cur->key, key) != 0)
+			continue;
+
+		const BOOL watched = cur->watched && (cur->watchEpoch == cache->watchEpoch);
+		if (drive_cache_fresh(now, cur->timestamp, watched))
+		{
+			cur->lastUsed = now;
+			InterlockedIncrement(&cur->refs);
+			listing = cur;
+		}
+		else
+			drive_cache_remove_listing(cache, x, FALSE);
+		break;
+	}
+
+	/* watch before enumerating so changes during the enumeration are not lost */
+	const BOOL watched = listing ? listing->watched : drive_cache_watch(cache, directory);
+	const UINT32 watchEpoch = cache->watchEpoch;
+	const UINT64 generation = cache->generation;
+	LeaveCriticalSection(&cache->lock);
+
+	if (!listing)
+	{
+		listing = drive_listing_enumerate(pattern);
+		if (!listing)
+			goto fail;
+
+		listing->refs = 1;
+		listing->key = key;
+		listing->directory = directory;
+		listing->watched = watched;
+		listing->watchEpoch = watchEpoch;
+		listing->timestamp = now;
+		listing->lastUsed = now;
+		key = NULL;
+		directory = NULL;
+
+		EnterCriticalSection(&cache->lock);
+		if (cache->generation == generation)
+		{
+			if (cache->listingCount >= ARRAYSIZE(cache->listings))
+			{
+				size_t oldest = 0;
+				for (size_t x = 1; x < cache->listingCount; x++)
+				{
+					if (cache->listings[x]->lastUsed < cache->listings[oldest]->lastUsed)
+						oldest = x;
+				}
+				drive_cache_remove_listing(cache, oldest, TRUE);
+			}
+
+			InterlockedIncrement(&listing->refs);
+			cache->listings[cache->listingCount++] = listing;
+		}
+		LeaveCriticalSection(&cache->lock);
+	}
+
+	if (listing->count == 0)
+	{
+		const DWORD error = listing->error;
+		drive_directory_listing_release(listing);
+		listing = NULL;
+		SetLastError(error);
+	}
+
+fail:
+	free(key);
+	free(directory);
+	return listing;
+}
+
+BOOL drive_cache_get_attributes(DRIVE_CACHE* cache, const WCHAR* path,
+                                DRIVE_FILE_ATTRIBUTES* attributes)
+{
+	BOOL rc = FALSE;
+
+	if (!cache || !path || !attributes)
+		return FALSE;
+
+	char* key = drive_cache_key(path);
+	if (!key)
+		return FALSE;
+
+	const UINT64 now = GetTickCount64();
+
+	EnterCriticalSection(&cache->lock);
+	const DRIVE_CACHE_ATTRIBUTES* cur =
+	    (const DRIVE_CACHE_ATTRIBUTES*)HashTable_GetItemValue(cache->attributes, key);
+
+	/* the other handles of the path might have changed it since */
+	wArrayList* handles = (wArrayList*)HashTable_GetItemValue(cache->openFiles, key);
+	if (handles && (ArrayList_Count(handles) > 1))
+		cur = NULL;
+
+	if (cur)
+	{
+		const BOOL watched = cur->watched && (cur->watchEpoch == cache->watchEpoch);
+		if (drive_cache_fresh(now, cur->timestamp, watched))
+		{
+			*attributes = cur->attributes;
+			rc = TRUE;
+		}
+		else
+			(void)HashTable_Remove(cache->attributes, key);
+	}
+	LeaveCriticalSection(&cache->lock);
+
+	free(key);
+	return rc;
+}
+
+void drive_cache_set_attributes(DRIVE_CACHE* cache, const WCHAR* path,
+                                const DRIVE_FILE_ATTRIBUTES* attributes)
+{
+	if (!cache || !path || !attributes)
+		return;
+
+	char* key = drive_cache_key(path);
+	char* directory = key ? drive_cache_parent(key) : NULL;
+	DRIVE_CACHE_ATTRIBUTES* value = calloc(1, sizeof(DRIVE_CACHE_ATTRIBUTES));
+	if (!key || !value)
+		goto fail;
+
+	value->attributes = *attributes;
+	value->timestamp = GetTickCount64();
+
+	EnterCriticalSection(&cache->lock);
+	value->watched = drive_cache_is_watched(cache, directory);
+	value->watchEpoch = cache->watchEpoch;
+
+	if (HashTable_Count(cache->attributes) >= DRIVE_CACHE_MAX_ATTRIBUTES)
+		HashTable_Clear(cache->attributes);
+
+	(void)HashTable_Remove(cache->attributes, key);
+	if (HashTable_Insert(cache->attributes, key, value))
+		value = NULL;
+	LeaveCriticalSection(&cache->lock);
+
+fail:
+	free(value);
+	free(key);
+	free(directory);
+}
+
+void drive_cache_invalidate(DRIVE_CACHE* cache, const WCHAR* path, BOOL recursive)
+{
+	if (!cache || !path)
+		return;
+
+	char* key = drive_cache_key(path);
+
+	EnterCriticalSection(&cache->lock);
+	if (key)
+		drive_cache_drop_path(cache, key, recursive);
+	else
+	{
+		cache->generation++;
+		drive_cache_drop_all(cache);
+	}
+	LeaveCriticalSection(&cache->lock);
+
+	free(key);
+}
+
+BOOL drive_cache_open_file(DRIVE_CACHE* cache, const WCHAR* path, DRIVE_FILE_BUFFER* buffer)
+{
+	BOOL rc = FALSE;
+
+	if (!buffer)
+		return FALSE;
+
+	char* key = cache ? drive_cache_key(path) : NULL;
+	if (!key)
+		goto fail;
+
+	EnterCriticalSection(&cache->lock);
+	wArrayList* handles = (wArrayList*)HashTable_GetItemValue(cache->openFiles, key);
+	if (!handles)
+	{
+		handles = ArrayList_New(FALSE);
+		if (!handles || !HashTable_Insert(cache->openFiles, key, handles))
+		{
+			ArrayList_Free(handles);
+			handles = NULL;
+		}
+	}
+
+	if (handles && ArrayList_Append(handles, buffer))
+	{
+		const size_t count = ArrayList_Count(handles);
+		for (size_t x = 0; (count > 1) && (x < count); x++)
+			drive_file_buffer_set_shared(ArrayList_GetItem(handles, x), TRUE);
+		rc = TRUE;
+	}
+	LeaveCriticalSection(&cache->lock);
+
+fail:
+	/* a handle that is not tracked is never buffered */
+	if (!rc)
+		drive_file_buffer_set_shared(buffer, TRUE);
+	free(key);
+	return rc;
+}
+
+void drive_cache_close_file(DRIVE_CACHE* cache, const WCHAR* path, DRIVE_FILE_BUFFER* buffer)
+{
+	if (!cache || !path || !buffer)
+		return;
+
+	char* key = drive_cache_key(path);
+	if (!key)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	wArrayList* handles = (wArrayList*)HashTable_GetItemValue(cache->openFiles, key);
+	if (handles && ArrayList_Remove(handles, buffer))
+	{
+		const size_t count = ArrayList_Count(handles);
+		if (count == 0)
+			(void)HashTable_Remove(cache->openFiles, key);
+		else if (count == 1)
+			drive_file_buffer_set_shared(ArrayList_GetItem(handles, 0), FALSE);
+	}
+	LeaveCriticalSection(&cache->lock);
+
+	free(key);
+}
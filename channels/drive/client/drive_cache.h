@@ -0,0 +1,95 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel, directory and attribute cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+#define FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/file.h>
+
+#include "drive_file_buffer.h"
+
+/** A directory entry with its name already encoded as it is sent to the server */
+typedef struct
+{
+	UINT32 dwFileAttributes;
+	FILETIME ftCreationTime;
+	FILETIME ftLastAccessTime;
+	FILETIME ftLastWriteTime;
+	UINT32 nFileSizeHigh;
+	UINT32 nFileSizeLow;
+	const WCHAR* name;
+	size_t nameLength; /* in bytes, without terminator */
+} DRIVE_FILE_ENTRY;
+
+/** Attributes of a path as returned by GetFileInformationByHandle */
+typedef struct
+{
+	UINT32 dwFileAttributes;
+	FILETIME ftCreationTime;
+	FILETIME ftLastAccessTime;
+	FILETIME ftLastWriteTime;
+	UINT32 nFileSizeHigh;
+	UINT32 nFileSizeLow;
+	UINT32 nNumberOfLinks;
+} DRIVE_FILE_ATTRIBUTES;
+
+typedef struct s_drive_cache DRIVE_CACHE;
+typedef struct s_drive_directory_listing DRIVE_DIRECTORY_LISTING;
+
+/** @brief Create a cache shared by all files of a drive.
+ *
+ *  Entries expire after a short time, on Linux cached directories are watched with inotify
+ *  and entries are kept until the directory changes.
+ */
+DRIVE_CACHE* drive_cache_new(void);
+void drive_cache_free(DRIVE_CACHE* cache);
+
+/** @brief Get the listing of a FindFirstFileW search \b pattern, enumerate it if not cached.
+ *
+ *  @return A referenced listing to be released with drive_directory_listing_release or \b NULL
+ *  with GetLastError() set if the search failed
+ */
+DRIVE_DIRECTORY_LISTING* drive_cache_get_listing(DRIVE_CACHE* cache, const WCHAR* pattern);
+
+void drive_directory_listing_release(DRIVE_DIRECTORY_LISTING* listing);
+
+/** @brief Get entry \b index of \b listing, \b NULL at the end */
+const DRIVE_FILE_ENTRY* drive_directory_listing_entry(const DRIVE_DIRECTORY_LISTING* listing,
+                                                      size_t index);
+
+BOOL drive_cache_get_attributes(DRIVE_CACHE* cache, const WCHAR* path,
+                                DRIVE_FILE_ATTRIBUTES* attributes);
+void drive_cache_set_attributes(DRIVE_CACHE* cache, const WCHAR* path,
+                                const DRIVE_FILE_ATTRIBUTES* attributes);
+
+/** @brief Drop what is cached for \b path and its parent directory after a local change.
+ *
+ *  \b recursive also drops everything below \b path, used for directories that were renamed
+ *  or deleted.
+ */
+void drive_cache_invalidate(DRIVE_CACHE* cache, const WCHAR* path, BOOL recursive);
+
+/** @brief Track the buffer of a handle open on \b path.
+ *
+ *  The buffers of a path are only used while a single handle is open on it, writes of one
+ *  handle must be seen by the reads and queries of the others.
+ */
+BOOL drive_cache_open_file(DRIVE_CACHE* cache, const WCHAR* path, DRIVE_FILE_BUFFER* buffer);
+void drive_cache_close_file(DRIVE_CACHE* cache, const WCHAR* path, DRIVE_FILE_BUFFER* buffer);
+
+#endif /* FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H */
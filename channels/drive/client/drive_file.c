@@ -317,7 +317,8 @@ static BOOL drive_file_init(DRIVE_FILE* file)
 
 DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathWCharLength,
                            UINT32 id, UINT32 DesiredAccess, UINT32 CreateDisposition,
-                           UINT32 CreateOptions, UINT32 FileAttributes, UINT32 SharedAccess)
+                           UINT32 CreateOptions, UINT32 FileAttributes, UINT32 SharedAccess,
+                           DRIVE_CACHE* cache)
 {
 	if (!base_path || (!path && (PathWCharLength > 0)))
 		return NULL;
@@ -339,11 +340,21 @@ DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 Pat
 	file->CreateDisposition = CreateDisposition;
 	file->CreateOptions = CreateOptions;
 	file->SharedAccess = SharedAccess;
+	file->cache = cache;
 
 	WCHAR* p = drive_file_combine_fullpath(base_path, path, PathWCharLength);
 	(void)drive_file_set_fullpath(file, p);
 	free(p);
 
+	file->buffer = drive_file_buffer_new();
+	if (!file->buffer)
+	{
+		WLog_ERR(TAG, "drive_file_buffer_new failed!");
+		drive_file_free(file);
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return NULL;
+	}
+
 	if (!drive_file_init(file))
 	{
 		DWORD lastError = GetLastError();
@@ -352,6 +363,12 @@ DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 Pat
 		return NULL;
 	}
 
+	file->tracked = drive_cache_open_file(cache, file->fullpath, file->buffer);
+
+	/* anything but FILE_OPEN may have created or truncated the file */
+	if (CreateDisposition != FILE_OPEN)
+		drive_cache_invalidate(cache, file->fullpath, FALSE);
+
 	return file;
 }
 
@@ -362,6 +379,26 @@ BOOL drive_file_free(DRIVE_FILE* file)
 	if (!file)
 		return FALSE;
 
+	/* pending write-behind data must reach the file before it is closed */
+	const BOOL synced = !file->buffer || drive_file_buffer_sync(file->buffer);
+	const DWORD syncError = GetLastError();
+
+	if (file->tracked)
+		drive_cache_close_file(file->cache, file->fullpath, file->buffer);
+
+	const DRIVE_FILE_IO_STATS* stats = drive_file_buffer_stats(file->buffer);
+	if (stats && (stats->reads > 0))
+		WLog_DBG(TAG,
+		         "read cache: %" PRIu64 " of %" PRIu64 " reads hit (%" PRIu64 "%%), %" PRIu64
+		         " bytes read ahead",
+		         stats->readHits, stats->reads, stats->readHits * 100 / stats->reads,
+		         stats->bytesReadAhead);
+	if (stats && (stats->writes > 0))
+		WLog_DBG(TAG, "write cache: %" PRIu64 " writes coalesced into %" PRIu64 " flushes",
+		         stats->writes, stats->writeFlushes);
+	drive_file_buffer_free(file->buffer);
+	file->buffer = NULL;
+
 	if (file->file_handle != INVALID_HANDLE_VALUE)
 	{
 		(void)CloseHandle(file->file_handle);
@@ -374,6 +411,9 @@ BOOL drive_file_free(DRIVE_FILE* file)
 		file->find_handle = INVALID_HANDLE_VALUE;
 	}
 
+	drive_directory_listing_release(file->listing);
+	file->listing = NULL;
+
 	if (file->delete_pending)
 	{
 		if (file->is_dir)
@@ -385,8 +425,14 @@ BOOL drive_file_free(DRIVE_FILE* file)
 			goto fail;
 	}
 
-	rc = TRUE;
+	rc = synced;
+	if (!synced)
+		SetLastError(syncError);
 fail:
+	if (file->fullpath && (file->modified || file->delete_pending))
+		drive_cache_invalidate(file->cache, file->fullpath,
+		                       file->delete_pending && file->is_dir);
+
 	DEBUG_WSTR("Free %s", file->fullpath);
 	free(file->fullpath);
 	free(file);
@@ -395,60 +441,74 @@ fail:
 
 BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset)
 {
-	LARGE_INTEGER loffset = { 0 };
-
 	if (!file)
 		return FALSE;
 
 	if (Offset > INT64_MAX)
 		return FALSE;
 
-	loffset.QuadPart = (LONGLONG)Offset;
-	return SetFilePointerEx(file->file_handle, loffset, NULL, FILE_BEGIN);
+	/* the position is applied by the next read or write */
+	file->offset = Offset;
+	return TRUE;
 }
 
 BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
 {
-	DWORD read = 0;
-
 	if (!file || !buffer || !Length)
 		return FALSE;
 
 	DEBUG_WSTR("Read file %s", file->fullpath);
 
-	if (ReadFile(file->file_handle, buffer, *Length, &read, NULL))
-	{
-		*Length = read;
-		return TRUE;
-	}
+	if (!drive_file_buffer_read(file->buffer, file->file_handle, file->fullpath, file->offset,
+	                            buffer, Length))
+		return FALSE;
 
-	return FALSE;
+	file->offset += *Length;
+	return TRUE;
 }
 
 BOOL drive_file_write(DRIVE_FILE* file, const BYTE* buffer, UINT32 Length)
 {
-	DWORD written = 0;
-
 	if (!file || !buffer)
 		return FALSE;
 
 	DEBUG_WSTR("Write file %s", file->fullpath);
 
-	while (Length > 0)
-	{
-		if (!WriteFile(file->file_handle, buffer, Length, &written, NULL))
-			return FALSE;
-
-		Length -= written;
-		buffer += written;
-	}
+	if (!drive_file_buffer_write(file->buffer, file->file_handle, file->offset, buffer, Length))
+		return FALSE;
 
+	file->modified = TRUE;
+	file->offset += Length;
 	return TRUE;
 }
 
-static BOOL drive_file_query_from_handle_information(const DRIVE_FILE* file,
-                                                     const BY_HANDLE_FILE_INFORMATION* info,
-                                                     UINT32 FsInformationClass, wStream* output)
+static void drive_file_attributes_from_handle_information(const BY_HANDLE_FILE_INFORMATION* info,
+                                                          DRIVE_FILE_ATTRIBUTES* attributes)
+{
+	attributes->dwFileAttributes = info->dwFileAttributes;
+	attributes->ftCreationTime = info->ftCreationTime;
+	attributes->ftLastAccessTime = info->ftLastAccessTime;
+	attributes->ftLastWriteTime = info->ftLastWriteTime;
+	attributes->nFileSizeHigh = info->nFileSizeHigh;
+	attributes->nFileSizeLow = info->nFileSizeLow;
+	attributes->nNumberOfLinks = info->nNumberOfLinks;
+}
+
+static void drive_file_attributes_from_attribute_data(const WIN32_FILE_ATTRIBUTE_DATA* attrib,
+                                                      DRIVE_FILE_ATTRIBUTES* attributes)
+{
+	attributes->dwFileAttributes = attrib->dwFileAttributes;
+	attributes->ftCreationTime = attrib->ftCreationTime;
+	attributes->ftLastAccessTime = attrib->ftLastAccessTime;
+	attributes->ftLastWriteTime = attrib->ftLastWriteTime;
+	attributes->nFileSizeHigh = attrib->nFileSizeHigh;
+	attributes->nFileSizeLow = attrib->nFileSizeLow;
+	attributes->nNumberOfLinks = 0;
+}
+
+static BOOL drive_file_query_from_attributes(const DRIVE_FILE* file,
+                                             const DRIVE_FILE_ATTRIBUTES* info,
+                                             UINT32 FsInformationClass, wStream* output)
 {
 	switch (FsInformationClass)
 	{
@@ -511,86 +571,34 @@ static BOOL drive_file_query_from_handle_information(const DRIVE_FILE* file,
 	return TRUE;
 }
 
-static BOOL drive_file_query_from_attributes(const DRIVE_FILE* file,
-                                             const WIN32_FILE_ATTRIBUTE_DATA* attrib,
-                                             UINT32 FsInformationClass, wStream* output)
-{
-	switch (FsInformationClass)
-	{
-		case FileBasicInformation:
-
-			/* http://msdn.microsoft.com/en-us/library/cc232094.aspx */
-			if (!Stream_EnsureRemainingCapacity(output, 4 + 36))
-				return FALSE;
-
-			Stream_Write_UINT32(output, 36);                                    /* Length */
-			Stream_Write_UINT32(output, attrib->ftCreationTime.dwLowDateTime);  /* CreationTime */
-			Stream_Write_UINT32(output, attrib->ftCreationTime.dwHighDateTime); /* CreationTime */
-			Stream_Write_UINT32(output,
-			                    attrib->ftLastAccessTime.dwLowDateTime); /* LastAccessTime */
-			Stream_Write_UINT32(output,
-			                    attrib->ftLastAccessTime.dwHighDateTime);       /* LastAccessTime */
-			Stream_Write_UINT32(output, attrib->ftLastWriteTime.dwLowDateTime); /* LastWriteTime */
-			Stream_Write_UINT32(output, attrib->ftLastWriteTime.dwHighDateTime); /* LastWriteTime */
-			Stream_Write_UINT32(output, attrib->ftLastWriteTime.dwLowDateTime);  /* ChangeTime */
-			Stream_Write_UINT32(output, attrib->ftLastWriteTime.dwHighDateTime); /* ChangeTime */
-			Stream_Write_UINT32(output, attrib->dwFileAttributes); /* FileAttributes */
-			/* Reserved(4), MUST NOT be added! */
-			break;
-
-		case FileStandardInformation:
-
-			/*  http://msdn.microsoft.com/en-us/library/cc232088.aspx */
-			if (!Stream_EnsureRemainingCapacity(output, 4 + 22))
-				return FALSE;
-
-			Stream_Write_UINT32(output, 22);                          /* Length */
-			Stream_Write_UINT32(output, attrib->nFileSizeLow);        /* AllocationSize */
-			Stream_Write_UINT32(output, attrib->nFileSizeHigh);       /* AllocationSize */
-			Stream_Write_UINT32(output, attrib->nFileSizeLow);        /* EndOfFile */
-			Stream_Write_UINT32(output, attrib->nFileSizeHigh);       /* EndOfFile */
-			Stream_Write_UINT32(output, 0);                           /* NumberOfLinks */
-			Stream_Write_UINT8(output, file->delete_pending ? 1 : 0); /* DeletePending */
-			Stream_Write_UINT8(output, attrib->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY
-			                               ? TRUE
-			                               : FALSE); /* Directory */
-			/* Reserved(2), MUST NOT be added! */
-			break;
-
-		case FileAttributeTagInformation:
-
-			/* http://msdn.microsoft.com/en-us/library/cc232093.aspx */
-			if (!Stream_EnsureRemainingCapacity(output, 4 + 8))
-				return FALSE;
-
-			Stream_Write_UINT32(output, 8);                        /* Length */
-			Stream_Write_UINT32(output, attrib->dwFileAttributes); /* FileAttributes */
-			Stream_Write_UINT32(output, 0);                        /* ReparseTag */
-			break;
-
-		default:
-			/* Unhandled FsInformationClass */
-			WLog_WARN(TAG, "Unhandled FSInformationClass %s [0x%08" PRIx32 "]",
-			          FSInformationClass2Tag(FsInformationClass), FsInformationClass);
-			return FALSE;
-	}
-
-	return TRUE;
-}
-
 BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output)
 {
 	BY_HANDLE_FILE_INFORMATION fileInformation = { 0 };
+	DRIVE_FILE_ATTRIBUTES attributes = { 0 };
 	BOOL status = 0;
 	HANDLE hFile = NULL;
 
 	if (!file || !output)
 		return FALSE;
 
+	/* sizes and times must include the write-behind data */
+	if (file->buffer && !drive_file_buffer_flush(file->buffer))
+		goto out_fail;
+
+	if (file->modified)
+	{
+		drive_cache_invalidate(file->cache, file->fullpath, FALSE);
+		file->modified = FALSE;
+	}
+	else if (drive_cache_get_attributes(file->cache, file->fullpath, &attributes))
+		goto out_write;
+
 	if ((file->file_handle != INVALID_HANDLE_VALUE) &&
 	    GetFileInformationByHandle(file->file_handle, &fileInformation))
-		return drive_file_query_from_handle_information(file, &fileInformation, FsInformationClass,
-		                                                output);
+	{
+		drive_file_attributes_from_handle_information(&fileInformation, &attributes);
+		goto out_cache;
+	}
 
 	hFile = CreateFileW(file->fullpath, 0, FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
 	                    FILE_ATTRIBUTE_NORMAL, NULL);
@@ -601,11 +609,8 @@ BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, w
 		if (!status)
 			goto out_fail;
 
-		if (!drive_file_query_from_handle_information(file, &fileInformation, FsInformationClass,
-		                                              output))
-			goto out_fail;
-
-		return TRUE;
+		drive_file_attributes_from_handle_information(&fileInformation, &attributes);
+		goto out_cache;
 	}
 
 	/* If we failed before (i.e. if information for a drive is queried) fall back to
@@ -614,7 +619,12 @@ BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, w
 	if (!GetFileAttributesExW(file->fullpath, GetFileExInfoStandard, &fileAttributes))
 		goto out_fail;
 
-	if (!drive_file_query_from_attributes(file, &fileAttributes, FsInformationClass, output))
+	drive_file_attributes_from_attribute_data(&fileAttributes, &attributes);
+
+out_cache:
+	drive_cache_set_attributes(file->cache, file->fullpath, &attributes);
+out_write:
+	if (!drive_file_query_from_attributes(file, &attributes, FsInformationClass, output))
 		goto out_fail;
 
 	return TRUE;
@@ -623,8 +633,8 @@ out_fail:
 	return FALSE;
 }
 
-BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
-                                wStream* input)
+static BOOL drive_file_set_information_int(DRIVE_FILE* file, UINT32 FsInformationClass,
+                                           UINT32 Length, wStream* input)
 {
 	INT64 size = 0;
 	ULARGE_INTEGER liCreationTime = { 0 };
@@ -644,8 +654,8 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	UINT8 ReplaceIfExists = 0;
 	DWORD attr = 0;
 
-	if (!file || !input)
-		return FALSE;
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(input);
 
 	switch (FsInformationClass)
 	{
@@ -813,8 +823,14 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 			                MOVEFILE_COPY_ALLOWED |
 			                    (ReplaceIfExists ? MOVEFILE_REPLACE_EXISTING : 0)))
 			{
+				drive_cache_invalidate(file->cache, file->fullpath, file->is_dir);
+				drive_cache_invalidate(file->cache, fullpath, file->is_dir);
+
+				if (file->tracked)
+					drive_cache_close_file(file->cache, file->fullpath, file->buffer);
 				const BOOL rc = drive_file_set_fullpath(file, fullpath);
 				free(fullpath);
+				file->tracked = drive_cache_open_file(file->cache, file->fullpath, file->buffer);
 				if (!rc)
 					return FALSE;
 			}
@@ -839,11 +855,30 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	return TRUE;
 }
 
-static BOOL drive_file_query_dir_info(DRIVE_FILE* file, wStream* output, size_t length)
+BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
+                                wStream* input)
 {
-	WINPR_ASSERT(file);
+	if (!file || !input)
+		return FALSE;
+
+	if (file->buffer && !drive_file_buffer_sync(file->buffer))
+		return FALSE;
+
+	const BOOL rc = drive_file_set_information_int(file, FsInformationClass, Length, input);
+
+	/* even a failed request might have changed parts of the file */
+	drive_cache_invalidate(file->cache, file->fullpath, FALSE);
+	file->modified = FALSE;
+	return rc;
+}
+
+static BOOL drive_file_query_dir_info(const DRIVE_FILE_ENTRY* entry, wStream* output)
+{
+	WINPR_ASSERT(entry);
 	WINPR_ASSERT(output);
 
+	const size_t length = entry->nameLength;
+
 	/* http://msdn.microsoft.com/en-us/library/cc232097.aspx */
 	if (!Stream_EnsureRemainingCapacity(output, 4 + 64 + length))
 		return FALSE;
@@ -854,30 +889,32 @@ static BOOL drive_file_query_dir_info(DRIVE_FILE* file, wStream* output, size_t
 	Stream_Write_UINT32(output, (UINT32)(64 + length));                        /* Length */
 	Stream_Write_UINT32(output, 0);                                            /* NextEntryOffset */
 	Stream_Write_UINT32(output, 0);                                            /* FileIndex */
-	Stream_Write_UINT32(output, file->find_data.ftCreationTime.dwLowDateTime); /* CreationTime */
-	Stream_Write_UINT32(output, file->find_data.ftCreationTime.dwHighDateTime); /* CreationTime */
+	Stream_Write_UINT32(output, entry->ftCreationTime.dwLowDateTime); /* CreationTime */
+	Stream_Write_UINT32(output, entry->ftCreationTime.dwHighDateTime); /* CreationTime */
 	Stream_Write_UINT32(output,
-	                    file->find_data.ftLastAccessTime.dwLowDateTime); /* LastAccessTime */
+	                    entry->ftLastAccessTime.dwLowDateTime); /* LastAccessTime */
 	Stream_Write_UINT32(output,
-	                    file->find_data.ftLastAccessTime.dwHighDateTime);       /* LastAccessTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwLowDateTime); /* LastWriteTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwHighDateTime); /* LastWriteTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwLowDateTime);  /* ChangeTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwHighDateTime); /* ChangeTime */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeLow);                   /* EndOfFile */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeHigh);                  /* EndOfFile */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeLow);     /* AllocationSize */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeHigh);    /* AllocationSize */
-	Stream_Write_UINT32(output, file->find_data.dwFileAttributes); /* FileAttributes */
+	                    entry->ftLastAccessTime.dwHighDateTime);       /* LastAccessTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwLowDateTime); /* LastWriteTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwHighDateTime); /* LastWriteTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwLowDateTime);  /* ChangeTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwHighDateTime); /* ChangeTime */
+	Stream_Write_UINT32(output, entry->nFileSizeLow);                   /* EndOfFile */
+	Stream_Write_UINT32(output, entry->nFileSizeHigh);                  /* EndOfFile */
+	Stream_Write_UINT32(output, entry->nFileSizeLow);     /* AllocationSize */
+	Stream_Write_UINT32(output, entry->nFileSizeHigh);    /* AllocationSize */
+	Stream_Write_UINT32(output, entry->dwFileAttributes); /* FileAttributes */
 	Stream_Write_UINT32(output, (UINT32)length);                   /* FileNameLength */
-	Stream_Write(output, file->find_data.cFileName, length);
+	Stream_Write(output, entry->name, length);
 	return TRUE;
 }
 
-static BOOL drive_file_query_full_dir_info(DRIVE_FILE* file, wStream* output, size_t length)
+static BOOL drive_file_query_full_dir_info(const DRIVE_FILE_ENTRY* entry, wStream* output)
 {
-	WINPR_ASSERT(file);
+	WINPR_ASSERT(entry);
 	WINPR_ASSERT(output);
+
+	const size_t length = entry->nameLength;
 	/* http://msdn.microsoft.com/en-us/library/cc232068.aspx */
 	if (!Stream_EnsureRemainingCapacity(output, 4 + 68 + length))
 		return FALSE;
@@ -888,31 +925,33 @@ static BOOL drive_file_query_full_dir_info(DRIVE_FILE* file, wStream* output, si
 	Stream_Write_UINT32(output, (UINT32)(68 + length));                        /* Length */
 	Stream_Write_UINT32(output, 0);                                            /* NextEntryOffset */
 	Stream_Write_UINT32(output, 0);                                            /* FileIndex */
-	Stream_Write_UINT32(output, file->find_data.ftCreationTime.dwLowDateTime); /* CreationTime */
-	Stream_Write_UINT32(output, file->find_data.ftCreationTime.dwHighDateTime); /* CreationTime */
+	Stream_Write_UINT32(output, entry->ftCreationTime.dwLowDateTime); /* CreationTime */
+	Stream_Write_UINT32(output, entry->ftCreationTime.dwHighDateTime); /* CreationTime */
 	Stream_Write_UINT32(output,
-	                    file->find_data.ftLastAccessTime.dwLowDateTime); /* LastAccessTime */
+	                    entry->ftLastAccessTime.dwLowDateTime); /* LastAccessTime */
 	Stream_Write_UINT32(output,
-	                    file->find_data.ftLastAccessTime.dwHighDateTime);       /* LastAccessTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwLowDateTime); /* LastWriteTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwHighDateTime); /* LastWriteTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwLowDateTime);  /* ChangeTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwHighDateTime); /* ChangeTime */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeLow);                   /* EndOfFile */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeHigh);                  /* EndOfFile */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeLow);     /* AllocationSize */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeHigh);    /* AllocationSize */
-	Stream_Write_UINT32(output, file->find_data.dwFileAttributes); /* FileAttributes */
+	                    entry->ftLastAccessTime.dwHighDateTime);       /* LastAccessTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwLowDateTime); /* LastWriteTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwHighDateTime); /* LastWriteTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwLowDateTime);  /* ChangeTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwHighDateTime); /* ChangeTime */
+	Stream_Write_UINT32(output, entry->nFileSizeLow);                   /* EndOfFile */
+	Stream_Write_UINT32(output, entry->nFileSizeHigh);                  /* EndOfFile */
+	Stream_Write_UINT32(output, entry->nFileSizeLow);     /* AllocationSize */
+	Stream_Write_UINT32(output, entry->nFileSizeHigh);    /* AllocationSize */
+	Stream_Write_UINT32(output, entry->dwFileAttributes); /* FileAttributes */
 	Stream_Write_UINT32(output, (UINT32)length);                   /* FileNameLength */
 	Stream_Write_UINT32(output, 0);                                /* EaSize */
-	Stream_Write(output, file->find_data.cFileName, length);
+	Stream_Write(output, entry->name, length);
 	return TRUE;
 }
 
-static BOOL drive_file_query_both_dir_info(DRIVE_FILE* file, wStream* output, size_t length)
+static BOOL drive_file_query_both_dir_info(const DRIVE_FILE_ENTRY* entry, wStream* output)
 {
-	WINPR_ASSERT(file);
+	WINPR_ASSERT(entry);
 	WINPR_ASSERT(output);
+
+	const size_t length = entry->nameLength;
 	/* http://msdn.microsoft.com/en-us/library/cc232095.aspx */
 	if (!Stream_EnsureRemainingCapacity(output, 4 + 93 + length))
 		return FALSE;
@@ -923,34 +962,36 @@ static BOOL drive_file_query_both_dir_info(DRIVE_FILE* file, wStream* output, si
 	Stream_Write_UINT32(output, (UINT32)(93 + length));                        /* Length */
 	Stream_Write_UINT32(output, 0);                                            /* NextEntryOffset */
 	Stream_Write_UINT32(output, 0);                                            /* FileIndex */
-	Stream_Write_UINT32(output, file->find_data.ftCreationTime.dwLowDateTime); /* CreationTime */
-	Stream_Write_UINT32(output, file->find_data.ftCreationTime.dwHighDateTime); /* CreationTime */
+	Stream_Write_UINT32(output, entry->ftCreationTime.dwLowDateTime); /* CreationTime */
+	Stream_Write_UINT32(output, entry->ftCreationTime.dwHighDateTime); /* CreationTime */
 	Stream_Write_UINT32(output,
-	                    file->find_data.ftLastAccessTime.dwLowDateTime); /* LastAccessTime */
+	                    entry->ftLastAccessTime.dwLowDateTime); /* LastAccessTime */
 	Stream_Write_UINT32(output,
-	                    file->find_data.ftLastAccessTime.dwHighDateTime);       /* LastAccessTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwLowDateTime); /* LastWriteTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwHighDateTime); /* LastWriteTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwLowDateTime);  /* ChangeTime */
-	Stream_Write_UINT32(output, file->find_data.ftLastWriteTime.dwHighDateTime); /* ChangeTime */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeLow);                   /* EndOfFile */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeHigh);                  /* EndOfFile */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeLow);     /* AllocationSize */
-	Stream_Write_UINT32(output, file->find_data.nFileSizeHigh);    /* AllocationSize */
-	Stream_Write_UINT32(output, file->find_data.dwFileAttributes); /* FileAttributes */
+	                    entry->ftLastAccessTime.dwHighDateTime);       /* LastAccessTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwLowDateTime); /* LastWriteTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwHighDateTime); /* LastWriteTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwLowDateTime);  /* ChangeTime */
+	Stream_Write_UINT32(output, entry->ftLastWriteTime.dwHighDateTime); /* ChangeTime */
+	Stream_Write_UINT32(output, entry->nFileSizeLow);                   /* EndOfFile */
+	Stream_Write_UINT32(output, entry->nFileSizeHigh);                  /* EndOfFile */
+	Stream_Write_UINT32(output, entry->nFileSizeLow);     /* AllocationSize */
+	Stream_Write_UINT32(output, entry->nFileSizeHigh);    /* AllocationSize */
+	Stream_Write_UINT32(output, entry->dwFileAttributes); /* FileAttributes */
 	Stream_Write_UINT32(output, (UINT32)length);                   /* FileNameLength */
 	Stream_Write_UINT32(output, 0);                                /* EaSize */
 	Stream_Write_UINT8(output, 0);                                 /* ShortNameLength */
 	/* Reserved(1), MUST NOT be added! */
 	Stream_Zero(output, 24); /* ShortName */
-	Stream_Write(output, file->find_data.cFileName, length);
+	Stream_Write(output, entry->name, length);
 	return TRUE;
 }
 
-static BOOL drive_file_query_names_info(DRIVE_FILE* file, wStream* output, size_t length)
+static BOOL drive_file_query_names_info(const DRIVE_FILE_ENTRY* entry, wStream* output)
 {
-	WINPR_ASSERT(file);
+	WINPR_ASSERT(entry);
 	WINPR_ASSERT(output);
+
+	const size_t length = entry->nameLength;
 	/* http://msdn.microsoft.com/en-us/library/cc232077.aspx */
 	if (!Stream_EnsureRemainingCapacity(output, 4 + 12 + length))
 		return FALSE;
@@ -962,16 +1003,30 @@ static BOOL drive_file_query_names_info(DRIVE_FILE* file, wStream* output, size_
 	Stream_Write_UINT32(output, 0);                     /* NextEntryOffset */
 	Stream_Write_UINT32(output, 0);                     /* FileIndex */
 	Stream_Write_UINT32(output, (UINT32)length);        /* FileNameLength */
-	Stream_Write(output, file->find_data.cFileName, length);
+	Stream_Write(output, entry->name, length);
 	return TRUE;
 }
 
+static void drive_file_entry_from_find_data(const WIN32_FIND_DATAW* find_data,
+                                            DRIVE_FILE_ENTRY* entry)
+{
+	entry->dwFileAttributes = find_data->dwFileAttributes;
+	entry->ftCreationTime = find_data->ftCreationTime;
+	entry->ftLastAccessTime = find_data->ftLastAccessTime;
+	entry->ftLastWriteTime = find_data->ftLastWriteTime;
+	entry->nFileSizeHigh = find_data->nFileSizeHigh;
+	entry->nFileSizeLow = find_data->nFileSizeLow;
+	entry->name = find_data->cFileName;
+	entry->nameLength = _wcslen(find_data->cFileName) * sizeof(WCHAR);
+}
+
 BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYTE InitialQuery,
                                 const WCHAR* path, UINT32 PathWCharLength, wStream* output)
 {
 	BOOL rc = FALSE;
-	size_t length = 0;
 	WCHAR* ent_path = NULL;
+	DRIVE_FILE_ENTRY findEntry = { 0 };
+	const DRIVE_FILE_ENTRY* entry = NULL;
 
 	if (!file || !path || !output)
 		return FALSE;
@@ -981,36 +1036,69 @@ BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYT
 		/* release search handle */
 		if (file->find_handle != INVALID_HANDLE_VALUE)
 			FindClose(file->find_handle);
+		file->find_handle = INVALID_HANDLE_VALUE;
+		drive_directory_listing_release(file->listing);
+		file->listing = NULL;
+		file->listingIndex = 0;
 
 		ent_path = drive_file_combine_fullpath(file->basepath, path, PathWCharLength);
-		/* open new search handle and retrieve the first entry */
-		file->find_handle = FindFirstFileW(ent_path, &file->find_data);
-		free(ent_path);
-
-		if (file->find_handle == INVALID_HANDLE_VALUE)
+		if (!ent_path)
 			goto out_fail;
+
+		if (file->cache)
+		{
+			/* take a snapshot of the directory, served from the cache when possible */
+			file->listing = drive_cache_get_listing(file->cache, ent_path);
+			free(ent_path);
+
+			if (!file->listing)
+				goto out_fail;
+		}
+		else
+		{
+			/* open new search handle and retrieve the first entry */
+			file->find_handle = FindFirstFileW(ent_path, &file->find_data);
+			free(ent_path);
+
+			if (file->find_handle == INVALID_HANDLE_VALUE)
+				goto out_fail;
+		}
 	}
-	else if (!FindNextFileW(file->find_handle, &file->find_data))
+	else if (!file->listing && !FindNextFileW(file->find_handle, &file->find_data))
 		goto out_fail;
 
-	length = _wcslen(file->find_data.cFileName) * 2;
+	if (file->listing)
+	{
+		entry = drive_directory_listing_entry(file->listing, file->listingIndex);
+		if (!entry)
+		{
+			SetLastError(ERROR_NO_MORE_FILES);
+			goto out_fail;
+		}
+		file->listingIndex++;
+	}
+	else
+	{
+		drive_file_entry_from_find_data(&file->find_data, &findEntry);
+		entry = &findEntry;
+	}
 
 	switch (FsInformationClass)
 	{
 		case FileDirectoryInformation:
-			rc = drive_file_query_dir_info(file, output, length);
+			rc = drive_file_query_dir_info(entry, output);
 			break;
 
 		case FileFullDirectoryInformation:
-			rc = drive_file_query_full_dir_info(file, output, length);
+			rc = drive_file_query_full_dir_info(entry, output);
 			break;
 
 		case FileBothDirectoryInformation:
-			rc = drive_file_query_both_dir_info(file, output, length);
+			rc = drive_file_query_both_dir_info(entry, output);
 			break;
 
 		case FileNamesInformation:
-			rc = drive_file_query_names_info(file, output, length);
+			rc = drive_file_query_names_info(entry, output);
 			break;
 
 		default:
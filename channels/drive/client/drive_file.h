@@ -30,6 +30,9 @@
 #include <winpr/file.h>
 #include <freerdp/channels/log.h>
 
+#include "drive_cache.h"
+#include "drive_file_buffer.h"
+
 #define TAG CHANNELS_TAG("drive.client")
 
 typedef struct
@@ -47,11 +50,19 @@ typedef struct
 	UINT32 DesiredAccess;
 	UINT32 CreateDisposition;
 	UINT32 CreateOptions;
+	UINT64 offset;
+	DRIVE_FILE_BUFFER* buffer;
+	BOOL tracked;
+	DRIVE_CACHE* cache;
+	DRIVE_DIRECTORY_LISTING* listing;
+	size_t listingIndex;
+	BOOL modified;
 } DRIVE_FILE;
 
 DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathWCharLength,
                            UINT32 id, UINT32 DesiredAccess, UINT32 CreateDisposition,
-                           UINT32 CreateOptions, UINT32 FileAttributes, UINT32 SharedAccess);
+                           UINT32 CreateOptions, UINT32 FileAttributes, UINT32 SharedAccess,
+                           DRIVE_CACHE* cache);
 BOOL drive_file_free(DRIVE_FILE* file);
 
 BOOL drive_file_open(DRIVE_FILE* file);
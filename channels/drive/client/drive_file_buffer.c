@@ -0,0 +1,548 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel, read-ahead and write-behind buffers
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/file.h>
+#include <winpr/io.h>
+#include <winpr/synch.h>
+
+#include <freerdp/types.h>
+
+#include "drive_file.h"
+#include "drive_file_buffer.h"
+
+/* number of sequential reads before the read-ahead window is started */
+#define DRIVE_READAHEAD_TRIGGER 2
+#define DRIVE_READAHEAD_SLOTS 4
+#define DRIVE_READAHEAD_SLOT_SIZE (256u * 1024u)
+#define DRIVE_WRITE_BEHIND_SIZE (1024u * 1024u)
+
+typedef struct
+{
+	OVERLAPPED overlapped;
+	BYTE* data;
+	UINT64 offset;
+	DWORD length;
+	BOOL pending;
+	BOOL valid;
+} DRIVE_READAHEAD_SLOT;
+
+struct s_drive_file_buffer
+{
+	CRITICAL_SECTION lock;
+	DRIVE_FILE_IO_STATS stats;
+	BOOL shared;
+
+	HANDLE readHandle;
+	BOOL readAheadDisabled;
+	BOOL readAheadEof;
+	UINT32 sequential;
+	UINT64 nextRead;
+	UINT64 readAheadNext;
+	DRIVE_READAHEAD_SLOT slots[DRIVE_READAHEAD_SLOTS];
+
+	BYTE* writeData;
+	HANDLE writeHandle;
+	UINT64 writeOffset;
+	size_t writeLength;
+	DWORD writeError;
+};
+
+static void set_offset(OVERLAPPED* overlapped, UINT64 offset)
+{
+	WINPR_ASSERT(overlapped);
+	overlapped->DUMMYUNIONNAME.DUMMYSTRUCTNAME.Offset = (DWORD)(offset & UINT32_MAX);
+	overlapped->DUMMYUNIONNAME.DUMMYSTRUCTNAME.OffsetHigh = (DWORD)(offset >> 32);
+}
+
+static BOOL direct_read(HANDLE handle, UINT64 Offset, BYTE* data, UINT32* Length)
+{
+	DWORD read = 0;
+	LARGE_INTEGER loffset = { 0 };
+
+	WINPR_ASSERT(Length);
+
+	loffset.QuadPart = (LONGLONG)Offset;
+	if (!SetFilePointerEx(handle, loffset, NULL, FILE_BEGIN))
+		return FALSE;
+
+	if (!ReadFile(handle, data, *Length, &read, NULL))
+		return FALSE;
+
+	*Length = read;
+	return TRUE;
+}
+
+static BOOL direct_write(HANDLE handle, UINT64 Offset, const BYTE* data, size_t Length)
+{
+	LARGE_INTEGER loffset = { 0 };
+
+	loffset.QuadPart = (LONGLONG)Offset;
+	if (!SetFilePointerEx(handle, loffset, NULL, FILE_BEGIN))
+		return FALSE;
+
+	while (Length > 0)
+	{
+		DWORD written = 0;
+		const DWORD chunk = (DWORD)MIN(Length, UINT32_MAX);
+
+		if (!WriteFile(handle, data, chunk, &written, NULL))
+			return FALSE;
+
+		Length -= written;
+		data += written;
+	}
+
+	return TRUE;
+}
+
+static void readahead_complete(DRIVE_FILE_BUFFER* buffer, DRIVE_READAHEAD_SLOT* slot)
+{
+	DWORD transferred = 0;
+
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(slot);
+
+	if (!slot->pending)
+		return;
+
+	slot->pending = FALSE;
+	slot->valid = TRUE;
+	slot->length = 0;
+
+	if (GetOverlappedResult(buffer->readHandle, &slot->overlapped, &transferred, TRUE))
+		slot->length = transferred;
+	else if (GetLastError() != ERROR_HANDLE_EOF)
+		slot->valid = FALSE;
+
+	if (slot->valid && (slot->length < DRIVE_READAHEAD_SLOT_SIZE))
+		buffer->readAheadEof = TRUE;
+	if (slot->valid)
+		buffer->stats.bytesReadAhead += slot->length;
+}
+
+static void readahead_drop(DRIVE_FILE_BUFFER* buffer)
+{
+	WINPR_ASSERT(buffer);
+
+	/* buffers of requests in flight can not be reused before they completed */
+	for (size_t x = 0; x < ARRAYSIZE(buffer->slots); x++)
+	{
+		DRIVE_READAHEAD_SLOT* slot = &buffer->slots[x];
+		readahead_complete(buffer, slot);
+		slot->valid = FALSE;
+	}
+
+	buffer->readAheadEof = FALSE;
+	buffer->readAheadNext = 0;
+}
+
+static void readahead_close(DRIVE_FILE_BUFFER* buffer)
+{
+	WINPR_ASSERT(buffer);
+
+	if (!buffer->readHandle)
+		return;
+
+	readahead_drop(buffer);
+	(void)CloseHandle(buffer->readHandle);
+	buffer->readHandle = NULL;
+}
+
+static BOOL readahead_open(DRIVE_FILE_BUFFER* buffer, const WCHAR* path)
+{
+	WINPR_ASSERT(buffer);
+
+	if (buffer->readHandle)
+		return TRUE;
+	if (buffer->readAheadDisabled || !path)
+		return FALSE;
+
+#if defined(_WIN32)
+	const DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+#else
+	/* WinPR locks files opened with a share mode, that would block on our own handle */
+	const DWORD share = 0;
+#endif
+	HANDLE handle = CreateFileW(path, GENERIC_READ, share, NULL, OPEN_EXISTING,
+	                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		WLog_DBG(TAG, "read-ahead not available [%" PRIu32 "]", GetLastError());
+		buffer->readAheadDisabled = TRUE;
+		return FALSE;
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(buffer->slots); x++)
+	{
+		DRIVE_READAHEAD_SLOT* slot = &buffer->slots[x];
+
+		if (!slot->data)
+			slot->data = malloc(DRIVE_READAHEAD_SLOT_SIZE);
+		if (!slot->overlapped.hEvent)
+			slot->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		if (!slot->data || !slot->overlapped.hEvent)
+		{
+			(void)CloseHandle(handle);
+			buffer->readAheadDisabled = TRUE;
+			return FALSE;
+		}
+	}
+
+	buffer->readHandle = handle;
+	return TRUE;
+}
+
+static BOOL readahead_useful(const DRIVE_FILE_BUFFER* buffer, const DRIVE_READAHEAD_SLOT* slot)
+{
+	if (slot->pending)
+		return TRUE;
+	if (!slot->valid)
+		return FALSE;
+	return (slot->offset + slot->length) > buffer->nextRead;
+}
+
+static void readahead_schedule(DRIVE_FILE_BUFFER* buffer)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(buffer->readHandle);
+
+	if (buffer->readAheadNext < buffer->nextRead)
+		buffer->readAheadNext = buffer->nextRead;
+
+	for (size_t x = 0; x < ARRAYSIZE(buffer->slots); x++)
+	{
+		DRIVE_READAHEAD_SLOT* slot = &buffer->slots[x];
+
+		if (buffer->readAheadEof)
+			break;
+		if (readahead_useful(buffer, slot))
+			continue;
+
+		HANDLE event = slot->overlapped.hEvent;
+		memset(&slot->overlapped, 0, sizeof(slot->overlapped));
+		slot->overlapped.hEvent = event;
+		(void)ResetEvent(event);
+
+		slot->offset = buffer->readAheadNext;
+		slot->length = 0;
+		slot->valid = FALSE;
+		set_offset(&slot->overlapped, slot->offset);
+
+		if (ReadFile(buffer->readHandle, slot->data, DRIVE_READAHEAD_SLOT_SIZE, NULL,
+		             &slot->overlapped) ||
+		    (GetLastError() == ERROR_IO_PENDING))
+			slot->pending = TRUE;
+		else if (GetLastError() == ERROR_HANDLE_EOF)
+		{
+			slot->valid = TRUE;
+			buffer->readAheadEof = TRUE;
+		}
+		else
+			break;
+
+		buffer->readAheadNext += DRIVE_READAHEAD_SLOT_SIZE;
+	}
+}
+
+/* copy what the read-ahead window holds for [Offset, Offset + Length) */
+static UINT32 readahead_copy(DRIVE_FILE_BUFFER* buffer, UINT64 Offset, BYTE* data, UINT32 Length)
+{
+	UINT32 copied = 0;
+
+	WINPR_ASSERT(buffer);
+
+	while (copied < Length)
+	{
+		const UINT64 pos = Offset + copied;
+		DRIVE_READAHEAD_SLOT* slot = NULL;
+
+		for (size_t x = 0; x < ARRAYSIZE(buffer->slots); x++)
+		{
+			DRIVE_READAHEAD_SLOT* cur = &buffer->slots[x];
+			if (!cur->pending && !cur->valid)
+				continue;
+			if ((cur->offset <= pos) && (pos < cur->offset + DRIVE_READAHEAD_SLOT_SIZE))
+			{
+				slot = cur;
+				break;
+			}
+		}
+
+		if (!slot)
+			break;
+
+		readahead_complete(buffer, slot);
+		if (!slot->valid || (pos >= slot->offset + slot->length))
+			break;
+
+		const size_t start = (size_t)(pos - slot->offset);
+		const UINT32 chunk = (UINT32)MIN(Length - copied, slot->length - start);
+		memcpy(&data[copied], &slot->data[start], chunk);
+		copied += chunk;
+	}
+
+	return copied;
+}
+
+/* called with the buffer lock held */
+static BOOL write_behind_flush(DRIVE_FILE_BUFFER* buffer)
+{
+	WINPR_ASSERT(buffer);
+
+	if (buffer->writeError != ERROR_SUCCESS)
+	{
+		SetLastError(buffer->writeError);
+		buffer->writeError = ERROR_SUCCESS;
+		return FALSE;
+	}
+
+	if (buffer->writeLength == 0)
+		return TRUE;
+
+	const size_t length = buffer->writeLength;
+	buffer->writeLength = 0;
+	buffer->stats.writeFlushes++;
+
+	if (!direct_write(buffer->writeHandle, buffer->writeOffset, buffer->writeData, length))
+	{
+		WLog_ERR(TAG, "write-behind of %" PRIuz " bytes at %" PRIu64 " failed [%" PRIu32 "]",
+		         length, buffer->writeOffset, GetLastError());
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* called with the buffer lock held */
+static BOOL buffer_sync(DRIVE_FILE_BUFFER* buffer)
+{
+	WINPR_ASSERT(buffer);
+
+	readahead_close(buffer);
+	buffer->sequential = 0;
+	return write_behind_flush(buffer);
+}
+
+DRIVE_FILE_BUFFER* drive_file_buffer_new(void)
+{
+	DRIVE_FILE_BUFFER* buffer = (DRIVE_FILE_BUFFER*)calloc(1, sizeof(DRIVE_FILE_BUFFER));
+	if (!buffer)
+		return NULL;
+
+	InitializeCriticalSection(&buffer->lock);
+	return buffer;
+}
+
+void drive_file_buffer_free(DRIVE_FILE_BUFFER* buffer)
+{
+	if (!buffer)
+		return;
+
+	readahead_close(buffer);
+
+	for (size_t x = 0; x < ARRAYSIZE(buffer->slots); x++)
+	{
+		DRIVE_READAHEAD_SLOT* slot = &buffer->slots[x];
+		if (slot->overlapped.hEvent)
+			(void)CloseHandle(slot->overlapped.hEvent);
+		free(slot->data);
+	}
+
+	free(buffer->writeData);
+	DeleteCriticalSection(&buffer->lock);
+	free(buffer);
+}
+
+static BOOL buffer_read(DRIVE_FILE_BUFFER* buffer, HANDLE handle, const WCHAR* path,
+                        UINT64 Offset, BYTE* data, UINT32* Length)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(Length);
+
+	buffer->stats.reads++;
+
+	/* reads must see the data written so far */
+	if (!write_behind_flush(buffer))
+		return FALSE;
+
+	if (buffer->shared)
+	{
+		if (!direct_read(handle, Offset, data, Length))
+			return FALSE;
+		buffer->stats.bytesRead += *Length;
+		return TRUE;
+	}
+
+	if (Offset == buffer->nextRead)
+		buffer->sequential++;
+	else
+	{
+		buffer->sequential = 0;
+		if (buffer->readHandle)
+			readahead_drop(buffer);
+	}
+
+	UINT32 copied = 0;
+	if (buffer->readHandle)
+		copied = readahead_copy(buffer, Offset, data, *Length);
+
+	if (copied == *Length)
+		buffer->stats.readHits++;
+	else
+	{
+		UINT32 remaining = *Length - copied;
+
+		if (!direct_read(handle, Offset + copied, &data[copied], &remaining))
+		{
+			if (copied == 0)
+				return FALSE;
+			remaining = 0;
+		}
+		copied += remaining;
+	}
+
+	*Length = copied;
+	buffer->stats.bytesRead += copied;
+	buffer->nextRead = Offset + copied;
+
+	if ((buffer->sequential >= DRIVE_READAHEAD_TRIGGER) && readahead_open(buffer, path))
+		readahead_schedule(buffer);
+
+	return TRUE;
+}
+
+BOOL drive_file_buffer_read(DRIVE_FILE_BUFFER* buffer, HANDLE handle, const WCHAR* path,
+                            UINT64 Offset, BYTE* data, UINT32* Length)
+{
+	if (!buffer || !data || !Length)
+		return FALSE;
+
+	EnterCriticalSection(&buffer->lock);
+	const BOOL rc = buffer_read(buffer, handle, path, Offset, data, Length);
+	LeaveCriticalSection(&buffer->lock);
+	return rc;
+}
+
+static BOOL buffer_write(DRIVE_FILE_BUFFER* buffer, HANDLE handle, UINT64 Offset,
+                         const BYTE* data, UINT32 Length)
+{
+	WINPR_ASSERT(buffer);
+
+	buffer->stats.writes++;
+	buffer->stats.bytesWritten += Length;
+
+	if (buffer->readHandle)
+		readahead_drop(buffer);
+
+	if ((buffer->writeError != ERROR_SUCCESS) ||
+	    ((buffer->writeLength > 0) &&
+	     ((Offset != buffer->writeOffset + buffer->writeLength) ||
+	      (buffer->writeLength + Length > DRIVE_WRITE_BEHIND_SIZE))))
+	{
+		if (!write_behind_flush(buffer))
+			return FALSE;
+	}
+
+	/* other handles on the file must see the data right away */
+	if (buffer->shared || (Length >= DRIVE_WRITE_BEHIND_SIZE))
+	{
+		buffer->stats.writeFlushes++;
+		return direct_write(handle, Offset, data, Length);
+	}
+
+	if (!buffer->writeData)
+	{
+		buffer->writeData = malloc(DRIVE_WRITE_BEHIND_SIZE);
+		if (!buffer->writeData)
+			return direct_write(handle, Offset, data, Length);
+	}
+
+	if (buffer->writeLength == 0)
+	{
+		buffer->writeHandle = handle;
+		buffer->writeOffset = Offset;
+	}
+
+	memcpy(&buffer->writeData[buffer->writeLength], data, Length);
+	buffer->writeLength += Length;
+	return TRUE;
+}
+
+BOOL drive_file_buffer_write(DRIVE_FILE_BUFFER* buffer, HANDLE handle, UINT64 Offset,
+                             const BYTE* data, UINT32 Length)
+{
+	if (!buffer || !data)
+		return FALSE;
+
+	EnterCriticalSection(&buffer->lock);
+	const BOOL rc = buffer_write(buffer, handle, Offset, data, Length);
+	LeaveCriticalSection(&buffer->lock);
+	return rc;
+}
+
+BOOL drive_file_buffer_flush(DRIVE_FILE_BUFFER* buffer)
+{
+	if (!buffer)
+		return FALSE;
+
+	EnterCriticalSection(&buffer->lock);
+	const BOOL rc = write_behind_flush(buffer);
+	LeaveCriticalSection(&buffer->lock);
+	return rc;
+}
+
+BOOL drive_file_buffer_sync(DRIVE_FILE_BUFFER* buffer)
+{
+	if (!buffer)
+		return FALSE;
+
+	EnterCriticalSection(&buffer->lock);
+	const BOOL rc = buffer_sync(buffer);
+	LeaveCriticalSection(&buffer->lock);
+	return rc;
+}
+
+void drive_file_buffer_set_shared(DRIVE_FILE_BUFFER* buffer, BOOL shared)
+{
+	if (!buffer)
+		return;
+
+	EnterCriticalSection(&buffer->lock);
+	if (shared && !buffer->shared)
+	{
+		/* the error is reported by the next request on the handle that wrote the data */
+		if (!buffer_sync(buffer))
+			buffer->writeError = GetLastError();
+	}
+	buffer->shared = shared;
+	LeaveCriticalSection(&buffer->lock);
+}
+
+const DRIVE_FILE_IO_STATS* drive_file_buffer_stats(const DRIVE_FILE_BUFFER* buffer)
+{
+	if (!buffer)
+		return NULL;
+	return &buffer->stats;
+}
@@ -0,0 +1,70 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel, read-ahead and write-behind buffers
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_DRIVE_CLIENT_FILE_BUFFER_H
+#define FREERDP_CHANNEL_DRIVE_CLIENT_FILE_BUFFER_H
+
+#include <winpr/wtypes.h>
+
+typedef struct
+{
+	UINT64 reads;
+	UINT64 readHits;
+	UINT64 bytesRead;
+	UINT64 bytesReadAhead;
+	UINT64 writes;
+	UINT64 writeFlushes;
+	UINT64 bytesWritten;
+} DRIVE_FILE_IO_STATS;
+
+typedef struct s_drive_file_buffer DRIVE_FILE_BUFFER;
+
+DRIVE_FILE_BUFFER* drive_file_buffer_new(void);
+
+/** @brief Release the buffers, pending write-behind data is lost, call
+ * drive_file_buffer_flush first */
+void drive_file_buffer_free(DRIVE_FILE_BUFFER* buffer);
+
+/** @brief Read \b Length bytes at \b Offset, from the read-ahead window if possible.
+ *
+ *  Sequential reads open a second, overlapped handle on \b path and keep a window of reads in
+ *  flight ahead of the requests.
+ */
+BOOL drive_file_buffer_read(DRIVE_FILE_BUFFER* buffer, HANDLE handle, const WCHAR* path,
+                            UINT64 Offset, BYTE* data, UINT32* Length);
+
+/** @brief Write \b Length bytes at \b Offset, contiguous writes are coalesced in memory */
+BOOL drive_file_buffer_write(DRIVE_FILE_BUFFER* buffer, HANDLE handle, UINT64 Offset,
+                             const BYTE* data, UINT32 Length);
+
+/** @brief Write pending write-behind data to the handle it was written for */
+BOOL drive_file_buffer_flush(DRIVE_FILE_BUFFER* buffer);
+
+/** @brief Flush and drop the read-ahead window, required before the file is modified,
+ * renamed or closed by other means */
+BOOL drive_file_buffer_sync(DRIVE_FILE_BUFFER* buffer);
+
+/** @brief Turn buffering off while other handles are open on the same file.
+ *
+ *  Pending write-behind data is written first, a failure is reported by the next request of
+ *  the owning handle. Can be called from any thread.
+ */
+void drive_file_buffer_set_shared(DRIVE_FILE_BUFFER* buffer, BOOL shared);
+
+const DRIVE_FILE_IO_STATS* drive_file_buffer_stats(const DRIVE_FILE_BUFFER* buffer);
+
+#endif /* FREERDP_CHANNEL_DRIVE_CLIENT_FILE_BUFFER_H */
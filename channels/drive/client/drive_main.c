@@ -46,6 +46,17 @@
 
 #include "drive_file.h"
 
+#define DRIVE_IRP_WORKER_COUNT 4
+
+/* IRPs of one file handle, executed in the order they were received */
+typedef struct
+{
+	UINT32 FileId;
+	BOOL scheduled;
+	BOOL transient;
+	wQueue* irps;
+} DRIVE_IRP_STRAND;
+
 typedef struct
 {
 	DEVICE device;
@@ -54,10 +65,16 @@ typedef struct
 	BOOL automount;
 	UINT32 PathLength;
 	wListDictionary* files;
+	DRIVE_CACHE* cache;
 
-	HANDLE thread;
 	BOOL async;
-	wMessageQueue* IrpQueue;
+	BOOL stopping;
+	CRITICAL_SECTION lock;
+	wListDictionary* strands;
+	wQueue* ready;
+	HANDLE readySignal;
+	HANDLE threads[DRIVE_IRP_WORKER_COUNT];
+	size_t threadCount;
 
 	DEVMAN* devman;
 
@@ -173,9 +190,13 @@ static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
 		return ERROR_INVALID_DATA;
 
 	path = Stream_ConstPointer(irp->input);
-	FileId = irp->devman->id_sequence++;
+
+	/* creates run concurrently on the worker threads of all devices */
+	FileId = (UINT32)InterlockedIncrement((LONG volatile*)&irp->devman->id_sequence) - 1;
+
 	file = drive_file_new(drive->path, path, PathLength / sizeof(WCHAR), FileId, DesiredAccess,
-	                      CreateDisposition, CreateOptions, FileAttributes, SharedAccess);
+	                      CreateDisposition, CreateOptions, FileAttributes, SharedAccess,
+	                      drive->cache);
 
 	if (!file)
 	{
@@ -786,6 +807,147 @@ static BOOL drive_poll_run(DRIVE_DEVICE* drive, IRP* irp)
 	return TRUE;
 }
 
+static void drive_irp_discard(void* obj)
+{
+	IRP* irp = (IRP*)obj;
+	if (!irp)
+		return;
+	WINPR_ASSERT(irp->Discard);
+	irp->Discard(irp);
+}
+
+static void drive_strand_free(void* obj)
+{
+	DRIVE_IRP_STRAND* strand = (DRIVE_IRP_STRAND*)obj;
+	if (!strand)
+		return;
+	Queue_Clear(strand->irps);
+	Queue_Free(strand->irps);
+	free(strand);
+}
+
+static DRIVE_IRP_STRAND* drive_strand_new(UINT32 FileId, BOOL transient)
+{
+	DRIVE_IRP_STRAND* strand = (DRIVE_IRP_STRAND*)calloc(1, sizeof(DRIVE_IRP_STRAND));
+	if (!strand)
+		return NULL;
+
+	strand->FileId = FileId;
+	strand->transient = transient;
+	strand->irps = Queue_New(FALSE, 4, 4);
+	if (!strand->irps)
+	{
+		free(strand);
+		return NULL;
+	}
+
+	wObject* obj = Queue_Object(strand->irps);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = drive_irp_discard;
+	return strand;
+}
+
+/**
+ * Queue an IRP on the strand of its file handle.
+ *
+ * Requests for the same FileId run in order, requests for different FileIds run concurrently
+ * on the worker threads. Creates do not reference an existing handle and get a strand of
+ * their own.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drive_irp_enqueue(DRIVE_DEVICE* drive, IRP* irp)
+{
+	UINT error = CHANNEL_RC_OK;
+	DRIVE_IRP_STRAND* strand = NULL;
+	const BOOL transient = irp->MajorFunction == IRP_MJ_CREATE;
+	void* key = (void*)(size_t)irp->FileId;
+
+	WINPR_ASSERT(drive);
+
+	EnterCriticalSection(&drive->lock);
+	if (drive->stopping)
+	{
+		error = ERROR_INVALID_STATE;
+		goto out;
+	}
+
+	if (!transient)
+		strand = (DRIVE_IRP_STRAND*)ListDictionary_GetItemValue(drive->strands, key);
+
+	if (!strand)
+	{
+		strand = drive_strand_new(irp->FileId, transient);
+		if (!strand)
+		{
+			error = CHANNEL_RC_NO_MEMORY;
+			goto out;
+		}
+
+		if (!transient && !ListDictionary_Add(drive->strands, key, strand))
+		{
+			drive_strand_free(strand);
+			error = ERROR_INTERNAL_ERROR;
+			goto out;
+		}
+	}
+
+	if (!Queue_Enqueue(strand->irps, irp))
+	{
+		if (transient)
+			drive_strand_free(strand);
+		error = ERROR_INTERNAL_ERROR;
+		goto out;
+	}
+
+	if (!strand->scheduled)
+	{
+		strand->scheduled = TRUE;
+		if (!Queue_Enqueue(drive->ready, strand))
+		{
+			/* the IRP is owned by the strand now and discarded with it */
+			strand->scheduled = FALSE;
+			error = ERROR_INTERNAL_ERROR;
+			goto out;
+		}
+		(void)ReleaseSemaphore(drive->readySignal, 1, NULL);
+	}
+
+out:
+	LeaveCriticalSection(&drive->lock);
+	return error;
+}
+
+/**
+ * Return a strand after one of its IRPs was processed.
+ *
+ * Strands with pending IRPs are put at the end of the ready queue so a busy handle can not
+ * starve the others. Idle strands are released unless their FileId refers to an open file,
+ * so handles that were closed or never existed do not keep a strand around.
+ */
+static void drive_strand_release(DRIVE_DEVICE* drive, DRIVE_IRP_STRAND* strand)
+{
+	WINPR_ASSERT(drive);
+	WINPR_ASSERT(strand);
+
+	EnterCriticalSection(&drive->lock);
+	if ((Queue_Count(strand->irps) > 0) && Queue_Enqueue(drive->ready, strand))
+		(void)ReleaseSemaphore(drive->readySignal, 1, NULL);
+	else
+	{
+		strand->scheduled = FALSE;
+		if (strand->transient)
+			drive_strand_free(strand);
+		else
+		{
+			void* key = (void*)(size_t)strand->FileId;
+			if ((Queue_Count(strand->irps) == 0) && !ListDictionary_Contains(drive->files, key))
+				ListDictionary_Remove(drive->strands, key);
+		}
+	}
+	LeaveCriticalSection(&drive->lock);
+}
+
 static DWORD WINAPI drive_thread_func(LPVOID arg)
 {
 	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)arg;
@@ -799,29 +961,40 @@ static DWORD WINAPI drive_thread_func(LPVOID arg)
 
 	while (1)
 	{
-		if (!MessageQueue_Wait(drive->IrpQueue))
+		if (WaitForSingleObject(drive->readySignal, INFINITE) != WAIT_OBJECT_0)
 		{
-			WLog_ERR(TAG, "MessageQueue_Wait failed!");
+			WLog_ERR(TAG, "WaitForSingleObject failed!");
 			error = ERROR_INTERNAL_ERROR;
 			break;
 		}
 
-		if (MessageQueue_Size(drive->IrpQueue) < 1)
-			continue;
-
-		wMessage message = { 0 };
-		if (!MessageQueue_Peek(drive->IrpQueue, &message, TRUE))
+		EnterCriticalSection(&drive->lock);
+		DRIVE_IRP_STRAND* strand = NULL;
+		IRP* irp = NULL;
+		if (!drive->stopping)
 		{
-			WLog_ERR(TAG, "MessageQueue_Peek failed!");
-			continue;
+			strand = (DRIVE_IRP_STRAND*)Queue_Dequeue(drive->ready);
+			if (strand)
+				irp = (IRP*)Queue_Dequeue(strand->irps);
 		}
+		const BOOL stopping = drive->stopping;
+		LeaveCriticalSection(&drive->lock);
 
-		if (message.id == WMQ_QUIT)
+		if (stopping)
 			break;
+		if (!strand)
+			continue;
 
-		IRP* irp = (IRP*)message.wParam;
-		if (!drive_poll_run(drive, irp))
+		BOOL rc = TRUE;
+		if (irp)
+			rc = drive_poll_run(drive, irp);
+
+		drive_strand_release(drive, strand);
+		if (!rc)
+		{
+			error = ERROR_INTERNAL_ERROR;
 			break;
+		}
 	}
 
 fail:
@@ -842,15 +1015,16 @@ static UINT drive_irp_request(DEVICE* device, IRP* irp)
 {
 	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)device;
 
-	if (!drive)
+	if (!drive || !irp)
 		return ERROR_INVALID_PARAMETER;
 
 	if (drive->async)
 	{
-		if (!MessageQueue_Post(drive->IrpQueue, NULL, 0, (void*)irp, NULL))
+		const UINT error = drive_irp_enqueue(drive, irp);
+		if (error)
 		{
-			WLog_ERR(TAG, "MessageQueue_Post failed!");
-			return ERROR_INTERNAL_ERROR;
+			WLog_ERR(TAG, "drive_irp_enqueue failed with error %" PRIu32 "!", error);
+			return error;
 		}
 	}
 	else
@@ -869,9 +1043,24 @@ static UINT drive_free_int(DRIVE_DEVICE* drive)
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	(void)CloseHandle(drive->thread);
+	for (size_t x = 0; x < drive->threadCount; x++)
+		(void)CloseHandle(drive->threads[x]);
+
+	/* strands still in the ready queue are owned by the dictionary or transient */
+	while (drive->ready && (Queue_Count(drive->ready) > 0))
+	{
+		DRIVE_IRP_STRAND* strand = (DRIVE_IRP_STRAND*)Queue_Dequeue(drive->ready);
+		if (strand && strand->transient)
+			drive_strand_free(strand);
+	}
+
+	Queue_Free(drive->ready);
+	ListDictionary_Free(drive->strands);
 	ListDictionary_Free(drive->files);
-	MessageQueue_Free(drive->IrpQueue);
+	drive_cache_free(drive->cache);
+	if (drive->readySignal)
+		(void)CloseHandle(drive->readySignal);
+	DeleteCriticalSection(&drive->lock);
 	Stream_Free(drive->device.data, TRUE);
 	free(drive->path);
 	free(drive);
@@ -891,12 +1080,21 @@ static UINT drive_free(DEVICE* device)
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	if (MessageQueue_PostQuit(drive->IrpQueue, 0) &&
-	    (WaitForSingleObject(drive->thread, INFINITE) == WAIT_FAILED))
+	/* IRPs in flight complete, queued ones are discarded with their strands */
+	EnterCriticalSection(&drive->lock);
+	drive->stopping = TRUE;
+	LeaveCriticalSection(&drive->lock);
+
+	if (drive->threadCount > 0)
 	{
-		error = GetLastError();
-		WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
-		return error;
+		(void)ReleaseSemaphore(drive->readySignal, (LONG)drive->threadCount, NULL);
+		if (WaitForMultipleObjects((DWORD)drive->threadCount, drive->threads, TRUE, INFINITE) ==
+		    WAIT_FAILED)
+		{
+			error = GetLastError();
+			WLog_ERR(TAG, "WaitForMultipleObjects failed with error %" PRIu32 "", error);
+			return error;
+		}
 	}
 
 	return drive_free_int(drive);
@@ -910,21 +1108,6 @@ static void drive_file_objfree(void* obj)
 	drive_file_free((DRIVE_FILE*)obj);
 }
 
-static void drive_message_free(void* obj)
-{
-	wMessage* msg = obj;
-	if (!msg)
-		return;
-	if (msg->id != 0)
-		return;
-
-	IRP* irp = (IRP*)msg->wParam;
-	if (!irp)
-		return;
-	WINPR_ASSERT(irp->Discard);
-	irp->Discard(irp);
-}
-
 /**
  * Function description
  *
@@ -955,6 +1138,7 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 			return CHANNEL_RC_NO_MEMORY;
 		}
 
+		InitializeCriticalSection(&drive->lock);
 		drive->device.type = RDPDR_DTYP_FILESYSTEM;
 		drive->device.IRPRequest = drive_irp_request;
 		drive->device.Free = drive_free;
@@ -1016,18 +1200,42 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 		}
 
 		ListDictionary_ValueObject(drive->files)->fnObjectFree = drive_file_objfree;
-		drive->IrpQueue = MessageQueue_New(NULL);
+		drive->cache = drive_cache_new();
+
+		if (!drive->cache)
+		{
+			WLog_ERR(TAG, "drive_cache_new failed!");
+			error = CHANNEL_RC_NO_MEMORY;
+			goto out_error;
+		}
+
+		drive->strands = ListDictionary_New(FALSE);
 
-		if (!drive->IrpQueue)
+		if (!drive->strands)
 		{
 			WLog_ERR(TAG, "ListDictionary_New failed!");
 			error = CHANNEL_RC_NO_MEMORY;
 			goto out_error;
 		}
 
-		wObject* obj = MessageQueue_Object(drive->IrpQueue);
-		WINPR_ASSERT(obj);
-		obj->fnObjectFree = drive_message_free;
+		ListDictionary_ValueObject(drive->strands)->fnObjectFree = drive_strand_free;
+		drive->ready = Queue_New(FALSE, -1, -1);
+
+		if (!drive->ready)
+		{
+			WLog_ERR(TAG, "Queue_New failed!");
+			error = CHANNEL_RC_NO_MEMORY;
+			goto out_error;
+		}
+
+		drive->readySignal = CreateSemaphore(NULL, 0, INT32_MAX, NULL);
+
+		if (!drive->readySignal)
+		{
+			WLog_ERR(TAG, "CreateSemaphore failed!");
+			error = ERROR_INTERNAL_ERROR;
+			goto out_error;
+		}
 
 		if ((error = pEntryPoints->RegisterDevice(pEntryPoints->devman, (DEVICE*)drive)))
 		{
@@ -1039,20 +1247,26 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 		                                          FreeRDP_SynchronousStaticChannels);
 		if (drive->async)
 		{
-			if (!(drive->thread =
-			          CreateThread(NULL, 0, drive_thread_func, drive, CREATE_SUSPENDED, NULL)))
+			for (size_t x = 0; x < ARRAYSIZE(drive->threads); x++)
 			{
-				WLog_ERR(TAG, "CreateThread failed!");
-				goto out_error;
-			}
+				drive->threads[x] =
+				    CreateThread(NULL, 0, drive_thread_func, drive, CREATE_SUSPENDED, NULL);
+				if (!drive->threads[x])
+				{
+					WLog_ERR(TAG, "CreateThread failed!");
+					error = ERROR_INTERNAL_ERROR;
+					goto out_error;
+				}
 
-			ResumeThread(drive->thread);
+				drive->threadCount++;
+				ResumeThread(drive->threads[x]);
+			}
 		}
 	}
 
 	return CHANNEL_RC_OK;
 out_error:
-	drive_free_int(drive);
+	(void)drive_free(&drive->device);
 	return error;
 }
 
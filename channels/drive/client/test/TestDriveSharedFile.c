@@ -0,0 +1,194 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/stream.h>
+#include <winpr/sysinfo.h>
+
+#include "drive_cache.h"
+#include "drive_file.h"
+
+#define TEST_BLOCK_SIZE 4096
+
+static char* create_name(const char* prefix)
+{
+	char sname[8192] = { 0 };
+	SYSTEMTIME systemTime = { 0 };
+
+	GetSystemTime(&systemTime);
+	(void)sprintf_s(sname, sizeof(sname),
+	                "%s-%04" PRIu16 "%02" PRIu16 "%02" PRIu16 "%02" PRIu16 "%02" PRIu16
+	                "%02" PRIu16 "%04" PRIu16 "-%" PRIu32,
+	                prefix, systemTime.wYear, systemTime.wMonth, systemTime.wDay,
+	                systemTime.wHour, systemTime.wMinute, systemTime.wSecond,
+	                systemTime.wMilliseconds, GetCurrentProcessId());
+	return GetKnownSubPath(KNOWN_PATH_TEMP, sname);
+}
+
+static DRIVE_FILE* open_file(const WCHAR* base, DRIVE_CACHE* cache, UINT32 id,
+                             UINT32 CreateDisposition)
+{
+	WCHAR path[32] = { 0 };
+	(void)ConvertUtf8ToWChar("\\shared.bin", path, ARRAYSIZE(path));
+
+	return drive_file_new(base, path, (UINT32)_wcslen(path) + 1, id, GENERIC_READ | GENERIC_WRITE,
+	                      CreateDisposition, FILE_NON_DIRECTORY_FILE, FILE_ATTRIBUTE_NORMAL,
+	                      FILE_SHARE_READ | FILE_SHARE_WRITE, cache);
+}
+
+static BOOL write_block(DRIVE_FILE* file, UINT32 block, BYTE value)
+{
+	BYTE data[TEST_BLOCK_SIZE] = { 0 };
+
+	memset(data, value, sizeof(data));
+	return drive_file_seek(file, 1ull * block * TEST_BLOCK_SIZE) &&
+	       drive_file_write(file, data, sizeof(data));
+}
+
+static BOOL check_block(DRIVE_FILE* file, UINT32 block, BYTE value)
+{
+	BYTE data[TEST_BLOCK_SIZE] = { 0 };
+	UINT32 length = sizeof(data);
+
+	if (!drive_file_seek(file, 1ull * block * TEST_BLOCK_SIZE) ||
+	    !drive_file_read(file, data, &length))
+		return FALSE;
+
+	if (length != sizeof(data))
+	{
+		printf("block %" PRIu32 ": read %" PRIu32 " bytes\n", block, length);
+		return FALSE;
+	}
+
+	for (size_t x = 0; x < length; x++)
+	{
+		if (data[x] != value)
+		{
+			printf("block %" PRIu32 ": got 0x%02" PRIx8 ", expected 0x%02" PRIx8 "\n", block,
+			       data[x], value);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL check_size(DRIVE_FILE* file, UINT32 blocks)
+{
+	BOOL rc = FALSE;
+	UINT32 length = 0;
+	UINT64 allocationSize = 0;
+	UINT64 endOfFile = 0;
+	wStream* s = Stream_New(NULL, 64);
+
+	if (!s || !drive_file_query_information(file, FileStandardInformation, s))
+		goto fail;
+
+	Stream_SealLength(s);
+	Stream_SetPosition(s, 0);
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, 20))
+		goto fail;
+
+	Stream_Read_UINT32(s, length);
+	Stream_Read_UINT64(s, allocationSize);
+	Stream_Read_UINT64(s, endOfFile);
+	WINPR_UNUSED(length);
+	WINPR_UNUSED(allocationSize);
+
+	rc = endOfFile == 1ull * blocks * TEST_BLOCK_SIZE;
+	if (!rc)
+		printf("size %" PRIu64 ", expected %" PRIu32 " blocks\n", endOfFile, blocks);
+fail:
+	Stream_Free(s, TRUE);
+	return rc;
+}
+
+/* writes and reads of two handles on one file must see each other, the read-ahead and
+ * write-behind buffers are only used while a single handle is open */
+static BOOL test_two_handles(const WCHAR* base)
+{
+	BOOL rc = FALSE;
+	DRIVE_FILE* first = NULL;
+	DRIVE_FILE* second = NULL;
+	DRIVE_CACHE* cache = drive_cache_new();
+
+	if (!cache)
+		goto fail;
+
+	first = open_file(base, cache, 1, FILE_OVERWRITE_IF);
+	if (!first)
+		goto fail;
+
+	for (UINT32 x = 0; x < 4; x++)
+	{
+		if (!write_block(first, x, 0x11))
+			goto fail;
+	}
+
+	/* sequential reads start the read-ahead window of the first handle */
+	for (UINT32 x = 0; x < 3; x++)
+	{
+		if (!check_block(first, x, 0x11))
+			goto fail;
+	}
+
+	if (!check_size(first, 4) || !write_block(first, 4, 0x22))
+		goto fail;
+
+	/* the data the first handle still buffers must be visible right away */
+	second = open_file(base, cache, 2, FILE_OPEN);
+	if (!second || !check_block(second, 4, 0x22) || !check_size(second, 5))
+		goto fail;
+
+	if (!write_block(second, 3, 0x33) || !check_block(first, 3, 0x33))
+		goto fail;
+
+	if (!write_block(first, 5, 0x44) || !check_size(second, 6) || !check_block(second, 5, 0x44))
+		goto fail;
+
+	/* a single handle is buffered again */
+	if (!drive_file_free(second))
+	{
+		second = NULL;
+		goto fail;
+	}
+	second = NULL;
+
+	if (!write_block(first, 6, 0x55) || !check_size(first, 7) || !check_block(first, 6, 0x55))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		printf("%s failed\n", __func__);
+	drive_file_free(second);
+	drive_file_free(first);
+	drive_cache_free(cache);
+	return rc;
+}
+
+int TestDriveSharedFile(int argc, char* argv[])
+{
+	int rc = -1;
+	WCHAR* base = NULL;
+	char* name = create_name("TestDriveSharedFile");
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!name || !winpr_PathMakePath(name, NULL))
+		goto fail;
+
+	base = ConvertUtf8ToWCharAlloc(name, NULL);
+	if (!base || !test_two_handles(base))
+		goto fail;
+
+	rc = 0;
+fail:
+	if (name)
+		winpr_RemoveDirectory_RecursiveA(name);
+	free(base);
+	free(name);
+	return rc;
+}
@@ -100,7 +100,7 @@ static UINT parallel_process_irp_create(PARALLEL_DEVICE* parallel, IRP* irp)
 	if (!path)
 		return CHANNEL_RC_NO_MEMORY;
 
-	parallel->id = irp->devman->id_sequence++;
+	parallel->id = (UINT32)InterlockedIncrement((LONG volatile*)&irp->devman->id_sequence) - 1;
 	parallel->file = open(parallel->path, O_RDWR);
 
 	if (parallel->file < 0)
@@ -464,8 +464,9 @@ static UINT printer_process_irp_create(PRINTER_DEVICE* printer_dev, IRP* irp)
 	if (printer_dev->printer)
 	{
 		WINPR_ASSERT(printer_dev->printer->CreatePrintJob);
-		printjob =
-		    printer_dev->printer->CreatePrintJob(printer_dev->printer, irp->devman->id_sequence++);
+		const UINT32 id =
+		    (UINT32)InterlockedIncrement((LONG volatile*)&irp->devman->id_sequence) - 1;
+		printjob = printer_dev->printer->CreatePrintJob(printer_dev->printer, id);
 	}
 
 	if (printjob)
@@ -29,6 +29,7 @@
 
 #include <winpr/crt.h>
 #include <winpr/stream.h>
+#include <winpr/interlocked.h>
 
 #include <freerdp/types.h>
 #include <freerdp/addin.h>
@@ -112,7 +113,7 @@ static UINT devman_register_device(DEVMAN* devman, DEVICE* device)
 	if (!devman || !device)
 		return ERROR_INVALID_PARAMETER;
 
-	device->id = devman->id_sequence++;
+	device->id = (UINT32)InterlockedIncrement((LONG volatile*)&devman->id_sequence) - 1;
 	key = (void*)(size_t)device->id;
 
 	if (!ListDictionary_Add(devman->devices, key, device))
@@ -29,6 +29,7 @@
 #include <winpr/crt.h>
 #include <winpr/wlog.h>
 #include <winpr/print.h>
+#include <winpr/string.h>
 #include <winpr/synch.h>
 #include <winpr/thread.h>
 #include <winpr/stream.h>
@@ -46,6 +47,11 @@
 
 #define TAG CHANNELS_TAG("rdpgfx.client")
 
+/* Twice the entries of an import offer, so that the offer is still full after the store dropped
+ * the least recently used half of the entries */
+#define RDPGFX_PERSISTENT_STORE_MAX_ENTRIES (2 * RDPGFX_CACHE_ENTRY_MAX_COUNT)
+#define RDPGFX_PERSISTENT_STORE_MAX_SIZE (256ull * 1024ull * 1024ull)
+
 static BOOL delete_surface(const void* key, void* value, void* arg)
 {
 	const UINT16 id = (UINT16)(uintptr_t)(key);
@@ -595,6 +601,68 @@ static UINT rdpgfx_recv_reset_graphics_pdu(GENERIC_CHANNEL_CALLBACK* callback, w
 	return error;
 }
 
+static void rdpgfx_drop_pending_import(RDPGFX_PLUGIN* gfx, UINT16 cacheSlot)
+{
+	WINPR_ASSERT(gfx);
+
+	if ((cacheSlot > 0) && (cacheSlot <= gfx->MaxCacheSlots))
+		gfx->PendingImports[cacheSlot - 1] = 0;
+}
+
+/**
+ * Imported entries of the persistent store are only loaded when the server first uses them.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_load_pending_import(RDPGFX_PLUGIN* gfx, UINT16 cacheSlot)
+{
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+	WINPR_ASSERT(gfx);
+	RdpgfxClientContext* context = gfx->context;
+
+	if (!gfx->store || (cacheSlot == 0) || (cacheSlot > gfx->MaxCacheSlots))
+		return CHANNEL_RC_OK;
+
+	const UINT32 pending = gfx->PendingImports[cacheSlot - 1];
+	if (pending == 0)
+		return CHANNEL_RC_OK;
+
+	gfx->PendingImports[cacheSlot - 1] = 0;
+
+	if (!persistent_cache_store_read_entry(gfx->store, pending - 1, &entry))
+		return ERROR_INVALID_DATA;
+
+	(void)persistent_cache_store_touch(gfx->store, pending - 1);
+
+	if (!context || !context->ImportCacheEntry)
+		return CHANNEL_RC_OK;
+
+	return context->ImportCacheEntry(context, cacheSlot, &entry);
+}
+
+/* Append a cache slot the server just filled to the persistent store */
+static void rdpgfx_store_cache_slot(RDPGFX_PLUGIN* gfx, UINT16 cacheSlot)
+{
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+	WINPR_ASSERT(gfx);
+	RdpgfxClientContext* context = gfx->context;
+
+	if (!gfx->store || !context || !context->ExportCacheEntry)
+		return;
+
+	if (context->ExportCacheEntry(context, cacheSlot, &entry) != CHANNEL_RC_OK)
+		return;
+
+	const SSIZE_T index = persistent_cache_store_find(gfx->store, entry.key64);
+	if (index >= 0)
+		(void)persistent_cache_store_touch(gfx->store, (size_t)index);
+	else if (persistent_cache_store_write_entry(gfx->store, &entry) < 0)
+		WLog_Print(gfx->log, WLOG_WARN, "storing cache entry 0x%016" PRIX64 " failed",
+		           entry.key64);
+}
+
 /**
  * Function description
  *
@@ -616,6 +684,8 @@ static UINT rdpgfx_recv_evict_cache_entry_pdu(GENERIC_CHANNEL_CALLBACK* callback
 	WLog_Print(gfx->log, WLOG_DEBUG, "RecvEvictCacheEntryPdu: cacheSlot: %" PRIu16 "",
 	           pdu.cacheSlot);
 
+	rdpgfx_drop_pending_import(gfx, pdu.cacheSlot);
+
 	if (context)
 	{
 		IFCALLRET(context->EvictCacheEntry, error, context, &pdu);
@@ -654,6 +724,10 @@ static UINT rdpgfx_save_persistent_cache(RDPGFX_PLUGIN* gfx)
 	if (!BitmapCachePersistFile)
 		return CHANNEL_RC_OK;
 
+	/* the store was written entry by entry */
+	if (gfx->store)
+		return persistent_cache_store_flush(gfx->store) ? CHANNEL_RC_OK : ERROR_WRITE_FAULT;
+
 	if (!context->ExportCacheEntry)
 		return CHANNEL_RC_INITIALIZATION_ERROR;
 
@@ -756,6 +830,122 @@ fail:
 	return error;
 }
 
+static BOOL rdpgfx_open_persistent_store(RDPGFX_PLUGIN* gfx, const char* BitmapCachePersistFile)
+{
+	char* filename = NULL;
+	size_t len = 0;
+
+	WINPR_ASSERT(gfx);
+	WINPR_ASSERT(BitmapCachePersistFile);
+
+	if (gfx->store)
+		return TRUE;
+
+	if (winpr_asprintf(&filename, &len, "%s.store", BitmapCachePersistFile) < 0)
+		return FALSE;
+
+	gfx->store = persistent_cache_store_new(filename, RDPGFX_PERSISTENT_STORE_MAX_ENTRIES,
+	                                        RDPGFX_PERSISTENT_STORE_MAX_SIZE);
+	if (!gfx->store)
+		WLog_Print(gfx->log, WLOG_WARN, "%s not available, using %s", filename,
+		           BitmapCachePersistFile);
+
+	free(filename);
+	return gfx->store != NULL;
+}
+
+/**
+ * Offer the most recently used entries of the store. Only the index of the store is read, the
+ * bitmaps of the entries the server imports are loaded on first use.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_send_store_offer(RDPGFX_PLUGIN* gfx)
+{
+	UINT error = CHANNEL_RC_OK;
+
+	WINPR_ASSERT(gfx);
+	WINPR_ASSERT(gfx->store);
+
+	const size_t max = MIN(RDPGFX_CACHE_ENTRY_MAX_COUNT - 1, gfx->MaxCacheSlots);
+	const size_t count = persistent_cache_store_get_recent(gfx->store, gfx->OfferedEntries, max);
+
+	gfx->OfferedCount = 0;
+	if (count == 0)
+		return CHANNEL_RC_OK;
+
+	RDPGFX_CACHE_IMPORT_OFFER_PDU* offer =
+	    (RDPGFX_CACHE_IMPORT_OFFER_PDU*)calloc(1, sizeof(RDPGFX_CACHE_IMPORT_OFFER_PDU));
+	if (!offer)
+		return CHANNEL_RC_NO_MEMORY;
+
+	offer->cacheEntriesCount = (UINT16)count;
+
+	for (size_t idx = 0; idx < count; idx++)
+	{
+		PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+		if (!persistent_cache_store_read_entry(gfx->store, gfx->OfferedEntries[idx], &entry))
+		{
+			error = ERROR_INVALID_DATA;
+			goto fail;
+		}
+
+		offer->cacheEntries[idx].cacheKey = entry.key64;
+		offer->cacheEntries[idx].bitmapLength = entry.size;
+	}
+
+	WLog_DBG(TAG, "Sending Cache Import Offer: %" PRIuz, count);
+
+	error = rdpgfx_send_cache_import_offer_pdu(gfx->context, offer);
+	if (error != CHANNEL_RC_OK)
+	{
+		WLog_Print(gfx->log, WLOG_ERROR, "Failed to send cache import offer PDU");
+		goto fail;
+	}
+
+	gfx->OfferedCount = offer->cacheEntriesCount;
+
+fail:
+	free(offer);
+	return error;
+}
+
+/**
+ * Offer the cache retained from the last connection if the server confirmed the same caps.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_send_retained_offer(RDPGFX_PLUGIN* gfx, BOOL* sent)
+{
+	UINT error = CHANNEL_RC_OK;
+
+	WINPR_ASSERT(gfx);
+	WINPR_ASSERT(sent);
+
+	*sent = FALSE;
+	if (!gfx->retained || (rdpgfx_retained_cache_count(gfx->retained) == 0))
+		return CHANNEL_RC_OK;
+
+	RDPGFX_CACHE_IMPORT_OFFER_PDU* offer =
+	    (RDPGFX_CACHE_IMPORT_OFFER_PDU*)calloc(1, sizeof(RDPGFX_CACHE_IMPORT_OFFER_PDU));
+	if (!offer)
+		return CHANNEL_RC_NO_MEMORY;
+
+	if (rdpgfx_retained_cache_offer(gfx->retained, &gfx->ConnectionCaps, offer))
+	{
+		WLog_DBG(TAG, "Sending Cache Import Offer of the retained cache: %" PRIu16,
+		         offer->cacheEntriesCount);
+		error = rdpgfx_send_cache_import_offer_pdu(gfx->context, offer);
+		if (error != CHANNEL_RC_OK)
+			rdpgfx_retained_cache_clear(gfx->retained);
+		*sent = TRUE;
+	}
+
+	free(offer);
+	return error;
+}
+
 /**
  * Function description
  *
@@ -775,6 +965,11 @@ static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
 	RdpgfxClientContext* context = gfx->context;
 	rdpSettings* settings = gfx->rdpcontext->settings;
 
+	BOOL sent = FALSE;
+	error = rdpgfx_send_retained_offer(gfx, &sent);
+	if (sent)
+		return error;
+
 	if (!freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled))
 		return CHANNEL_RC_OK;
 
@@ -783,6 +978,9 @@ static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
 	if (!BitmapCachePersistFile)
 		return CHANNEL_RC_OK;
 
+	if (rdpgfx_open_persistent_store(gfx, BitmapCachePersistFile))
+		return rdpgfx_send_store_offer(gfx);
+
 	persistent = persistent_cache_new();
 
 	if (!persistent)
@@ -853,6 +1051,35 @@ fail:
 	return error;
 }
 
+/**
+ * Remember the slots the offered store entries were imported to, they are loaded on first use.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_store_import_reply(RDPGFX_PLUGIN* gfx,
+                                      const RDPGFX_CACHE_IMPORT_REPLY_PDU* reply)
+{
+	WINPR_ASSERT(gfx);
+	WINPR_ASSERT(reply);
+
+	const UINT16 count = MIN(gfx->OfferedCount, reply->importedEntriesCount);
+
+	WLog_DBG(TAG, "Receiving Cache Import Reply: %" PRIu16, count);
+
+	for (UINT16 idx = 0; idx < count; idx++)
+	{
+		const UINT16 cacheSlot = reply->cacheSlots[idx];
+
+		if ((cacheSlot == 0) || (cacheSlot > gfx->MaxCacheSlots))
+			continue;
+
+		gfx->PendingImports[cacheSlot - 1] = (UINT32)gfx->OfferedEntries[idx] + 1;
+	}
+
+	gfx->OfferedCount = 0;
+	return CHANNEL_RC_OK;
+}
+
 /**
  * Function description
  *
@@ -871,6 +1098,14 @@ static UINT rdpgfx_load_cache_import_reply(RDPGFX_PLUGIN* gfx,
 
 	WINPR_ASSERT(settings);
 	WINPR_ASSERT(reply);
+
+	if (gfx->retained && rdpgfx_retained_cache_is_offered(gfx->retained))
+	{
+		if (!context)
+			return ERROR_BAD_CONFIGURATION;
+		return rdpgfx_retained_cache_import(gfx->retained, context, reply);
+	}
+
 	if (!freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled))
 		return CHANNEL_RC_OK;
 
@@ -879,6 +1114,9 @@ static UINT rdpgfx_load_cache_import_reply(RDPGFX_PLUGIN* gfx,
 	if (!BitmapCachePersistFile)
 		return CHANNEL_RC_OK;
 
+	if (gfx->store)
+		return rdpgfx_store_import_reply(gfx, reply);
+
 	persistent = persistent_cache_new();
 
 	if (!persistent)
@@ -1569,6 +1807,8 @@ static UINT rdpgfx_recv_surface_to_cache_pdu(GENERIC_CHANNEL_CALLBACK* callback,
 	             pdu.surfaceId, pdu.cacheKey, pdu.cacheSlot, pdu.rectSrc.left, pdu.rectSrc.top,
 	             pdu.rectSrc.right, pdu.rectSrc.bottom);
 
+	rdpgfx_drop_pending_import(gfx, pdu.cacheSlot);
+
 	if (context)
 	{
 		IFCALLRET(context->SurfaceToCache, error, context, &pdu);
@@ -1576,6 +1816,8 @@ static UINT rdpgfx_recv_surface_to_cache_pdu(GENERIC_CHANNEL_CALLBACK* callback,
 		if (error)
 			WLog_Print(gfx->log, WLOG_ERROR,
 			           "context->SurfaceToCache failed with error %" PRIu32 "", error);
+		else
+			rdpgfx_store_cache_slot(gfx, pdu.cacheSlot);
 	}
 
 	return error;
@@ -1633,6 +1875,14 @@ static UINT rdpgfx_recv_cache_to_surface_pdu(GENERIC_CHANNEL_CALLBACK* callback,
 	             " destPtsCount: %" PRIu16 "",
 	             pdu.cacheSlot, pdu.surfaceId, pdu.destPtsCount);
 
+	if ((error = rdpgfx_load_pending_import(gfx, pdu.cacheSlot)))
+	{
+		WLog_Print(gfx->log, WLOG_ERROR,
+		           "rdpgfx_load_pending_import failed with error %" PRIu32 "", error);
+		free(pdu.destPts);
+		return error;
+	}
+
 	if (context)
 	{
 		IFCALLRET(context->CacheToSurface, error, context, &pdu);
@@ -2086,6 +2336,33 @@ static UINT rdpgfx_on_open(IWTSVirtualChannelCallback* pChannelCallback)
 	return error;
 }
 
+/* Keep a copy of the cache when the connection is lost, the slots themselves are released with
+ * the surfaces. The persistent store already holds all entries if it is in use. */
+static void rdpgfx_retain_cache(RDPGFX_PLUGIN* gfx)
+{
+	WINPR_ASSERT(gfx);
+	WINPR_ASSERT(gfx->rdpcontext);
+
+	RdpgfxClientContext* context = gfx->context;
+	rdpSettings* settings = gfx->rdpcontext->settings;
+
+	if (gfx->retained)
+		rdpgfx_retained_cache_clear(gfx->retained);
+
+	if (!context || gfx->store ||
+	    !freerdp_settings_get_bool(settings, FreeRDP_AutoReconnectionEnabled) ||
+	    freerdp_shall_disconnect_context(gfx->rdpcontext))
+		return;
+
+	if (!gfx->retained)
+		gfx->retained = rdpgfx_retained_cache_new();
+
+	if (gfx->retained &&
+	    !rdpgfx_retained_cache_save(gfx->retained, context, &gfx->ConnectionCaps,
+	                                gfx->MaxCacheSlots))
+		WLog_Print(gfx->log, WLOG_WARN, "failed to retain the cache for a reconnect");
+}
+
 /**
  * Function description
  *
@@ -2113,8 +2390,12 @@ static UINT rdpgfx_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 		           "rdpgfx_save_persistent_cache failed with error %" PRIu32 "", error);
 	}
 
+	rdpgfx_retain_cache(gfx);
+
 	free_surfaces(context, gfx->SurfaceTable);
 	evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
+	ZeroMemory(gfx->PendingImports, sizeof(gfx->PendingImports));
+	gfx->OfferedCount = 0;
 
 	free(callback);
 	gfx->UnacknowledgedFrames = 0;
@@ -2271,7 +2552,7 @@ static UINT init_plugin_cb(GENERIC_DYNVC_PLUGIN* base, rdpContext* rcontext,
 	gfx->log = WLog_Get(TAG);
 
 	gfx->SurfaceTable = HashTable_New(TRUE);
-	if (!gfx->SurfaceTable)
+	if (!gfx->SurfaceTable || !HashTable_SetReadMostly(gfx->SurfaceTable, TRUE))
 	{
 		WLog_ERR(TAG, "HashTable_New for surfaces failed !");
 		return CHANNEL_RC_NO_MEMORY;
@@ -2336,6 +2617,11 @@ void rdpgfx_client_context_free(RdpgfxClientContext* context)
 		gfx->zgfx = NULL;
 	}
 
+	persistent_cache_store_free(gfx->store);
+	gfx->store = NULL;
+	rdpgfx_retained_cache_free(gfx->retained);
+	gfx->retained = NULL;
+
 	HashTable_Free(gfx->SurfaceTable);
 	free(context);
 }
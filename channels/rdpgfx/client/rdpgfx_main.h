@@ -34,6 +34,8 @@
 #include <freerdp/cache/persistent.h>
 #include <freerdp/freerdp.h>
 
+#include "rdpgfx_retain.h"
+
 typedef struct
 {
 	GENERIC_DYNVC_PLUGIN base;
@@ -51,6 +53,12 @@ typedef struct
 	void* CacheSlots[25600];
 	rdpPersistentCache* persistent;
 
+	rdpPersistentCacheStore* store;
+	UINT32 PendingImports[25600]; /* store index + 1 of imported but not yet loaded entries */
+	size_t OfferedEntries[RDPGFX_CACHE_ENTRY_MAX_COUNT];
+	UINT16 OfferedCount;
+	RDPGFX_RETAINED_CACHE* retained;
+
 	rdpContext* rdpcontext;
 
 	wLog* log;
@@ -0,0 +1,173 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Graphics Pipeline Extension, cache retained across reconnects
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+
+#include <freerdp/channels/log.h>
+
+#include "rdpgfx_retain.h"
+
+#define TAG CHANNELS_TAG("rdpgfx.client")
+
+struct s_rdpgfx_retained_cache
+{
+	RDPGFX_CAPSET caps;
+	size_t count;
+	size_t offered;
+	PERSISTENT_CACHE_ENTRY entries[RDPGFX_CACHE_ENTRY_MAX_COUNT - 1];
+};
+
+RDPGFX_RETAINED_CACHE* rdpgfx_retained_cache_new(void)
+{
+	return calloc(1, sizeof(RDPGFX_RETAINED_CACHE));
+}
+
+void rdpgfx_retained_cache_free(RDPGFX_RETAINED_CACHE* cache)
+{
+	if (!cache)
+		return;
+
+	rdpgfx_retained_cache_clear(cache);
+	free(cache);
+}
+
+void rdpgfx_retained_cache_clear(RDPGFX_RETAINED_CACHE* cache)
+{
+	WINPR_ASSERT(cache);
+
+	for (size_t x = 0; x < cache->count; x++)
+		winpr_aligned_free(cache->entries[x].data);
+
+	const PERSISTENT_CACHE_ENTRY empty = { 0 };
+	for (size_t x = 0; x < cache->count; x++)
+		cache->entries[x] = empty;
+
+	cache->count = 0;
+	cache->offered = 0;
+}
+
+size_t rdpgfx_retained_cache_count(const RDPGFX_RETAINED_CACHE* cache)
+{
+	WINPR_ASSERT(cache);
+	return cache->count;
+}
+
+BOOL rdpgfx_retained_cache_save(RDPGFX_RETAINED_CACHE* cache, RdpgfxClientContext* context,
+                                const RDPGFX_CAPSET* caps, UINT16 maxCacheSlots)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(caps);
+
+	rdpgfx_retained_cache_clear(cache);
+	cache->caps = *caps;
+
+	if (!context->ExportCacheEntry)
+		return FALSE;
+
+	for (UINT32 slot = 1; (slot <= maxCacheSlots) && (cache->count < ARRAYSIZE(cache->entries));
+	     slot++)
+	{
+		PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+		if (context->ExportCacheEntry(context, (UINT16)slot, &entry) != CHANNEL_RC_OK)
+			continue;
+
+		if ((entry.size == 0) || !entry.data)
+			continue;
+
+		BYTE* data = winpr_aligned_malloc(entry.size, 32);
+		if (!data)
+		{
+			rdpgfx_retained_cache_clear(cache);
+			return FALSE;
+		}
+
+		memcpy(data, entry.data, entry.size);
+		entry.data = data;
+		cache->entries[cache->count++] = entry;
+	}
+
+	WLog_DBG(TAG, "retained %" PRIuz " cache entries for a reconnect", cache->count);
+	return TRUE;
+}
+
+BOOL rdpgfx_retained_cache_offer(RDPGFX_RETAINED_CACHE* cache, const RDPGFX_CAPSET* caps,
+                                 RDPGFX_CACHE_IMPORT_OFFER_PDU* offer)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(caps);
+	WINPR_ASSERT(offer);
+
+	/* the cache keys do not depend on the session, but on what the server was allowed to
+	 * cache with the confirmed capabilities */
+	if ((cache->count == 0) || (cache->caps.version != caps->version) ||
+	    (cache->caps.flags != caps->flags))
+	{
+		rdpgfx_retained_cache_clear(cache);
+		return FALSE;
+	}
+
+	for (size_t x = 0; x < cache->count; x++)
+	{
+		offer->cacheEntries[x].cacheKey = cache->entries[x].key64;
+		offer->cacheEntries[x].bitmapLength = cache->entries[x].size;
+	}
+
+	offer->cacheEntriesCount = (UINT16)cache->count;
+	cache->offered = cache->count;
+	return TRUE;
+}
+
+BOOL rdpgfx_retained_cache_is_offered(const RDPGFX_RETAINED_CACHE* cache)
+{
+	WINPR_ASSERT(cache);
+	return cache->offered > 0;
+}
+
+UINT rdpgfx_retained_cache_import(RDPGFX_RETAINED_CACHE* cache, RdpgfxClientContext* context,
+                                  const RDPGFX_CACHE_IMPORT_REPLY_PDU* reply)
+{
+	UINT error = CHANNEL_RC_OK;
+
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(reply);
+
+	const size_t count = MIN(cache->offered, reply->importedEntriesCount);
+
+	WLog_DBG(TAG, "importing %" PRIuz " of %" PRIuz " retained cache entries", count,
+	         cache->offered);
+
+	for (size_t x = 0; (x < count) && context->ImportCacheEntry; x++)
+	{
+		const UINT16 cacheSlot = reply->cacheSlots[x];
+
+		if (cacheSlot == 0)
+			continue;
+
+		error = context->ImportCacheEntry(context, cacheSlot, &cache->entries[x]);
+		if (error != CHANNEL_RC_OK)
+			break;
+	}
+
+	rdpgfx_retained_cache_clear(cache);
+	return error;
+}
@@ -0,0 +1,59 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Graphics Pipeline Extension, cache retained across reconnects
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_RDPGFX_CLIENT_RETAIN_H
+#define FREERDP_CHANNEL_RDPGFX_CLIENT_RETAIN_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/channels/rdpgfx.h>
+#include <freerdp/client/rdpgfx.h>
+
+/** Copies of the cache slots of a closed connection. They are offered to the server of the next
+ * connection with a cache import offer and imported to the slots the server assigns. */
+typedef struct s_rdpgfx_retained_cache RDPGFX_RETAINED_CACHE;
+
+FREERDP_LOCAL void rdpgfx_retained_cache_free(RDPGFX_RETAINED_CACHE* cache);
+
+WINPR_ATTR_MALLOC(rdpgfx_retained_cache_free, 1)
+FREERDP_LOCAL RDPGFX_RETAINED_CACHE* rdpgfx_retained_cache_new(void);
+
+FREERDP_LOCAL void rdpgfx_retained_cache_clear(RDPGFX_RETAINED_CACHE* cache);
+
+FREERDP_LOCAL size_t rdpgfx_retained_cache_count(const RDPGFX_RETAINED_CACHE* cache);
+
+/** Copy the cache slots 1 to maxCacheSlots of the context, caps are the capabilities the
+ * server confirmed for the connection the slots were filled in */
+FREERDP_LOCAL BOOL rdpgfx_retained_cache_save(RDPGFX_RETAINED_CACHE* cache,
+                                              RdpgfxClientContext* context,
+                                              const RDPGFX_CAPSET* caps, UINT16 maxCacheSlots);
+
+/** Fill an import offer with the retained entries. Returns FALSE and drops the entries if the
+ * server confirmed other capabilities than the ones they were cached with. */
+FREERDP_LOCAL BOOL rdpgfx_retained_cache_offer(RDPGFX_RETAINED_CACHE* cache,
+                                               const RDPGFX_CAPSET* caps,
+                                               RDPGFX_CACHE_IMPORT_OFFER_PDU* offer);
+
+FREERDP_LOCAL BOOL rdpgfx_retained_cache_is_offered(const RDPGFX_RETAINED_CACHE* cache);
+
+/** Import the offered entries to the slots of the reply and drop all copies */
+FREERDP_LOCAL UINT rdpgfx_retained_cache_import(RDPGFX_RETAINED_CACHE* cache,
+                                                RdpgfxClientContext* context,
+                                                const RDPGFX_CACHE_IMPORT_REPLY_PDU* reply);
+
+#endif /* FREERDP_CHANNEL_RDPGFX_CLIENT_RETAIN_H */
@@ -0,0 +1,287 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Graphics Pipeline Extension, retained cache test
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+
+#include "rdpgfx_retain.h"
+
+#define TEST_TILES 64
+#define TEST_TILE_SIZE 64
+#define TEST_TILE_BYTES (4ull * TEST_TILE_SIZE * TEST_TILE_SIZE)
+#define TEST_MAX_SLOTS 4096
+
+/* sizes of the server PDUs on the wire, RDPGFX_HEADER_SIZE included */
+#define TEST_HEADER_SIZE 8ull
+#define TEST_WIRE_TO_SURFACE_1_SIZE (TEST_HEADER_SIZE + 17ull)
+#define TEST_CACHE_TO_SURFACE_SIZE (TEST_HEADER_SIZE + 6ull + 4ull)
+#define TEST_SURFACE_TO_CACHE_SIZE (TEST_HEADER_SIZE + 20ull)
+#define TEST_CACHE_IMPORT_REPLY_SIZE (TEST_HEADER_SIZE + 2ull)
+
+/* the cache slots of the client, as the gdi keeps them */
+typedef struct
+{
+	PERSISTENT_CACHE_ENTRY slots[TEST_MAX_SLOTS + 1];
+} TestSlots;
+
+/* the server side of the connection: what it knows the client has cached */
+typedef struct
+{
+	UINT64 keys[TEST_TILES];
+	size_t bytesSent;
+} TestServer;
+
+static void test_slots_clear(TestSlots* slots)
+{
+	for (size_t x = 0; x < ARRAYSIZE(slots->slots); x++)
+	{
+		free(slots->slots[x].data);
+		slots->slots[x].data = NULL;
+		slots->slots[x].size = 0;
+	}
+}
+
+static UINT test_import(RdpgfxClientContext* context, UINT16 cacheSlot,
+                        const PERSISTENT_CACHE_ENTRY* entry)
+{
+	TestSlots* slots = context->custom;
+
+	if ((cacheSlot == 0) || (cacheSlot > TEST_MAX_SLOTS))
+		return ERROR_INVALID_INDEX;
+
+	PERSISTENT_CACHE_ENTRY* slot = &slots->slots[cacheSlot];
+	free(slot->data);
+	*slot = *entry;
+	slot->data = malloc(entry->size);
+	if (!slot->data)
+		return CHANNEL_RC_NO_MEMORY;
+	memcpy(slot->data, entry->data, entry->size);
+	return CHANNEL_RC_OK;
+}
+
+static UINT test_export(RdpgfxClientContext* context, UINT16 cacheSlot,
+                        PERSISTENT_CACHE_ENTRY* entry)
+{
+	TestSlots* slots = context->custom;
+
+	if ((cacheSlot == 0) || (cacheSlot > TEST_MAX_SLOTS))
+		return ERROR_INVALID_INDEX;
+
+	*entry = slots->slots[cacheSlot];
+	return CHANNEL_RC_OK;
+}
+
+static UINT64 test_key(const BYTE* data)
+{
+	UINT64 key = 0xcbf29ce484222325ull;
+	for (size_t x = 0; x < TEST_TILE_BYTES; x++)
+		key = (key ^ data[x]) * 0x100000001b3ull;
+	return key;
+}
+
+/* the first connection: every tile is sent once and cached in slot 1 + index */
+static BOOL test_first_connection(RdpgfxClientContext* context, TestServer* server,
+                                  BYTE* const* tiles)
+{
+	for (size_t x = 0; x < TEST_TILES; x++)
+	{
+		const PERSISTENT_CACHE_ENTRY entry = {
+			test_key(tiles[x]), TEST_TILE_SIZE, TEST_TILE_SIZE, TEST_TILE_BYTES, 0, tiles[x]
+		};
+
+		if (test_import(context, (UINT16)(x + 1), &entry) != CHANNEL_RC_OK)
+			return FALSE;
+
+		server->keys[x] = entry.key64;
+		server->bytesSent +=
+		    TEST_WIRE_TO_SURFACE_1_SIZE + TEST_TILE_BYTES + TEST_SURFACE_TO_CACHE_SIZE;
+	}
+
+	return TRUE;
+}
+
+/* redraw all tiles after a reconnect, from the cache if the server knows the client has them */
+static BOOL test_redraw(RdpgfxClientContext* context, TestServer* server,
+                        const RDPGFX_CACHE_IMPORT_REPLY_PDU* reply, BYTE* const* tiles)
+{
+	TestSlots* slots = context->custom;
+
+	for (size_t x = 0; x < TEST_TILES; x++)
+	{
+		UINT16 cacheSlot = 0;
+
+		for (size_t y = 0; reply && (y < reply->importedEntriesCount); y++)
+		{
+			const PERSISTENT_CACHE_ENTRY* slot = &slots->slots[reply->cacheSlots[y]];
+			if ((reply->cacheSlots[y] != 0) && slot->data && (slot->key64 == server->keys[x]))
+				cacheSlot = reply->cacheSlots[y];
+		}
+
+		if (cacheSlot == 0)
+		{
+			server->bytesSent += TEST_WIRE_TO_SURFACE_1_SIZE + TEST_TILE_BYTES;
+			continue;
+		}
+
+		if (memcmp(slots->slots[cacheSlot].data, tiles[x], TEST_TILE_BYTES) != 0)
+		{
+			printf("tile %" PRIuz " restored to slot %" PRIu16 " differs\n", x, cacheSlot);
+			return FALSE;
+		}
+
+		server->bytesSent += TEST_CACHE_TO_SURFACE_SIZE;
+	}
+
+	return TRUE;
+}
+
+/* the server accepts the offered keys it knows and assigns them slots from the top */
+static void test_reply(const TestServer* server, const RDPGFX_CACHE_IMPORT_OFFER_PDU* offer,
+                       RDPGFX_CACHE_IMPORT_REPLY_PDU* reply, size_t* bytesSent)
+{
+	reply->importedEntriesCount = offer->cacheEntriesCount;
+	*bytesSent += TEST_CACHE_IMPORT_REPLY_SIZE + 2ull * offer->cacheEntriesCount;
+
+	for (size_t x = 0; x < offer->cacheEntriesCount; x++)
+	{
+		reply->cacheSlots[x] = 0;
+		for (size_t y = 0; y < ARRAYSIZE(server->keys); y++)
+		{
+			if ((server->keys[y] == offer->cacheEntries[x].cacheKey) &&
+			    (offer->cacheEntries[x].bitmapLength == TEST_TILE_BYTES))
+				reply->cacheSlots[x] = (UINT16)(TEST_MAX_SLOTS - x);
+		}
+	}
+}
+
+static BOOL test_reconnect(BYTE* const* tiles, BOOL sameCaps, size_t* bytesReceived)
+{
+	BOOL rc = FALSE;
+	const RDPGFX_CAPSET caps = { RDPGFX_CAPVERSION_107, 4, RDPGFX_CAPS_FLAG_SMALL_CACHE };
+	const RDPGFX_CAPSET otherCaps = { RDPGFX_CAPVERSION_106, 4, RDPGFX_CAPS_FLAG_SMALL_CACHE };
+	RdpgfxClientContext context = { 0 };
+	TestServer server = { 0 };
+	TestSlots* slots = calloc(1, sizeof(TestSlots));
+	RDPGFX_RETAINED_CACHE* retained = rdpgfx_retained_cache_new();
+	RDPGFX_CACHE_IMPORT_OFFER_PDU* offer = calloc(1, sizeof(RDPGFX_CACHE_IMPORT_OFFER_PDU));
+	RDPGFX_CACHE_IMPORT_REPLY_PDU* reply = calloc(1, sizeof(RDPGFX_CACHE_IMPORT_REPLY_PDU));
+	if (!slots || !retained || !offer || !reply)
+		goto fail;
+
+	context.custom = slots;
+	context.ImportCacheEntry = test_import;
+	context.ExportCacheEntry = test_export;
+
+	if (!test_first_connection(&context, &server, tiles))
+		goto fail;
+
+	/* the connection is lost, the channel is closed and the slots are released */
+	if (!rdpgfx_retained_cache_save(retained, &context, &caps, TEST_MAX_SLOTS))
+		goto fail;
+	test_slots_clear(slots);
+
+	if (rdpgfx_retained_cache_count(retained) != TEST_TILES)
+	{
+		printf("retained %" PRIuz " instead of %d entries\n",
+		       rdpgfx_retained_cache_count(retained), TEST_TILES);
+		goto fail;
+	}
+
+	/* the reconnect, count what the server sends from the caps confirm on */
+	server.bytesSent = 0;
+	if (rdpgfx_retained_cache_offer(retained, sameCaps ? &caps : &otherCaps, offer))
+	{
+		if (!sameCaps || (offer->cacheEntriesCount != TEST_TILES))
+			goto fail;
+
+		test_reply(&server, offer, reply, &server.bytesSent);
+		if (rdpgfx_retained_cache_import(retained, &context, reply) != CHANNEL_RC_OK)
+			goto fail;
+
+		if (!test_redraw(&context, &server, reply, tiles))
+			goto fail;
+	}
+	else
+	{
+		/* other capabilities, the copies must be gone */
+		if (sameCaps || (rdpgfx_retained_cache_count(retained) != 0))
+			goto fail;
+
+		if (!test_redraw(&context, &server, NULL, tiles))
+			goto fail;
+	}
+
+	if ((rdpgfx_retained_cache_count(retained) != 0) || rdpgfx_retained_cache_is_offered(retained))
+		goto fail;
+
+	*bytesReceived = server.bytesSent;
+	rc = TRUE;
+fail:
+	if (slots)
+		test_slots_clear(slots);
+	free(slots);
+	free(offer);
+	free(reply);
+	rdpgfx_retained_cache_free(retained);
+	return rc;
+}
+
+int TestRdpgfxRetainedCache(int argc, char* argv[])
+{
+	int rc = -1;
+	size_t cold = 0;
+	size_t warm = 0;
+	BYTE* tiles[TEST_TILES] = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	for (size_t x = 0; x < TEST_TILES; x++)
+	{
+		tiles[x] = malloc(TEST_TILE_BYTES);
+		if (!tiles[x])
+			goto fail;
+		winpr_RAND(tiles[x], TEST_TILE_BYTES);
+	}
+
+	if (!test_reconnect(tiles, FALSE, &cold))
+	{
+		printf("reconnect with other capabilities failed\n");
+		goto fail;
+	}
+
+	if (!test_reconnect(tiles, TRUE, &warm))
+	{
+		printf("reconnect with the same capabilities failed\n");
+		goto fail;
+	}
+
+	printf("bytes received after a reconnect: %" PRIuz " without, %" PRIuz
+	       " with the retained cache\n",
+	       cold, warm);
+
+	if ((cold < TEST_TILES * TEST_TILE_BYTES) || (warm * 100 > cold))
+		goto fail;
+
+	rc = 0;
+fail:
+	for (size_t x = 0; x < TEST_TILES; x++)
+		free(tiles[x]);
+	return rc;
+}
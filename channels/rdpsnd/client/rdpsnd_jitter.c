@@ -0,0 +1,533 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Audio Output Virtual Channel, playback jitter buffer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <math.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+
+#include <freerdp/types.h>
+
+#include "rdpsnd_jitter.h"
+
+/* bounds of the adaptive target latency in ms */
+#define RDPSND_JITTER_MIN_TARGET 20
+#define RDPSND_JITTER_MAX_TARGET 500
+/* maximum playback rate correction in ppm, inaudible for speech and music */
+#define RDPSND_JITTER_MAX_DRIFT 5000
+/* time constant of the averaged buffer depth in ms */
+#define RDPSND_JITTER_DEPTH_AVERAGE 2000
+/* missing audio is concealed for this many ms, playback stops after that */
+#define RDPSND_JITTER_MAX_CONCEALMENT 60
+/* length of the audio repeated to conceal missing audio in ms */
+#define RDPSND_JITTER_HISTORY 10
+
+struct s_rdpsnd_jitter_buffer
+{
+	CRITICAL_SECTION lock;
+
+	BOOL valid;
+	UINT32 rate;
+	UINT16 channels;
+	size_t frameSize;
+	UINT32 configuredTarget;
+
+	/* decoded audio waiting for playback */
+	BYTE* data;
+	size_t capacity;
+	size_t head;
+	size_t length;
+	double position; /* fractional read position in frames */
+
+	BOOL playing;
+	UINT64 bufferingSince;
+	UINT64 startTime;
+	UINT64 framesOut;
+
+	/* interarrival jitter, RFC 3550 6.4.1 */
+	BOOL haveLast;
+	UINT16 lastTimeStamp;
+	UINT64 lastArrival;
+	double jitter;
+	double peakDelay; /* slowly decaying maximum of the transit time variation */
+	UINT32 packetDuration;
+
+	double averageDepth;
+	INT32 drift;
+
+	INT16* output;
+	size_t outputFrames;
+	INT16* history;
+	size_t historyFrames;
+	size_t historyLength;
+	size_t concealed;
+
+	RDPSND_PLAYBACK_STATS stats;
+};
+
+static size_t jitter_frames(const RDPSND_JITTER_BUFFER* jitter, UINT64 ms)
+{
+	return (size_t)(ms * jitter->rate / 1000);
+}
+
+static UINT32 jitter_ms(const RDPSND_JITTER_BUFFER* jitter, size_t frames)
+{
+	return (UINT32)(1000ull * frames / jitter->rate);
+}
+
+static size_t jitter_buffered(const RDPSND_JITTER_BUFFER* jitter)
+{
+	return jitter->length / jitter->frameSize;
+}
+
+static UINT32 jitter_target(const RDPSND_JITTER_BUFFER* jitter)
+{
+	/* a packet must be buffered in addition to the largest recent delay of an arrival, the
+	 * average jitter alone underestimates bursty networks */
+	const double delay = MAX(3.0 * jitter->jitter, jitter->peakDelay);
+	const UINT32 required = jitter->packetDuration + (UINT32)lround(MIN(delay, UINT16_MAX));
+	const UINT32 target = MAX(jitter->configuredTarget, MIN(required, RDPSND_JITTER_MAX_TARGET));
+	return MAX(target, RDPSND_JITTER_MIN_TARGET);
+}
+
+static void jitter_consume(RDPSND_JITTER_BUFFER* jitter, size_t frames)
+{
+	const size_t size = frames * jitter->frameSize;
+
+	WINPR_ASSERT(size <= jitter->length);
+	jitter->head += size;
+	jitter->length -= size;
+	if (jitter->length == 0)
+		jitter->head = 0;
+}
+
+static BOOL jitter_append(RDPSND_JITTER_BUFFER* jitter, const BYTE* data, size_t size)
+{
+	if (jitter->head + jitter->length + size > jitter->capacity)
+	{
+		if (jitter->head > 0)
+		{
+			memmove(jitter->data, &jitter->data[jitter->head], jitter->length);
+			jitter->head = 0;
+		}
+
+		if (jitter->length + size > jitter->capacity)
+		{
+			const size_t capacity = MAX(jitter->length + size, jitter->capacity * 2);
+			BYTE* tmp = realloc(jitter->data, capacity);
+			if (!tmp)
+				return FALSE;
+			jitter->data = tmp;
+			jitter->capacity = capacity;
+		}
+	}
+
+	memcpy(&jitter->data[jitter->head + jitter->length], data, size);
+	jitter->length += size;
+	return TRUE;
+}
+
+static void jitter_stop(RDPSND_JITTER_BUFFER* jitter)
+{
+	/* the interpolation might have left a frame behind */
+	jitter->head = 0;
+	jitter->length = 0;
+	jitter->playing = FALSE;
+	jitter->concealed = 0;
+	jitter->historyLength = 0;
+	jitter->position = 0.0;
+	jitter->drift = 0;
+}
+
+static void jitter_start(RDPSND_JITTER_BUFFER* jitter, UINT64 now)
+{
+	if (jitter->playing || (jitter->length == 0))
+		return;
+
+	const UINT32 target = jitter_target(jitter);
+	if ((jitter_ms(jitter, jitter_buffered(jitter)) < target) &&
+	    (now - jitter->bufferingSince < target))
+		return;
+
+	jitter->playing = TRUE;
+	jitter->startTime = now;
+	jitter->framesOut = 0;
+	jitter->averageDepth = jitter_ms(jitter, jitter_buffered(jitter));
+}
+
+static void jitter_update_drift(RDPSND_JITTER_BUFFER* jitter, size_t frames)
+{
+	const double depth = jitter_ms(jitter, jitter_buffered(jitter));
+	const double weight = MIN(1.0, 1000.0 * frames / jitter->rate / RDPSND_JITTER_DEPTH_AVERAGE);
+
+	jitter->averageDepth += (depth - jitter->averageDepth) * weight;
+
+	/* the buffer runs full or empty if the server clock drifts against ours, slightly
+	 * speed up or slow down playback to keep it at the target */
+	const double error = jitter->averageDepth - jitter_target(jitter);
+	if (fabs(error) < RDPSND_JITTER_PERIOD / 2.0)
+		jitter->drift = 0;
+	else
+	{
+		const double drift = error * 500.0;
+		jitter->drift = (INT32)MAX(-RDPSND_JITTER_MAX_DRIFT, MIN(RDPSND_JITTER_MAX_DRIFT, drift));
+	}
+}
+
+static size_t jitter_render(RDPSND_JITTER_BUFFER* jitter, INT16* dst, size_t frames)
+{
+	const size_t available = jitter_buffered(jitter);
+	const INT16* src = (const INT16*)&jitter->data[jitter->head];
+	const size_t channels = jitter->channels;
+
+	if ((jitter->drift == 0) && (jitter->position == 0.0))
+	{
+		const size_t count = MIN(frames, available);
+		memcpy(dst, src, count * jitter->frameSize);
+		jitter_consume(jitter, count);
+		return count;
+	}
+
+	/* linear interpolation is sufficient for corrections well below 1% */
+	const double step = 1.0 + jitter->drift / 1000000.0;
+	double position = jitter->position;
+	size_t count = 0;
+
+	for (; count < frames; count++)
+	{
+		const size_t index = (size_t)position;
+		if (index + 1 >= available)
+			break;
+
+		const double fraction = position - (double)index;
+		for (size_t c = 0; c < channels; c++)
+		{
+			const double a = src[index * channels + c];
+			const double b = src[(index + 1) * channels + c];
+			dst[count * channels + c] = (INT16)lround(a + (b - a) * fraction);
+		}
+		position += step;
+	}
+
+	const size_t consumed = MIN((size_t)position, available);
+	jitter_consume(jitter, consumed);
+	jitter->position = position - (double)consumed;
+	return count;
+}
+
+static void jitter_conceal(RDPSND_JITTER_BUFFER* jitter, INT16* dst, size_t frames)
+{
+	const size_t channels = jitter->channels;
+	const size_t maxConcealed = jitter_frames(jitter, RDPSND_JITTER_MAX_CONCEALMENT);
+
+	/* repeat the last audio played and fade it out */
+	for (size_t x = 0; x < frames; x++)
+	{
+		const size_t pos = jitter->concealed + x;
+		if ((jitter->historyLength == 0) || (pos >= maxConcealed))
+		{
+			memset(&dst[x * channels], 0, jitter->frameSize);
+			continue;
+		}
+
+		const double gain = 1.0 - (double)pos / (double)maxConcealed;
+		const INT16* src = &jitter->history[(pos % jitter->historyLength) * channels];
+		for (size_t c = 0; c < channels; c++)
+			dst[x * channels + c] = (INT16)lround(src[c] * gain);
+	}
+
+	jitter->concealed += frames;
+	jitter->stats.concealedFrames += frames;
+}
+
+static void jitter_update_history(RDPSND_JITTER_BUFFER* jitter, const INT16* src, size_t frames)
+{
+	const size_t channels = jitter->channels;
+
+	if (frames >= jitter->historyFrames)
+	{
+		memcpy(jitter->history, &src[(frames - jitter->historyFrames) * channels],
+		       jitter->historyFrames * jitter->frameSize);
+		jitter->historyLength = jitter->historyFrames;
+		return;
+	}
+
+	const size_t keep = MIN(jitter->historyLength, jitter->historyFrames - frames);
+	memmove(jitter->history, &jitter->history[(jitter->historyLength - keep) * channels],
+	        keep * jitter->frameSize);
+	memcpy(&jitter->history[keep * channels], src, frames * jitter->frameSize);
+	jitter->historyLength = keep + frames;
+}
+
+static BOOL jitter_ensure_output(RDPSND_JITTER_BUFFER* jitter, size_t frames)
+{
+	if (frames <= jitter->outputFrames)
+		return TRUE;
+
+	INT16* tmp = realloc(jitter->output, frames * jitter->frameSize);
+	if (!tmp)
+		return FALSE;
+	jitter->output = tmp;
+	jitter->outputFrames = frames;
+	return TRUE;
+}
+
+RDPSND_JITTER_BUFFER* rdpsnd_jitter_buffer_new(void)
+{
+	RDPSND_JITTER_BUFFER* jitter = calloc(1, sizeof(RDPSND_JITTER_BUFFER));
+	if (!jitter)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&jitter->lock, 4000))
+	{
+		free(jitter);
+		return NULL;
+	}
+	return jitter;
+}
+
+void rdpsnd_jitter_buffer_free(RDPSND_JITTER_BUFFER* jitter)
+{
+	if (!jitter)
+		return;
+
+	DeleteCriticalSection(&jitter->lock);
+	free(jitter->data);
+	free(jitter->output);
+	free(jitter->history);
+	free(jitter);
+}
+
+BOOL rdpsnd_jitter_buffer_reset(RDPSND_JITTER_BUFFER* jitter, const AUDIO_FORMAT* format,
+                                UINT32 targetLatency)
+{
+	WINPR_ASSERT(jitter);
+
+	EnterCriticalSection(&jitter->lock);
+	jitter_stop(jitter);
+	jitter->valid = FALSE;
+	jitter->head = 0;
+	jitter->length = 0;
+	jitter->haveLast = FALSE;
+	jitter->jitter = 0.0;
+	jitter->peakDelay = 0.0;
+	jitter->packetDuration = 0;
+	jitter->configuredTarget = targetLatency;
+
+	if (format && (format->wFormatTag == WAVE_FORMAT_PCM) && (format->wBitsPerSample == 16) &&
+	    (format->nChannels > 0) && (format->nSamplesPerSec > 0))
+	{
+		jitter->rate = format->nSamplesPerSec;
+		jitter->channels = format->nChannels;
+		jitter->frameSize = 2ull * format->nChannels;
+		jitter->historyFrames = MAX(1, jitter_frames(jitter, RDPSND_JITTER_HISTORY));
+
+		INT16* history = realloc(jitter->history, jitter->historyFrames * jitter->frameSize);
+		if (history)
+		{
+			jitter->history = history;
+			jitter->valid = TRUE;
+		}
+	}
+
+	const BOOL valid = jitter->valid;
+	LeaveCriticalSection(&jitter->lock);
+	return valid;
+}
+
+BOOL rdpsnd_jitter_buffer_push(RDPSND_JITTER_BUFFER* jitter, UINT16 wTimeStamp, UINT64 arrival,
+                               const BYTE* data, size_t size)
+{
+	BOOL rc = TRUE;
+
+	WINPR_ASSERT(jitter);
+	WINPR_ASSERT(data || (size == 0));
+
+	EnterCriticalSection(&jitter->lock);
+	size_t frames = jitter->valid ? size / jitter->frameSize : 0;
+	if (!jitter->valid || (frames == 0))
+		goto out;
+
+	jitter->stats.packets++;
+
+	if (jitter->haveLast)
+	{
+		/* wTimeStamp is the server time the PDU was sent at, wrapping at 16 bit */
+		const INT16 sent = (INT16)(UINT16)(wTimeStamp - jitter->lastTimeStamp);
+		const double transit = (double)(INT64)(arrival - jitter->lastArrival) - sent;
+		jitter->jitter += (fabs(transit) - jitter->jitter) / 16.0;
+		jitter->peakDelay = MAX(fabs(transit), jitter->peakDelay - jitter->peakDelay / 256.0);
+	}
+	jitter->haveLast = TRUE;
+	jitter->lastTimeStamp = wTimeStamp;
+	jitter->lastArrival = arrival;
+	jitter->packetDuration = jitter_ms(jitter, frames);
+
+	/* the start of this packet was already replaced by concealment. Skip what would exceed the
+	 * target latency, keeping the rest grows the buffer to the delay just observed */
+	if (jitter->playing && (jitter->concealed > 0))
+	{
+		const size_t target = jitter_frames(jitter, jitter_target(jitter));
+		const size_t buffered = jitter_buffered(jitter) + frames;
+		const size_t excess = (buffered > target) ? buffered - target : 0;
+		const size_t skip = MIN(jitter->concealed, MIN(excess, frames));
+
+		jitter->stats.latePackets++;
+		jitter->concealed = 0;
+		data += skip * jitter->frameSize;
+		frames -= skip;
+		if (frames == 0)
+			goto out;
+	}
+
+	const size_t maxFrames =
+	    jitter_frames(jitter, MAX(2ull * jitter_target(jitter), jitter_target(jitter) + 100ull));
+	if (jitter_buffered(jitter) + frames > maxFrames)
+	{
+		jitter->stats.droppedPackets++;
+		goto out;
+	}
+
+	if (!jitter->playing && (jitter->length == 0))
+		jitter->bufferingSince = arrival;
+
+	if (!jitter_append(jitter, data, frames * jitter->frameSize))
+		rc = FALSE;
+
+out:
+	LeaveCriticalSection(&jitter->lock);
+	return rc;
+}
+
+BOOL rdpsnd_jitter_buffer_read(RDPSND_JITTER_BUFFER* jitter, UINT64 now, wStream* s)
+{
+	BOOL rc = TRUE;
+
+	WINPR_ASSERT(jitter);
+	WINPR_ASSERT(s);
+
+	EnterCriticalSection(&jitter->lock);
+	if (!jitter->valid)
+		goto out;
+
+	jitter_start(jitter, now);
+	if (!jitter->playing)
+		goto out;
+
+	const size_t elapsed = jitter_frames(jitter, now - jitter->startTime);
+	if (elapsed < jitter->framesOut + jitter_frames(jitter, RDPSND_JITTER_PERIOD / 2))
+		goto out;
+
+	/* do not catch up with a stalled consumer, that would only add latency */
+	size_t due = elapsed - jitter->framesOut;
+	const size_t maxDue = jitter_frames(jitter, RDPSND_JITTER_MAX_TARGET);
+	if (due > maxDue)
+	{
+		jitter->framesOut = elapsed - maxDue;
+		due = maxDue;
+	}
+
+	if (!jitter_ensure_output(jitter, due) ||
+	    !Stream_EnsureRemainingCapacity(s, due * jitter->frameSize))
+	{
+		rc = FALSE;
+		goto out;
+	}
+
+	jitter_update_drift(jitter, due);
+
+	const size_t rendered = jitter_render(jitter, jitter->output, due);
+	if (rendered > 0)
+		jitter_update_history(jitter, jitter->output, rendered);
+
+	if (rendered < due)
+	{
+		if (jitter->concealed == 0)
+			jitter->stats.underruns++;
+
+		jitter_conceal(jitter, &jitter->output[rendered * jitter->channels], due - rendered);
+	}
+
+	Stream_Write(s, jitter->output, due * jitter->frameSize);
+	jitter->framesOut += due;
+
+	/* the server stopped sending, wait for new audio to fill the buffer again */
+	if (jitter->concealed >= jitter_frames(jitter, RDPSND_JITTER_MAX_CONCEALMENT))
+		jitter_stop(jitter);
+
+out:
+	LeaveCriticalSection(&jitter->lock);
+	return rc;
+}
+
+DWORD rdpsnd_jitter_buffer_timeout(RDPSND_JITTER_BUFFER* jitter, UINT64 now)
+{
+	DWORD timeout = INFINITE;
+	UINT64 next = 0;
+
+	WINPR_ASSERT(jitter);
+
+	EnterCriticalSection(&jitter->lock);
+	if (!jitter->valid)
+		goto out;
+
+	if (jitter->playing)
+		next = jitter->startTime + jitter_ms(jitter, jitter->framesOut) + RDPSND_JITTER_PERIOD;
+	else if (jitter->length > 0)
+		next = jitter->bufferingSince + jitter_target(jitter);
+	else
+		goto out;
+
+	timeout = (next > now) ? (DWORD)(next - now) : 0;
+
+out:
+	LeaveCriticalSection(&jitter->lock);
+	return timeout;
+}
+
+UINT32 rdpsnd_jitter_buffer_depth(RDPSND_JITTER_BUFFER* jitter)
+{
+	UINT32 depth = 0;
+
+	WINPR_ASSERT(jitter);
+
+	EnterCriticalSection(&jitter->lock);
+	if (jitter->valid)
+		depth = jitter_ms(jitter, jitter_buffered(jitter));
+	LeaveCriticalSection(&jitter->lock);
+	return depth;
+}
+
+void rdpsnd_jitter_buffer_get_stats(RDPSND_JITTER_BUFFER* jitter, RDPSND_PLAYBACK_STATS* stats)
+{
+	WINPR_ASSERT(jitter);
+	WINPR_ASSERT(stats);
+
+	EnterCriticalSection(&jitter->lock);
+	*stats = jitter->stats;
+	if (jitter->valid)
+	{
+		stats->depth = jitter_ms(jitter, jitter_buffered(jitter));
+		stats->targetLatency = jitter_target(jitter);
+	}
+	stats->jitter = (UINT32)lround(jitter->jitter);
+	stats->drift = jitter->drift;
+	LeaveCriticalSection(&jitter->lock);
+}
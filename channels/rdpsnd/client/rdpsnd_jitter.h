@@ -0,0 +1,70 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Audio Output Virtual Channel, playback jitter buffer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_RDPSND_CLIENT_JITTER_H
+#define FREERDP_CHANNEL_RDPSND_CLIENT_JITTER_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <freerdp/codec/audio.h>
+#include <freerdp/client/rdpsnd.h>
+
+/** interval in ms the buffered audio is handed to the device */
+#define RDPSND_JITTER_PERIOD 10
+/** default target latency in ms, the jitter buffer is disabled with a target of 0 */
+#define RDPSND_JITTER_DEFAULT_LATENCY 60
+
+typedef struct s_rdpsnd_jitter_buffer RDPSND_JITTER_BUFFER;
+
+RDPSND_JITTER_BUFFER* rdpsnd_jitter_buffer_new(void);
+void rdpsnd_jitter_buffer_free(RDPSND_JITTER_BUFFER* jitter);
+
+/** @brief Drop all buffered audio and switch to \b format.
+ *
+ *  Playback starts with at least \b targetLatency ms of buffered audio, the target is raised
+ *  when the measured arrival jitter requires it.
+ *
+ *  @return \b FALSE if \b format is not 16 bit PCM, the buffer can not be used then
+ */
+BOOL rdpsnd_jitter_buffer_reset(RDPSND_JITTER_BUFFER* jitter, const AUDIO_FORMAT* format,
+                                UINT32 targetLatency);
+
+/** @brief Queue decoded audio of a wave PDU sent at \b wTimeStamp that arrived at \b arrival ms
+ *
+ *  @return \b FALSE on allocation failure, late or dropped audio is not an error
+ */
+BOOL rdpsnd_jitter_buffer_push(RDPSND_JITTER_BUFFER* jitter, UINT16 wTimeStamp, UINT64 arrival,
+                               const BYTE* data, size_t size);
+
+/** @brief Append the audio due for playback at \b now ms to \b s.
+ *
+ *  Underruns are concealed and the playback rate is adjusted slightly to keep the buffer
+ *  at its target latency. Nothing is appended while buffering or idle.
+ */
+BOOL rdpsnd_jitter_buffer_read(RDPSND_JITTER_BUFFER* jitter, UINT64 now, wStream* s);
+
+/** @brief Time in ms until rdpsnd_jitter_buffer_read should be called again, \b INFINITE if idle
+ */
+DWORD rdpsnd_jitter_buffer_timeout(RDPSND_JITTER_BUFFER* jitter, UINT64 now);
+
+/** @brief Audio currently buffered in ms */
+UINT32 rdpsnd_jitter_buffer_depth(RDPSND_JITTER_BUFFER* jitter);
+
+void rdpsnd_jitter_buffer_get_stats(RDPSND_JITTER_BUFFER* jitter, RDPSND_PLAYBACK_STATS* stats);
+
+#endif /* FREERDP_CHANNEL_RDPSND_CLIENT_JITTER_H */
@@ -50,6 +50,7 @@
 
 #include "rdpsnd_common.h"
 #include "rdpsnd_main.h"
+#include "rdpsnd_jitter.h"
 
 struct rdpsnd_plugin
 {
@@ -95,6 +96,11 @@ struct rdpsnd_plugin
 	UINT32 startPlayTime;
 	size_t totalPlaySize;
 
+	RDPSND_JITTER_BUFFER* jitter;
+	UINT32 jitterLatency;
+	BOOL jitterActive;
+	UINT32 deviceLatency;
+
 	char* subsystem;
 	char* device_name;
 
@@ -390,6 +396,38 @@ static BOOL rdpsnd_apply_volume(rdpsndPlugin* rdpsnd)
 	return TRUE;
 }
 
+static void rdpsnd_reset_jitter_buffer(rdpsndPlugin* rdpsnd, const AUDIO_FORMAT* format,
+                                       BOOL supported)
+{
+	AUDIO_FORMAT pcm = *format;
+
+	WINPR_ASSERT(rdpsnd);
+
+	rdpsnd->jitterActive = FALSE;
+	rdpsnd->deviceLatency = 0;
+	if (!rdpsnd->jitter)
+		return;
+
+	/* only PCM can be buffered, formats played by the device directly bypass the buffer */
+	if (!supported)
+	{
+		pcm.wFormatTag = WAVE_FORMAT_PCM;
+		pcm.wBitsPerSample = 16;
+		pcm.nBlockAlign = 2 * pcm.nChannels;
+		pcm.nAvgBytesPerSec = pcm.nBlockAlign * pcm.nSamplesPerSec;
+		pcm.cbSize = 0;
+	}
+
+	if (rdpsnd->jitterLatency > 0)
+		rdpsnd->jitterActive = rdpsnd_jitter_buffer_reset(rdpsnd->jitter, &pcm,
+		                                                  rdpsnd->jitterLatency);
+	else
+		(void)rdpsnd_jitter_buffer_reset(rdpsnd->jitter, NULL, 0);
+
+	WLog_Print(rdpsnd->log, WLOG_DEBUG, "%s jitter buffer %s", rdpsnd_is_dyn_str(rdpsnd->dynamic),
+	           rdpsnd->jitterActive ? "enabled" : "disabled");
+}
+
 static BOOL rdpsnd_ensure_device_is_open(rdpsndPlugin* rdpsnd, UINT16 wFormatNo,
                                          const AUDIO_FORMAT* format)
 {
@@ -433,6 +471,8 @@ static BOOL rdpsnd_ensure_device_is_open(rdpsndPlugin* rdpsnd, UINT16 wFormatNo,
 				return FALSE;
 		}
 
+		rdpsnd_reset_jitter_buffer(rdpsnd, format, supported);
+
 		rdpsnd->isOpen = TRUE;
 		rdpsnd->wCurrentFormatNo = wFormatNo;
 		rdpsnd->startPlayTime = 0;
@@ -596,6 +636,90 @@ static BOOL rdpsnd_detect_overrun(rdpsndPlugin* rdpsnd, const AUDIO_FORMAT* form
 	}
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpsnd_play_buffered(rdpsndPlugin* rdpsnd)
+{
+	UINT status = CHANNEL_RC_OK;
+
+	WINPR_ASSERT(rdpsnd);
+
+	if (!rdpsnd->jitterActive || !rdpsnd->device || !rdpsnd->attached)
+		return CHANNEL_RC_OK;
+
+	if (rdpsnd->wCurrentFormatNo >= rdpsnd->NumberOfClientFormats)
+		return ERROR_INTERNAL_ERROR;
+
+	wStream* pcmData = StreamPool_Take(rdpsnd->pool, 4096);
+	if (!pcmData)
+		return CHANNEL_RC_NO_MEMORY;
+
+	if (!rdpsnd_jitter_buffer_read(rdpsnd->jitter, GetTickCount64(), pcmData))
+		status = CHANNEL_RC_NO_MEMORY;
+	else if (Stream_GetPosition(pcmData) > 0)
+	{
+		const AUDIO_FORMAT* format = &rdpsnd->ClientFormats[rdpsnd->wCurrentFormatNo];
+		const BYTE* data = Stream_Buffer(pcmData);
+		const size_t size = Stream_GetPosition(pcmData);
+
+		if (rdpsnd->device->PlayEx)
+			rdpsnd->deviceLatency = rdpsnd->device->PlayEx(rdpsnd->device, format, data, size);
+		else
+			rdpsnd->deviceLatency =
+			    IFCALLRESULT(0, rdpsnd->device->Play, rdpsnd->device, data, size);
+	}
+
+	Stream_Release(pcmData);
+	return status;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpsnd_queue_wave(rdpsndPlugin* rdpsnd, const AUDIO_FORMAT* format, const BYTE* data,
+                              size_t size)
+{
+	UINT status = CHANNEL_RC_OK;
+	wStream* pcmData = NULL;
+
+	WINPR_ASSERT(rdpsnd);
+	WINPR_ASSERT(rdpsnd->device);
+
+	if (!rdpsnd->device->FormatSupported(rdpsnd->device, format))
+	{
+		pcmData = StreamPool_Take(rdpsnd->pool, 4096);
+		if (!pcmData)
+			return CHANNEL_RC_NO_MEMORY;
+
+		if (!freerdp_dsp_decode(rdpsnd->dsp_context, format, data, size, pcmData))
+		{
+			Stream_Release(pcmData);
+			return ERROR_INTERNAL_ERROR;
+		}
+
+		Stream_SealLength(pcmData);
+		data = Stream_Buffer(pcmData);
+		size = Stream_Length(pcmData);
+	}
+
+	if (!rdpsnd_jitter_buffer_push(rdpsnd->jitter, rdpsnd->wTimeStamp, rdpsnd->wArrivalTime, data,
+	                               size))
+		status = CHANNEL_RC_NO_MEMORY;
+
+	if (pcmData)
+		Stream_Release(pcmData);
+
+	if (status != CHANNEL_RC_OK)
+		return status;
+
+	return rdpsnd_play_buffered(rdpsnd);
+}
+
 static UINT rdpsnd_treat_wave(rdpsndPlugin* rdpsnd, wStream* s, size_t size)
 {
 	AUDIO_FORMAT* format = NULL;
@@ -626,7 +750,16 @@ static UINT rdpsnd_treat_wave(rdpsndPlugin* rdpsnd, wStream* s, size_t size)
 	           "%s Wave: cBlockNo: %" PRIu8 " wTimeStamp: %" PRIu16 ", size: %" PRIdz,
 	           rdpsnd_is_dyn_str(rdpsnd->dynamic), rdpsnd->cBlockNo, rdpsnd->wTimeStamp, size);
 
-	if (rdpsnd->device && rdpsnd->attached && !rdpsnd_detect_overrun(rdpsnd, format, size))
+	if (rdpsnd->device && rdpsnd->attached && rdpsnd->jitterActive)
+	{
+		error = rdpsnd_queue_wave(rdpsnd, format, data, size);
+		if (error != CHANNEL_RC_OK)
+			return error;
+
+		/* the wave is played after the audio buffered before it */
+		latency = rdpsnd_jitter_buffer_depth(rdpsnd->jitter) + rdpsnd->deviceLatency;
+	}
+	else if (rdpsnd->device && rdpsnd->attached && !rdpsnd_detect_overrun(rdpsnd, format, size))
 	{
 		UINT status = CHANNEL_RC_OK;
 		wStream* pcmData = StreamPool_Take(rdpsnd->pool, 4096);
@@ -908,6 +1041,8 @@ static UINT rdpsnd_process_addin_args(rdpsndPlugin* rdpsnd, const ADDIN_ARGV* ar
 		{ "latency", COMMAND_LINE_VALUE_REQUIRED, "<latency>", NULL, NULL, -1, NULL, "latency" },
 		{ "quality", COMMAND_LINE_VALUE_REQUIRED, "<quality mode>", NULL, NULL, -1, NULL,
 		  "quality mode" },
+		{ "jitter", COMMAND_LINE_VALUE_REQUIRED, "<latency>", NULL, NULL, -1, NULL,
+		  "jitter buffer target latency, 0 disables" },
 		{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
 	};
 	rdpsnd->wQualityMode = HIGH_QUALITY; /* default quality mode */
@@ -975,6 +1110,15 @@ static UINT rdpsnd_process_addin_args(rdpsndPlugin* rdpsnd, const ADDIN_ARGV* ar
 
 				rdpsnd->latency = (UINT32)val;
 			}
+			CommandLineSwitchCase(arg, "jitter")
+			{
+				unsigned long val = strtoul(arg->Value, NULL, 0);
+
+				if ((errno != 0) || (val > UINT32_MAX))
+					return CHANNEL_RC_INITIALIZATION_ERROR;
+
+				rdpsnd->jitterLatency = (UINT32)val;
+			}
 			CommandLineSwitchCase(arg, "quality")
 			{
 				long wQualityMode = DYNAMIC_QUALITY;
@@ -1050,6 +1194,7 @@ static UINT rdpsnd_process_connect(rdpsndPlugin* rdpsnd)
 	UINT status = ERROR_INTERNAL_ERROR;
 	WINPR_ASSERT(rdpsnd);
 	rdpsnd->latency = 0;
+	rdpsnd->jitterLatency = RDPSND_JITTER_DEFAULT_LATENCY;
 	args = (const ADDIN_ARGV*)rdpsnd->channelEntryPoints.pExtendedData;
 
 	if (args)
@@ -1405,11 +1550,21 @@ static DWORD WINAPI play_thread(LPVOID arg)
 
 		handles[nCount++] = MessageQueue_Event(rdpsnd->queue);
 		handles[nCount++] = freerdp_abort_event(rdpsnd->rdpcontext);
-		status = WaitForMultipleObjects(nCount, handles, FALSE, INFINITE);
+
+		/* wake up when buffered audio is due for playback */
+		const DWORD timeout = rdpsnd->jitterActive
+		                          ? rdpsnd_jitter_buffer_timeout(rdpsnd->jitter, GetTickCount64())
+		                          : INFINITE;
+		status = WaitForMultipleObjects(nCount, handles, FALSE, timeout);
 		switch (status)
 		{
 			case WAIT_OBJECT_0:
 				break;
+			case WAIT_TIMEOUT:
+				error = rdpsnd_play_buffered(rdpsnd);
+				if (error)
+					return error;
+				continue;
 			default:
 				return ERROR_TIMEOUT;
 		}
@@ -1445,6 +1600,11 @@ static UINT rdpsnd_virtual_channel_event_initialized(rdpsndPlugin* rdpsnd)
 		if (!rdpsnd->queue)
 			return CHANNEL_RC_NO_MEMORY;
 
+		/* buffered audio is played from the play thread */
+		rdpsnd->jitter = rdpsnd_jitter_buffer_new();
+		if (!rdpsnd->jitter)
+			return CHANNEL_RC_NO_MEMORY;
+
 		rdpsnd->thread = CreateThread(NULL, 0, play_thread, rdpsnd, 0, NULL);
 		if (!rdpsnd->thread)
 			return CHANNEL_RC_INITIALIZATION_ERROR;
@@ -1469,6 +1629,7 @@ void rdpsnd_virtual_channel_event_terminated(rdpsndPlugin* rdpsnd)
 			(void)CloseHandle(rdpsnd->thread);
 		}
 		MessageQueue_Free(rdpsnd->queue);
+		rdpsnd_jitter_buffer_free(rdpsnd->jitter);
 
 		free_internals(rdpsnd);
 		audio_formats_free(rdpsnd->fixed_format, 1);
@@ -1544,6 +1705,15 @@ rdpContext* freerdp_rdpsnd_get_context(rdpsndPlugin* plugin)
 	return plugin->rdpcontext;
 }
 
+BOOL freerdp_rdpsnd_get_playback_stats(rdpsndPlugin* plugin, RDPSND_PLAYBACK_STATS* stats)
+{
+	if (!plugin || !stats || !plugin->jitterActive)
+		return FALSE;
+
+	rdpsnd_jitter_buffer_get_stats(plugin->jitter, stats);
+	return TRUE;
+}
+
 static rdpsndPlugin* allocatePlugin(void)
 {
 	rdpsndPlugin* rdpsnd = (rdpsndPlugin*)calloc(1, sizeof(rdpsndPlugin));
@@ -0,0 +1,390 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include "rdpsnd_jitter.h"
+
+#define TEST_RATE 48000
+#define TEST_CHANNELS 2
+#define TEST_FRAME_SIZE (2 * TEST_CHANNELS)
+#define TEST_PACKET_MS 20
+#define TEST_PACKET_FRAMES (TEST_RATE * TEST_PACKET_MS / 1000)
+#define TEST_START 1000
+
+typedef struct
+{
+	RDPSND_JITTER_BUFFER* jitter;
+	wStream* out;
+	UINT64 now;
+	UINT64 played;
+	UINT64 firstPlayed;
+	INT16 packet[TEST_PACKET_FRAMES * TEST_CHANNELS];
+	UINT32 seed;
+} TestPlayer;
+
+static UINT32 test_random(TestPlayer* player, UINT32 max)
+{
+	player->seed = player->seed * 1103515245u + 12345u;
+	return (player->seed >> 8) % (max + 1);
+}
+
+static void test_format(AUDIO_FORMAT* format, UINT16 bits)
+{
+	format->wFormatTag = WAVE_FORMAT_PCM;
+	format->nChannels = TEST_CHANNELS;
+	format->nSamplesPerSec = TEST_RATE;
+	format->wBitsPerSample = bits;
+	format->nBlockAlign = (UINT16)(TEST_CHANNELS * bits / 8);
+	format->nAvgBytesPerSec = format->nBlockAlign * TEST_RATE;
+}
+
+static BOOL test_player_init(TestPlayer* player, UINT32 target)
+{
+	AUDIO_FORMAT format = { 0 };
+
+	test_format(&format, 16);
+	player->now = TEST_START;
+	player->seed = 42;
+	for (size_t x = 0; x < ARRAYSIZE(player->packet); x++)
+		player->packet[x] = (INT16)((x % 96) * 300 - 14400);
+
+	player->jitter = rdpsnd_jitter_buffer_new();
+	player->out = Stream_New(NULL, 4096);
+	if (!player->jitter || !player->out)
+		return FALSE;
+	return rdpsnd_jitter_buffer_reset(player->jitter, &format, target);
+}
+
+static void test_player_free(TestPlayer* player)
+{
+	rdpsnd_jitter_buffer_free(player->jitter);
+	Stream_Free(player->out, TRUE);
+}
+
+/* advance the clock to until, reading whenever the buffer asks for it like the play thread */
+static BOOL test_player_run(TestPlayer* player, UINT64 until)
+{
+	for (; player->now <= until; player->now++)
+	{
+		if (rdpsnd_jitter_buffer_timeout(player->jitter, player->now) != 0)
+			continue;
+
+		Stream_SetPosition(player->out, 0);
+		if (!rdpsnd_jitter_buffer_read(player->jitter, player->now, player->out))
+			return FALSE;
+
+		if ((player->played == 0) && (Stream_GetPosition(player->out) > 0))
+			player->firstPlayed = player->now;
+		player->played += Stream_GetPosition(player->out) / TEST_FRAME_SIZE;
+	}
+
+	player->now = until;
+	return TRUE;
+}
+
+static BOOL test_player_push(TestPlayer* player, UINT64 sent)
+{
+	return rdpsnd_jitter_buffer_push(player->jitter, (UINT16)sent, player->now,
+	                                 (const BYTE*)player->packet, sizeof(player->packet));
+}
+
+static void test_print_stats(const char* name, const RDPSND_PLAYBACK_STATS* stats)
+{
+	(void)printf("%s: depth %" PRIu32 "ms target %" PRIu32 "ms jitter %" PRIu32
+	             "ms drift %" PRId32 "ppm packets %" PRIu64 " late %" PRIu64 " dropped %" PRIu64
+	             " underruns %" PRIu64 " concealed %" PRIu64 "\n",
+	             name, stats->depth, stats->targetLatency, stats->jitter, stats->drift,
+	             stats->packets, stats->latePackets, stats->droppedPackets, stats->underruns,
+	             stats->concealedFrames);
+}
+
+static BOOL test_unsupported_format(void)
+{
+	BOOL rc = FALSE;
+	AUDIO_FORMAT format = { 0 };
+	RDPSND_JITTER_BUFFER* jitter = rdpsnd_jitter_buffer_new();
+	wStream* s = Stream_New(NULL, 16);
+	const BYTE data[64] = { 0 };
+
+	if (!jitter || !s)
+		goto fail;
+
+	test_format(&format, 8);
+	if (rdpsnd_jitter_buffer_reset(jitter, &format, 60))
+		goto fail;
+	if (rdpsnd_jitter_buffer_reset(jitter, NULL, 60))
+		goto fail;
+
+	/* an unusable buffer swallows nothing and plays nothing */
+	if (!rdpsnd_jitter_buffer_push(jitter, 0, TEST_START, data, sizeof(data)))
+		goto fail;
+	if (!rdpsnd_jitter_buffer_read(jitter, TEST_START + 1000, s) || (Stream_GetPosition(s) != 0))
+		goto fail;
+	if (rdpsnd_jitter_buffer_timeout(jitter, TEST_START) != INFINITE)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	rdpsnd_jitter_buffer_free(jitter);
+	Stream_Free(s, TRUE);
+	return rc;
+}
+
+/* packets sent every interval us arrive with up to maxJitter ms of delay, in order */
+static BOOL test_stream(const char* name, UINT32 interval, UINT32 maxJitter, UINT64 duration,
+                        RDPSND_PLAYBACK_STATS* stats)
+{
+	BOOL rc = FALSE;
+	TestPlayer player = { 0 };
+	UINT64 lastArrival = 0;
+
+	if (!test_player_init(&player, 60))
+		goto fail;
+
+	for (UINT64 x = 0;; x++)
+	{
+		const UINT64 sent = TEST_START + x * interval / 1000;
+		UINT64 arrival = sent + test_random(&player, maxJitter);
+		if (arrival < lastArrival)
+			arrival = lastArrival;
+		lastArrival = arrival;
+
+		if (arrival > TEST_START + duration)
+			break;
+
+		if (!test_player_run(&player, arrival) || !test_player_push(&player, sent))
+			goto fail;
+	}
+
+	if (!test_player_run(&player, TEST_START + duration))
+		goto fail;
+
+	rdpsnd_jitter_buffer_get_stats(player.jitter, stats);
+	test_print_stats(name, stats);
+
+	/* playback follows the clock once started */
+	if (stats->underruns == 0)
+	{
+		const UINT64 expected = (player.now - player.firstPlayed) * TEST_RATE / 1000;
+		const UINT64 tolerance = 2ull * TEST_RATE * RDPSND_JITTER_PERIOD / 1000;
+		if ((player.played + tolerance < expected) || (player.played > expected + tolerance))
+		{
+			(void)fprintf(stderr, "%s: played %" PRIu64 " frames, expected %" PRIu64 "\n", name,
+			              player.played, expected);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	test_player_free(&player);
+	return rc;
+}
+
+static BOOL test_jitter(void)
+{
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+
+	if (!test_stream("jitter", TEST_PACKET_MS * 1000, 30, 10000, &stats))
+		return FALSE;
+
+	/* 30ms of jitter fit into the 60ms target */
+	if ((stats.underruns != 0) || (stats.latePackets != 0) || (stats.droppedPackets != 0))
+		return FALSE;
+	if ((stats.jitter == 0) || (stats.depth > 2 * stats.targetLatency))
+		return FALSE;
+	return TRUE;
+}
+
+static BOOL test_adaptive_target(void)
+{
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+
+	/* jitter well above the configured target raises it */
+	if (!test_stream("adaptive", TEST_PACKET_MS * 1000, 150, 20000, &stats))
+		return FALSE;
+
+	if (stats.targetLatency <= 60)
+		return FALSE;
+	if (stats.underruns > 2)
+		return FALSE;
+	return TRUE;
+}
+
+static BOOL test_drift(void)
+{
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+
+	/* the server clock runs 0.3% fast, without correction 180ms would pile up */
+	if (!test_stream("fast", TEST_PACKET_MS * 1000 * 997 / 1000, 0, 60000, &stats))
+		return FALSE;
+	if ((stats.drift <= 0) || (stats.depth > stats.targetLatency + 40) ||
+	    (stats.droppedPackets != 0))
+		return FALSE;
+
+	/* the server clock runs 0.3% slow, without correction the buffer would run empty */
+	if (!test_stream("slow", TEST_PACKET_MS * 1000 * 1003 / 1000, 0, 60000, &stats))
+		return FALSE;
+	if ((stats.drift >= 0) || (stats.underruns != 0))
+		return FALSE;
+	return TRUE;
+}
+
+static BOOL test_stall(UINT32 stall, UINT64 expectLate)
+{
+	BOOL rc = FALSE;
+	TestPlayer player = { 0 };
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+	UINT64 x = 0;
+
+	if (!test_player_init(&player, 60))
+		goto fail;
+
+	/* 2 seconds of steady audio, then nothing arrives for stall ms followed by a burst */
+	for (; x < 100; x++)
+	{
+		const UINT64 sent = TEST_START + x * TEST_PACKET_MS;
+		if (!test_player_run(&player, sent) || !test_player_push(&player, sent))
+			goto fail;
+	}
+
+	const UINT64 resume = TEST_START + x * TEST_PACKET_MS + stall;
+	for (; x < 200; x++)
+	{
+		const UINT64 sent = TEST_START + x * TEST_PACKET_MS;
+		if (!test_player_run(&player, MAX(sent, resume)) || !test_player_push(&player, sent))
+			goto fail;
+	}
+
+	const UINT64 before = player.played;
+	if (!test_player_run(&player, player.now + RDPSND_JITTER_PERIOD + 1))
+		goto fail;
+
+	rdpsnd_jitter_buffer_get_stats(player.jitter, &stats);
+	test_print_stats("stall", &stats);
+
+	if ((stats.underruns != 1) || (stats.concealedFrames == 0))
+		goto fail;
+	if (stats.latePackets != expectLate)
+		goto fail;
+	if (player.played <= before)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	test_player_free(&player);
+	return rc;
+}
+
+static BOOL test_concealment(void)
+{
+	BOOL rc = FALSE;
+	TestPlayer player = { 0 };
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+	INT32 first = 0;
+	INT32 last = 0;
+	size_t concealed = 0;
+
+	if (!test_player_init(&player, 20))
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(player.packet); x++)
+		player.packet[x] = 10000;
+
+	if (!test_player_push(&player, TEST_START))
+		goto fail;
+
+	/* a single packet plays, followed by the faded out repetition and then nothing */
+	for (UINT64 now = TEST_START; now < TEST_START + 200; now++)
+	{
+		Stream_SetPosition(player.out, 0);
+		if (!rdpsnd_jitter_buffer_read(player.jitter, now, player.out))
+			goto fail;
+
+		const INT16* samples = (const INT16*)Stream_Buffer(player.out);
+		const size_t frames = Stream_GetPosition(player.out) / TEST_FRAME_SIZE;
+		for (size_t x = 0; x < frames; x++, player.played++)
+		{
+			if (player.played < TEST_PACKET_FRAMES)
+			{
+				if (samples[x * TEST_CHANNELS] != 10000)
+					goto fail;
+				continue;
+			}
+
+			if (concealed++ == 0)
+				first = samples[x * TEST_CHANNELS];
+			last = samples[x * TEST_CHANNELS];
+		}
+	}
+
+	rdpsnd_jitter_buffer_get_stats(player.jitter, &stats);
+	test_print_stats("concealment", &stats);
+
+	if ((concealed != stats.concealedFrames) || (stats.underruns != 1))
+		goto fail;
+	if ((first <= 9000) || (last > first / 10))
+		goto fail;
+	if (rdpsnd_jitter_buffer_timeout(player.jitter, TEST_START + 200) != INFINITE)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	test_player_free(&player);
+	return rc;
+}
+
+static BOOL test_overflow(void)
+{
+	BOOL rc = FALSE;
+	TestPlayer player = { 0 };
+	RDPSND_PLAYBACK_STATS stats = { 0 };
+
+	if (!test_player_init(&player, 60))
+		goto fail;
+
+	/* two seconds arriving at once must not turn into two seconds of latency */
+	for (UINT64 x = 0; x < 100; x++)
+	{
+		if (!test_player_push(&player, TEST_START + x * TEST_PACKET_MS))
+			goto fail;
+	}
+
+	rdpsnd_jitter_buffer_get_stats(player.jitter, &stats);
+	test_print_stats("overflow", &stats);
+
+	if ((stats.droppedPackets == 0) || (stats.depth > 2 * stats.targetLatency + 100))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	test_player_free(&player);
+	return rc;
+}
+
+int TestRdpsndJitter(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_unsupported_format())
+		return -1;
+	if (!test_jitter())
+		return -1;
+	if (!test_adaptive_target())
+		return -1;
+	if (!test_drift())
+		return -1;
+	/* the buffer runs empty, the late audio replaces the concealment */
+	if (!test_stall(80, 1))
+		return -1;
+	/* the concealment ends and playback stops until the buffer is filled again */
+	if (!test_stall(300, 0))
+		return -1;
+	if (!test_concealment())
+		return -1;
+	if (!test_overflow())
+		return -1;
+	return 0;
+}
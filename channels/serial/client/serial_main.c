@@ -30,6 +30,7 @@
 #include <winpr/collections.h>
 #include <winpr/comm.h>
 #include <winpr/crt.h>
+#include <winpr/interlocked.h>
 #include <winpr/stream.h>
 #include <winpr/synch.h>
 #include <winpr/thread.h>
@@ -189,7 +190,8 @@ static UINT serial_process_irp_create(SERIAL_DEVICE* serial, IRP* irp)
 	/* dcb.fBinary = TRUE; */
 	/* SetCommState(serial->hComm, &dcb); */
 	WINPR_ASSERT(irp->FileId == 0);
-	irp->FileId = irp->devman->id_sequence++; /* FIXME: why not ((WINPR_COMM*)hComm)->fd? */
+	/* FIXME: why not ((WINPR_COMM*)hComm)->fd? */
+	irp->FileId = (UINT32)InterlockedIncrement((LONG volatile*)&irp->devman->id_sequence) - 1;
 	irp->IoStatus = STATUS_SUCCESS;
 	WLog_Print(serial->log, WLOG_DEBUG, "%s (DeviceId: %" PRIu32 ", FileId: %" PRIu32 ") created.",
 	           serial->device.name, irp->device->id, irp->FileId);
@@ -107,7 +107,7 @@ static UINT urb_write_completion(WINPR_ATTR_UNUSED IUDEVICE* pdev,
 
 	if (Stream_Capacity(out) < OutputBufferSize + 36)
 	{
-		Stream_Free(out, TRUE);
+		Stream_Release(out);
 		return ERROR_INVALID_PARAMETER;
 	}
 
@@ -116,7 +116,7 @@ static UINT urb_write_completion(WINPR_ATTR_UNUSED IUDEVICE* pdev,
 	const UINT32 FunctionId = (OutputBufferSize != 0) ? URB_COMPLETION : URB_COMPLETION_NO_DATA;
 	if (!write_shared_message_header_with_functionid(out, InterfaceId, MessageId, FunctionId))
 	{
-		Stream_Free(out, TRUE);
+		Stream_Release(out);
 		return ERROR_OUTOFMEMORY;
 	}
 
@@ -125,7 +125,7 @@ static UINT urb_write_completion(WINPR_ATTR_UNUSED IUDEVICE* pdev,
 
 	if (!write_urb_result_header(out, 8, usbd_status))
 	{
-		Stream_Free(out, TRUE);
+		Stream_Release(out);
 		return ERROR_OUTOFMEMORY;
 	}
 
@@ -136,7 +136,7 @@ static UINT urb_write_completion(WINPR_ATTR_UNUSED IUDEVICE* pdev,
 	if (!noAck)
 		return stream_write_and_free(callback->plugin, callback->channel, out);
 	else
-		Stream_Free(out, TRUE);
+		Stream_Release(out);
 
 	return ERROR_SUCCESS;
 }
@@ -795,7 +795,7 @@ static void urb_bulk_transfer_cb(IUDEVICE* pdev, GENERIC_CHANNEL_CALLBACK* callb
 		urb_write_completion(pdev, callback, noAck, out, InterfaceId, MessageId, RequestId, status,
 		                     OutputBufferSize);
 	else
-		Stream_Free(out, TRUE);
+		Stream_Release(out);
 }
 
 static UINT urb_bulk_or_interrupt_transfer(IUDEVICE* pdev, GENERIC_CHANNEL_CALLBACK* callback,
@@ -851,7 +851,7 @@ static void urb_isoch_transfer_cb(WINPR_ATTR_UNUSED IUDEVICE* pdev,
 		const UINT32 FunctionId = (OutputBufferSize == 0) ? URB_COMPLETION_NO_DATA : URB_COMPLETION;
 		if (!write_shared_message_header_with_functionid(out, InterfaceId, MessageId, FunctionId))
 		{
-			Stream_Free(out, TRUE);
+			Stream_Release(out);
 			return;
 		}
 
@@ -860,7 +860,7 @@ static void urb_isoch_transfer_cb(WINPR_ATTR_UNUSED IUDEVICE* pdev,
 		if (!write_urb_result_header(out, WINPR_ASSERTING_INT_CAST(uint16_t, 20 + packetSize),
 		                             status))
 		{
-			Stream_Free(out, TRUE);
+			Stream_Release(out);
 			return;
 		}
 
@@ -62,13 +62,9 @@
 	_dev->iface.get_##_arg = udev_get_##_arg; \
 	(_dev)->iface.set_##_arg = udev_set_##_arg
 
-#if LIBUSB_API_VERSION >= 0x01000103
-#define HAVE_STREAM_ID_API 1
-#endif
-
+/* owner data of a URBDRC_TRANSFER, the buffer is the pooled transfer->data */
 typedef struct
 {
-	wStream* data;
 	BOOL noack;
 	UINT32 MessageId;
 	UINT32 StartFrame;
@@ -77,62 +73,8 @@ typedef struct
 	UINT32 OutputBufferSize;
 	GENERIC_CHANNEL_CALLBACK* callback;
 	t_isoch_transfer_cb cb;
-	wArrayList* queue;
-#if !defined(HAVE_STREAM_ID_API)
-	UINT32 streamID;
-#endif
 } ASYNC_TRANSFER_USER_DATA;
 
-static void request_free(void* value);
-
-static struct libusb_transfer* list_contains(wArrayList* list, UINT32 streamID)
-{
-	size_t count = 0;
-	if (!list)
-		return NULL;
-	count = ArrayList_Count(list);
-	for (size_t x = 0; x < count; x++)
-	{
-		struct libusb_transfer* transfer = ArrayList_GetItem(list, x);
-
-#if defined(HAVE_STREAM_ID_API)
-		const UINT32 currentID = libusb_transfer_get_stream_id(transfer);
-#else
-		const ASYNC_TRANSFER_USER_DATA* user_data = (ASYNC_TRANSFER_USER_DATA*)transfer->user_data;
-		const UINT32 currentID = user_data->streamID;
-#endif
-		if (currentID == streamID)
-			return transfer;
-	}
-	return NULL;
-}
-
-static UINT32 stream_id_from_buffer(struct libusb_transfer* transfer)
-{
-	if (!transfer)
-		return 0;
-#if defined(HAVE_STREAM_ID_API)
-	return libusb_transfer_get_stream_id(transfer);
-#else
-	ASYNC_TRANSFER_USER_DATA* user_data = (ASYNC_TRANSFER_USER_DATA*)transfer->user_data;
-	if (!user_data)
-		return 0;
-	return user_data->streamID;
-#endif
-}
-
-static void set_stream_id_for_buffer(struct libusb_transfer* transfer, UINT32 streamID)
-{
-#if defined(HAVE_STREAM_ID_API)
-	libusb_transfer_set_stream_id(transfer, streamID);
-#else
-	ASYNC_TRANSFER_USER_DATA* user_data = (ASYNC_TRANSFER_USER_DATA*)transfer->user_data;
-	if (!user_data)
-		return;
-	user_data->streamID = streamID;
-#endif
-}
-
 WINPR_ATTR_FORMAT_ARG(3, 8)
 static BOOL log_libusb_result_(wLog* log, DWORD lvl, WINPR_FORMAT_ARG const char* fmt,
                                const char* fkt, const char* file, size_t line, int error, ...)
@@ -202,13 +144,15 @@ const char* usb_interface_class_to_string(uint8_t class)
 	}
 }
 
-static ASYNC_TRANSFER_USER_DATA* async_transfer_user_data_new(IUDEVICE* idev, UINT32 MessageId,
-                                                              size_t offset, size_t BufferSize,
-                                                              const BYTE* data, size_t packetSize,
-                                                              BOOL NoAck, t_isoch_transfer_cb cb,
-                                                              GENERIC_CHANNEL_CALLBACK* callback)
+static URBDRC_TRANSFER* async_transfer_new(IUDEVICE* idev, UINT32 streamID,
+                                           UINT32 EndpointAddress, UINT32 MessageId, size_t offset,
+                                           size_t BufferSize, const BYTE* data, size_t packetSize,
+                                           BOOL NoAck, t_isoch_transfer_cb cb,
+                                           GENERIC_CHANNEL_CALLBACK* callback,
+                                           urbdrc_transfer_complete_fn complete)
 {
 	ASYNC_TRANSFER_USER_DATA* user_data = NULL;
+	URBDRC_TRANSFER* transfer = NULL;
 	UDEVICE* pdev = (UDEVICE*)idev;
 
 	if (BufferSize > UINT32_MAX)
@@ -218,17 +162,18 @@ static ASYNC_TRANSFER_USER_DATA* async_transfer_user_data_new(IUDEVICE* idev, UI
 	if (!user_data)
 		return NULL;
 
-	user_data->data = Stream_New(NULL, offset + BufferSize + packetSize);
-
-	if (!user_data->data)
+	transfer = urbdrc_transfer_new(pdev->transfers, streamID,
+	                               WINPR_ASSERTING_INT_CAST(BYTE, EndpointAddress),
+	                               offset + BufferSize + packetSize, complete, user_data);
+	if (!transfer)
 	{
 		free(user_data);
 		return NULL;
 	}
 
-	Stream_Seek(user_data->data, offset); /* Skip header offset */
+	Stream_Seek(transfer->data, offset); /* Skip header offset */
 	if (data)
-		memcpy(Stream_Pointer(user_data->data), data, BufferSize);
+		memcpy(Stream_Pointer(transfer->data), data, BufferSize);
 	else
 		user_data->OutputBufferSize = (UINT32)BufferSize;
 
@@ -238,92 +183,65 @@ static ASYNC_TRANSFER_USER_DATA* async_transfer_user_data_new(IUDEVICE* idev, UI
 	user_data->idev = idev;
 	user_data->MessageId = MessageId;
 
-	user_data->queue = pdev->request_queue;
-
-	return user_data;
+	return transfer;
 }
 
-static void async_transfer_user_data_free(ASYNC_TRANSFER_USER_DATA* user_data)
+static void LIBUSB_CALL func_transfer_cb(struct libusb_transfer* transfer)
 {
-	if (user_data)
-	{
-		Stream_Free(user_data->data, TRUE);
-		free(user_data);
-	}
+	URBDRC_TRANSFER* t = (URBDRC_TRANSFER*)transfer->user_data;
+
+	/* the completion is delivered by the flush after the current event handling pass */
+	urbdrc_transfer_completed(t, transfer->status);
 }
 
-static void LIBUSB_CALL func_iso_callback(struct libusb_transfer* transfer)
+static void func_iso_complete(URBDRC_TRANSFER* t)
 {
-	ASYNC_TRANSFER_USER_DATA* user_data = (ASYNC_TRANSFER_USER_DATA*)transfer->user_data;
-	const UINT32 streamID = stream_id_from_buffer(transfer);
-	wArrayList* list = user_data->queue;
+	ASYNC_TRANSFER_USER_DATA* user_data = (ASYNC_TRANSFER_USER_DATA*)t->context;
+	struct libusb_transfer* transfer = (struct libusb_transfer*)t->backend;
 
-	ArrayList_Lock(list);
-	switch (transfer->status)
+	if (t->status == LIBUSB_TRANSFER_COMPLETED)
 	{
-		case LIBUSB_TRANSFER_COMPLETED:
-		{
-			UINT32 index = 0;
-			BYTE* dataStart = Stream_Pointer(user_data->data);
-			Stream_SetPosition(user_data->data,
-			                   40); /* TS_URB_ISOCH_TRANSFER_RESULT IsoPacket offset */
+		UINT32 index = 0;
+		BYTE* dataStart = Stream_Pointer(t->data);
+		Stream_SetPosition(t->data, 40); /* TS_URB_ISOCH_TRANSFER_RESULT IsoPacket offset */
 
-			for (uint32_t i = 0; i < WINPR_ASSERTING_INT_CAST(uint32_t, transfer->num_iso_packets);
-			     i++)
-			{
-				const UINT32 act_len = transfer->iso_packet_desc[i].actual_length;
-				Stream_Write_UINT32(user_data->data, index);
-				Stream_Write_UINT32(user_data->data, act_len);
-				Stream_Write_UINT32(user_data->data, transfer->iso_packet_desc[i].status);
-
-				if (transfer->iso_packet_desc[i].status != USBD_STATUS_SUCCESS)
-					user_data->ErrorCount++;
-				else
-				{
-					const unsigned char* packetBuffer =
-					    libusb_get_iso_packet_buffer_simple(transfer, i);
-					BYTE* data = dataStart + index;
-
-					if (data != packetBuffer)
-						memmove(data, packetBuffer, act_len);
-
-					index += act_len;
-				}
-			}
-		}
-			/* fallthrough */
-			WINPR_FALLTHROUGH
-		case LIBUSB_TRANSFER_CANCELLED:
-			/* fallthrough */
-			WINPR_FALLTHROUGH
-		case LIBUSB_TRANSFER_TIMED_OUT:
-			/* fallthrough */
-			WINPR_FALLTHROUGH
-		case LIBUSB_TRANSFER_ERROR:
+		for (uint32_t i = 0; i < WINPR_ASSERTING_INT_CAST(uint32_t, transfer->num_iso_packets);
+		     i++)
 		{
-			const UINT32 InterfaceId =
-			    ((STREAM_ID_PROXY << 30) | user_data->idev->get_ReqCompletion(user_data->idev));
+			const UINT32 act_len = transfer->iso_packet_desc[i].actual_length;
+			Stream_Write_UINT32(t->data, index);
+			Stream_Write_UINT32(t->data, act_len);
+			Stream_Write_UINT32(t->data, transfer->iso_packet_desc[i].status);
 
-			if (list_contains(list, streamID))
+			if (transfer->iso_packet_desc[i].status != USBD_STATUS_SUCCESS)
+				user_data->ErrorCount++;
+			else
 			{
-				if (!user_data->noack)
-				{
-					const UINT32 RequestID = streamID & INTERFACE_ID_MASK;
-					user_data->cb(user_data->idev, user_data->callback, user_data->data,
-					              InterfaceId, user_data->noack, user_data->MessageId, RequestID,
-					              WINPR_ASSERTING_INT_CAST(uint32_t, transfer->num_iso_packets),
-					              transfer->status, user_data->StartFrame, user_data->ErrorCount,
-					              user_data->OutputBufferSize);
-					user_data->data = NULL;
-				}
-				ArrayList_Remove(list, transfer);
+				const unsigned char* packetBuffer =
+				    libusb_get_iso_packet_buffer_simple(transfer, i);
+				BYTE* data = dataStart + index;
+
+				if (data != packetBuffer)
+					memmove(data, packetBuffer, act_len);
+
+				index += act_len;
 			}
 		}
-		break;
-		default:
-			break;
 	}
-	ArrayList_Unlock(list);
+
+	/* every request needs a completion, stalls and lost devices included */
+	if (!user_data->noack)
+	{
+		const UINT32 InterfaceId =
+		    ((STREAM_ID_PROXY << 30) | user_data->idev->get_ReqCompletion(user_data->idev));
+		const UINT32 RequestID = t->streamID & INTERFACE_ID_MASK;
+		user_data->cb(user_data->idev, user_data->callback, t->data, InterfaceId,
+		              user_data->noack, user_data->MessageId, RequestID,
+		              WINPR_ASSERTING_INT_CAST(uint32_t, transfer->num_iso_packets),
+		              WINPR_ASSERTING_INT_CAST(uint32_t, t->status), user_data->StartFrame,
+		              user_data->ErrorCount, user_data->OutputBufferSize);
+		t->data = NULL;
+	}
 }
 
 static const LIBUSB_ENDPOINT_DESCEIPTOR* func_get_ep_desc(LIBUSB_CONFIG_DESCRIPTOR* LibusbConfig,
@@ -350,37 +268,21 @@ static const LIBUSB_ENDPOINT_DESCEIPTOR* func_get_ep_desc(LIBUSB_CONFIG_DESCRIPT
 	return NULL;
 }
 
-static void LIBUSB_CALL func_bulk_transfer_cb(struct libusb_transfer* transfer)
+static void func_bulk_complete(URBDRC_TRANSFER* t)
 {
-	ASYNC_TRANSFER_USER_DATA* user_data = NULL;
-	uint32_t streamID = 0;
-	wArrayList* list = NULL;
-
-	user_data = (ASYNC_TRANSFER_USER_DATA*)transfer->user_data;
-	if (!user_data)
-	{
-		WLog_ERR(TAG, "[%s]: Invalid transfer->user_data!");
-		return;
-	}
-	list = user_data->queue;
-	ArrayList_Lock(list);
-	streamID = stream_id_from_buffer(transfer);
-
-	if (list_contains(list, streamID))
-	{
-		const UINT32 InterfaceId =
-		    ((STREAM_ID_PROXY << 30) | user_data->idev->get_ReqCompletion(user_data->idev));
-		const UINT32 RequestID = streamID & INTERFACE_ID_MASK;
-
-		user_data->cb(user_data->idev, user_data->callback, user_data->data, InterfaceId,
-		              user_data->noack, user_data->MessageId, RequestID,
-		              WINPR_ASSERTING_INT_CAST(uint32_t, transfer->num_iso_packets),
-		              transfer->status, user_data->StartFrame, user_data->ErrorCount,
-		              WINPR_ASSERTING_INT_CAST(uint32_t, transfer->actual_length));
-		user_data->data = NULL;
-		ArrayList_Remove(list, transfer);
-	}
-	ArrayList_Unlock(list);
+	ASYNC_TRANSFER_USER_DATA* user_data = (ASYNC_TRANSFER_USER_DATA*)t->context;
+	const struct libusb_transfer* transfer = (const struct libusb_transfer*)t->backend;
+	const UINT32 InterfaceId =
+	    ((STREAM_ID_PROXY << 30) | user_data->idev->get_ReqCompletion(user_data->idev));
+	const UINT32 RequestID = t->streamID & INTERFACE_ID_MASK;
+
+	user_data->cb(user_data->idev, user_data->callback, t->data, InterfaceId, user_data->noack,
+	              user_data->MessageId, RequestID,
+	              WINPR_ASSERTING_INT_CAST(uint32_t, transfer->num_iso_packets),
+	              WINPR_ASSERTING_INT_CAST(uint32_t, t->status), user_data->StartFrame,
+	              user_data->ErrorCount,
+	              WINPR_ASSERTING_INT_CAST(uint32_t, transfer->actual_length));
+	t->data = NULL;
 }
 
 static BOOL func_set_usbd_status(URBDRC_PLUGIN* urbdrc, UDEVICE* pdev, UINT32* status,
@@ -1233,6 +1135,7 @@ static int libusb_udev_isoch_transfer(IUDEVICE* idev, GENERIC_CHANNEL_CALLBACK*
 	UINT32 iso_packet_size = 0;
 	UDEVICE* pdev = (UDEVICE*)idev;
 	ASYNC_TRANSFER_USER_DATA* user_data = NULL;
+	URBDRC_TRANSFER* transfer = NULL;
 	struct libusb_transfer* iso_transfer = NULL;
 	URBDRC_PLUGIN* urbdrc = NULL;
 	size_t outSize = (12ULL * NumberOfPackets);
@@ -1242,17 +1145,18 @@ static int libusb_udev_isoch_transfer(IUDEVICE* idev, GENERIC_CHANNEL_CALLBACK*
 		return -1;
 
 	urbdrc = pdev->urbdrc;
-	user_data = async_transfer_user_data_new(idev, MessageId, 48, BufferSize, Buffer,
-	                                         outSize + 1024, NoAck, cb, callback);
+	transfer = async_transfer_new(idev, streamID, EndpointAddress, MessageId, 48, BufferSize,
+	                              Buffer, outSize + 1024, NoAck, cb, callback, func_iso_complete);
 
-	if (!user_data)
+	if (!transfer)
 		return -1;
 
+	user_data = (ASYNC_TRANSFER_USER_DATA*)transfer->context;
 	user_data->ErrorCount = ErrorCount;
 	user_data->StartFrame = StartFrame;
 
 	if (!Buffer)
-		Stream_Seek(user_data->data, (12ULL * NumberOfPackets));
+		Stream_Seek(transfer->data, (12ULL * NumberOfPackets));
 
 	if (NumberOfPackets > 0)
 	{
@@ -1266,28 +1170,19 @@ static int libusb_udev_isoch_transfer(IUDEVICE* idev, GENERIC_CHANNEL_CALLBACK*
 		           "Error: libusb_alloc_transfer [NumberOfPackets=%" PRIu32 ", BufferSize=%" PRIu32
 		           " ]",
 		           NumberOfPackets, BufferSize);
-		async_transfer_user_data_free(user_data);
+		urbdrc_transfer_discard(transfer);
 		return -1;
 	}
+	transfer->backend = iso_transfer;
 
 	/**  process URB_FUNCTION_IOSCH_TRANSFER */
 	libusb_fill_iso_transfer(
 	    iso_transfer, pdev->libusb_handle, WINPR_ASSERTING_INT_CAST(uint8_t, EndpointAddress),
-	    Stream_Pointer(user_data->data), WINPR_ASSERTING_INT_CAST(int, BufferSize),
-	    WINPR_ASSERTING_INT_CAST(int, NumberOfPackets), func_iso_callback, user_data, Timeout);
-	set_stream_id_for_buffer(iso_transfer, streamID);
+	    Stream_Pointer(transfer->data), WINPR_ASSERTING_INT_CAST(int, BufferSize),
+	    WINPR_ASSERTING_INT_CAST(int, NumberOfPackets), func_transfer_cb, transfer, Timeout);
 	libusb_set_iso_packet_lengths(iso_transfer, iso_packet_size);
 
-	if (!ArrayList_Append(pdev->request_queue, iso_transfer))
-	{
-		WLog_Print(urbdrc->log, WLOG_WARN,
-		           "Failed to queue iso transfer, streamID %08" PRIx32 " already in use!",
-		           streamID);
-		request_free(iso_transfer);
-		return -1;
-	}
-	rc = libusb_submit_transfer(iso_transfer);
-	if (log_libusb_result(urbdrc->log, WLOG_ERROR, "libusb_submit_transfer", rc))
+	if (!urbdrc_transfer_submit(transfer))
 		return -1;
 	return rc;
 }
@@ -1335,27 +1230,27 @@ static int libusb_udev_bulk_or_interrupt_transfer(IUDEVICE* idev,
 	const LIBUSB_ENDPOINT_DESCEIPTOR* ep_desc = NULL;
 	struct libusb_transfer* transfer = NULL;
 	URBDRC_PLUGIN* urbdrc = NULL;
-	ASYNC_TRANSFER_USER_DATA* user_data = NULL;
+	URBDRC_TRANSFER* t = NULL;
 	uint32_t streamID = 0x80000000 | RequestId;
 
 	if (!pdev || !pdev->LibusbConfig || !pdev->urbdrc)
 		return -1;
 
 	urbdrc = pdev->urbdrc;
-	user_data =
-	    async_transfer_user_data_new(idev, MessageId, 36, BufferSize, data, 0, NoAck, cb, callback);
+	t = async_transfer_new(idev, streamID, EndpointAddress, MessageId, 36, BufferSize, data, 0,
+	                       NoAck, cb, callback, func_bulk_complete);
 
-	if (!user_data)
+	if (!t)
 		return -1;
 
 	/* alloc memory for urb transfer */
 	transfer = libusb_alloc_transfer(0);
 	if (!transfer)
 	{
-		async_transfer_user_data_free(user_data);
+		urbdrc_transfer_discard(t);
 		return -1;
 	}
-	transfer->user_data = user_data;
+	t->backend = transfer;
 
 	ep_desc = func_get_ep_desc(pdev->LibusbConfig, pdev->MsConfig, EndpointAddress);
 
@@ -1363,7 +1258,7 @@ static int libusb_udev_bulk_or_interrupt_transfer(IUDEVICE* idev,
 	{
 		WLog_Print(urbdrc->log, WLOG_ERROR, "func_get_ep_desc: endpoint 0x%" PRIx32 " not found",
 		           EndpointAddress);
-		request_free(transfer);
+		urbdrc_transfer_discard(t);
 		return -1;
 	}
 
@@ -1379,16 +1274,16 @@ static int libusb_udev_bulk_or_interrupt_transfer(IUDEVICE* idev,
 			/** Bulk Transfer */
 			libusb_fill_bulk_transfer(
 			    transfer, pdev->libusb_handle, WINPR_ASSERTING_INT_CAST(uint8_t, EndpointAddress),
-			    Stream_Pointer(user_data->data), WINPR_ASSERTING_INT_CAST(int, BufferSize),
-			    func_bulk_transfer_cb, user_data, Timeout);
+			    Stream_Pointer(t->data), WINPR_ASSERTING_INT_CAST(int, BufferSize),
+			    func_transfer_cb, t, Timeout);
 			break;
 
 		case INTERRUPT_TRANSFER:
 			/**  Interrupt Transfer */
 			libusb_fill_interrupt_transfer(
 			    transfer, pdev->libusb_handle, WINPR_ASSERTING_INT_CAST(uint8_t, EndpointAddress),
-			    Stream_Pointer(user_data->data), WINPR_ASSERTING_INT_CAST(int, BufferSize),
-			    func_bulk_transfer_cb, user_data, Timeout);
+			    Stream_Pointer(t->data), WINPR_ASSERTING_INT_CAST(int, BufferSize),
+			    func_transfer_cb, t, Timeout);
 			break;
 
 		default:
@@ -1396,21 +1291,11 @@ static int libusb_udev_bulk_or_interrupt_transfer(IUDEVICE* idev,
 			           "urb_bulk_or_interrupt_transfer:"
 			           " other transfer type 0x%" PRIX32 "",
 			           transfer_type);
-			request_free(transfer);
+			urbdrc_transfer_discard(t);
 			return -1;
 	}
 
-	set_stream_id_for_buffer(transfer, streamID);
-
-	if (!ArrayList_Append(pdev->request_queue, transfer))
-	{
-		WLog_Print(urbdrc->log, WLOG_WARN,
-		           "Failed to queue transfer, streamID %08" PRIx32 " already in use!", streamID);
-		request_free(transfer);
-		return -1;
-	}
-	rc = libusb_submit_transfer(transfer);
-	if (log_libusb_result(urbdrc->log, WLOG_ERROR, "libusb_submit_transfer", rc))
+	if (!urbdrc_transfer_submit(t))
 		return -1;
 	return rc;
 }
@@ -1438,46 +1323,26 @@ static int func_cancel_xact_request(URBDRC_PLUGIN* urbdrc, struct libusb_transfe
 static void libusb_udev_cancel_all_transfer_request(IUDEVICE* idev)
 {
 	UDEVICE* pdev = (UDEVICE*)idev;
-	size_t count = 0;
 
-	if (!pdev || !pdev->request_queue || !pdev->urbdrc)
+	if (!pdev || !pdev->transfers || !pdev->urbdrc)
 		return;
 
-	ArrayList_Lock(pdev->request_queue);
-	count = ArrayList_Count(pdev->request_queue);
-
-	for (size_t x = 0; x < count; x++)
-	{
-		struct libusb_transfer* transfer = ArrayList_GetItem(pdev->request_queue, x);
-		func_cancel_xact_request(pdev->urbdrc, transfer);
-	}
-
-	ArrayList_Unlock(pdev->request_queue);
+	urbdrc_transfer_engine_cancel_all(pdev->transfers);
 }
 
 static int libusb_udev_cancel_transfer_request(IUDEVICE* idev, UINT32 RequestId)
 {
 	int rc = -1;
 	UDEVICE* pdev = (UDEVICE*)idev;
-	struct libusb_transfer* transfer = NULL;
 	uint32_t cancelID1 = 0x40000000 | RequestId;
 	uint32_t cancelID2 = 0x80000000 | RequestId;
 
-	if (!idev || !pdev->urbdrc || !pdev->request_queue)
+	if (!idev || !pdev->urbdrc || !pdev->transfers)
 		return -1;
 
-	ArrayList_Lock(pdev->request_queue);
-	transfer = list_contains(pdev->request_queue, cancelID1);
-	if (!transfer)
-		transfer = list_contains(pdev->request_queue, cancelID2);
-
-	if (transfer)
-	{
-		URBDRC_PLUGIN* urbdrc = pdev->urbdrc;
-
-		rc = func_cancel_xact_request(urbdrc, transfer);
-	}
-	ArrayList_Unlock(pdev->request_queue);
+	rc = urbdrc_transfer_engine_cancel(pdev->transfers, cancelID1);
+	if (rc < 0)
+		rc = urbdrc_transfer_engine_cancel(pdev->transfers, cancelID2);
 	return rc;
 }
 
@@ -1536,10 +1401,12 @@ static void udev_free(IUDEVICE* idev)
 	 * poll_libusb_events
 	 */
 	Sleep(100);
+	if (udev->transfers)
+		(void)urbdrc_transfer_engine_flush(udev->transfers);
 
 	/* release all interface and  attach kernel driver */
 	udev->iface.attach_kernel_driver(idev);
-	ArrayList_Free(udev->request_queue);
+	urbdrc_transfer_engine_free(udev->transfers);
 	/* free the config descriptor that send from windows */
 	msusb_msconfig_free(udev->MsConfig);
 	libusb_unref_device(udev->libusb_dev);
@@ -1686,21 +1553,39 @@ static int udev_get_hub_handle(URBDRC_PLUGIN* urbdrc, libusb_context* ctx, UDEVI
 	return 0;
 }
 
-static void request_free(void* value)
+static BOOL request_submit(void* context, URBDRC_TRANSFER* transfer)
 {
-	ASYNC_TRANSFER_USER_DATA* user_data = NULL;
-	struct libusb_transfer* transfer = (struct libusb_transfer*)value;
-	if (!transfer)
-		return;
+	UDEVICE* pdev = (UDEVICE*)context;
+
+	WINPR_ASSERT(pdev);
+	WINPR_ASSERT(transfer);
+
+	const int rc = libusb_submit_transfer(transfer->backend);
+	return !log_libusb_result(pdev->urbdrc->log, WLOG_ERROR, "libusb_submit_transfer", rc);
+}
+
+static int request_cancel(void* context, URBDRC_TRANSFER* transfer)
+{
+	UDEVICE* pdev = (UDEVICE*)context;
+
+	WINPR_ASSERT(pdev);
+	WINPR_ASSERT(transfer);
 
-	user_data = (ASYNC_TRANSFER_USER_DATA*)transfer->user_data;
-	async_transfer_user_data_free(user_data);
-	transfer->user_data = NULL;
-	libusb_free_transfer(transfer);
+	return func_cancel_xact_request(pdev->urbdrc, transfer->backend);
+}
+
+static void request_free(WINPR_ATTR_UNUSED void* context, URBDRC_TRANSFER* transfer)
+{
+	WINPR_ASSERT(transfer);
+
+	free(transfer->context);
+	libusb_free_transfer(transfer->backend);
+	transfer->context = NULL;
+	transfer->backend = NULL;
 }
 
 static IUDEVICE* udev_init(URBDRC_PLUGIN* urbdrc, libusb_context* context, LIBUSB_DEVICE* device,
-                           BYTE bus_number, BYTE dev_number)
+                           BYTE bus_number, BYTE dev_number, size_t queueDepth)
 {
 	UDEVICE* pdev = NULL;
 	int status = LIBUSB_ERROR_OTHER;
@@ -1797,13 +1682,20 @@ static IUDEVICE* udev_init(URBDRC_PLUGIN* urbdrc, libusb_context* context, LIBUS
 	/* initialize pdev */
 	pdev->bus_number = bus_number;
 	pdev->dev_number = dev_number;
-	pdev->request_queue = ArrayList_New(TRUE);
+	{
+		const URBDRC_TRANSFER_BACKEND backend = { .context = pdev,
+			                                      .submit = request_submit,
+			                                      .cancel = request_cancel,
+			                                      .release = request_free,
+			                                      .cancelledStatus = LIBUSB_TRANSFER_CANCELLED,
+			                                      .errorStatus = LIBUSB_TRANSFER_ERROR };
+		pdev->transfers = urbdrc_transfer_engine_new(&backend, queueDepth,
+		                                             URBDRC_TRANSFER_DEFAULT_BATCH_SIZE);
+	}
 
-	if (!pdev->request_queue)
+	if (!pdev->transfers)
 		goto fail;
 
-	ArrayList_Object(pdev->request_queue)->fnObjectFree = request_free;
-
 	/* set config of windows */
 	pdev->MsConfig = msusb_msconfig_new();
 
@@ -1818,7 +1710,7 @@ fail:
 }
 
 size_t udev_new_by_id(URBDRC_PLUGIN* urbdrc, libusb_context* ctx, UINT16 idVendor, UINT16 idProduct,
-                      IUDEVICE*** devArray)
+                      size_t queueDepth, IUDEVICE*** devArray)
 {
 	WINPR_ASSERT(urbdrc);
 	WINPR_ASSERT(devArray);
@@ -1856,7 +1748,7 @@ size_t udev_new_by_id(URBDRC_PLUGIN* urbdrc, libusb_context* ctx, UINT16 idVendo
 		{
 			const uint8_t nr = libusb_get_bus_number(dev);
 			const uint8_t addr = libusb_get_device_address(dev);
-			array[num] = (PUDEVICE)udev_init(urbdrc, ctx, dev, nr, addr);
+			array[num] = (PUDEVICE)udev_init(urbdrc, ctx, dev, nr, addr, queueDepth);
 
 			if (array[num] != NULL)
 				num++;
@@ -1879,8 +1771,18 @@ fail:
 }
 
 IUDEVICE* udev_new_by_addr(URBDRC_PLUGIN* urbdrc, libusb_context* context, BYTE bus_number,
-                           BYTE dev_number)
+                           BYTE dev_number, size_t queueDepth)
 {
 	WLog_Print(urbdrc->log, WLOG_DEBUG, "bus:%d dev:%d", bus_number, dev_number);
-	return udev_init(urbdrc, context, NULL, bus_number, dev_number);
+	return udev_init(urbdrc, context, NULL, bus_number, dev_number, queueDepth);
+}
+
+size_t udev_flush_transfers(IUDEVICE* idev)
+{
+	UDEVICE* pdev = (UDEVICE*)idev;
+
+	if (!pdev || !pdev->transfers)
+		return 0;
+
+	return urbdrc_transfer_engine_flush(pdev->transfers);
 }
@@ -26,6 +26,7 @@
 
 #include "urbdrc_types.h"
 #include "urbdrc_main.h"
+#include "urbdrc_transfer.h"
 #include "msusb.h"
 
 typedef struct libusb_device LIBUSB_DEVICE;
@@ -62,16 +63,18 @@ typedef struct
 	MSUSB_CONFIG_DESCRIPTOR* MsConfig;
 	LIBUSB_CONFIG_DESCRIPTOR* LibusbConfig;
 
-	wArrayList* request_queue;
+	URBDRC_TRANSFER_ENGINE* transfers;
 
 	URBDRC_PLUGIN* urbdrc;
 } UDEVICE;
 typedef UDEVICE* PUDEVICE;
 
 size_t udev_new_by_id(URBDRC_PLUGIN* urbdrc, libusb_context* ctx, UINT16 idVendor, UINT16 idProduct,
-                      IUDEVICE*** devArray);
+                      size_t queueDepth, IUDEVICE*** devArray);
 IUDEVICE* udev_new_by_addr(URBDRC_PLUGIN* urbdrc, libusb_context* context, BYTE bus_number,
-                           BYTE dev_number);
+                           BYTE dev_number, size_t queueDepth);
+/** deliver the transfer completions collected during the last event handling pass */
+size_t udev_flush_transfers(IUDEVICE* idev);
 const char* usb_interface_class_to_string(uint8_t class);
 
 #endif /* FREERDP_CHANNEL_URBDRC_CLIENT_LIBUSB_UDEVICE_H */
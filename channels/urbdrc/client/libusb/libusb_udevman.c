@@ -77,6 +77,7 @@ typedef struct
 	UINT32 device_num;
 	UINT32 next_device_id;
 	UINT32 channel_id;
+	size_t queue_depth; /* transfers in flight per endpoint */
 
 	HANDLE devman_loading;
 	libusb_context* context;
@@ -160,7 +161,8 @@ static size_t udevman_register_udevice(IUDEVMAN* idevman, BYTE bus_number, BYTE
 	if (flag & UDEVMAN_FLAG_ADD_BY_ADDR)
 	{
 		UINT32 id = 0;
-		IUDEVICE* tdev = udev_new_by_addr(urbdrc, udevman->context, bus_number, dev_number);
+		IUDEVICE* tdev = udev_new_by_addr(urbdrc, udevman->context, bus_number, dev_number,
+		                                 udevman->queue_depth);
 
 		if (tdev == NULL)
 			return 0;
@@ -190,7 +192,8 @@ static size_t udevman_register_udevice(IUDEVMAN* idevman, BYTE bus_number, BYTE
 	{
 		addnum = 0;
 		/* register all device that match pid vid */
-		num = udev_new_by_id(urbdrc, udevman->context, idVendor, idProduct, &devArray);
+		num = udev_new_by_id(urbdrc, udevman->context, idVendor, idProduct, udevman->queue_depth,
+		                     &devArray);
 
 		if (num == 0)
 		{
@@ -770,6 +773,14 @@ static UINT urbdrc_udevman_parse_addin_args(UDEVMAN* udevman, const ADDIN_ARGV*
 		{
 			udevman->flags |= UDEVMAN_FLAG_ADD_BY_AUTO;
 		}
+		else if (_strnicmp(arg, "queue:", 6) == 0)
+		{
+			errno = 0;
+			const unsigned long val = strtoul(&arg[6], NULL, 0);
+			if ((errno != 0) || (val == 0) || (val > UINT16_MAX))
+				return ERROR_INVALID_DATA;
+			udevman->queue_depth = val;
+		}
 		else
 		{
 			const size_t len = strlen(arg);
@@ -858,6 +869,19 @@ static BOOL poll_libusb_events(UDEVMAN* udevman)
 	return rc > 0;
 }
 
+/* deliver completions collected during the last event pass, skipped while devices are
+ * (un)registered as that waits for this thread to process cancelled transfers */
+static void udevman_flush_transfers(UDEVMAN* udevman)
+{
+	if (WaitForSingleObject(udevman->devman_loading, 0) != WAIT_OBJECT_0)
+		return;
+
+	for (UDEVICE* dev = (UDEVICE*)udevman->head; dev; dev = (UDEVICE*)dev->next)
+		(void)udev_flush_transfers(&dev->iface);
+
+	(void)ReleaseMutex(udevman->devman_loading);
+}
+
 static DWORD WINAPI poll_thread(LPVOID lpThreadParameter)
 {
 	libusb_hotplug_callback_handle handle = 0;
@@ -882,6 +906,7 @@ static DWORD WINAPI poll_thread(LPVOID lpThreadParameter)
 	while (udevman->running)
 	{
 		poll_libusb_events(udevman);
+		udevman_flush_transfers(udevman);
 	}
 
 	if (hasHotplug)
@@ -890,6 +915,7 @@ static DWORD WINAPI poll_thread(LPVOID lpThreadParameter)
 	/* Process remaining usb events */
 	while (poll_libusb_events(udevman))
 		;
+	udevman_flush_transfers(udevman);
 
 	ExitThread(0);
 	return 0;
@@ -941,6 +967,7 @@ FREERDP_ENTRY_POINT(UINT VCAPITYPE libusb_freerdp_urbdrc_client_subsystem_entry(
 #endif
 
 	udevman->flags = UDEVMAN_FLAG_ADD_BY_VID_PID;
+	udevman->queue_depth = URBDRC_TRANSFER_DEFAULT_QUEUE_DEPTH;
 	udevman->devman_loading = CreateMutexA(NULL, FALSE, "devman_loading");
 
 	if (!udevman->devman_loading)
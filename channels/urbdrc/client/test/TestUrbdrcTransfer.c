@@ -0,0 +1,371 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+#include <winpr/collections.h>
+
+#include "urbdrc_transfer.h"
+
+#define TEST_STATUS_OK 0
+#define TEST_STATUS_ERROR 1
+#define TEST_STATUS_CANCELLED 3
+
+#define TEST_EP_IN 0x81
+#define TEST_EP_OUT 0x02
+
+/* loopback device, submitted transfers wait in a list until the test completes them */
+typedef struct
+{
+	wArrayList* submitted;
+	size_t submits;
+	size_t releases;
+	BOOL failSubmit;
+	BOOL cancelFinished;
+
+	UINT32 completed[256];
+	INT32 status[256];
+	size_t completions;
+	size_t reused;
+	const BYTE* buffers[256];
+} TestDevice;
+
+static BOOL test_submit(void* context, URBDRC_TRANSFER* transfer)
+{
+	TestDevice* dev = context;
+
+	dev->submits++;
+	if (dev->failSubmit)
+		return FALSE;
+	return ArrayList_Append(dev->submitted, transfer);
+}
+
+static int test_cancel(void* context, URBDRC_TRANSFER* transfer)
+{
+	TestDevice* dev = context;
+
+	if (dev->cancelFinished || !ArrayList_Contains(dev->submitted, transfer))
+		return -1;
+
+	/* a real device completes cancelled transfers asynchronously as well */
+	transfer->backend = transfer;
+	return 1;
+}
+
+static void test_release(void* context, URBDRC_TRANSFER* transfer)
+{
+	TestDevice* dev = context;
+
+	dev->releases++;
+	transfer->backend = NULL;
+}
+
+static void test_complete(URBDRC_TRANSFER* transfer)
+{
+	TestDevice* dev = transfer->context;
+
+	if (dev->completions >= ARRAYSIZE(dev->completed))
+		return;
+
+	for (size_t x = 0; x < dev->completions; x++)
+	{
+		if (transfer->data && (dev->buffers[x] == Stream_Buffer(transfer->data)))
+		{
+			dev->reused++;
+			break;
+		}
+	}
+
+	dev->completed[dev->completions] = transfer->streamID;
+	dev->status[dev->completions] = transfer->status;
+	dev->buffers[dev->completions] = transfer->data ? Stream_Buffer(transfer->data) : NULL;
+	dev->completions++;
+}
+
+/* complete the oldest submitted transfer, cancelled ones report the cancelled status */
+static BOOL test_device_complete_next(TestDevice* dev)
+{
+	if (ArrayList_Count(dev->submitted) == 0)
+		return FALSE;
+
+	URBDRC_TRANSFER* transfer = ArrayList_GetItem(dev->submitted, 0);
+	ArrayList_RemoveAt(dev->submitted, 0);
+	urbdrc_transfer_completed(transfer, transfer->backend ? TEST_STATUS_CANCELLED
+	                                                      : TEST_STATUS_OK);
+	return TRUE;
+}
+
+static URBDRC_TRANSFER_ENGINE* test_engine_new(TestDevice* dev, size_t depth, size_t batch)
+{
+	const URBDRC_TRANSFER_BACKEND backend = { .context = dev,
+		                                      .submit = test_submit,
+		                                      .cancel = test_cancel,
+		                                      .release = test_release,
+		                                      .cancelledStatus = TEST_STATUS_CANCELLED,
+		                                      .errorStatus = TEST_STATUS_ERROR };
+
+	memset(dev, 0, sizeof(TestDevice));
+	dev->submitted = ArrayList_New(FALSE);
+	if (!dev->submitted)
+		return NULL;
+	return urbdrc_transfer_engine_new(&backend, depth, batch);
+}
+
+static void test_engine_free(TestDevice* dev, URBDRC_TRANSFER_ENGINE* engine)
+{
+	urbdrc_transfer_engine_free(engine);
+	ArrayList_Free(dev->submitted);
+}
+
+static BOOL test_submit_transfer(TestDevice* dev, URBDRC_TRANSFER_ENGINE* engine, UINT32 streamID,
+                                 BYTE endpoint)
+{
+	URBDRC_TRANSFER* transfer =
+	    urbdrc_transfer_new(engine, streamID, endpoint, 512, test_complete, dev);
+	if (!transfer)
+		return FALSE;
+	return urbdrc_transfer_submit(transfer);
+}
+
+static BOOL test_queue_depth(void)
+{
+	BOOL rc = FALSE;
+	TestDevice dev;
+	URBDRC_TRANSFER_ENGINE* engine = test_engine_new(&dev, 4, 64);
+	if (!engine)
+		goto fail;
+
+	for (UINT32 x = 0; x < 10; x++)
+	{
+		if (!test_submit_transfer(&dev, engine, x, TEST_EP_IN))
+			goto fail;
+	}
+	if (!test_submit_transfer(&dev, engine, 100, TEST_EP_OUT))
+		goto fail;
+
+	/* the other endpoint is not blocked by the full one */
+	if ((urbdrc_transfer_engine_in_flight(engine, TEST_EP_IN) != 4) ||
+	    (urbdrc_transfer_engine_queued(engine, TEST_EP_IN) != 6) ||
+	    (urbdrc_transfer_engine_in_flight(engine, TEST_EP_OUT) != 1) || (dev.submits != 5))
+	{
+		(void)fprintf(stderr, "%s: unexpected queue state\n", __func__);
+		goto fail;
+	}
+
+	/* completions wait for the flush and refill the endpoint */
+	if (!test_device_complete_next(&dev) || (dev.completions != 0) ||
+	    (urbdrc_transfer_engine_in_flight(engine, TEST_EP_IN) != 4) ||
+	    (urbdrc_transfer_engine_queued(engine, TEST_EP_IN) != 5))
+	{
+		(void)fprintf(stderr, "%s: completion did not refill the endpoint\n", __func__);
+		goto fail;
+	}
+
+	while (test_device_complete_next(&dev))
+		;
+	if (urbdrc_transfer_engine_flush(engine) != 11)
+		goto fail;
+
+	/* submission order is kept per endpoint */
+	for (size_t x = 0, in = 0; x < dev.completions; x++)
+	{
+		if (dev.status[x] != TEST_STATUS_OK)
+			goto fail;
+		if (dev.completed[x] == 100)
+			continue;
+		if (dev.completed[x] != in++)
+		{
+			(void)fprintf(stderr, "%s: completion %" PRIuz " out of order\n", __func__, x);
+			goto fail;
+		}
+	}
+
+	if ((dev.releases != 11) || (urbdrc_transfer_engine_in_flight(engine, TEST_EP_IN) != 0))
+		goto fail;
+
+	/* buffers returned by the completions are handed out again */
+	if (!test_submit_transfer(&dev, engine, 200, TEST_EP_IN) || !test_device_complete_next(&dev) ||
+	    (urbdrc_transfer_engine_flush(engine) != 1) || (dev.reused != 1))
+	{
+		(void)fprintf(stderr, "%s: transfer buffer was not reused\n", __func__);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	test_engine_free(&dev, engine);
+	return rc;
+}
+
+static BOOL test_batch(void)
+{
+	BOOL rc = FALSE;
+	TestDevice dev;
+	URBDRC_TRANSFER_ENGINE* engine = test_engine_new(&dev, 32, 3);
+	if (!engine)
+		goto fail;
+
+	for (UINT32 x = 0; x < 7; x++)
+	{
+		if (!test_submit_transfer(&dev, engine, x, TEST_EP_IN))
+			goto fail;
+	}
+
+	/* a full batch is delivered right away */
+	for (size_t x = 0; x < 7; x++)
+	{
+		if (!test_device_complete_next(&dev))
+			goto fail;
+		if (dev.completions != ((x + 1) / 3) * 3)
+		{
+			(void)fprintf(stderr, "%s: %" PRIuz " completions after %" PRIuz "\n", __func__,
+			              dev.completions, x + 1);
+			goto fail;
+		}
+	}
+
+	if ((urbdrc_transfer_engine_flush(engine) != 1) || (dev.completions != 7))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	test_engine_free(&dev, engine);
+	return rc;
+}
+
+static BOOL test_cancel_transfers(void)
+{
+	BOOL rc = FALSE;
+	TestDevice dev;
+	URBDRC_TRANSFER_ENGINE* engine = test_engine_new(&dev, 2, 64);
+	if (!engine)
+		goto fail;
+
+	for (UINT32 x = 0; x < 5; x++)
+	{
+		if (!test_submit_transfer(&dev, engine, x, TEST_EP_IN))
+			goto fail;
+	}
+
+	/* a queued transfer completes as cancelled without reaching the device */
+	if ((urbdrc_transfer_engine_cancel(engine, 3) != 1) ||
+	    (urbdrc_transfer_engine_queued(engine, TEST_EP_IN) != 2) || (dev.submits != 2))
+		goto fail;
+	if (urbdrc_transfer_engine_cancel(engine, 42) != -1)
+		goto fail;
+
+	/* one in flight is cancelled by the device, the queue moves up */
+	if (urbdrc_transfer_engine_cancel(engine, 0) != 1)
+		goto fail;
+	while (test_device_complete_next(&dev))
+		;
+	if ((urbdrc_transfer_engine_flush(engine) != 5) || (dev.submits != 4))
+		goto fail;
+
+	const UINT32 expected[] = { 3, 0, 1, 2, 4 };
+	const INT32 status[] = { TEST_STATUS_CANCELLED, TEST_STATUS_CANCELLED, TEST_STATUS_OK,
+		                     TEST_STATUS_OK, TEST_STATUS_OK };
+	for (size_t x = 0; x < ARRAYSIZE(expected); x++)
+	{
+		if ((dev.completed[x] != expected[x]) || (dev.status[x] != status[x]))
+		{
+			(void)fprintf(stderr, "%s: completion %" PRIuz " is %" PRIu32 "/%" PRId32 "\n",
+			              __func__, x, dev.completed[x], dev.status[x]);
+			goto fail;
+		}
+	}
+
+	/* cancel all drops the queue and cancels what is in flight */
+	dev.completions = 0;
+	for (UINT32 x = 10; x < 15; x++)
+	{
+		if (!test_submit_transfer(&dev, engine, x, TEST_EP_IN))
+			goto fail;
+	}
+	urbdrc_transfer_engine_cancel_all(engine);
+	if ((urbdrc_transfer_engine_queued(engine, TEST_EP_IN) != 0) || (dev.submits != 6))
+		goto fail;
+	while (test_device_complete_next(&dev))
+		;
+	if ((urbdrc_transfer_engine_flush(engine) != 5) || (dev.submits != 6))
+		goto fail;
+	for (size_t x = 0; x < dev.completions; x++)
+	{
+		if (dev.status[x] != TEST_STATUS_CANCELLED)
+			goto fail;
+	}
+
+	/* the device finished it already */
+	if (!test_submit_transfer(&dev, engine, 20, TEST_EP_IN))
+		goto fail;
+	dev.cancelFinished = TRUE;
+	if (urbdrc_transfer_engine_cancel(engine, 20) != -1)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	test_engine_free(&dev, engine);
+	return rc;
+}
+
+static BOOL test_submit_failure(void)
+{
+	BOOL rc = FALSE;
+	TestDevice dev;
+	URBDRC_TRANSFER_ENGINE* engine = test_engine_new(&dev, 1, 64);
+	if (!engine)
+		goto fail;
+
+	/* a direct submission failure is reported to the caller */
+	dev.failSubmit = TRUE;
+	if (test_submit_transfer(&dev, engine, 1, TEST_EP_OUT) || (dev.releases != 1) ||
+	    (urbdrc_transfer_engine_in_flight(engine, TEST_EP_OUT) != 0))
+		goto fail;
+
+	/* a queued one can only fail with a completion */
+	dev.failSubmit = FALSE;
+	if (!test_submit_transfer(&dev, engine, 2, TEST_EP_OUT) ||
+	    !test_submit_transfer(&dev, engine, 3, TEST_EP_OUT) ||
+	    !test_submit_transfer(&dev, engine, 4, TEST_EP_OUT))
+		goto fail;
+	dev.failSubmit = TRUE;
+	if (!test_device_complete_next(&dev))
+		goto fail;
+	if ((urbdrc_transfer_engine_flush(engine) != 3) ||
+	    (urbdrc_transfer_engine_in_flight(engine, TEST_EP_OUT) != 0) ||
+	    (urbdrc_transfer_engine_queued(engine, TEST_EP_OUT) != 0))
+		goto fail;
+	if ((dev.status[0] != TEST_STATUS_OK) || (dev.status[1] != TEST_STATUS_ERROR) ||
+	    (dev.status[2] != TEST_STATUS_ERROR))
+		goto fail;
+
+	/* transfers still pending are released with the engine */
+	dev.failSubmit = FALSE;
+	if (!test_submit_transfer(&dev, engine, 5, TEST_EP_OUT) ||
+	    !test_submit_transfer(&dev, engine, 6, TEST_EP_OUT))
+		goto fail;
+	urbdrc_transfer_engine_free(engine);
+	engine = NULL;
+	if ((dev.releases != 6) || (dev.completions != 3))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	test_engine_free(&dev, engine);
+	return rc;
+}
+
+int TestUrbdrcTransfer(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_queue_depth())
+		return -1;
+	if (!test_batch())
+		return -1;
+	if (!test_cancel_transfers())
+		return -1;
+	if (!test_submit_failure())
+		return -1;
+	return 0;
+}
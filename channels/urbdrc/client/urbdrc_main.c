@@ -1054,13 +1054,13 @@ UINT stream_write_and_free(IWTSPlugin* plugin, IWTSVirtualChannel* channel, wStr
 
 	if (!channel || !out || !urbdrc)
 	{
-		Stream_Free(out, TRUE);
+		Stream_Release(out);
 		return ERROR_INVALID_PARAMETER;
 	}
 
 	if (!channel->Write)
 	{
-		Stream_Free(out, TRUE);
+		Stream_Release(out);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -1069,6 +1069,6 @@ UINT stream_write_and_free(IWTSPlugin* plugin, IWTSVirtualChannel* channel, wStr
 	UINT rc = ERROR_INTERNAL_ERROR;
 	if (len <= UINT32_MAX)
 		rc = channel->Write(channel, (UINT32)len, Stream_Buffer(out), NULL);
-	Stream_Free(out, TRUE);
+	Stream_Release(out);
 	return rc;
 }
@@ -0,0 +1,414 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX USB Redirection, asynchronous transfer engine
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/collections.h>
+#include <winpr/synch.h>
+
+#include <freerdp/types.h>
+#include <freerdp/channels/log.h>
+
+#include "urbdrc_transfer.h"
+
+#define TAG CHANNELS_TAG("urbdrc.client")
+
+/* endpoint numbers 0-15 in both directions */
+#define URBDRC_TRANSFER_ENDPOINTS 32
+#define URBDRC_TRANSFER_POOL_SIZE 4096
+
+enum
+{
+	URBDRC_TRANSFER_STATE_NEW,
+	URBDRC_TRANSFER_STATE_QUEUED,
+	URBDRC_TRANSFER_STATE_IN_FLIGHT,
+	URBDRC_TRANSFER_STATE_COMPLETED
+};
+
+typedef struct
+{
+	size_t inFlight;
+	wArrayList* queued;
+} URBDRC_TRANSFER_ENDPOINT;
+
+struct s_urbdrc_transfer_engine
+{
+	URBDRC_TRANSFER_BACKEND backend;
+	size_t queueDepth;
+	size_t batchSize;
+
+	/* protects everything but the pool, flushLock keeps completions in order */
+	CRITICAL_SECTION lock;
+	CRITICAL_SECTION flushLock;
+
+	wStreamPool* pool;
+	wArrayList* transfers; /* queued and in flight */
+	wQueue* completed;     /* waiting for the next flush */
+	URBDRC_TRANSFER_ENDPOINT endpoints[URBDRC_TRANSFER_ENDPOINTS];
+};
+
+static URBDRC_TRANSFER_ENDPOINT* transfer_endpoint(URBDRC_TRANSFER_ENGINE* engine, BYTE endpoint)
+{
+	WINPR_ASSERT(engine);
+	return &engine->endpoints[(endpoint & 0x0F) | ((endpoint & 0x80) >> 3)];
+}
+
+static void transfer_release(URBDRC_TRANSFER* transfer)
+{
+	if (!transfer)
+		return;
+
+	URBDRC_TRANSFER_ENGINE* engine = transfer->engine;
+	WINPR_ASSERT(engine);
+
+	if (engine->backend.release)
+		engine->backend.release(engine->backend.context, transfer);
+	if (transfer->data)
+		Stream_Release(transfer->data);
+	free(transfer);
+}
+
+/* must be called with the engine lock held, returns TRUE if the batch is full */
+static BOOL transfer_finish(URBDRC_TRANSFER* transfer, INT32 status)
+{
+	URBDRC_TRANSFER_ENGINE* engine = transfer->engine;
+	URBDRC_TRANSFER_ENDPOINT* ep = transfer_endpoint(engine, transfer->endpoint);
+
+	if (transfer->state == URBDRC_TRANSFER_STATE_IN_FLIGHT)
+	{
+		WINPR_ASSERT(ep->inFlight > 0);
+		ep->inFlight--;
+	}
+
+	transfer->status = status;
+	transfer->state = URBDRC_TRANSFER_STATE_COMPLETED;
+	ArrayList_Remove(engine->transfers, transfer);
+
+	if (!Queue_Enqueue(engine->completed, transfer))
+	{
+		/* can only fail on allocation, drop the completion rather than leaking it */
+		WLog_ERR(TAG, "failed to queue completion of transfer %08" PRIx32, transfer->streamID);
+		transfer_release(transfer);
+	}
+
+	return Queue_Count(engine->completed) >= engine->batchSize;
+}
+
+/* submit queued transfers of the endpoint as long as the queue depth allows */
+static BOOL transfer_submit_queued(URBDRC_TRANSFER_ENGINE* engine, URBDRC_TRANSFER_ENDPOINT* ep)
+{
+	BOOL flush = FALSE;
+
+	for (;;)
+	{
+		URBDRC_TRANSFER* next = NULL;
+
+		EnterCriticalSection(&engine->lock);
+		if ((ep->inFlight < engine->queueDepth) && (ArrayList_Count(ep->queued) > 0))
+		{
+			next = ArrayList_GetItem(ep->queued, 0);
+			ArrayList_RemoveAt(ep->queued, 0);
+			next->state = URBDRC_TRANSFER_STATE_IN_FLIGHT;
+			ep->inFlight++;
+		}
+		LeaveCriticalSection(&engine->lock);
+
+		if (!next)
+			return flush;
+
+		if (!engine->backend.submit(engine->backend.context, next))
+		{
+			EnterCriticalSection(&engine->lock);
+			flush |= transfer_finish(next, engine->backend.errorStatus);
+			LeaveCriticalSection(&engine->lock);
+		}
+	}
+}
+
+URBDRC_TRANSFER_ENGINE* urbdrc_transfer_engine_new(const URBDRC_TRANSFER_BACKEND* backend,
+                                                   size_t queueDepth, size_t batchSize)
+{
+	WINPR_ASSERT(backend);
+	WINPR_ASSERT(backend->submit);
+	WINPR_ASSERT(backend->cancel);
+
+	URBDRC_TRANSFER_ENGINE* engine = calloc(1, sizeof(URBDRC_TRANSFER_ENGINE));
+	if (!engine)
+		return NULL;
+
+	engine->backend = *backend;
+	engine->queueDepth = MAX(queueDepth, 1);
+	engine->batchSize = MAX(batchSize, 1);
+	InitializeCriticalSection(&engine->lock);
+	InitializeCriticalSection(&engine->flushLock);
+
+	engine->pool = StreamPool_New(TRUE, URBDRC_TRANSFER_POOL_SIZE);
+	engine->transfers = ArrayList_New(FALSE);
+	engine->completed = Queue_New(FALSE, -1, -1);
+	if (!engine->pool || !engine->transfers || !engine->completed)
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(engine->endpoints); x++)
+	{
+		engine->endpoints[x].queued = ArrayList_New(FALSE);
+		if (!engine->endpoints[x].queued)
+			goto fail;
+	}
+
+	return engine;
+
+fail:
+	urbdrc_transfer_engine_free(engine);
+	return NULL;
+}
+
+void urbdrc_transfer_engine_free(URBDRC_TRANSFER_ENGINE* engine)
+{
+	if (!engine)
+		return;
+
+	/* whatever is left was cancelled by the owner, release it without completing */
+	if (engine->completed)
+	{
+		URBDRC_TRANSFER* transfer = NULL;
+		while ((transfer = Queue_Dequeue(engine->completed)))
+			transfer_release(transfer);
+	}
+
+	if (engine->transfers)
+	{
+		for (size_t x = 0; x < ArrayList_Count(engine->transfers); x++)
+			transfer_release(ArrayList_GetItem(engine->transfers, x));
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(engine->endpoints); x++)
+		ArrayList_Free(engine->endpoints[x].queued);
+
+	Queue_Free(engine->completed);
+	ArrayList_Free(engine->transfers);
+	StreamPool_Free(engine->pool);
+	DeleteCriticalSection(&engine->flushLock);
+	DeleteCriticalSection(&engine->lock);
+	free(engine);
+}
+
+URBDRC_TRANSFER* urbdrc_transfer_new(URBDRC_TRANSFER_ENGINE* engine, UINT32 streamID,
+                                     BYTE endpoint, size_t size,
+                                     urbdrc_transfer_complete_fn complete, void* context)
+{
+	WINPR_ASSERT(engine);
+
+	URBDRC_TRANSFER* transfer = calloc(1, sizeof(URBDRC_TRANSFER));
+	if (!transfer)
+		return NULL;
+
+	transfer->data = StreamPool_Take(engine->pool, MAX(size, 1));
+	if (!transfer->data)
+	{
+		free(transfer);
+		return NULL;
+	}
+
+	transfer->engine = engine;
+	transfer->streamID = streamID;
+	transfer->endpoint = endpoint;
+	transfer->complete = complete;
+	transfer->context = context;
+	transfer->state = URBDRC_TRANSFER_STATE_NEW;
+	return transfer;
+}
+
+void urbdrc_transfer_discard(URBDRC_TRANSFER* transfer)
+{
+	if (!transfer)
+		return;
+
+	WINPR_ASSERT(transfer->state == URBDRC_TRANSFER_STATE_NEW);
+	transfer_release(transfer);
+}
+
+BOOL urbdrc_transfer_submit(URBDRC_TRANSFER* transfer)
+{
+	WINPR_ASSERT(transfer);
+	WINPR_ASSERT(transfer->state == URBDRC_TRANSFER_STATE_NEW);
+
+	URBDRC_TRANSFER_ENGINE* engine = transfer->engine;
+	URBDRC_TRANSFER_ENDPOINT* ep = transfer_endpoint(engine, transfer->endpoint);
+	BOOL submit = FALSE;
+
+	EnterCriticalSection(&engine->lock);
+	if (!ArrayList_Append(engine->transfers, transfer))
+	{
+		LeaveCriticalSection(&engine->lock);
+		urbdrc_transfer_discard(transfer);
+		return FALSE;
+	}
+
+	/* queued transfers go first to keep the order of the endpoint */
+	if ((ArrayList_Count(ep->queued) == 0) && (ep->inFlight < engine->queueDepth))
+	{
+		transfer->state = URBDRC_TRANSFER_STATE_IN_FLIGHT;
+		ep->inFlight++;
+		submit = TRUE;
+	}
+	else if (ArrayList_Append(ep->queued, transfer))
+		transfer->state = URBDRC_TRANSFER_STATE_QUEUED;
+	else
+	{
+		ArrayList_Remove(engine->transfers, transfer);
+		LeaveCriticalSection(&engine->lock);
+		urbdrc_transfer_discard(transfer);
+		return FALSE;
+	}
+	LeaveCriticalSection(&engine->lock);
+
+	if (submit && !engine->backend.submit(engine->backend.context, transfer))
+	{
+		EnterCriticalSection(&engine->lock);
+		ArrayList_Remove(engine->transfers, transfer);
+		ep->inFlight--;
+		transfer->state = URBDRC_TRANSFER_STATE_NEW;
+		LeaveCriticalSection(&engine->lock);
+
+		urbdrc_transfer_discard(transfer);
+		if (transfer_submit_queued(engine, ep))
+			urbdrc_transfer_engine_flush(engine);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void urbdrc_transfer_completed(URBDRC_TRANSFER* transfer, INT32 status)
+{
+	WINPR_ASSERT(transfer);
+
+	URBDRC_TRANSFER_ENGINE* engine = transfer->engine;
+	URBDRC_TRANSFER_ENDPOINT* ep = transfer_endpoint(engine, transfer->endpoint);
+
+	EnterCriticalSection(&engine->lock);
+	BOOL flush = transfer_finish(transfer, status);
+	LeaveCriticalSection(&engine->lock);
+
+	flush |= transfer_submit_queued(engine, ep);
+	if (flush)
+		urbdrc_transfer_engine_flush(engine);
+}
+
+size_t urbdrc_transfer_engine_flush(URBDRC_TRANSFER_ENGINE* engine)
+{
+	size_t count = 0;
+
+	WINPR_ASSERT(engine);
+
+	EnterCriticalSection(&engine->flushLock);
+	for (;;)
+	{
+		EnterCriticalSection(&engine->lock);
+		URBDRC_TRANSFER* transfer = Queue_Dequeue(engine->completed);
+		LeaveCriticalSection(&engine->lock);
+
+		if (!transfer)
+			break;
+
+		if (transfer->complete)
+			transfer->complete(transfer);
+		transfer_release(transfer);
+		count++;
+	}
+	LeaveCriticalSection(&engine->flushLock);
+
+	return count;
+}
+
+int urbdrc_transfer_engine_cancel(URBDRC_TRANSFER_ENGINE* engine, UINT32 streamID)
+{
+	int rc = -1;
+
+	WINPR_ASSERT(engine);
+
+	EnterCriticalSection(&engine->lock);
+	for (size_t x = 0; x < ArrayList_Count(engine->transfers); x++)
+	{
+		URBDRC_TRANSFER* transfer = ArrayList_GetItem(engine->transfers, x);
+		if (transfer->streamID != streamID)
+			continue;
+
+		if (transfer->state == URBDRC_TRANSFER_STATE_QUEUED)
+		{
+			URBDRC_TRANSFER_ENDPOINT* ep = transfer_endpoint(engine, transfer->endpoint);
+			ArrayList_Remove(ep->queued, transfer);
+			(void)transfer_finish(transfer, engine->backend.cancelledStatus);
+			rc = 1;
+		}
+		else
+			rc = engine->backend.cancel(engine->backend.context, transfer);
+		break;
+	}
+	LeaveCriticalSection(&engine->lock);
+
+	return rc;
+}
+
+void urbdrc_transfer_engine_cancel_all(URBDRC_TRANSFER_ENGINE* engine)
+{
+	WINPR_ASSERT(engine);
+
+	EnterCriticalSection(&engine->lock);
+
+	/* drop the queues first, cancelled transfers in flight must not submit queued ones */
+	for (size_t x = 0; x < ARRAYSIZE(engine->endpoints); x++)
+	{
+		wArrayList* queued = engine->endpoints[x].queued;
+		while (ArrayList_Count(queued) > 0)
+		{
+			URBDRC_TRANSFER* transfer = ArrayList_GetItem(queued, 0);
+			ArrayList_RemoveAt(queued, 0);
+			(void)transfer_finish(transfer, engine->backend.cancelledStatus);
+		}
+	}
+
+	/* backwards, a backend completing synchronously removes the transfer from the list */
+	for (size_t x = ArrayList_Count(engine->transfers); x > 0; x--)
+	{
+		URBDRC_TRANSFER* transfer = ArrayList_GetItem(engine->transfers, x - 1);
+		(void)engine->backend.cancel(engine->backend.context, transfer);
+	}
+
+	LeaveCriticalSection(&engine->lock);
+}
+
+size_t urbdrc_transfer_engine_in_flight(URBDRC_TRANSFER_ENGINE* engine, BYTE endpoint)
+{
+	WINPR_ASSERT(engine);
+
+	EnterCriticalSection(&engine->lock);
+	const size_t count = transfer_endpoint(engine, endpoint)->inFlight;
+	LeaveCriticalSection(&engine->lock);
+	return count;
+}
+
+size_t urbdrc_transfer_engine_queued(URBDRC_TRANSFER_ENGINE* engine, BYTE endpoint)
+{
+	WINPR_ASSERT(engine);
+
+	EnterCriticalSection(&engine->lock);
+	const size_t count = ArrayList_Count(transfer_endpoint(engine, endpoint)->queued);
+	LeaveCriticalSection(&engine->lock);
+	return count;
+}
@@ -0,0 +1,116 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX USB Redirection, asynchronous transfer engine
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_URBDRC_CLIENT_TRANSFER_H
+#define FREERDP_CHANNEL_URBDRC_CLIENT_TRANSFER_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+/** default number of transfers in flight per endpoint, more are queued until one completes */
+#define URBDRC_TRANSFER_DEFAULT_QUEUE_DEPTH 32
+/** completions are delivered at the latest when this many are waiting */
+#define URBDRC_TRANSFER_DEFAULT_BATCH_SIZE 64
+
+typedef struct s_urbdrc_transfer_engine URBDRC_TRANSFER_ENGINE;
+typedef struct s_urbdrc_transfer URBDRC_TRANSFER;
+
+/** @brief Called from urbdrc_transfer_engine_flush for every completed transfer.
+ *
+ *  The callback may take ownership of \b transfer->data by setting it to \b NULL,
+ *  everything else is released by the engine afterwards.
+ */
+typedef void (*urbdrc_transfer_complete_fn)(URBDRC_TRANSFER* transfer);
+
+struct s_urbdrc_transfer
+{
+	UINT32 streamID;
+	BYTE endpoint;
+	INT32 status;  /* backend status, valid once completed */
+	wStream* data; /* transfer buffer taken from the engine pool */
+	void* backend; /* backend transfer, e.g. a struct libusb_transfer */
+	void* context; /* owner data, released by the backend */
+	urbdrc_transfer_complete_fn complete;
+
+	URBDRC_TRANSFER_ENGINE* engine;
+	DWORD state;
+};
+
+/** The device side of the engine, e.g. libusb or the loopback backend of the tests */
+typedef struct
+{
+	void* context;
+	/** Start the transfer, the backend calls urbdrc_transfer_completed once it is done */
+	BOOL (*submit)(void* context, URBDRC_TRANSFER* transfer);
+	/** Abort a submitted transfer, it still completes through urbdrc_transfer_completed.
+	 *  Returns 1 on success, -1 if the transfer already finished and 0 on other errors */
+	int (*cancel)(void* context, URBDRC_TRANSFER* transfer);
+	/** Free \b transfer->backend and \b transfer->context */
+	void (*release)(void* context, URBDRC_TRANSFER* transfer);
+	/** status reported for queued transfers that were cancelled before submission */
+	INT32 cancelledStatus;
+	/** status reported for queued transfers the backend failed to submit */
+	INT32 errorStatus;
+} URBDRC_TRANSFER_BACKEND;
+
+URBDRC_TRANSFER_ENGINE* urbdrc_transfer_engine_new(const URBDRC_TRANSFER_BACKEND* backend,
+                                                   size_t queueDepth, size_t batchSize);
+void urbdrc_transfer_engine_free(URBDRC_TRANSFER_ENGINE* engine);
+
+/** @brief Create a transfer with a pooled buffer of at least \b size bytes at position 0 */
+URBDRC_TRANSFER* urbdrc_transfer_new(URBDRC_TRANSFER_ENGINE* engine, UINT32 streamID,
+                                     BYTE endpoint, size_t size,
+                                     urbdrc_transfer_complete_fn complete, void* context);
+
+/** @brief Release a transfer that was never submitted, including backend and context */
+void urbdrc_transfer_discard(URBDRC_TRANSFER* transfer);
+
+/** @brief Submit \b transfer or queue it if its endpoint has \b queueDepth transfers in flight.
+ *
+ *  Transfers of an endpoint are submitted and completed in order.
+ *
+ *  @return \b FALSE if the backend rejected it, the transfer is discarded then
+ */
+BOOL urbdrc_transfer_submit(URBDRC_TRANSFER* transfer);
+
+/** @brief Backend notification that \b transfer finished with \b status.
+ *
+ *  The next queued transfer of the endpoint is submitted, the completion is delivered by the
+ *  next urbdrc_transfer_engine_flush or right away once \b batchSize completions wait.
+ */
+void urbdrc_transfer_completed(URBDRC_TRANSFER* transfer, INT32 status);
+
+/** @brief Deliver all waiting completions, must be called after the backend handled events
+ *
+ *  @return the number of completions delivered
+ */
+size_t urbdrc_transfer_engine_flush(URBDRC_TRANSFER_ENGINE* engine);
+
+/** @brief Cancel the first unfinished transfer with \b streamID
+ *
+ *  @return -1 if there is none, otherwise the backend result or 1 for a queued transfer
+ */
+int urbdrc_transfer_engine_cancel(URBDRC_TRANSFER_ENGINE* engine, UINT32 streamID);
+void urbdrc_transfer_engine_cancel_all(URBDRC_TRANSFER_ENGINE* engine);
+
+/** @brief Number of submitted transfers not yet completed on \b endpoint */
+size_t urbdrc_transfer_engine_in_flight(URBDRC_TRANSFER_ENGINE* engine, BYTE endpoint);
+
+/** @brief Number of transfers queued on \b endpoint waiting for submission */
+size_t urbdrc_transfer_engine_queued(URBDRC_TRANSFER_ENGINE* engine, BYTE endpoint);
+
+#endif /* FREERDP_CHANNEL_URBDRC_CLIENT_TRANSFER_H */
@@ -43,6 +43,7 @@
 #include <winpr/config.h>
 #include <winpr/assert.h>
 #include <winpr/synch.h>
+#include <winpr/sysinfo.h>
 #include <freerdp/log.h>
 
 #include <SDL3/SDL.h>
@@ -910,6 +911,10 @@ static int sdl_run(SdlContext* sdl)
 						rectangles = sdl->pop();
 						sdl_draw_to_window(sdl, sdl->windows, rectangles);
 					} while (!rectangles.empty());
+					freerdp_latency_stats_frame(freerdp_get_latency_stats(sdl->context()),
+					                            FREERDP_LATENCY_FRAME_LAST,
+					                            FREERDP_LATENCY_STAGE_PRESENT,
+					                            winpr_GetTickCount64NS());
 				}
 				break;
 				case SDL_EVENT_USER_CREATE_WINDOWS:
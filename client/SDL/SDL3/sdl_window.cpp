@@ -20,6 +20,9 @@
 #include "sdl_window.hpp"
 #include "sdl_utils.hpp"
 
+/* Above this many dirty rectangles a single full window update is cheaper */
+static const size_t s_max_dirty_rects = 128;
+
 SdlWindow::SdlWindow(const std::string& title, Sint32 startupX, Sint32 startupY, Sint32 width,
                      Sint32 height, [[maybe_unused]] Uint32 flags)
 {
@@ -51,7 +54,8 @@ SdlWindow::SdlWindow(const std::string& title, Sint32 startupX, Sint32 startupY,
 }
 
 SdlWindow::SdlWindow(SdlWindow&& other) noexcept
-    : _window(other._window), _offset_x(other._offset_x), _offset_y(other._offset_y)
+    : _window(other._window), _offset_x(other._offset_x), _offset_y(other._offset_y),
+      _dirty(std::move(other._dirty))
 {
 	other._window = nullptr;
 }
@@ -208,6 +212,8 @@ bool SdlWindow::fill(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 	auto color = SDL_MapSurfaceRGBA(surface, r, g, b, a);
 
 	SDL_FillSurfaceRect(surface, &rect, color);
+	_dirty.clear();
+	_dirty.push_back(rect);
 	return true;
 }
 
@@ -225,10 +231,22 @@ bool SdlWindow::blit(SDL_Surface* surface, const SDL_Rect& srcRect, SDL_Rect& ds
 		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "SDL_BlitScaled: %s", SDL_GetError());
 		return false;
 	}
+
+	/* the clip rectangle is the part of dstRect inside the window */
+	SDL_Rect clip = {};
+	if (SDL_GetSurfaceClipRect(screen, &clip) && !SDL_RectEmpty(&clip))
+		_dirty.push_back(clip);
 	return true;
 }
 
 void SdlWindow::updateSurface()
 {
-	SDL_UpdateWindowSurface(_window);
+	if (_dirty.empty())
+		return;
+
+	if (_dirty.size() > s_max_dirty_rects)
+		SDL_UpdateWindowSurface(_window);
+	else
+		SDL_UpdateWindowSurfaceRects(_window, _dirty.data(), static_cast<int>(_dirty.size()));
+	_dirty.clear();
 }
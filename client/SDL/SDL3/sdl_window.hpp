@@ -20,6 +20,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <SDL3/SDL.h>
 
 #include <freerdp/settings_types.h>
@@ -59,6 +60,8 @@ class SdlWindow
 
 	bool fill(Uint8 r = 0x00, Uint8 g = 0x00, Uint8 b = 0x00, Uint8 a = 0xff);
 	bool blit(SDL_Surface* surface, const SDL_Rect& src, SDL_Rect& dst);
+
+	/** Present the areas drawn by \b fill and \b blit since the last call */
 	void updateSurface();
 
   private:
@@ -68,4 +71,5 @@ class SdlWindow
 	SDL_Window* _window = nullptr;
 	Sint32 _offset_x = 0;
 	Sint32 _offset_y = 0;
+	std::vector<SDL_Rect> _dirty;
 };
@@ -99,6 +99,7 @@
 #include "xf_disp.h"
 #include "xf_video.h"
 #include "xf_monitor.h"
+#include "xf_shm.h"
 #include "xf_graphics.h"
 #include "xf_keyboard.h"
 #include "xf_channels.h"
@@ -424,9 +425,9 @@ static BOOL xf_paint(xfContext* xfc, const GDI_RGN* region)
 	}
 	else
 	{
-		XPutImage(xfc->display, xfc->primary, xfc->gc, xfc->image, region->x, region->y, region->x,
-		          region->y, WINPR_ASSERTING_INT_CAST(UINT16, region->w),
-		          WINPR_ASSERTING_INT_CAST(UINT16, region->h));
+		xf_shm_put_image(xfc, xfc->primaryImage, xfc->primary, xfc->gc, region->x, region->y,
+		                 region->x, region->y, WINPR_ASSERTING_INT_CAST(UINT16, region->w),
+		                 WINPR_ASSERTING_INT_CAST(UINT16, region->h));
 		xf_draw_screen(xfc, region->x, region->y, region->w, region->h);
 	}
 	return TRUE;
@@ -473,6 +474,9 @@ static BOOL xf_end_paint(rdpContext* context)
 		xf_unlock_x11(xfc);
 	}
 
+	/* gdi draws the next frame to the same buffer */
+	xf_shm_image_wait(xfc, xfc->primaryImage);
+
 	hdc->hwnd->invalid->null = TRUE;
 	hdc->hwnd->ninvalid = 0;
 	return TRUE;
@@ -485,33 +489,28 @@ static BOOL xf_sw_desktop_resize(rdpContext* context)
 	rdpSettings* settings = context->settings;
 	BOOL ret = FALSE;
 
-	if (!gdi_resize(gdi, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
-	                freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight)))
+	const UINT32 width = freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth);
+	const UINT32 height = freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight);
+	const UINT32 stride = width * FreeRDPGetBytesPerPixel(gdi->dstFormat);
+	xfShmImage* image = xf_shm_image_new(xfc, width, height, stride);
+
+	if (!image)
 		return FALSE;
 
 	/* Do not lock during gdi_resize, there might still be drawing operations in progress.
 	 * locking will deadlock. */
-	xf_lock_x11(xfc);
-	if (xfc->image)
-	{
-		xfc->image->data = NULL;
-		XDestroyImage(xfc->image);
-	}
-
-	WINPR_ASSERT(xfc->depth != 0);
-	if (!(xfc->image = XCreateImage(
-	          xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth), ZPixmap, 0,
-	          (char*)gdi->primary_buffer, WINPR_ASSERTING_INT_CAST(uint32_t, gdi->width),
-	          WINPR_ASSERTING_INT_CAST(uint32_t, gdi->height), xfc->scanline_pad,
-	          WINPR_ASSERTING_INT_CAST(int, gdi->stride))))
+	if (!gdi_resize_ex(gdi, width, height, stride, gdi->dstFormat, (BYTE*)image->image->data,
+	                   NULL))
 	{
-		goto out;
+		xf_shm_image_free(xfc, image);
+		return FALSE;
 	}
 
-	xfc->image->byte_order = LSBFirst;
-	xfc->image->bitmap_bit_order = LSBFirst;
+	xf_lock_x11(xfc);
+	xf_shm_image_free(xfc, xfc->primaryImage);
+	xfc->primaryImage = image;
+	xfc->image = image->image;
 	ret = xf_desktop_resize(context);
-out:
 	xf_unlock_x11(xfc);
 	return ret;
 }
@@ -728,15 +727,23 @@ BOOL xf_create_image(xfContext* xfc)
 		rdpGdi* cgdi = xfc->common.context.gdi;
 		WINPR_ASSERT(cgdi);
 
-		WINPR_ASSERT(xfc->depth != 0);
-		xfc->image =
-		    XCreateImage(xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth),
-		                 ZPixmap, 0, (char*)cgdi->primary_buffer,
-		                 freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
-		                 freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight),
-		                 xfc->scanline_pad, WINPR_ASSERTING_INT_CAST(int, cgdi->stride));
-		xfc->image->byte_order = LSBFirst;
-		xfc->image->bitmap_bit_order = LSBFirst;
+		const UINT32 width = freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth);
+		const UINT32 height = freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight);
+		xfShmImage* image = xf_shm_image_new(xfc, width, height, cgdi->stride);
+
+		if (!image)
+			return FALSE;
+
+		/* gdi draws to the image buffer, shared with the X server if possible */
+		if (!gdi_resize_ex(cgdi, width, height, cgdi->stride, cgdi->dstFormat,
+		                   (BYTE*)image->image->data, NULL))
+		{
+			xf_shm_image_free(xfc, image);
+			return FALSE;
+		}
+
+		xfc->primaryImage = image;
+		xfc->image = image->image;
 	}
 	return TRUE;
 }
@@ -757,12 +764,9 @@ static void xf_window_free(xfContext* xfc)
 	}
 #endif
 
-	if (xfc->image)
-	{
-		xfc->image->data = NULL;
-		XDestroyImage(xfc->image);
-		xfc->image = NULL;
-	}
+	xf_shm_image_free(xfc, xfc->primaryImage);
+	xfc->primaryImage = NULL;
+	xfc->image = NULL;
 
 	if (xfc->bitmap_mono)
 	{
@@ -946,6 +950,8 @@ static void xf_check_extensions(xfContext* context)
 		}
 	}
 #endif
+
+	(void)xf_shm_init(context);
 }
 
 #ifdef WITH_XI
@@ -1859,6 +1865,7 @@ void xf_teardown_x11(xfContext* xfc)
 
 	if (xfc->display)
 	{
+		xf_shm_uninit(xfc);
 		XCloseDisplay(xfc->display);
 		xfc->display = NULL;
 	}
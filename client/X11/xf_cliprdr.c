@@ -37,6 +37,9 @@
 #include <winpr/stream.h>
 #include <winpr/clipboard.h>
 #include <winpr/path.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
 
 #include <freerdp/utils/signal.h>
 #include <freerdp/log.h>
@@ -54,6 +57,11 @@
 
 #define MAX_CLIPBOARD_FORMATS 255
 
+/* selections larger than this are handed out with the INCR protocol */
+#define XF_CLIPRDR_INCR_CHUNK_SIZE (256 * 1024)
+/* INCR transfers without progress are dropped after this many milliseconds */
+#define XF_CLIPRDR_INCR_TIMEOUT 10000
+
 #ifdef WITH_DEBUG_CLIPRDR
 #define DEBUG_CLIPRDR(...) WLog_DBG(TAG, __VA_ARGS__)
 #else
@@ -76,8 +84,19 @@ typedef struct
 {
 	BYTE* data;
 	UINT32 data_length;
+	LONG refs;
 } xfCachedData;
 
+typedef struct
+{
+	Window requestor;
+	Atom property;
+	Atom target;
+	xfCachedData* data;
+	size_t offset;
+	UINT64 lastActivity;
+} xfIncrTransfer;
+
 typedef struct
 {
 	UINT32 localFormat;
@@ -131,7 +150,10 @@ struct xf_clipboard
 	BOOL incr_starts;
 	BYTE* incr_data;
 	size_t incr_data_length;
+	size_t incr_data_capacity;
 	long event_mask;
+	wArrayList* incr_transfers;
+	size_t incr_chunk_size;
 
 	/* XFixes extension */
 	int xfixes_event_base;
@@ -210,10 +232,22 @@ static void xf_cached_data_free(void* ptr)
 	if (!cached_data)
 		return;
 
+	/* entries stay alive while INCR transfers hand them out */
+	if (InterlockedDecrement(&cached_data->refs) > 0)
+		return;
+
 	free(cached_data->data);
 	free(cached_data);
 }
 
+static xfCachedData* xf_cached_data_ref(xfCachedData* cached_data)
+{
+	WINPR_ASSERT(cached_data);
+
+	InterlockedIncrement(&cached_data->refs);
+	return cached_data;
+}
+
 static xfCachedData* xf_cached_data_new(BYTE* data, size_t data_length)
 {
 	if (data_length > UINT32_MAX)
@@ -225,6 +259,7 @@ static xfCachedData* xf_cached_data_new(BYTE* data, size_t data_length)
 
 	cached_data->data = data;
 	cached_data->data_length = (UINT32)data_length;
+	cached_data->refs = 1;
 
 	return cached_data;
 }
@@ -1078,11 +1113,17 @@ static BOOL append(xfClipboard* clipboard, const void* sdata, size_t length)
 	WINPR_ASSERT(clipboard);
 
 	const size_t size = length + clipboard->incr_data_length + 2;
-	BYTE* data = realloc(clipboard->incr_data, size);
-	if (!data)
-		return FALSE;
-	clipboard->incr_data = data;
-	memcpy(&data[clipboard->incr_data_length], sdata, length);
+	if (size > clipboard->incr_data_capacity)
+	{
+		/* grow geometrically, huge selections arrive in many small chunks */
+		const size_t capacity = MAX(size, clipboard->incr_data_capacity * 2);
+		BYTE* data = realloc(clipboard->incr_data, capacity);
+		if (!data)
+			return FALSE;
+		clipboard->incr_data = data;
+		clipboard->incr_data_capacity = capacity;
+	}
+	memcpy(&clipboard->incr_data[clipboard->incr_data_length], sdata, length);
 	clipboard->incr_data_length += length;
 	clipboard->incr_data[clipboard->incr_data_length + 0] = '\0';
 	clipboard->incr_data[clipboard->incr_data_length + 1] = '\0';
@@ -1170,6 +1211,14 @@ static BOOL xf_cliprdr_get_requested_data(xfClipboard* clipboard, Atom target)
 	LogTagAndXDeleteProperty(TAG, xfc->display, xfc->drawable, clipboard->property_atom);
 	xf_cliprdr_process_requested_data(clipboard, has_data, clipboard->incr_data, len);
 
+	/* do not keep the buffer of a large transfer around */
+	if (!clipboard->incr_starts && (clipboard->incr_data_capacity > XF_CLIPRDR_INCR_CHUNK_SIZE))
+	{
+		free(clipboard->incr_data);
+		clipboard->incr_data = NULL;
+		clipboard->incr_data_capacity = 0;
+	}
+
 	return TRUE;
 }
 
@@ -1224,8 +1273,119 @@ static void xf_cliprdr_provide_timestamp(xfClipboard* clipboard, const XSelectio
 	}
 }
 
+static void xf_incr_transfer_free(void* obj)
+{
+	xfIncrTransfer* transfer = obj;
+
+	if (!transfer)
+		return;
+
+	xf_cached_data_free(transfer->data);
+	free(transfer);
+}
+
+/* Hand out the next chunk of an INCR transfer, a zero length chunk ends the transfer */
+static BOOL xf_cliprdr_continue_incr_transfer(xfClipboard* clipboard, xfIncrTransfer* transfer)
+{
+	WINPR_ASSERT(clipboard);
+	WINPR_ASSERT(transfer);
+
+	xfContext* xfc = clipboard->xfc;
+	WINPR_ASSERT(xfc);
+
+	const size_t length =
+	    MIN(clipboard->incr_chunk_size, transfer->data->data_length - transfer->offset);
+
+	LogTagAndXChangeProperty(TAG, xfc->display, transfer->requestor, transfer->property,
+	                         transfer->target, 8, PropModeReplace,
+	                         &transfer->data->data[transfer->offset],
+	                         WINPR_ASSERTING_INT_CAST(int32_t, length));
+	XFlush(xfc->display);
+
+	transfer->offset += length;
+	transfer->lastActivity = GetTickCount64();
+	return length > 0;
+}
+
+static void xf_cliprdr_start_incr_transfer(xfClipboard* clipboard, const XSelectionEvent* respond,
+                                           xfCachedData* cached_data)
+{
+	WINPR_ASSERT(clipboard);
+	WINPR_ASSERT(respond);
+	WINPR_ASSERT(cached_data);
+
+	xfContext* xfc = clipboard->xfc;
+	WINPR_ASSERT(xfc);
+
+	xfIncrTransfer* transfer = calloc(1, sizeof(xfIncrTransfer));
+	if (!transfer)
+		return;
+
+	transfer->requestor = respond->requestor;
+	transfer->property = respond->property;
+	transfer->target = respond->target;
+	transfer->data = xf_cached_data_ref(cached_data);
+	transfer->lastActivity = GetTickCount64();
+
+	ArrayList_Lock(clipboard->incr_transfers);
+
+	/* drop transfers of requestors that went away */
+	for (size_t x = ArrayList_Count(clipboard->incr_transfers); x > 0; x--)
+	{
+		const xfIncrTransfer* cur = ArrayList_GetItem(clipboard->incr_transfers, x - 1);
+		if ((cur->requestor == transfer->requestor) ||
+		    (transfer->lastActivity - cur->lastActivity > XF_CLIPRDR_INCR_TIMEOUT))
+			ArrayList_RemoveAt(clipboard->incr_transfers, x - 1);
+	}
+
+	if (!ArrayList_Append(clipboard->incr_transfers, transfer))
+	{
+		ArrayList_Unlock(clipboard->incr_transfers);
+		xf_incr_transfer_free(transfer);
+		return;
+	}
+
+	/* the requestor deletes the property to ask for the next chunk */
+	XSelectInput(xfc->display, transfer->requestor, PropertyChangeMask);
+
+	const long size = WINPR_ASSERTING_INT_CAST(long, cached_data->data_length);
+	LogTagAndXChangeProperty(TAG, xfc->display, transfer->requestor, transfer->property,
+	                         clipboard->incr_atom, 32, PropModeReplace, (const BYTE*)&size, 1);
+	ArrayList_Unlock(clipboard->incr_transfers);
+}
+
+static BOOL xf_cliprdr_process_incr_transfer(xfClipboard* clipboard, const XPropertyEvent* xevent)
+{
+	BOOL handled = FALSE;
+
+	WINPR_ASSERT(clipboard);
+	WINPR_ASSERT(xevent);
+
+	if (xevent->state != PropertyDelete)
+		return FALSE;
+
+	ArrayList_Lock(clipboard->incr_transfers);
+	for (size_t x = 0; x < ArrayList_Count(clipboard->incr_transfers); x++)
+	{
+		xfIncrTransfer* transfer = ArrayList_GetItem(clipboard->incr_transfers, x);
+		if ((transfer->requestor != xevent->window) || (transfer->property != xevent->atom))
+			continue;
+
+		if (!xf_cliprdr_continue_incr_transfer(clipboard, transfer))
+		{
+			XSelectInput(clipboard->xfc->display, transfer->requestor, NoEventMask);
+			ArrayList_RemoveAt(clipboard->incr_transfers, x);
+		}
+		handled = TRUE;
+		break;
+	}
+	ArrayList_Unlock(clipboard->incr_transfers);
+
+	return handled;
+}
+
 static void xf_cliprdr_provide_data(xfClipboard* clipboard, const XSelectionEvent* respond,
-                                    const BYTE* data, UINT32 size)
+                                    xfCachedData* cached_data)
 {
 	xfContext* xfc = NULL;
 
@@ -1236,9 +1396,18 @@ static void xf_cliprdr_provide_data(xfClipboard* clipboard, const XSelectionEven
 
 	if (respond->property != None)
 	{
+		if (cached_data && (cached_data->data_length > clipboard->incr_chunk_size))
+		{
+			xf_cliprdr_start_incr_transfer(clipboard, respond, cached_data);
+			return;
+		}
+
 		LogTagAndXChangeProperty(TAG, xfc->display, respond->requestor, respond->property,
-		                         respond->target, 8, PropModeReplace, data,
-		                         WINPR_ASSERTING_INT_CAST(int32_t, size));
+		                         respond->target, 8, PropModeReplace,
+		                         cached_data ? cached_data->data : NULL,
+		                         cached_data ? WINPR_ASSERTING_INT_CAST(int32_t,
+		                                                                cached_data->data_length)
+		                                     : 0);
 	}
 }
 
@@ -1609,8 +1778,7 @@ static BOOL xf_cliprdr_process_selection_request(xfClipboard* clipboard,
 				respond->property = xevent->property;
 
 				// NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-				xf_cliprdr_provide_data(clipboard, respond, cached_data->data,
-				                        cached_data->data_length);
+				xf_cliprdr_provide_data(clipboard, respond, cached_data);
 			}
 			else if (clipboard->respond)
 			{
@@ -1684,6 +1852,9 @@ static BOOL xf_cliprdr_process_property_notify(xfClipboard* clipboard, const XPr
 	WINPR_ASSERT(xfc);
 	WINPR_ASSERT(xevent);
 
+	if (xf_cliprdr_process_incr_transfer(clipboard, xevent))
+		return TRUE;
+
 	if (xevent->atom == clipboard->timestamp_property_atom)
 	{
 		/* This is the response to the property change we did
@@ -2309,6 +2480,13 @@ xf_cliprdr_server_format_data_response(CliprdrClientContext* context,
 					DstSize = (UINT32)diff;
 				}
 			}
+
+			/* the original data is cached below, do not keep a third copy around. File lists
+			 * stay as the file delegate works on them */
+			const UINT32 fileGroupId =
+			    ClipboardGetFormatId(clipboard->system, type_FileGroupDescriptorW);
+			if (srcFormatId != (INT64)fileGroupId)
+				ClipboardEmpty(clipboard->system);
 		}
 	}
 	ClipboardUnlock(clipboard->system);
@@ -2357,7 +2535,7 @@ xf_cliprdr_server_format_data_response(CliprdrClientContext* context,
 
 	// clipboard->cachedRawData owns cached_raw_data
 	// NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-	xf_cliprdr_provide_data(clipboard, clipboard->respond, pDstData, DstSize);
+	xf_cliprdr_provide_data(clipboard, clipboard->respond, cached_data);
 	{
 		union
 		{
@@ -2620,6 +2798,22 @@ xfClipboard* xf_clipboard_new(xfContext* xfc, BOOL relieveFilenameRestriction)
 	obj = HashTable_ValueObject(clipboard->cachedRawData);
 	obj->fnObjectFree = xf_cached_data_free;
 
+	clipboard->incr_transfers = ArrayList_New(TRUE);
+	if (!clipboard->incr_transfers)
+		goto fail;
+
+	obj = ArrayList_Object(clipboard->incr_transfers);
+	obj->fnObjectFree = xf_incr_transfer_free;
+
+	{
+		/* ICCCM: data that does not fit into a single request must use INCR */
+		long maxRequest = XExtendedMaxRequestSize(xfc->display);
+		if (maxRequest == 0)
+			maxRequest = XMaxRequestSize(xfc->display);
+		const size_t maxBytes = (size_t)MAX(maxRequest, 1024) * 4 - 100;
+		clipboard->incr_chunk_size = MIN(XF_CLIPRDR_INCR_CHUNK_SIZE, maxBytes);
+	}
+
 	return clipboard;
 
 fail:
@@ -2650,6 +2844,7 @@ void xf_clipboard_free(xfClipboard* clipboard)
 
 	ClipboardDestroy(clipboard->system);
 	xf_clipboard_formats_free(clipboard);
+	ArrayList_Free(clipboard->incr_transfers);
 	HashTable_Free(clipboard->cachedRawData);
 	HashTable_Free(clipboard->cachedData);
 	requested_format_free(&clipboard->requestedFormat);
@@ -40,6 +40,7 @@
 #include "xf_gfx.h"
 #include "xf_graphics.h"
 #include "xf_utils.h"
+#include "xf_shm.h"
 
 #include "xf_debug.h"
 #include "xf_event.h"
@@ -1185,6 +1186,10 @@ BOOL xf_event_process(freerdp* instance, const XEvent* event)
 	rdpSettings* settings = xfc->common.context.settings;
 	WINPR_ASSERT(settings);
 
+	/* presentation buffer released, nothing else to do */
+	if (xf_shm_handle_xevent(xfc, event))
+		return TRUE;
+
 	if (xfc->remote_app)
 	{
 		xfAppWindow* appWindow = xf_AppWindowFromX11Window(xfc, event->xany.window);
@@ -25,10 +25,12 @@
 
 #include <winpr/assert.h>
 #include <winpr/cast.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 #include "xf_gfx.h"
 #include "xf_rail.h"
+#include "xf_shm.h"
 
 #include <X11/Xutil.h>
 
@@ -94,10 +96,11 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 
 		if (xfc->remote_app)
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image,
-			          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
-			          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
-			          dwidth, dheight);
+			xf_shm_put_image(xfc, surface->image, xfc->primary, xfc->gc,
+			                 WINPR_ASSERTING_INT_CAST(int, nXSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nYSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nXDst),
+			                 WINPR_ASSERTING_INT_CAST(int, nYDst), dwidth, dheight);
 			xf_lock_x11(xfc);
 			xf_rail_paint_surface(xfc, surface->gdi.windowId, rect);
 			xf_unlock_x11(xfc);
@@ -107,10 +110,11 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 		    if (freerdp_settings_get_bool(settings, FreeRDP_SmartSizing) ||
 		        freerdp_settings_get_bool(settings, FreeRDP_MultiTouchGestures))
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image,
-			          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
-			          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
-			          dwidth, dheight);
+			xf_shm_put_image(xfc, surface->image, xfc->primary, xfc->gc,
+			                 WINPR_ASSERTING_INT_CAST(int, nXSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nYSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nXDst),
+			                 WINPR_ASSERTING_INT_CAST(int, nYDst), dwidth, dheight);
 			xf_draw_screen(xfc, WINPR_ASSERTING_INT_CAST(int32_t, nXDst),
 			               WINPR_ASSERTING_INT_CAST(int32_t, nYDst),
 			               WINPR_ASSERTING_INT_CAST(int32_t, dwidth),
@@ -119,10 +123,11 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 		else
 #endif
 		{
-			XPutImage(xfc->display, xfc->drawable, xfc->gc, surface->image,
-			          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
-			          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
-			          dwidth, dheight);
+			xf_shm_put_image(xfc, surface->image, xfc->drawable, xfc->gc,
+			                 WINPR_ASSERTING_INT_CAST(int, nXSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nYSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nXDst),
+			                 WINPR_ASSERTING_INT_CAST(int, nYDst), dwidth, dheight);
 		}
 	}
 
@@ -130,7 +135,12 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 fail:
 	region16_clear(&surface->gdi.invalidRegion);
 	XSetClipMask(xfc->display, xfc->gc, None);
-	XSync(xfc->display, False);
+
+	/* the decoder may write to the surface once the server is done reading it */
+	if (surface->image->shared)
+		xf_shm_image_wait(xfc, surface->image);
+	else
+		XSync(xfc->display, False);
 	return rc;
 }
 
@@ -184,6 +194,10 @@ static UINT xf_UpdateSurfaces(RdpgfxClientContext* context)
 
 	free(pSurfaceIds);
 	LeaveCriticalSection(&context->mux);
+
+	if (status == CHANNEL_RC_OK)
+		freerdp_latency_stats_frame(freerdp_get_latency_stats(gdi->context), gdi->frameId,
+		                            FREERDP_LATENCY_STAGE_PRESENT, winpr_GetTickCount64NS());
 	return status;
 }
 
@@ -326,58 +340,48 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 	surface->gdi.scanline = surface->gdi.width * FreeRDPGetBytesPerPixel(surface->gdi.format);
 	surface->gdi.scanline = x11_pad_scanline(surface->gdi.scanline,
 	                                         WINPR_ASSERTING_INT_CAST(uint32_t, xfc->scanline_pad));
-	size = 1ull * surface->gdi.scanline * surface->gdi.height;
-	surface->gdi.data = (BYTE*)winpr_aligned_malloc(size, 16);
-
-	if (!surface->gdi.data)
-	{
-		WLog_ERR(TAG, "unable to allocate GDI data");
-		goto out_free;
-	}
-
-	ZeroMemory(surface->gdi.data, size);
-
 	if (FreeRDPAreColorFormatsEqualNoAlpha(gdi->dstFormat, surface->gdi.format))
 	{
-		WINPR_ASSERT(xfc->depth != 0);
-		surface->image = XCreateImage(
-		    xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth), ZPixmap, 0,
-		    (char*)surface->gdi.data, surface->gdi.mappedWidth, surface->gdi.mappedHeight,
-		    xfc->scanline_pad, WINPR_ASSERTING_INT_CAST(int, surface->gdi.scanline));
+		surface->image = xf_shm_image_new(xfc, surface->gdi.mappedWidth, surface->gdi.height,
+		                                  surface->gdi.scanline);
+		if (!surface->image)
+		{
+			WLog_ERR(TAG, "unable to allocate GDI data");
+			goto out_free;
+		}
+
+		surface->gdi.data = (BYTE*)surface->image->image->data;
 	}
 	else
 	{
+		size = 1ull * surface->gdi.scanline * surface->gdi.height;
+		surface->gdi.data = (BYTE*)winpr_aligned_malloc(size, 16);
+
+		if (!surface->gdi.data)
+		{
+			WLog_ERR(TAG, "unable to allocate GDI data");
+			goto out_free;
+		}
+
+		ZeroMemory(surface->gdi.data, size);
+
 		UINT32 width = surface->gdi.width;
 		UINT32 bytes = FreeRDPGetBytesPerPixel(gdi->dstFormat);
 		surface->stageScanline = width * bytes;
 		surface->stageScanline = x11_pad_scanline(
 		    surface->stageScanline, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->scanline_pad));
-		size = 1ull * surface->stageScanline * surface->gdi.height;
-		surface->stage = (BYTE*)winpr_aligned_malloc(size, 16);
+		surface->image = xf_shm_image_new(xfc, surface->gdi.mappedWidth, surface->gdi.height,
+		                                  surface->stageScanline);
 
-		if (!surface->stage)
+		if (!surface->image)
 		{
 			WLog_ERR(TAG, "unable to allocate stage buffer");
 			goto out_free_gdidata;
 		}
 
-		ZeroMemory(surface->stage, size);
-		WINPR_ASSERT(xfc->depth != 0);
-		surface->image = XCreateImage(
-		    xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth), ZPixmap, 0,
-		    (char*)surface->stage, surface->gdi.mappedWidth, surface->gdi.mappedHeight,
-		    xfc->scanline_pad, WINPR_ASSERTING_INT_CAST(int, surface->stageScanline));
-	}
-
-	if (!surface->image)
-	{
-		WLog_ERR(TAG, "an error occurred when creating the XImage");
-		goto error_surface_image;
+		surface->stage = (BYTE*)surface->image->image->data;
 	}
 
-	surface->image->byte_order = LSBFirst;
-	surface->image->bitmap_bit_order = LSBFirst;
-
 	region16_init(&surface->gdi.invalidRegion);
 
 	if (context->SetSurfaceData(context, surface->gdi.surfaceId, (void*)surface) != CHANNEL_RC_OK)
@@ -388,10 +392,9 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 
 	return CHANNEL_RC_OK;
 error_set_surface_data:
-	surface->image->data = NULL;
-	XDestroyImage(surface->image);
-error_surface_image:
-	winpr_aligned_free(surface->stage);
+	xf_shm_image_free(xfc, surface->image);
+	if (!surface->stage)
+		goto out_free;
 out_free_gdidata:
 	winpr_aligned_free(surface->gdi.data);
 out_free:
@@ -410,6 +413,10 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 	rdpCodecs* codecs = NULL;
 	xfGfxSurface* surface = NULL;
 	UINT status = 0;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
+	xfContext* xfc = (xfContext*)gdi->context;
+
+	(void)gdi_graphics_pipeline_release_surface(context, deleteSurface->surfaceId);
 	EnterCriticalSection(&context->mux);
 	surface = (xfGfxSurface*)context->GetSurfaceData(context, deleteSurface->surfaceId);
 
@@ -421,10 +428,9 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 #ifdef WITH_GFX_H264
 		h264_context_free(surface->gdi.h264);
 #endif
-		surface->image->data = NULL;
-		XDestroyImage(surface->image);
-		winpr_aligned_free(surface->gdi.data);
-		winpr_aligned_free(surface->stage);
+		if (surface->stage)
+			winpr_aligned_free(surface->gdi.data);
+		xf_shm_image_free(xfc, surface->image);
 		region16_uninit(&surface->gdi.invalidRegion);
 		codecs = surface->gdi.codecs;
 		free(surface);
@@ -32,7 +32,7 @@ struct xf_gfx_surface
 	gdiGfxSurface gdi;
 	BYTE* stage;
 	UINT32 stageScanline;
-	XImage* image;
+	xfShmImage* image; /* owns stage, or gdi.data if no stage is required */
 };
 typedef struct xf_gfx_surface xfGfxSurface;
 
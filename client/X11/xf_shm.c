@@ -0,0 +1,351 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM presentation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/cast.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
+
+#ifdef WITH_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+#include <X11/Xutil.h>
+
+#include <freerdp/log.h>
+
+#include "xf_shm.h"
+
+#define TAG CLIENT_TAG("x11")
+
+/* how long to wait for a ShmCompletion event before assuming the request failed */
+#define XF_SHM_WAIT_TIMEOUT_MS 100
+
+#ifdef WITH_XSHM
+static volatile BOOL xf_shm_attach_failed = FALSE;
+
+static int xf_shm_error_handler(Display* display, XErrorEvent* event)
+{
+	WINPR_UNUSED(display);
+	WINPR_UNUSED(event);
+	xf_shm_attach_failed = TRUE;
+	return 0;
+}
+
+/* The extension might be announced by displays that do not share our memory, e.g. a remote
+ * display or one in a different IPC namespace. Attach a small segment to find out. */
+static BOOL xf_shm_probe(xfContext* xfc)
+{
+	BOOL rc = FALSE;
+	XShmSegmentInfo segment = { 0 };
+
+	segment.shmid = shmget(IPC_PRIVATE, 4096, IPC_CREAT | 0600);
+	if (segment.shmid < 0)
+		return FALSE;
+
+	segment.shmaddr = shmat(segment.shmid, NULL, 0);
+	if (segment.shmaddr == (char*)-1)
+		goto fail;
+
+	segment.readOnly = True;
+	xf_shm_attach_failed = FALSE;
+	XSync(xfc->display, False);
+	XErrorHandler handler = XSetErrorHandler(xf_shm_error_handler);
+	const Status status = XShmAttach(xfc->display, &segment);
+	XSync(xfc->display, False);
+	(void)XSetErrorHandler(handler);
+
+	if (status && !xf_shm_attach_failed)
+	{
+		XShmDetach(xfc->display, &segment);
+		XSync(xfc->display, False);
+		rc = TRUE;
+	}
+
+	(void)shmdt(segment.shmaddr);
+fail:
+	(void)shmctl(segment.shmid, IPC_RMID, NULL);
+	return rc;
+}
+#endif
+
+BOOL xf_shm_init(xfContext* xfc)
+{
+	WINPR_ASSERT(xfc);
+
+	xfc->shmAvailable = FALSE;
+#ifdef WITH_XSHM
+	if (!XShmQueryExtension(xfc->display))
+		return FALSE;
+
+	if (!xf_shm_probe(xfc))
+	{
+		WLog_INFO(TAG, "MIT-SHM not usable with this display, using XPutImage");
+		return FALSE;
+	}
+
+	xfc->shmImages = ArrayList_New(TRUE);
+	if (!xfc->shmImages)
+		return FALSE;
+
+	xfc->shmCompletionEvent = XShmGetEventBase(xfc->display) + ShmCompletion;
+	xfc->shmAvailable = TRUE;
+	WLog_DBG(TAG, "MIT-SHM available");
+#endif
+	return xfc->shmAvailable;
+}
+
+void xf_shm_uninit(xfContext* xfc)
+{
+	WINPR_ASSERT(xfc);
+
+	ArrayList_Free(xfc->shmImages);
+	xfc->shmImages = NULL;
+	xfc->shmAvailable = FALSE;
+}
+
+#ifdef WITH_XSHM
+static BOOL xf_shm_image_attach(xfContext* xfc, xfShmImage* image, size_t size)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(image);
+
+	image->segment.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+	if (image->segment.shmid < 0)
+		return FALSE;
+
+	image->segment.shmaddr = shmat(image->segment.shmid, NULL, 0);
+	if (image->segment.shmaddr == (char*)-1)
+	{
+		(void)shmctl(image->segment.shmid, IPC_RMID, NULL);
+		return FALSE;
+	}
+
+	image->segment.readOnly = True;
+	if (!XShmAttach(xfc->display, &image->segment))
+	{
+		(void)shmdt(image->segment.shmaddr);
+		(void)shmctl(image->segment.shmid, IPC_RMID, NULL);
+		return FALSE;
+	}
+
+	/* The segment is released automatically once both sides detached */
+	XSync(xfc->display, False);
+	(void)shmctl(image->segment.shmid, IPC_RMID, NULL);
+
+	if (!ArrayList_Append(xfc->shmImages, image))
+	{
+		XShmDetach(xfc->display, &image->segment);
+		XSync(xfc->display, False);
+		(void)shmdt(image->segment.shmaddr);
+		return FALSE;
+	}
+
+	image->image->data = image->segment.shmaddr;
+	image->image->obdata = (char*)&image->segment;
+	image->shared = TRUE;
+	return TRUE;
+}
+#endif
+
+xfShmImage* xf_shm_image_new(xfContext* xfc, UINT32 width, UINT32 height, UINT32 scanline)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(xfc->depth != 0);
+
+	const size_t size = 1ull * scanline * height;
+	xfShmImage* image = calloc(1, sizeof(xfShmImage));
+	if (!image)
+		return NULL;
+
+	image->image =
+	    XCreateImage(xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth),
+	                 ZPixmap, 0, NULL, width, height, xfc->scanline_pad,
+	                 WINPR_ASSERTING_INT_CAST(int, scanline));
+	if (!image->image)
+		goto fail;
+
+	image->image->byte_order = LSBFirst;
+	image->image->bitmap_bit_order = LSBFirst;
+
+#ifdef WITH_XSHM
+	if (xfc->shmAvailable)
+	{
+		/* The server derives the row stride of a shared image from its width, so the width
+		 * must cover the whole scanline. Rectangles are only ever taken from the mapped area. */
+		const int bpp = image->image->bits_per_pixel;
+		const int pad = xfc->scanline_pad;
+
+		if ((bpp > 0) && (pad > 0) && ((8ull * scanline) % (UINT32)bpp == 0) &&
+		    ((8ull * scanline) % (UINT32)pad == 0))
+		{
+			const UINT32 total = WINPR_ASSERTING_INT_CAST(UINT32, 8ull * scanline / (UINT32)bpp);
+			image->image->width = WINPR_ASSERTING_INT_CAST(int, total);
+			if (!xf_shm_image_attach(xfc, image, size))
+			{
+				WLog_WARN(TAG, "failed to share a %" PRIuz " byte image, using XPutImage", size);
+				image->image->width = WINPR_ASSERTING_INT_CAST(int, width);
+			}
+		}
+	}
+#endif
+
+	if (!image->shared)
+	{
+		image->image->data = winpr_aligned_malloc(size, 16);
+		if (!image->image->data)
+			goto fail;
+	}
+
+	ZeroMemory(image->image->data, size);
+	return image;
+
+fail:
+	xf_shm_image_free(xfc, image);
+	return NULL;
+}
+
+void xf_shm_image_free(xfContext* xfc, xfShmImage* image)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!image)
+		return;
+
+	if (image->image)
+	{
+#ifdef WITH_XSHM
+		if (image->shared)
+		{
+			xf_shm_image_wait(xfc, image);
+			ArrayList_Remove(xfc->shmImages, image);
+			XShmDetach(xfc->display, &image->segment);
+			XSync(xfc->display, False);
+			(void)shmdt(image->segment.shmaddr);
+		}
+		else
+#endif
+			winpr_aligned_free(image->image->data);
+
+		image->image->data = NULL;
+		image->image->obdata = NULL;
+		XDestroyImage(image->image);
+	}
+
+	free(image);
+}
+
+void xf_shm_put_image(xfContext* xfc, xfShmImage* image, Drawable drawable, GC gc, int src_x,
+                      int src_y, int dst_x, int dst_y, unsigned int width, unsigned int height)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(image);
+
+#ifdef WITH_XSHM
+	if (image->shared)
+	{
+		(void)InterlockedIncrement(&image->pending);
+		if (XShmPutImage(xfc->display, drawable, gc, image->image, src_x, src_y, dst_x, dst_y,
+		                 width, height, True))
+			return;
+
+		(void)InterlockedDecrement(&image->pending);
+	}
+#endif
+
+	XPutImage(xfc->display, drawable, gc, image->image, src_x, src_y, dst_x, dst_y, width,
+	          height);
+}
+
+void xf_shm_image_wait(xfContext* xfc, xfShmImage* image)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(image);
+
+	/* XPutImage copies the data to the request buffer */
+	if (!image->shared)
+		return;
+
+#ifdef WITH_XSHM
+	BOOL synced = FALSE;
+	const UINT64 start = GetTickCount64();
+	while (InterlockedCompareExchange(&image->pending, 0, 0) > 0)
+	{
+		XEvent event = { 0 };
+
+		if (XCheckTypedEvent(xfc->display, xfc->shmCompletionEvent, &event))
+		{
+			(void)xf_shm_handle_xevent(xfc, &event);
+			continue;
+		}
+
+		/* Once synced all completions are either queued or taken by the event thread */
+		if (!synced)
+		{
+			XSync(xfc->display, False);
+			synced = TRUE;
+			continue;
+		}
+
+		if (GetTickCount64() - start > XF_SHM_WAIT_TIMEOUT_MS)
+		{
+			WLog_WARN(TAG, "missing %" PRId32 " ShmCompletion events", image->pending);
+			(void)InterlockedExchange(&image->pending, 0);
+			break;
+		}
+		Sleep(1);
+	}
+#endif
+}
+
+BOOL xf_shm_handle_xevent(xfContext* xfc, const XEvent* event)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(event);
+
+#ifdef WITH_XSHM
+	if (!xfc->shmAvailable || (event->type != xfc->shmCompletionEvent))
+		return FALSE;
+
+	const XShmCompletionEvent* completion = (const XShmCompletionEvent*)event;
+
+	ArrayList_Lock(xfc->shmImages);
+	for (size_t i = 0; i < ArrayList_Count(xfc->shmImages); i++)
+	{
+		xfShmImage* image = ArrayList_GetItem(xfc->shmImages, i);
+
+		if (image->segment.shmseg == completion->shmseg)
+		{
+			if (InterlockedCompareExchange(&image->pending, 0, 0) > 0)
+				(void)InterlockedDecrement(&image->pending);
+			break;
+		}
+	}
+	ArrayList_Unlock(xfc->shmImages);
+	return TRUE;
+#else
+	WINPR_UNUSED(xfc);
+	WINPR_UNUSED(event);
+	return FALSE;
+#endif
+}
@@ -0,0 +1,59 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM presentation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FREERDP_CLIENT_X11_SHM_H
+#define FREERDP_CLIENT_X11_SHM_H
+
+#include <X11/Xlib.h>
+
+#ifdef WITH_XSHM
+#include <X11/extensions/XShm.h>
+#endif
+
+#include <winpr/wtypes.h>
+
+#include "xfreerdp.h"
+
+/** An XImage with a buffer owned by the image, in a MIT-SHM segment attached to the X server
+ *  if the display supports it and in private memory otherwise. */
+struct xf_shm_image
+{
+	XImage* image;
+	BOOL shared;
+	volatile LONG pending; /* XShmPutImage requests without ShmCompletion event */
+#ifdef WITH_XSHM
+	XShmSegmentInfo segment;
+#endif
+};
+
+BOOL xf_shm_init(xfContext* xfc);
+void xf_shm_uninit(xfContext* xfc);
+
+void xf_shm_image_free(xfContext* xfc, xfShmImage* image);
+
+WINPR_ATTR_MALLOC(xf_shm_image_free, 2)
+xfShmImage* xf_shm_image_new(xfContext* xfc, UINT32 width, UINT32 height, UINT32 scanline);
+
+/** Copy a rectangle of \b image to \b drawable, with XShmPutImage if the image is shared */
+void xf_shm_put_image(xfContext* xfc, xfShmImage* image, Drawable drawable, GC gc, int src_x,
+                      int src_y, int dst_x, int dst_y, unsigned int width, unsigned int height);
+
+/** Wait until the X server finished reading \b image, the buffer may be modified afterwards */
+void xf_shm_image_wait(xfContext* xfc, xfShmImage* image);
+
+BOOL xf_shm_handle_xevent(xfContext* xfc, const XEvent* event);
+
+#endif /* FREERDP_CLIENT_X11_SHM_H */
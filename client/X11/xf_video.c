@@ -23,6 +23,7 @@
 #include <freerdp/gdi/video.h>
 
 #include "xf_video.h"
+#include "xf_shm.h"
 
 #include <freerdp/log.h>
 #define TAG CLIENT_TAG("video")
@@ -30,7 +31,7 @@
 typedef struct
 {
 	VideoSurface base;
-	XImage* image;
+	xfShmImage* image; /* owns base.data */
 } xfVideoSurface;
 
 static VideoSurface* xfVideoCreateSurface(VideoClientContext* video, UINT32 x, UINT32 y,
@@ -47,9 +48,7 @@ static VideoSurface* xfVideoCreateSurface(VideoClientContext* video, UINT32 x, U
 	xfc = (xfContext*)video->custom;
 	WINPR_ASSERT(xfc);
 
-	ret->image = XCreateImage(
-	    xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth), ZPixmap, 0,
-	    (char*)ret->base.data, width, height, 8, WINPR_ASSERTING_INT_CAST(int, ret->base.scanline));
+	ret->image = xf_shm_image_new(xfc, width, ret->base.alignedHeight, ret->base.scanline);
 
 	if (!ret->image)
 	{
@@ -58,6 +57,10 @@ static VideoSurface* xfVideoCreateSurface(VideoClientContext* video, UINT32 x, U
 		return NULL;
 	}
 
+	/* frames are written straight to the image buffer */
+	winpr_aligned_free(ret->base.data);
+	ret->base.data = (BYTE*)ret->image->image->data;
+
 	return &ret->base;
 }
 
@@ -65,7 +68,7 @@ static BOOL xfVideoShowSurface(VideoClientContext* video, const VideoSurface* su
                                WINPR_ATTR_UNUSED UINT32 destinationWidth,
                                WINPR_ATTR_UNUSED UINT32 destinationHeight)
 {
-	const xfVideoSurface* xfSurface = (const xfVideoSurface*)surface;
+	xfVideoSurface* xfSurface = (xfVideoSurface*)surface;
 	xfContext* xfc = NULL;
 	const rdpSettings* settings = NULL;
 
@@ -83,9 +86,9 @@ static BOOL xfVideoShowSurface(VideoClientContext* video, const VideoSurface* su
 	if (freerdp_settings_get_bool(settings, FreeRDP_SmartSizing) ||
 	    freerdp_settings_get_bool(settings, FreeRDP_MultiTouchGestures))
 	{
-		XPutImage(xfc->display, xfc->primary, xfc->gc, xfSurface->image, 0, 0,
-		          WINPR_ASSERTING_INT_CAST(int, surface->x),
-		          WINPR_ASSERTING_INT_CAST(int, surface->y), surface->w, surface->h);
+		xf_shm_put_image(xfc, xfSurface->image, xfc->primary, xfc->gc, 0, 0,
+		                 WINPR_ASSERTING_INT_CAST(int, surface->x),
+		                 WINPR_ASSERTING_INT_CAST(int, surface->y), surface->w, surface->h);
 		xf_draw_screen(xfc, WINPR_ASSERTING_INT_CAST(int32_t, surface->x),
 		               WINPR_ASSERTING_INT_CAST(int32_t, surface->y),
 		               WINPR_ASSERTING_INT_CAST(int32_t, surface->w),
@@ -94,11 +97,13 @@ static BOOL xfVideoShowSurface(VideoClientContext* video, const VideoSurface* su
 	else
 #endif
 	{
-		XPutImage(xfc->display, xfc->drawable, xfc->gc, xfSurface->image, 0, 0,
-		          WINPR_ASSERTING_INT_CAST(int, surface->x),
-		          WINPR_ASSERTING_INT_CAST(int, surface->y), surface->w, surface->h);
+		xf_shm_put_image(xfc, xfSurface->image, xfc->drawable, xfc->gc, 0, 0,
+		                 WINPR_ASSERTING_INT_CAST(int, surface->x),
+		                 WINPR_ASSERTING_INT_CAST(int, surface->y), surface->w, surface->h);
 	}
 
+	/* the next frame is written to the same buffer */
+	xf_shm_image_wait(xfc, xfSurface->image);
 	return TRUE;
 }
 
@@ -106,10 +111,13 @@ static BOOL xfVideoDeleteSurface(VideoClientContext* video, VideoSurface* surfac
 {
 	xfVideoSurface* xfSurface = (xfVideoSurface*)surface;
 
-	WINPR_UNUSED(video);
+	WINPR_ASSERT(video);
 
 	if (xfSurface)
-		XFree(xfSurface->image);
+	{
+		xf_shm_image_free(video->custom, xfSurface->image);
+		xfSurface->base.data = NULL;
+	}
 
 	VideoClient_DestroyCommonContext(surface);
 	return TRUE;
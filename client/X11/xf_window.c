@@ -56,6 +56,7 @@
 #include "xf_input.h"
 #include "xf_keyboard.h"
 #include "xf_utils.h"
+#include "xf_shm.h"
 #include "xf_debug.h"
 
 #define TAG CLIENT_TAG("x11")
@@ -1505,7 +1506,7 @@ UINT xf_AppUpdateWindowFromSurface(xfContext* xfc, gdiGfxSurface* surface)
 	else
 	{
 		xfGfxSurface* xfSurface = (xfGfxSurface*)surface;
-		image = xfSurface->image;
+		image = xfSurface->image->image;
 	}
 
 	for (UINT32 x = 0; x < nrects; x++)
@@ -45,6 +45,7 @@
 #include <winpr/stream.h>
 #include <winpr/clipboard.h>
 #include <winpr/path.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/utils/signal.h>
 #include <freerdp/log.h>
@@ -55,6 +56,11 @@
 #include <freerdp/client/client_cliprdr_file.h>
 
 #define MAX_CLIP_DATA_DIR_LEN 10
+#define FUSE_READ_AHEAD_CHUNK_SIZE (512ULL * 1024ULL)
+#define FUSE_READ_AHEAD_MIN_WINDOW 2
+#define FUSE_READ_AHEAD_MAX_WINDOW 16
+/* a read not aligned to the chunks spans one chunk more than its size */
+#define FUSE_READ_AHEAD_MAX_READ ((FUSE_READ_AHEAD_MAX_WINDOW - 1) * FUSE_READ_AHEAD_CHUNK_SIZE)
 #define NO_CLIP_DATA_ID (UINT64_C(1) << 32)
 #define WIN32_FILETIME_TO_UNIX_EPOCH INT64_C(11644473600)
 
@@ -74,9 +80,11 @@ typedef enum eFuseLowlevelOperationType
 	FUSE_LL_OPERATION_LOOKUP,
 	FUSE_LL_OPERATION_GETATTR,
 	FUSE_LL_OPERATION_READ,
+	FUSE_LL_OPERATION_READ_AHEAD,
 } FuseLowlevelOperationType;
 
 typedef struct sCliprdrFuseFile CliprdrFuseFile;
+typedef struct sCliprdrFuseStream CliprdrFuseStream;
 
 struct sCliprdrFuseFile
 {
@@ -128,8 +136,52 @@ typedef struct
 	CliprdrFuseFile* fuse_file;
 	fuse_req_t fuse_req;
 	UINT32 stream_id;
+	CliprdrFuseStream* stream;
 } CliprdrFuseRequest;
 
+typedef struct
+{
+	UINT32 stream_id;
+	UINT64 offset;
+	UINT32 size;
+	UINT32 length;
+	BOOL ready;
+	BOOL failed;
+	UINT64 sent_ns;
+	BYTE* data;
+} CliprdrFuseChunk;
+
+typedef struct
+{
+	fuse_req_t fuse_req;
+	int error;
+	char* data;
+	size_t size;
+} CliprdrFuseReply;
+
+/* Read-ahead state of an open file, keeps a window of FileContentsRequests in flight ahead
+ * of the reader */
+struct sCliprdrFuseStream
+{
+	CliprdrFileContext* file_context;
+	CliprdrFuseFile* fuse_file;
+
+	CliprdrFuseChunk chunks[FUSE_READ_AHEAD_MAX_WINDOW];
+	size_t head;
+	size_t count;
+	UINT64 next_offset;
+
+	size_t window;
+	UINT64 min_rtt_ns;
+	UINT64 last_arrival_ns;
+	UINT64 rate; /* bytes per second */
+
+	BOOL has_pending;
+	fuse_req_t pending_req;
+	UINT64 pending_offset;
+	size_t pending_size;
+};
+
 typedef struct
 {
 	CliprdrFuseFile* parent;
@@ -169,6 +221,7 @@ struct cliprdr_file_context
 	wHashTable* inode_table;
 	wHashTable* clip_data_table;
 	wHashTable* request_table;
+	wArrayList* fuse_streams;
 
 	CliprdrFuseFile* root_dir;
 	CliprdrFuseClipDataEntry* clip_data_entry_without_id;
@@ -227,6 +280,82 @@ static CliprdrFuseFile* fuse_file_new(void)
 	return fuse_file;
 }
 
+static CliprdrFuseChunk* fuse_stream_chunk(CliprdrFuseStream* stream, size_t index)
+{
+	WINPR_ASSERT(stream);
+	WINPR_ASSERT(index < stream->count);
+
+	return &stream->chunks[(stream->head + index) % ARRAYSIZE(stream->chunks)];
+}
+
+static void fuse_stream_drop_front(CliprdrFuseStream* stream)
+{
+	CliprdrFuseChunk* chunk = fuse_stream_chunk(stream, 0);
+
+	/* there is no way to abort a FileContentsRequest, forget it and ignore the response */
+	if (!chunk->ready && !chunk->failed)
+		HashTable_Remove(stream->file_context->request_table, (void*)(uintptr_t)chunk->stream_id);
+
+	free(chunk->data);
+	memset(chunk, 0, sizeof(CliprdrFuseChunk));
+
+	stream->head = (stream->head + 1) % ARRAYSIZE(stream->chunks);
+	stream->count--;
+}
+
+static void fuse_stream_cancel(CliprdrFuseStream* stream)
+{
+	WINPR_ASSERT(stream);
+
+	while (stream->count > 0)
+		fuse_stream_drop_front(stream);
+	stream->head = 0;
+}
+
+static void fuse_stream_free(void* data)
+{
+	CliprdrFuseStream* stream = data;
+
+	if (!stream)
+		return;
+
+	DEBUG_CLIPRDR(stream->file_context->log,
+	              "Closing stream with window %" PRIuz ", rtt %" PRIu64 "us, %" PRIu64 " bytes/s",
+	              stream->window, stream->min_rtt_ns / 1000, stream->rate);
+
+	fuse_stream_cancel(stream);
+	free(stream);
+}
+
+static CliprdrFuseStream* fuse_stream_new(CliprdrFileContext* file_context,
+                                          CliprdrFuseFile* fuse_file)
+{
+	CliprdrFuseStream* stream = calloc(1, sizeof(CliprdrFuseStream));
+	if (!stream)
+		return NULL;
+
+	stream->file_context = file_context;
+	stream->fuse_file = fuse_file;
+	stream->window = FUSE_READ_AHEAD_MIN_WINDOW;
+	return stream;
+}
+
+static void fuse_stream_reply(CliprdrFuseReply* reply)
+{
+	WINPR_ASSERT(reply);
+
+	if (!reply->fuse_req)
+		return;
+
+	if (reply->error != 0)
+		fuse_reply_err(reply->fuse_req, reply->error);
+	else
+		fuse_reply_buf(reply->fuse_req, reply->data, reply->size);
+
+	free(reply->data);
+	memset(reply, 0, sizeof(CliprdrFuseReply));
+}
+
 static void clip_data_entry_free(void* data)
 {
 	CliprdrFuseClipDataEntry* clip_data_entry = data;
@@ -352,12 +481,39 @@ static BOOL maybe_clear_fuse_request(const void* key, void* value, void* arg)
 	DEBUG_CLIPRDR(file_context->log, "Clearing FileContentsRequest for file \"%s\"",
 	              fuse_file->filename_with_root);
 
-	fuse_reply_err(fuse_request->fuse_req, EIO);
+	if (fuse_request->fuse_req)
+		fuse_reply_err(fuse_request->fuse_req, EIO);
 	HashTable_Remove(file_context->request_table, key);
 
 	return TRUE;
 }
 
+static BOOL maybe_orphan_stream(void* data, WINPR_ATTR_UNUSED size_t index, va_list ap)
+{
+	CliprdrFuseStream* stream = data;
+	FuseFileClearContext* clear_context = va_arg(ap, FuseFileClearContext*);
+
+	WINPR_ASSERT(stream);
+	WINPR_ASSERT(clear_context);
+
+	if (!stream->fuse_file ||
+	    !should_remove_fuse_file(stream->fuse_file, clear_context->all_files,
+	                             clear_context->has_clip_data_id, clear_context->clip_data_id))
+		return TRUE;
+
+	if (stream->has_pending)
+	{
+		fuse_reply_err(stream->pending_req, EIO);
+		stream->has_pending = FALSE;
+	}
+
+	/* the stream lives until the file is released, but the file is gone */
+	fuse_stream_cancel(stream);
+	stream->fuse_file = NULL;
+
+	return TRUE;
+}
+
 static BOOL maybe_steal_inode(const void* key, void* value, void* arg)
 {
 	CliprdrFuseFile* fuse_file = value;
@@ -459,6 +615,7 @@ static void clear_selection(CliprdrFileContext* file_context, BOOL all_selection
 		WLog_Print(file_context->log, WLOG_DEBUG, "Clearing selection%s",
 		           all_selections ? "s" : "");
 
+	ArrayList_ForEach(file_context->fuse_streams, maybe_orphan_stream, &clear_context);
 	HashTable_Foreach(file_context->request_table, maybe_clear_fuse_request, &clear_context);
 	HashTable_Foreach(file_context->inode_table, maybe_steal_inode, &clear_context);
 	HashTable_Unlock(file_context->inode_table);
@@ -640,6 +797,7 @@ static void cliprdr_file_fuse_readdir(fuse_req_t req, fuse_ino_t ino, size_t siz
 static void cliprdr_file_fuse_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
                                    struct fuse_file_info* fi);
 static void cliprdr_file_fuse_open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi);
+static void cliprdr_file_fuse_release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi);
 static void cliprdr_file_fuse_opendir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi);
 
 static const struct fuse_lowlevel_ops cliprdr_file_fuse_oper = {
@@ -648,6 +806,7 @@ static const struct fuse_lowlevel_ops cliprdr_file_fuse_oper = {
 	.readdir = cliprdr_file_fuse_readdir,
 	.open = cliprdr_file_fuse_open,
 	.read = cliprdr_file_fuse_read,
+	.release = cliprdr_file_fuse_release,
 	.opendir = cliprdr_file_fuse_opendir,
 };
 
@@ -896,35 +1055,38 @@ static void cliprdr_file_fuse_open(fuse_req_t fuse_req, fuse_ino_t fuse_ino,
 		fuse_reply_err(fuse_req, EISDIR);
 		return;
 	}
-	HashTable_Unlock(file_context->inode_table);
-
 	if ((file_info->flags & O_ACCMODE) != O_RDONLY)
 	{
+		HashTable_Unlock(file_context->inode_table);
 		fuse_reply_err(fuse_req, EACCES);
 		return;
 	}
 
+	/* without a stream reads are forwarded one by one */
+	CliprdrFuseStream* stream = fuse_stream_new(file_context, fuse_file);
+	if (stream && !ArrayList_Append(file_context->fuse_streams, stream))
+	{
+		fuse_stream_free(stream);
+		stream = NULL;
+	}
+	file_info->fh = (uintptr_t)stream;
+	HashTable_Unlock(file_context->inode_table);
+
 	/* Important for KDE to get file correctly */
 	file_info->direct_io = 1;
 
 	fuse_reply_open(fuse_req, file_info);
 }
 
-static BOOL request_file_range_async(CliprdrFileContext* file_context, CliprdrFuseFile* fuse_file,
-                                     fuse_req_t fuse_req, off_t offset, size_t requested_size)
+static BOOL send_file_range_request(CliprdrFileContext* file_context, CliprdrFuseFile* fuse_file,
+                                    const CliprdrFuseRequest* fuse_request, UINT64 offset,
+                                    UINT32 requested_size)
 {
 	CLIPRDR_FILE_CONTENTS_REQUEST file_contents_request = { 0 };
 
 	WINPR_ASSERT(file_context);
 	WINPR_ASSERT(fuse_file);
-
-	if (requested_size > UINT32_MAX)
-		return FALSE;
-
-	CliprdrFuseRequest* fuse_request =
-	    cliprdr_fuse_request_new(file_context, fuse_file, fuse_req, FUSE_LL_OPERATION_READ);
-	if (!fuse_request)
-		return FALSE;
+	WINPR_ASSERT(fuse_request);
 
 	file_contents_request.common.msgType = CB_FILECONTENTS_REQUEST;
 	file_contents_request.streamId = fuse_request->stream_id;
@@ -932,7 +1094,7 @@ static BOOL request_file_range_async(CliprdrFileContext* file_context, CliprdrFu
 	file_contents_request.dwFlags = FILECONTENTS_RANGE;
 	file_contents_request.nPositionLow = (UINT32)(offset & 0xFFFFFFFF);
 	file_contents_request.nPositionHigh = (UINT32)((offset >> 32) & 0xFFFFFFFF);
-	file_contents_request.cbRequested = (UINT32)requested_size;
+	file_contents_request.cbRequested = requested_size;
 	file_contents_request.haveClipDataId = fuse_file->has_clip_data_id;
 	file_contents_request.clipDataId = fuse_file->clip_data_id;
 
@@ -946,22 +1108,271 @@ static BOOL request_file_range_async(CliprdrFileContext* file_context, CliprdrFu
 		return FALSE;
 	}
 
+	DEBUG_CLIPRDR(file_context->log,
+	              "Requested file range (%" PRIu32 " Bytes at offset %" PRIu64
+	              ") for file \"%s\" with stream id %u",
+	              requested_size, offset, fuse_file->filename, fuse_request->stream_id);
+	return TRUE;
+}
+
+static BOOL request_file_range_async(CliprdrFileContext* file_context, CliprdrFuseFile* fuse_file,
+                                     fuse_req_t fuse_req, off_t offset, size_t requested_size)
+{
+	WINPR_ASSERT(file_context);
+	WINPR_ASSERT(fuse_file);
+
+	if (requested_size > UINT32_MAX)
+		return FALSE;
+
+	CliprdrFuseRequest* fuse_request =
+	    cliprdr_fuse_request_new(file_context, fuse_file, fuse_req, FUSE_LL_OPERATION_READ);
+	if (!fuse_request)
+		return FALSE;
+
 	// file_context->request_table owns fuse_request
-	// NOLINTBEGIN(clang-analyzer-unix.Malloc)
-	DEBUG_CLIPRDR(
-	    file_context->log,
-	    "Requested file range (%zu Bytes at offset %lu) for file \"%s\" with stream id %u",
-	    requested_size, offset, fuse_file->filename, fuse_request->stream_id);
+	// NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+	return send_file_range_request(file_context, fuse_file, fuse_request, (UINT64)offset,
+	                               (UINT32)requested_size);
+}
 
-	return TRUE;
-	// NOLINTEND(clang-analyzer-unix.Malloc)
+static void fuse_stream_request_chunk(CliprdrFuseStream* stream)
+{
+	WINPR_ASSERT(stream);
+	WINPR_ASSERT(stream->fuse_file);
+	WINPR_ASSERT(stream->count < ARRAYSIZE(stream->chunks));
+
+	CliprdrFileContext* file_context = stream->file_context;
+	CliprdrFuseFile* fuse_file = stream->fuse_file;
+
+	stream->count++;
+	CliprdrFuseChunk* chunk = fuse_stream_chunk(stream, stream->count - 1);
+	chunk->offset = stream->next_offset;
+	chunk->size = (UINT32)MIN(FUSE_READ_AHEAD_CHUNK_SIZE, fuse_file->size - stream->next_offset);
+	chunk->sent_ns = winpr_GetTickCount64NS();
+	stream->next_offset += chunk->size;
+
+	CliprdrFuseRequest* fuse_request =
+	    cliprdr_fuse_request_new(file_context, fuse_file, NULL, FUSE_LL_OPERATION_READ_AHEAD);
+	if (!fuse_request)
+	{
+		chunk->failed = TRUE;
+		return;
+	}
+
+	fuse_request->stream = stream;
+	chunk->stream_id = fuse_request->stream_id;
+
+	// NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+	if (!send_file_range_request(file_context, fuse_file, fuse_request, chunk->offset, chunk->size))
+		chunk->failed = TRUE;
+}
+
+static void fuse_stream_fill(CliprdrFuseStream* stream)
+{
+	WINPR_ASSERT(stream);
+	WINPR_ASSERT(stream->fuse_file);
+
+	while ((stream->count < stream->window) && (stream->next_offset < stream->fuse_file->size))
+	{
+		fuse_stream_request_chunk(stream);
+		if (fuse_stream_chunk(stream, stream->count - 1)->failed)
+			break;
+	}
+}
+
+/* Reply to the pending read once all the data it covers has arrived */
+static void fuse_stream_complete(CliprdrFuseStream* stream, CliprdrFuseReply* reply)
+{
+	WINPR_ASSERT(stream);
+	WINPR_ASSERT(reply);
+
+	if (!stream->has_pending)
+		return;
+
+	const UINT64 start = stream->pending_offset;
+	const UINT64 end = start + stream->pending_size;
+	UINT64 position = start;
+
+	for (size_t x = 0; (x < stream->count) && (position < end); x++)
+	{
+		const CliprdrFuseChunk* chunk = fuse_stream_chunk(stream, x);
+
+		if (chunk->failed)
+		{
+			reply->fuse_req = stream->pending_req;
+			reply->error = EIO;
+			stream->has_pending = FALSE;
+			return;
+		}
+		if (!chunk->ready)
+			return;
+
+		position = MIN(end, chunk->offset + chunk->length);
+
+		/* short responses only happen at the end of the file */
+		if (chunk->length < chunk->size)
+			break;
+	}
+
+	if ((position < end) && (stream->next_offset < stream->fuse_file->size))
+		return;
+
+	reply->fuse_req = stream->pending_req;
+	reply->size = position - start;
+	reply->data = malloc(MAX(reply->size, 1));
+	if (!reply->data)
+	{
+		reply->error = ENOMEM;
+		stream->has_pending = FALSE;
+		return;
+	}
+
+	for (size_t x = 0; x < stream->count; x++)
+	{
+		const CliprdrFuseChunk* chunk = fuse_stream_chunk(stream, x);
+		const UINT64 chunk_end = chunk->offset + chunk->length;
+
+		if (chunk->offset >= position)
+			break;
+		if (chunk_end <= start)
+			continue;
+
+		const UINT64 from = MAX(start, chunk->offset);
+		const UINT64 to = MIN(position, chunk_end);
+		memcpy(&reply->data[from - start], &chunk->data[from - chunk->offset], to - from);
+	}
+
+	stream->has_pending = FALSE;
+
+	/* release what the reader consumed to make room for the next requests */
+	while ((stream->count > 0) && fuse_stream_chunk(stream, 0)->ready &&
+	       (fuse_stream_chunk(stream, 0)->offset + fuse_stream_chunk(stream, 0)->length <=
+	        position))
+		fuse_stream_drop_front(stream);
+}
+
+static void fuse_stream_read(CliprdrFuseStream* stream, fuse_req_t fuse_req, UINT64 offset,
+                             size_t size, CliprdrFuseReply* reply)
+{
+	WINPR_ASSERT(stream);
+	WINPR_ASSERT(stream->fuse_file);
+	WINPR_ASSERT(!stream->has_pending);
+	WINPR_ASSERT(reply);
+
+	/* skip what lies before the requested offset */
+	while (stream->count > 0)
+	{
+		const CliprdrFuseChunk* chunk = fuse_stream_chunk(stream, 0);
+		const UINT64 chunk_end = chunk->offset + (chunk->ready ? chunk->length : chunk->size);
+		if (chunk_end > offset)
+			break;
+		fuse_stream_drop_front(stream);
+	}
+
+	/* restart the window on anything but a sequential read and retry failed requests */
+	BOOL restart = FALSE;
+	for (size_t x = 0; x < stream->count; x++)
+		restart |= fuse_stream_chunk(stream, x)->failed;
+
+	const UINT64 window_start =
+	    (stream->count > 0) ? fuse_stream_chunk(stream, 0)->offset : stream->next_offset;
+	if (restart || (offset < window_start) || (offset > stream->next_offset))
+	{
+		fuse_stream_cancel(stream);
+		stream->next_offset = offset;
+	}
+
+	stream->has_pending = TRUE;
+	stream->pending_req = fuse_req;
+	stream->pending_offset = offset;
+	stream->pending_size =
+	    MIN(MIN(size, FUSE_READ_AHEAD_MAX_READ), stream->fuse_file->size - offset);
+
+	/* a single read must fit into the window */
+	const size_t needed =
+	    (stream->pending_size + FUSE_READ_AHEAD_CHUNK_SIZE - 1) / FUSE_READ_AHEAD_CHUNK_SIZE + 1;
+	stream->window = MIN(FUSE_READ_AHEAD_MAX_WINDOW, MAX(stream->window, needed));
+
+	fuse_stream_fill(stream);
+	fuse_stream_complete(stream, reply);
+}
+
+/* Size the window to the bandwidth-delay product of the link, plus one chunk to probe for more */
+static void fuse_stream_update_window(CliprdrFuseStream* stream, const CliprdrFuseChunk* chunk)
+{
+	WINPR_ASSERT(stream);
+	WINPR_ASSERT(chunk);
+
+	const UINT64 now = winpr_GetTickCount64NS();
+	const UINT64 rtt = MAX(1, now - chunk->sent_ns);
+
+	if ((stream->min_rtt_ns == 0) || (rtt < stream->min_rtt_ns))
+		stream->min_rtt_ns = rtt;
+
+	/* the gap between two responses measures the link only if both were in flight */
+	if ((stream->last_arrival_ns > chunk->sent_ns) && (now > stream->last_arrival_ns))
+	{
+		const UINT64 rate = 1000000000ULL * chunk->length / (now - stream->last_arrival_ns);
+		stream->rate = (stream->rate == 0) ? rate : (stream->rate * 7 + rate) / 8;
+
+		const UINT64 bdp = stream->rate * stream->min_rtt_ns / 1000000000ULL;
+		const size_t window = (size_t)(bdp / FUSE_READ_AHEAD_CHUNK_SIZE) + 2;
+		stream->window =
+		    MIN(FUSE_READ_AHEAD_MAX_WINDOW, MAX(FUSE_READ_AHEAD_MIN_WINDOW, window));
+	}
+	stream->last_arrival_ns = now;
+}
+
+static void fuse_stream_on_response(CliprdrFuseStream* stream,
+                                    const CLIPRDR_FILE_CONTENTS_RESPONSE* file_contents_response,
+                                    CliprdrFuseReply* reply)
+{
+	CliprdrFuseChunk* chunk = NULL;
+
+	WINPR_ASSERT(stream);
+	WINPR_ASSERT(file_contents_response);
+
+	for (size_t x = 0; x < stream->count; x++)
+	{
+		CliprdrFuseChunk* cur = fuse_stream_chunk(stream, x);
+		if (!cur->ready && !cur->failed && (cur->stream_id == file_contents_response->streamId))
+		{
+			chunk = cur;
+			break;
+		}
+	}
+	if (!chunk)
+		return;
+
+	if (!(file_contents_response->common.msgFlags & CB_RESPONSE_OK) ||
+	    (file_contents_response->cbRequested > chunk->size))
+		chunk->failed = TRUE;
+	else
+	{
+		chunk->length = file_contents_response->cbRequested;
+		chunk->data = malloc(MAX(chunk->length, 1));
+		if (!chunk->data)
+			chunk->failed = TRUE;
+		else
+		{
+			memcpy(chunk->data, file_contents_response->requestedData, chunk->length);
+			chunk->ready = TRUE;
+			fuse_stream_update_window(stream, chunk);
+		}
+	}
+
+	fuse_stream_complete(stream, reply);
+	if (stream->fuse_file)
+		fuse_stream_fill(stream);
 }
 
 static void cliprdr_file_fuse_read(fuse_req_t fuse_req, fuse_ino_t fuse_ino, size_t size,
-                                   off_t offset, WINPR_ATTR_UNUSED struct fuse_file_info* file_info)
+                                   off_t offset, struct fuse_file_info* file_info)
 {
 	CliprdrFileContext* file_context = fuse_req_userdata(fuse_req);
 	CliprdrFuseFile* fuse_file = NULL;
+	CliprdrFuseStream* stream = (CliprdrFuseStream*)(uintptr_t)file_info->fh;
+	CliprdrFuseReply reply = { 0 };
 	BOOL result = 0;
 
 	WINPR_ASSERT(file_context);
@@ -988,6 +1399,17 @@ static void cliprdr_file_fuse_read(fuse_req_t fuse_req, fuse_ino_t fuse_ino, siz
 
 	size = MIN(size, 8ULL * 1024ULL * 1024ULL);
 
+	/* sequential reads are served from the read-ahead window, overlapping reads of the same
+	 * handle fall back to a request of their own */
+	if (stream && (stream->fuse_file == fuse_file) && !stream->has_pending)
+	{
+		fuse_stream_read(stream, fuse_req, (UINT64)offset, size, &reply);
+		HashTable_Unlock(file_context->inode_table);
+
+		fuse_stream_reply(&reply);
+		return;
+	}
+
 	result = request_file_range_async(file_context, fuse_file, fuse_req, offset, size);
 	HashTable_Unlock(file_context->inode_table);
 
@@ -995,6 +1417,25 @@ static void cliprdr_file_fuse_read(fuse_req_t fuse_req, fuse_ino_t fuse_ino, siz
 		fuse_reply_err(fuse_req, EIO);
 }
 
+static void cliprdr_file_fuse_release(fuse_req_t fuse_req, WINPR_ATTR_UNUSED fuse_ino_t fuse_ino,
+                                      struct fuse_file_info* file_info)
+{
+	CliprdrFileContext* file_context = fuse_req_userdata(fuse_req);
+	CliprdrFuseStream* stream = (CliprdrFuseStream*)(uintptr_t)file_info->fh;
+
+	WINPR_ASSERT(file_context);
+
+	if (stream)
+	{
+		/* drops the requests still in flight */
+		HashTable_Lock(file_context->inode_table);
+		ArrayList_Remove(file_context->fuse_streams, stream);
+		HashTable_Unlock(file_context->inode_table);
+	}
+
+	fuse_reply_err(fuse_req, 0);
+}
+
 static void cliprdr_file_fuse_opendir(fuse_req_t fuse_req, fuse_ino_t fuse_ino,
                                       struct fuse_file_info* file_info)
 {
@@ -1199,6 +1640,19 @@ static UINT cliprdr_file_context_server_file_contents_response(
 		return CHANNEL_RC_OK;
 	}
 
+	if (fuse_request->operation_type == FUSE_LL_OPERATION_READ_AHEAD)
+	{
+		CliprdrFuseReply reply = { 0 };
+
+		fuse_stream_on_response(fuse_request->stream, file_contents_response, &reply);
+		HashTable_Remove(file_context->request_table,
+		                 (void*)(uintptr_t)file_contents_response->streamId);
+		HashTable_Unlock(file_context->inode_table);
+
+		fuse_stream_reply(&reply);
+		return CHANNEL_RC_OK;
+	}
+
 	if (!(file_contents_response->common.msgFlags & CB_RESPONSE_OK))
 	{
 		WLog_Print(file_context->log, WLOG_WARN,
@@ -2086,6 +2540,7 @@ void cliprdr_file_context_free(CliprdrFileContext* file)
 	if (file->fuse_start_sync)
 		(void)CloseHandle(file->fuse_start_sync);
 
+	ArrayList_Free(file->fuse_streams);
 	HashTable_Free(file->request_table);
 	HashTable_Free(file->clip_data_table);
 	HashTable_Free(file->inode_table);
@@ -2420,9 +2875,17 @@ CliprdrFileContext* cliprdr_file_context_new(void* context)
 	file->inode_table = HashTable_New(FALSE);
 	file->clip_data_table = HashTable_New(FALSE);
 	file->request_table = HashTable_New(FALSE);
-	if (!file->inode_table || !file->clip_data_table || !file->request_table)
+	file->fuse_streams = ArrayList_New(FALSE);
+	if (!file->inode_table || !file->clip_data_table || !file->request_table ||
+	    !file->fuse_streams)
 		goto fail;
 
+	{
+		wObject* aobj = ArrayList_Object(file->fuse_streams);
+		WINPR_ASSERT(aobj);
+		aobj->fnObjectFree = fuse_stream_free;
+	}
+
 	{
 		wObject* ctobj = HashTable_ValueObject(file->request_table);
 		WINPR_ASSERT(ctobj);
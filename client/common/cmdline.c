@@ -5259,6 +5259,13 @@ static int parse_command_line(rdpSettings* settings, const COMMAND_LINE_ARGUMENT
 			if (rc != 0)
 				return fail_at(arg, rc);
 		}
+		CommandLineSwitchCase(arg, "mouse-coalescing")
+		{
+			const int rc = parse_command_line_option_uint32(
+			    settings, arg, FreeRDP_InputCoalescingInterval, 0, 100);
+			if (rc != 0)
+				return fail_at(arg, rc);
+		}
 		CommandLineSwitchCase(arg, "mouse-motion")
 		{
 			if (!freerdp_settings_set_bool(settings, FreeRDP_MouseMotion, enable))
@@ -327,6 +327,8 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 #endif
 	{ "monitors", COMMAND_LINE_VALUE_REQUIRED, "<id>[,<id>[,...]]", NULL, NULL, -1, NULL,
 	  "Select monitors to use (only effective in fullscreen or multimonitor mode)" },
+	{ "mouse-coalescing", COMMAND_LINE_VALUE_REQUIRED, "<time in ms>", NULL, NULL, -1, NULL,
+	  "Coalesce mouse motion events sent within the given interval, 0 to disable [0,100]" },
 	{ "mouse-motion", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
 	  "Send mouse motion" },
 	{ "mouse-relative", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
@@ -445,7 +447,7 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  -1, NULL, "Activates Smartcard (optional certificate) Logon authentication." },
 	{ "sound", COMMAND_LINE_VALUE_OPTIONAL,
 	  "[sys:<sys>,][dev:<dev>,][format:<format>,][rate:<rate>,][channel:<channel>,][latency:<"
-	  "latency>,][quality:<quality>]",
+	  "latency>,][quality:<quality>,][jitter:<latency>]",
 	  NULL, NULL, -1, "audio", "Audio output (sound)" },
 	{ "span", COMMAND_LINE_VALUE_FLAG, NULL, NULL, NULL, -1, NULL,
 	  "Span screen over multiple monitors" },
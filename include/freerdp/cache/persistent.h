@@ -93,6 +93,109 @@ extern "C"
 	WINPR_ATTR_MALLOC(persistent_cache_free, 1)
 	FREERDP_API rdpPersistentCache* persistent_cache_new(void);
 
+	/** @brief A memory mapped, indexed persistent cache file.
+	 *
+	 *  Entries are appended one by one as they are written and only the index is read when the
+	 *  file is opened, the bitmap data is paged in when an entry is accessed. The file survives
+	 *  crashes: entries that were not completely written are dropped on the next open.
+	 *
+	 *  @since version 3.16.0
+	 */
+	typedef struct rdp_persistent_cache_store rdpPersistentCacheStore;
+
+	/** @brief Number of entries in the store
+	 *
+	 *  @param store The store to query
+	 *  @return The number of valid entries
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API size_t persistent_cache_store_get_count(const rdpPersistentCacheStore* store);
+
+	/** @brief Get the indices of the most recently used entries
+	 *
+	 *  @param store The store to query
+	 *  @param indices An array receiving the entry indices, most recently used first
+	 *  @param count The number of elements in \b indices
+	 *  @return The number of indices written
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API size_t persistent_cache_store_get_recent(const rdpPersistentCacheStore* store,
+	                                                     size_t* indices, size_t count);
+
+	/** @brief Look up an entry by cache key
+	 *
+	 *  @param store The store to query
+	 *  @param key64 The cache key to look for
+	 *  @return The index of the entry or \b -1 if the key is not in the store
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API SSIZE_T persistent_cache_store_find(const rdpPersistentCacheStore* store,
+	                                                UINT64 key64);
+
+	/** @brief Read an entry of the store
+	 *
+	 *  The entry data points into the mapped file and stays valid until the store is freed.
+	 *
+	 *  @param store The store to read from
+	 *  @param index The index of the entry
+	 *  @param entry The entry to fill
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL persistent_cache_store_read_entry(rdpPersistentCacheStore* store,
+	                                                   size_t index, PERSISTENT_CACHE_ENTRY* entry);
+
+	/** @brief Append an entry to the store
+	 *
+	 *  @param store The store to write to
+	 *  @param entry The entry to append, \b data must hold \b width * \b height 32bpp pixels
+	 *  @return \b 1 if the entry was appended, \b 0 if the key is already in the store or the
+	 *  store is full, \b -1 on failure
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API int persistent_cache_store_write_entry(rdpPersistentCacheStore* store,
+	                                                   const PERSISTENT_CACHE_ENTRY* entry);
+
+	/** @brief Mark an entry as used, recently used entries are kept when the store is full
+	 *
+	 *  @param store The store to update
+	 *  @param index The index of the entry
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL persistent_cache_store_touch(rdpPersistentCacheStore* store, size_t index);
+
+	/** @brief Write all changes of the store to disk
+	 *
+	 *  @param store The store to flush
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL persistent_cache_store_flush(rdpPersistentCacheStore* store);
+
+	/** @brief Flush and close a store
+	 *
+	 *  @param store The store to free, may be \b NULL
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void persistent_cache_store_free(rdpPersistentCacheStore* store);
+
+	/** @brief Open or create a persistent cache store
+	 *
+	 *  A store that is nearly full or was created with different limits is rebuilt keeping the
+	 *  most recently used entries.
+	 *
+	 *  @param filename The file backing the store
+	 *  @param maxEntries The maximum number of entries
+	 *  @param maxSize The maximum size of the bitmap data in bytes
+	 *  @return The store or \b NULL on failure. Not supported on windows.
+	 *  @since version 3.16.0
+	 */
+	WINPR_ATTR_MALLOC(persistent_cache_store_free, 1)
+	FREERDP_API rdpPersistentCacheStore* persistent_cache_store_new(const char* filename,
+	                                                                UINT32 maxEntries,
+	                                                                UINT64 maxSize);
+
 #ifdef __cplusplus
 }
 #endif
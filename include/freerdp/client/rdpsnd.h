@@ -85,6 +85,30 @@ typedef UINT(VCAPITYPE* PFREERDP_RDPSND_DEVICE_ENTRY)(
 
 FREERDP_API rdpContext* freerdp_rdpsnd_get_context(rdpsndPlugin* plugin);
 
+/** @brief Statistics of the client side playback jitter buffer
+ *  \since version 3.16.0
+ */
+typedef struct
+{
+	UINT32 depth;           /**< audio currently buffered in ms */
+	UINT32 targetLatency;   /**< latency the buffer currently aims for in ms */
+	UINT32 jitter;          /**< estimated wave PDU arrival jitter in ms */
+	INT32 drift;            /**< current playback rate correction in ppm */
+	UINT64 packets;         /**< wave PDUs queued for playback */
+	UINT64 latePackets;     /**< wave PDUs that arrived after their playback time */
+	UINT64 droppedPackets;  /**< wave PDUs dropped to limit the latency */
+	UINT64 underruns;       /**< times the buffer ran empty during playback */
+	UINT64 concealedFrames; /**< frames generated to conceal missing audio */
+} RDPSND_PLAYBACK_STATS;
+
+/** @brief Get the playback statistics of \b plugin
+ *
+ *  @return \b FALSE if the jitter buffer is disabled or not used by the current format
+ *  \since version 3.16.0
+ */
+FREERDP_API BOOL freerdp_rdpsnd_get_playback_stats(rdpsndPlugin* plugin,
+                                                   RDPSND_PLAYBACK_STATS* stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -55,6 +55,7 @@ extern "C"
 	typedef RDP_CLIENT_ENTRY_POINTS_V1 RDP_CLIENT_ENTRY_POINTS;
 
 #include <freerdp/utils/smartcardlogon.h>
+#include <freerdp/utils/latency.h>
 #include <freerdp/update.h>
 #include <freerdp/input.h>
 #include <freerdp/graphics.h>
@@ -630,6 +631,14 @@ owned by rdpRdp */
 	FREERDP_API BOOL freerdp_get_stats(rdpRdp* rdp, UINT64* inBytes, UINT64* outBytes,
 	                                   UINT64* inPackets, UINT64* outPackets);
 
+	/** @brief Get the input to display latency statistics of a connection
+	 *
+	 *  @param context The context of the connection
+	 *  @return The statistics or \b NULL
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API rdpLatencyStats* freerdp_get_latency_stats(rdpContext* context);
+
 	FREERDP_API void freerdp_get_version(int* major, int* minor, int* revision);
 	FREERDP_API const char* freerdp_get_version_string(void);
 	FREERDP_API const char* freerdp_get_build_revision(void);
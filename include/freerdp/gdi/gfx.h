@@ -70,6 +70,17 @@ extern "C"
 	                                               pcRdpgfxUpdateSurfaceArea update);
 	FREERDP_API void gdi_graphics_pipeline_uninit(rdpGdi* gdi, RdpgfxClientContext* gfx);
 
+	/** @brief Wait for the surface commands of \b surfaceId still being decoded on the thread
+	 *  pool and drop its decode queue.
+	 *
+	 *  Clients replacing the DeleteSurface callback must call this before freeing the surface.
+	 *
+	 *  @return 0 on success, otherwise the error of a failed decode
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API UINT gdi_graphics_pipeline_release_surface(RdpgfxClientContext* gfx,
+	                                                       UINT16 surfaceId);
+
 #ifdef __cplusplus
 }
 #endif
@@ -124,6 +124,27 @@ extern "C"
 	typedef BOOL (*pGlyph_SetBounds)(rdpContext* context, INT32 x, INT32 y, INT32 width,
 	                                 INT32 height);
 
+	/** @brief A glyph of a run with the arguments of \b pGlyph_Draw
+	 *  @since version 3.16.0
+	 */
+	typedef struct
+	{
+		const rdpGlyph* glyph;
+		INT32 x;
+		INT32 y;
+		INT32 width;
+		INT32 height;
+		INT32 sx;
+		INT32 sy;
+	} GLYPH_PLACEMENT;
+
+	/** @brief Draw the glyphs of a string between \b pGlyph_BeginDraw and \b pGlyph_EndDraw in
+	 *  one call, with the same result as \b pGlyph_Draw for every placement in order
+	 *  @since version 3.16.0
+	 */
+	typedef BOOL (*pGlyph_DrawRun)(rdpContext* context, const GLYPH_PLACEMENT* placements,
+	                               size_t count, BOOL fOpRedundant);
+
 	struct rdp_glyph
 	{
 		size_t size;                /* 0 */
@@ -133,7 +154,8 @@ extern "C"
 		pGlyph_BeginDraw BeginDraw; /* 4 */
 		pGlyph_EndDraw EndDraw;     /* 5 */
 		pGlyph_SetBounds SetBounds; /* 6 */
-		UINT32 paddingA[16 - 7];    /* 7 */
+		pGlyph_DrawRun DrawRun;     /* 7 */
+		UINT32 paddingA[16 - 7 - sizeof(void*) / sizeof(UINT32)]; /* 8 */
 
 		INT32 x;                  /* 16 */
 		INT32 y;                  /* 17 */
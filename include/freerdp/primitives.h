@@ -83,6 +83,16 @@ typedef enum
 	AVC444_CHROMAv2
 } avc444_frame_type;
 
+/** @brief resampling filters of \b scale_8u_C4R
+ *  @since version 3.16.0
+ */
+typedef enum
+{
+	PRIM_SCALE_BILINEAR,
+	PRIM_SCALE_BICUBIC, /* Catmull-Rom */
+	PRIM_SCALE_BOX      /* area average */
+} prim_scale_filter;
+
 /* Function prototypes for all of the supported primitives. */
 typedef pstatus_t (*fn_copy_t)(const void* WINPR_RESTRICT pSrc, void* WINPR_RESTRICT pDst,
 	                           INT32 bytes);
@@ -212,6 +222,14 @@ typedef pstatus_t (*fn_andC_32u_t)(const UINT32* WINPR_RESTRICT pSrc, UINT32 val
 	                               UINT32* WINPR_RESTRICT pDst, INT32 len);
 typedef pstatus_t (*fn_orC_32u_t)(const UINT32* WINPR_RESTRICT pSrc, UINT32 val,
 	                              UINT32* WINPR_RESTRICT pDst, INT32 len);
+typedef pstatus_t (*fn_scale_8u_C4R_t)(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+	                                   UINT32 srcWidth, UINT32 srcHeight, BYTE* WINPR_RESTRICT pDst,
+	                                   UINT32 dstStep, UINT32 dstWidth, UINT32 dstHeight,
+	                                   const RECTANGLE_16* WINPR_RESTRICT rect,
+	                                   prim_scale_filter filter);
+typedef pstatus_t (*fn_alphaMask_8u_C4R_t)(const BYTE* WINPR_RESTRICT pMask, UINT32 maskStep,
+	                                       UINT32 color, BYTE* WINPR_RESTRICT pDst, UINT32 dstStep,
+	                                       UINT32 width, UINT32 height);
 typedef pstatus_t (*primitives_uninit_t)(void);
 
 #if defined(WITH_FREERDP_3x_DEPRECATED)
@@ -302,6 +320,24 @@ typedef struct
 	fn_add_16s_inplace_t add_16s_inplace;         /** @since version 3.6.0 */
 	fn_lShiftC_16s_inplace_t lShiftC_16s_inplace; /** @since version 3.6.0 */
 	fn_copy_no_overlap_t copy_no_overlap;         /** @since version 3.6.0 */
+
+	/** \brief Scale a 32bpp image of \b srcWidth x \b srcHeight pixels to \b dstWidth x
+	 *  \b dstHeight pixels, all four channels are filtered alike.
+	 *
+	 *  Only the pixels within \b rect (destination coordinates, NULL for all) are written.
+	 *  Filter taps are taken from the whole source image and clamped at its borders, so
+	 *  scaling the rectangles of a region one by one gives the same result as scaling the
+	 *  whole image.
+	 */
+	fn_scale_8u_C4R_t scale_8u_C4R; /** @since version 3.16.0 */
+
+	/** \brief Fill a 32bpp image with \b color through an 8 bit coverage mask.
+	 *
+	 *  Every byte of a pixel becomes (color * mask + dst * (255 - mask)) / 255, rounded, so a
+	 *  mask of 0 keeps the pixel and a mask of 255 writes \b color. \b color is a pixel as
+	 *  loaded from \b pDst with a 32 bit read.
+	 */
+	fn_alphaMask_8u_C4R_t alphaMask_8u_C4R; /** @since version 3.16.0 */
 } primitives_t;
 
 typedef enum
@@ -613,7 +613,11 @@ struct rdp_settings
 	SETTINGS_DEPRECATED(ALIGN64 char* KeyboardPipeName);     /* 2637 */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL HasRelativeMouseEvent); /* 2638 */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL HasQoeEvent);           /* 2639 */
-	UINT64 padding2688[2688 - 2640];                         /* 2640 */
+	/** Interval in milliseconds to coalesce fast-path mouse motion in, 0 disables coalescing
+	 * @since version 3.16.0
+	 */
+	SETTINGS_DEPRECATED(ALIGN64 UINT32 InputCoalescingInterval); /* 2640 */
+	UINT64 padding2688[2688 - 2641];                             /* 2641 */
 
 	/* Brush Capabilities */
 	SETTINGS_DEPRECATED(ALIGN64 UINT32 BrushSupportLevel); /* 2688 */
@@ -0,0 +1,149 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Input to display latency statistics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_UTILS_LATENCY_H
+#define FREERDP_UTILS_LATENCY_H
+
+#include <winpr/wtypes.h>
+#include <winpr/wlog.h>
+
+#include <freerdp/api.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** @brief Latency statistics of a connection
+	 *
+	 *  An input event is assigned to the first frame that is started after it, every stage the
+	 *  frame passes adds the time since the input event to the histogram of the stage.
+	 *
+	 *  @since version 3.16.0
+	 */
+	typedef struct rdp_latency_stats rdpLatencyStats;
+
+	/** @brief The stages a frame passes on the client and on the server
+	 *  @since version 3.16.0
+	 */
+	typedef enum
+	{
+		FREERDP_LATENCY_STAGE_RECEIVE,      /**< client: the start of the frame was received */
+		FREERDP_LATENCY_STAGE_DECODE_START, /**< client: the first command was decoded */
+		FREERDP_LATENCY_STAGE_DECODE_END,   /**< client: all commands of the frame are decoded */
+		FREERDP_LATENCY_STAGE_PRESENT,      /**< client: the frame was handed to the display */
+		FREERDP_LATENCY_STAGE_CAPTURE,      /**< server: the frame was taken from the screen */
+		FREERDP_LATENCY_STAGE_ENCODE,       /**< server: the frame is encoded */
+		FREERDP_LATENCY_STAGE_SEND,         /**< server: the frame was sent */
+		FREERDP_LATENCY_STAGE_COUNT
+	} FREERDP_LATENCY_STAGE;
+
+/** Frame id to record a stage for the newest frame that passed the previous stage */
+#define FREERDP_LATENCY_FRAME_LAST UINT32_MAX
+
+#define FREERDP_LATENCY_HISTOGRAM_BUCKETS 16
+
+	/** @brief Latencies from input events to a stage
+	 *  @since version 3.16.0
+	 */
+	typedef struct
+	{
+		UINT64 count; /**< number of frames that passed the stage with an input event */
+		UINT64 sum;   /**< sum of the latencies in us */
+		UINT64 min;   /**< lowest latency in us */
+		UINT64 max;   /**< highest latency in us */
+		/** bucket \b i counts latencies below 250us << \b i, the last bucket all others */
+		UINT64 buckets[FREERDP_LATENCY_HISTOGRAM_BUCKETS];
+	} FREERDP_LATENCY_HISTOGRAM;
+
+	/** @brief Get the name of a stage
+	 *
+	 *  @param stage The stage
+	 *  @return A static string
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API const char* freerdp_latency_stage_string(FREERDP_LATENCY_STAGE stage);
+
+	/** @brief Record an input event, only the oldest one not assigned to a frame is kept
+	 *
+	 *  @param stats The statistics to update, may be \b NULL
+	 *  @param timestamp The time of the event from \b winpr_GetTickCount64NS
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void freerdp_latency_stats_input(rdpLatencyStats* stats, UINT64 timestamp);
+
+	/** @brief Record that a frame passed a stage, only the first time counts
+	 *
+	 *  @param stats The statistics to update, may be \b NULL
+	 *  @param frameId The RDPGFX or surface frame id or \b FREERDP_LATENCY_FRAME_LAST
+	 *  @param stage The stage the frame passed
+	 *  @param timestamp The time from \b winpr_GetTickCount64NS
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void freerdp_latency_stats_frame(rdpLatencyStats* stats, UINT32 frameId,
+	                                             FREERDP_LATENCY_STAGE stage, UINT64 timestamp);
+
+	/** @brief Get the histogram of a stage
+	 *
+	 *  @param stats The statistics to query
+	 *  @param stage The stage
+	 *  @param histogram The histogram to fill
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL freerdp_latency_stats_get(rdpLatencyStats* stats, FREERDP_LATENCY_STAGE stage,
+	                                           FREERDP_LATENCY_HISTOGRAM* histogram);
+
+	/** @brief Clear all histograms and pending input events
+	 *
+	 *  @param stats The statistics to reset, may be \b NULL
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void freerdp_latency_stats_reset(rdpLatencyStats* stats);
+
+	/** @brief Log all stages that were passed by at least one frame
+	 *
+	 *  @param stats The statistics to log
+	 *  @param log The logger to write to
+	 *  @param level The log level to use
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void freerdp_latency_stats_log(rdpLatencyStats* stats, wLog* log, DWORD level);
+
+	/** @brief Free latency statistics
+	 *
+	 *  @param stats The statistics to free, may be \b NULL
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void freerdp_latency_stats_free(rdpLatencyStats* stats);
+
+	/** @brief Create latency statistics
+	 *
+	 *  @param name The name used in the log output
+	 *  @param logInterval If not \b 0 the statistics are logged with \b WLOG_DEBUG to the
+	 *  com.freerdp.utils.latency logger every \b logInterval milliseconds while frames pass
+	 *  @return The statistics or \b NULL on failure
+	 *  @since version 3.16.0
+	 */
+	WINPR_ATTR_MALLOC(freerdp_latency_stats_free, 1)
+	FREERDP_API rdpLatencyStats* freerdp_latency_stats_new(const char* name, UINT32 logInterval);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_UTILS_LATENCY_H */
@@ -355,6 +355,54 @@ end:
 	return status;
 }
 
+/* The bitmaps of the last connection are still cached after a reconnect. Move the bitmaps
+ * with a persistent key to the front of their cell so that they can be announced in the
+ * persistent key list, which assigns the keys to the cell indices in order. Bitmaps without a
+ * key are unknown to the server after the reconnect and dropped. */
+size_t bitmap_cache_retain_keys(rdpBitmapCache* bitmapCache, UINT64* keys, size_t maxKeys,
+                                UINT16* counts, size_t maxCells)
+{
+	size_t total = 0;
+
+	WINPR_ASSERT(bitmapCache);
+	WINPR_ASSERT(keys || (maxKeys == 0));
+	WINPR_ASSERT(counts || (maxCells == 0));
+
+	for (size_t x = 0; x < maxCells; x++)
+		counts[x] = 0;
+
+	for (UINT32 i = 0; i < bitmapCache->maxCells; i++)
+	{
+		BITMAP_V2_CELL* cell = &bitmapCache->cells[i];
+		UINT32 kept = 0;
+
+		if (!cell->entries)
+			continue;
+
+		for (UINT32 j = 0; j < cell->number + 1; j++)
+		{
+			rdpBitmap* bitmap = cell->entries[j];
+			if (!bitmap)
+				continue;
+
+			cell->entries[j] = NULL;
+			if ((i < maxCells) && (j < cell->number) && (bitmap->key64 != 0) &&
+			    (kept < UINT16_MAX) && (total < maxKeys))
+			{
+				cell->entries[kept++] = bitmap;
+				keys[total++] = bitmap->key64;
+			}
+			else
+				Bitmap_Free(bitmapCache->context, bitmap);
+		}
+
+		if (i < maxCells)
+			counts[i] = (UINT16)kept;
+	}
+
+	return total;
+}
+
 rdpBitmapCache* bitmap_cache_new(rdpContext* context)
 {
 	rdpSettings* settings = NULL;
@@ -59,6 +59,10 @@ extern "C"
 
 	FREERDP_LOCAL void bitmap_cache_free(rdpBitmapCache* bitmap_cache);
 
+	FREERDP_LOCAL size_t bitmap_cache_retain_keys(rdpBitmapCache* bitmapCache, UINT64* keys,
+	                                              size_t maxKeys, UINT16* counts,
+	                                              size_t maxCells);
+
 	WINPR_ATTR_MALLOC(bitmap_cache_free, 1)
 	FREERDP_LOCAL rdpBitmapCache* bitmap_cache_new(rdpContext* context);
 
@@ -35,6 +35,17 @@
 
 #define TAG FREERDP_TAG("cache.glyph")
 
+#define GLYPH_RUN_SIZE 64
+
+/* glyphs of a string that are drawn with one call to pGlyph_DrawRun */
+typedef struct
+{
+	pGlyph_DrawRun DrawRun;
+	BOOL fOpRedundant;
+	size_t count;
+	GLYPH_PLACEMENT placements[GLYPH_RUN_SIZE];
+} rdpGlyphRun;
+
 static rdpGlyph* glyph_cache_get(rdpGlyphCache* glyphCache, UINT32 id, UINT32 index);
 static BOOL glyph_cache_put(rdpGlyphCache* glyphCache, UINT32 id, UINT32 index, rdpGlyph* glyph);
 
@@ -72,8 +83,20 @@ static UINT32 update_glyph_offset(const BYTE* data, size_t length, UINT32 index,
 	return index;
 }
 
+static BOOL update_flush_glyph_run(rdpContext* context, rdpGlyphRun* run)
+{
+	WINPR_ASSERT(run);
+
+	if (run->count == 0)
+		return TRUE;
+
+	const size_t count = run->count;
+	run->count = 0;
+	return run->DrawRun(context, run->placements, count, run->fOpRedundant);
+}
+
 static BOOL update_process_glyph(rdpContext* context, const BYTE* data, UINT32 cacheIndex, INT32* x,
-                                 const INT32* y, UINT32 cacheId, UINT32 flAccel, BOOL fOpRedundant,
+                                 const INT32* y, UINT32 cacheId, UINT32 flAccel, rdpGlyphRun* run,
                                  const RDP_RECT* bound)
 {
 	INT32 sx = 0;
@@ -121,8 +144,20 @@ static BOOL update_process_glyph(rdpContext* context, const BYTE* data, UINT32 c
 
 		if ((dh > 0) && (dw > 0))
 		{
-			if (!glyph->Draw(context, glyph, dx, dy, dw, dh, sx, sy, fOpRedundant))
-				return FALSE;
+			if (!run->DrawRun)
+			{
+				if (!glyph->Draw(context, glyph, dx, dy, dw, dh, sx, sy, run->fOpRedundant))
+					return FALSE;
+			}
+			else
+			{
+				if ((run->count == ARRAYSIZE(run->placements)) &&
+				    !update_flush_glyph_run(context, run))
+					return FALSE;
+
+				const GLYPH_PLACEMENT placement = { glyph, dx, dy, dw, dh, sx, sy };
+				run->placements[run->count++] = placement;
+			}
 		}
 	}
 
@@ -147,6 +182,7 @@ static BOOL update_process_glyph_fragments(rdpContext* context, const BYTE* data
 	rdpGlyphCache* glyph_cache = NULL;
 	rdpGlyph* glyph = NULL;
 	RDP_RECT bound;
+	rdpGlyphRun run = { 0 };
 
 	if (!context || !data || !context->graphics || !context->cache || !context->cache->glyph)
 		return FALSE;
@@ -158,6 +194,9 @@ static BOOL update_process_glyph_fragments(rdpContext* context, const BYTE* data
 	if (!glyph)
 		return FALSE;
 
+	run.DrawRun = glyph->DrawRun;
+	run.fOpRedundant = fOpRedundant;
+
 	/* Limit op rectangle to visible screen. */
 	if (opX < 0)
 	{
@@ -258,7 +297,7 @@ static BOOL update_process_glyph_fragments(rdpContext* context, const BYTE* data
 					n = update_glyph_offset(fragments, size, n, &x, &y, ulCharInc, flAccel);
 
 					if (!update_process_glyph(context, fragments, fop, &x, &y, cacheId, flAccel,
-					                          fOpRedundant, &bound))
+					                          &run, &bound))
 						return FALSE;
 				}
 
@@ -276,7 +315,7 @@ static BOOL update_process_glyph_fragments(rdpContext* context, const BYTE* data
 			default:
 				index = update_glyph_offset(data, length, index, &x, &y, ulCharInc, flAccel);
 
-				if (!update_process_glyph(context, data, op, &x, &y, cacheId, flAccel, fOpRedundant,
+				if (!update_process_glyph(context, data, op, &x, &y, cacheId, flAccel, &run,
 				                          &bound))
 					return FALSE;
 
@@ -284,6 +323,9 @@ static BOOL update_process_glyph_fragments(rdpContext* context, const BYTE* data
 		}
 	}
 
+	if (!update_flush_glyph_run(context, &run))
+		return FALSE;
+
 	return glyph->EndDraw(context, opX, opY, opWidth, opHeight, bgcolor, fgcolor);
 }
 
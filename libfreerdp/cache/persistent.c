@@ -19,15 +19,28 @@
 
 #include <freerdp/config.h>
 
+#include <stddef.h>
+
 #include <winpr/crt.h>
 #include <winpr/stream.h>
 #include <winpr/assert.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/constants.h>
+#include <freerdp/log.h>
 
 #include <freerdp/cache/persistent.h>
 
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define TAG FREERDP_TAG("cache.persistent")
+
 struct rdp_persistent_cache
 {
 	FILE* fp;
@@ -374,3 +387,657 @@ void persistent_cache_free(rdpPersistentCache* persistent)
 
 	free(persistent);
 }
+
+/* The store file starts with a header and an index of a fixed number of entries, followed by the
+ * bitmap data which is appended entry by entry. The file is mapped for reading only, all changes
+ * are written with pwrite so that a full disk is reported as an error instead of a fault.
+ *
+ * An entry is committed by writing the header with the incremented count after its data and
+ * index entry were written. The header is flagged dirty while the store is open, a store that
+ * was not closed cleanly has all entries checked against their checksums on the next open. */
+
+#define PERSISTENT_STORE_VERSION 1
+#define PERSISTENT_STORE_FLAG_DIRTY 0x00000001
+#define PERSISTENT_STORE_PAGE_SIZE 4096ull
+
+static const char store_sig_str[] = "FRDPstr";
+
+typedef struct
+{
+	BYTE sig[8];
+	UINT32 version;
+	UINT32 flags;
+	UINT32 maxEntries;
+	UINT32 count;
+	UINT64 maxSize;
+	UINT64 dataSize;
+	UINT64 sequence;
+} PERSISTENT_STORE_HEADER;
+
+typedef struct
+{
+	UINT64 key64;
+	UINT64 offset;
+	UINT64 lastUse;
+	UINT16 width;
+	UINT16 height;
+	UINT32 checksum;
+} PERSISTENT_STORE_ENTRY;
+
+typedef struct
+{
+	UINT64 lastUse;
+	size_t index;
+} PERSISTENT_STORE_USE;
+
+struct rdp_persistent_cache_store
+{
+	int fd;
+	char* filename;
+	const BYTE* map;
+	size_t mapSize;
+	UINT64 dataOffset;
+	PERSISTENT_STORE_HEADER header;
+	const PERSISTENT_STORE_ENTRY* entries;
+	UINT32* lookup; /* index + 1 of the entry, open addressed by cache key */
+	UINT32 lookupBits;
+};
+
+#if !defined(_WIN32)
+static UINT64 store_data_offset(UINT32 maxEntries)
+{
+	const UINT64 size =
+	    sizeof(PERSISTENT_STORE_HEADER) + 1ull * maxEntries * sizeof(PERSISTENT_STORE_ENTRY);
+	return (size + PERSISTENT_STORE_PAGE_SIZE - 1) & ~(PERSISTENT_STORE_PAGE_SIZE - 1);
+}
+
+static UINT64 store_entry_size(const PERSISTENT_STORE_ENTRY* entry)
+{
+	WINPR_ASSERT(entry);
+	return 4ull * entry->width * entry->height;
+}
+
+static UINT32 store_hash(UINT32 hash, const BYTE* data, size_t size)
+{
+	size_t x = 0;
+
+	/* FNV-1a on 32 bit words */
+	for (; x + 4 <= size; x += 4)
+	{
+		UINT32 val = 0;
+		memcpy(&val, &data[x], sizeof(val));
+		hash = (hash ^ val) * 0x01000193;
+	}
+
+	for (; x < size; x++)
+		hash = (hash ^ data[x]) * 0x01000193;
+
+	return hash;
+}
+
+static UINT32 store_checksum(const PERSISTENT_STORE_ENTRY* entry, const BYTE* data)
+{
+	WINPR_ASSERT(entry);
+
+	const UINT64 fields[] = { entry->key64, entry->offset,
+		                      ((UINT64)entry->width << 16) | entry->height };
+	const UINT32 hash = store_hash(0x811C9DC5, (const BYTE*)fields, sizeof(fields));
+	return store_hash(hash, data, store_entry_size(entry));
+}
+
+static BOOL store_pwrite(rdpPersistentCacheStore* store, UINT64 offset, const void* data,
+                         size_t size)
+{
+	const BYTE* ptr = data;
+
+	WINPR_ASSERT(store);
+
+	while (size > 0)
+	{
+		const ssize_t rc = pwrite(store->fd, ptr, size, (off_t)offset);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			char ebuffer[256] = { 0 };
+			WLog_ERR(TAG, "writing %s failed: %s", store->filename,
+			         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+			return FALSE;
+		}
+
+		ptr += rc;
+		offset += (UINT64)rc;
+		size -= (size_t)rc;
+	}
+
+	return TRUE;
+}
+
+static BOOL store_write_header(rdpPersistentCacheStore* store)
+{
+	WINPR_ASSERT(store);
+	return store_pwrite(store, 0, &store->header, sizeof(store->header));
+}
+
+static BOOL store_sync(rdpPersistentCacheStore* store)
+{
+	WINPR_ASSERT(store);
+
+	if (fsync(store->fd) != 0)
+	{
+		char ebuffer[256] = { 0 };
+		WLog_ERR(TAG, "syncing %s failed: %s", store->filename,
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL store_header_valid(const PERSISTENT_STORE_HEADER* header, UINT64 fileSize)
+{
+	WINPR_ASSERT(header);
+
+	if (memcmp(header->sig, store_sig_str, sizeof(store_sig_str)) != 0)
+		return FALSE;
+
+	if ((header->version != PERSISTENT_STORE_VERSION) || (header->maxEntries == 0) ||
+	    (header->count > header->maxEntries) || (header->dataSize > header->maxSize))
+		return FALSE;
+
+	const UINT64 dataOffset = store_data_offset(header->maxEntries);
+	if (header->maxSize > SIZE_MAX - dataOffset)
+		return FALSE;
+
+	return dataOffset + header->dataSize <= fileSize;
+}
+
+static size_t store_lookup_pos(const rdpPersistentCacheStore* store, UINT64 key64)
+{
+	WINPR_ASSERT(store);
+	return (size_t)((key64 * 0x9E3779B97F4A7C15ull) >> (64 - store->lookupBits));
+}
+
+static void store_lookup_insert(rdpPersistentCacheStore* store, UINT64 key64, UINT32 index)
+{
+	const size_t mask = (1ull << store->lookupBits) - 1;
+	size_t pos = store_lookup_pos(store, key64);
+
+	while (store->lookup[pos] != 0)
+		pos = (pos + 1) & mask;
+
+	store->lookup[pos] = index + 1;
+}
+
+static BOOL store_entry_valid(const rdpPersistentCacheStore* store,
+                              const PERSISTENT_STORE_ENTRY* entry)
+{
+	WINPR_ASSERT(store);
+
+	const UINT64 size = store_entry_size(entry);
+	return (size > 0) && (size <= UINT32_MAX) && (entry->offset <= store->header.dataSize) &&
+	       (size <= store->header.dataSize - entry->offset);
+}
+
+/* The index of a store that was closed cleanly is trusted, but the file might have been damaged
+ * or edited since. Entries must not point outside of the data. */
+static BOOL store_entries_valid(const rdpPersistentCacheStore* store)
+{
+	WINPR_ASSERT(store);
+
+	for (UINT32 x = 0; x < store->header.count; x++)
+	{
+		if (!store_entry_valid(store, &store->entries[x]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* A store that was not closed cleanly might contain entries whose data did not reach the disk.
+ * Keep only the entries that match their checksum. */
+static BOOL store_recover(rdpPersistentCacheStore* store)
+{
+	UINT32 kept = 0;
+	UINT64 end = 0;
+
+	WINPR_ASSERT(store);
+
+	const UINT32 count = store->header.count;
+	for (UINT32 x = 0; x < count; x++)
+	{
+		const PERSISTENT_STORE_ENTRY entry = store->entries[x];
+		const UINT64 size = store_entry_size(&entry);
+
+		if (!store_entry_valid(store, &entry))
+			continue;
+
+		if (store_checksum(&entry, &store->map[store->dataOffset + entry.offset]) !=
+		    entry.checksum)
+			continue;
+
+		if (kept != x)
+		{
+			if (!store_pwrite(store, sizeof(PERSISTENT_STORE_HEADER) + 1ull * kept * sizeof(entry),
+			                  &entry, sizeof(entry)))
+				return FALSE;
+		}
+
+		kept++;
+		end = MAX(end, entry.offset + size);
+	}
+
+	if (kept != count)
+		WLog_WARN(TAG,
+		          "%s was damaged or not closed cleanly, dropped %" PRIu32 " of %" PRIu32
+		          " entries",
+		          store->filename, count - kept, count);
+
+	store->header.count = kept;
+	store->header.dataSize = end;
+	return store_write_header(store);
+}
+
+static void store_close(rdpPersistentCacheStore* store)
+{
+	if (!store)
+		return;
+
+	if (store->map)
+		munmap((void*)store->map, store->mapSize);
+
+	if (store->fd >= 0)
+		close(store->fd);
+
+	free(store->lookup);
+	free(store->filename);
+	free(store);
+}
+
+static rdpPersistentCacheStore* store_open(const char* filename, UINT32 maxEntries,
+                                           UINT64 maxSize)
+{
+	struct stat st = { 0 };
+	PERSISTENT_STORE_HEADER header = { 0 };
+
+	WINPR_ASSERT(filename);
+
+	rdpPersistentCacheStore* store = calloc(1, sizeof(rdpPersistentCacheStore));
+	if (!store)
+		return NULL;
+
+	store->fd = -1;
+	store->filename = _strdup(filename);
+	if (!store->filename)
+		goto fail;
+
+	store->fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if ((store->fd < 0) || (fstat(store->fd, &st) != 0))
+	{
+		char ebuffer[256] = { 0 };
+		WLog_ERR(TAG, "opening %s failed: %s", filename,
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		goto fail;
+	}
+
+	const UINT64 fileSize = (UINT64)st.st_size;
+	if ((fileSize < sizeof(header)) ||
+	    (pread(store->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) ||
+	    !store_header_valid(&header, fileSize))
+	{
+		if (fileSize > 0)
+			WLog_WARN(TAG, "%s is not a valid cache store, recreating it", filename);
+
+		const PERSISTENT_STORE_HEADER empty = { 0 };
+		header = empty;
+		memcpy(header.sig, store_sig_str, sizeof(store_sig_str));
+		header.version = PERSISTENT_STORE_VERSION;
+		header.maxEntries = maxEntries;
+		header.maxSize = maxSize;
+
+		const UINT64 dataOffset = store_data_offset(maxEntries);
+		if ((maxEntries == 0) || (maxSize > SIZE_MAX - dataOffset) ||
+		    (ftruncate(store->fd, 0) != 0) || (ftruncate(store->fd, (off_t)dataOffset) != 0))
+			goto fail;
+	}
+
+	store->header = header;
+	store->dataOffset = store_data_offset(header.maxEntries);
+
+	/* The mapping covers the largest possible file, the pages beyond the end of the file are
+	 * never accessed. */
+	store->mapSize = (size_t)(store->dataOffset + header.maxSize);
+	void* map = mmap(NULL, store->mapSize, PROT_READ, MAP_SHARED, store->fd, 0);
+	if (map == MAP_FAILED)
+	{
+		char ebuffer[256] = { 0 };
+		WLog_ERR(TAG, "mapping %s failed: %s", filename,
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		goto fail;
+	}
+
+	store->map = map;
+	store->entries = (const PERSISTENT_STORE_ENTRY*)&store->map[sizeof(PERSISTENT_STORE_HEADER)];
+
+	if (((store->header.flags & PERSISTENT_STORE_FLAG_DIRTY) != 0) || !store_entries_valid(store))
+	{
+		if (!store_recover(store) || !store_sync(store))
+			goto fail;
+	}
+
+	store->header.flags |= PERSISTENT_STORE_FLAG_DIRTY;
+	if (!store_write_header(store) || !store_sync(store))
+		goto fail;
+
+	store->lookupBits = 1;
+	while ((1ull << store->lookupBits) < 2ull * store->header.maxEntries)
+		store->lookupBits++;
+
+	store->lookup = calloc(1ull << store->lookupBits, sizeof(UINT32));
+	if (!store->lookup)
+		goto fail;
+
+	for (UINT32 x = 0; x < store->header.count; x++)
+	{
+		store_lookup_insert(store, store->entries[x].key64, x);
+		store->header.sequence = MAX(store->header.sequence, store->entries[x].lastUse);
+	}
+
+	return store;
+fail:
+	store_close(store);
+	return NULL;
+}
+
+static BOOL store_needs_rebuild(const rdpPersistentCacheStore* store, UINT32 maxEntries,
+                                UINT64 maxSize)
+{
+	WINPR_ASSERT(store);
+
+	const PERSISTENT_STORE_HEADER* header = &store->header;
+	if ((header->maxEntries != maxEntries) || (header->maxSize != maxSize))
+		return TRUE;
+
+	return (header->count >= maxEntries - maxEntries / 10) ||
+	       (header->dataSize >= maxSize - maxSize / 10);
+}
+
+/* Copy the most recently used half of the store to a new file and replace the old one with it */
+static rdpPersistentCacheStore* store_rebuild(rdpPersistentCacheStore* store, UINT32 maxEntries,
+                                              UINT64 maxSize)
+{
+	char* tmp = NULL;
+	size_t* recent = NULL;
+	size_t tmpLen = 0;
+	rdpPersistentCacheStore* next = NULL;
+
+	WINPR_ASSERT(store);
+
+	char* filename = _strdup(store->filename);
+	if (!filename || (winpr_asprintf(&tmp, &tmpLen, "%s.tmp", filename) < 0))
+		goto fail;
+
+	(void)unlink(tmp);
+	next = store_open(tmp, maxEntries, maxSize);
+	recent = calloc(MAX(store->header.count, 1), sizeof(size_t));
+	if (!next || !recent)
+		goto fail;
+
+	const size_t count = persistent_cache_store_get_recent(store, recent, store->header.count);
+	size_t keep = 0;
+	UINT64 size = 0;
+	for (; (keep < count) && (keep < maxEntries / 2); keep++)
+	{
+		const UINT64 entrySize = store_entry_size(&store->entries[recent[keep]]);
+		if (size + entrySize > maxSize / 2)
+			break;
+		size += entrySize;
+	}
+
+	/* oldest first so that the use order is kept */
+	while (keep > 0)
+	{
+		PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+		keep--;
+		if (!persistent_cache_store_read_entry(store, recent[keep], &entry) ||
+		    (persistent_cache_store_write_entry(next, &entry) < 0))
+			goto fail;
+	}
+
+	WLog_DBG(TAG, "rebuilt %s, kept %" PRIu32 " of %" PRIu32 " entries", filename,
+	         next->header.count, store->header.count);
+
+	persistent_cache_store_free(next);
+	next = NULL;
+	store_close(store);
+	store = NULL;
+
+	if (rename(tmp, filename) != 0)
+		goto fail;
+
+	store = store_open(filename, maxEntries, maxSize);
+
+fail:
+	persistent_cache_store_free(next);
+	if (tmp)
+		(void)unlink(tmp);
+	if (!store && filename)
+		store = store_open(filename, maxEntries, maxSize);
+	free(recent);
+	free(tmp);
+	free(filename);
+	return store;
+}
+#endif
+
+size_t persistent_cache_store_get_count(const rdpPersistentCacheStore* store)
+{
+	WINPR_ASSERT(store);
+	return store->header.count;
+}
+
+static int store_use_compare(const void* pva, const void* pvb)
+{
+	const PERSISTENT_STORE_USE* a = pva;
+	const PERSISTENT_STORE_USE* b = pvb;
+
+	if (a->lastUse == b->lastUse)
+		return 0;
+	return (a->lastUse > b->lastUse) ? -1 : 1;
+}
+
+size_t persistent_cache_store_get_recent(const rdpPersistentCacheStore* store, size_t* indices,
+                                         size_t count)
+{
+	WINPR_ASSERT(store);
+	WINPR_ASSERT(indices || (count == 0));
+
+	const size_t total = store->header.count;
+	if ((total == 0) || (count == 0))
+		return 0;
+
+	PERSISTENT_STORE_USE* use = calloc(total, sizeof(PERSISTENT_STORE_USE));
+	if (!use)
+		return 0;
+
+	for (size_t x = 0; x < total; x++)
+	{
+		use[x].lastUse = store->entries[x].lastUse;
+		use[x].index = x;
+	}
+
+	qsort(use, total, sizeof(PERSISTENT_STORE_USE), store_use_compare);
+
+	count = MIN(count, total);
+	for (size_t x = 0; x < count; x++)
+		indices[x] = use[x].index;
+
+	free(use);
+	return count;
+}
+
+SSIZE_T persistent_cache_store_find(const rdpPersistentCacheStore* store, UINT64 key64)
+{
+	WINPR_ASSERT(store);
+
+#if !defined(_WIN32)
+	const size_t mask = (1ull << store->lookupBits) - 1;
+	for (size_t pos = store_lookup_pos(store, key64); store->lookup[pos] != 0;
+	     pos = (pos + 1) & mask)
+	{
+		const UINT32 index = store->lookup[pos] - 1;
+		if (store->entries[index].key64 == key64)
+			return (SSIZE_T)index;
+	}
+#else
+	WINPR_UNUSED(key64);
+#endif
+
+	return -1;
+}
+
+BOOL persistent_cache_store_read_entry(rdpPersistentCacheStore* store, size_t index,
+                                       PERSISTENT_CACHE_ENTRY* entry)
+{
+	WINPR_ASSERT(store);
+	WINPR_ASSERT(entry);
+
+	if (index >= store->header.count)
+		return FALSE;
+
+	const PERSISTENT_STORE_ENTRY* cur = &store->entries[index];
+#if !defined(_WIN32)
+	if (!store_entry_valid(store, cur))
+		return FALSE;
+#endif
+
+	entry->key64 = cur->key64;
+	entry->width = cur->width;
+	entry->height = cur->height;
+	entry->size = (UINT32)(4ull * cur->width * cur->height);
+	entry->flags = 0;
+	entry->data = (BYTE*)&store->map[store->dataOffset + cur->offset];
+	return TRUE;
+}
+
+int persistent_cache_store_write_entry(rdpPersistentCacheStore* store,
+                                       const PERSISTENT_CACHE_ENTRY* entry)
+{
+	WINPR_ASSERT(store);
+	WINPR_ASSERT(entry);
+
+#if !defined(_WIN32)
+	PERSISTENT_STORE_HEADER* header = &store->header;
+	const UINT64 size = 4ull * entry->width * entry->height;
+
+	if (!entry->data || (entry->size != size))
+		return -1;
+
+	if ((size == 0) || (persistent_cache_store_find(store, entry->key64) >= 0))
+		return 0;
+
+	if ((header->count >= header->maxEntries) || (size > header->maxSize - header->dataSize))
+		return 0;
+
+	PERSISTENT_STORE_ENTRY cur = { 0 };
+	cur.key64 = entry->key64;
+	cur.offset = header->dataSize;
+	cur.lastUse = header->sequence + 1;
+	cur.width = entry->width;
+	cur.height = entry->height;
+	cur.checksum = store_checksum(&cur, entry->data);
+
+	/* data, index entry and the header with the new count, in this order */
+	if (!store_pwrite(store, store->dataOffset + cur.offset, entry->data, (size_t)size) ||
+	    !store_pwrite(store,
+	                  sizeof(PERSISTENT_STORE_HEADER) + 1ull * header->count * sizeof(cur), &cur,
+	                  sizeof(cur)))
+		return -1;
+
+	header->sequence++;
+	header->dataSize += size;
+	header->count++;
+	if (!store_write_header(store))
+	{
+		header->count--;
+		header->dataSize -= size;
+		return -1;
+	}
+
+	store_lookup_insert(store, cur.key64, header->count - 1);
+	return 1;
+#else
+	return -1;
+#endif
+}
+
+BOOL persistent_cache_store_touch(rdpPersistentCacheStore* store, size_t index)
+{
+	WINPR_ASSERT(store);
+
+#if !defined(_WIN32)
+	if (index >= store->header.count)
+		return FALSE;
+
+	const UINT64 lastUse = ++store->header.sequence;
+	return store_pwrite(store,
+	                    sizeof(PERSISTENT_STORE_HEADER) +
+	                        1ull * index * sizeof(PERSISTENT_STORE_ENTRY) +
+	                        offsetof(PERSISTENT_STORE_ENTRY, lastUse),
+	                    &lastUse, sizeof(lastUse));
+#else
+	WINPR_UNUSED(index);
+	return FALSE;
+#endif
+}
+
+BOOL persistent_cache_store_flush(rdpPersistentCacheStore* store)
+{
+	WINPR_ASSERT(store);
+
+#if !defined(_WIN32)
+	return store_write_header(store) && store_sync(store);
+#else
+	return FALSE;
+#endif
+}
+
+void persistent_cache_store_free(rdpPersistentCacheStore* store)
+{
+	if (!store)
+		return;
+
+#if !defined(_WIN32)
+	/* the dirty flag is only cleared once everything else is on disk */
+	if (persistent_cache_store_flush(store))
+	{
+		store->header.flags &= (UINT32)~PERSISTENT_STORE_FLAG_DIRTY;
+		if (store_write_header(store))
+			(void)store_sync(store);
+	}
+
+	store_close(store);
+#endif
+}
+
+rdpPersistentCacheStore* persistent_cache_store_new(const char* filename, UINT32 maxEntries,
+                                                    UINT64 maxSize)
+{
+	WINPR_ASSERT(filename);
+
+#if !defined(_WIN32)
+	rdpPersistentCacheStore* store = store_open(filename, maxEntries, maxSize);
+
+	if (store && store_needs_rebuild(store, maxEntries, maxSize))
+		store = store_rebuild(store, maxEntries, maxSize);
+
+	return store;
+#else
+	WINPR_UNUSED(maxEntries);
+	WINPR_UNUSED(maxSize);
+	WLog_WARN(TAG, "persistent cache stores are not supported on this platform");
+	return NULL;
+#endif
+}
@@ -0,0 +1,315 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent cache store test
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/cache/persistent.h>
+
+#define TEST_ENTRIES 40
+#define TEST_MAX_SIZE (1024ull * 1024ull)
+
+static UINT16 test_width(size_t index)
+{
+	return (UINT16)(3 + index % 7);
+}
+
+static UINT16 test_height(size_t index)
+{
+	return (UINT16)(5 + index % 11);
+}
+
+static UINT64 test_key(size_t index)
+{
+	return 0x1234567800000000ull + index * 0x10001ull;
+}
+
+static BOOL test_entry_equal(rdpPersistentCacheStore* store, BYTE* const* data, size_t index)
+{
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+	const SSIZE_T pos = persistent_cache_store_find(store, test_key(index));
+	if (pos < 0)
+	{
+		printf("entry %" PRIuz " not found\n", index);
+		return FALSE;
+	}
+
+	if (!persistent_cache_store_read_entry(store, (size_t)pos, &entry))
+		return FALSE;
+
+	if ((entry.key64 != test_key(index)) || (entry.width != test_width(index)) ||
+	    (entry.height != test_height(index)) ||
+	    (entry.size != 4ul * entry.width * entry.height) ||
+	    (memcmp(entry.data, data[index], entry.size) != 0))
+	{
+		printf("entry %" PRIuz " differs\n", index);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_fill(const char* filename, BYTE* const* data)
+{
+	BOOL rc = FALSE;
+	rdpPersistentCacheStore* store =
+	    persistent_cache_store_new(filename, TEST_ENTRIES * 2, TEST_MAX_SIZE);
+	if (!store)
+		return FALSE;
+
+	for (size_t x = 0; x < TEST_ENTRIES; x++)
+	{
+		const PERSISTENT_CACHE_ENTRY entry = { test_key(x),
+			                                   test_width(x),
+			                                   test_height(x),
+			                                   4ul * test_width(x) * test_height(x),
+			                                   0,
+			                                   data[x] };
+
+		if (persistent_cache_store_write_entry(store, &entry) != 1)
+			goto fail;
+
+		/* known keys are not stored twice */
+		if (persistent_cache_store_write_entry(store, &entry) != 0)
+			goto fail;
+	}
+
+	for (size_t x = 0; x < TEST_ENTRIES; x++)
+	{
+		if (!test_entry_equal(store, data, x))
+			goto fail;
+	}
+
+	/* a zero sized entry is not stored */
+	const PERSISTENT_CACHE_ENTRY empty = { 23, 0, 0, 0, 0, data[0] };
+	if (persistent_cache_store_write_entry(store, &empty) != 0)
+		goto fail;
+
+	rc = persistent_cache_store_get_count(store) == TEST_ENTRIES;
+fail:
+	persistent_cache_store_free(store);
+	return rc;
+}
+
+static BOOL test_reopen(const char* filename, BYTE* const* data)
+{
+	BOOL rc = FALSE;
+	size_t recent[TEST_ENTRIES] = { 0 };
+	rdpPersistentCacheStore* store =
+	    persistent_cache_store_new(filename, TEST_ENTRIES * 2, TEST_MAX_SIZE);
+	if (!store)
+		return FALSE;
+
+	if (persistent_cache_store_get_count(store) != TEST_ENTRIES)
+		goto fail;
+
+	for (size_t x = 0; x < TEST_ENTRIES; x++)
+	{
+		if (!test_entry_equal(store, data, x))
+			goto fail;
+	}
+
+	/* the last written entry is the most recent one until another one is used */
+	if ((persistent_cache_store_get_recent(store, recent, ARRAYSIZE(recent)) != TEST_ENTRIES) ||
+	    (recent[0] != (size_t)persistent_cache_store_find(store, test_key(TEST_ENTRIES - 1))))
+		goto fail;
+
+	const SSIZE_T pos = persistent_cache_store_find(store, test_key(3));
+	if ((pos < 0) || !persistent_cache_store_touch(store, (size_t)pos))
+		goto fail;
+
+	if ((persistent_cache_store_get_recent(store, recent, 1) != 1) || (recent[0] != (size_t)pos))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	persistent_cache_store_free(store);
+	return rc;
+}
+
+/* simulate a store that was not closed and whose last entry did not fully reach the disk */
+static BOOL test_recover(const char* filename, BYTE* const* data)
+{
+	BOOL rc = FALSE;
+	const UINT32 dirty = 1;
+	const BYTE garbage = 0xA5;
+	rdpPersistentCacheStore* store = NULL;
+	FILE* fp = winpr_fopen(filename, "r+b");
+	if (!fp)
+		return FALSE;
+
+	const BOOL written = (fseek(fp, 12, SEEK_SET) == 0) && (fwrite(&dirty, 4, 1, fp) == 1) &&
+	                     (fseek(fp, -1, SEEK_END) == 0) && (fwrite(&garbage, 1, 1, fp) == 1);
+	(void)fclose(fp);
+	if (!written)
+		return FALSE;
+
+	store = persistent_cache_store_new(filename, TEST_ENTRIES * 2, TEST_MAX_SIZE);
+	if (!store)
+		return FALSE;
+
+	if ((persistent_cache_store_get_count(store) != TEST_ENTRIES - 1) ||
+	    (persistent_cache_store_find(store, test_key(TEST_ENTRIES - 1)) >= 0))
+		goto fail;
+
+	for (size_t x = 0; x < TEST_ENTRIES - 1; x++)
+	{
+		if (!test_entry_equal(store, data, x))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	persistent_cache_store_free(store);
+	return rc;
+}
+
+/* a store closed cleanly whose first index entry was edited to point past the data */
+static BOOL test_damaged(const char* filename, BYTE* const* data)
+{
+	BOOL rc = FALSE;
+	const UINT64 offset = 0xFFFFFFFF00ull;
+	rdpPersistentCacheStore* store = NULL;
+	FILE* fp = winpr_fopen(filename, "r+b");
+	if (!fp)
+		return FALSE;
+
+	/* the offset of the entry following the 48 byte header and its key */
+	const BOOL written = (fseek(fp, 48 + 8, SEEK_SET) == 0) && (fwrite(&offset, 8, 1, fp) == 1);
+	(void)fclose(fp);
+	if (!written)
+		return FALSE;
+
+	store = persistent_cache_store_new(filename, TEST_ENTRIES * 2, TEST_MAX_SIZE);
+	if (!store)
+		return FALSE;
+
+	if ((persistent_cache_store_get_count(store) != TEST_ENTRIES - 2) ||
+	    (persistent_cache_store_find(store, test_key(0)) >= 0))
+		goto fail;
+
+	for (size_t x = 1; x < TEST_ENTRIES - 1; x++)
+	{
+		if (!test_entry_equal(store, data, x))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	persistent_cache_store_free(store);
+	return rc;
+}
+
+/* a full store keeps the most recently used half */
+static BOOL test_rebuild(const char* filename, BYTE* const* data)
+{
+	BOOL rc = FALSE;
+	rdpPersistentCacheStore* store =
+	    persistent_cache_store_new(filename, TEST_ENTRIES, TEST_MAX_SIZE);
+	if (!store)
+		return FALSE;
+
+	const size_t count = persistent_cache_store_get_count(store);
+	if ((count == 0) || (count > TEST_ENTRIES / 2))
+		goto fail;
+
+	/* entry 3 was touched last, then the most recently written ones */
+	if (!test_entry_equal(store, data, 3) || !test_entry_equal(store, data, TEST_ENTRIES - 2))
+		goto fail;
+
+	if (persistent_cache_store_find(store, test_key(0)) >= 0)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	persistent_cache_store_free(store);
+	return rc;
+}
+
+int TestPersistentCacheStore(int argc, char* argv[])
+{
+	int rc = -1;
+	char name[64] = { 0 };
+	char* filename = NULL;
+	BYTE* data[TEST_ENTRIES] = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+#if defined(_WIN32)
+	return 0;
+#endif
+
+	(void)sprintf_s(name, sizeof(name), "TestPersistentCacheStore-%08" PRIx32 ".bin",
+	                GetTickCount());
+	filename = GetKnownSubPath(KNOWN_PATH_TEMP, name);
+	if (!filename)
+		return -1;
+
+	for (size_t x = 0; x < TEST_ENTRIES; x++)
+	{
+		const size_t size = 4ull * test_width(x) * test_height(x);
+		data[x] = malloc(size);
+		if (!data[x])
+			goto fail;
+		winpr_RAND(data[x], size);
+	}
+
+	if (!test_fill(filename, data))
+	{
+		printf("filling the store failed\n");
+		goto fail;
+	}
+
+	if (!test_reopen(filename, data))
+	{
+		printf("reopening the store failed\n");
+		goto fail;
+	}
+
+	if (!test_recover(filename, data))
+	{
+		printf("recovering the store failed\n");
+		goto fail;
+	}
+
+	if (!test_damaged(filename, data))
+	{
+		printf("opening the damaged store failed\n");
+		goto fail;
+	}
+
+	if (!test_rebuild(filename, data))
+	{
+		printf("rebuilding the store failed\n");
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	for (size_t x = 0; x < TEST_ENTRIES; x++)
+		free(data[x]);
+	(void)winpr_DeleteFile(filename);
+	free(filename);
+	return rc;
+}
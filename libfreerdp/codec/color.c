@@ -1182,6 +1182,73 @@ static int av_format_for_buffer(UINT32 format)
 }
 #endif
 
+#if !defined(WITH_SWSCALE) && !defined(WITH_CAIRO)
+/* Scale with the built-in 32bpp scaler, other formats are converted through temporary buffers */
+static BOOL freerdp_image_scale_prim(BYTE* WINPR_RESTRICT pDstData, DWORD DstFormat,
+                                     UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst,
+                                     UINT32 nDstWidth, UINT32 nDstHeight,
+                                     const BYTE* WINPR_RESTRICT pSrcData, DWORD SrcFormat,
+                                     UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc,
+                                     UINT32 nSrcWidth, UINT32 nSrcHeight)
+{
+	BOOL rc = FALSE;
+	BYTE* srcTmp = NULL;
+	BYTE* dstTmp = NULL;
+	primitives_t* prims = primitives_get();
+
+	WINPR_ASSERT(prims);
+
+	DWORD format = PIXEL_FORMAT_BGRA32;
+	if (FreeRDPGetBytesPerPixel(SrcFormat) == 4)
+		format = SrcFormat;
+	else if (FreeRDPGetBytesPerPixel(DstFormat) == 4)
+		format = DstFormat;
+
+	const BYTE* src = &pSrcData[4ull * nXSrc + 1ull * nYSrc * nSrcStep];
+	UINT32 srcStep = nSrcStep;
+	if (format != SrcFormat)
+	{
+		srcStep = nSrcWidth * 4;
+		srcTmp = winpr_aligned_malloc(1ull * srcStep * nSrcHeight, 32);
+		if (!srcTmp)
+			goto fail;
+
+		if (!freerdp_image_copy_no_overlap(srcTmp, format, srcStep, 0, 0, nSrcWidth, nSrcHeight,
+		                                   pSrcData, SrcFormat, nSrcStep, nXSrc, nYSrc, NULL,
+		                                   FREERDP_FLIP_NONE))
+			goto fail;
+		src = srcTmp;
+	}
+
+	if (FreeRDPAreColorFormatsEqualNoAlpha(format, DstFormat))
+	{
+		BYTE* dst = &pDstData[4ull * nXDst + 1ull * nYDst * nDstStep];
+		rc = prims->scale_8u_C4R(src, srcStep, nSrcWidth, nSrcHeight, dst, nDstStep, nDstWidth,
+		                         nDstHeight, NULL, PRIM_SCALE_BILINEAR) == PRIMITIVES_SUCCESS;
+	}
+	else
+	{
+		const UINT32 dstStep = nDstWidth * 4;
+		dstTmp = winpr_aligned_malloc(1ull * dstStep * nDstHeight, 32);
+		if (!dstTmp)
+			goto fail;
+
+		if (prims->scale_8u_C4R(src, srcStep, nSrcWidth, nSrcHeight, dstTmp, dstStep, nDstWidth,
+		                        nDstHeight, NULL, PRIM_SCALE_BILINEAR) != PRIMITIVES_SUCCESS)
+			goto fail;
+
+		rc = freerdp_image_copy_no_overlap(pDstData, DstFormat, nDstStep, nXDst, nYDst, nDstWidth,
+		                                   nDstHeight, dstTmp, format, dstStep, 0, 0, NULL,
+		                                   FREERDP_FLIP_NONE);
+	}
+
+fail:
+	winpr_aligned_free(srcTmp);
+	winpr_aligned_free(dstTmp);
+	return rc;
+}
+#endif
+
 BOOL freerdp_image_scale(BYTE* WINPR_RESTRICT pDstData, DWORD DstFormat, UINT32 nDstStep,
                          UINT32 nXDst, UINT32 nYDst, UINT32 nDstWidth, UINT32 nDstHeight,
                          const BYTE* WINPR_RESTRICT pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
@@ -1271,7 +1338,9 @@ BOOL freerdp_image_scale(BYTE* WINPR_RESTRICT pDstData, DWORD DstFormat, UINT32
 	}
 #else
 	{
-		WLog_WARN(TAG, "SmartScaling requested but compiled without libcairo support!");
+		rc = freerdp_image_scale_prim(pDstData, DstFormat, nDstStep, nXDst, nYDst, nDstWidth,
+		                              nDstHeight, pSrcData, SrcFormat, nSrcStep, nXSrc, nYSrc,
+		                              nSrcWidth, nSrcHeight);
 	}
 #endif
 	return rc;
@@ -31,6 +31,8 @@
 #include <freerdp/codec/dsp.h>
 
 #include "dsp.h"
+#include "dsp_adpcm.h"
+#include "dsp_resample.h"
 
 #if defined(WITH_FDK_AAC)
 #include "dsp_fdk_aac.h"
@@ -71,23 +73,6 @@
 
 #define TAG FREERDP_TAG("dsp")
 
-typedef union
-{
-	struct
-	{
-		size_t packet_size;
-		INT16 last_sample[2];
-		INT16 last_step[2];
-	} ima;
-	struct
-	{
-		BYTE predictor[2];
-		INT32 delta[2];
-		INT32 sample1[2];
-		INT32 sample2[2];
-	} ms;
-} ADPCM;
-
 struct S_FREERDP_DSP_CONTEXT
 {
 	FREERDP_DSP_COMMON_CONTEXT common;
@@ -118,6 +103,8 @@ struct S_FREERDP_DSP_CONTEXT
 
 #if defined(WITH_SOXR)
 	soxr_t sox;
+#else
+	FREERDP_DSP_RESAMPLER* resampler;
 #endif
 };
 
@@ -140,11 +127,6 @@ static BOOL opus_is_valid_samplerate(const AUDIO_FORMAT* WINPR_RESTRICT format)
 }
 #endif
 
-static INT16 read_int16(const BYTE* WINPR_RESTRICT src)
-{
-	return (INT16)(src[0] | (src[1] << 8));
-}
-
 static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
                                     const BYTE* WINPR_RESTRICT src, size_t size,
                                     const AUDIO_FORMAT* WINPR_RESTRICT srcFormat,
@@ -174,16 +156,23 @@ static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 		switch (srcFormat->nChannels)
 		{
 			case 1:
-				if (!Stream_EnsureCapacity(context->common.channelmix, size * 2))
+				if (!Stream_EnsureCapacity(context->common.channelmix, samples * bpp * 2))
 					return FALSE;
 
-				for (size_t x = 0; x < samples; x++)
+				if (bpp == 2)
 				{
-					for (size_t y = 0; y < bpp; y++)
-						Stream_Write_UINT8(context->common.channelmix, src[x * bpp + y]);
-
-					for (size_t y = 0; y < bpp; y++)
-						Stream_Write_UINT8(context->common.channelmix, src[x * bpp + y]);
+					const FREERDP_DSP_RESAMPLE_KERNELS* kernels = freerdp_dsp_resample_kernels();
+					INT16* dst = Stream_PointerAs(context->common.channelmix, INT16);
+					kernels->upmix_s16((const INT16*)src, dst, samples);
+					Stream_Seek(context->common.channelmix, samples * bpp * 2);
+				}
+				else
+				{
+					for (size_t x = 0; x < samples; x++)
+					{
+						Stream_Write_UINT8(context->common.channelmix, src[x]);
+						Stream_Write_UINT8(context->common.channelmix, src[x]);
+					}
 				}
 
 				Stream_SealLength(context->common.channelmix);
@@ -201,15 +190,23 @@ static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	switch (srcFormat->nChannels)
 	{
 		case 2:
-			if (!Stream_EnsureCapacity(context->common.channelmix, size / 2))
+			if (!Stream_EnsureCapacity(context->common.channelmix, samples * bpp))
 				return FALSE;
 
-			/* Simply drop second channel.
-			 * TODO: Calculate average */
-			for (size_t x = 0; x < samples; x++)
+			if (bpp == 2)
 			{
-				for (size_t y = 0; y < bpp; y++)
-					Stream_Write_UINT8(context->common.channelmix, src[2 * x * bpp + y]);
+				const FREERDP_DSP_RESAMPLE_KERNELS* kernels = freerdp_dsp_resample_kernels();
+				INT16* dst = Stream_PointerAs(context->common.channelmix, INT16);
+				kernels->downmix_s16((const INT16*)src, dst, samples);
+				Stream_Seek(context->common.channelmix, samples * bpp);
+			}
+			else
+			{
+				for (size_t x = 0; x < samples; x++)
+				{
+					const BYTE avg = (BYTE)((src[2 * x] + src[2 * x + 1]) / 2);
+					Stream_Write_UINT8(context->common.channelmix, avg);
+				}
 			}
 
 			Stream_SealLength(context->common.channelmix);
@@ -292,153 +289,35 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	*length = Stream_Length(context->common.resample);
 	return (error == 0) ? TRUE : FALSE;
 #else
-	WLog_ERR(TAG, "Missing resample support, recompile -DWITH_SOXR=ON or -DWITH_DSP_FFMPEG=ON");
-	return FALSE;
-#endif
-}
-
-/**
- * Microsoft IMA ADPCM specification:
- *
- * http://wiki.multimedia.cx/index.php?title=Microsoft_IMA_ADPCM
- * http://wiki.multimedia.cx/index.php?title=IMA_ADPCM
- */
-
-static const INT16 ima_step_index_table[] = {
-	-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
-};
-
-static const INT16 ima_step_size_table[] = {
-	7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,   21,    23,
-	25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,   73,    80,
-	88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,  253,   279,
-	307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,  876,   963,
-	1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749, 3024,  3327,
-	3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487,
-	12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
-};
-
-static UINT16 dsp_decode_ima_adpcm_sample(ADPCM* WINPR_RESTRICT adpcm, unsigned int channel,
-                                          BYTE sample)
-{
-	const INT32 ss = ima_step_size_table[adpcm->ima.last_step[channel]];
-	INT32 d = (ss >> 3);
-
-	if (sample & 1)
-		d += (ss >> 2);
-
-	if (sample & 2)
-		d += (ss >> 1);
-
-	if (sample & 4)
-		d += ss;
-
-	if (sample & 8)
-		d = -d;
-
-	d += adpcm->ima.last_sample[channel];
-
-	if (d < -32768)
-		d = -32768;
-	else if (d > 32767)
-		d = 32767;
-
-	adpcm->ima.last_sample[channel] = (INT16)d;
-	adpcm->ima.last_step[channel] += ima_step_index_table[sample];
-
-	if (adpcm->ima.last_step[channel] < 0)
-		adpcm->ima.last_step[channel] = 0;
-	else if (adpcm->ima.last_step[channel] > 88)
-		adpcm->ima.last_step[channel] = 88;
-
-	return (UINT16)d;
-}
-
-static BOOL freerdp_dsp_decode_ima_adpcm(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
-                                         const BYTE* WINPR_RESTRICT src, size_t size,
-                                         wStream* WINPR_RESTRICT out)
-{
-	size_t out_size = size * 4;
-	const UINT32 block_size = context->common.format.nBlockAlign;
-	const UINT32 channels = context->common.format.nChannels;
-
-	if (!Stream_EnsureCapacity(out, out_size))
+	if (srcFormat->wBitsPerSample != 16)
+	{
+		WLog_ERR(TAG, "resampling requires 16 bit samples, got %" PRIu16,
+		         srcFormat->wBitsPerSample);
 		return FALSE;
+	}
 
-	while (size > 0)
+	if (!freerdp_dsp_resampler_matches(context->resampler, srcFormat->nSamplesPerSec,
+	                                   context->common.format.nSamplesPerSec,
+	                                   srcFormat->nChannels))
 	{
-		if (size % block_size == 0)
-		{
-			context->adpcm.ima.last_sample[0] =
-			    (INT16)(((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-			context->adpcm.ima.last_step[0] = (INT16)(*(src + 2));
-			src += 4;
-			size -= 4;
-			out_size -= 16;
-
-			if (channels > 1)
-			{
-				context->adpcm.ima.last_sample[1] =
-				    (INT16)(((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-				context->adpcm.ima.last_step[1] = (INT16)(*(src + 2));
-				src += 4;
-				size -= 4;
-				out_size -= 16;
-			}
-		}
-
-		if (channels > 1)
-		{
-			for (size_t i = 0; i < 8; i++)
-			{
-				BYTE* dst = Stream_Pointer(out);
-
-				const int channel = (i < 4 ? 0 : 1);
-				{
-					const BYTE sample = ((*src) & 0x0f);
-					const UINT16 decoded =
-					    dsp_decode_ima_adpcm_sample(&context->adpcm, channel, sample);
-					dst[((i & 3) << 3) + (channel << 1)] = (decoded & 0xFF);
-					dst[((i & 3) << 3) + (channel << 1) + 1] = (decoded >> 8);
-				}
-				{
-					const BYTE sample = ((*src) >> 4);
-					const UINT16 decoded =
-					    dsp_decode_ima_adpcm_sample(&context->adpcm, channel, sample);
-					dst[((i & 3) << 3) + (channel << 1) + 4] = (decoded & 0xFF);
-					dst[((i & 3) << 3) + (channel << 1) + 5] = (decoded >> 8);
-				}
-				src++;
-			}
+		freerdp_dsp_resampler_free(context->resampler);
+		context->resampler =
+		    freerdp_dsp_resampler_new(srcFormat->nSamplesPerSec,
+		                              context->common.format.nSamplesPerSec, srcFormat->nChannels);
+		if (!context->resampler)
+			return FALSE;
+	}
 
-			if (!Stream_SafeSeek(out, 32))
-				return FALSE;
-			size -= 8;
-		}
-		else
-		{
-			BYTE* dst = Stream_Pointer(out);
-			if (!Stream_SafeSeek(out, 4))
-				return FALSE;
+	Stream_SetPosition(context->common.resample, 0);
 
-			{
-				const BYTE sample = ((*src) & 0x0f);
-				const UINT16 decoded = dsp_decode_ima_adpcm_sample(&context->adpcm, 0, sample);
-				*dst++ = (decoded & 0xFF);
-				*dst++ = (decoded >> 8);
-			}
-			{
-				const BYTE sample = ((*src) >> 4);
-				const UINT16 decoded = dsp_decode_ima_adpcm_sample(&context->adpcm, 0, sample);
-				*dst++ = (decoded & 0xFF);
-				*dst++ = (decoded >> 8);
-			}
-			src++;
-			size--;
-		}
-	}
+	if (!freerdp_dsp_resampler_process(context->resampler, src, size, context->common.resample))
+		return FALSE;
 
+	Stream_SealLength(context->common.resample);
+	*data = Stream_Buffer(context->common.resample);
+	*length = Stream_Length(context->common.resample);
 	return TRUE;
+#endif
 }
 
 #if defined(WITH_GSM)
@@ -731,392 +610,6 @@ static BOOL freerdp_dsp_decode_faad(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 
 #endif
 
-/**
- * 0     1     2     3
- * 2 0   6 4   10 8  14 12   <left>
- *
- * 4     5     6     7
- * 3 1   7 5   11 9  15 13   <right>
- */
-static const struct
-{
-	BYTE byte_num;
-	BYTE byte_shift;
-} ima_stereo_encode_map[] = { { 0, 0 }, { 4, 0 }, { 0, 4 }, { 4, 4 }, { 1, 0 }, { 5, 0 },
-	                          { 1, 4 }, { 5, 4 }, { 2, 0 }, { 6, 0 }, { 2, 4 }, { 6, 4 },
-	                          { 3, 0 }, { 7, 0 }, { 3, 4 }, { 7, 4 } };
-
-static BYTE dsp_encode_ima_adpcm_sample(ADPCM* WINPR_RESTRICT adpcm, int channel, INT16 sample)
-{
-	INT32 ss = ima_step_size_table[adpcm->ima.last_step[channel]];
-	INT32 e = sample - adpcm->ima.last_sample[channel];
-	INT32 d = e;
-	INT32 diff = ss >> 3;
-	BYTE enc = 0;
-
-	if (e < 0)
-	{
-		enc = 8;
-		e = -e;
-	}
-
-	if (e >= ss)
-	{
-		enc |= 4;
-		e -= ss;
-	}
-
-	ss >>= 1;
-
-	if (e >= ss)
-	{
-		enc |= 2;
-		e -= ss;
-	}
-
-	ss >>= 1;
-
-	if (e >= ss)
-	{
-		enc |= 1;
-		e -= ss;
-	}
-
-	if (d < 0)
-		diff = d + e - diff;
-	else
-		diff = d - e + diff;
-
-	diff += adpcm->ima.last_sample[channel];
-
-	if (diff < -32768)
-		diff = -32768;
-	else if (diff > 32767)
-		diff = 32767;
-
-	adpcm->ima.last_sample[channel] = (INT16)diff;
-	adpcm->ima.last_step[channel] += ima_step_index_table[enc];
-
-	if (adpcm->ima.last_step[channel] < 0)
-		adpcm->ima.last_step[channel] = 0;
-	else if (adpcm->ima.last_step[channel] > 88)
-		adpcm->ima.last_step[channel] = 88;
-
-	return enc;
-}
-
-static BOOL freerdp_dsp_encode_ima_adpcm(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
-                                         const BYTE* WINPR_RESTRICT src, size_t size,
-                                         wStream* WINPR_RESTRICT out)
-{
-	if (!Stream_EnsureRemainingCapacity(out, size))
-		return FALSE;
-	if (!Stream_EnsureRemainingCapacity(context->common.buffer, size + 64))
-		return FALSE;
-
-	const size_t align = (context->common.format.nChannels > 1) ? 32 : 4;
-
-	while (size >= align)
-	{
-		if (Stream_GetPosition(context->common.buffer) % context->common.format.nBlockAlign == 0)
-		{
-			Stream_Write_UINT8(context->common.buffer, context->adpcm.ima.last_sample[0] & 0xFF);
-			Stream_Write_UINT8(context->common.buffer,
-			                   (context->adpcm.ima.last_sample[0] >> 8) & 0xFF);
-			Stream_Write_UINT8(context->common.buffer, (BYTE)context->adpcm.ima.last_step[0]);
-			Stream_Write_UINT8(context->common.buffer, 0);
-
-			if (context->common.format.nChannels > 1)
-			{
-				Stream_Write_UINT8(context->common.buffer,
-				                   context->adpcm.ima.last_sample[1] & 0xFF);
-				Stream_Write_UINT8(context->common.buffer,
-				                   (context->adpcm.ima.last_sample[1] >> 8) & 0xFF);
-				Stream_Write_UINT8(context->common.buffer, (BYTE)context->adpcm.ima.last_step[1]);
-				Stream_Write_UINT8(context->common.buffer, 0);
-			}
-		}
-
-		if (context->common.format.nChannels > 1)
-		{
-			BYTE* dst = Stream_Pointer(context->common.buffer);
-			ZeroMemory(dst, 8);
-
-			for (size_t i = 0; i < 16; i++)
-			{
-				const INT16 sample = (INT16)(((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-				src += 2;
-				const BYTE encoded = dsp_encode_ima_adpcm_sample(&context->adpcm, i % 2, sample);
-				dst[ima_stereo_encode_map[i].byte_num] |= encoded
-				                                          << ima_stereo_encode_map[i].byte_shift;
-			}
-
-			if (!Stream_SafeSeek(context->common.buffer, 8))
-				return FALSE;
-			size -= 32;
-		}
-		else
-		{
-			INT16 sample = (INT16)(((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-			src += 2;
-			BYTE encoded = dsp_encode_ima_adpcm_sample(&context->adpcm, 0, sample);
-			sample = (INT16)(((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-			src += 2;
-			encoded |= dsp_encode_ima_adpcm_sample(&context->adpcm, 0, sample) << 4;
-			Stream_Write_UINT8(context->common.buffer, encoded);
-			size -= 4;
-		}
-
-		if (Stream_GetPosition(context->common.buffer) >= context->adpcm.ima.packet_size)
-		{
-			BYTE* bsrc = Stream_Buffer(context->common.buffer);
-			Stream_Write(out, bsrc, context->adpcm.ima.packet_size);
-			Stream_SetPosition(context->common.buffer, 0);
-		}
-	}
-
-	return TRUE;
-}
-
-/**
- * Microsoft ADPCM Specification:
- *
- * http://wiki.multimedia.cx/index.php?title=Microsoft_ADPCM
- */
-
-static const INT32 ms_adpcm_adaptation_table[] = { 230, 230, 230, 230, 307, 409, 512, 614,
-	                                               768, 614, 512, 409, 307, 230, 230, 230 };
-
-static const INT32 ms_adpcm_coeffs1[7] = { 256, 512, 0, 192, 240, 460, 392 };
-
-static const INT32 ms_adpcm_coeffs2[7] = { 0, -256, 0, 64, 0, -208, -232 };
-
-static INLINE INT16 freerdp_dsp_decode_ms_adpcm_sample(ADPCM* WINPR_RESTRICT adpcm, BYTE sample,
-                                                       int channel)
-{
-	const INT8 nibble = (sample & 0x08 ? (INT8)sample - 16 : (INT8)sample);
-	INT32 presample =
-	    ((adpcm->ms.sample1[channel] * ms_adpcm_coeffs1[adpcm->ms.predictor[channel]]) +
-	     (adpcm->ms.sample2[channel] * ms_adpcm_coeffs2[adpcm->ms.predictor[channel]])) /
-	    256;
-	presample += nibble * adpcm->ms.delta[channel];
-
-	if (presample > 32767)
-		presample = 32767;
-	else if (presample < -32768)
-		presample = -32768;
-
-	adpcm->ms.sample2[channel] = adpcm->ms.sample1[channel];
-	adpcm->ms.sample1[channel] = presample;
-	adpcm->ms.delta[channel] = adpcm->ms.delta[channel] * ms_adpcm_adaptation_table[sample] / 256;
-
-	if (adpcm->ms.delta[channel] < 16)
-		adpcm->ms.delta[channel] = 16;
-
-	return (INT16)presample;
-}
-
-static BOOL freerdp_dsp_decode_ms_adpcm(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
-                                        const BYTE* WINPR_RESTRICT src, size_t size,
-                                        wStream* WINPR_RESTRICT out)
-{
-	const size_t out_size = size * 4;
-	const UINT32 channels = context->common.format.nChannels;
-	const UINT32 block_size = context->common.format.nBlockAlign;
-
-	if (!Stream_EnsureCapacity(out, out_size))
-		return FALSE;
-
-	while (size > 0)
-	{
-		if (size % block_size == 0)
-		{
-			if (channels > 1)
-			{
-				context->adpcm.ms.predictor[0] = *src++;
-				context->adpcm.ms.predictor[1] = *src++;
-				context->adpcm.ms.delta[0] = read_int16(src);
-				src += 2;
-				context->adpcm.ms.delta[1] = read_int16(src);
-				src += 2;
-				context->adpcm.ms.sample1[0] = read_int16(src);
-				src += 2;
-				context->adpcm.ms.sample1[1] = read_int16(src);
-				src += 2;
-				context->adpcm.ms.sample2[0] = read_int16(src);
-				src += 2;
-				context->adpcm.ms.sample2[1] = read_int16(src);
-				src += 2;
-				size -= 14;
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample2[0]);
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample2[1]);
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample1[0]);
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample1[1]);
-			}
-			else
-			{
-				context->adpcm.ms.predictor[0] = *src++;
-				context->adpcm.ms.delta[0] = read_int16(src);
-				src += 2;
-				context->adpcm.ms.sample1[0] = read_int16(src);
-				src += 2;
-				context->adpcm.ms.sample2[0] = read_int16(src);
-				src += 2;
-				size -= 7;
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample2[0]);
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample1[0]);
-			}
-		}
-
-		if (channels > 1)
-		{
-			{
-				const BYTE sample = *src++;
-				size--;
-				Stream_Write_INT16(
-				    out, freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample >> 4, 0));
-				Stream_Write_INT16(
-				    out, freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample & 0x0F, 1));
-			}
-			{
-				const BYTE sample = *src++;
-				size--;
-				Stream_Write_INT16(
-				    out, freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample >> 4, 0));
-				Stream_Write_INT16(
-				    out, freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample & 0x0F, 1));
-			}
-		}
-		else
-		{
-			const BYTE sample = *src++;
-			size--;
-			Stream_Write_INT16(out,
-			                   freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample >> 4, 0));
-			Stream_Write_INT16(
-			    out, freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample & 0x0F, 0));
-		}
-	}
-
-	return TRUE;
-}
-
-static BYTE freerdp_dsp_encode_ms_adpcm_sample(ADPCM* WINPR_RESTRICT adpcm, INT32 sample,
-                                               int channel)
-{
-	INT32 presample =
-	    ((adpcm->ms.sample1[channel] * ms_adpcm_coeffs1[adpcm->ms.predictor[channel]]) +
-	     (adpcm->ms.sample2[channel] * ms_adpcm_coeffs2[adpcm->ms.predictor[channel]])) /
-	    256;
-	INT32 errordelta = (sample - presample) / adpcm->ms.delta[channel];
-
-	if ((sample - presample) % adpcm->ms.delta[channel] > adpcm->ms.delta[channel] / 2)
-		errordelta++;
-
-	if (errordelta > 7)
-		errordelta = 7;
-	else if (errordelta < -8)
-		errordelta = -8;
-
-	presample += adpcm->ms.delta[channel] * errordelta;
-
-	if (presample > 32767)
-		presample = 32767;
-	else if (presample < -32768)
-		presample = -32768;
-
-	adpcm->ms.sample2[channel] = adpcm->ms.sample1[channel];
-	adpcm->ms.sample1[channel] = presample;
-	adpcm->ms.delta[channel] =
-	    adpcm->ms.delta[channel] * ms_adpcm_adaptation_table[(((BYTE)errordelta) & 0x0F)] / 256;
-
-	if (adpcm->ms.delta[channel] < 16)
-		adpcm->ms.delta[channel] = 16;
-
-	return ((BYTE)errordelta) & 0x0F;
-}
-
-static BOOL freerdp_dsp_encode_ms_adpcm(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
-                                        const BYTE* WINPR_RESTRICT src, size_t size,
-                                        wStream* WINPR_RESTRICT out)
-{
-	const size_t step = 8 + ((context->common.format.nChannels > 1) ? 4 : 0);
-
-	if (!Stream_EnsureRemainingCapacity(out, size))
-		return FALSE;
-
-	const size_t start = Stream_GetPosition(out);
-
-	if (context->adpcm.ms.delta[0] < 16)
-		context->adpcm.ms.delta[0] = 16;
-
-	if (context->adpcm.ms.delta[1] < 16)
-		context->adpcm.ms.delta[1] = 16;
-
-	while (size >= step)
-	{
-		if ((Stream_GetPosition(out) - start) % context->common.format.nBlockAlign == 0)
-		{
-			if (context->common.format.nChannels > 1)
-			{
-				Stream_Write_UINT8(out, context->adpcm.ms.predictor[0]);
-				Stream_Write_UINT8(out, context->adpcm.ms.predictor[1]);
-				Stream_Write_UINT8(out, (context->adpcm.ms.delta[0] & 0xFF));
-				Stream_Write_UINT8(out, ((context->adpcm.ms.delta[0] >> 8) & 0xFF));
-				Stream_Write_UINT8(out, (context->adpcm.ms.delta[1] & 0xFF));
-				Stream_Write_UINT8(out, ((context->adpcm.ms.delta[1] >> 8) & 0xFF));
-
-				context->adpcm.ms.sample1[0] = read_int16(src + 4);
-				context->adpcm.ms.sample1[1] = read_int16(src + 6);
-				context->adpcm.ms.sample2[0] = read_int16(src + 0);
-				context->adpcm.ms.sample2[1] = read_int16(src + 2);
-
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample1[0]);
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample1[1]);
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample2[0]);
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample2[1]);
-
-				src += 8;
-				size -= 8;
-			}
-			else
-			{
-				Stream_Write_UINT8(out, context->adpcm.ms.predictor[0]);
-				Stream_Write_UINT8(out, (BYTE)(context->adpcm.ms.delta[0] & 0xFF));
-				Stream_Write_UINT8(out, (BYTE)((context->adpcm.ms.delta[0] >> 8) & 0xFF));
-
-				context->adpcm.ms.sample1[0] = read_int16(src + 2);
-				context->adpcm.ms.sample2[0] = read_int16(src + 0);
-
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample1[0]);
-				Stream_Write_INT16(out, (INT16)context->adpcm.ms.sample2[0]);
-				src += 4;
-				size -= 4;
-			}
-		}
-
-		{
-			const INT16 sample = read_int16(src);
-			src += 2;
-			Stream_Write_UINT8(
-			    out, (freerdp_dsp_encode_ms_adpcm_sample(&context->adpcm, sample, 0) << 4) & 0xFF);
-		}
-		{
-			const INT16 sample = read_int16(src);
-			src += 2;
-
-			BYTE val = 0;
-			Stream_Read_UINT8(out, val);
-			val += freerdp_dsp_encode_ms_adpcm_sample(&context->adpcm, sample,
-			                                          context->common.format.nChannels > 1 ? 1 : 0);
-			Stream_Write_UINT8(out, val);
-		}
-		size -= 4;
-	}
-
-	return TRUE;
-}
-
 #endif
 
 FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(BOOL encoder)
@@ -1233,6 +726,8 @@ void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context)
 #endif
 #if defined(WITH_SOXR)
 		soxr_delete(context->sox);
+#else
+	    freerdp_dsp_resampler_free(context->resampler);
 #endif
 	    free(context);
 
@@ -1285,10 +780,12 @@ BOOL freerdp_dsp_encode(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 			return TRUE;
 
 		case WAVE_FORMAT_ADPCM:
-			return freerdp_dsp_encode_ms_adpcm(context, data, length, out);
+			return freerdp_dsp_encode_ms_adpcm(&context->common, &context->adpcm, data, length,
+			                                   out);
 
 		case WAVE_FORMAT_DVI_ADPCM:
-			return freerdp_dsp_encode_ima_adpcm(context, data, length, out);
+			return freerdp_dsp_encode_ima_adpcm(&context->common, &context->adpcm, data, length,
+			                                    out);
 #if defined(WITH_GSM)
 
 		case WAVE_FORMAT_GSM610:
@@ -1350,10 +847,12 @@ BOOL freerdp_dsp_decode(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 			return TRUE;
 
 		case WAVE_FORMAT_ADPCM:
-			return freerdp_dsp_decode_ms_adpcm(context, data, length, out);
+			return freerdp_dsp_decode_ms_adpcm(&context->common, &context->adpcm, data, length,
+			                                   out);
 
 		case WAVE_FORMAT_DVI_ADPCM:
-			return freerdp_dsp_decode_ima_adpcm(context, data, length, out);
+			return freerdp_dsp_decode_ima_adpcm(&context->common, &context->adpcm, data, length,
+			                                    out);
 #if defined(WITH_GSM)
 
 		case WAVE_FORMAT_GSM610:
@@ -1574,6 +1073,10 @@ BOOL freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 		if (!context->sox || (error != 0))
 			return FALSE;
 	}
+#else
+	/* Recreated with the source rate on the next encode */
+	freerdp_dsp_resampler_free(context->resampler);
+	context->resampler = NULL;
 #endif
 	return TRUE;
 #endif
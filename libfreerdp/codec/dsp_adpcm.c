@@ -0,0 +1,782 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - IMA and MS ADPCM
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include <freerdp/types.h>
+#include <freerdp/log.h>
+
+#include "dsp_adpcm.h"
+#include "sse/dsp_adpcm_avx2.h"
+
+#define TAG FREERDP_TAG("dsp.adpcm")
+
+static INIT_ONCE dsp_adpcm_InitOnce = INIT_ONCE_STATIC_INIT;
+static FREERDP_DSP_ADPCM_KERNELS dsp_adpcm_kernels = { 0 };
+static INT32 ima_decode_table[FREERDP_DSP_IMA_TABLE_SIZE] = { 0 };
+
+static INT16 read_int16(const BYTE* WINPR_RESTRICT src)
+{
+	return (INT16)(src[0] | (src[1] << 8));
+}
+
+static INLINE INT32 clamp_int16(INT32 value)
+{
+	return MAX(-32768, MIN(32767, value));
+}
+
+/**
+ * Microsoft IMA ADPCM specification:
+ *
+ * http://wiki.multimedia.cx/index.php?title=Microsoft_IMA_ADPCM
+ * http://wiki.multimedia.cx/index.php?title=IMA_ADPCM
+ */
+
+static const INT16 ima_step_index_table[] = {
+	-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const INT16 ima_step_size_table[] = {
+	7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,   21,    23,
+	25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,   73,    80,
+	88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,  253,   279,
+	307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,  876,   963,
+	1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749, 3024,  3327,
+	3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487,
+	12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+#define IMA_MAX_STEP ((INT16)(ARRAYSIZE(ima_step_size_table) - 1))
+
+static void ima_build_decode_table(void)
+{
+	for (INT16 step = 0; step <= IMA_MAX_STEP; step++)
+	{
+		for (BYTE nibble = 0; nibble < 16; nibble++)
+		{
+			const INT32 ss = ima_step_size_table[step];
+			INT32 d = (ss >> 3);
+
+			if (nibble & 1)
+				d += (ss >> 2);
+
+			if (nibble & 2)
+				d += (ss >> 1);
+
+			if (nibble & 4)
+				d += ss;
+
+			if (nibble & 8)
+				d = -d;
+
+			const INT32 next =
+			    MAX(0, MIN(IMA_MAX_STEP, step + ima_step_index_table[nibble]));
+			ima_decode_table[step * 16 + nibble] = (INT32)((UINT32)d << 8) | next;
+		}
+	}
+}
+
+const INT32* freerdp_dsp_ima_adpcm_table(void)
+{
+	return ima_decode_table;
+}
+
+static INLINE INT16 ima_decode_nibble(const INT32* WINPR_RESTRICT table,
+                                      INT32* WINPR_RESTRICT sample, INT32* WINPR_RESTRICT step,
+                                      BYTE nibble)
+{
+	const INT32 entry = table[*step * 16 + nibble];
+	const INT32 value = clamp_int16(*sample + (entry >> 8));
+
+	*sample = value;
+	*step = entry & 0xFF;
+	return (INT16)value;
+}
+
+static void ima_decode_block(ADPCM* WINPR_RESTRICT adpcm, const BYTE* WINPR_RESTRICT src,
+                             size_t block_size, size_t channels, INT16* WINPR_RESTRICT dst)
+{
+	const INT32* table = ima_decode_table;
+	const size_t header = 4 * channels;
+	INT32 sample[2] = { 0 };
+	INT32 step[2] = { 0 };
+
+	for (size_t c = 0; c < channels; c++)
+	{
+		sample[c] = read_int16(&src[4 * c]);
+		step[c] = MIN(src[4 * c + 2], IMA_MAX_STEP);
+	}
+
+	if (channels > 1)
+	{
+		/* 4 bytes of 8 left samples followed by 4 bytes of 8 right samples */
+		for (size_t x = header; x < block_size; x += 8)
+		{
+			for (size_t c = 0; c < 2; c++)
+			{
+				for (size_t i = 0; i < 4; i++)
+				{
+					const BYTE b = src[x + c * 4 + i];
+					dst[4 * i + c] = ima_decode_nibble(table, &sample[c], &step[c], b & 0x0F);
+					dst[4 * i + 2 + c] = ima_decode_nibble(table, &sample[c], &step[c], b >> 4);
+				}
+			}
+			dst += 16;
+		}
+	}
+	else
+	{
+		for (size_t x = header; x < block_size; x++)
+		{
+			*dst++ = ima_decode_nibble(table, &sample[0], &step[0], src[x] & 0x0F);
+			*dst++ = ima_decode_nibble(table, &sample[0], &step[0], src[x] >> 4);
+		}
+	}
+
+	if (adpcm)
+	{
+		for (size_t c = 0; c < channels; c++)
+		{
+			adpcm->ima.last_sample[c] = (INT16)sample[c];
+			adpcm->ima.last_step[c] = (INT16)step[c];
+		}
+	}
+}
+
+static void generic_ima_decode_blocks(const BYTE* WINPR_RESTRICT src, size_t blocks,
+                                      size_t blockAlign, size_t channels, INT16* WINPR_RESTRICT dst)
+{
+	const size_t samples = (blockAlign - 4 * channels) * 2;
+
+	for (size_t x = 0; x < blocks; x++)
+		ima_decode_block(NULL, &src[x * blockAlign], blockAlign, channels, &dst[x * samples]);
+}
+
+static UINT16 dsp_decode_ima_adpcm_sample(ADPCM* WINPR_RESTRICT adpcm, unsigned int channel,
+                                          BYTE sample)
+{
+	INT32 value = adpcm->ima.last_sample[channel];
+	INT32 step = MIN(adpcm->ima.last_step[channel], IMA_MAX_STEP);
+	const INT16 decoded = ima_decode_nibble(ima_decode_table, &value, &step, sample);
+
+	adpcm->ima.last_sample[channel] = (INT16)value;
+	adpcm->ima.last_step[channel] = (INT16)step;
+	return (UINT16)decoded;
+}
+
+static BOOL ima_adpcm_blocks_valid(size_t block_size, size_t channels, size_t size)
+{
+	const size_t header = 4 * channels;
+
+	if ((channels < 1) || (channels > 2) || (block_size <= header) || (size == 0))
+		return FALSE;
+
+	if ((size % block_size) != 0)
+		return FALSE;
+
+	/* stereo data is interleaved in groups of 4 bytes per channel */
+	return (channels == 1) || (((block_size - header) % 8) == 0);
+}
+
+BOOL freerdp_dsp_decode_ima_adpcm(FREERDP_DSP_COMMON_CONTEXT* WINPR_RESTRICT common,
+                                  ADPCM* WINPR_RESTRICT adpcm, const BYTE* WINPR_RESTRICT src,
+                                  size_t size, wStream* WINPR_RESTRICT out)
+{
+	WINPR_ASSERT(common);
+	WINPR_ASSERT(adpcm);
+
+	size_t out_size = size * 4;
+	const UINT32 block_size = common->format.nBlockAlign;
+	const UINT32 channels = common->format.nChannels;
+
+	if (!Stream_EnsureRemainingCapacity(out, out_size))
+		return FALSE;
+
+	if (ima_adpcm_blocks_valid(block_size, channels, size))
+	{
+		/* All but the last block are decoded in parallel, the last one updates the state */
+		const FREERDP_DSP_ADPCM_KERNELS* kernels = freerdp_dsp_adpcm_kernels();
+		const size_t blocks = size / block_size;
+		const size_t samples = (block_size - 4ull * channels) * 2;
+		INT16* dst = Stream_PointerAs(out, INT16);
+
+		kernels->ima_decode_blocks(src, blocks - 1, block_size, channels, dst);
+		ima_decode_block(adpcm, &src[(blocks - 1) * block_size], block_size, channels,
+		                 &dst[(blocks - 1) * samples]);
+		Stream_Seek(out, blocks * samples * sizeof(INT16));
+		return TRUE;
+	}
+
+	while (size > 0)
+	{
+		if (size % block_size == 0)
+		{
+			adpcm->ima.last_sample[0] = (INT16)(((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
+			adpcm->ima.last_step[0] = (INT16)(*(src + 2));
+			src += 4;
+			size -= 4;
+			out_size -= 16;
+
+			if (channels > 1)
+			{
+				adpcm->ima.last_sample[1] =
+				    (INT16)(((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
+				adpcm->ima.last_step[1] = (INT16)(*(src + 2));
+				src += 4;
+				size -= 4;
+				out_size -= 16;
+			}
+		}
+
+		if (channels > 1)
+		{
+			for (size_t i = 0; i < 8; i++)
+			{
+				BYTE* dst = Stream_Pointer(out);
+
+				const int channel = (i < 4 ? 0 : 1);
+				{
+					const BYTE sample = ((*src) & 0x0f);
+					const UINT16 decoded = dsp_decode_ima_adpcm_sample(adpcm, channel, sample);
+					dst[((i & 3) << 3) + (channel << 1)] = (decoded & 0xFF);
+					dst[((i & 3) << 3) + (channel << 1) + 1] = (decoded >> 8);
+				}
+				{
+					const BYTE sample = ((*src) >> 4);
+					const UINT16 decoded = dsp_decode_ima_adpcm_sample(adpcm, channel, sample);
+					dst[((i & 3) << 3) + (channel << 1) + 4] = (decoded & 0xFF);
+					dst[((i & 3) << 3) + (channel << 1) + 5] = (decoded >> 8);
+				}
+				src++;
+			}
+
+			if (!Stream_SafeSeek(out, 32))
+				return FALSE;
+			size -= 8;
+		}
+		else
+		{
+			BYTE* dst = Stream_Pointer(out);
+			if (!Stream_SafeSeek(out, 4))
+				return FALSE;
+
+			{
+				const BYTE sample = ((*src) & 0x0f);
+				const UINT16 decoded = dsp_decode_ima_adpcm_sample(adpcm, 0, sample);
+				*dst++ = (decoded & 0xFF);
+				*dst++ = (decoded >> 8);
+			}
+			{
+				const BYTE sample = ((*src) >> 4);
+				const UINT16 decoded = dsp_decode_ima_adpcm_sample(adpcm, 0, sample);
+				*dst++ = (decoded & 0xFF);
+				*dst++ = (decoded >> 8);
+			}
+			src++;
+			size--;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * 0     1     2     3
+ * 2 0   6 4   10 8  14 12   <left>
+ *
+ * 4     5     6     7
+ * 3 1   7 5   11 9  15 13   <right>
+ */
+static const struct
+{
+	BYTE byte_num;
+	BYTE byte_shift;
+} ima_stereo_encode_map[] = { { 0, 0 }, { 4, 0 }, { 0, 4 }, { 4, 4 }, { 1, 0 }, { 5, 0 },
+	                          { 1, 4 }, { 5, 4 }, { 2, 0 }, { 6, 0 }, { 2, 4 }, { 6, 4 },
+	                          { 3, 0 }, { 7, 0 }, { 3, 4 }, { 7, 4 } };
+
+static BYTE dsp_encode_ima_adpcm_sample(ADPCM* WINPR_RESTRICT adpcm, int channel, INT16 sample)
+{
+	const INT32 step = MIN(adpcm->ima.last_step[channel], IMA_MAX_STEP);
+	const INT32 e = sample - adpcm->ima.last_sample[channel];
+	const INT32 sign = (e < 0) ? -1 : 0;
+	INT32 ss = ima_step_size_table[step];
+	INT32 mag = (e ^ sign) - sign;
+	INT32 bit = 0;
+	BYTE enc = (BYTE)(sign & 8);
+
+	/* Quantize the magnitude with masks instead of branches. The reconstructed difference
+	 * matches the decoder table entry of the code, so it is used to update the state. */
+	bit = -(mag >= ss);
+	enc |= (BYTE)(bit & 4);
+	mag -= bit & ss;
+	ss >>= 1;
+
+	bit = -(mag >= ss);
+	enc |= (BYTE)(bit & 2);
+	mag -= bit & ss;
+	ss >>= 1;
+
+	bit = -(mag >= ss);
+	enc |= (BYTE)(bit & 1);
+
+	const INT32 entry = ima_decode_table[step * 16 + enc];
+	adpcm->ima.last_sample[channel] =
+	    (INT16)clamp_int16(adpcm->ima.last_sample[channel] + (entry >> 8));
+	adpcm->ima.last_step[channel] = (INT16)(entry & 0xFF);
+
+	return enc;
+}
+
+BOOL freerdp_dsp_encode_ima_adpcm(FREERDP_DSP_COMMON_CONTEXT* WINPR_RESTRICT common,
+                                  ADPCM* WINPR_RESTRICT adpcm, const BYTE* WINPR_RESTRICT src,
+                                  size_t size, wStream* WINPR_RESTRICT out)
+{
+	WINPR_ASSERT(common);
+	WINPR_ASSERT(adpcm);
+
+	(void)freerdp_dsp_adpcm_kernels();
+
+	if (!Stream_EnsureRemainingCapacity(out, size))
+		return FALSE;
+	if (!Stream_EnsureRemainingCapacity(common->buffer, size + 64))
+		return FALSE;
+
+	const size_t align = (common->format.nChannels > 1) ? 32 : 4;
+
+	while (size >= align)
+	{
+		if (Stream_GetPosition(common->buffer) % common->format.nBlockAlign == 0)
+		{
+			Stream_Write_UINT8(common->buffer, adpcm->ima.last_sample[0] & 0xFF);
+			Stream_Write_UINT8(common->buffer, (adpcm->ima.last_sample[0] >> 8) & 0xFF);
+			Stream_Write_UINT8(common->buffer, (BYTE)adpcm->ima.last_step[0]);
+			Stream_Write_UINT8(common->buffer, 0);
+
+			if (common->format.nChannels > 1)
+			{
+				Stream_Write_UINT8(common->buffer, adpcm->ima.last_sample[1] & 0xFF);
+				Stream_Write_UINT8(common->buffer, (adpcm->ima.last_sample[1] >> 8) & 0xFF);
+				Stream_Write_UINT8(common->buffer, (BYTE)adpcm->ima.last_step[1]);
+				Stream_Write_UINT8(common->buffer, 0);
+			}
+		}
+
+		if (common->format.nChannels > 1)
+		{
+			BYTE* dst = Stream_Pointer(common->buffer);
+			ZeroMemory(dst, 8);
+
+			for (size_t i = 0; i < 16; i++)
+			{
+				const INT16 sample = read_int16(src);
+				src += 2;
+				const BYTE encoded = dsp_encode_ima_adpcm_sample(adpcm, i % 2, sample);
+				dst[ima_stereo_encode_map[i].byte_num] |= encoded
+				                                          << ima_stereo_encode_map[i].byte_shift;
+			}
+
+			if (!Stream_SafeSeek(common->buffer, 8))
+				return FALSE;
+			size -= 32;
+		}
+		else
+		{
+			INT16 sample = read_int16(src);
+			src += 2;
+			BYTE encoded = dsp_encode_ima_adpcm_sample(adpcm, 0, sample);
+			sample = read_int16(src);
+			src += 2;
+			encoded |= dsp_encode_ima_adpcm_sample(adpcm, 0, sample) << 4;
+			Stream_Write_UINT8(common->buffer, encoded);
+			size -= 4;
+		}
+
+		if (Stream_GetPosition(common->buffer) >= adpcm->ima.packet_size)
+		{
+			BYTE* bsrc = Stream_Buffer(common->buffer);
+			if (!Stream_EnsureRemainingCapacity(out, adpcm->ima.packet_size))
+				return FALSE;
+			Stream_Write(out, bsrc, adpcm->ima.packet_size);
+			Stream_SetPosition(common->buffer, 0);
+		}
+	}
+
+	return TRUE;
+}
+
+static INLINE INT16 ms_decode_nibble(INT32 coeff1, INT32 coeff2, INT32* WINPR_RESTRICT sample1,
+                                     INT32* WINPR_RESTRICT sample2, INT32* WINPR_RESTRICT delta,
+                                     BYTE nibble)
+{
+	/* sign extend the 4 bit value */
+	const INT32 value = (INT32)(nibble ^ 8) - 8;
+	INT32 presample = ((*sample1 * coeff1) + (*sample2 * coeff2)) / 256;
+	presample = clamp_int16(presample + value * *delta);
+
+	*sample2 = *sample1;
+	*sample1 = presample;
+	*delta = MAX(16, *delta * ms_adpcm_adaptation_table[nibble] / 256);
+	return (INT16)presample;
+}
+
+static void ms_decode_block(ADPCM* WINPR_RESTRICT adpcm, const BYTE* WINPR_RESTRICT src,
+                            size_t block_size, size_t channels, INT16* WINPR_RESTRICT dst)
+{
+	const size_t header = FREERDP_DSP_MS_ADPCM_HEADER * channels;
+	BYTE predictor[2] = { 0 };
+	INT32 delta[2] = { 0 };
+	INT32 sample1[2] = { 0 };
+	INT32 sample2[2] = { 0 };
+
+	for (size_t c = 0; c < channels; c++)
+	{
+		predictor[c] = src[c];
+		delta[c] = read_int16(&src[channels + 2 * c]);
+		sample1[c] = read_int16(&src[3 * channels + 2 * c]);
+		sample2[c] = read_int16(&src[5 * channels + 2 * c]);
+		dst[c] = (INT16)sample2[c];
+		dst[channels + c] = (INT16)sample1[c];
+	}
+	dst += 2 * channels;
+
+	const INT32 c1[2] = { ms_adpcm_coeffs1[predictor[0]], ms_adpcm_coeffs1[predictor[1]] };
+	const INT32 c2[2] = { ms_adpcm_coeffs2[predictor[0]], ms_adpcm_coeffs2[predictor[1]] };
+
+	if (channels > 1)
+	{
+		for (size_t x = header; x < block_size; x++)
+		{
+			*dst++ = ms_decode_nibble(c1[0], c2[0], &sample1[0], &sample2[0], &delta[0],
+			                          src[x] >> 4);
+			*dst++ = ms_decode_nibble(c1[1], c2[1], &sample1[1], &sample2[1], &delta[1],
+			                          src[x] & 0x0F);
+		}
+	}
+	else
+	{
+		for (size_t x = header; x < block_size; x++)
+		{
+			*dst++ = ms_decode_nibble(c1[0], c2[0], &sample1[0], &sample2[0], &delta[0],
+			                          src[x] >> 4);
+			*dst++ = ms_decode_nibble(c1[0], c2[0], &sample1[0], &sample2[0], &delta[0],
+			                          src[x] & 0x0F);
+		}
+	}
+
+	if (adpcm)
+	{
+		for (size_t c = 0; c < channels; c++)
+		{
+			adpcm->ms.predictor[c] = predictor[c];
+			adpcm->ms.delta[c] = delta[c];
+			adpcm->ms.sample1[c] = sample1[c];
+			adpcm->ms.sample2[c] = sample2[c];
+		}
+	}
+}
+
+static void generic_ms_decode_blocks(const BYTE* WINPR_RESTRICT src, size_t blocks,
+                                     size_t blockAlign, size_t channels, INT16* WINPR_RESTRICT dst)
+{
+	const size_t header = FREERDP_DSP_MS_ADPCM_HEADER * channels;
+	const size_t samples = 2 * channels + (blockAlign - header) * 2;
+
+	for (size_t x = 0; x < blocks; x++)
+		ms_decode_block(NULL, &src[x * blockAlign], blockAlign, channels, &dst[x * samples]);
+}
+
+static INLINE INT16 freerdp_dsp_decode_ms_adpcm_sample(ADPCM* WINPR_RESTRICT adpcm, BYTE sample,
+                                                       int channel)
+{
+	const BYTE predictor = adpcm->ms.predictor[channel];
+
+	return ms_decode_nibble(ms_adpcm_coeffs1[predictor], ms_adpcm_coeffs2[predictor],
+	                        &adpcm->ms.sample1[channel], &adpcm->ms.sample2[channel],
+	                        &adpcm->ms.delta[channel], sample);
+}
+
+static BOOL ms_adpcm_blocks_valid(size_t block_size, size_t channels, size_t size)
+{
+	const size_t header = FREERDP_DSP_MS_ADPCM_HEADER * channels;
+
+	if ((channels < 1) || (channels > 2) || (block_size <= header) || (size == 0))
+		return FALSE;
+
+	if ((size % block_size) != 0)
+		return FALSE;
+
+	if ((channels > 1) && (((block_size - header) % 2) != 0))
+		return FALSE;
+
+	return TRUE;
+}
+
+static BOOL ms_adpcm_predictors_valid(const BYTE* WINPR_RESTRICT src, size_t block_size,
+                                      size_t channels, size_t size)
+{
+	for (size_t x = 0; x + block_size <= size; x += block_size)
+	{
+		for (size_t c = 0; c < channels; c++)
+		{
+			if (src[x + c] >= ARRAYSIZE(ms_adpcm_coeffs1))
+			{
+				WLog_ERR(TAG, "invalid MS ADPCM predictor %" PRIu8, src[x + c]);
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+BOOL freerdp_dsp_decode_ms_adpcm(FREERDP_DSP_COMMON_CONTEXT* WINPR_RESTRICT common,
+                                 ADPCM* WINPR_RESTRICT adpcm, const BYTE* WINPR_RESTRICT src,
+                                 size_t size, wStream* WINPR_RESTRICT out)
+{
+	WINPR_ASSERT(common);
+	WINPR_ASSERT(adpcm);
+
+	const size_t out_size = size * 4;
+	const UINT32 channels = common->format.nChannels;
+	const UINT32 block_size = common->format.nBlockAlign;
+
+	if (!Stream_EnsureRemainingCapacity(out, out_size))
+		return FALSE;
+
+	if (ms_adpcm_blocks_valid(block_size, channels, size))
+	{
+		if (!ms_adpcm_predictors_valid(src, block_size, channels, size))
+			return FALSE;
+
+		/* All but the last block are decoded in parallel, the last one updates the state */
+		const FREERDP_DSP_ADPCM_KERNELS* kernels = freerdp_dsp_adpcm_kernels();
+		const size_t blocks = size / block_size;
+		const size_t header = 1ull * FREERDP_DSP_MS_ADPCM_HEADER * channels;
+		const size_t samples = 2ull * channels + (block_size - header) * 2;
+		INT16* dst = Stream_PointerAs(out, INT16);
+
+		kernels->ms_decode_blocks(src, blocks - 1, block_size, channels, dst);
+		ms_decode_block(adpcm, &src[(blocks - 1) * block_size], block_size, channels,
+		                &dst[(blocks - 1) * samples]);
+		Stream_Seek(out, blocks * samples * sizeof(INT16));
+		return TRUE;
+	}
+
+	while (size > 0)
+	{
+		if (size % block_size == 0)
+		{
+			if (!ms_adpcm_predictors_valid(src, block_size, channels, block_size))
+				return FALSE;
+
+			if (channels > 1)
+			{
+				adpcm->ms.predictor[0] = *src++;
+				adpcm->ms.predictor[1] = *src++;
+				adpcm->ms.delta[0] = read_int16(src);
+				src += 2;
+				adpcm->ms.delta[1] = read_int16(src);
+				src += 2;
+				adpcm->ms.sample1[0] = read_int16(src);
+				src += 2;
+				adpcm->ms.sample1[1] = read_int16(src);
+				src += 2;
+				adpcm->ms.sample2[0] = read_int16(src);
+				src += 2;
+				adpcm->ms.sample2[1] = read_int16(src);
+				src += 2;
+				size -= 14;
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample2[0]);
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample2[1]);
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample1[0]);
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample1[1]);
+			}
+			else
+			{
+				adpcm->ms.predictor[0] = *src++;
+				adpcm->ms.delta[0] = read_int16(src);
+				src += 2;
+				adpcm->ms.sample1[0] = read_int16(src);
+				src += 2;
+				adpcm->ms.sample2[0] = read_int16(src);
+				src += 2;
+				size -= 7;
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample2[0]);
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample1[0]);
+			}
+		}
+
+		if (channels > 1)
+		{
+			{
+				const BYTE sample = *src++;
+				size--;
+				Stream_Write_INT16(out, freerdp_dsp_decode_ms_adpcm_sample(adpcm, sample >> 4, 0));
+				Stream_Write_INT16(out,
+				                   freerdp_dsp_decode_ms_adpcm_sample(adpcm, sample & 0x0F, 1));
+			}
+			{
+				const BYTE sample = *src++;
+				size--;
+				Stream_Write_INT16(out, freerdp_dsp_decode_ms_adpcm_sample(adpcm, sample >> 4, 0));
+				Stream_Write_INT16(out,
+				                   freerdp_dsp_decode_ms_adpcm_sample(adpcm, sample & 0x0F, 1));
+			}
+		}
+		else
+		{
+			const BYTE sample = *src++;
+			size--;
+			Stream_Write_INT16(out, freerdp_dsp_decode_ms_adpcm_sample(adpcm, sample >> 4, 0));
+			Stream_Write_INT16(out, freerdp_dsp_decode_ms_adpcm_sample(adpcm, sample & 0x0F, 0));
+		}
+	}
+
+	return TRUE;
+}
+
+static BYTE freerdp_dsp_encode_ms_adpcm_sample(ADPCM* WINPR_RESTRICT adpcm, INT32 sample,
+                                               int channel)
+{
+	const BYTE predictor = adpcm->ms.predictor[channel];
+	const INT32 delta = adpcm->ms.delta[channel];
+	INT32 presample = ((adpcm->ms.sample1[channel] * ms_adpcm_coeffs1[predictor]) +
+	                   (adpcm->ms.sample2[channel] * ms_adpcm_coeffs2[predictor])) /
+	                  256;
+	INT32 errordelta = (sample - presample) / delta;
+
+	if ((sample - presample) % delta > delta / 2)
+		errordelta++;
+
+	errordelta = MAX(-8, MIN(7, errordelta));
+	presample = clamp_int16(presample + delta * errordelta);
+
+	const BYTE code = ((BYTE)errordelta) & 0x0F;
+	adpcm->ms.sample2[channel] = adpcm->ms.sample1[channel];
+	adpcm->ms.sample1[channel] = presample;
+	adpcm->ms.delta[channel] = MAX(16, delta * ms_adpcm_adaptation_table[code] / 256);
+
+	return code;
+}
+
+BOOL freerdp_dsp_encode_ms_adpcm(FREERDP_DSP_COMMON_CONTEXT* WINPR_RESTRICT common,
+                                 ADPCM* WINPR_RESTRICT adpcm, const BYTE* WINPR_RESTRICT src,
+                                 size_t size, wStream* WINPR_RESTRICT out)
+{
+	WINPR_ASSERT(common);
+	WINPR_ASSERT(adpcm);
+
+	const size_t step = 8 + ((common->format.nChannels > 1) ? 4 : 0);
+
+	if (!Stream_EnsureRemainingCapacity(out, size))
+		return FALSE;
+
+	const size_t start = Stream_GetPosition(out);
+
+	if (adpcm->ms.delta[0] < 16)
+		adpcm->ms.delta[0] = 16;
+
+	if (adpcm->ms.delta[1] < 16)
+		adpcm->ms.delta[1] = 16;
+
+	while (size >= step)
+	{
+		if ((Stream_GetPosition(out) - start) % common->format.nBlockAlign == 0)
+		{
+			if (common->format.nChannels > 1)
+			{
+				Stream_Write_UINT8(out, adpcm->ms.predictor[0]);
+				Stream_Write_UINT8(out, adpcm->ms.predictor[1]);
+				Stream_Write_UINT8(out, (adpcm->ms.delta[0] & 0xFF));
+				Stream_Write_UINT8(out, ((adpcm->ms.delta[0] >> 8) & 0xFF));
+				Stream_Write_UINT8(out, (adpcm->ms.delta[1] & 0xFF));
+				Stream_Write_UINT8(out, ((adpcm->ms.delta[1] >> 8) & 0xFF));
+
+				adpcm->ms.sample1[0] = read_int16(src + 4);
+				adpcm->ms.sample1[1] = read_int16(src + 6);
+				adpcm->ms.sample2[0] = read_int16(src + 0);
+				adpcm->ms.sample2[1] = read_int16(src + 2);
+
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample1[0]);
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample1[1]);
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample2[0]);
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample2[1]);
+
+				src += 8;
+				size -= 8;
+			}
+			else
+			{
+				Stream_Write_UINT8(out, adpcm->ms.predictor[0]);
+				Stream_Write_UINT8(out, (BYTE)(adpcm->ms.delta[0] & 0xFF));
+				Stream_Write_UINT8(out, (BYTE)((adpcm->ms.delta[0] >> 8) & 0xFF));
+
+				adpcm->ms.sample1[0] = read_int16(src + 2);
+				adpcm->ms.sample2[0] = read_int16(src + 0);
+
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample1[0]);
+				Stream_Write_INT16(out, (INT16)adpcm->ms.sample2[0]);
+				src += 4;
+				size -= 4;
+			}
+		}
+
+		/* stereo: high nibble left, low nibble right, mono: high nibble first */
+		const BYTE hi = freerdp_dsp_encode_ms_adpcm_sample(adpcm, read_int16(src), 0);
+		const BYTE lo = freerdp_dsp_encode_ms_adpcm_sample(adpcm, read_int16(src + 2),
+		                                                   common->format.nChannels > 1 ? 1 : 0);
+		Stream_Write_UINT8(out, (BYTE)((hi << 4) | lo));
+		src += 4;
+		size -= 4;
+	}
+
+	return TRUE;
+}
+
+void freerdp_dsp_adpcm_init_generic(FREERDP_DSP_ADPCM_KERNELS* kernels)
+{
+	WINPR_ASSERT(kernels);
+
+	kernels->ima_decode_blocks = generic_ima_decode_blocks;
+	kernels->ms_decode_blocks = generic_ms_decode_blocks;
+}
+
+static BOOL CALLBACK dsp_adpcm_init_cb(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	ima_build_decode_table();
+	freerdp_dsp_adpcm_init_generic(&dsp_adpcm_kernels);
+#if defined(WITH_AVX2)
+	dsp_adpcm_init_avx2(&dsp_adpcm_kernels);
+#endif
+	return TRUE;
+}
+
+const FREERDP_DSP_ADPCM_KERNELS* freerdp_dsp_adpcm_kernels(void)
+{
+	InitOnceExecuteOnce(&dsp_adpcm_InitOnce, dsp_adpcm_init_cb, NULL, NULL);
+	return &dsp_adpcm_kernels;
+}
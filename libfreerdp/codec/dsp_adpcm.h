@@ -0,0 +1,107 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - IMA and MS ADPCM
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_DSP_ADPCM_H
+#define FREERDP_LIB_CODEC_DSP_ADPCM_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <freerdp/api.h>
+
+#include "dsp.h"
+
+typedef union
+{
+	struct
+	{
+		size_t packet_size;
+		INT16 last_sample[2];
+		INT16 last_step[2];
+	} ima;
+	struct
+	{
+		BYTE predictor[2];
+		INT32 delta[2];
+		INT32 sample1[2];
+		INT32 sample2[2];
+	} ms;
+} ADPCM;
+
+/** @brief Block decoders, every block is independent so several can be decoded in parallel.
+ *
+ *  \b src holds \b blocks blocks of \b blockAlign bytes with \b channels (1 or 2) channels,
+ *  the block layout must have been validated by the caller. All implementations produce bit
+ *  identical results.
+ */
+typedef struct
+{
+	void (*ima_decode_blocks)(const BYTE* WINPR_RESTRICT src, size_t blocks, size_t blockAlign,
+	                          size_t channels, INT16* WINPR_RESTRICT dst);
+	void (*ms_decode_blocks)(const BYTE* WINPR_RESTRICT src, size_t blocks, size_t blockAlign,
+	                         size_t channels, INT16* WINPR_RESTRICT dst);
+} FREERDP_DSP_ADPCM_KERNELS;
+
+/** IMA ADPCM decoding table, indexed by step index * 16 + nibble.
+ *  Bits 8-31 hold the signed sample difference, bits 0-7 the next step index.
+ *  The table is filled before the optimized kernels are initialized. */
+#define FREERDP_DSP_IMA_TABLE_SIZE (89 * 16)
+
+FREERDP_LOCAL const INT32* freerdp_dsp_ima_adpcm_table(void);
+
+/** MS ADPCM header size of a block per channel, in bytes */
+#define FREERDP_DSP_MS_ADPCM_HEADER 7
+
+/**
+ * Microsoft ADPCM Specification:
+ *
+ * http://wiki.multimedia.cx/index.php?title=Microsoft_ADPCM
+ */
+
+static const INT32 ms_adpcm_adaptation_table[] = { 230, 230, 230, 230, 307, 409, 512, 614,
+	                                               768, 614, 512, 409, 307, 230, 230, 230 };
+
+static const INT32 ms_adpcm_coeffs1[7] = { 256, 512, 0, 192, 240, 460, 392 };
+
+static const INT32 ms_adpcm_coeffs2[7] = { 0, -256, 0, 64, 0, -208, -232 };
+
+FREERDP_LOCAL void freerdp_dsp_adpcm_init_generic(FREERDP_DSP_ADPCM_KERNELS* kernels);
+
+/** @brief The fastest kernels supported by the CPU */
+FREERDP_LOCAL const FREERDP_DSP_ADPCM_KERNELS* freerdp_dsp_adpcm_kernels(void);
+
+FREERDP_LOCAL BOOL freerdp_dsp_decode_ima_adpcm(FREERDP_DSP_COMMON_CONTEXT* WINPR_RESTRICT common,
+                                                ADPCM* WINPR_RESTRICT adpcm,
+                                                const BYTE* WINPR_RESTRICT src, size_t size,
+                                                wStream* WINPR_RESTRICT out);
+
+FREERDP_LOCAL BOOL freerdp_dsp_encode_ima_adpcm(FREERDP_DSP_COMMON_CONTEXT* WINPR_RESTRICT common,
+                                                ADPCM* WINPR_RESTRICT adpcm,
+                                                const BYTE* WINPR_RESTRICT src, size_t size,
+                                                wStream* WINPR_RESTRICT out);
+
+FREERDP_LOCAL BOOL freerdp_dsp_decode_ms_adpcm(FREERDP_DSP_COMMON_CONTEXT* WINPR_RESTRICT common,
+                                               ADPCM* WINPR_RESTRICT adpcm,
+                                               const BYTE* WINPR_RESTRICT src, size_t size,
+                                               wStream* WINPR_RESTRICT out);
+
+FREERDP_LOCAL BOOL freerdp_dsp_encode_ms_adpcm(FREERDP_DSP_COMMON_CONTEXT* WINPR_RESTRICT common,
+                                               ADPCM* WINPR_RESTRICT adpcm,
+                                               const BYTE* WINPR_RESTRICT src, size_t size,
+                                               wStream* WINPR_RESTRICT out);
+
+#endif /* FREERDP_LIB_CODEC_DSP_ADPCM_H */
@@ -0,0 +1,391 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - built-in resampler and channel mixer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include <freerdp/types.h>
+#include <freerdp/log.h>
+
+#include "dsp_resample.h"
+#include "sse/dsp_resample_sse2.h"
+#include "sse/dsp_resample_avx2.h"
+#include "neon/dsp_resample_neon.h"
+
+#define TAG FREERDP_TAG("dsp.resample")
+
+/* Polyphase windowed sinc resampler.
+ *
+ * The rate ratio is reduced to L / M, every output frame is computed from the filter phase
+ * closest to its fractional position in the input. Up to DSP_RESAMPLE_MAX_PHASES phases are
+ * precomputed, which is exact for all the usual rates (e.g. 44100 -> 48000 is 160 / 147).
+ */
+#define DSP_RESAMPLE_MAX_PHASES 1024
+#define DSP_RESAMPLE_BASE_TAPS 48
+#define DSP_RESAMPLE_MAX_TAPS 256
+#define DSP_RESAMPLE_MAX_CHANNELS 8
+/* Kaiser window beta, ~70 dB stop band attenuation */
+#define DSP_RESAMPLE_KAISER_BETA 7.0
+/* pass band edge relative to the lower of the two Nyquist frequencies */
+#define DSP_RESAMPLE_ROLLOFF 0.9
+#define DSP_RESAMPLE_PI 3.14159265358979323846
+
+struct S_FREERDP_DSP_RESAMPLER
+{
+	UINT32 srcRate;
+	UINT32 dstRate;
+	UINT32 channels;
+
+	UINT32 L; /* output step, in 1 / L input frames */
+	UINT32 M; /* input advance per output frame, in 1 / L input frames */
+	UINT32 phases;
+	size_t taps;
+	INT16* coeffs; /* phases * taps */
+
+	/* planar input history, channel c starts at history[c * capacity] */
+	INT16* history;
+	size_t capacity;
+	size_t avail;
+	UINT32 frac;
+
+	const FREERDP_DSP_RESAMPLE_KERNELS* kernels;
+};
+
+static INIT_ONCE dsp_resample_InitOnce = INIT_ONCE_STATIC_INIT;
+static FREERDP_DSP_RESAMPLE_KERNELS dsp_resample_kernels = { 0 };
+
+static INT32 generic_dot_s16(const INT16* WINPR_RESTRICT samples,
+                             const INT16* WINPR_RESTRICT coeffs, size_t count)
+{
+	INT32 acc = 0;
+
+	for (size_t x = 0; x < count; x++)
+		acc += (INT32)samples[x] * coeffs[x];
+
+	return acc;
+}
+
+static void generic_upmix_s16(const INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                              size_t frames)
+{
+	for (size_t x = 0; x < frames; x++)
+	{
+		dst[2 * x] = src[x];
+		dst[2 * x + 1] = src[x];
+	}
+}
+
+static void generic_downmix_s16(const INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                                size_t frames)
+{
+	for (size_t x = 0; x < frames; x++)
+		dst[x] = (INT16)(((INT32)src[2 * x] + src[2 * x + 1]) >> 1);
+}
+
+void freerdp_dsp_resample_init_generic(FREERDP_DSP_RESAMPLE_KERNELS* kernels)
+{
+	WINPR_ASSERT(kernels);
+
+	kernels->dot_s16 = generic_dot_s16;
+	kernels->upmix_s16 = generic_upmix_s16;
+	kernels->downmix_s16 = generic_downmix_s16;
+}
+
+static BOOL CALLBACK dsp_resample_init_cb(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	freerdp_dsp_resample_init_generic(&dsp_resample_kernels);
+	dsp_resample_init_sse2(&dsp_resample_kernels);
+#if defined(WITH_AVX2)
+	dsp_resample_init_avx2(&dsp_resample_kernels);
+#endif
+	dsp_resample_init_neon(&dsp_resample_kernels);
+	return TRUE;
+}
+
+const FREERDP_DSP_RESAMPLE_KERNELS* freerdp_dsp_resample_kernels(void)
+{
+	InitOnceExecuteOnce(&dsp_resample_InitOnce, dsp_resample_init_cb, NULL, NULL);
+	return &dsp_resample_kernels;
+}
+
+static UINT32 dsp_resample_gcd(UINT32 a, UINT32 b)
+{
+	while (b != 0)
+	{
+		const UINT32 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* zeroth order modified Bessel function of the first kind */
+static double dsp_resample_bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (unsigned k = 1; k < 32; k++)
+	{
+		const double f = x / (2.0 * k);
+		term *= f * f;
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+static BOOL dsp_resample_build_filter(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler)
+{
+	const size_t taps = resampler->taps;
+	const double half = (double)taps / 2.0;
+	const double cutoff =
+	    0.5 * DSP_RESAMPLE_ROLLOFF * MIN(1.0, (double)resampler->L / (double)resampler->M);
+	const double norm = dsp_resample_bessel_i0(DSP_RESAMPLE_KAISER_BETA);
+	const INT32 one = 1 << FREERDP_DSP_RESAMPLE_COEFF_BITS;
+
+	double* h = calloc(taps, sizeof(double));
+	if (!h)
+		return FALSE;
+
+	for (UINT32 p = 0; p < resampler->phases; p++)
+	{
+		INT16* coeffs = &resampler->coeffs[1ull * p * taps];
+		const double f = (double)p / resampler->phases;
+		double sum = 0.0;
+
+		/* tap x is applied to the input frame at distance d before the output position */
+		for (size_t x = 0; x < taps; x++)
+		{
+			const double d = half - 1.0 - (double)x + f;
+			const double r = d / half;
+			const double arg = 2.0 * DSP_RESAMPLE_PI * cutoff * d;
+			double v = (fabs(arg) < 1e-9) ? 1.0 : sin(arg) / arg;
+
+			if (fabs(r) < 1.0)
+				v *= dsp_resample_bessel_i0(DSP_RESAMPLE_KAISER_BETA * sqrt(1.0 - r * r)) / norm;
+			else
+				v = 0.0;
+
+			h[x] = v;
+			sum += v;
+		}
+
+		/* Normalize every phase to unity gain, the rounding error is folded into the largest
+		 * tap so a constant signal passes unchanged. */
+		INT32 total = 0;
+		size_t peak = 0;
+		for (size_t x = 0; x < taps; x++)
+		{
+			const double v = h[x] / sum * one;
+			coeffs[x] = (INT16)lround(v);
+			total += coeffs[x];
+			if (abs(coeffs[x]) > abs(coeffs[peak]))
+				peak = x;
+		}
+		coeffs[peak] = (INT16)(coeffs[peak] + one - total);
+	}
+
+	free(h);
+	return TRUE;
+}
+
+void freerdp_dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler)
+{
+	if (!resampler)
+		return;
+
+	winpr_aligned_free(resampler->coeffs);
+	winpr_aligned_free(resampler->history);
+	free(resampler);
+}
+
+FREERDP_DSP_RESAMPLER* freerdp_dsp_resampler_new(UINT32 srcRate, UINT32 dstRate, UINT32 channels)
+{
+	if ((srcRate == 0) || (dstRate == 0) || (channels == 0) ||
+	    (channels > DSP_RESAMPLE_MAX_CHANNELS))
+	{
+		WLog_ERR(TAG, "unsupported conversion %" PRIu32 "Hz -> %" PRIu32 "Hz, %" PRIu32 " channels",
+		         srcRate, dstRate, channels);
+		return NULL;
+	}
+
+	FREERDP_DSP_RESAMPLER* resampler = calloc(1, sizeof(FREERDP_DSP_RESAMPLER));
+	if (!resampler)
+		return NULL;
+
+	const UINT32 gcd = dsp_resample_gcd(srcRate, dstRate);
+	resampler->srcRate = srcRate;
+	resampler->dstRate = dstRate;
+	resampler->channels = channels;
+	resampler->L = dstRate / gcd;
+	resampler->M = srcRate / gcd;
+	resampler->phases = MIN(resampler->L, DSP_RESAMPLE_MAX_PHASES);
+	resampler->kernels = freerdp_dsp_resample_kernels();
+
+	/* Widen the filter when downsampling to keep the transition band constant in the output */
+	const size_t factor = (resampler->M + resampler->L - 1) / resampler->L;
+	size_t taps = DSP_RESAMPLE_BASE_TAPS * factor;
+	taps = (taps + FREERDP_DSP_RESAMPLE_TAP_ALIGN - 1) & ~(FREERDP_DSP_RESAMPLE_TAP_ALIGN - 1ull);
+	resampler->taps = MIN(taps, DSP_RESAMPLE_MAX_TAPS);
+	if (resampler->M / resampler->L >= resampler->taps / 2)
+	{
+		WLog_ERR(TAG, "unsupported conversion %" PRIu32 "Hz -> %" PRIu32 "Hz", srcRate, dstRate);
+		goto fail;
+	}
+
+	resampler->coeffs =
+	    winpr_aligned_calloc(1ull * resampler->phases, resampler->taps * sizeof(INT16), 32);
+	if (!resampler->coeffs)
+		goto fail;
+
+	if (!dsp_resample_build_filter(resampler))
+		goto fail;
+
+	/* Prime the history so the first output frame lines up with the first input frame */
+	resampler->capacity = resampler->taps * 4;
+	resampler->history =
+	    winpr_aligned_calloc(1ull * channels, resampler->capacity * sizeof(INT16), 32);
+	if (!resampler->history)
+		goto fail;
+	resampler->avail = resampler->taps / 2 - 1;
+
+	return resampler;
+fail:
+	freerdp_dsp_resampler_free(resampler);
+	return NULL;
+}
+
+BOOL freerdp_dsp_resampler_matches(const FREERDP_DSP_RESAMPLER* resampler, UINT32 srcRate,
+                                   UINT32 dstRate, UINT32 channels)
+{
+	if (!resampler)
+		return FALSE;
+
+	return (resampler->srcRate == srcRate) && (resampler->dstRate == dstRate) &&
+	       (resampler->channels == channels);
+}
+
+static BOOL dsp_resample_ensure_history(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                        size_t frames)
+{
+	if (frames <= resampler->capacity)
+		return TRUE;
+
+	size_t capacity = resampler->capacity;
+	while (capacity < frames)
+		capacity *= 2;
+
+	INT16* history = winpr_aligned_calloc(1ull * resampler->channels, capacity * sizeof(INT16), 32);
+	if (!history)
+		return FALSE;
+
+	for (size_t c = 0; c < resampler->channels; c++)
+		memcpy(&history[c * capacity], &resampler->history[c * resampler->capacity],
+		       resampler->avail * sizeof(INT16));
+
+	winpr_aligned_free(resampler->history);
+	resampler->history = history;
+	resampler->capacity = capacity;
+	return TRUE;
+}
+
+BOOL freerdp_dsp_resampler_process(FREERDP_DSP_RESAMPLER* resampler,
+                                   const BYTE* WINPR_RESTRICT src, size_t size,
+                                   wStream* WINPR_RESTRICT out)
+{
+	if (!resampler || (!src && (size > 0)) || !out)
+		return FALSE;
+
+	const size_t channels = resampler->channels;
+	const size_t taps = resampler->taps;
+	const size_t frames = size / (channels * sizeof(INT16));
+
+	if (!dsp_resample_ensure_history(resampler, resampler->avail + frames))
+		return FALSE;
+
+	for (size_t c = 0; c < channels; c++)
+	{
+		INT16* history = &resampler->history[c * resampler->capacity + resampler->avail];
+		const BYTE* in = &src[c * sizeof(INT16)];
+
+		for (size_t x = 0; x < frames; x++)
+		{
+			history[x] = (INT16)(in[0] | (in[1] << 8));
+			in += channels * sizeof(INT16);
+		}
+	}
+	resampler->avail += frames;
+
+	if (resampler->avail < taps)
+		return TRUE;
+
+	/* Upper bound of the frames that can be produced from the buffered input */
+	const size_t ready = ((resampler->avail - taps + 1) * resampler->L) / resampler->M + 1;
+	if (!Stream_EnsureRemainingCapacity(out, ready * channels * sizeof(INT16)))
+		return FALSE;
+
+	const FREERDP_DSP_RESAMPLE_KERNELS* kernels = resampler->kernels;
+	const INT32 round = 1 << (FREERDP_DSP_RESAMPLE_COEFF_BITS - 1);
+	size_t pos = 0;
+	UINT32 frac = resampler->frac;
+
+	while (pos + taps <= resampler->avail)
+	{
+		const UINT64 phase = (1ull * frac * resampler->phases) / resampler->L;
+		const INT16* coeffs = &resampler->coeffs[phase * taps];
+
+		for (size_t c = 0; c < channels; c++)
+		{
+			const INT16* history = &resampler->history[c * resampler->capacity + pos];
+			const INT32 acc = kernels->dot_s16(history, coeffs, taps);
+			INT32 v = (acc + round) >> FREERDP_DSP_RESAMPLE_COEFF_BITS;
+			v = MAX(INT16_MIN, MIN(INT16_MAX, v));
+			Stream_Write_INT16(out, (INT16)v);
+		}
+
+		frac += resampler->M;
+		pos += frac / resampler->L;
+		frac %= resampler->L;
+	}
+
+	resampler->frac = frac;
+	resampler->avail -= pos;
+
+	if (pos > 0)
+	{
+		for (size_t c = 0; c < channels; c++)
+		{
+			INT16* history = &resampler->history[c * resampler->capacity];
+			memmove(history, &history[pos], resampler->avail * sizeof(INT16));
+		}
+	}
+
+	return TRUE;
+}
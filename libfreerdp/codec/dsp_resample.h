@@ -0,0 +1,73 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - built-in resampler and channel mixer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_DSP_RESAMPLE_H
+#define FREERDP_LIB_CODEC_DSP_RESAMPLE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <freerdp/api.h>
+
+/** fractional bits of the fixed point filter coefficients */
+#define FREERDP_DSP_RESAMPLE_COEFF_BITS 14
+/** the number of filter taps is always a multiple of this */
+#define FREERDP_DSP_RESAMPLE_TAP_ALIGN 16
+
+/** @brief Inner loops of the resampler and channel mixer.
+ *
+ *  All implementations operate on integers only and produce bit identical results.
+ */
+typedef struct
+{
+	/** sum of \b samples[x] * \b coeffs[x], \b count is a multiple of
+	 * FREERDP_DSP_RESAMPLE_TAP_ALIGN */
+	INT32 (*dot_s16)(const INT16* WINPR_RESTRICT samples, const INT16* WINPR_RESTRICT coeffs,
+	                 size_t count);
+	/** duplicate \b frames mono samples to stereo */
+	void (*upmix_s16)(const INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst, size_t frames);
+	/** average \b frames stereo frames to mono */
+	void (*downmix_s16)(const INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+	                    size_t frames);
+} FREERDP_DSP_RESAMPLE_KERNELS;
+
+FREERDP_LOCAL void freerdp_dsp_resample_init_generic(FREERDP_DSP_RESAMPLE_KERNELS* kernels);
+
+/** @brief The fastest kernels supported by the CPU */
+FREERDP_LOCAL const FREERDP_DSP_RESAMPLE_KERNELS* freerdp_dsp_resample_kernels(void);
+
+typedef struct S_FREERDP_DSP_RESAMPLER FREERDP_DSP_RESAMPLER;
+
+FREERDP_LOCAL void freerdp_dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler);
+
+WINPR_ATTR_MALLOC(freerdp_dsp_resampler_free, 1)
+FREERDP_LOCAL FREERDP_DSP_RESAMPLER* freerdp_dsp_resampler_new(UINT32 srcRate, UINT32 dstRate,
+                                                               UINT32 channels);
+
+FREERDP_LOCAL BOOL freerdp_dsp_resampler_matches(const FREERDP_DSP_RESAMPLER* resampler,
+                                                 UINT32 srcRate, UINT32 dstRate, UINT32 channels);
+
+/** @brief Resample interleaved 16 bit little endian PCM and append the result to \b out.
+ *
+ *  The filter history is kept between calls, so a stream can be fed in arbitrary chunks.
+ *  The output is delayed by half the filter length.
+ */
+FREERDP_LOCAL BOOL freerdp_dsp_resampler_process(FREERDP_DSP_RESAMPLER* resampler,
+                                                 const BYTE* WINPR_RESTRICT src, size_t size,
+                                                 wStream* WINPR_RESTRICT out);
+
+#endif /* FREERDP_LIB_CODEC_DSP_RESAMPLE_H */
@@ -0,0 +1,97 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - NEON Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "dsp_resample_neon.h"
+
+#include "../../core/simd.h"
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+static INT32 neon_dot_s16(const INT16* WINPR_RESTRICT samples, const INT16* WINPR_RESTRICT coeffs,
+                          size_t count)
+{
+	int32x4_t acc = vdupq_n_s32(0);
+
+	WINPR_ASSERT((count % 8) == 0);
+
+	for (size_t x = 0; x < count; x += 8)
+	{
+		const int16x8_t s = vld1q_s16(&samples[x]);
+		const int16x8_t c = vld1q_s16(&coeffs[x]);
+		acc = vmlal_s16(acc, vget_low_s16(s), vget_low_s16(c));
+		acc = vmlal_s16(acc, vget_high_s16(s), vget_high_s16(c));
+	}
+
+	int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	sum = vpadd_s32(sum, sum);
+	return vget_lane_s32(sum, 0);
+}
+
+static void neon_upmix_s16(const INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                           size_t frames)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		int16x8x2_t v;
+		v.val[0] = vld1q_s16(&src[x]);
+		v.val[1] = v.val[0];
+		vst2q_s16(&dst[2 * x], v);
+	}
+
+	for (; x < frames; x++)
+	{
+		dst[2 * x] = src[x];
+		dst[2 * x + 1] = src[x];
+	}
+}
+
+static void neon_downmix_s16(const INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                             size_t frames)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		/* halving add, (l + r) >> 1 without intermediate overflow */
+		const int16x8x2_t v = vld2q_s16(&src[2 * x]);
+		vst1q_s16(&dst[x], vhaddq_s16(v.val[0], v.val[1]));
+	}
+
+	for (; x < frames; x++)
+		dst[x] = (INT16)(((INT32)src[2 * x] + src[2 * x + 1]) >> 1);
+}
+#endif
+
+void dsp_resample_init_neon_int(FREERDP_DSP_RESAMPLE_KERNELS* kernels)
+{
+#if defined(NEON_INTRINSICS_ENABLED)
+	WINPR_ASSERT(kernels);
+
+	kernels->dot_s16 = neon_dot_s16;
+	kernels->upmix_s16 = neon_upmix_s16;
+	kernels->downmix_s16 = neon_downmix_s16;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
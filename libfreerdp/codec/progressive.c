@@ -2568,6 +2568,10 @@ PROGRESSIVE_CONTEXT* progressive_context_new_ex(BOOL Compressor, UINT32 Threadin
 	if (!progressive->SurfaceContexts)
 		goto fail;
 
+	/* surface contexts are looked up for every tile, but rarely created */
+	if (!HashTable_SetReadMostly(progressive->SurfaceContexts, TRUE))
+		goto fail;
+
 	{
 		wObject* obj = HashTable_ValueObject(progressive->SurfaceContexts);
 		WINPR_ASSERT(obj);
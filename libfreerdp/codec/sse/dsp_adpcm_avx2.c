@@ -0,0 +1,229 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+#include <freerdp/types.h>
+
+#include "dsp_adpcm_avx2.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+/* Every lane decodes one channel of one block, so 8 mono or 4 stereo blocks are decoded at
+ * once. The nibbles are gathered from the source, a 32 bit gather ending at the wanted byte
+ * is used so it never reads past the end of the buffer. */
+#define LANES 8
+
+static FREERDP_DSP_ADPCM_KERNELS generic = { 0 };
+static const INT32* ima_table = NULL;
+
+static INT32 read_int16(const BYTE* WINPR_RESTRICT src)
+{
+	return (INT16)(src[0] | (src[1] << 8));
+}
+
+static INLINE __m256i avx2_clamp_int16(__m256i value)
+{
+	return _mm256_min_epi32(_mm256_max_epi32(value, _mm256_set1_epi32(-32768)),
+	                        _mm256_set1_epi32(32767));
+}
+
+/* signed division by 256 rounding towards zero, like the C operator */
+static INLINE __m256i avx2_div256(__m256i value)
+{
+	const __m256i bias = _mm256_and_si256(_mm256_srai_epi32(value, 31), _mm256_set1_epi32(255));
+	return _mm256_srai_epi32(_mm256_add_epi32(value, bias), 8);
+}
+
+static INLINE void avx2_scatter(INT16* WINPR_RESTRICT dst, const size_t* WINPR_RESTRICT offsets,
+                                __m256i value)
+{
+	INT32 tmp[LANES];
+
+	_mm256_storeu_si256((__m256i*)tmp, value);
+	for (size_t l = 0; l < LANES; l++)
+		dst[offsets[l]] = (INT16)tmp[l];
+}
+
+static void avx2_ima_decode_blocks(const BYTE* WINPR_RESTRICT src, size_t blocks,
+                                   size_t blockAlign, size_t channels, INT16* WINPR_RESTRICT dst)
+{
+	const size_t perGroup = LANES / channels;
+	const size_t header = 4 * channels;
+	const size_t frames = (blockAlign - header) * 2 / channels;
+	const size_t samples = frames * channels;
+	const __m256i mask = _mm256_set1_epi32(0x0F);
+	const __m256i stepMask = _mm256_set1_epi32(0xFF);
+	size_t b = 0;
+
+	for (; b + perGroup <= blocks; b += perGroup)
+	{
+		const BYTE* base = &src[b * blockAlign];
+		INT16* out = &dst[b * samples];
+		INT32 sample[LANES] = { 0 };
+		INT32 step[LANES] = { 0 };
+		INT32 offset[LANES] = { 0 };
+		size_t outOffset[LANES] = { 0 };
+
+		for (size_t l = 0; l < LANES; l++)
+		{
+			const size_t blk = l / channels;
+			const size_t c = l % channels;
+			const BYTE* hdr = &base[blk * blockAlign + 4 * c];
+
+			sample[l] = read_int16(hdr);
+			step[l] = MIN(hdr[2], 88);
+			offset[l] = (INT32)(blk * blockAlign + header + 4 * c - 3);
+			outOffset[l] = blk * samples + c;
+		}
+
+		__m256i vsample = _mm256_loadu_si256((const __m256i*)sample);
+		__m256i vstep = _mm256_loadu_si256((const __m256i*)step);
+		const __m256i voffset = _mm256_loadu_si256((const __m256i*)offset);
+
+		for (size_t t = 0; t < frames; t++)
+		{
+			/* mono: 2 samples per byte, stereo: 4 bytes per channel in groups of 8 bytes */
+			const size_t f = (channels > 1) ? ((t / 8) * 8 + (t % 8) / 2) : (t / 2);
+			const __m256i off = _mm256_add_epi32(voffset, _mm256_set1_epi32((int)f));
+			const __m256i bytes = _mm256_i32gather_epi32((const int*)base, off, 1);
+			const __m128i shift = _mm_cvtsi32_si128((t & 1) ? 28 : 24);
+			const __m256i nibble = _mm256_and_si256(_mm256_srl_epi32(bytes, shift), mask);
+			const __m256i index = _mm256_add_epi32(_mm256_slli_epi32(vstep, 4), nibble);
+			const __m256i entry = _mm256_i32gather_epi32((const int*)ima_table, index, 4);
+
+			vsample = avx2_clamp_int16(_mm256_add_epi32(vsample, _mm256_srai_epi32(entry, 8)));
+			vstep = _mm256_and_si256(entry, stepMask);
+			avx2_scatter(&out[t * channels], outOffset, vsample);
+		}
+	}
+
+	if (b < blocks)
+		generic.ima_decode_blocks(&src[b * blockAlign], blocks - b, blockAlign, channels,
+		                          &dst[b * samples]);
+}
+
+static void avx2_ms_decode_blocks(const BYTE* WINPR_RESTRICT src, size_t blocks,
+                                  size_t blockAlign, size_t channels, INT16* WINPR_RESTRICT dst)
+{
+	const size_t perGroup = LANES / channels;
+	const size_t header = FREERDP_DSP_MS_ADPCM_HEADER * channels;
+	const size_t frames = (blockAlign - header) * 2 / channels;
+	const size_t samples = 2 * channels + frames * channels;
+	const __m256i mask = _mm256_set1_epi32(0x0F);
+	const __m256i eight = _mm256_set1_epi32(8);
+	const __m256i seven = _mm256_set1_epi32(7);
+	const __m256i minDelta = _mm256_set1_epi32(16);
+	const __m256i adaptLo = _mm256_loadu_si256((const __m256i*)&ms_adpcm_adaptation_table[0]);
+	const __m256i adaptHi = _mm256_loadu_si256((const __m256i*)&ms_adpcm_adaptation_table[8]);
+	size_t b = 0;
+
+	for (; b + perGroup <= blocks; b += perGroup)
+	{
+		const BYTE* base = &src[b * blockAlign];
+		INT16* out = &dst[b * samples];
+		INT32 coeff1[LANES] = { 0 };
+		INT32 coeff2[LANES] = { 0 };
+		INT32 delta[LANES] = { 0 };
+		INT32 sample1[LANES] = { 0 };
+		INT32 sample2[LANES] = { 0 };
+		INT32 offset[LANES] = { 0 };
+		INT32 shift[LANES] = { 0 };
+		size_t outOffset[LANES] = { 0 };
+
+		for (size_t l = 0; l < LANES; l++)
+		{
+			const size_t blk = l / channels;
+			const size_t c = l % channels;
+			const BYTE* hdr = &base[blk * blockAlign];
+			INT16* blkOut = &out[blk * samples];
+			const BYTE predictor = hdr[c];
+
+			coeff1[l] = ms_adpcm_coeffs1[predictor];
+			coeff2[l] = ms_adpcm_coeffs2[predictor];
+			delta[l] = read_int16(&hdr[channels + 2 * c]);
+			sample1[l] = read_int16(&hdr[3 * channels + 2 * c]);
+			sample2[l] = read_int16(&hdr[5 * channels + 2 * c]);
+			blkOut[c] = (INT16)sample2[l];
+			blkOut[channels + c] = (INT16)sample1[l];
+
+			offset[l] = (INT32)(blk * blockAlign + header - 3);
+			/* stereo: high nibble left, low nibble right */
+			shift[l] = (channels > 1) ? ((c == 0) ? 28 : 24) : 28;
+			outOffset[l] = blk * samples + 2 * channels + c;
+		}
+
+		const __m256i vcoeff1 = _mm256_loadu_si256((const __m256i*)coeff1);
+		const __m256i vcoeff2 = _mm256_loadu_si256((const __m256i*)coeff2);
+		const __m256i voffset = _mm256_loadu_si256((const __m256i*)offset);
+		const __m256i vshift = _mm256_loadu_si256((const __m256i*)shift);
+		const __m256i monoShift = _mm256_set1_epi32(24);
+		__m256i vdelta = _mm256_loadu_si256((const __m256i*)delta);
+		__m256i vsample1 = _mm256_loadu_si256((const __m256i*)sample1);
+		__m256i vsample2 = _mm256_loadu_si256((const __m256i*)sample2);
+
+		for (size_t t = 0; t < frames; t++)
+		{
+			/* mono: high nibble first, stereo: one byte per frame */
+			const size_t f = (channels > 1) ? t : (t / 2);
+			const __m256i off = _mm256_add_epi32(voffset, _mm256_set1_epi32((int)f));
+			const __m256i bytes = _mm256_i32gather_epi32((const int*)base, off, 1);
+			const __m256i sh = ((channels == 1) && (t & 1)) ? monoShift : vshift;
+			const __m256i nibble = _mm256_and_si256(_mm256_srlv_epi32(bytes, sh), mask);
+			const __m256i value = _mm256_sub_epi32(_mm256_xor_si256(nibble, eight), eight);
+
+			__m256i presample = _mm256_add_epi32(_mm256_mullo_epi32(vsample1, vcoeff1),
+			                                     _mm256_mullo_epi32(vsample2, vcoeff2));
+			presample = avx2_div256(presample);
+			presample = _mm256_add_epi32(presample, _mm256_mullo_epi32(value, vdelta));
+			presample = avx2_clamp_int16(presample);
+
+			vsample2 = vsample1;
+			vsample1 = presample;
+
+			const __m256i adapt =
+			    _mm256_blendv_epi8(_mm256_permutevar8x32_epi32(adaptLo, nibble),
+			                       _mm256_permutevar8x32_epi32(adaptHi, nibble),
+			                       _mm256_cmpgt_epi32(nibble, seven));
+			vdelta = _mm256_max_epi32(avx2_div256(_mm256_mullo_epi32(vdelta, adapt)), minDelta);
+			avx2_scatter(&out[t * channels], outOffset, presample);
+		}
+	}
+
+	if (b < blocks)
+		generic.ms_decode_blocks(&src[b * blockAlign], blocks - b, blockAlign, channels,
+		                         &dst[b * samples]);
+}
+#endif
+
+void dsp_adpcm_init_avx2_int(FREERDP_DSP_ADPCM_KERNELS* kernels)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WINPR_ASSERT(kernels);
+
+	generic = *kernels;
+	ima_table = freerdp_dsp_ima_adpcm_table();
+	kernels->ima_decode_blocks = avx2_ima_decode_blocks;
+	kernels->ms_decode_blocks = avx2_ms_decode_blocks;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
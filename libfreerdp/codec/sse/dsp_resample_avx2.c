@@ -0,0 +1,60 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "dsp_resample_avx2.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+static INT32 avx2_dot_s16(const INT16* WINPR_RESTRICT samples, const INT16* WINPR_RESTRICT coeffs,
+                          size_t count)
+{
+	__m256i acc = _mm256_setzero_si256();
+
+	WINPR_ASSERT((count % 16) == 0);
+
+	for (size_t x = 0; x < count; x += 16)
+	{
+		const __m256i s = _mm256_loadu_si256((const __m256i*)&samples[x]);
+		const __m256i c = _mm256_loadu_si256((const __m256i*)&coeffs[x]);
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(s, c));
+	}
+
+	__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+void dsp_resample_init_avx2_int(FREERDP_DSP_RESAMPLE_KERNELS* kernels)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WINPR_ASSERT(kernels);
+
+	/* The channel mixers are memory bound, the SSE2 versions are kept */
+	kernels->dot_s16 = avx2_dot_s16;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,99 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "dsp_resample_sse2.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <emmintrin.h>
+
+static INT32 sse2_dot_s16(const INT16* WINPR_RESTRICT samples, const INT16* WINPR_RESTRICT coeffs,
+                          size_t count)
+{
+	__m128i acc = _mm_setzero_si128();
+
+	WINPR_ASSERT((count % 8) == 0);
+
+	for (size_t x = 0; x < count; x += 8)
+	{
+		const __m128i s = _mm_loadu_si128((const __m128i*)&samples[x]);
+		const __m128i c = _mm_loadu_si128((const __m128i*)&coeffs[x]);
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(s, c));
+	}
+
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(acc);
+}
+
+static void sse2_upmix_s16(const INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                           size_t frames)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		const __m128i s = _mm_loadu_si128((const __m128i*)&src[x]);
+		_mm_storeu_si128((__m128i*)&dst[2 * x], _mm_unpacklo_epi16(s, s));
+		_mm_storeu_si128((__m128i*)&dst[2 * x + 8], _mm_unpackhi_epi16(s, s));
+	}
+
+	for (; x < frames; x++)
+	{
+		dst[2 * x] = src[x];
+		dst[2 * x + 1] = src[x];
+	}
+}
+
+static void sse2_downmix_s16(const INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                             size_t frames)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		/* l + r of every frame as 32 bit, halved and packed back without saturation */
+		const __m128i lo = _mm_loadu_si128((const __m128i*)&src[2 * x]);
+		const __m128i hi = _mm_loadu_si128((const __m128i*)&src[2 * x + 8]);
+		const __m128i sumLo = _mm_srai_epi32(_mm_madd_epi16(lo, ones), 1);
+		const __m128i sumHi = _mm_srai_epi32(_mm_madd_epi16(hi, ones), 1);
+		_mm_storeu_si128((__m128i*)&dst[x], _mm_packs_epi32(sumLo, sumHi));
+	}
+
+	for (; x < frames; x++)
+		dst[x] = (INT16)(((INT32)src[2 * x] + src[2 * x + 1]) >> 1);
+}
+#endif
+
+void dsp_resample_init_sse2_int(FREERDP_DSP_RESAMPLE_KERNELS* kernels)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WINPR_ASSERT(kernels);
+
+	kernels->dot_s16 = sse2_dot_s16;
+	kernels->upmix_s16 = sse2_upmix_s16;
+	kernels->downmix_s16 = sse2_downmix_s16;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,667 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/stream.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/codec/audio.h>
+#include <freerdp/codec/dsp.h>
+
+#define TEST_RATE 22050
+#define TEST_FRAMES_PER_PACKET 1024
+#define TEST_BENCHMARK_BLOCKS 2000
+
+/* Reference implementations, straight scalar code the DSP module must stay bit exact with */
+typedef struct
+{
+	UINT16 channels;
+	UINT16 block_align;
+	size_t packet_size;
+	wStream* buffer;
+	INT16 last_sample[2];
+	INT16 last_step[2];
+	BYTE predictor[2];
+	INT32 delta[2];
+	INT32 sample1[2];
+	INT32 sample2[2];
+} REF_ADPCM;
+
+static const INT16 ima_step_index_table[] = {
+	-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const INT16 ima_step_size_table[] = {
+	7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,   21,    23,
+	25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,   73,    80,
+	88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,  253,   279,
+	307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,  876,   963,
+	1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749, 3024,  3327,
+	3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487,
+	12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const INT32 ms_adaptation_table[] = { 230, 230, 230, 230, 307, 409, 512, 614,
+	                                         768, 614, 512, 409, 307, 230, 230, 230 };
+
+static const INT32 ms_coeffs1[7] = { 256, 512, 0, 192, 240, 460, 392 };
+
+static const INT32 ms_coeffs2[7] = { 0, -256, 0, 64, 0, -208, -232 };
+
+static INT16 ref_read_int16(const BYTE* src)
+{
+	return (INT16)(src[0] | (src[1] << 8));
+}
+
+static INT16 ref_ima_decode_sample(REF_ADPCM* ref, size_t channel, BYTE sample)
+{
+	const INT32 ss = ima_step_size_table[ref->last_step[channel]];
+	INT32 d = (ss >> 3);
+
+	if (sample & 1)
+		d += (ss >> 2);
+	if (sample & 2)
+		d += (ss >> 1);
+	if (sample & 4)
+		d += ss;
+	if (sample & 8)
+		d = -d;
+
+	d += ref->last_sample[channel];
+	if (d < -32768)
+		d = -32768;
+	else if (d > 32767)
+		d = 32767;
+
+	ref->last_sample[channel] = (INT16)d;
+	ref->last_step[channel] += ima_step_index_table[sample];
+	if (ref->last_step[channel] < 0)
+		ref->last_step[channel] = 0;
+	else if (ref->last_step[channel] > 88)
+		ref->last_step[channel] = 88;
+
+	return (INT16)d;
+}
+
+static BOOL ref_ima_decode(REF_ADPCM* ref, const BYTE* src, size_t size, wStream* out)
+{
+	if (!Stream_EnsureRemainingCapacity(out, size * 4))
+		return FALSE;
+
+	while (size > 0)
+	{
+		if (size % ref->block_align == 0)
+		{
+			for (size_t c = 0; c < ref->channels; c++)
+			{
+				ref->last_sample[c] = ref_read_int16(src);
+				ref->last_step[c] = src[2];
+				src += 4;
+				size -= 4;
+			}
+		}
+
+		if (ref->channels > 1)
+		{
+			INT16* dst = Stream_PointerAs(out, INT16);
+
+			for (size_t i = 0; i < 8; i++)
+			{
+				const size_t channel = (i < 4) ? 0 : 1;
+				const size_t frame = (i & 3) * 2;
+				dst[frame * 2 + channel] = ref_ima_decode_sample(ref, channel, *src & 0x0F);
+				dst[(frame + 1) * 2 + channel] = ref_ima_decode_sample(ref, channel, *src >> 4);
+				src++;
+			}
+			Stream_Seek(out, 32);
+			size -= 8;
+		}
+		else
+		{
+			const INT16 lo = ref_ima_decode_sample(ref, 0, *src & 0x0F);
+			const INT16 hi = ref_ima_decode_sample(ref, 0, *src >> 4);
+			Stream_Write_INT16(out, lo);
+			Stream_Write_INT16(out, hi);
+			src++;
+			size--;
+		}
+	}
+
+	return TRUE;
+}
+
+static BYTE ref_ima_encode_sample(REF_ADPCM* ref, size_t channel, INT16 sample)
+{
+	INT32 ss = ima_step_size_table[ref->last_step[channel]];
+	INT32 e = sample - ref->last_sample[channel];
+	const INT32 d = e;
+	INT32 diff = ss >> 3;
+	BYTE enc = 0;
+
+	if (e < 0)
+	{
+		enc = 8;
+		e = -e;
+	}
+
+	for (BYTE bit = 4; bit > 0; bit >>= 1)
+	{
+		if (e >= ss)
+		{
+			enc |= bit;
+			e -= ss;
+		}
+		ss >>= 1;
+	}
+
+	if (d < 0)
+		diff = d + e - diff;
+	else
+		diff = d - e + diff;
+
+	diff += ref->last_sample[channel];
+	if (diff < -32768)
+		diff = -32768;
+	else if (diff > 32767)
+		diff = 32767;
+
+	ref->last_sample[channel] = (INT16)diff;
+	ref->last_step[channel] += ima_step_index_table[enc];
+	if (ref->last_step[channel] < 0)
+		ref->last_step[channel] = 0;
+	else if (ref->last_step[channel] > 88)
+		ref->last_step[channel] = 88;
+
+	return enc;
+}
+
+static BOOL ref_ima_encode(REF_ADPCM* ref, const BYTE* src, size_t size, wStream* out)
+{
+	const size_t align = (ref->channels > 1) ? 32 : 4;
+
+	if (!Stream_EnsureRemainingCapacity(out, size) ||
+	    !Stream_EnsureRemainingCapacity(ref->buffer, size + 64))
+		return FALSE;
+
+	while (size >= align)
+	{
+		if (Stream_GetPosition(ref->buffer) % ref->block_align == 0)
+		{
+			for (size_t c = 0; c < ref->channels; c++)
+			{
+				Stream_Write_INT16(ref->buffer, ref->last_sample[c]);
+				Stream_Write_UINT8(ref->buffer, (BYTE)ref->last_step[c]);
+				Stream_Write_UINT8(ref->buffer, 0);
+			}
+		}
+
+		if (ref->channels > 1)
+		{
+			/* 8 samples per channel, 4 bytes left then 4 bytes right, low nibble first */
+			BYTE* dst = Stream_Pointer(ref->buffer);
+			ZeroMemory(dst, 8);
+
+			for (size_t i = 0; i < 16; i++)
+			{
+				const size_t channel = i % 2;
+				const size_t frame = i / 2;
+				const BYTE encoded = ref_ima_encode_sample(ref, channel, ref_read_int16(src));
+				dst[channel * 4 + frame / 2] |= (BYTE)(encoded << ((frame % 2) * 4));
+				src += 2;
+			}
+			Stream_Seek(ref->buffer, 8);
+			size -= 32;
+		}
+		else
+		{
+			BYTE encoded = ref_ima_encode_sample(ref, 0, ref_read_int16(src));
+			encoded |= (BYTE)(ref_ima_encode_sample(ref, 0, ref_read_int16(src + 2)) << 4);
+			Stream_Write_UINT8(ref->buffer, encoded);
+			src += 4;
+			size -= 4;
+		}
+
+		if (Stream_GetPosition(ref->buffer) >= ref->packet_size)
+		{
+			if (!Stream_EnsureRemainingCapacity(out, ref->packet_size))
+				return FALSE;
+			Stream_Write(out, Stream_Buffer(ref->buffer), ref->packet_size);
+			Stream_SetPosition(ref->buffer, 0);
+		}
+	}
+
+	return TRUE;
+}
+
+static INT16 ref_ms_decode_sample(REF_ADPCM* ref, BYTE sample, size_t channel)
+{
+	const INT8 nibble = (sample & 0x08 ? (INT8)sample - 16 : (INT8)sample);
+	INT32 presample = ((ref->sample1[channel] * ms_coeffs1[ref->predictor[channel]]) +
+	                   (ref->sample2[channel] * ms_coeffs2[ref->predictor[channel]])) /
+	                  256;
+	presample += nibble * ref->delta[channel];
+
+	if (presample > 32767)
+		presample = 32767;
+	else if (presample < -32768)
+		presample = -32768;
+
+	ref->sample2[channel] = ref->sample1[channel];
+	ref->sample1[channel] = presample;
+	ref->delta[channel] = ref->delta[channel] * ms_adaptation_table[sample] / 256;
+	if (ref->delta[channel] < 16)
+		ref->delta[channel] = 16;
+
+	return (INT16)presample;
+}
+
+static BOOL ref_ms_decode(REF_ADPCM* ref, const BYTE* src, size_t size, wStream* out)
+{
+	const size_t channels = ref->channels;
+
+	if (!Stream_EnsureRemainingCapacity(out, size * 4))
+		return FALSE;
+
+	while (size > 0)
+	{
+		if (size % ref->block_align == 0)
+		{
+			for (size_t c = 0; c < channels; c++)
+			{
+				ref->predictor[c] = src[c];
+				ref->delta[c] = ref_read_int16(&src[channels + 2 * c]);
+				ref->sample1[c] = ref_read_int16(&src[3 * channels + 2 * c]);
+				ref->sample2[c] = ref_read_int16(&src[5 * channels + 2 * c]);
+			}
+			for (size_t c = 0; c < channels; c++)
+				Stream_Write_INT16(out, (INT16)ref->sample2[c]);
+			for (size_t c = 0; c < channels; c++)
+				Stream_Write_INT16(out, (INT16)ref->sample1[c]);
+			src += 7 * channels;
+			size -= 7 * channels;
+		}
+
+		/* stereo: high nibble left, low nibble right, mono: high nibble first */
+		const BYTE sample = *src++;
+		size--;
+		const INT16 hi = ref_ms_decode_sample(ref, sample >> 4, 0);
+		const INT16 lo = ref_ms_decode_sample(ref, sample & 0x0F, (channels > 1) ? 1 : 0);
+		Stream_Write_INT16(out, hi);
+		Stream_Write_INT16(out, lo);
+	}
+
+	return TRUE;
+}
+
+static BYTE ref_ms_encode_sample(REF_ADPCM* ref, INT32 sample, size_t channel)
+{
+	INT32 presample = ((ref->sample1[channel] * ms_coeffs1[ref->predictor[channel]]) +
+	                   (ref->sample2[channel] * ms_coeffs2[ref->predictor[channel]])) /
+	                  256;
+	INT32 errordelta = (sample - presample) / ref->delta[channel];
+
+	if ((sample - presample) % ref->delta[channel] > ref->delta[channel] / 2)
+		errordelta++;
+
+	if (errordelta > 7)
+		errordelta = 7;
+	else if (errordelta < -8)
+		errordelta = -8;
+
+	presample += ref->delta[channel] * errordelta;
+	if (presample > 32767)
+		presample = 32767;
+	else if (presample < -32768)
+		presample = -32768;
+
+	ref->sample2[channel] = ref->sample1[channel];
+	ref->sample1[channel] = presample;
+	ref->delta[channel] =
+	    ref->delta[channel] * ms_adaptation_table[(((BYTE)errordelta) & 0x0F)] / 256;
+	if (ref->delta[channel] < 16)
+		ref->delta[channel] = 16;
+
+	return ((BYTE)errordelta) & 0x0F;
+}
+
+static BOOL ref_ms_encode(REF_ADPCM* ref, const BYTE* src, size_t size, wStream* out)
+{
+	const size_t channels = ref->channels;
+	const size_t step = 8 + ((channels > 1) ? 4 : 0);
+
+	if (!Stream_EnsureRemainingCapacity(out, size))
+		return FALSE;
+
+	const size_t start = Stream_GetPosition(out);
+
+	for (size_t c = 0; c < 2; c++)
+	{
+		if (ref->delta[c] < 16)
+			ref->delta[c] = 16;
+	}
+
+	while (size >= step)
+	{
+		if ((Stream_GetPosition(out) - start) % ref->block_align == 0)
+		{
+			for (size_t c = 0; c < channels; c++)
+				Stream_Write_UINT8(out, ref->predictor[c]);
+			for (size_t c = 0; c < channels; c++)
+				Stream_Write_INT16(out, (INT16)ref->delta[c]);
+			for (size_t c = 0; c < channels; c++)
+			{
+				ref->sample1[c] = ref_read_int16(&src[2 * (channels + c)]);
+				ref->sample2[c] = ref_read_int16(&src[2 * c]);
+			}
+			for (size_t c = 0; c < channels; c++)
+				Stream_Write_INT16(out, (INT16)ref->sample1[c]);
+			for (size_t c = 0; c < channels; c++)
+				Stream_Write_INT16(out, (INT16)ref->sample2[c]);
+			src += 4 * channels;
+			size -= 4 * channels;
+		}
+
+		const BYTE hi = ref_ms_encode_sample(ref, ref_read_int16(src), 0);
+		const BYTE lo = ref_ms_encode_sample(ref, ref_read_int16(src + 2), (channels > 1) ? 1 : 0);
+		Stream_Write_UINT8(out, (BYTE)((hi << 4) | lo));
+		src += 4;
+		size -= 4;
+	}
+
+	return TRUE;
+}
+
+static AUDIO_FORMAT test_adpcm_format(UINT16 tag, UINT16 channels, UINT16 blockAlign)
+{
+	const AUDIO_FORMAT format = { .wFormatTag = tag,
+		                          .nChannels = channels,
+		                          .nSamplesPerSec = TEST_RATE,
+		                          .nAvgBytesPerSec = TEST_RATE * blockAlign / 1024,
+		                          .nBlockAlign = blockAlign,
+		                          .wBitsPerSample = 4,
+		                          .cbSize = 0,
+		                          .data = NULL };
+	return format;
+}
+
+static AUDIO_FORMAT test_pcm_format(UINT16 channels)
+{
+	const AUDIO_FORMAT format = { .wFormatTag = WAVE_FORMAT_PCM,
+		                          .nChannels = channels,
+		                          .nSamplesPerSec = TEST_RATE,
+		                          .nAvgBytesPerSec = TEST_RATE * channels * 2,
+		                          .nBlockAlign = (UINT16)(channels * 2),
+		                          .wBitsPerSample = 16,
+		                          .cbSize = 0,
+		                          .data = NULL };
+	return format;
+}
+
+static BOOL test_ref_init(REF_ADPCM* ref, const AUDIO_FORMAT* format)
+{
+	const size_t min_frame_data = 1ull * format->wBitsPerSample * format->nChannels *
+	                              TEST_FRAMES_PER_PACKET;
+	const size_t data_per_block = (1ull * format->nBlockAlign - 4ull * format->nChannels) * 8ull;
+
+	ZeroMemory(ref, sizeof(REF_ADPCM));
+	ref->channels = format->nChannels;
+	ref->block_align = format->nBlockAlign;
+	ref->packet_size = (min_frame_data + data_per_block - 1) / data_per_block * ref->block_align;
+	ref->buffer = Stream_New(NULL, ref->packet_size + 64);
+	return ref->buffer != NULL;
+}
+
+/* random nibbles with valid block headers, at most 88 for the IMA step and 6 for MS predictors */
+static BYTE* test_adpcm_data(UINT16 tag, const AUDIO_FORMAT* format, size_t blocks)
+{
+	const size_t channels = format->nChannels;
+	BYTE* data = calloc(blocks, format->nBlockAlign);
+	if (!data)
+		return NULL;
+
+	winpr_RAND_pseudo(data, blocks * format->nBlockAlign);
+	for (size_t b = 0; b < blocks; b++)
+	{
+		BYTE* hdr = &data[b * format->nBlockAlign];
+		for (size_t c = 0; c < channels; c++)
+		{
+			if (tag == WAVE_FORMAT_DVI_ADPCM)
+				hdr[4 * c + 2] %= 89;
+			else
+				hdr[c] %= 7;
+		}
+	}
+	return data;
+}
+
+static INT16* test_pcm_data(UINT16 channels, size_t frames)
+{
+	INT16* samples = calloc(frames * channels, sizeof(INT16));
+	if (!samples)
+		return NULL;
+
+	winpr_RAND_pseudo(samples, frames * channels * sizeof(INT16));
+	for (size_t x = 0; x < frames; x++)
+	{
+		/* a loud tone with some noise, clipping now and then to exercise the clamps */
+		const double v = 40000.0 * sin(2.0 * M_PI * 440.0 * (double)x / TEST_RATE);
+		for (size_t c = 0; c < channels; c++)
+		{
+			const double n = v + samples[x * channels + c] / 16.0;
+			samples[x * channels + c] = (INT16)MAX(-32768.0, MIN(32767.0, n));
+		}
+	}
+	return samples;
+}
+
+static BOOL test_compare(const char* what, const AUDIO_FORMAT* format, wStream* s1, wStream* s2)
+{
+	const size_t l1 = Stream_GetPosition(s1);
+	const size_t l2 = Stream_GetPosition(s2);
+
+	if ((l1 == l2) && (memcmp(Stream_Buffer(s1), Stream_Buffer(s2), l1) == 0))
+		return TRUE;
+
+	(void)fprintf(stderr,
+	              "[%s] %s 0x%04" PRIx16 " %" PRIu16 "ch align %" PRIu16 ": %" PRIuz
+	              " bytes differ from reference %" PRIuz " bytes\n",
+	              __func__, what, format->wFormatTag, format->nChannels, format->nBlockAlign, l1,
+	              l2);
+	return FALSE;
+}
+
+static BOOL test_decode(UINT16 tag, UINT16 channels, UINT16 blockAlign, size_t blocks)
+{
+	BOOL rc = FALSE;
+	const AUDIO_FORMAT format = test_adpcm_format(tag, channels, blockAlign);
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(FALSE);
+	BYTE* data = test_adpcm_data(tag, &format, blocks);
+	wStream* out = Stream_New(NULL, 1024);
+	wStream* expect = Stream_New(NULL, 1024);
+	REF_ADPCM ref = { 0 };
+
+	if (!context || !data || !out || !expect || !test_ref_init(&ref, &format))
+		goto fail;
+
+	if (!freerdp_dsp_context_reset(context, &format, 0))
+		goto fail;
+
+	/* all blocks at once and one block per call */
+	const size_t size = blocks * blockAlign;
+	if (!freerdp_dsp_decode(context, &format, data, size, out))
+		goto fail;
+	for (size_t b = 0; b < blocks; b++)
+	{
+		if (!freerdp_dsp_decode(context, &format, &data[b * blockAlign], blockAlign, out))
+			goto fail;
+	}
+
+	for (size_t x = 0; x < 2; x++)
+	{
+		if (tag == WAVE_FORMAT_DVI_ADPCM)
+		{
+			if (!ref_ima_decode(&ref, data, size, expect))
+				goto fail;
+		}
+		else if (!ref_ms_decode(&ref, data, size, expect))
+			goto fail;
+	}
+
+	rc = test_compare("decode", &format, out, expect);
+
+fail:
+	Stream_Free(ref.buffer, TRUE);
+	Stream_Free(expect, TRUE);
+	Stream_Free(out, TRUE);
+	free(data);
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+static BOOL test_encode(UINT16 tag, UINT16 channels, UINT16 blockAlign, size_t frames,
+                        size_t chunk)
+{
+	BOOL rc = FALSE;
+	const AUDIO_FORMAT format = test_adpcm_format(tag, channels, blockAlign);
+	const AUDIO_FORMAT pcm = test_pcm_format(channels);
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(TRUE);
+	INT16* samples = test_pcm_data(channels, frames);
+	wStream* out = Stream_New(NULL, 1024);
+	wStream* expect = Stream_New(NULL, 1024);
+	REF_ADPCM ref = { 0 };
+
+	if (!context || !samples || !out || !expect || !test_ref_init(&ref, &format))
+		goto fail;
+
+	if (!freerdp_dsp_context_reset(context, &format, TEST_FRAMES_PER_PACKET))
+		goto fail;
+
+	for (size_t x = 0; x < frames; x += chunk)
+	{
+		const BYTE* src = (const BYTE*)&samples[x * channels];
+		const size_t size = MIN(chunk, frames - x) * pcm.nBlockAlign;
+
+		if (!freerdp_dsp_encode(context, &pcm, src, size, out))
+			goto fail;
+
+		if (tag == WAVE_FORMAT_DVI_ADPCM)
+		{
+			if (!ref_ima_encode(&ref, src, size, expect))
+				goto fail;
+		}
+		else if (!ref_ms_encode(&ref, src, size, expect))
+			goto fail;
+	}
+
+	rc = test_compare("encode", &format, out, expect);
+
+fail:
+	Stream_Free(ref.buffer, TRUE);
+	Stream_Free(expect, TRUE);
+	Stream_Free(out, TRUE);
+	free(samples);
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+static BOOL test_benchmark(UINT16 tag, UINT16 channels, UINT16 blockAlign)
+{
+	BOOL rc = FALSE;
+	const AUDIO_FORMAT format = test_adpcm_format(tag, channels, blockAlign);
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(FALSE);
+	BYTE* data = test_adpcm_data(tag, &format, TEST_BENCHMARK_BLOCKS);
+	wStream* out = Stream_New(NULL, 1024);
+	REF_ADPCM ref = { 0 };
+
+	if (!context || !data || !out || !test_ref_init(&ref, &format))
+		goto fail;
+
+	if (!freerdp_dsp_context_reset(context, &format, 0))
+		goto fail;
+
+	const size_t size = 1ull * TEST_BENCHMARK_BLOCKS * blockAlign;
+	const UINT64 t0 = winpr_GetUnixTimeNS();
+	if (!freerdp_dsp_decode(context, &format, data, size, out))
+		goto fail;
+	const UINT64 t1 = winpr_GetUnixTimeNS();
+
+	const size_t samples = Stream_GetPosition(out) / sizeof(INT16);
+	Stream_SetPosition(out, 0);
+	if (tag == WAVE_FORMAT_DVI_ADPCM)
+	{
+		if (!ref_ima_decode(&ref, data, size, out))
+			goto fail;
+	}
+	else if (!ref_ms_decode(&ref, data, size, out))
+		goto fail;
+	const UINT64 t2 = winpr_GetUnixTimeNS();
+
+	const double dsp = (double)(t1 - t0) / 1000000.0;
+	const double scalar = (double)(t2 - t1) / 1000000.0;
+	(void)fprintf(stdout,
+	              "[%s] 0x%04" PRIx16 " %" PRIu16 "ch align %" PRIu16 ": %" PRIuz
+	              " samples in %lf ms, scalar reference %lf ms\n",
+	              __func__, tag, channels, blockAlign, samples, dsp, scalar);
+	rc = TRUE;
+
+fail:
+	Stream_Free(ref.buffer, TRUE);
+	Stream_Free(out, TRUE);
+	free(data);
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+int TestFreeRDPCodecAdpcm(int argc, char* argv[])
+{
+	/* the timings are only run on request: TestFreeRDPCodec TestFreeRDPCodecAdpcm benchmark */
+	const BOOL benchmark = (argc > 1) && (strcmp(argv[1], "benchmark") == 0);
+
+	const struct
+	{
+		UINT16 tag;
+		UINT16 channels;
+		UINT16 blockAlign;
+	} formats[] = { { WAVE_FORMAT_DVI_ADPCM, 1, 256 },  { WAVE_FORMAT_DVI_ADPCM, 1, 1024 },
+		            { WAVE_FORMAT_DVI_ADPCM, 1, 37 },   { WAVE_FORMAT_DVI_ADPCM, 2, 2048 },
+		            { WAVE_FORMAT_DVI_ADPCM, 2, 512 },  { WAVE_FORMAT_DVI_ADPCM, 2, 40 },
+		            { WAVE_FORMAT_ADPCM, 1, 256 },      { WAVE_FORMAT_ADPCM, 1, 1024 },
+		            { WAVE_FORMAT_ADPCM, 1, 31 },       { WAVE_FORMAT_ADPCM, 2, 2048 },
+		            { WAVE_FORMAT_ADPCM, 2, 512 },      { WAVE_FORMAT_ADPCM, 2, 50 } };
+
+	for (size_t x = 0; x < ARRAYSIZE(formats); x++)
+	{
+		const UINT16 tag = formats[x].tag;
+		const UINT16 channels = formats[x].channels;
+		const UINT16 align = formats[x].blockAlign;
+
+		/* block counts around the width of the vector kernels */
+		const size_t blocks[] = { 1, 3, 4, 8, 9, 37 };
+		for (size_t y = 0; y < ARRAYSIZE(blocks); y++)
+		{
+			if (!test_decode(tag, channels, align, blocks[y]))
+				return -1;
+		}
+
+		const size_t chunks[] = { 16, 441, 4096 };
+		for (size_t y = 0; y < ARRAYSIZE(chunks); y++)
+		{
+			if (!test_encode(tag, channels, align, TEST_RATE, chunks[y]))
+				return -1;
+		}
+	}
+
+	for (size_t x = 0; benchmark && (x < ARRAYSIZE(formats)); x++)
+	{
+		if (formats[x].blockAlign < 256)
+			continue;
+		if (!test_benchmark(formats[x].tag, formats[x].channels, formats[x].blockAlign))
+			return -1;
+	}
+
+	return 0;
+}
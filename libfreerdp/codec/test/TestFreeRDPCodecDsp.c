@@ -0,0 +1,304 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/codec/audio.h>
+#include <freerdp/codec/dsp.h>
+
+#define TEST_AMPLITUDE 16000.0
+
+static AUDIO_FORMAT test_pcm_format(UINT32 rate, UINT16 channels)
+{
+	const AUDIO_FORMAT format = { .wFormatTag = WAVE_FORMAT_PCM,
+		                          .nChannels = channels,
+		                          .nSamplesPerSec = rate,
+		                          .nAvgBytesPerSec = rate * channels * 2,
+		                          .nBlockAlign = (UINT16)(channels * 2),
+		                          .wBitsPerSample = 16,
+		                          .cbSize = 0,
+		                          .data = NULL };
+	return format;
+}
+
+static INT16* test_tone(UINT32 rate, UINT16 channels, size_t frames, double freq, double offset)
+{
+	INT16* samples = calloc(frames * channels, sizeof(INT16));
+	if (!samples)
+		return NULL;
+
+	for (size_t x = 0; x < frames; x++)
+	{
+		const double v = offset + TEST_AMPLITUDE * sin(2.0 * M_PI * freq * (double)x / rate);
+		for (size_t c = 0; c < channels; c++)
+			samples[x * channels + c] = (INT16)lround(v);
+	}
+	return samples;
+}
+
+static wStream* test_encode(const AUDIO_FORMAT* srcFormat, const AUDIO_FORMAT* dstFormat,
+                            const INT16* samples, size_t frames, size_t chunk)
+{
+	wStream* out = Stream_New(NULL, 1024);
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(TRUE);
+	if (!out || !context)
+		goto fail;
+
+	if (!freerdp_dsp_context_reset(context, dstFormat, 0))
+		goto fail;
+
+	for (size_t x = 0; x < frames; x += chunk)
+	{
+		const size_t count = MIN(chunk, frames - x);
+		const BYTE* data = (const BYTE*)&samples[x * srcFormat->nChannels];
+		if (!freerdp_dsp_encode(context, srcFormat, data, count * srcFormat->nBlockAlign, out))
+			goto fail;
+	}
+
+	Stream_SealLength(out);
+	freerdp_dsp_context_free(context);
+	return out;
+
+fail:
+	(void)fprintf(stderr, "[%s] encoding %" PRIu32 "Hz -> %" PRIu32 "Hz failed\n", __func__,
+	              srcFormat->nSamplesPerSec, dstFormat->nSamplesPerSec);
+	freerdp_dsp_context_free(context);
+	Stream_Free(out, TRUE);
+	return NULL;
+}
+
+/* Fit a sine of freq to the first channel of [first, last) and return amplitude and residual */
+static void test_fit(const INT16* samples, UINT16 channels, UINT32 rate, size_t first, size_t last,
+                     double freq, double* amplitude, double* residual)
+{
+	const double n = (double)(last - first);
+	double a = 0.0;
+	double b = 0.0;
+
+	for (size_t x = first; x < last; x++)
+	{
+		const double w = 2.0 * M_PI * freq * (double)x / rate;
+		a += samples[x * channels] * sin(w);
+		b += samples[x * channels] * cos(w);
+	}
+	a = 2.0 * a / n;
+	b = 2.0 * b / n;
+
+	double err = 0.0;
+	for (size_t x = first; x < last; x++)
+	{
+		const double w = 2.0 * M_PI * freq * (double)x / rate;
+		const double d = samples[x * channels] - (a * sin(w) + b * cos(w));
+		err += d * d;
+	}
+
+	*amplitude = sqrt(a * a + b * b);
+	*residual = sqrt(err / n);
+}
+
+static BOOL test_resample_tone(UINT32 srcRate, UINT32 dstRate, UINT16 channels, double freq)
+{
+	BOOL rc = FALSE;
+	const AUDIO_FORMAT srcFormat = test_pcm_format(srcRate, channels);
+	const AUDIO_FORMAT dstFormat = test_pcm_format(dstRate, channels);
+	INT16* samples = test_tone(srcRate, channels, srcRate, freq, 0.0);
+	wStream* s1 = NULL;
+	wStream* s2 = NULL;
+
+	if (!samples)
+		goto fail;
+
+	/* 10ms packets and an odd chunk size must give the same result */
+	s1 = test_encode(&srcFormat, &dstFormat, samples, srcRate, srcRate / 100);
+	s2 = test_encode(&srcFormat, &dstFormat, samples, srcRate, 37);
+	if (!s1 || !s2)
+		goto fail;
+
+	if ((Stream_Length(s1) != Stream_Length(s2)) ||
+	    (memcmp(Stream_Buffer(s1), Stream_Buffer(s2), Stream_Length(s1)) != 0))
+	{
+		(void)fprintf(stderr, "[%s] %" PRIu32 " -> %" PRIu32 ": output depends on chunking\n",
+		              __func__, srcRate, dstRate);
+		goto fail;
+	}
+
+	const size_t frames = Stream_Length(s1) / dstFormat.nBlockAlign;
+	if ((frames > dstRate) || (frames < dstRate * 98 / 100))
+	{
+		(void)fprintf(stderr, "[%s] %" PRIu32 " -> %" PRIu32 ": got %" PRIuz " frames\n",
+		              __func__, srcRate, dstRate, frames);
+		goto fail;
+	}
+
+	const INT16* out = Stream_BufferAs(s1, INT16);
+	double amplitude = 0.0;
+	double residual = 0.0;
+	test_fit(out, channels, dstRate, dstRate / 10, dstRate * 9 / 10, freq, &amplitude, &residual);
+
+	(void)fprintf(stdout,
+	              "[%s] %" PRIu32 " -> %" PRIu32 " %uch %.0fHz: amplitude %.1f, residual %.2f\n",
+	              __func__, srcRate, dstRate, channels, freq, amplitude, residual);
+
+	if ((fabs(amplitude - TEST_AMPLITUDE) > TEST_AMPLITUDE * 0.01) ||
+	    (residual > TEST_AMPLITUDE * 0.003))
+		goto fail;
+
+	if (channels > 1)
+	{
+		for (size_t x = 0; x < frames; x++)
+		{
+			if (out[x * channels] != out[x * channels + 1])
+				goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(s1, TRUE);
+	Stream_Free(s2, TRUE);
+	free(samples);
+	return rc;
+}
+
+static BOOL test_resample_alias(void)
+{
+	BOOL rc = FALSE;
+	const AUDIO_FORMAT srcFormat = test_pcm_format(48000, 1);
+	const AUDIO_FORMAT dstFormat = test_pcm_format(16000, 1);
+	/* above the 8kHz output Nyquist frequency, must be filtered instead of folding to 4kHz */
+	INT16* samples = test_tone(48000, 1, 48000, 12000.0, 0.0);
+	wStream* s = NULL;
+
+	if (!samples)
+		goto fail;
+
+	s = test_encode(&srcFormat, &dstFormat, samples, 48000, 480);
+	if (!s)
+		goto fail;
+
+	const INT16* out = Stream_BufferAs(s, INT16);
+	const size_t frames = Stream_Length(s) / sizeof(INT16);
+	double err = 0.0;
+	for (size_t x = frames / 10; x < frames; x++)
+		err += (double)out[x] * out[x];
+	const double rms = sqrt(err / (double)(frames - frames / 10));
+
+	(void)fprintf(stdout, "[%s] 12kHz at 16kHz: rms %.2f\n", __func__, rms);
+	rc = rms < TEST_AMPLITUDE * 0.001;
+fail:
+	Stream_Free(s, TRUE);
+	free(samples);
+	return rc;
+}
+
+static BOOL test_resample_dc(void)
+{
+	BOOL rc = FALSE;
+	const AUDIO_FORMAT srcFormat = test_pcm_format(22050, 2);
+	const AUDIO_FORMAT dstFormat = test_pcm_format(48000, 2);
+	INT16* samples = test_tone(22050, 2, 22050, 0.0, -12345.0);
+	wStream* s = NULL;
+
+	if (!samples)
+		goto fail;
+
+	s = test_encode(&srcFormat, &dstFormat, samples, 22050, 220);
+	if (!s)
+		goto fail;
+
+	/* every filter phase has unity gain, a constant passes unchanged once the history filled */
+	const INT16* out = Stream_BufferAs(s, INT16);
+	const size_t count = Stream_Length(s) / sizeof(INT16);
+	for (size_t x = count / 2; x < count; x++)
+	{
+		if (out[x] != -12345)
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(s, TRUE);
+	free(samples);
+	return rc;
+}
+
+static BOOL test_channel_mix(size_t frames)
+{
+	BOOL rc = FALSE;
+	const AUDIO_FORMAT mono = test_pcm_format(44100, 1);
+	const AUDIO_FORMAT stereo = test_pcm_format(44100, 2);
+	INT16* src = calloc(frames * 2, sizeof(INT16));
+	wStream* up = NULL;
+	wStream* down = NULL;
+
+	if (!src)
+		goto fail;
+
+	for (size_t x = 0; x < frames * 2; x++)
+		src[x] = (INT16)((x % 2) ? INT16_MIN + (INT16)x : INT16_MAX - (INT16)(3 * x));
+
+	up = test_encode(&mono, &stereo, src, frames, frames);
+	down = test_encode(&stereo, &mono, src, frames, frames);
+	if (!up || !down)
+		goto fail;
+
+	if ((Stream_Length(up) != frames * 4) || (Stream_Length(down) != frames * 2))
+		goto fail;
+
+	const INT16* pup = Stream_BufferAs(up, INT16);
+	const INT16* pdown = Stream_BufferAs(down, INT16);
+	for (size_t x = 0; x < frames; x++)
+	{
+		if ((pup[2 * x] != src[x]) || (pup[2 * x + 1] != src[x]))
+			goto fail;
+
+		const INT32 avg = ((INT32)src[2 * x] + src[2 * x + 1]) >> 1;
+		if (pdown[x] != avg)
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		(void)fprintf(stderr, "[%s] %" PRIuz " frames failed\n", __func__, frames);
+	Stream_Free(up, TRUE);
+	Stream_Free(down, TRUE);
+	free(src);
+	return rc;
+}
+
+int TestFreeRDPCodecDsp(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	const struct
+	{
+		UINT32 src;
+		UINT32 dst;
+		UINT16 channels;
+	} rates[] = { { 44100, 48000, 2 }, { 48000, 44100, 2 }, { 22050, 48000, 2 },
+		          { 48000, 16000, 1 }, { 16000, 48000, 1 }, { 44100, 22050, 2 },
+		          { 11025, 44100, 1 }, { 8000, 44100, 1 } };
+
+	for (size_t x = 0; x < ARRAYSIZE(rates); x++)
+	{
+		if (!test_resample_tone(rates[x].src, rates[x].dst, rates[x].channels, 1000.0))
+			return -1;
+	}
+
+	if (!test_resample_alias())
+		return -1;
+
+	if (!test_resample_dc())
+		return -1;
+
+	if (!test_channel_mix(1) || !test_channel_mix(8) || !test_channel_mix(1001))
+		return -1;
+
+	return 0;
+}
@@ -1774,6 +1774,9 @@ UINT32 freerdp_settings_get_uint32(WINPR_ATTR_UNUSED const rdpSettings* settings
 		case FreeRDP_GlyphSupportLevel:
 			return settings->GlyphSupportLevel;
 
+		case FreeRDP_InputCoalescingInterval:
+			return settings->InputCoalescingInterval;
+
 		case FreeRDP_JpegCodecId:
 			return settings->JpegCodecId;
 
@@ -2229,6 +2232,10 @@ BOOL freerdp_settings_set_uint32(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->GlyphSupportLevel = cnv.c;
 			break;
 
+		case FreeRDP_InputCoalescingInterval:
+			settings->InputCoalescingInterval = cnv.c;
+			break;
+
 		case FreeRDP_JpegCodecId:
 			settings->JpegCodecId = cnv.c;
 			break;
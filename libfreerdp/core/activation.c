@@ -26,6 +26,7 @@
 
 #include "activation.h"
 #include "display.h"
+#include "../cache/cache.h"
 
 #define TAG FREERDP_TAG("core.activation")
 
@@ -336,14 +337,52 @@ error:
 	return 0;
 }
 
+/* On a reconnect the bitmap cache still holds the bitmaps of the last connection */
+static UINT16 rdp_load_retained_key_list(rdpRdp* rdp, UINT64** pKeyList, UINT16 keyMaxFrag,
+                                         UINT16* counts, size_t cellCount)
+{
+	WINPR_ASSERT(rdp);
+	WINPR_ASSERT(pKeyList);
+
+	*pKeyList = NULL;
+
+	rdpContext* context = rdp->context;
+	if (!context || !context->cache || !context->cache->bitmap)
+		return 0;
+
+	if (!freerdp_settings_get_bool(rdp->settings, FreeRDP_AutoReconnectionEnabled))
+		return 0;
+
+	UINT64* keyList = (UINT64*)calloc(keyMaxFrag, sizeof(UINT64));
+	if (!keyList)
+		return 0;
+
+	const size_t count = bitmap_cache_retain_keys(context->cache->bitmap, keyList, keyMaxFrag,
+	                                              counts, cellCount);
+	if (count == 0)
+	{
+		free(keyList);
+		return 0;
+	}
+
+	*pKeyList = keyList;
+	return (UINT16)count;
+}
+
 BOOL rdp_send_client_persistent_key_list_pdu(rdpRdp* rdp)
 {
 	UINT16 keyMaxFrag = 2042;
 	UINT64* keyList = NULL;
+	UINT16 retained[5] = { 0 };
 	RDP_BITMAP_PERSISTENT_INFO info = { 0 };
 	WINPR_ASSERT(rdp);
 	rdpSettings* settings = rdp->settings;
-	UINT16 keyCount = rdp_load_persistent_key_list(rdp, &keyList);
+	UINT16 keyCount =
+	    rdp_load_retained_key_list(rdp, &keyList, keyMaxFrag, retained, ARRAYSIZE(retained));
+	const BOOL reconnect = (keyCount > 0);
+
+	if (!reconnect)
+		keyCount = rdp_load_persistent_key_list(rdp, &keyList);
 
 	WLog_DBG(TAG, "Persistent Key List: TotalKeyCount: %" PRIu16 " MaxKeyFrag: %" PRIu16, keyCount,
 	         keyMaxFrag);
@@ -372,15 +411,27 @@ BOOL rdp_send_client_persistent_key_list_pdu(rdpRdp* rdp)
 	WINPR_ASSERT(settings->BitmapCacheV2CellInfo[4].numEntries <= UINT16_MAX);
 	info.totalEntriesCache4 = (UINT16)settings->BitmapCacheV2CellInfo[4].numEntries;
 
-	info.numEntriesCache0 = MIN(keyCount, info.totalEntriesCache0);
-	keyCount -= info.numEntriesCache0;
-	info.numEntriesCache1 = MIN(keyCount, info.totalEntriesCache1);
-	keyCount -= info.numEntriesCache1;
-	info.numEntriesCache2 = MIN(keyCount, info.totalEntriesCache2);
-	keyCount -= info.numEntriesCache2;
-	info.numEntriesCache3 = MIN(keyCount, info.totalEntriesCache3);
-	keyCount -= info.numEntriesCache3;
-	info.numEntriesCache4 = MIN(keyCount, info.totalEntriesCache4);
+	if (reconnect)
+	{
+		/* the retained bitmaps are at the start of their cells already */
+		info.numEntriesCache0 = MIN(retained[0], info.totalEntriesCache0);
+		info.numEntriesCache1 = MIN(retained[1], info.totalEntriesCache1);
+		info.numEntriesCache2 = MIN(retained[2], info.totalEntriesCache2);
+		info.numEntriesCache3 = MIN(retained[3], info.totalEntriesCache3);
+		info.numEntriesCache4 = MIN(retained[4], info.totalEntriesCache4);
+	}
+	else
+	{
+		info.numEntriesCache0 = MIN(keyCount, info.totalEntriesCache0);
+		keyCount -= info.numEntriesCache0;
+		info.numEntriesCache1 = MIN(keyCount, info.totalEntriesCache1);
+		keyCount -= info.numEntriesCache1;
+		info.numEntriesCache2 = MIN(keyCount, info.totalEntriesCache2);
+		keyCount -= info.numEntriesCache2;
+		info.numEntriesCache3 = MIN(keyCount, info.totalEntriesCache3);
+		keyCount -= info.numEntriesCache3;
+		info.numEntriesCache4 = MIN(keyCount, info.totalEntriesCache4);
+	}
 
 	info.totalEntriesCache0 = info.numEntriesCache0;
 	info.totalEntriesCache1 = info.numEntriesCache1;
@@ -136,6 +136,8 @@ static BOOL CALLBACK init_channel_handles_table(WINPR_ATTR_UNUSED PINIT_ONCE onc
                                                 WINPR_ATTR_UNUSED PVOID* context)
 {
 	g_ChannelHandles = HashTable_New(TRUE);
+	if (g_ChannelHandles)
+		(void)HashTable_SetReadMostly(g_ChannelHandles, TRUE);
 	return TRUE;
 }
 
@@ -404,6 +404,14 @@ DWORD freerdp_get_event_handles(rdpContext* context, HANDLE* events, DWORD count
 	else
 		return 0;
 
+	const HANDLE input = input_get_event_handle(context->input);
+	if (input)
+	{
+		if (nCount >= count)
+			return 0;
+		events[nCount++] = input;
+	}
+
 	const SSIZE_T rc = freerdp_client_channel_get_registered_event_handles(
 	    context->channels, &events[nCount], count - nCount);
 	if (rc < 0)
@@ -487,6 +495,17 @@ BOOL freerdp_check_event_handles(rdpContext* context)
 		return FALSE;
 	}
 
+	status = input_check_event_handle(context->input);
+
+	if (!status)
+	{
+		if (freerdp_get_last_error(context) == FREERDP_ERROR_SUCCESS)
+			WLog_Print(context->log, WLOG_ERROR, "input_check_event_handle() failed - %" PRIi32 "",
+			           status);
+
+		return FALSE;
+	}
+
 	status = freerdp_prevent_session_lock(context);
 
 	return status;
@@ -19,7 +19,10 @@
 
 #include <freerdp/config.h>
 
+#include <stddef.h>
+
 #include <winpr/crt.h>
+#include <winpr/assert.h>
 
 #include <freerdp/graphics.h>
 
@@ -110,6 +113,11 @@ void graphics_register_pointer(rdpGraphics* graphics, const rdpPointer* pointer)
 
 /* Glyph Class */
 
+/* DrawRun took its slot from paddingA, the fields after it must not move */
+WINPR_STATIC_ASSERT((sizeof(void*) != 8) || (offsetof(rdpGlyph, x) == 92));
+WINPR_STATIC_ASSERT((sizeof(void*) != 8) || (offsetof(rdpGlyph, aj) == 112));
+WINPR_STATIC_ASSERT((sizeof(void*) != 8) || (sizeof(rdpGlyph) == 160));
+
 rdpGlyph* Glyph_Alloc(rdpContext* context, INT32 x, INT32 y, UINT32 cx, UINT32 cy, UINT32 cb,
                       const BYTE* aj)
 {
@@ -161,7 +169,14 @@ void graphics_register_glyph(rdpGraphics* graphics, const rdpGlyph* glyph)
 	WINPR_ASSERT(graphics->Glyph_Prototype);
 	WINPR_ASSERT(glyph);
 
+	/* A glyph class copied from the registered one and given its own Draw keeps the DrawRun
+	 * of the previous class, which knows nothing about the new glyphs. */
+	const rdpGlyph* prev = graphics->Glyph_Prototype;
+	const BOOL stale = (glyph->DrawRun == prev->DrawRun) && (glyph->Draw != prev->Draw);
+
 	*graphics->Glyph_Prototype = *glyph;
+	if (stale)
+		graphics->Glyph_Prototype->DrawRun = NULL;
 }
 
 /* Graphics Module */
@@ -22,6 +22,8 @@
 
 #include <winpr/crt.h>
 #include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/input.h>
 #include <freerdp/log.h>
@@ -40,6 +42,9 @@
 #define INPUT_EVENT_MOUSEX 0x8002
 #define INPUT_EVENT_MOUSEREL 0x8004
 
+/* [MS-RDPBCGR] 2.2.8.1.2 a fast-path input PDU without the numEvents field holds 15 events */
+#define INPUT_BATCH_MAX_EVENTS 15
+
 static void rdp_write_client_input_pdu_header(wStream* s, UINT16 number)
 {
 	WINPR_ASSERT(s);
@@ -334,74 +339,249 @@ static BOOL input_send_keyboard_pause_event(rdpInput* input)
 	                                 RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
 }
 
-static BOOL input_send_fastpath_synchronize_event(rdpInput* input, UINT32 flags)
+/* Send all fast-path events of the batch in one PDU, called with batchLock held */
+static BOOL input_batch_send(rdpInput* input)
 {
 	UINT16 sec_flags = 0;
-	wStream* s = NULL;
-	rdpRdp* rdp = NULL;
+	rdp_input_internal* in = input_cast(input);
 
-	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
+	if (in->batchCount == 0)
+		return TRUE;
+
+	rdpRdp* rdp = input->context->rdp;
 	WINPR_ASSERT(rdp);
 
-	if (!input_ensure_client_running(input))
+	const size_t length = Stream_GetPosition(in->batch);
+	const size_t count = in->batchCount;
+	Stream_SetPosition(in->batch, 0);
+	in->batchCount = 0;
+
+	wStream* s = fastpath_input_pdu_init_header(rdp->fastpath, &sec_flags);
+
+	if (!s)
 		return FALSE;
 
-	/* The FastPath Synchronization eventFlags has identical values as SlowPath */
-	s = fastpath_input_pdu_init(rdp->fastpath, (BYTE)flags, FASTPATH_INPUT_EVENT_SYNC, &sec_flags);
+	if (!Stream_EnsureRemainingCapacity(s, length))
+	{
+		Stream_Release(s);
+		return FALSE;
+	}
+
+	Stream_Write(s, Stream_Buffer(in->batch), length);
+	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, count, sec_flags);
+}
+
+/* Append the header of a fast-path event to the batch, called with batchLock held */
+static wStream* input_batch_write_header(rdpInput* input, BYTE eventFlags, BYTE eventCode)
+{
+	rdp_input_internal* in = input_cast(input);
+
+	WINPR_ASSERT(eventCode < 8);
+	WINPR_ASSERT(eventFlags < 0x20);
+
+	if (in->batchCount >= INPUT_BATCH_MAX_EVENTS)
+	{
+		if (!input_batch_send(input))
+			return NULL;
+	}
+
+	/* the largest fast-path event has 6 bytes following the header */
+	if (!Stream_EnsureRemainingCapacity(in->batch, 7))
+		return NULL;
+
+	Stream_Write_UINT8(in->batch, (UINT8)(eventFlags | (eventCode << 5))); /* eventHeader */
+	in->batchCount++;
+	return in->batch;
+}
+
+/* Append the coalesced mouse motion to the batch, called with batchLock held */
+static BOOL input_batch_write_motion(rdpInput* input)
+{
+	rdp_input_internal* in = input_cast(input);
+
+	if (in->motionEvent == 0)
+		return TRUE;
+
+	wStream* s = input_batch_write_header(input, 0, in->motionEvent);
 
 	if (!s)
 		return FALSE;
 
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	Stream_Write_UINT16(s, PTR_FLAGS_MOVE); /* pointerFlags (2 bytes) */
+	if (in->motionEvent == TS_FP_RELPOINTER_EVENT)
+	{
+		Stream_Write_INT16(s, (INT16)in->motionX); /* xDelta (2 bytes) */
+		Stream_Write_INT16(s, (INT16)in->motionY); /* yDelta (2 bytes) */
+	}
+	else
+	{
+		Stream_Write_UINT16(s, (UINT16)in->motionX); /* xPos (2 bytes) */
+		Stream_Write_UINT16(s, (UINT16)in->motionY); /* yPos (2 bytes) */
+	}
+
+	in->motionEvent = 0;
+	return TRUE;
+}
+
+/* Append a fast-path event to the batch behind the mouse motion that happened before it,
+ * called with batchLock held. Everything but mouse motion is sent right away. */
+#if !defined(BUILD_TESTING_INTERNAL)
+static
+#endif
+    wStream*
+    input_batch_event(rdpInput* input, BYTE eventFlags, BYTE eventCode)
+{
+	if (!input_batch_write_motion(input))
+		return NULL;
+
+	return input_batch_write_header(input, eventFlags, eventCode);
+}
+
+/* Coalesce pure mouse motion for FreeRDP_InputCoalescingInterval milliseconds. Absolute
+ * positions replace each other, relative ones are summed up. */
+static BOOL input_batch_motion(rdpInput* input, BYTE eventCode, INT32 x, INT32 y)
+{
+	BOOL rc = FALSE;
+	rdp_input_internal* in = input_cast(input);
+
+	WINPR_ASSERT(input->context);
+
+	const UINT32 interval =
+	    freerdp_settings_get_uint32(input->context->settings, FreeRDP_InputCoalescingInterval);
+	const UINT64 now = GetTickCount64();
+
+	EnterCriticalSection(&in->batchLock);
+
+	if ((in->motionEvent != 0) && (in->motionEvent != eventCode))
+	{
+		if (!input_batch_write_motion(input))
+			goto fail;
+	}
+
+	if ((in->motionEvent == TS_FP_RELPOINTER_EVENT) &&
+	    ((in->motionX + x < INT16_MIN) || (in->motionX + x > INT16_MAX) ||
+	     (in->motionY + y < INT16_MIN) || (in->motionY + y > INT16_MAX)))
+	{
+		if (!input_batch_write_motion(input))
+			goto fail;
+	}
+
+	if (in->motionEvent == 0)
+	{
+		in->motionEvent = eventCode;
+		in->motionStart = now;
+		in->motionX = x;
+		in->motionY = y;
+
+		if (interval > 0)
+		{
+			LARGE_INTEGER due = { 0 };
+			due.QuadPart = -10000LL * interval;
+			(void)SetWaitableTimer(in->motionTimer, &due, 0, NULL, NULL, FALSE);
+		}
+	}
+	else if (eventCode == TS_FP_RELPOINTER_EVENT)
+	{
+		in->motionX += x;
+		in->motionY += y;
+	}
+	else
+	{
+		in->motionX = x;
+		in->motionY = y;
+	}
+
+	if (now - in->motionStart >= interval)
+	{
+		if (!input_batch_write_motion(input))
+			goto fail;
+	}
+
+	rc = input_batch_send(input);
+fail:
+	LeaveCriticalSection(&in->batchLock);
+	return rc;
+}
+
+/* Lock the batch and append the header of an event to it. The returned stream receives the
+ * event data and must be passed to input_batch_end_event, even if it is NULL. */
+#if !defined(BUILD_TESTING_INTERNAL)
+static
+#endif
+    wStream*
+    input_batch_begin_event(rdpInput* input, BYTE eventFlags, BYTE eventCode)
+{
+	rdp_input_internal* in = input_cast(input);
+
+	EnterCriticalSection(&in->batchLock);
+	return input_batch_event(input, eventFlags, eventCode);
+}
+
+/* Send the batch the event was appended to and unlock it */
+#if !defined(BUILD_TESTING_INTERNAL)
+static
+#endif
+    BOOL
+    input_batch_end_event(rdpInput* input, wStream* s)
+{
+	rdp_input_internal* in = input_cast(input);
+
+	BOOL rc = FALSE;
+	if (s)
+		rc = input_batch_send(input);
+	else
+	{
+		/* drop the events of a sequence that could not be completed */
+		Stream_SetPosition(in->batch, 0);
+		in->batchCount = 0;
+	}
+	LeaveCriticalSection(&in->batchLock);
+	return rc;
+}
+
+static BOOL input_send_fastpath_synchronize_event(rdpInput* input, UINT32 flags)
+{
+	WINPR_ASSERT(input);
+	WINPR_ASSERT(input->context);
+
+	if (!input_ensure_client_running(input))
+		return FALSE;
+
+	/* The FastPath Synchronization eventFlags has identical values as SlowPath */
+	wStream* s = input_batch_begin_event(input, (BYTE)flags, FASTPATH_INPUT_EVENT_SYNC);
+	return input_batch_end_event(input, s);
 }
 
 static BOOL input_send_fastpath_keyboard_event(rdpInput* input, UINT16 flags, UINT8 code)
 {
-	UINT16 sec_flags = 0;
-	wStream* s = NULL;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
 	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
 	eventFlags |= (flags & KBD_FLAGS_EXTENDED) ? FASTPATH_INPUT_KBDFLAGS_EXTENDED : 0;
 	eventFlags |= (flags & KBD_FLAGS_EXTENDED1) ? FASTPATH_INPUT_KBDFLAGS_PREFIX_E1 : 0;
-	s = fastpath_input_pdu_init(rdp->fastpath, eventFlags, FASTPATH_INPUT_EVENT_SCANCODE,
-	                            &sec_flags);
+	wStream* s = input_batch_begin_event(input, eventFlags, FASTPATH_INPUT_EVENT_SCANCODE);
 
-	if (!s)
-		return FALSE;
-
-	WINPR_ASSERT(code <= UINT8_MAX);
-	Stream_Write_UINT8(s, code); /* keyCode (1 byte) */
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	if (s)
+		Stream_Write_UINT8(s, code); /* keyCode (1 byte) */
+	return input_batch_end_event(input, s);
 }
 
 static BOOL input_send_fastpath_unicode_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code)
 {
-	UINT16 sec_flags = 0;
-	wStream* s = NULL;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -412,29 +592,19 @@ static BOOL input_send_fastpath_unicode_keyboard_event(rdpInput* input, UINT16 f
 	}
 
 	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
-	s = fastpath_input_pdu_init(rdp->fastpath, eventFlags, FASTPATH_INPUT_EVENT_UNICODE,
-	                            &sec_flags);
-
-	if (!s)
-		return FALSE;
+	wStream* s = input_batch_begin_event(input, eventFlags, FASTPATH_INPUT_EVENT_UNICODE);
 
-	Stream_Write_UINT16(s, code); /* unicodeCode (2 bytes) */
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	if (s)
+		Stream_Write_UINT16(s, code); /* unicodeCode (2 bytes) */
+	return input_batch_end_event(input, s);
 }
 
 static BOOL input_send_fastpath_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
 {
-	UINT16 sec_flags = 0;
-	wStream* s = NULL;
-	rdpRdp* rdp = NULL;
-
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -450,28 +620,22 @@ static BOOL input_send_fastpath_mouse_event(rdpInput* input, UINT16 flags, UINT1
 		}
 	}
 
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSE, &sec_flags);
+	if (flags == PTR_FLAGS_MOVE)
+		return input_batch_motion(input, FASTPATH_INPUT_EVENT_MOUSE, x, y);
 
-	if (!s)
-		return FALSE;
+	wStream* s = input_batch_begin_event(input, 0, FASTPATH_INPUT_EVENT_MOUSE);
 
-	input_write_mouse_event(s, flags, x, y);
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	if (s)
+		input_write_mouse_event(s, flags, x, y);
+	return input_batch_end_event(input, s);
 }
 
 static BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 flags, UINT16 x,
                                                      UINT16 y)
 {
-	UINT16 sec_flags = 0;
-	wStream* s = NULL;
-	rdpRdp* rdp = NULL;
-
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -484,29 +648,20 @@ static BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 fla
 		return TRUE;
 	}
 
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSEX, &sec_flags);
-
-	if (!s)
-		return FALSE;
+	wStream* s = input_batch_begin_event(input, 0, FASTPATH_INPUT_EVENT_MOUSEX);
 
-	input_write_extended_mouse_event(s, flags, x, y);
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	if (s)
+		input_write_extended_mouse_event(s, flags, x, y);
+	return input_batch_end_event(input, s);
 }
 
 static BOOL input_send_fastpath_relmouse_event(rdpInput* input, UINT16 flags, INT16 xDelta,
                                                INT16 yDelta)
 {
-	UINT16 sec_flags = 0;
-	wStream* s = NULL;
-	rdpRdp* rdp = NULL;
-
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -516,15 +671,18 @@ static BOOL input_send_fastpath_relmouse_event(rdpInput* input, UINT16 flags, IN
 		return FALSE;
 	}
 
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, TS_FP_RELPOINTER_EVENT, &sec_flags);
+	if (flags == PTR_FLAGS_MOVE)
+		return input_batch_motion(input, TS_FP_RELPOINTER_EVENT, xDelta, yDelta);
 
-	if (!s)
-		return FALSE;
+	wStream* s = input_batch_begin_event(input, 0, TS_FP_RELPOINTER_EVENT);
 
-	Stream_Write_UINT16(s, flags); /* pointerFlags (2 bytes) */
-	Stream_Write_INT16(s, xDelta); /* xDelta (2 bytes) */
-	Stream_Write_INT16(s, yDelta); /* yDelta (2 bytes) */
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	if (s)
+	{
+		Stream_Write_UINT16(s, flags); /* pointerFlags (2 bytes) */
+		Stream_Write_INT16(s, xDelta); /* xDelta (2 bytes) */
+		Stream_Write_INT16(s, yDelta); /* yDelta (2 bytes) */
+	}
+	return input_batch_end_event(input, s);
 }
 
 static BOOL input_send_fastpath_qoe_event(rdpInput* input, UINT32 timestampMS)
@@ -533,9 +691,6 @@ static BOOL input_send_fastpath_qoe_event(rdpInput* input, UINT32 timestampMS)
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdpRdp* rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -545,55 +700,39 @@ static BOOL input_send_fastpath_qoe_event(rdpInput* input, UINT32 timestampMS)
 		return FALSE;
 	}
 
-	UINT16 sec_flags = 0;
-	wStream* s = fastpath_input_pdu_init(rdp->fastpath, 0, TS_FP_QOETIMESTAMP_EVENT, &sec_flags);
-
-	if (!s)
-		return FALSE;
-
-	if (!Stream_EnsureRemainingCapacity(s, 4))
-	{
-		Stream_Free(s, TRUE);
-		return FALSE;
-	}
+	wStream* s = input_batch_begin_event(input, 0, TS_FP_QOETIMESTAMP_EVENT);
 
-	Stream_Write_UINT32(s, timestampMS);
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	if (s)
+		Stream_Write_UINT32(s, timestampMS); /* timestamp (4 bytes) */
+	return input_batch_end_event(input, s);
 }
 
 static BOOL input_send_fastpath_focus_in_event(rdpInput* input, UINT16 toggleStates)
 {
-	UINT16 sec_flags = 0;
-	wStream* s = NULL;
-	BYTE eventFlags = 0;
-	rdpRdp* rdp = NULL;
-
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
-	s = fastpath_input_pdu_init_header(rdp->fastpath, &sec_flags);
-
+	/* send a tab up like mstsc.exe */
+	wStream* s = input_batch_begin_event(input, FASTPATH_INPUT_KBDFLAGS_RELEASE,
+	                                     FASTPATH_INPUT_EVENT_SCANCODE);
 	if (!s)
-		return FALSE;
+		goto fail;
+	Stream_Write_UINT8(s, 0x0f); /* keyCode (1 byte) */
 
-	/* send a tab up like mstsc.exe */
-	eventFlags = FASTPATH_INPUT_KBDFLAGS_RELEASE | FASTPATH_INPUT_EVENT_SCANCODE << 5;
-	Stream_Write_UINT8(s, eventFlags); /* Key Release event (1 byte) */
-	Stream_Write_UINT8(s, 0x0f);       /* keyCode (1 byte) */
 	/* send the toggle key states */
-	eventFlags = (toggleStates & 0x1F) | FASTPATH_INPUT_EVENT_SYNC << 5;
-	Stream_Write_UINT8(s, eventFlags); /* toggle state (1 byte) */
+	s = input_batch_event(input, (toggleStates & 0x1F), FASTPATH_INPUT_EVENT_SYNC);
+	if (!s)
+		goto fail;
+
 	/* send another tab up like mstsc.exe */
-	eventFlags = FASTPATH_INPUT_KBDFLAGS_RELEASE | FASTPATH_INPUT_EVENT_SCANCODE << 5;
-	Stream_Write_UINT8(s, eventFlags); /* Key Release event (1 byte) */
-	Stream_Write_UINT8(s, 0x0f);       /* keyCode (1 byte) */
-	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, 3, sec_flags);
+	s = input_batch_event(input, FASTPATH_INPUT_KBDFLAGS_RELEASE, FASTPATH_INPUT_EVENT_SCANCODE);
+	if (s)
+		Stream_Write_UINT8(s, 0x0f); /* keyCode (1 byte) */
+fail:
+	return input_batch_end_event(input, s);
 }
 
 static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
@@ -602,39 +741,40 @@ static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
 	 * and pause-up sent nothing.  However, reverse engineering mstsc shows
 	 * it sending the following sequence:
 	 */
-	UINT16 sec_flags = 0;
-	wStream* s = NULL;
-	const BYTE keyDownEvent = FASTPATH_INPUT_EVENT_SCANCODE << 5;
-	const BYTE keyUpEvent = (FASTPATH_INPUT_EVENT_SCANCODE << 5) | FASTPATH_INPUT_KBDFLAGS_RELEASE;
-	rdpRdp* rdp = NULL;
+	const BYTE keyUpFlags = FASTPATH_INPUT_KBDFLAGS_RELEASE;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
-	s = fastpath_input_pdu_init_header(rdp->fastpath, &sec_flags);
-
-	if (!s)
-		return FALSE;
-
 	/* Control down (0x1D) */
-	Stream_Write_UINT8(s, keyDownEvent | FASTPATH_INPUT_KBDFLAGS_PREFIX_E1);
+	wStream* s = input_batch_begin_event(input, FASTPATH_INPUT_KBDFLAGS_PREFIX_E1,
+	                                     FASTPATH_INPUT_EVENT_SCANCODE);
+	if (!s)
+		goto fail;
 	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_LCONTROL));
+
 	/* Numlock down (0x45) */
-	Stream_Write_UINT8(s, keyDownEvent);
+	s = input_batch_event(input, 0, FASTPATH_INPUT_EVENT_SCANCODE);
+	if (!s)
+		goto fail;
 	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
+
 	/* Control up (0x1D) */
-	Stream_Write_UINT8(s, keyUpEvent | FASTPATH_INPUT_KBDFLAGS_PREFIX_E1);
+	s = input_batch_event(input, keyUpFlags | FASTPATH_INPUT_KBDFLAGS_PREFIX_E1,
+	                      FASTPATH_INPUT_EVENT_SCANCODE);
+	if (!s)
+		goto fail;
 	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_LCONTROL));
-	/* Numlock down (0x45) */
-	Stream_Write_UINT8(s, keyUpEvent);
-	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
-	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, 4, sec_flags);
+
+	/* Numlock up (0x45) */
+	s = input_batch_event(input, keyUpFlags, FASTPATH_INPUT_EVENT_SCANCODE);
+	if (s)
+		Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
+fail:
+	return input_batch_end_event(input, s);
 }
 
 static BOOL input_recv_sync_event(rdpInput* input, wStream* s)
@@ -924,6 +1064,16 @@ static BOOL input_update_last_event(rdpInput* input, BOOL mouse, UINT16 x, UINT1
 	return TRUE;
 }
 
+/* Start an input to display latency measurement, the next frame is accounted to this event */
+static void input_record_latency(rdpInput* input)
+{
+	WINPR_ASSERT(input);
+	WINPR_ASSERT(input->context);
+
+	freerdp_latency_stats_input(freerdp_get_latency_stats(input->context),
+	                            winpr_GetTickCount64NS());
+}
+
 BOOL freerdp_input_send_synchronize_event(rdpInput* input, UINT32 flags)
 {
 	if (!input || !input->context)
@@ -945,6 +1095,7 @@ BOOL freerdp_input_send_keyboard_event(rdpInput* input, UINT16 flags, UINT8 code
 
 	input_update_last_event(input, FALSE, 0, 0);
 
+	input_record_latency(input);
 	return IFCALLRESULT(TRUE, input->KeyboardEvent, input, flags, code);
 }
 
@@ -970,6 +1121,7 @@ BOOL freerdp_input_send_unicode_keyboard_event(rdpInput* input, UINT16 flags, UI
 
 	input_update_last_event(input, FALSE, 0, 0);
 
+	input_record_latency(input);
 	return IFCALLRESULT(TRUE, input->UnicodeKeyboardEvent, input, flags, code);
 }
 
@@ -985,6 +1137,7 @@ BOOL freerdp_input_send_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UIN
 	    input, flags & (PTR_FLAGS_MOVE | PTR_FLAGS_BUTTON1 | PTR_FLAGS_BUTTON2 | PTR_FLAGS_BUTTON3),
 	    x, y);
 
+	input_record_latency(input);
 	return IFCALLRESULT(TRUE, input->MouseEvent, input, flags, x, y);
 }
 
@@ -996,6 +1149,7 @@ BOOL freerdp_input_send_rel_mouse_event(rdpInput* input, UINT16 flags, INT16 xDe
 	if (freerdp_settings_get_bool(input->context->settings, FreeRDP_SuspendInput))
 		return TRUE;
 
+	input_record_latency(input);
 	return IFCALLRESULT(TRUE, input->RelMouseEvent, input, flags, xDelta, yDelta);
 }
 
@@ -1017,6 +1171,7 @@ BOOL freerdp_input_send_extended_mouse_event(rdpInput* input, UINT16 flags, UINT
 
 	input_update_last_event(input, TRUE, x, y);
 
+	input_record_latency(input);
 	return IFCALLRESULT(TRUE, input->ExtendedMouseEvent, input, flags, x, y);
 }
 
@@ -1039,6 +1194,7 @@ BOOL freerdp_input_send_keyboard_pause_event(rdpInput* input)
 	if (freerdp_settings_get_bool(input->context->settings, FreeRDP_SuspendInput))
 		return TRUE;
 
+	input_record_latency(input);
 	return IFCALLRESULT(TRUE, input->KeyboardPauseEvent, input);
 }
 
@@ -1050,6 +1206,53 @@ int input_process_events(rdpInput* input)
 	return input_message_queue_process_pending_messages(input);
 }
 
+HANDLE input_get_event_handle(rdpInput* input)
+{
+	if (!input || !input->context)
+		return NULL;
+
+	if (freerdp_settings_get_uint32(input->context->settings, FreeRDP_InputCoalescingInterval) ==
+	    0)
+		return NULL;
+
+	rdp_input_internal* in = input_cast(input);
+	return in->motionTimer;
+}
+
+/* Send the coalesced mouse motion once the coalescing interval passed. When the timer
+ * fired early or another handle woke us up it is armed again for the remaining time, so
+ * the last motion is never left pending. */
+BOOL input_check_event_handle(rdpInput* input)
+{
+	BOOL rc = TRUE;
+
+	if (!input || !input->context)
+		return FALSE;
+
+	rdp_input_internal* in = input_cast(input);
+	const UINT32 interval =
+	    freerdp_settings_get_uint32(input->context->settings, FreeRDP_InputCoalescingInterval);
+
+	EnterCriticalSection(&in->batchLock);
+	if (in->motionEvent != 0)
+	{
+		const UINT64 elapsed = GetTickCount64() - in->motionStart;
+
+		if (freerdp_shall_disconnect_context(input->context))
+			in->motionEvent = 0;
+		else if (elapsed >= interval)
+			rc = input_batch_write_motion(input) && input_batch_send(input);
+		else
+		{
+			LARGE_INTEGER due = { 0 };
+			due.QuadPart = -10000LL * (LONGLONG)(interval - elapsed);
+			(void)SetWaitableTimer(in->motionTimer, &due, 0, NULL, NULL, FALSE);
+		}
+	}
+	LeaveCriticalSection(&in->batchLock);
+	return rc;
+}
+
 static void input_free_queued_message(void* obj)
 {
 	wMessage* msg = (wMessage*)obj;
@@ -1067,11 +1270,14 @@ rdpInput* input_new(rdpRdp* rdp)
 		return NULL;
 
 	input->common.context = rdp->context;
+	InitializeCriticalSection(&input->batchLock);
 	input->queue = MessageQueue_New(&cb);
+	input->batch = Stream_New(NULL, 7 * INPUT_BATCH_MAX_EVENTS);
+	input->motionTimer = CreateWaitableTimerA(NULL, FALSE, NULL);
 
-	if (!input->queue)
+	if (!input->queue || !input->batch || !input->motionTimer)
 	{
-		free(input);
+		input_free(&input->common);
 		return NULL;
 	}
 
@@ -1085,6 +1291,10 @@ void input_free(rdpInput* input)
 		rdp_input_internal* in = input_cast(input);
 
 		MessageQueue_Free(in->queue);
+		Stream_Free(in->batch, TRUE);
+		if (in->motionTimer)
+			(void)CloseHandle(in->motionTimer);
+		DeleteCriticalSection(&in->batchLock);
 		free(in);
 	}
 }
@@ -29,6 +29,7 @@
 #include <freerdp/api.h>
 
 #include <winpr/stream.h>
+#include <winpr/synch.h>
 
 typedef struct
 {
@@ -41,6 +42,18 @@ typedef struct
 	UINT64 lastInputTimestamp;
 	UINT16 lastX;
 	UINT16 lastY;
+
+	/* fast-path events waiting to be sent in one PDU, guarded by batchLock */
+	CRITICAL_SECTION batchLock;
+	wStream* batch;
+	size_t batchCount;
+
+	/* the coalesced mouse motion, not yet written to the batch */
+	HANDLE motionTimer;
+	BYTE motionEvent;
+	UINT64 motionStart;
+	INT32 motionX;
+	INT32 motionY;
 } rdp_input_internal;
 
 static INLINE rdp_input_internal* input_cast(rdpInput* input)
@@ -58,8 +71,16 @@ static INLINE rdp_input_internal* input_cast(rdpInput* input)
 FREERDP_LOCAL BOOL input_recv(rdpInput* input, wStream* s);
 
 FREERDP_LOCAL int input_process_events(rdpInput* input);
+FREERDP_LOCAL HANDLE input_get_event_handle(rdpInput* input);
+FREERDP_LOCAL BOOL input_check_event_handle(rdpInput* input);
 FREERDP_LOCAL BOOL input_register_client_callbacks(rdpInput* input);
 
+#if defined(BUILD_TESTING_INTERNAL)
+FREERDP_LOCAL wStream* input_batch_begin_event(rdpInput* input, BYTE eventFlags, BYTE eventCode);
+FREERDP_LOCAL wStream* input_batch_event(rdpInput* input, BYTE eventFlags, BYTE eventCode);
+FREERDP_LOCAL BOOL input_batch_end_event(rdpInput* input, wStream* s);
+#endif
+
 FREERDP_LOCAL void input_free(rdpInput* input);
 
 WINPR_ATTR_MALLOC(input_free, 1)
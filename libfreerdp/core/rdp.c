@@ -44,6 +44,9 @@
 
 #define RDP_TAG FREERDP_TAG("core.rdp")
 
+/* interval of the latency statistics dump to the debug log in ms */
+#define RDP_LATENCY_LOG_INTERVAL 10000
+
 typedef struct
 {
 	const char* file;
@@ -2301,6 +2304,14 @@ BOOL freerdp_get_stats(rdpRdp* rdp, UINT64* inBytes, UINT64* outBytes, UINT64* i
 	return TRUE;
 }
 
+rdpLatencyStats* freerdp_get_latency_stats(rdpContext* context)
+{
+	if (!context || !context->rdp)
+		return NULL;
+
+	return context->rdp->latency;
+}
+
 /**
  * Instantiate new RDP module.
  * @return new RDP module
@@ -2385,6 +2396,12 @@ rdpRdp* rdp_new(rdpContext* context)
 	if (!rdp->input)
 		goto fail;
 
+	rdp->latency = freerdp_latency_stats_new(context->ServerMode ? "server" : "client",
+	                                         RDP_LATENCY_LOG_INTERVAL);
+
+	if (!rdp->latency)
+		goto fail;
+
 	rdp->update = update_new(rdp);
 
 	if (!rdp->update)
@@ -2563,6 +2580,7 @@ void rdp_free(rdpRdp* rdp)
 		freerdp_settings_free(rdp->remoteSettings);
 
 		input_free(rdp->input);
+		freerdp_latency_stats_free(rdp->latency);
 		update_free(rdp->update);
 		nla_free(rdp->nla);
 		redirection_free(rdp->redirection);
@@ -207,6 +207,8 @@ struct rdp_rdp
 	wLog* log;
 	char log_context[64];
 	WINPR_JSON* wellknown;
+
+	rdpLatencyStats* latency;
 };
 
 FREERDP_LOCAL BOOL rdp_read_security_header(rdpRdp* rdp, wStream* s, UINT16* flags, UINT16* length);
@@ -0,0 +1,323 @@
+#include <stdio.h>
+
+#include <winpr/stream.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/transport_io.h>
+
+#include "../rdp.h"
+#include "../input.h"
+#include "../fastpath.h"
+#include "../connection.h"
+
+#define TEST_MAX_PDUS 32
+
+typedef struct
+{
+	wStream* pdus[TEST_MAX_PDUS];
+	size_t count;
+} test_pdus;
+
+static test_pdus captured = { 0 };
+
+static void test_pdus_clear(void)
+{
+	for (size_t x = 0; x < captured.count; x++)
+		Stream_Free(captured.pdus[x], TRUE);
+	captured.count = 0;
+}
+
+static int test_write_pdu(WINPR_ATTR_UNUSED rdpTransport* transport, wStream* s)
+{
+	const size_t length = Stream_GetPosition(s);
+
+	if (captured.count >= TEST_MAX_PDUS)
+		return -1;
+
+	wStream* copy = Stream_New(NULL, length);
+	if (!copy)
+		return -1;
+	Stream_Write(copy, Stream_Buffer(s), length);
+	Stream_SealLength(copy);
+	captured.pdus[captured.count++] = copy;
+	return (int)length;
+}
+
+static BOOL test_pdu_equal(size_t index, const BYTE* data, size_t length)
+{
+	if (index >= captured.count)
+	{
+		(void)fprintf(stderr, "PDU %" PRIuz " was not sent, got %" PRIuz " PDUs\n", index,
+		              captured.count);
+		return FALSE;
+	}
+
+	wStream* s = captured.pdus[index];
+	if ((Stream_Length(s) != length) || (memcmp(Stream_Buffer(s), data, length) != 0))
+	{
+		(void)fprintf(stderr, "PDU %" PRIuz " differs\n", index);
+		winpr_HexDump("expected", WLOG_ERROR, data, length);
+		winpr_HexDump("got", WLOG_ERROR, Stream_Buffer(s), Stream_Length(s));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL test_pdu_count(size_t expected)
+{
+	if (captured.count != expected)
+	{
+		(void)fprintf(stderr, "expected %" PRIuz " PDUs, got %" PRIuz "\n", expected,
+		              captured.count);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL test_set_interval(rdpContext* context, UINT32 interval)
+{
+	return freerdp_settings_set_uint32(context->settings, FreeRDP_InputCoalescingInterval,
+	                                   interval);
+}
+
+/* Absolute motion is replaced by the latest position and sent ahead of the next key */
+static BOOL test_absolute_motion(rdpContext* context)
+{
+	rdpInput* input = context->input;
+	const BYTE expected[] = {
+		0x08, 0x80, 0x0c,                         /* fpInputHeader, 2 events, length */
+		0x20, 0x00, 0x08, 0x1e, 0x00, 0x28, 0x00, /* mouse move to 30x40 */
+		0x00, 0x1e                                /* key 'a' down */
+	};
+
+	test_pdus_clear();
+	if (!test_set_interval(context, 60000))
+		return FALSE;
+
+	if (!freerdp_input_send_mouse_event(input, PTR_FLAGS_MOVE, 10, 20) ||
+	    !freerdp_input_send_mouse_event(input, PTR_FLAGS_MOVE, 20, 30) ||
+	    !freerdp_input_send_mouse_event(input, PTR_FLAGS_MOVE, 30, 40))
+		return FALSE;
+
+	if (!test_pdu_count(0))
+		return FALSE;
+
+	if (!freerdp_input_send_keyboard_event(input, KBD_FLAGS_DOWN, 0x1e))
+		return FALSE;
+
+	return test_pdu_count(1) && test_pdu_equal(0, expected, sizeof(expected));
+}
+
+/* Relative motion is summed up and split before the deltas leave the INT16 range */
+static BOOL test_relative_motion(rdpContext* context)
+{
+	rdpInput* input = context->input;
+	const BYTE split[] = {
+		0x04, 0x80, 0x0a,                        /* fpInputHeader, 1 event, length */
+		0xa0, 0x00, 0x08, 0x20, 0x4e, 0x00, 0x00 /* relative move by 20000x0 */
+	};
+	const BYTE summed[] = {
+		0x08, 0x80, 0x0c,                         /* fpInputHeader, 2 events, length */
+		0xa0, 0x00, 0x08, 0x4c, 0x4f, 0xe0, 0xb1, /* relative move by 20300x-20000 */
+		0x01, 0x1e                                /* key 'a' up */
+	};
+
+	test_pdus_clear();
+	if (!test_set_interval(context, 60000))
+		return FALSE;
+
+	if (!freerdp_input_send_rel_mouse_event(input, PTR_FLAGS_MOVE, 12000, 0) ||
+	    !freerdp_input_send_rel_mouse_event(input, PTR_FLAGS_MOVE, 8000, 0))
+		return FALSE;
+
+	if (!test_pdu_count(0))
+		return FALSE;
+
+	if (!freerdp_input_send_rel_mouse_event(input, PTR_FLAGS_MOVE, 20000, -10000) ||
+	    !freerdp_input_send_rel_mouse_event(input, PTR_FLAGS_MOVE, 300, -10000))
+		return FALSE;
+
+	if (!test_pdu_count(1) || !test_pdu_equal(0, split, sizeof(split)))
+		return FALSE;
+
+	if (!freerdp_input_send_keyboard_event(input, KBD_FLAGS_RELEASE, 0x1e))
+		return FALSE;
+
+	return test_pdu_count(2) && test_pdu_equal(1, summed, sizeof(summed));
+}
+
+/* A fast-path PDU carries at most 15 events, longer sequences are split in order */
+static BOOL test_split(rdpContext* context)
+{
+	rdpInput* input = context->input;
+	const size_t events = 20;
+
+	test_pdus_clear();
+	if (!test_set_interval(context, 0))
+		return FALSE;
+
+	wStream* s = input_batch_begin_event(input, 0, FASTPATH_INPUT_EVENT_SCANCODE);
+	if (s)
+		Stream_Write_UINT8(s, 0);
+	for (size_t x = 1; s && (x < events); x++)
+	{
+		s = input_batch_event(input, 0, FASTPATH_INPUT_EVENT_SCANCODE);
+		if (s)
+			Stream_Write_UINT8(s, (BYTE)x);
+	}
+	if (!input_batch_end_event(input, s))
+		return FALSE;
+
+	if (!test_pdu_count(2))
+		return FALSE;
+
+	BYTE next = 0;
+	for (size_t x = 0; x < captured.count; x++)
+	{
+		wStream* pdu = captured.pdus[x];
+		const size_t count = (x == 0) ? 15 : events - 15;
+
+		if (Stream_Length(pdu) != 3 + 2 * count)
+			return FALSE;
+		if (Stream_Buffer(pdu)[0] != (BYTE)(count << 2))
+			return FALSE;
+
+		for (size_t y = 0; y < count; y++)
+		{
+			const BYTE* event = &Stream_Buffer(pdu)[3 + 2 * y];
+			if ((event[0] != 0) || (event[1] != next++))
+			{
+				(void)fprintf(stderr, "event %" PRIuz " of PDU %" PRIuz " out of order\n", y, x);
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+/* Without coalescing every event is sent in a PDU of its own, as it was before batching */
+static BOOL test_unbatched(rdpContext* context)
+{
+	UINT16 sec_flags = 0;
+	rdpInput* input = context->input;
+	rdpRdp* rdp = context->rdp;
+
+	test_pdus_clear();
+	if (!test_set_interval(context, 0))
+		return FALSE;
+
+	if (!freerdp_input_send_mouse_event(input, PTR_FLAGS_MOVE, 640, 480) ||
+	    !freerdp_input_send_mouse_event(input, PTR_FLAGS_DOWN | PTR_FLAGS_BUTTON1, 640, 480) ||
+	    !freerdp_input_send_rel_mouse_event(input, PTR_FLAGS_MOVE, -5, 7) ||
+	    !freerdp_input_send_keyboard_event(input, KBD_FLAGS_EXTENDED, 0x48) ||
+	    !freerdp_input_send_unicode_keyboard_event(input, 0, 0x20ac) ||
+	    !freerdp_input_send_synchronize_event(input, KBD_SYNC_NUM_LOCK))
+		return FALSE;
+
+	const size_t sent = captured.count;
+
+	wStream* s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSE, &sec_flags);
+	if (!s)
+		return FALSE;
+	Stream_Write_UINT16(s, PTR_FLAGS_MOVE);
+	Stream_Write_UINT16(s, 640);
+	Stream_Write_UINT16(s, 480);
+	if (!fastpath_send_input_pdu(rdp->fastpath, s, sec_flags))
+		return FALSE;
+
+	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSE, &sec_flags);
+	if (!s)
+		return FALSE;
+	Stream_Write_UINT16(s, PTR_FLAGS_DOWN | PTR_FLAGS_BUTTON1);
+	Stream_Write_UINT16(s, 640);
+	Stream_Write_UINT16(s, 480);
+	if (!fastpath_send_input_pdu(rdp->fastpath, s, sec_flags))
+		return FALSE;
+
+	s = fastpath_input_pdu_init(rdp->fastpath, 0, TS_FP_RELPOINTER_EVENT, &sec_flags);
+	if (!s)
+		return FALSE;
+	Stream_Write_UINT16(s, PTR_FLAGS_MOVE);
+	Stream_Write_INT16(s, -5);
+	Stream_Write_INT16(s, 7);
+	if (!fastpath_send_input_pdu(rdp->fastpath, s, sec_flags))
+		return FALSE;
+
+	s = fastpath_input_pdu_init(rdp->fastpath, FASTPATH_INPUT_KBDFLAGS_EXTENDED,
+	                            FASTPATH_INPUT_EVENT_SCANCODE, &sec_flags);
+	if (!s)
+		return FALSE;
+	Stream_Write_UINT8(s, 0x48);
+	if (!fastpath_send_input_pdu(rdp->fastpath, s, sec_flags))
+		return FALSE;
+
+	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_UNICODE, &sec_flags);
+	if (!s)
+		return FALSE;
+	Stream_Write_UINT16(s, 0x20ac);
+	if (!fastpath_send_input_pdu(rdp->fastpath, s, sec_flags))
+		return FALSE;
+
+	s = fastpath_input_pdu_init(rdp->fastpath, KBD_SYNC_NUM_LOCK, FASTPATH_INPUT_EVENT_SYNC,
+	                            &sec_flags);
+	if (!s)
+		return FALSE;
+	if (!fastpath_send_input_pdu(rdp->fastpath, s, sec_flags))
+		return FALSE;
+
+	if ((sent != 6) || !test_pdu_count(2 * sent))
+		return FALSE;
+
+	for (size_t x = 0; x < sent; x++)
+	{
+		wStream* expected = captured.pdus[sent + x];
+		if (!test_pdu_equal(x, Stream_Buffer(expected), Stream_Length(expected)))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+int TestInputBatch(int argc, char* argv[])
+{
+	int rc = -1;
+	freerdp* instance = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	instance = freerdp_new();
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	rdpContext* context = instance->context;
+	if (!freerdp_settings_set_bool(context->settings, FreeRDP_FastPathInput, TRUE) ||
+	    !freerdp_settings_set_bool(context->settings, FreeRDP_HasRelativeMouseEvent, TRUE) ||
+	    !freerdp_settings_set_bool(context->settings, FreeRDP_UnicodeInput, TRUE))
+		goto fail;
+
+	rdpTransportIo io = *freerdp_get_io_callbacks(context);
+	io.WritePdu = test_write_pdu;
+	if (!freerdp_set_io_callbacks(context, &io))
+		goto fail;
+
+	if (!input_register_client_callbacks(context->input) ||
+	    !rdp_client_transition_to_state(context->rdp, CONNECTION_STATE_ACTIVE))
+		goto fail;
+
+	if (!test_absolute_motion(context))
+		goto fail;
+	if (!test_relative_motion(context))
+		goto fail;
+	if (!test_split(context))
+		goto fail;
+	if (!test_unbatched(context))
+		goto fail;
+
+	rc = 0;
+fail:
+	test_pdus_clear();
+	if (instance)
+		freerdp_context_free(instance);
+	freerdp_free(instance);
+	return rc;
+}
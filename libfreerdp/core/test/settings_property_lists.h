@@ -266,6 +266,7 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_GatewayUsageMethod,
 	FreeRDP_GfxCapsFilter,
 	FreeRDP_GlyphSupportLevel,
+	FreeRDP_InputCoalescingInterval,
 	FreeRDP_JpegCodecId,
 	FreeRDP_JpegQuality,
 	FreeRDP_KeySpec,
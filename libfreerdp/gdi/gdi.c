@@ -1330,20 +1330,38 @@ BOOL gdi_resize_ex(rdpGdi* gdi, UINT32 width, UINT32 height, UINT32 stride, UINT
 	WINPR_ASSERT(gdi->context);
 	WINPR_ASSERT(gdi->context->update);
 
+	/* Graphics pipeline surfaces might decode to the primary buffer */
+	RdpgfxClientContext* gfx = gdi->gfx;
+	if (gfx)
+	{
+		gdi_graphics_pipeline_lock_surfaces(gdi);
+		EnterCriticalSection(&gfx->mux);
+		gdi_graphics_pipeline_detach_primary(gdi);
+	}
+
 	/* EndPaint might not have been called, ensure the update lock is released */
-	if (!update_end_paint(gdi->context->update))
-		return FALSE;
-	rdp_update_lock(gdi->context->update);
+	BOOL rc = update_end_paint(gdi->context->update);
+	if (rc)
+	{
+		rdp_update_lock(gdi->context->update);
 
-	if (gdi->drawing == gdi->primary)
-		gdi->drawing = NULL;
+		if (gdi->drawing == gdi->primary)
+			gdi->drawing = NULL;
 
-	gdi->width = (INT32)width;
-	gdi->height = (INT32)height;
-	gdi_bitmap_free_ex(gdi->primary);
-	gdi->primary = NULL;
-	gdi->primary_buffer = NULL;
-	return gdi_init_primary(gdi, stride, format, buffer, pfree, TRUE);
+		gdi->width = (INT32)width;
+		gdi->height = (INT32)height;
+		gdi_bitmap_free_ex(gdi->primary);
+		gdi->primary = NULL;
+		gdi->primary_buffer = NULL;
+		rc = gdi_init_primary(gdi, stride, format, buffer, pfree, TRUE);
+	}
+
+	if (gfx)
+	{
+		LeaveCriticalSection(&gfx->mux);
+		gdi_graphics_pipeline_unlock_surfaces(gdi);
+	}
+	return rc;
 }
 
 /**
@@ -1384,11 +1402,13 @@ BOOL gdi_init_ex(freerdp* instance, UINT32 format, UINT32 stride, BYTE* buffer,
 
 	const UINT32 ColorDepth = freerdp_settings_get_uint32(context->settings, FreeRDP_ColorDepth);
 	SrcFormat = gdi_get_pixel_format(ColorDepth);
-	gdi = (rdpGdi*)calloc(1, sizeof(rdpGdi));
+	rdp_gdi_internal* internal = (rdp_gdi_internal*)calloc(1, sizeof(rdp_gdi_internal));
 
-	if (!gdi)
+	if (!internal)
 		goto fail;
 
+	gdi = &internal->common;
+
 	context->gdi = gdi;
 	gdi->log = WLog_Get(TAG);
 
@@ -1449,7 +1469,7 @@ void gdi_free(freerdp* instance)
 	{
 		gdi_bitmap_free_ex(gdi->primary);
 		gdi_DeleteDC(gdi->hdc);
-		free(gdi);
+		free(gdi_cast(gdi));
 	}
 
 	context = instance->context;
@@ -20,18 +20,54 @@
 #ifndef FREERDP_LIB_GDI_CORE_H
 #define FREERDP_LIB_GDI_CORE_H
 
+#include <winpr/assert.h>
 #include <winpr/cast.h>
+#include <winpr/pool.h>
+#include <winpr/collections.h>
 
 #include "graphics.h"
 #include "brush.h"
 
 #include <freerdp/api.h>
 
+typedef struct
+{
+	rdpGdi common;
+
+	/* Surface commands decoded asynchronously, see gdi_graphics_pipeline_init_ex */
+	PTP_POOL gfxDecodePool;
+	TP_CALLBACK_ENVIRON gfxDecodeEnv;
+	wHashTable* gfxDecoders; /* per surface decode queues */
+	wHashTable* gfxPrimary;  /* primary buffer attachment of the surfaces */
+} rdp_gdi_internal;
+
+static INLINE rdp_gdi_internal* gdi_cast(rdpGdi* gdi)
+{
+	union
+	{
+		rdpGdi* pub;
+		rdp_gdi_internal* internal;
+	} cnv;
+
+	WINPR_ASSERT(gdi);
+	cnv.pub = gdi;
+	return cnv.internal;
+}
+
 FREERDP_LOCAL BOOL gdi_bitmap_update(rdpContext* context, const BITMAP_UPDATE* bitmapUpdate);
 
 FREERDP_LOCAL gdiBitmap* gdi_bitmap_new_ex(rdpGdi* gdi, int width, int height, int bpp, BYTE* data);
 FREERDP_LOCAL void gdi_bitmap_free_ex(gdiBitmap* gdi_bmp);
 
+/** Give the graphics pipeline surfaces decoding into the primary buffer their own buffer back,
+ *  the caller must hold the pipeline mux. */
+FREERDP_LOCAL void gdi_graphics_pipeline_detach_primary(rdpGdi* gdi);
+
+/** Keep the graphics pipeline surfaces from being decoded into until
+ *  gdi_graphics_pipeline_unlock_surfaces, must be called before taking the pipeline mux. */
+FREERDP_LOCAL void gdi_graphics_pipeline_lock_surfaces(rdpGdi* gdi);
+FREERDP_LOCAL void gdi_graphics_pipeline_unlock_surfaces(rdpGdi* gdi);
+
 static INLINE BYTE* gdi_get_bitmap_pointer(HGDI_DC hdcBmp, INT32 x, INT32 y)
 {
 	HGDI_BITMAP hBmp = (HGDI_BITMAP)hdcBmp->selectedObject;
@@ -22,12 +22,17 @@
 #include <freerdp/config.h>
 
 #include "../core/update.h"
+#include "gdi.h"
 
 #include <winpr/assert.h>
 #include <winpr/cast.h>
+#include <winpr/pool.h>
+#include <winpr/collections.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/api.h>
 #include <freerdp/log.h>
+#include <freerdp/primitives.h>
 #include <freerdp/gdi/gfx.h>
 #include <freerdp/gdi/region.h>
 #include <freerdp/utils/gfx.h>
@@ -79,6 +84,514 @@ static DWORD gfx_align_scanline(DWORD widthInBytes, DWORD alignment)
 	return scanline;
 }
 
+typedef struct
+{
+	RDPGFX_SURFACE_COMMAND cmd;
+	RDPGFX_AVC444_BITMAP_STREAM bs; /* AVC420 commands only use the first bitstream */
+} gdiGfxDecodeJob;
+
+/* Decode queue of a surface. Jobs of a surface run in order, those of different surfaces
+ * run concurrently on the pool. */
+typedef struct
+{
+	RdpgfxClientContext* context;
+	PTP_WORK work;
+	/* held while a command decodes into the surface */
+	CRITICAL_SECTION lock;
+	wQueue* jobs; /* gdiGfxDecodeJob */
+	HANDLE idle;  /* set while no job is queued or decoding */
+	BOOL running; /* the work callback is submitted and did not find the queue empty yet */
+	UINT status;  /* first error of a decode since the last frame end, under the queue lock */
+} gdiGfxDecoder;
+
+static UINT gdi_SurfaceCommand_Decode(rdpGdi* gdi, RdpgfxClientContext* context,
+                                      const RDPGFX_SURFACE_COMMAND* cmd);
+
+static void* gdi_surface_key(UINT16 surfaceId)
+{
+	return (void*)(((ULONG_PTR)surfaceId) + 1);
+}
+
+static void gdi_DecodeJobFree(void* obj)
+{
+	gdiGfxDecodeJob* job = obj;
+
+	if (!job)
+		return;
+
+	free(job->bs.bitstream[0].meta.regionRects);
+	free(job->bs.bitstream[1].meta.regionRects);
+	free(job->cmd.data);
+	free(job);
+}
+
+static BOOL gdi_CopyAVC420Stream(RDPGFX_AVC420_BITMAP_STREAM* dst,
+                                 const RDPGFX_AVC420_BITMAP_STREAM* src,
+                                 const RDPGFX_SURFACE_COMMAND* cmd, BYTE* data)
+{
+	WINPR_ASSERT(dst);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(cmd);
+
+	/* The bitstream points into the command data */
+	if (src->data)
+	{
+		if ((src->data < cmd->data) || (src->data > cmd->data + cmd->length))
+			return FALSE;
+
+		const size_t offset = WINPR_ASSERTING_INT_CAST(size_t, src->data - cmd->data);
+		if (src->length > cmd->length - offset)
+			return FALSE;
+
+		dst->data = &data[offset];
+	}
+
+	dst->length = src->length;
+	dst->meta.numRegionRects = src->meta.numRegionRects;
+
+	if (src->meta.numRegionRects > 0)
+	{
+		dst->meta.regionRects = calloc(src->meta.numRegionRects, sizeof(RECTANGLE_16));
+		if (!dst->meta.regionRects)
+			return FALSE;
+
+		memcpy(dst->meta.regionRects, src->meta.regionRects,
+		       src->meta.numRegionRects * sizeof(RECTANGLE_16));
+	}
+
+	return TRUE;
+}
+
+/* The command and its data are only valid during the SurfaceCommand callback */
+static gdiGfxDecodeJob* gdi_DecodeJobNew(const RDPGFX_SURFACE_COMMAND* cmd)
+{
+	WINPR_ASSERT(cmd);
+
+	gdiGfxDecodeJob* job = calloc(1, sizeof(gdiGfxDecodeJob));
+	if (!job)
+		return NULL;
+
+	job->cmd = *cmd;
+	job->cmd.data = NULL;
+	job->cmd.extra = NULL;
+
+	if (!cmd->data || !cmd->extra || (cmd->length == 0))
+		goto fail;
+
+	job->cmd.data = malloc(cmd->length);
+	if (!job->cmd.data)
+		goto fail;
+
+	memcpy(job->cmd.data, cmd->data, cmd->length);
+
+	switch (cmd->codecId)
+	{
+		case RDPGFX_CODECID_AVC420:
+			if (!gdi_CopyAVC420Stream(&job->bs.bitstream[0], cmd->extra, cmd, job->cmd.data))
+				goto fail;
+			job->cmd.extra = &job->bs.bitstream[0];
+			break;
+
+		case RDPGFX_CODECID_AVC444:
+		case RDPGFX_CODECID_AVC444v2:
+		{
+			const RDPGFX_AVC444_BITMAP_STREAM* bs = cmd->extra;
+			job->bs.cbAvc420EncodedBitstream1 = bs->cbAvc420EncodedBitstream1;
+			job->bs.LC = bs->LC;
+
+			for (size_t x = 0; x < ARRAYSIZE(bs->bitstream); x++)
+			{
+				if (!gdi_CopyAVC420Stream(&job->bs.bitstream[x], &bs->bitstream[x], cmd,
+				                          job->cmd.data))
+					goto fail;
+			}
+			job->cmd.extra = &job->bs;
+		}
+		break;
+
+		default:
+			goto fail;
+	}
+
+	return job;
+
+fail:
+	gdi_DecodeJobFree(job);
+	return NULL;
+}
+
+static void CALLBACK gdi_DecodeWorkCallback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
+                                            void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	gdiGfxDecoder* decoder = context;
+	WINPR_ASSERT(decoder);
+
+	RdpgfxClientContext* gfx = decoder->context;
+	WINPR_ASSERT(gfx);
+
+	rdpGdi* gdi = (rdpGdi*)gfx->custom;
+	WINPR_ASSERT(gdi);
+
+	while (TRUE)
+	{
+		Queue_Lock(decoder->jobs);
+		gdiGfxDecodeJob* job = Queue_Dequeue(decoder->jobs);
+		if (!job)
+		{
+			decoder->running = FALSE;
+			(void)SetEvent(decoder->idle);
+			Queue_Unlock(decoder->jobs);
+			return;
+		}
+		Queue_Unlock(decoder->jobs);
+
+		EnterCriticalSection(&decoder->lock);
+		const UINT status = gdi_SurfaceCommand_Decode(gdi, gfx, &job->cmd);
+		LeaveCriticalSection(&decoder->lock);
+		if (status != CHANNEL_RC_OK)
+		{
+			WLog_Print(gdi->log, WLOG_ERROR,
+			           "decoding surfaceId=%" PRIu32 " failed with error %" PRIu32,
+			           job->cmd.surfaceId, status);
+			Queue_Lock(decoder->jobs);
+			if (decoder->status == CHANNEL_RC_OK)
+				decoder->status = status;
+			Queue_Unlock(decoder->jobs);
+		}
+		gdi_DecodeJobFree(job);
+	}
+}
+
+static void gdi_DecoderWaitIdle(gdiGfxDecoder* decoder)
+{
+	if (!decoder)
+		return;
+
+	(void)WaitForSingleObject(decoder->idle, INFINITE);
+}
+
+/* Wait for the queued commands and return the first error since the last call */
+static UINT gdi_DecoderTakeStatus(gdiGfxDecoder* decoder)
+{
+	WINPR_ASSERT(decoder);
+
+	gdi_DecoderWaitIdle(decoder);
+
+	Queue_Lock(decoder->jobs);
+	const UINT status = decoder->status;
+	decoder->status = CHANNEL_RC_OK;
+	Queue_Unlock(decoder->jobs);
+	return status;
+}
+
+static void gdi_DecoderFree(void* obj)
+{
+	gdiGfxDecoder* decoder = obj;
+
+	if (!decoder)
+		return;
+
+	/* Drop what did not start yet, a running decode still writes to the surface */
+	if (decoder->work)
+	{
+		WaitForThreadpoolWorkCallbacks(decoder->work, TRUE);
+		CloseThreadpoolWork(decoder->work);
+	}
+	Queue_Free(decoder->jobs);
+	if (decoder->idle)
+		(void)CloseHandle(decoder->idle);
+	DeleteCriticalSection(&decoder->lock);
+	free(decoder);
+}
+
+static gdiGfxDecoder* gdi_DecoderNew(rdpGdi* gdi, RdpgfxClientContext* context)
+{
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(context);
+
+	gdiGfxDecoder* decoder = calloc(1, sizeof(gdiGfxDecoder));
+	if (!decoder)
+		return NULL;
+
+	decoder->context = context;
+	InitializeCriticalSection(&decoder->lock);
+	decoder->jobs = Queue_New(TRUE, -1, -1);
+	if (!decoder->jobs)
+		goto fail;
+
+	wObject* obj = Queue_Object(decoder->jobs);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = gdi_DecodeJobFree;
+
+	decoder->idle = CreateEvent(NULL, TRUE, TRUE, NULL);
+	if (!decoder->idle)
+		goto fail;
+
+	decoder->work =
+	    CreateThreadpoolWork(gdi_DecodeWorkCallback, decoder, &gdi_cast(gdi)->gfxDecodeEnv);
+	if (!decoder->work)
+		goto fail;
+
+	return decoder;
+
+fail:
+	gdi_DecoderFree(decoder);
+	return NULL;
+}
+
+/* Codecs with state shared by all surfaces (ClearCodec glyph and vbar caches, the RemoteFX,
+ * progressive and planar contexts) are decoded on the channel thread, in order. */
+static BOOL gdi_DecodeAsync(rdpGdi* gdi, const RDPGFX_SURFACE_COMMAND* cmd)
+{
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(cmd);
+
+	/* Outside of a frame the result is presented right away */
+	if (!gdi_cast(gdi)->gfxDecoders || !gdi->inGfxFrame)
+		return FALSE;
+
+	switch (cmd->codecId)
+	{
+#ifdef WITH_GFX_H264
+		case RDPGFX_CODECID_AVC420:
+		case RDPGFX_CODECID_AVC444:
+		case RDPGFX_CODECID_AVC444v2:
+			return TRUE;
+#endif
+		default:
+			return FALSE;
+	}
+}
+
+static UINT gdi_QueueSurfaceCommand(rdpGdi* gdi, RdpgfxClientContext* context,
+                                    const RDPGFX_SURFACE_COMMAND* cmd)
+{
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(cmd);
+
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+	const UINT16 surfaceId = (UINT16)MIN(UINT16_MAX, cmd->surfaceId);
+	gdiGfxDecoder* decoder =
+	    HashTable_GetItemValue(internal->gfxDecoders, gdi_surface_key(surfaceId));
+
+	if (!decoder)
+	{
+		decoder = gdi_DecoderNew(gdi, context);
+		if (!decoder)
+			return ERROR_NOT_ENOUGH_MEMORY;
+
+		if (!HashTable_Insert(internal->gfxDecoders, gdi_surface_key(surfaceId), decoder))
+		{
+			gdi_DecoderFree(decoder);
+			return ERROR_NOT_ENOUGH_MEMORY;
+		}
+	}
+
+	gdiGfxDecodeJob* job = gdi_DecodeJobNew(cmd);
+	if (!job)
+		return ERROR_NOT_ENOUGH_MEMORY;
+
+	Queue_Lock(decoder->jobs);
+	if (!Queue_Enqueue(decoder->jobs, job))
+	{
+		Queue_Unlock(decoder->jobs);
+		gdi_DecodeJobFree(job);
+		return ERROR_NOT_ENOUGH_MEMORY;
+	}
+
+	if (!decoder->running)
+	{
+		decoder->running = TRUE;
+		(void)ResetEvent(decoder->idle);
+		SubmitThreadpoolWork(decoder->work);
+	}
+	Queue_Unlock(decoder->jobs);
+	return CHANNEL_RC_OK;
+}
+
+/* Must not be called with the context mux held, the decodes take it to publish their results */
+static void gdi_WaitForSurfaceDecodes(rdpGdi* gdi, UINT16 surfaceId)
+{
+	WINPR_ASSERT(gdi);
+
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+	if (!internal->gfxDecoders)
+		return;
+
+	gdi_DecoderWaitIdle(HashTable_GetItemValue(internal->gfxDecoders, gdi_surface_key(surfaceId)));
+}
+
+static BOOL gdi_wait_decoder(WINPR_ATTR_UNUSED const void* key, void* value, void* arg)
+{
+	gdiGfxDecoder* decoder = value;
+	UINT* pstatus = arg;
+	WINPR_ASSERT(decoder);
+	WINPR_ASSERT(pstatus);
+
+	const UINT status = gdi_DecoderTakeStatus(decoder);
+	if (*pstatus == CHANNEL_RC_OK)
+		*pstatus = status;
+	return TRUE;
+}
+
+/* Wait for the decodes of all surfaces and return the first error since the last call */
+static UINT gdi_WaitForAllDecodes(rdpGdi* gdi)
+{
+	UINT status = CHANNEL_RC_OK;
+	WINPR_ASSERT(gdi);
+
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+	if (internal->gfxDecoders)
+		(void)HashTable_Foreach(internal->gfxDecoders, gdi_wait_decoder, &status);
+	return status;
+}
+
+static BOOL gdi_lock_decoder(WINPR_ATTR_UNUSED const void* key, void* value,
+                             WINPR_ATTR_UNUSED void* arg)
+{
+	gdiGfxDecoder* decoder = value;
+	WINPR_ASSERT(decoder);
+
+	EnterCriticalSection(&decoder->lock);
+	return TRUE;
+}
+
+static BOOL gdi_unlock_decoder(WINPR_ATTR_UNUSED const void* key, void* value,
+                               WINPR_ATTR_UNUSED void* arg)
+{
+	gdiGfxDecoder* decoder = value;
+	WINPR_ASSERT(decoder);
+
+	LeaveCriticalSection(&decoder->lock);
+	return TRUE;
+}
+
+void gdi_graphics_pipeline_lock_surfaces(rdpGdi* gdi)
+{
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+
+	if (!internal->gfxDecoders)
+		return;
+
+	/* The table stays locked, no decode queue is added until the surfaces are unlocked */
+	HashTable_Lock(internal->gfxDecoders);
+	(void)HashTable_Foreach(internal->gfxDecoders, gdi_lock_decoder, NULL);
+}
+
+void gdi_graphics_pipeline_unlock_surfaces(rdpGdi* gdi)
+{
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+
+	if (!internal->gfxDecoders)
+		return;
+
+	(void)HashTable_Foreach(internal->gfxDecoders, gdi_unlock_decoder, NULL);
+	HashTable_Unlock(internal->gfxDecoders);
+}
+
+/* Primary buffer attachment of a surface, kept out of gdiGfxSurface which clients embed.
+ * While attached, data points into the gdi primary buffer so that decoders write to the
+ * presented image directly. The own buffer of the surface is kept aside. */
+typedef struct
+{
+	BOOL attached;
+	BOOL denied; /* received commands of codecs that need the own buffer */
+	BYTE* ownData;
+	UINT32 ownScanline;
+	UINT32 ownWidth;
+	UINT32 ownHeight;
+} gdiGfxPrimary;
+
+static gdiGfxPrimary* gdi_SurfacePrimary(rdpGdi* gdi, UINT16 surfaceId)
+{
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+
+	if (!internal->gfxPrimary)
+		return NULL;
+	return HashTable_GetItemValue(internal->gfxPrimary, gdi_surface_key(surfaceId));
+}
+
+static gdiGfxPrimary* gdi_SurfacePrimaryNew(rdpGdi* gdi, UINT16 surfaceId)
+{
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+	gdiGfxPrimary* primary = gdi_SurfacePrimary(gdi, surfaceId);
+
+	if (primary || !internal->gfxPrimary)
+		return primary;
+
+	primary = calloc(1, sizeof(gdiGfxPrimary));
+	if (!primary)
+		return NULL;
+
+	if (!HashTable_Insert(internal->gfxPrimary, gdi_surface_key(surfaceId), primary))
+	{
+		free(primary);
+		return NULL;
+	}
+	return primary;
+}
+
+static void gdi_SurfacePrimaryFree(rdpGdi* gdi, UINT16 surfaceId)
+{
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+
+	if (internal->gfxPrimary)
+		HashTable_Remove(internal->gfxPrimary, gdi_surface_key(surfaceId));
+}
+
+/* Give an attached surface its own buffer back, with the content of the primary buffer */
+static void gdi_SurfaceDetachPrimary(rdpGdi* gdi, gdiGfxSurface* surface)
+{
+	WINPR_ASSERT(surface);
+
+	gdiGfxPrimary* primary = gdi_SurfacePrimary(gdi, surface->surfaceId);
+	if (!primary || !primary->attached)
+		return;
+
+	if (!freerdp_image_copy_no_overlap(primary->ownData, surface->format, primary->ownScanline, 0,
+	                                   0, surface->width, surface->height, surface->data,
+	                                   surface->format, surface->scanline, 0, 0, NULL,
+	                                   FREERDP_FLIP_NONE))
+		WLog_WARN(TAG, "failed to keep the content of surfaceId=%" PRIu16, surface->surfaceId);
+
+	surface->data = primary->ownData;
+	surface->scanline = primary->ownScanline;
+	surface->width = primary->ownWidth;
+	surface->height = primary->ownHeight;
+	primary->ownData = NULL;
+	primary->attached = FALSE;
+}
+
+static void gdi_DetachSurfaces(rdpGdi* gdi, RdpgfxClientContext* context)
+{
+	UINT16 count = 0;
+	UINT16* pSurfaceIds = NULL;
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->GetSurfaceIds);
+	context->GetSurfaceIds(context, &pSurfaceIds, &count);
+
+	for (UINT32 index = 0; index < count; index++)
+	{
+		WINPR_ASSERT(context->GetSurfaceData);
+		gdiGfxSurface* surface =
+		    (gdiGfxSurface*)context->GetSurfaceData(context, pSurfaceIds[index]);
+
+		if (surface)
+			gdi_SurfaceDetachPrimary(gdi, surface);
+	}
+
+	free(pSurfaceIds);
+}
+
+void gdi_graphics_pipeline_detach_primary(rdpGdi* gdi)
+{
+	WINPR_ASSERT(gdi);
+
+	if (gdi->gfx)
+		gdi_DetachSurfaces(gdi, gdi->gfx);
+}
+
 /**
  * Function description
  *
@@ -107,6 +620,11 @@ static UINT gdi_ResetGraphics(RdpgfxClientContext* context,
 
 	settings = gdi->context->settings;
 	WINPR_ASSERT(settings);
+
+	/* Everything decoded so far is discarded */
+	(void)gdi_WaitForAllDecodes(gdi);
+
+	gdi_graphics_pipeline_lock_surfaces(gdi);
 	EnterCriticalSection(&context->mux);
 	DesktopWidth = resetGraphics->width;
 	DesktopHeight = resetGraphics->height;
@@ -134,6 +652,7 @@ static UINT gdi_ResetGraphics(RdpgfxClientContext* context,
 		if (!surface)
 			continue;
 
+		gdi_SurfaceDetachPrimary(gdi, surface);
 		memset(surface->data, 0xFF, (size_t)surface->scanline * surface->height);
 		region16_clear(&surface->invalidRegion);
 	}
@@ -160,9 +679,71 @@ static UINT gdi_ResetGraphics(RdpgfxClientContext* context,
 	rc = CHANNEL_RC_OK;
 fail:
 	LeaveCriticalSection(&context->mux);
+	gdi_graphics_pipeline_unlock_surfaces(gdi);
 	return rc;
 }
 
+static BOOL gdi_SurfaceScalesDirect(const rdpGdi* gdi, const gdiGfxSurface* surface)
+{
+	if ((surface->outputTargetWidth == surface->mappedWidth) &&
+	    (surface->outputTargetHeight == surface->mappedHeight))
+		return FALSE;
+
+	return (FreeRDPGetBytesPerPixel(gdi->dstFormat) == 4) &&
+	       (FreeRDPGetBytesPerPixel(surface->format) == 4) &&
+	       FreeRDPAreColorFormatsEqualNoAlpha(surface->format, gdi->dstFormat);
+}
+
+/* Scale a dirty rectangle of a surface to the primary buffer. The filter taps are taken from
+ * the whole surface, so the borders of the rectangles do not show up as seams. The
+ * destination pixels depending on the rectangle are returned in primary buffer coordinates. */
+static BOOL gdi_ScaleSurfaceRect(rdpGdi* gdi, const gdiGfxSurface* surface,
+                                 const RECTANGLE_16* rect, RECTANGLE_16* invalid)
+{
+	primitives_t* prims = primitives_get();
+	const RECTANGLE_16 empty = { 0 };
+
+	WINPR_ASSERT(prims);
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(surface);
+	WINPR_ASSERT(rect);
+	WINPR_ASSERT(invalid);
+
+	*invalid = empty;
+	const UINT32 x = surface->outputOriginX;
+	const UINT32 y = surface->outputOriginY;
+	if ((x >= (UINT32)gdi->width) || (y >= (UINT32)gdi->height))
+		return TRUE;
+
+	const double sx = surface->outputTargetWidth / (double)surface->mappedWidth;
+	const double sy = surface->outputTargetHeight / (double)surface->mappedHeight;
+	const double mx = ceil(MAX(sx, 1.0)) + 1.0;
+	const double my = ceil(MAX(sy, 1.0)) + 1.0;
+	const UINT32 maxX = MIN(MIN(surface->outputTargetWidth, (UINT32)gdi->width - x), UINT16_MAX);
+	const UINT32 maxY = MIN(MIN(surface->outputTargetHeight, (UINT32)gdi->height - y), UINT16_MAX);
+
+	RECTANGLE_16 dst = { 0 };
+	dst.left = (UINT16)MIN(MAX(floor(rect->left * sx) - mx, 0.0), maxX);
+	dst.top = (UINT16)MIN(MAX(floor(rect->top * sy) - my, 0.0), maxY);
+	dst.right = (UINT16)MIN(ceil(rect->right * sx) + mx, maxX);
+	dst.bottom = (UINT16)MIN(ceil(rect->bottom * sy) + my, maxY);
+	if ((dst.left >= dst.right) || (dst.top >= dst.bottom))
+		return TRUE;
+
+	BYTE* pDst = &gdi->primary_buffer[4ull * x + 1ull * y * gdi->stride];
+	if (prims->scale_8u_C4R(surface->data, surface->scanline, surface->mappedWidth,
+	                        surface->mappedHeight, pDst, gdi->stride, surface->outputTargetWidth,
+	                        surface->outputTargetHeight, &dst,
+	                        PRIM_SCALE_BILINEAR) != PRIMITIVES_SUCCESS)
+		return FALSE;
+
+	invalid->left = (UINT16)(dst.left + x);
+	invalid->top = (UINT16)(dst.top + y);
+	invalid->right = (UINT16)(dst.right + x);
+	invalid->bottom = (UINT16)(dst.bottom + y);
+	return TRUE;
+}
+
 static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 {
 	UINT rc = ERROR_INTERNAL_ERROR;
@@ -192,6 +773,9 @@ static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 	region16_intersect_rect(&(surface->invalidRegion), &(surface->invalidRegion), &surfaceRect);
 	const double sx = surface->outputTargetWidth / (double)surface->mappedWidth;
 	const double sy = surface->outputTargetHeight / (double)surface->mappedHeight;
+	const BOOL scaleDirect = gdi_SurfaceScalesDirect(gdi, surface);
+	const gdiGfxPrimary* primary = gdi_SurfacePrimary(gdi, surface->surfaceId);
+	const BOOL attached = primary && primary->attached;
 
 	if (!(rects = region16_rects(&surface->invalidRegion, &nbRects)) || !nbRects)
 		return CHANNEL_RC_OK;
@@ -210,7 +794,23 @@ static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 		const UINT32 dwidth = MIN((UINT32)(swidth * sx), (UINT32)gdi->width - nXDst);
 		const UINT32 dheight = MIN((UINT32)(sheight * sy), (UINT32)gdi->height - nYDst);
 
-		if (!freerdp_image_scale(gdi->primary_buffer, gdi->dstFormat, gdi->stride, nXDst, nYDst,
+		/* Attached surfaces were decoded in place */
+		if (!attached && scaleDirect)
+		{
+			RECTANGLE_16 invalid = { 0 };
+			if (!gdi_ScaleSurfaceRect(gdi, surface, &rects[i], &invalid))
+			{
+				rc = CHANNEL_RC_NULL_DATA;
+				goto fail;
+			}
+
+			gdi_InvalidateRegion(gdi->primary->hdc, invalid.left, invalid.top,
+			                     invalid.right - invalid.left, invalid.bottom - invalid.top);
+			continue;
+		}
+
+		if (!attached &&
+		    !freerdp_image_scale(gdi->primary_buffer, gdi->dstFormat, gdi->stride, nXDst, nYDst,
 		                         dwidth, dheight, surface->data, surface->format, surface->scanline,
 		                         nXSrc, nYSrc, swidth, sheight))
 		{
@@ -287,6 +887,158 @@ static UINT gdi_UpdateSurfaces(RdpgfxClientContext* context)
 	return status;
 }
 
+static BOOL gdi_SurfaceOutputRect(const gdiGfxSurface* surface, RECTANGLE_16* rect)
+{
+	WINPR_ASSERT(surface);
+	WINPR_ASSERT(rect);
+
+	if (!surface->outputMapped)
+		return FALSE;
+
+	rect->left = (UINT16)MIN(UINT16_MAX, surface->outputOriginX);
+	rect->top = (UINT16)MIN(UINT16_MAX, surface->outputOriginY);
+	rect->right = (UINT16)MIN(UINT16_MAX, surface->outputOriginX + surface->outputTargetWidth);
+	rect->bottom = (UINT16)MIN(UINT16_MAX, surface->outputOriginY + surface->outputTargetHeight);
+	return TRUE;
+}
+
+/* Detach the other surfaces covering the output area of surface, returns TRUE if surface does
+ * not overlap any of them. */
+static BOOL gdi_SurfaceOutputExclusive(rdpGdi* gdi, RdpgfxClientContext* context,
+                                       const gdiGfxSurface* surface)
+{
+	BOOL exclusive = TRUE;
+	UINT16 count = 0;
+	UINT16* pSurfaceIds = NULL;
+	RECTANGLE_16 rect = { 0 };
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(surface);
+
+	if (!gdi_SurfaceOutputRect(surface, &rect))
+		return FALSE;
+
+	WINPR_ASSERT(context->GetSurfaceIds);
+	context->GetSurfaceIds(context, &pSurfaceIds, &count);
+
+	for (UINT32 index = 0; index < count; index++)
+	{
+		RECTANGLE_16 other = { 0 };
+		RECTANGLE_16 intersection = { 0 };
+
+		WINPR_ASSERT(context->GetSurfaceData);
+		gdiGfxSurface* cur = (gdiGfxSurface*)context->GetSurfaceData(context, pSurfaceIds[index]);
+
+		if (!cur || (cur == surface) || !gdi_SurfaceOutputRect(cur, &other))
+			continue;
+
+		if (rectangles_intersection(&rect, &other, &intersection))
+		{
+			gdi_SurfaceDetachPrimary(gdi, cur);
+			exclusive = FALSE;
+		}
+	}
+
+	free(pSurfaceIds);
+	return exclusive;
+}
+
+/**
+ * Let the decoders of an output mapped surface write to the primary buffer directly, saving the
+ * copy in gdi_OutputUpdate. Only done if the surface is presented unscaled by gdi_UpdateSurfaces,
+ * has the primary buffer format and is the only surface on its output area. Other surfaces
+ * overlapping it are detached.
+ */
+static void gdi_SurfaceAttachPrimary(rdpGdi* gdi, RdpgfxClientContext* context,
+                                     gdiGfxSurface* surface)
+{
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(surface);
+
+	if (!gdi_SurfaceOutputExclusive(gdi, context, surface) || !gdi->primary_buffer)
+		return;
+
+	gdiGfxPrimary* primary = gdi_SurfacePrimaryNew(gdi, surface->surfaceId);
+	if (!primary || primary->attached || primary->denied)
+		return;
+
+	if ((context->UpdateSurfaces != gdi_UpdateSurfaces) || context->UpdateSurfaceArea)
+		return;
+
+	if ((surface->outputTargetWidth != surface->mappedWidth) ||
+	    (surface->outputTargetHeight != surface->mappedHeight))
+		return;
+
+	if (!FreeRDPAreColorFormatsEqualNoAlpha(surface->format, gdi->dstFormat))
+		return;
+
+	if ((gdi->width < 0) || (gdi->height < 0) ||
+	    (1ull * surface->outputOriginX + surface->mappedWidth > (UINT32)gdi->width) ||
+	    (1ull * surface->outputOriginY + surface->mappedHeight > (UINT32)gdi->height))
+		return;
+
+	const size_t offset = 1ull * surface->outputOriginY * gdi->stride +
+	                      1ull * surface->outputOriginX * FreeRDPGetBytesPerPixel(gdi->dstFormat);
+	BYTE* data = &gdi->primary_buffer[offset];
+
+	if (!freerdp_image_copy_no_overlap(data, surface->format, gdi->stride, 0, 0,
+	                                   surface->mappedWidth, surface->mappedHeight, surface->data,
+	                                   surface->format, surface->scanline, 0, 0, NULL,
+	                                   FREERDP_FLIP_NONE))
+		return;
+
+	/* Commands are checked against width and height, keep them within the primary buffer */
+	primary->ownData = surface->data;
+	primary->ownScanline = surface->scanline;
+	primary->ownWidth = surface->width;
+	primary->ownHeight = surface->height;
+	surface->data = data;
+	surface->scanline = gdi->stride;
+	surface->width = surface->mappedWidth;
+	surface->height = surface->mappedHeight;
+	primary->attached = TRUE;
+
+	const RECTANGLE_16 rect = { 0, 0, (UINT16)MIN(UINT16_MAX, surface->mappedWidth),
+		                        (UINT16)MIN(UINT16_MAX, surface->mappedHeight) };
+	region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rect);
+	WLog_Print(gdi->log, WLOG_DEBUG, "surfaceId=%" PRIu16 " decodes to the primary buffer",
+	           surface->surfaceId);
+}
+
+/* ClearCodec, planar, alpha and uncompressed commands only write to their destination
+ * rectangle. The other codecs keep state sized after the surface. */
+static void gdi_SurfaceCommandPrimary(rdpGdi* gdi, RdpgfxClientContext* context,
+                                      const RDPGFX_SURFACE_COMMAND* cmd)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(cmd);
+
+	switch (cmd->codecId)
+	{
+		case RDPGFX_CODECID_UNCOMPRESSED:
+		case RDPGFX_CODECID_PLANAR:
+		case RDPGFX_CODECID_CLEARCODEC:
+		case RDPGFX_CODECID_ALPHA:
+			return;
+		default:
+			break;
+	}
+
+	WINPR_ASSERT(context->GetSurfaceData);
+	gdiGfxSurface* surface = (gdiGfxSurface*)context->GetSurfaceData(
+	    context, (UINT16)MIN(UINT16_MAX, cmd->surfaceId));
+
+	if (!surface)
+		return;
+
+	gdi_SurfaceDetachPrimary(gdi, surface);
+
+	gdiGfxPrimary* primary = gdi_SurfacePrimaryNew(gdi, surface->surfaceId);
+	if (primary)
+		primary->denied = TRUE;
+}
+
 /**
  * Function description
  *
@@ -303,6 +1055,8 @@ static UINT gdi_StartFrame(RdpgfxClientContext* context, const RDPGFX_START_FRAM
 	WINPR_ASSERT(gdi);
 	gdi->inGfxFrame = TRUE;
 	gdi->frameId = startFrame->frameId;
+	freerdp_latency_stats_frame(freerdp_get_latency_stats(gdi->context), gdi->frameId,
+	                            FREERDP_LATENCY_STAGE_RECEIVE, winpr_GetTickCount64NS());
 	return CHANNEL_RC_OK;
 }
 
@@ -325,7 +1079,14 @@ static UINT gdi_EndFrame(RdpgfxClientContext* context,
 
 	rdpGdi* gdi = (rdpGdi*)context->custom;
 	WINPR_ASSERT(gdi);
-	const UINT status = gdi_call_update_surfaces(context);
+
+	/* The frame is acknowledged once we return, so all of its decodes must be done */
+	UINT status = gdi_WaitForAllDecodes(gdi);
+	freerdp_latency_stats_frame(freerdp_get_latency_stats(gdi->context), gdi->frameId,
+	                            FREERDP_LATENCY_STAGE_DECODE_END, winpr_GetTickCount64NS());
+	const UINT rc = gdi_call_update_surfaces(context);
+	if (status == CHANNEL_RC_OK)
+		status = rc;
 	gdi->inGfxFrame = FALSE;
 	return status;
 }
@@ -623,6 +1384,8 @@ static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
 		return CHANNEL_RC_OK;
 	}
 
+	/* Might run on the thread pool, see gdi_QueueSurfaceCommand */
+	EnterCriticalSection(&context->mux);
 	for (UINT32 i = 0; i < meta->numRegionRects; i++)
 	{
 		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
@@ -638,6 +1401,7 @@ static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
 	status = gdi_interFrameUpdate(gdi, context);
 
 fail:
+	LeaveCriticalSection(&context->mux);
 	return status;
 #else
 	return ERROR_NOT_SUPPORTED;
@@ -712,6 +1476,8 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 		return CHANNEL_RC_OK;
 	}
 
+	/* Might run on the thread pool, see gdi_QueueSurfaceCommand */
+	EnterCriticalSection(&context->mux);
 	for (UINT32 i = 0; i < meta1->numRegionRects; i++)
 	{
 		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
@@ -739,6 +1505,7 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 	status = gdi_interFrameUpdate(gdi, context);
 
 fail:
+	LeaveCriticalSection(&context->mux);
 	return status;
 #else
 	return ERROR_NOT_SUPPORTED;
@@ -1028,29 +1795,11 @@ fail:
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFACE_COMMAND* cmd)
+static UINT gdi_SurfaceCommand_Decode(rdpGdi* gdi, RdpgfxClientContext* context,
+                                      const RDPGFX_SURFACE_COMMAND* cmd)
 {
 	UINT status = CHANNEL_RC_OK;
-	rdpGdi* gdi = NULL;
-
-	if (!context || !cmd)
-		return ERROR_INVALID_PARAMETER;
-
-	gdi = (rdpGdi*)context->custom;
-
-	EnterCriticalSection(&context->mux);
 	const UINT16 codecId = WINPR_ASSERTING_INT_CAST(UINT16, cmd->codecId);
-	WLog_Print(gdi->log, WLOG_TRACE,
-	           "surfaceId=%" PRIu32 ", codec=%s [%" PRIu32 "], contextId=%" PRIu32 ", format=%s, "
-	           "left=%" PRIu32 ", top=%" PRIu32 ", right=%" PRIu32 ", bottom=%" PRIu32
-	           ", width=%" PRIu32 ", height=%" PRIu32 " "
-	           "length=%" PRIu32 ", data=%p, extra=%p",
-	           cmd->surfaceId, rdpgfx_get_codec_id_string(codecId), cmd->codecId, cmd->contextId,
-	           FreeRDPGetColorFormatName(cmd->format), cmd->left, cmd->top, cmd->right, cmd->bottom,
-	           cmd->width, cmd->height, cmd->length, (void*)cmd->data, (void*)cmd->extra);
-#if defined(WITH_GFX_FRAME_DUMP)
-	dump_cmd(cmd, gdi->frameId);
-#endif
 
 	switch (codecId)
 	{
@@ -1098,6 +1847,53 @@ static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFAC
 			break;
 	}
 
+	return status;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFACE_COMMAND* cmd)
+{
+	UINT status = CHANNEL_RC_OK;
+	rdpGdi* gdi = NULL;
+
+	if (!context || !cmd)
+		return ERROR_INVALID_PARAMETER;
+
+	gdi = (rdpGdi*)context->custom;
+
+	const UINT16 codecId = WINPR_ASSERTING_INT_CAST(UINT16, cmd->codecId);
+	WLog_Print(gdi->log, WLOG_TRACE,
+	           "surfaceId=%" PRIu32 ", codec=%s [%" PRIu32 "], contextId=%" PRIu32 ", format=%s, "
+	           "left=%" PRIu32 ", top=%" PRIu32 ", right=%" PRIu32 ", bottom=%" PRIu32
+	           ", width=%" PRIu32 ", height=%" PRIu32 " "
+	           "length=%" PRIu32 ", data=%p, extra=%p",
+	           cmd->surfaceId, rdpgfx_get_codec_id_string(codecId), cmd->codecId, cmd->contextId,
+	           FreeRDPGetColorFormatName(cmd->format), cmd->left, cmd->top, cmd->right, cmd->bottom,
+	           cmd->width, cmd->height, cmd->length, (void*)cmd->data, (void*)cmd->extra);
+#if defined(WITH_GFX_FRAME_DUMP)
+	dump_cmd(cmd, gdi->frameId);
+#endif
+
+	if (gdi->inGfxFrame)
+		freerdp_latency_stats_frame(freerdp_get_latency_stats(gdi->context), gdi->frameId,
+		                            FREERDP_LATENCY_STAGE_DECODE_START, winpr_GetTickCount64NS());
+
+	EnterCriticalSection(&context->mux);
+	gdi_SurfaceCommandPrimary(gdi, context, cmd);
+	LeaveCriticalSection(&context->mux);
+
+	if (gdi_DecodeAsync(gdi, cmd))
+		return gdi_QueueSurfaceCommand(gdi, context, cmd);
+
+	/* Keep the order with commands of this surface still decoding on the pool */
+	gdi_WaitForSurfaceDecodes(gdi, (UINT16)MIN(UINT16_MAX, cmd->surfaceId));
+
+	EnterCriticalSection(&context->mux);
+	status = gdi_SurfaceCommand_Decode(gdi, context, cmd);
 	LeaveCriticalSection(&context->mux);
 	return status;
 }
@@ -1186,6 +1982,7 @@ static UINT gdi_CreateSurface(RdpgfxClientContext* context,
 
 	memset(surface->data, 0xFF, (size_t)surface->scanline * surface->height);
 	region16_init(&surface->invalidRegion);
+	gdi_SurfacePrimaryFree(gdi, surface->surfaceId);
 
 	WINPR_ASSERT(context->SetSurfaceData);
 	rc = context->SetSurfaceData(context, surface->surfaceId, (void*)surface);
@@ -1206,6 +2003,8 @@ static UINT gdi_DeleteSurface(RdpgfxClientContext* context,
 	UINT res = ERROR_INTERNAL_ERROR;
 	rdpCodecs* codecs = NULL;
 	gdiGfxSurface* surface = NULL;
+
+	(void)gdi_graphics_pipeline_release_surface(context, deleteSurface->surfaceId);
 	EnterCriticalSection(&context->mux);
 
 	WINPR_ASSERT(context->GetSurfaceData);
@@ -1222,10 +2021,17 @@ static UINT gdi_DeleteSurface(RdpgfxClientContext* context,
 #endif
 		region16_uninit(&surface->invalidRegion);
 		codecs = surface->codecs;
-		winpr_aligned_free(surface->data);
+		const gdiGfxPrimary* primary =
+		    gdi_SurfacePrimary((rdpGdi*)context->custom, deleteSurface->surfaceId);
+		if (primary && primary->attached)
+			winpr_aligned_free(primary->ownData);
+		else
+			winpr_aligned_free(surface->data);
 		free(surface);
 	}
 
+	gdi_SurfacePrimaryFree((rdpGdi*)context->custom, deleteSurface->surfaceId);
+
 	WINPR_ASSERT(context->SetSurfaceData);
 	res = context->SetSurfaceData(context, deleteSurface->surfaceId, NULL);
 	if (res)
@@ -1273,6 +2079,7 @@ static UINT gdi_SolidFill(RdpgfxClientContext* context, const RDPGFX_SOLID_FILL_
 	RECTANGLE_16 invalidRect = { 0 };
 	rdpGdi* gdi = (rdpGdi*)context->custom;
 
+	gdi_WaitForSurfaceDecodes(gdi, solidFill->surfaceId);
 	EnterCriticalSection(&context->mux);
 
 	WINPR_ASSERT(context->GetSurfaceData);
@@ -1341,6 +2148,9 @@ static UINT gdi_SurfaceToSurface(RdpgfxClientContext* context,
 	gdiGfxSurface* surfaceSrc = NULL;
 	gdiGfxSurface* surfaceDst = NULL;
 	rdpGdi* gdi = (rdpGdi*)context->custom;
+
+	gdi_WaitForSurfaceDecodes(gdi, surfaceToSurface->surfaceIdSrc);
+	gdi_WaitForSurfaceDecodes(gdi, surfaceToSurface->surfaceIdDest);
 	EnterCriticalSection(&context->mux);
 	rectSrc = &(surfaceToSurface->rectSrc);
 
@@ -1415,7 +2225,8 @@ static gdiGfxCacheEntry* gdi_GfxCacheEntryNew(UINT64 cacheKey, UINT32 width, UIN
 	cacheEntry->width = width;
 	cacheEntry->height = height;
 	cacheEntry->format = format;
-	cacheEntry->scanline = gfx_align_scanline(cacheEntry->width * 4, 16);
+	/* ExportCacheEntry hands out the data as is, keep the rows packed */
+	cacheEntry->scanline = cacheEntry->width * 4;
 
 	if ((cacheEntry->width > 0) && (cacheEntry->height > 0))
 	{
@@ -1442,6 +2253,9 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	gdiGfxSurface* surface = NULL;
 	gdiGfxCacheEntry* cacheEntry = NULL;
 	UINT rc = ERROR_INTERNAL_ERROR;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
+
+	gdi_WaitForSurfaceDecodes(gdi, surfaceToCache->surfaceId);
 	EnterCriticalSection(&context->mux);
 	rect = &(surfaceToCache->rectSrc);
 
@@ -1496,6 +2310,7 @@ static UINT gdi_CacheToSurface(RdpgfxClientContext* context,
 	RECTANGLE_16 invalidRect;
 	rdpGdi* gdi = (rdpGdi*)context->custom;
 
+	gdi_WaitForSurfaceDecodes(gdi, cacheToSurface->surfaceId);
 	EnterCriticalSection(&context->mux);
 
 	WINPR_ASSERT(context->GetSurfaceData);
@@ -1706,12 +2521,14 @@ static UINT gdi_MapSurfaceToOutput(RdpgfxClientContext* context,
 		goto fail;
 	}
 
+	gdi_SurfaceDetachPrimary((rdpGdi*)context->custom, surface);
 	surface->outputMapped = TRUE;
 	surface->outputOriginX = surfaceToOutput->outputOriginX;
 	surface->outputOriginY = surfaceToOutput->outputOriginY;
 	surface->outputTargetWidth = surface->mappedWidth;
 	surface->outputTargetHeight = surface->mappedHeight;
 	region16_clear(&surface->invalidRegion);
+	gdi_SurfaceAttachPrimary((rdpGdi*)context->custom, context, surface);
 	rc = CHANNEL_RC_OK;
 fail:
 	LeaveCriticalSection(&context->mux);
@@ -1738,12 +2555,14 @@ gdi_MapSurfaceToScaledOutput(RdpgfxClientContext* context,
 		goto fail;
 	}
 
+	gdi_SurfaceDetachPrimary((rdpGdi*)context->custom, surface);
 	surface->outputMapped = TRUE;
 	surface->outputOriginX = surfaceToOutput->outputOriginX;
 	surface->outputOriginY = surfaceToOutput->outputOriginY;
 	surface->outputTargetWidth = surfaceToOutput->targetWidth;
 	surface->outputTargetHeight = surfaceToOutput->targetHeight;
 	region16_clear(&surface->invalidRegion);
+	gdi_SurfaceAttachPrimary((rdpGdi*)context->custom, context, surface);
 	rc = CHANNEL_RC_OK;
 fail:
 	LeaveCriticalSection(&context->mux);
@@ -1882,6 +2701,15 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 	gfx->UnmapWindowForSurface = unmap;
 	gfx->UpdateSurfaceArea = update;
 
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+	internal->gfxPrimary = HashTable_New(TRUE);
+	if (!internal->gfxPrimary)
+		return FALSE;
+
+	wObject* obj = HashTable_ValueObject(internal->gfxPrimary);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = free;
+
 	if (!freerdp_settings_get_bool(settings, FreeRDP_DeactivateClientDecoding))
 	{
 		const UINT32 w = freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth);
@@ -1893,6 +2721,24 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 			return FALSE;
 		if (!freerdp_client_codecs_prepare(gfx->codecs, FREERDP_CODEC_ALL, w, h))
 			return FALSE;
+
+		if (!(flags & THREADING_FLAGS_DISABLE_THREADS))
+		{
+			internal->gfxDecoders = HashTable_New(TRUE);
+			if (!internal->gfxDecoders)
+				return FALSE;
+
+			obj = HashTable_ValueObject(internal->gfxDecoders);
+			WINPR_ASSERT(obj);
+			obj->fnObjectFree = gdi_DecoderFree;
+
+			internal->gfxDecodePool = CreateThreadpool(NULL);
+			if (!internal->gfxDecodePool)
+				return FALSE;
+
+			InitializeThreadpoolEnvironment(&internal->gfxDecodeEnv);
+			SetThreadpoolCallbackPool(&internal->gfxDecodeEnv, internal->gfxDecodePool);
+		}
 	}
 	InitializeCriticalSection(&gfx->mux);
 	PROFILER_CREATE(gfx->SurfaceProfiler, "GFX-PROFILER")
@@ -1917,7 +2763,23 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 void gdi_graphics_pipeline_uninit(rdpGdi* gdi, RdpgfxClientContext* gfx)
 {
 	if (gdi)
+	{
+		rdp_gdi_internal* internal = gdi_cast(gdi);
+
+		/* Waits for the decodes still running */
+		HashTable_Free(internal->gfxDecoders);
+		internal->gfxDecoders = NULL;
+		HashTable_Free(internal->gfxPrimary);
+		internal->gfxPrimary = NULL;
+
+		if (internal->gfxDecodePool)
+		{
+			CloseThreadpool(internal->gfxDecodePool);
+			DestroyThreadpoolEnvironment(&internal->gfxDecodeEnv);
+			internal->gfxDecodePool = NULL;
+		}
 		gdi->gfx = NULL;
+	}
 
 	if (!gfx)
 		return;
@@ -1932,6 +2794,26 @@ void gdi_graphics_pipeline_uninit(rdpGdi* gdi, RdpgfxClientContext* gfx)
 	PROFILER_FREE(gfx->SurfaceProfiler)
 }
 
+UINT gdi_graphics_pipeline_release_surface(RdpgfxClientContext* gfx, UINT16 surfaceId)
+{
+	if (!gfx)
+		return ERROR_INVALID_PARAMETER;
+
+	rdpGdi* gdi = (rdpGdi*)gfx->custom;
+	if (!gdi || !gdi_cast(gdi)->gfxDecoders)
+		return CHANNEL_RC_OK;
+
+	rdp_gdi_internal* internal = gdi_cast(gdi);
+	gdiGfxDecoder* decoder =
+	    HashTable_GetItemValue(internal->gfxDecoders, gdi_surface_key(surfaceId));
+	if (!decoder)
+		return CHANNEL_RC_OK;
+
+	const UINT status = gdi_DecoderTakeStatus(decoder);
+	HashTable_Remove(internal->gfxDecoders, gdi_surface_key(surfaceId));
+	return status;
+}
+
 const char* rdpgfx_caps_version_str(UINT32 capsVersion)
 {
 	switch (capsVersion)
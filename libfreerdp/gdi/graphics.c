@@ -29,6 +29,7 @@
 #include <freerdp/gdi/shape.h>
 #include <freerdp/gdi/region.h>
 #include <freerdp/gdi/bitmap.h>
+#include <freerdp/primitives.h>
 
 #include "clipping.h"
 #include "drawing.h"
@@ -268,9 +269,45 @@ static BOOL gdi_Bitmap_SetSurface(rdpContext* context, rdpBitmap* bitmap, BOOL p
 }
 
 /* Glyph Class */
+
+/* converts the 1 bpp glyph to an 8 bit alpha mask, rows are padded for SIMD access */
+static BYTE* gdi_glyph_convert_mask(const rdpGlyph* glyph, UINT32* pStride)
+{
+	WINPR_ASSERT(glyph);
+	WINPR_ASSERT(pStride);
+
+	const size_t scanline = (glyph->cx + 7) / 8;
+	const size_t stride = (glyph->cx + 15ull) & ~15ull;
+	const size_t size = stride * glyph->cy;
+
+	if ((size == 0) || (stride > UINT32_MAX) || (glyph->cb < scanline * glyph->cy) || !glyph->aj)
+		return NULL;
+
+	BYTE* data = winpr_aligned_calloc(size, 1, 64);
+
+	if (!data)
+		return NULL;
+
+	for (size_t y = 0; y < glyph->cy; y++)
+	{
+		const BYTE* src = &glyph->aj[y * scanline];
+		BYTE* dst = &data[y * stride];
+
+		for (size_t x = 0; x < glyph->cx; x++)
+		{
+			if ((src[x / 8] & (0x80 >> (x % 8))) != 0)
+				dst[x] = 0xFF;
+		}
+	}
+
+	*pStride = (UINT32)stride;
+	return data;
+}
+
 static BOOL gdi_Glyph_New(rdpContext* context, rdpGlyph* glyph)
 {
 	BYTE* data = NULL;
+	UINT32 stride = 0;
 	gdiGlyph* gdi_glyph = NULL;
 
 	if (!context || !glyph)
@@ -283,7 +320,7 @@ static BOOL gdi_Glyph_New(rdpContext* context, rdpGlyph* glyph)
 		return FALSE;
 
 	gdi_glyph->hdc->format = PIXEL_FORMAT_MONO;
-	data = freerdp_glyph_convert(glyph->cx, glyph->cy, glyph->aj);
+	data = gdi_glyph_convert_mask(glyph, &stride);
 
 	if (!data)
 	{
@@ -291,7 +328,8 @@ static BOOL gdi_Glyph_New(rdpContext* context, rdpGlyph* glyph)
 		return FALSE;
 	}
 
-	gdi_glyph->bitmap = gdi_CreateBitmap(glyph->cx, glyph->cy, PIXEL_FORMAT_MONO, data);
+	gdi_glyph->bitmap = gdi_CreateBitmapEx(glyph->cx, glyph->cy, PIXEL_FORMAT_MONO, stride, data,
+	                                       winpr_aligned_free);
 
 	if (!gdi_glyph->bitmap)
 	{
@@ -374,6 +412,144 @@ static BOOL gdi_Glyph_Draw(rdpContext* context, const rdpGlyph* glyph, INT32 x,
 	return rc;
 }
 
+static BOOL gdi_Glyph_DrawRun(rdpContext* context, const GLYPH_PLACEMENT* placements, size_t count,
+                              BOOL fOpRedundant)
+{
+	UINT32 color = 0;
+	BYTE colorBytes[4] = { 0 };
+	HGDI_BRUSH brush = NULL;
+	INT32 left = INT32_MAX;
+	INT32 top = INT32_MAX;
+	INT32 right = INT32_MIN;
+	INT32 bottom = INT32_MIN;
+	BOOL rc = FALSE;
+
+	if (!context || !context->gdi || (!placements && (count > 0)))
+		return FALSE;
+
+	rdpGdi* gdi = context->gdi;
+
+	if (!gdi->drawing || !gdi->drawing->hdc)
+		return FALSE;
+
+	HGDI_DC hdc = gdi->drawing->hdc;
+	HGDI_BITMAP hBmp = (HGDI_BITMAP)hdc->selectedObject;
+
+	/* Glyphs of another class are drawn by their own Draw */
+	BOOL gdiGlyphs = TRUE;
+	for (size_t x = 0; x < count; x++)
+	{
+		if (placements[x].glyph->New != gdi_Glyph_New)
+			gdiGlyphs = FALSE;
+	}
+
+	if (!gdiGlyphs || !hBmp || (FreeRDPGetBytesPerPixel(hdc->format) != sizeof(color)))
+	{
+		for (size_t x = 0; x < count; x++)
+		{
+			const GLYPH_PLACEMENT* p = &placements[x];
+			if (!p->glyph->Draw(context, p->glyph, p->x, p->y, p->width, p->height, p->sx, p->sy,
+			                    fOpRedundant))
+				return FALSE;
+		}
+
+		return TRUE;
+	}
+
+	/* the text color as stored in the surface, masks only contain 0x00 and 0xFF so the
+	 * result is the same as with the GDI_GLYPH_ORDER raster operation */
+	if (!FreeRDPWriteColor(colorBytes, hdc->format, hdc->textColor))
+		return FALSE;
+	memcpy(&color, colorBytes, sizeof(color));
+
+	if (!fOpRedundant)
+	{
+		brush = gdi_CreateSolidBrush(hdc->bkColor);
+
+		if (!brush)
+			return FALSE;
+	}
+
+	const primitives_t* prims = primitives_get();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const GLYPH_PLACEMENT* p = &placements[i];
+		const gdiGlyph* gdi_glyph = (const gdiGlyph*)p->glyph;
+		INT32 x = p->x;
+		INT32 y = p->y;
+		INT32 w = p->width;
+		INT32 h = p->height;
+		INT32 sx = p->sx;
+		INT32 sy = p->sy;
+
+		if (!gdi_glyph)
+			goto fail;
+
+		if (brush)
+		{
+			GDI_RECT rect = { 0 };
+
+			if (x > 0)
+				rect.left = x;
+
+			if (y > 0)
+				rect.top = y;
+
+			if (x + w > 0)
+				rect.right = x + w - 1;
+
+			if (y + h > 0)
+				rect.bottom = y + h - 1;
+
+			if ((rect.left < rect.right) && (rect.top < rect.bottom))
+				gdi_FillRect(hdc, &rect, brush);
+		}
+
+		if (!gdi_ClipCoords(hdc, &x, &y, &w, &h, &sx, &sy) || (w <= 0) || (h <= 0))
+			continue;
+
+		const HGDI_BITMAP mask = gdi_glyph->bitmap;
+
+		/* source rectangles outside of the glyph are adjusted by gdi_BitBlt */
+		if ((sx < 0) || (sy < 0) || (sx + w > mask->width) || (sy + h > mask->height))
+		{
+			if (!gdi_Glyph_Draw(context, p->glyph, p->x, p->y, p->width, p->height, p->sx, p->sy,
+			                    TRUE))
+				goto fail;
+			continue;
+		}
+
+		const size_t maskOffset = 1ull * mask->scanline * WINPR_ASSERTING_INT_CAST(UINT32, sy) +
+		                          WINPR_ASSERTING_INT_CAST(UINT32, sx);
+		const size_t dstOffset = 1ull * hBmp->scanline * WINPR_ASSERTING_INT_CAST(UINT32, y) +
+		                         4ull * WINPR_ASSERTING_INT_CAST(UINT32, x);
+		const BYTE* pMask = &mask->data[maskOffset];
+		BYTE* pDst = &hBmp->data[dstOffset];
+
+		if (prims->alphaMask_8u_C4R(pMask, mask->scanline, color, pDst, hBmp->scanline,
+		                            WINPR_ASSERTING_INT_CAST(UINT32, w),
+		                            WINPR_ASSERTING_INT_CAST(UINT32, h)) != PRIMITIVES_SUCCESS)
+			goto fail;
+
+		left = MIN(left, x);
+		top = MIN(top, y);
+		right = MAX(right, x + w);
+		bottom = MAX(bottom, y + h);
+	}
+
+	if ((left < right) && (top < bottom))
+	{
+		if (!gdi_InvalidateRegion(hdc, left, top, right - left, bottom - top))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	gdi_DeleteObject((HGDIOBJECT)brush);
+	return rc;
+}
+
 static BOOL gdi_Glyph_BeginDraw(rdpContext* context, INT32 x, INT32 y, INT32 width, INT32 height,
                                 UINT32 bgcolor, UINT32 fgcolor, BOOL fOpRedundant)
 {
@@ -465,6 +641,7 @@ BOOL gdi_register_graphics(rdpGraphics* graphics)
 	glyph.Draw = gdi_Glyph_Draw;
 	glyph.BeginDraw = gdi_Glyph_BeginDraw;
 	glyph.EndDraw = gdi_Glyph_EndDraw;
+	glyph.DrawRun = gdi_Glyph_DrawRun;
 	graphics_register_glyph(graphics, &glyph);
 	return TRUE;
 }
@@ -0,0 +1,240 @@
+#include <freerdp/config.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/gfx.h>
+#include <freerdp/client/rdpgfx.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/interlocked.h>
+
+#define TEST_SURFACES 3
+#define TEST_SIZE 64
+#define TEST_FRAMES 8
+#define TEST_COMMANDS 4
+#define TEST_DELETED 1
+
+typedef struct
+{
+	void* surfaces[TEST_SURFACES];
+	LONG lateUpdates; /* decodes that published into a deleted surface */
+} TestGfx;
+
+static UINT test_set_surface_data(RdpgfxClientContext* context, UINT16 surfaceId, void* pData)
+{
+	TestGfx* test = context->handle;
+
+	if (surfaceId >= TEST_SURFACES)
+		return ERROR_INVALID_INDEX;
+
+	test->surfaces[surfaceId] = pData;
+	return CHANNEL_RC_OK;
+}
+
+static void* test_get_surface_data(RdpgfxClientContext* context, UINT16 surfaceId)
+{
+	TestGfx* test = context->handle;
+
+	if (surfaceId >= TEST_SURFACES)
+		return NULL;
+	return test->surfaces[surfaceId];
+}
+
+static UINT test_get_surface_ids(RdpgfxClientContext* context, UINT16** ppSurfaceIds,
+                                 UINT16* count)
+{
+	TestGfx* test = context->handle;
+	UINT16* ids = calloc(TEST_SURFACES, sizeof(UINT16));
+
+	*count = 0;
+	*ppSurfaceIds = ids;
+	if (!ids)
+		return CHANNEL_RC_NO_MEMORY;
+
+	for (UINT16 x = 0; x < TEST_SURFACES; x++)
+	{
+		if (test->surfaces[x])
+			ids[(*count)++] = x;
+	}
+	return CHANNEL_RC_OK;
+}
+
+/* called by the decodes under the pipeline mux */
+static UINT test_update_surface_area(RdpgfxClientContext* context, UINT16 surfaceId,
+                                     UINT32 nrRects, const RECTANGLE_16* rects)
+{
+	TestGfx* test = context->handle;
+
+	WINPR_UNUSED(nrRects);
+	WINPR_UNUSED(rects);
+
+	if (!test_get_surface_data(context, surfaceId))
+		(void)InterlockedIncrement(&test->lateUpdates);
+	return CHANNEL_RC_OK;
+}
+
+static BOOL create_surface(RdpgfxClientContext* gfx, UINT16 surfaceId)
+{
+	const RDPGFX_CREATE_SURFACE_PDU create = { surfaceId, TEST_SIZE, TEST_SIZE,
+		                                       GFX_PIXEL_FORMAT_XRGB_8888 };
+	return gfx->CreateSurface(gfx, &create) == CHANNEL_RC_OK;
+}
+
+static BOOL delete_surface(RdpgfxClientContext* gfx, UINT16 surfaceId)
+{
+	const RDPGFX_DELETE_SURFACE_PDU pdu = { surfaceId };
+
+	if (gfx->DeleteSurface(gfx, &pdu) != CHANNEL_RC_OK)
+		return FALSE;
+	return gfx->GetSurfaceData(gfx, surfaceId) == NULL;
+}
+
+/* The bitstream does not decode, the commands are still queued and run on the pool */
+static BOOL send_avc420(RdpgfxClientContext* gfx, UINT16 surfaceId, UINT32 frameId)
+{
+	BYTE data[512] = { 0x00, 0x00, 0x00, 0x01 };
+	RECTANGLE_16 rect = { 0 };
+	RDPGFX_AVC420_BITMAP_STREAM bs = { 0 };
+	RDPGFX_SURFACE_COMMAND cmd = { 0 };
+
+	winpr_RAND(&data[4], sizeof(data) - 4);
+	rect.left = (UINT16)(frameId % 16);
+	rect.top = (UINT16)(surfaceId * 8);
+	rect.right = TEST_SIZE;
+	rect.bottom = TEST_SIZE;
+
+	bs.meta.numRegionRects = 1;
+	bs.meta.regionRects = &rect;
+	bs.length = sizeof(data);
+	bs.data = data;
+
+	cmd.surfaceId = surfaceId;
+	cmd.codecId = RDPGFX_CODECID_AVC420;
+	cmd.format = PIXEL_FORMAT_BGRX32;
+	cmd.right = TEST_SIZE;
+	cmd.bottom = TEST_SIZE;
+	cmd.width = TEST_SIZE;
+	cmd.height = TEST_SIZE;
+	cmd.length = sizeof(data);
+	cmd.data = data;
+	cmd.extra = &bs;
+
+	const UINT rc = gfx->SurfaceCommand(gfx, &cmd);
+#if defined(WITH_GFX_H264)
+	return rc == CHANNEL_RC_OK;
+#else
+	return rc == ERROR_NOT_SUPPORTED;
+#endif
+}
+
+static BOOL send_frames(RdpgfxClientContext* gfx, TestGfx* test)
+{
+	for (UINT32 frameId = 1; frameId <= TEST_FRAMES; frameId++)
+	{
+		const RDPGFX_START_FRAME_PDU start = { 0, frameId };
+		const RDPGFX_END_FRAME_PDU end = { frameId };
+
+		if (gfx->StartFrame(gfx, &start) != CHANNEL_RC_OK)
+			return FALSE;
+
+		for (UINT32 x = 0; x < TEST_COMMANDS; x++)
+		{
+			for (UINT16 surfaceId = 0; surfaceId < TEST_SURFACES; surfaceId++)
+			{
+				if (test->surfaces[surfaceId] && !send_avc420(gfx, surfaceId, frameId))
+					return FALSE;
+			}
+		}
+
+		/* the decodes of the surface are still queued or running */
+		if ((frameId == 3) && !delete_surface(gfx, TEST_DELETED))
+			return FALSE;
+
+		/* a surface with the same id gets a new decode queue */
+		if ((frameId == 6) && !create_surface(gfx, TEST_DELETED))
+			return FALSE;
+
+		/* decode errors are reported here, the bitstream is not valid */
+		(void)gfx->EndFrame(gfx, &end);
+	}
+
+	return TRUE;
+}
+
+int TestGdiGfxDecode(int argc, char* argv[])
+{
+	int rc = -1;
+	TestGfx test = { 0 };
+	rdpContext* context = NULL;
+	RdpgfxClientContext* gfx = NULL;
+	BOOL initialized = FALSE;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	freerdp* instance = freerdp_new();
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	context = instance->context;
+	if (!freerdp_settings_set_uint32(context->settings, FreeRDP_DesktopWidth, 800) ||
+	    !freerdp_settings_set_uint32(context->settings, FreeRDP_DesktopHeight, 600) ||
+	    !freerdp_settings_set_uint32(context->settings, FreeRDP_ColorDepth, 32))
+		goto fail;
+
+	if (!gdi_init(instance, PIXEL_FORMAT_BGRX32))
+		goto fail;
+
+	gfx = calloc(1, sizeof(RdpgfxClientContext));
+	if (!gfx)
+		goto fail;
+
+	gfx->handle = &test;
+	gfx->GetSurfaceIds = test_get_surface_ids;
+	gfx->SetSurfaceData = test_set_surface_data;
+	gfx->GetSurfaceData = test_get_surface_data;
+
+	if (!gdi_graphics_pipeline_init_ex(context->gdi, gfx, NULL, NULL, test_update_surface_area))
+		goto fail;
+	initialized = TRUE;
+
+	for (UINT16 surfaceId = 0; surfaceId < TEST_SURFACES; surfaceId++)
+	{
+		if (!create_surface(gfx, surfaceId))
+			goto fail;
+	}
+
+	if (!send_frames(gfx, &test))
+	{
+		printf("surface commands failed\n");
+		goto fail;
+	}
+
+	if (test.lateUpdates != 0)
+	{
+		printf("%" PRId32 " decodes finished after their surface was deleted\n",
+		       test.lateUpdates);
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	if (initialized)
+	{
+		for (UINT16 surfaceId = 0; surfaceId < TEST_SURFACES; surfaceId++)
+		{
+			if (test.surfaces[surfaceId])
+				(void)delete_surface(gfx, surfaceId);
+		}
+		gdi_graphics_pipeline_uninit(context->gdi, gfx);
+	}
+	free(gfx);
+	if (instance)
+	{
+		gdi_free(instance);
+		freerdp_context_free(instance);
+	}
+	freerdp_free(instance);
+	return rc;
+}
@@ -0,0 +1,231 @@
+#include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#define TEST_WIDTH 800
+#define TEST_HEIGHT 600
+#define TEST_CACHE_ID 3
+#define TEST_GLYPHS 96
+#define TEST_LINES 40
+#define TEST_LINE_HEIGHT 15
+
+static pGlyph_Draw gdiDraw = NULL;
+static size_t clientDraws = 0;
+
+/* Draw of a client glyph class copied from the gdi one */
+static BOOL client_glyph_draw(rdpContext* context, const rdpGlyph* glyph, INT32 x, INT32 y,
+                              INT32 w, INT32 h, INT32 sx, INT32 sy, BOOL fOpRedundant)
+{
+	clientDraws++;
+	return gdiDraw(context, glyph, x, y, w, h, sx, sy, fOpRedundant);
+}
+
+static BOOL cache_glyphs(rdpContext* context, BYTE* data)
+{
+	BOOL rc = FALSE;
+	CACHE_GLYPH_ORDER* order = calloc(1, sizeof(CACHE_GLYPH_ORDER));
+
+	if (!order)
+		return FALSE;
+
+	order->cacheId = TEST_CACHE_ID;
+	order->cGlyphs = TEST_GLYPHS;
+
+	for (UINT32 x = 0; x < TEST_GLYPHS; x++)
+	{
+		GLYPH_DATA* glyph = &order->glyphData[x];
+		glyph->cacheIndex = x;
+		glyph->x = (INT16)(x % 2);
+		glyph->y = -12;
+		glyph->cx = 5 + x % 7;
+		glyph->cy = 12 + x % 5;
+		glyph->cb = (((glyph->cx + 7) / 8) * glyph->cy + 3) & ~3u;
+		glyph->aj = &data[32ull * x];
+		winpr_RAND(glyph->aj, glyph->cb);
+	}
+
+	rc = context->update->secondary->CacheGlyph(context, order);
+	free(order);
+	return rc;
+}
+
+/* one screen of text lines, drawn with all glyph orders and clipped at the screen edges */
+static BOOL replay_text(rdpContext* context)
+{
+	GLYPH_INDEX_ORDER index = { 0 };
+	FAST_GLYPH_ORDER fast = { 0 };
+
+	for (INT32 line = 0; line < TEST_LINES; line++)
+	{
+		const INT32 y = 8 + line * TEST_LINE_HEIGHT;
+		const INT32 left = (line % 5 == 4) ? TEST_WIDTH - 300 : 4 + line % 3;
+		const GLYPH_INDEX_ORDER empty = { 0 };
+
+		index = empty;
+		index.cacheId = TEST_CACHE_ID;
+		index.fOpRedundant = (line % 3) != 0;
+		index.backColor = 0xFF000000u | (UINT32)line * 0x050301u;
+		index.foreColor = 0xFFFFFFFFu - (UINT32)line * 0x010305u;
+		index.x = left;
+		index.y = y;
+		index.bkLeft = left;
+		index.bkTop = y - 12 + line % 4;
+		index.bkRight = TEST_WIDTH + 100;
+		index.bkBottom = y + 4 - line % 2;
+		index.opLeft = index.bkLeft;
+		index.opTop = index.bkTop;
+		index.opRight = index.bkRight;
+		index.opBottom = index.bkBottom;
+
+		if (line % 2 == 0)
+		{
+			/* proportional text with overlapping glyphs */
+			index.flAccel = SO_HORIZONTAL;
+			for (UINT32 x = 0; x + 2 <= ARRAYSIZE(index.data); x += 2)
+			{
+				index.data[x] = (BYTE)((line * 7 + x) % TEST_GLYPHS);
+				index.data[x + 1] = (BYTE)(4 + x % 5);
+			}
+		}
+		else
+		{
+			index.flAccel = SO_HORIZONTAL | SO_CHAR_INC_EQUAL_BM_BASE;
+			for (UINT32 x = 0; x < ARRAYSIZE(index.data); x++)
+				index.data[x] = (BYTE)((line * 3 + x) % TEST_GLYPHS);
+		}
+
+		index.cbData = ARRAYSIZE(index.data) - 2;
+
+		if (!context->update->primary->GlyphIndex(context, &index))
+			return FALSE;
+
+		const FAST_GLYPH_ORDER emptyFast = { 0 };
+		fast = emptyFast;
+		fast.cacheId = TEST_CACHE_ID;
+		fast.flAccel = SO_HORIZONTAL | SO_CHAR_INC_EQUAL_BM_BASE;
+		fast.backColor = index.foreColor;
+		fast.foreColor = index.backColor;
+		fast.x = TEST_WIDTH - 8 + line % 11;
+		fast.y = TEST_HEIGHT - 4 + line % 9;
+		fast.bkLeft = fast.x - 2;
+		fast.bkTop = fast.y - 14;
+		fast.bkRight = fast.x + 12;
+		fast.bkBottom = fast.y + 2;
+		fast.cbData = 1;
+		fast.data[0] = (BYTE)(line % TEST_GLYPHS);
+
+		if (!context->update->primary->FastGlyph(context, &fast))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL render(rdpContext* context, BYTE* result, UINT64* duration)
+{
+	rdpGdi* gdi = context->gdi;
+	const size_t size = 1ull * gdi->stride * gdi->height;
+
+	for (size_t x = 0; x < size; x++)
+		gdi->primary_buffer[x] = (BYTE)(x % 251);
+
+	const UINT64 start = winpr_GetTickCount64NS();
+
+	if (!replay_text(context))
+		return FALSE;
+
+	*duration = winpr_GetTickCount64NS() - start;
+	memcpy(result, gdi->primary_buffer, size);
+	return TRUE;
+}
+
+int TestGdiGlyph(int argc, char* argv[])
+{
+	int rc = -1;
+	BOOL res = FALSE;
+	rdpContext* context = NULL;
+	rdpGlyph* prototype = NULL;
+	pGlyph_DrawRun DrawRun = NULL;
+	BYTE* run = NULL;
+	BYTE* legacy = NULL;
+	UINT64 runTime = 0;
+	UINT64 legacyTime = 0;
+	BYTE data[32 * TEST_GLYPHS] = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	freerdp* instance = freerdp_new();
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	context = instance->context;
+	if (!freerdp_settings_set_uint32(context->settings, FreeRDP_DesktopWidth, TEST_WIDTH) ||
+	    !freerdp_settings_set_uint32(context->settings, FreeRDP_DesktopHeight, TEST_HEIGHT) ||
+	    !freerdp_settings_set_uint32(context->settings, FreeRDP_ColorDepth, 32))
+		goto fail;
+
+	if (!gdi_init(instance, PIXEL_FORMAT_BGRX32))
+		goto fail;
+
+	if (!cache_glyphs(context, data))
+		goto fail;
+
+	run = calloc(1ull * context->gdi->stride, context->gdi->height);
+	legacy = calloc(1ull * context->gdi->stride, context->gdi->height);
+	if (!run || !legacy)
+		goto fail;
+
+	if (!render(context, run, &runTime))
+		goto fail;
+
+	/* cached glyphs draw one by one with the raster operation without a run callback */
+	prototype = context->graphics->Glyph_Prototype;
+	DrawRun = prototype->DrawRun;
+	prototype->DrawRun = NULL;
+	res = render(context, legacy, &legacyTime);
+	prototype->DrawRun = DrawRun;
+	if (!res)
+		goto fail;
+
+	printf("%d lines of text: glyph runs %" PRIu64 "us, single glyphs %" PRIu64 "us\n",
+	       TEST_LINES, runTime / 1000, legacyTime / 1000);
+
+	if (memcmp(run, legacy, 1ull * context->gdi->stride * context->gdi->height) != 0)
+	{
+		printf("glyph runs differ from single glyphs\n");
+		goto fail;
+	}
+
+	/* a class copied from the gdi one with its own Draw must not get the gdi glyph runs */
+	{
+		rdpGlyph client = *prototype;
+		gdiDraw = client.Draw;
+		client.Draw = client_glyph_draw;
+		graphics_register_glyph(context->graphics, &client);
+	}
+
+	if (!cache_glyphs(context, data) || !render(context, legacy, &legacyTime))
+		goto fail;
+
+	if ((clientDraws == 0) || context->graphics->Glyph_Prototype->DrawRun)
+	{
+		printf("the glyphs of the client class were not drawn by it\n");
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	free(run);
+	free(legacy);
+	if (instance)
+	{
+		gdi_free(instance);
+		freerdp_context_free(instance);
+	}
+	freerdp_free(instance);
+	return rc;
+}
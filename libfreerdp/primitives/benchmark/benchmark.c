@@ -20,9 +20,22 @@
 
 #include <stdio.h>
 
+#include <freerdp/config.h>
+
 #include <winpr/crypto.h>
 #include <winpr/sysinfo.h>
 #include <freerdp/primitives.h>
+#include <freerdp/codec/color.h>
+
+#if defined(WITH_SWSCALE)
+#include <libswscale/swscale.h>
+#endif
+
+/* smart sizing a 4k desktop to a 1440p window */
+#define SCALE_SRC_WIDTH 3840
+#define SCALE_SRC_HEIGHT 2160
+#define SCALE_DST_WIDTH 2560
+#define SCALE_DST_HEIGHT 1440
 
 typedef struct
 {
@@ -198,6 +211,70 @@ static BOOL primitives_RGB2444_benchmark_run(primitives_YUV_benchmark* bench, pr
 	return TRUE;
 }
 
+static BOOL primitives_scale_benchmark_run(primitives_YUV_benchmark* bench, primitives_t* prims,
+                                           prim_scale_filter filter, const char* name)
+{
+	for (size_t x = 0; x < 10; x++)
+	{
+		const UINT64 start = winpr_GetTickCount64NS();
+		pstatus_t status = prims->scale_8u_C4R(bench->rgbBuffer, bench->outputStride,
+		                                       SCALE_SRC_WIDTH, SCALE_SRC_HEIGHT,
+		                                       bench->outputBuffer, bench->outputStride,
+		                                       SCALE_DST_WIDTH, SCALE_DST_HEIGHT, NULL, filter);
+		const UINT64 end = winpr_GetTickCount64NS();
+		if (status != PRIMITIVES_SUCCESS)
+		{
+			(void)fprintf(stderr, "Running scale_8u_C4R failed\n");
+			return FALSE;
+		}
+		const UINT64 diff = end - start;
+		char buffer[32] = { 0 };
+		printf("[%" PRIuz "] scale_8u_C4R %s %dx%d -> %dx%d took %sns\n", x, name,
+		       SCALE_SRC_WIDTH, SCALE_SRC_HEIGHT, SCALE_DST_WIDTH, SCALE_DST_HEIGHT,
+		       print_time(diff, buffer, sizeof(buffer)));
+	}
+
+	return TRUE;
+}
+
+#if defined(WITH_SWSCALE)
+/* the way freerdp_image_scale uses swscale, for comparison */
+static BOOL swscale_benchmark_run(primitives_YUV_benchmark* bench)
+{
+	for (size_t x = 0; x < 10; x++)
+	{
+		const BYTE* src = bench->rgbBuffer;
+		BYTE* dst = bench->outputBuffer;
+		const int step[1] = { (int)bench->outputStride };
+
+		const UINT64 start = winpr_GetTickCount64NS();
+		struct SwsContext* resize =
+		    sws_getContext(SCALE_SRC_WIDTH, SCALE_SRC_HEIGHT, AV_PIX_FMT_BGRA, SCALE_DST_WIDTH,
+		                   SCALE_DST_HEIGHT, AV_PIX_FMT_BGRA, SWS_BILINEAR, NULL, NULL, NULL);
+		if (!resize)
+		{
+			(void)fprintf(stderr, "sws_getContext failed\n");
+			return FALSE;
+		}
+		const int res = sws_scale(resize, &src, step, 0, SCALE_SRC_HEIGHT, &dst, step);
+		sws_freeContext(resize);
+		const UINT64 end = winpr_GetTickCount64NS();
+		if (res != SCALE_DST_HEIGHT)
+		{
+			(void)fprintf(stderr, "Running sws_scale failed\n");
+			return FALSE;
+		}
+		const UINT64 diff = end - start;
+		char buffer[32] = { 0 };
+		printf("[%" PRIuz "] sws_scale bilinear %dx%d -> %dx%d took %sns\n", x,
+		       SCALE_SRC_WIDTH, SCALE_SRC_HEIGHT, SCALE_DST_WIDTH, SCALE_DST_HEIGHT,
+		       print_time(diff, buffer, sizeof(buffer)));
+	}
+
+	return TRUE;
+}
+#endif
+
 int main(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -245,7 +322,28 @@ int main(int argc, char* argv[])
 			goto fail;
 		}
 		printf("\n");
+
+		const prim_scale_filter filters[] = { PRIM_SCALE_BILINEAR, PRIM_SCALE_BICUBIC,
+			                                  PRIM_SCALE_BOX };
+		const char* names[] = { "bilinear", "bicubic", "box" };
+		for (size_t x = 0; x < ARRAYSIZE(filters); x++)
+		{
+			printf("Running %s scale benchmark on %s implementation:\n", names[x], hintstr);
+			if (!primitives_scale_benchmark_run(&bench, prim, filters[x], names[x]))
+			{
+				(void)fprintf(stderr, "%s scale benchmark failed\n", names[x]);
+				goto fail;
+			}
+			printf("\n");
+		}
 	}
+
+#if defined(WITH_SWSCALE)
+	printf("Running bilinear scale benchmark on swscale:\n");
+	if (!swscale_benchmark_run(&bench))
+		(void)fprintf(stderr, "swscale benchmark failed\n");
+	printf("\n");
+#endif
 fail:
 	primitives_YUV_benchmark_free(&bench);
 	return 0;
@@ -0,0 +1,108 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized alpha blending routines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include "prim_internal.h"
+#include "prim_alphaComp.h"
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+static primitives_t* generic = NULL;
+
+/* blend 8 pixel bytes with their alphas, as prim_alpha_mask_blend */
+static inline uint8x8_t neon_alphaMask_blend(uint8x8_t color, uint8x8_t dst, uint8x8_t alpha)
+{
+	uint16x8_t t = vmull_u8(color, alpha);
+	t = vmlal_u8(t, dst, vmvn_u8(alpha));
+	t = vaddq_u16(t, vdupq_n_u16(0x80));
+	return vshrn_n_u16(vsraq_n_u16(t, t, 8), 8);
+}
+
+static pstatus_t neon_alphaMask_8u_C4R(const BYTE* WINPR_RESTRICT pMask, UINT32 maskStep,
+                                       UINT32 color, BYTE* WINPR_RESTRICT pDst, UINT32 dstStep,
+                                       UINT32 width, UINT32 height)
+{
+	const uint8x16_t fill = vreinterpretq_u8_u32(vdupq_n_u32(color));
+
+	for (size_t y = 0; y < height; y++)
+	{
+		const BYTE* mask = &pMask[y * maskStep];
+		BYTE* dst = &pDst[y * dstStep];
+		size_t x = 0;
+
+		/* 4 pixels at a time, runs of empty or fully covered pixels are skipped or filled */
+		for (; x + 4 <= width; x += 4)
+		{
+			UINT32 alphas = 0;
+			memcpy(&alphas, &mask[x], sizeof(alphas));
+
+			if (alphas == 0)
+				continue;
+
+			if (alphas == UINT32_MAX)
+			{
+				vst1q_u8(&dst[x * 4], fill);
+				continue;
+			}
+
+			/* a0a0a0a0 a1a1a1a1 a2a2a2a2 a3a3a3a3 */
+			const uint8x8_t m = vreinterpret_u8_u32(vdup_n_u32(alphas));
+			const uint8x8x2_t m2 = vzip_u8(m, m);
+			const uint16x4x2_t m4 =
+			    vzip_u16(vreinterpret_u16_u8(m2.val[0]), vreinterpret_u16_u8(m2.val[0]));
+
+			const uint8x16_t d = vld1q_u8(&dst[x * 4]);
+			const uint8x8_t lo = neon_alphaMask_blend(vget_low_u8(fill), vget_low_u8(d),
+			                                          vreinterpret_u8_u16(m4.val[0]));
+			const uint8x8_t hi = neon_alphaMask_blend(vget_high_u8(fill), vget_high_u8(d),
+			                                          vreinterpret_u8_u16(m4.val[1]));
+			vst1q_u8(&dst[x * 4], vcombine_u8(lo, hi));
+		}
+
+		if (x < width)
+		{
+			const pstatus_t status = generic->alphaMask_8u_C4R(
+			    &mask[x], maskStep, color, &dst[x * 4], dstStep,
+			    WINPR_ASSERTING_INT_CAST(UINT32, width - x), 1);
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_alphaComp_neon_int(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(NEON_INTRINSICS_ENABLED)
+	generic = primitives_get_generic();
+	WLog_VRB(PRIM_TAG, "NEON optimizations");
+	prims->alphaMask_8u_C4R = neon_alphaMask_8u_C4R;
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or neon intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
@@ -0,0 +1,124 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized image scaling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include "prim_internal.h"
+#include "prim_scale.h"
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+/* (acc + round) >> bits, saturated to 0..255 like prim_scale_clamp */
+static inline uint8x8_t neon_scale_narrow(int32x4_t lo, int32x4_t hi)
+{
+	const int16x8_t res = vcombine_s16(vqmovn_s32(vrshrq_n_s32(lo, PRIM_SCALE_BITS)),
+	                                   vqmovn_s32(vrshrq_n_s32(hi, PRIM_SCALE_BITS)));
+	return vqmovun_s16(res);
+}
+
+static void neon_scale_row_h(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                             const prim_scale_axis* WINPR_RESTRICT axis)
+{
+	for (UINT32 x = 0; x < axis->count; x++)
+	{
+		const BYTE* s = &src[4ull * axis->start[x]];
+		const INT16* w = &axis->weights[1ull * x * axis->taps];
+		int32x4_t acc = vdupq_n_s32(0);
+		UINT32 t = 0;
+
+		for (; t + 1 < axis->taps; t += 2)
+		{
+			const int16x8_t px = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&s[4ull * t])));
+			acc = vmlal_n_s16(acc, vget_low_s16(px), w[t]);
+			acc = vmlal_n_s16(acc, vget_high_s16(px), w[t + 1]);
+		}
+
+		if (t < axis->taps)
+		{
+			UINT32 val = 0;
+			memcpy(&val, &s[4ull * t], sizeof(val));
+			const uint8x8_t raw = vreinterpret_u8_u32(vdup_n_u32(val));
+			const int16x8_t px = vreinterpretq_s16_u16(vmovl_u8(raw));
+			acc = vmlal_n_s16(acc, vget_low_s16(px), w[t]);
+		}
+
+		const uint8x8_t res = neon_scale_narrow(acc, acc);
+		const UINT32 val = vget_lane_u32(vreinterpret_u32_u8(res), 0);
+		memcpy(&dst[4ull * x], &val, sizeof(val));
+	}
+}
+
+static void neon_scale_row_v(const BYTE* const* WINPR_RESTRICT rows,
+                             const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                             BYTE* WINPR_RESTRICT dst, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16)
+	{
+		int32x4_t acc0 = vdupq_n_s32(0);
+		int32x4_t acc1 = vdupq_n_s32(0);
+		int32x4_t acc2 = vdupq_n_s32(0);
+		int32x4_t acc3 = vdupq_n_s32(0);
+
+		for (UINT32 t = 0; t < taps; t++)
+		{
+			const uint8x16_t px = vld1q_u8(&rows[t][i]);
+			const int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(px)));
+			const int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(px)));
+
+			acc0 = vmlal_n_s16(acc0, vget_low_s16(lo), weights[t]);
+			acc1 = vmlal_n_s16(acc1, vget_high_s16(lo), weights[t]);
+			acc2 = vmlal_n_s16(acc2, vget_low_s16(hi), weights[t]);
+			acc3 = vmlal_n_s16(acc3, vget_high_s16(hi), weights[t]);
+		}
+
+		vst1q_u8(&dst[i],
+		         vcombine_u8(neon_scale_narrow(acc0, acc1), neon_scale_narrow(acc2, acc3)));
+	}
+
+	generic_scale_row_v(rows, weights, taps, dst, i, len);
+}
+
+static pstatus_t neon_scale_8u_C4R(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                   UINT32 srcWidth, UINT32 srcHeight, BYTE* WINPR_RESTRICT pDst,
+                                   UINT32 dstStep, UINT32 dstWidth, UINT32 dstHeight,
+                                   const RECTANGLE_16* WINPR_RESTRICT rect,
+                                   prim_scale_filter filter)
+{
+	return generic_scale_8u_C4R_ex(pSrc, srcStep, srcWidth, srcHeight, pDst, dstStep, dstWidth,
+	                               dstHeight, rect, filter, neon_scale_row_h, neon_scale_row_v);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_scale_neon_int(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(NEON_INTRINSICS_ENABLED)
+	WLog_VRB(PRIM_TAG, "NEON optimizations");
+	prims->scale_8u_C4R = neon_scale_8u_C4R;
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or neon intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
@@ -21,6 +21,8 @@
 
 #include <freerdp/config.h>
 
+#include <string.h>
+
 #include <freerdp/types.h>
 #include <freerdp/primitives.h>
 
@@ -85,14 +87,52 @@ static pstatus_t general_alphaComp_argb(const BYTE* WINPR_RESTRICT pSrc1, UINT32
 	return PRIMITIVES_SUCCESS;
 }
 
+/* ------------------------------------------------------------------------- */
+static pstatus_t general_alphaMask_8u_C4R(const BYTE* WINPR_RESTRICT pMask, UINT32 maskStep,
+                                          UINT32 color, BYTE* WINPR_RESTRICT pDst,
+                                          UINT32 dstStep, UINT32 width, UINT32 height)
+{
+	BYTE bytes[4] = { 0 };
+	memcpy(bytes, &color, sizeof(bytes));
+
+	for (size_t y = 0; y < height; y++)
+	{
+		const BYTE* mask = &pMask[y * maskStep];
+		BYTE* dst = &pDst[y * dstStep];
+
+		for (size_t x = 0; x < width; x++)
+		{
+			const BYTE alpha = mask[x];
+			BYTE* pixel = &dst[x * 4];
+
+			/* glyphs are mostly fully covered or empty pixels */
+			if (alpha == 0)
+				continue;
+
+			if (alpha == 0xFF)
+			{
+				memcpy(pixel, bytes, sizeof(bytes));
+				continue;
+			}
+
+			for (size_t c = 0; c < sizeof(bytes); c++)
+				pixel[c] = prim_alpha_mask_blend(bytes[c], pixel[c], alpha);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
 /* ------------------------------------------------------------------------- */
 void primitives_init_alphaComp(primitives_t* WINPR_RESTRICT prims)
 {
 	prims->alphaComp_argb = general_alphaComp_argb;
+	prims->alphaMask_8u_C4R = general_alphaMask_8u_C4R;
 }
 
 void primitives_init_alphaComp_opt(primitives_t* WINPR_RESTRICT prims)
 {
 	primitives_init_alphaComp(prims);
 	primitives_init_alphaComp_sse3(prims);
+	primitives_init_alphaComp_neon(prims);
 }
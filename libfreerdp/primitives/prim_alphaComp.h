@@ -29,6 +29,14 @@
 
 #include "prim_internal.h"
 
+/* (color * alpha + dst * (255 - alpha)) / 255, rounded; exact for every input and also what the
+ * 16 bit lanes of the vector versions compute, the sum fits 16 bits */
+static inline BYTE prim_alpha_mask_blend(BYTE color, BYTE dst, BYTE alpha)
+{
+	const UINT32 t = 1u * color * alpha + 1u * dst * (255u - alpha) + 128u;
+	return (BYTE)((t + (t >> 8)) >> 8);
+}
+
 FREERDP_LOCAL void primitives_init_alphaComp_sse3_int(primitives_t* WINPR_RESTRICT prims);
 static inline void primitives_init_alphaComp_sse3(primitives_t* WINPR_RESTRICT prims)
 {
@@ -39,4 +47,13 @@ static inline void primitives_init_alphaComp_sse3(primitives_t* WINPR_RESTRICT p
 	primitives_init_alphaComp_sse3_int(prims);
 }
 
+FREERDP_LOCAL void primitives_init_alphaComp_neon_int(primitives_t* WINPR_RESTRICT prims);
+static inline void primitives_init_alphaComp_neon(primitives_t* WINPR_RESTRICT prims)
+{
+	if (!IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	primitives_init_alphaComp_neon_int(prims);
+}
+
 #endif
@@ -0,0 +1,302 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Primitives image scaling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_scale.h"
+
+/* Kernel weight of a source pixel at distance x (in source pixels) from the sampling point.
+ * fs is the filter scale, the kernels are widened when scaling down to average all covered
+ * pixels instead of skipping some. */
+static double scale_kernel(prim_scale_filter filter, double x, double fs)
+{
+	const double t = fabs(x) / fs;
+
+	switch (filter)
+	{
+		case PRIM_SCALE_BILINEAR:
+			return (t < 1.0) ? 1.0 - t : 0.0;
+
+		case PRIM_SCALE_BICUBIC:
+			if (t < 1.0)
+				return (1.5 * t - 2.5) * t * t + 1.0;
+			if (t < 2.0)
+				return ((-0.5 * t + 2.5) * t - 4.0) * t + 2.0;
+			return 0.0;
+
+		case PRIM_SCALE_BOX:
+		{
+			/* coverage of the source pixel by the footprint of the destination pixel */
+			const double lo = MAX(x - 0.5, -fs / 2.0);
+			const double hi = MIN(x + 0.5, fs / 2.0);
+			return (hi > lo) ? hi - lo : 0.0;
+		}
+
+		default:
+			return 0.0;
+	}
+}
+
+static double scale_radius(prim_scale_filter filter, double fs)
+{
+	switch (filter)
+	{
+		case PRIM_SCALE_BILINEAR:
+			return fs;
+		case PRIM_SCALE_BICUBIC:
+			return 2.0 * fs;
+		case PRIM_SCALE_BOX:
+			return (fs + 1.0) / 2.0;
+		default:
+			return -1.0;
+	}
+}
+
+static void scale_axis_free(prim_scale_axis* axis)
+{
+	WINPR_ASSERT(axis);
+
+	free(axis->start);
+	free(axis->weights);
+
+	const prim_scale_axis empty = { 0 };
+	*axis = empty;
+}
+
+/* Build the filter for the output coordinates [first, last) */
+static BOOL scale_axis_init(prim_scale_axis* axis, UINT32 srcSize, UINT32 dstSize, UINT32 first,
+                            UINT32 last, prim_scale_filter filter)
+{
+	BOOL rc = FALSE;
+	double* w = NULL;
+
+	WINPR_ASSERT(axis);
+	WINPR_ASSERT(srcSize > 0);
+	WINPR_ASSERT(dstSize > 0);
+	WINPR_ASSERT(first < last);
+
+	const double scale = 1.0 * srcSize / dstSize;
+	const double fs = MAX(scale, 1.0);
+	const double radius = scale_radius(filter, fs);
+	if (radius <= 0.0)
+		return FALSE;
+
+	const UINT32 span = (UINT32)ceil(2.0 * radius) + 1;
+	const UINT32 taps = MIN(span, srcSize);
+	axis->taps = taps;
+	axis->count = last - first;
+	axis->start = calloc(axis->count, sizeof(UINT32));
+	axis->weights = calloc(1ull * axis->count * taps, sizeof(INT16));
+	w = calloc(taps, sizeof(double));
+	if (!axis->start || !axis->weights || !w)
+		goto fail;
+
+	for (UINT32 i = 0; i < axis->count; i++)
+	{
+		const double center = (first + i + 0.5) * scale - 0.5;
+		const INT64 lo = (INT64)ceil(center - radius);
+		const INT64 start = MIN(MAX(lo, 0), (INT64)(srcSize - taps));
+		INT16* weights = &axis->weights[1ull * i * taps];
+		double sum = 0.0;
+
+		for (UINT32 t = 0; t < taps; t++)
+			w[t] = 0.0;
+
+		for (INT64 j = lo; (j <= center + radius) && (j < lo + span); j++)
+		{
+			const double k = scale_kernel(filter, (double)j - center, fs);
+			const INT64 idx = MIN(MAX(j, 0), (INT64)srcSize - 1);
+
+			if ((k == 0.0) || (idx < start) || (idx >= start + taps))
+				continue;
+
+			w[idx - start] += k;
+			sum += k;
+		}
+
+		if (sum == 0.0)
+		{
+			const INT64 idx = MIN(MAX(llround(center), 0), (INT64)srcSize - 1);
+			w[idx - start] = 1.0;
+			sum = 1.0;
+		}
+
+		/* Quantize and hand the rounding error to the largest tap so that every set of
+		 * weights adds up to exactly one and flat areas keep their color. */
+		INT32 total = 0;
+		UINT32 largest = 0;
+		for (UINT32 t = 0; t < taps; t++)
+		{
+			weights[t] = (INT16)lround(w[t] / sum * PRIM_SCALE_ONE);
+			total += weights[t];
+			if (fabs(w[t]) > fabs(w[largest]))
+				largest = t;
+		}
+		weights[largest] = (INT16)(weights[largest] + PRIM_SCALE_ONE - total);
+		axis->start[i] = (UINT32)start;
+	}
+
+	rc = TRUE;
+fail:
+	free(w);
+	if (!rc)
+		scale_axis_free(axis);
+	return rc;
+}
+
+static void generic_scale_row_h(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                const prim_scale_axis* WINPR_RESTRICT axis)
+{
+	for (UINT32 x = 0; x < axis->count; x++)
+	{
+		const BYTE* s = &src[4ull * axis->start[x]];
+		const INT16* w = &axis->weights[1ull * x * axis->taps];
+		INT32 acc[4] = { 0 };
+
+		for (UINT32 t = 0; t < axis->taps; t++)
+		{
+			for (size_t c = 0; c < 4; c++)
+				acc[c] += w[t] * s[4ull * t + c];
+		}
+
+		for (size_t c = 0; c < 4; c++)
+			dst[4ull * x + c] = prim_scale_clamp(acc[c]);
+	}
+}
+
+void generic_scale_row_v(const BYTE* const* WINPR_RESTRICT rows,
+                         const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                         BYTE* WINPR_RESTRICT dst, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		INT32 acc = 0;
+
+		for (UINT32 t = 0; t < taps; t++)
+			acc += weights[t] * rows[t][i];
+
+		dst[i] = prim_scale_clamp(acc);
+	}
+}
+
+static void generic_scale_row_v_full(const BYTE* const* WINPR_RESTRICT rows,
+                                     const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                     BYTE* WINPR_RESTRICT dst, size_t len)
+{
+	generic_scale_row_v(rows, weights, taps, dst, 0, len);
+}
+
+pstatus_t generic_scale_8u_C4R_ex(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                  UINT32 srcWidth, UINT32 srcHeight, BYTE* WINPR_RESTRICT pDst,
+                                  UINT32 dstStep, UINT32 dstWidth, UINT32 dstHeight,
+                                  const RECTANGLE_16* WINPR_RESTRICT rect,
+                                  prim_scale_filter filter, prim_scale_row_h_fn rowH,
+                                  prim_scale_row_v_fn rowV)
+{
+	pstatus_t rc = -1;
+	prim_scale_axis xaxis = { 0 };
+	prim_scale_axis yaxis = { 0 };
+	BYTE* ring = NULL;
+	const BYTE** rows = NULL;
+
+	WINPR_ASSERT(rowH);
+	WINPR_ASSERT(rowV);
+
+	if (!pSrc || !pDst || (srcWidth == 0) || (srcHeight == 0) || (dstWidth == 0) ||
+	    (dstHeight == 0))
+		return -1;
+
+	const UINT32 left = rect ? MIN(rect->left, dstWidth) : 0;
+	const UINT32 top = rect ? MIN(rect->top, dstHeight) : 0;
+	const UINT32 right = rect ? MIN(rect->right, dstWidth) : dstWidth;
+	const UINT32 bottom = rect ? MIN(rect->bottom, dstHeight) : dstHeight;
+
+	if ((left >= right) || (top >= bottom))
+		return PRIMITIVES_SUCCESS;
+
+	if (!scale_axis_init(&xaxis, srcWidth, dstWidth, left, right, filter) ||
+	    !scale_axis_init(&yaxis, srcHeight, dstHeight, top, bottom, filter))
+		goto fail;
+
+	/* The horizontally filtered source rows are kept in a ring of as many rows as the vertical
+	 * filter has taps. The start rows of the vertical filter never decrease, so every source
+	 * row is filtered at most once. */
+	const size_t len = 4ull * xaxis.count;
+	ring = winpr_aligned_malloc(len * yaxis.taps, 32);
+	rows = calloc(yaxis.taps, sizeof(BYTE*));
+	if (!ring || !rows)
+		goto fail;
+
+	UINT32 next = yaxis.start[0];
+	for (UINT32 y = 0; y < yaxis.count; y++)
+	{
+		const UINT32 start = yaxis.start[y];
+
+		next = MAX(next, start);
+		for (; next < start + yaxis.taps; next++)
+			rowH(&pSrc[1ull * next * srcStep], &ring[(next % yaxis.taps) * len], &xaxis);
+
+		for (UINT32 t = 0; t < yaxis.taps; t++)
+			rows[t] = &ring[((start + t) % yaxis.taps) * len];
+
+		rowV(rows, &yaxis.weights[1ull * y * yaxis.taps], yaxis.taps,
+		     &pDst[1ull * (top + y) * dstStep + 4ull * left], len);
+	}
+
+	rc = PRIMITIVES_SUCCESS;
+fail:
+	free((void*)rows);
+	winpr_aligned_free(ring);
+	scale_axis_free(&xaxis);
+	scale_axis_free(&yaxis);
+	return rc;
+}
+
+static pstatus_t generic_scale_8u_C4R(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                      UINT32 srcWidth, UINT32 srcHeight, BYTE* WINPR_RESTRICT pDst,
+                                      UINT32 dstStep, UINT32 dstWidth, UINT32 dstHeight,
+                                      const RECTANGLE_16* WINPR_RESTRICT rect,
+                                      prim_scale_filter filter)
+{
+	return generic_scale_8u_C4R_ex(pSrc, srcStep, srcWidth, srcHeight, pDst, dstStep, dstWidth,
+	                               dstHeight, rect, filter, generic_scale_row_h,
+	                               generic_scale_row_v_full);
+}
+
+void primitives_init_scale(primitives_t* WINPR_RESTRICT prims)
+{
+	prims->scale_8u_C4R = generic_scale_8u_C4R;
+}
+
+void primitives_init_scale_opt(primitives_t* WINPR_RESTRICT prims)
+{
+	primitives_init_scale(prims);
+	primitives_init_scale_sse41(prims);
+#if defined(WITH_AVX2)
+	primitives_init_scale_avx2(prims);
+#endif
+	primitives_init_scale_neon(prims);
+}
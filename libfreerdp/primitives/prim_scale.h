@@ -0,0 +1,107 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Primitives image scaling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_PRIM_SCALE_H
+#define FREERDP_LIB_PRIM_SCALE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/config.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+
+/* filter weights are fixed point numbers with this many fractional bits */
+#define PRIM_SCALE_BITS 14
+#define PRIM_SCALE_ONE (1 << PRIM_SCALE_BITS)
+#define PRIM_SCALE_ROUND (1 << (PRIM_SCALE_BITS - 1))
+
+/** The separable filter of one axis: every output coordinate reads \b taps consecutive source
+ *  coordinates beginning with \b start, taps beyond the image border are folded into the
+ *  border pixel so that no source coordinate is out of range. */
+typedef struct
+{
+	UINT32 taps;
+	UINT32 count;
+	UINT32* start;
+	INT16* weights; /* count x taps */
+} prim_scale_axis;
+
+/** Filter the \b count pixels of one source row horizontally to \b dst */
+typedef void (*prim_scale_row_h_fn)(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                    const prim_scale_axis* WINPR_RESTRICT axis);
+
+/** Combine \b taps horizontally filtered rows of \b len bytes to one destination row */
+typedef void (*prim_scale_row_v_fn)(const BYTE* const* WINPR_RESTRICT rows,
+                                    const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                    BYTE* WINPR_RESTRICT dst, size_t len);
+
+static inline BYTE prim_scale_clamp(INT32 acc)
+{
+	const INT32 val = (acc + PRIM_SCALE_ROUND) >> PRIM_SCALE_BITS;
+	if (val < 0)
+		return 0;
+	if (val > 0xFF)
+		return 0xFF;
+	return (BYTE)val;
+}
+
+/** Scalar vertical filter of the bytes [begin, end), used for the tails of the SIMD rows */
+FREERDP_LOCAL void generic_scale_row_v(const BYTE* const* WINPR_RESTRICT rows,
+                                       const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                       BYTE* WINPR_RESTRICT dst, size_t begin, size_t end);
+
+/** The scaler with the row filters of an implementation plugged in */
+FREERDP_LOCAL pstatus_t generic_scale_8u_C4R_ex(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                                UINT32 srcWidth, UINT32 srcHeight,
+                                                BYTE* WINPR_RESTRICT pDst, UINT32 dstStep,
+                                                UINT32 dstWidth, UINT32 dstHeight,
+                                                const RECTANGLE_16* WINPR_RESTRICT rect,
+                                                prim_scale_filter filter, prim_scale_row_h_fn rowH,
+                                                prim_scale_row_v_fn rowV);
+
+FREERDP_LOCAL void primitives_init_scale_sse41_int(primitives_t* WINPR_RESTRICT prims);
+static inline void primitives_init_scale_sse41(primitives_t* WINPR_RESTRICT prims)
+{
+	if (!IsProcessorFeaturePresent(PF_SSE4_1_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	primitives_init_scale_sse41_int(prims);
+}
+
+#if defined(WITH_AVX2)
+FREERDP_LOCAL void primitives_init_scale_avx2_int(primitives_t* WINPR_RESTRICT prims);
+static inline void primitives_init_scale_avx2(primitives_t* WINPR_RESTRICT prims)
+{
+	if (!IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	primitives_init_scale_avx2_int(prims);
+}
+#endif
+
+FREERDP_LOCAL void primitives_init_scale_neon_int(primitives_t* WINPR_RESTRICT prims);
+static inline void primitives_init_scale_neon(primitives_t* WINPR_RESTRICT prims)
+{
+	if (!IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	primitives_init_scale_neon_int(prims);
+}
+
+#endif /* FREERDP_LIB_PRIM_SCALE_H */
@@ -77,6 +77,7 @@ static BOOL primitives_init_generic(primitives_t* prims)
 	primitives_init_colors(prims);
 	primitives_init_YCoCg(prims);
 	primitives_init_YUV(prims);
+	primitives_init_scale(prims);
 	prims->uninit = NULL;
 	return TRUE;
 }
@@ -104,6 +105,7 @@ static BOOL primitives_init_optimized(primitives_t* prims)
 	primitives_init_colors_opt(prims);
 	primitives_init_YCoCg_opt(prims);
 	primitives_init_YUV_opt(prims);
+	primitives_init_scale_opt(prims);
 	prims->flags |= PRIM_FLAGS_HAVE_EXTCPU;
 #endif
 	return TRUE;
@@ -22,6 +22,8 @@
 
 #include <freerdp/config.h>
 
+#include <string.h>
+
 #include <freerdp/types.h>
 #include <freerdp/primitives.h>
 #include <winpr/sysinfo.h>
@@ -198,6 +200,70 @@ static pstatus_t sse2_alphaComp_argb(const BYTE* WINPR_RESTRICT pSrc1, UINT32 sr
 
 	return PRIMITIVES_SUCCESS;
 }
+
+/* blend the 8 pixel bytes of each 16 bit lane with their alphas, as prim_alpha_mask_blend */
+static inline __m128i sse2_alphaMask_blend(__m128i color, __m128i dst, __m128i alpha)
+{
+	const __m128i inv = _mm_sub_epi16(_mm_set1_epi16(0xFF), alpha);
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(color, alpha), _mm_mullo_epi16(dst, inv));
+	t = _mm_add_epi16(t, _mm_set1_epi16(0x80));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static pstatus_t sse2_alphaMask_8u_C4R(const BYTE* WINPR_RESTRICT pMask, UINT32 maskStep,
+                                       UINT32 color, BYTE* WINPR_RESTRICT pDst, UINT32 dstStep,
+                                       UINT32 width, UINT32 height)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i fill = mm_set1_epu32(color);
+	const __m128i colorLo = _mm_unpacklo_epi8(fill, zero);
+
+	for (size_t y = 0; y < height; y++)
+	{
+		const BYTE* mask = &pMask[y * maskStep];
+		BYTE* dst = &pDst[y * dstStep];
+		size_t x = 0;
+
+		/* 4 pixels at a time, runs of empty or fully covered pixels are skipped or filled */
+		for (; x + 4 <= width; x += 4)
+		{
+			UINT32 alphas = 0;
+			memcpy(&alphas, &mask[x], sizeof(alphas));
+
+			if (alphas == 0)
+				continue;
+
+			if (alphas == UINT32_MAX)
+			{
+				STORE_SI128(&dst[x * 4], fill);
+				continue;
+			}
+
+			/* a0a0a0a0 a1a1a1a1 a2a2a2a2 a3a3a3a3 */
+			__m128i a = _mm_cvtsi32_si128(WINPR_CXX_COMPAT_CAST(int32_t, alphas));
+			a = _mm_unpacklo_epi8(a, a);
+			a = _mm_unpacklo_epi16(a, a);
+
+			const __m128i d = LOAD_SI128(&dst[x * 4]);
+			const __m128i lo = sse2_alphaMask_blend(colorLo, _mm_unpacklo_epi8(d, zero),
+			                                        _mm_unpacklo_epi8(a, zero));
+			const __m128i hi = sse2_alphaMask_blend(colorLo, _mm_unpackhi_epi8(d, zero),
+			                                        _mm_unpackhi_epi8(a, zero));
+			STORE_SI128(&dst[x * 4], _mm_packus_epi16(lo, hi));
+		}
+
+		if (x < width)
+		{
+			const pstatus_t status = generic->alphaMask_8u_C4R(
+			    &mask[x], maskStep, color, &dst[x * 4], dstStep,
+			    WINPR_ASSERTING_INT_CAST(UINT32, width - x), 1);
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
 #endif
 
 /* ------------------------------------------------------------------------- */
@@ -207,6 +273,7 @@ void primitives_init_alphaComp_sse3_int(primitives_t* WINPR_RESTRICT prims)
 	generic = primitives_get_generic();
 	WLog_VRB(PRIM_TAG, "SSE2/SSE3 optimizations");
 	prims->alphaComp_argb = sse2_alphaComp_argb;
+	prims->alphaMask_8u_C4R = sse2_alphaMask_8u_C4R;
 
 #else
 	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or SSE3 intrinsics not available");
@@ -0,0 +1,207 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized image scaling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/sysinfo.h>
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <freerdp/log.h>
+
+#include "prim_internal.h"
+#include "prim_avxsse.h"
+#include "prim_scale.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <emmintrin.h>
+#include <immintrin.h>
+
+static inline UINT32 avx2_weight_pair(INT16 first, INT16 second)
+{
+	return (((UINT32)(UINT16)second) << 16) | (UINT16)first;
+}
+
+static inline __m256i avx2_set_lanes(__m128i lo, __m128i hi)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+static inline __m256i avx2_scale_round(__m256i acc)
+{
+	return _mm256_srai_epi32(_mm256_add_epi32(acc, _mm256_set1_epi32(PRIM_SCALE_ROUND)),
+	                         PRIM_SCALE_BITS);
+}
+
+static inline INT32 avx2_load_pixel(const BYTE* WINPR_RESTRICT src)
+{
+	INT32 val = 0;
+	memcpy(&val, src, sizeof(val));
+	return val;
+}
+
+/* one pixel per 128 bit lane, the channels of two taps interleaved to 16 bit pairs */
+static const BYTE avx2_interleave[32] = { 0, 0x80, 4, 0x80, 1, 0x80, 5, 0x80, 2, 0x80, 6,
+	                                      0x80, 3, 0x80, 7, 0x80, 0, 0x80, 4, 0x80, 1, 0x80,
+	                                      5, 0x80, 2, 0x80, 6, 0x80, 3, 0x80, 7, 0x80 };
+
+static inline __m128i avx2_scale_pixel_h(const BYTE* WINPR_RESTRICT s,
+                                         const INT16* WINPR_RESTRICT w, UINT32 taps)
+{
+	const __m128i interleave = _mm_loadu_si128((const __m128i*)avx2_interleave);
+	__m128i acc = _mm_setzero_si128();
+	UINT32 t = 0;
+
+	for (; t + 1 < taps; t += 2)
+	{
+		const __m128i px = _mm_loadl_epi64((const __m128i*)&s[4ull * t]);
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_shuffle_epi8(px, interleave),
+		                                        mm_set1_epu32(avx2_weight_pair(w[t], w[t + 1]))));
+	}
+
+	if (t < taps)
+	{
+		const __m128i px = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(avx2_load_pixel(&s[4ull * t])));
+		acc = _mm_add_epi32(acc, _mm_mullo_epi32(px, _mm_set1_epi32(w[t])));
+	}
+
+	return acc;
+}
+
+static void avx2_scale_row_h(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                             const prim_scale_axis* WINPR_RESTRICT axis)
+{
+	const __m256i interleave = _mm256_loadu_si256((const __m256i*)avx2_interleave);
+	const UINT32 taps = axis->taps;
+	UINT32 x = 0;
+
+	/* two destination pixels at once, one in each lane */
+	for (; x + 1 < axis->count; x += 2)
+	{
+		const BYTE* s0 = &src[4ull * axis->start[x]];
+		const BYTE* s1 = &src[4ull * axis->start[x + 1]];
+		const INT16* w0 = &axis->weights[1ull * x * taps];
+		const INT16* w1 = &w0[taps];
+		__m256i acc = _mm256_setzero_si256();
+		UINT32 t = 0;
+
+		for (; t + 1 < taps; t += 2)
+		{
+			const __m256i px = avx2_set_lanes(_mm_loadl_epi64((const __m128i*)&s0[4ull * t]),
+			                                  _mm_loadl_epi64((const __m128i*)&s1[4ull * t]));
+			const __m256i weight =
+			    avx2_set_lanes(mm_set1_epu32(avx2_weight_pair(w0[t], w0[t + 1])),
+			                   mm_set1_epu32(avx2_weight_pair(w1[t], w1[t + 1])));
+			acc = _mm256_add_epi32(acc,
+			                       _mm256_madd_epi16(_mm256_shuffle_epi8(px, interleave), weight));
+		}
+
+		if (t < taps)
+		{
+			const __m256i px = _mm256_cvtepu8_epi32(_mm_set_epi32(
+			    0, 0, avx2_load_pixel(&s1[4ull * t]), avx2_load_pixel(&s0[4ull * t])));
+			const __m256i weight = _mm256_set_epi32(w1[t], w1[t], w1[t], w1[t], w0[t], w0[t],
+			                                        w0[t], w0[t]);
+			acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(px, weight));
+		}
+
+		const __m256i res = avx2_scale_round(acc);
+		const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(res, res), res);
+		const INT32 val0 = _mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+		const INT32 val1 = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+		memcpy(&dst[4ull * x], &val0, sizeof(val0));
+		memcpy(&dst[4ull * x + 4], &val1, sizeof(val1));
+	}
+
+	if (x < axis->count)
+	{
+		const __m128i acc = avx2_scale_pixel_h(&src[4ull * axis->start[x]],
+		                                       &axis->weights[1ull * x * taps], taps);
+		const __m128i res =
+		    _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(PRIM_SCALE_ROUND)), PRIM_SCALE_BITS);
+		const INT32 val = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(res, res), res));
+		memcpy(&dst[4ull * x], &val, sizeof(val));
+	}
+}
+
+static void avx2_scale_row_v(const BYTE* const* WINPR_RESTRICT rows,
+                             const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                             BYTE* WINPR_RESTRICT dst, size_t len)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+
+	/* all operations stay within the 128 bit lanes, so the byte order is kept */
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i acc0 = _mm256_setzero_si256();
+		__m256i acc1 = _mm256_setzero_si256();
+		__m256i acc2 = _mm256_setzero_si256();
+		__m256i acc3 = _mm256_setzero_si256();
+
+		for (UINT32 t = 0; t < taps; t += 2)
+		{
+			/* an odd last tap is paired with zeros */
+			const BOOL pair = (t + 1 < taps);
+			const __m256i weight = _mm256_set1_epi32(
+			    (INT32)avx2_weight_pair(weights[t], pair ? weights[t + 1] : 0));
+			const __m256i a = _mm256_loadu_si256((const __m256i*)&rows[t][i]);
+			const __m256i b = pair ? _mm256_loadu_si256((const __m256i*)&rows[t + 1][i]) : zero;
+			const __m256i lo = _mm256_unpacklo_epi8(a, b);
+			const __m256i hi = _mm256_unpackhi_epi8(a, b);
+
+			acc0 =
+			    _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), weight));
+			acc1 =
+			    _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), weight));
+			acc2 =
+			    _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), weight));
+			acc3 =
+			    _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), weight));
+		}
+
+		const __m256i lo = _mm256_packs_epi32(avx2_scale_round(acc0), avx2_scale_round(acc1));
+		const __m256i hi = _mm256_packs_epi32(avx2_scale_round(acc2), avx2_scale_round(acc3));
+		_mm256_storeu_si256((__m256i*)&dst[i], _mm256_packus_epi16(lo, hi));
+	}
+
+	generic_scale_row_v(rows, weights, taps, dst, i, len);
+}
+
+static pstatus_t avx2_scale_8u_C4R(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                   UINT32 srcWidth, UINT32 srcHeight, BYTE* WINPR_RESTRICT pDst,
+                                   UINT32 dstStep, UINT32 dstWidth, UINT32 dstHeight,
+                                   const RECTANGLE_16* WINPR_RESTRICT rect,
+                                   prim_scale_filter filter)
+{
+	return generic_scale_8u_C4R_ex(pSrc, srcStep, srcWidth, srcHeight, pDst, dstStep, dstWidth,
+	                               dstHeight, rect, filter, avx2_scale_row_h, avx2_scale_row_v);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_scale_avx2_int(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(PRIM_TAG, "AVX2 optimizations");
+	prims->scale_8u_C4R = avx2_scale_8u_C4R;
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or WITH_AVX2 or AVX2 intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
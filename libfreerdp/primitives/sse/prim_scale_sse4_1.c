@@ -0,0 +1,140 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized image scaling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/sysinfo.h>
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <freerdp/log.h>
+
+#include "prim_internal.h"
+#include "prim_avxsse.h"
+#include "prim_scale.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <emmintrin.h>
+#include <immintrin.h>
+
+/* two weights for the 16 bit pairs of _mm_madd_epi16 */
+static inline __m128i sse41_weight_pair(INT16 first, INT16 second)
+{
+	return mm_set1_epu32((((UINT32)(UINT16)second) << 16) | (UINT16)first);
+}
+
+static inline __m128i sse41_scale_round(__m128i acc)
+{
+	return _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(PRIM_SCALE_ROUND)), PRIM_SCALE_BITS);
+}
+
+static void sse41_scale_row_h(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                              const prim_scale_axis* WINPR_RESTRICT axis)
+{
+	/* interleave the channels of two pixels to 16 bit pairs: c0 of both, c1 of both... */
+	const __m128i interleave = _mm_set_epi8(-1, 7, -1, 3, -1, 6, -1, 2, -1, 5, -1, 1, -1, 4, -1, 0);
+
+	for (UINT32 x = 0; x < axis->count; x++)
+	{
+		const BYTE* s = &src[4ull * axis->start[x]];
+		const INT16* w = &axis->weights[1ull * x * axis->taps];
+		__m128i acc = _mm_setzero_si128();
+		UINT32 t = 0;
+
+		for (; t + 1 < axis->taps; t += 2)
+		{
+			const __m128i px = _mm_loadl_epi64((const __m128i*)&s[4ull * t]);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_shuffle_epi8(px, interleave),
+			                                        sse41_weight_pair(w[t], w[t + 1])));
+		}
+
+		if (t < axis->taps)
+		{
+			INT32 val = 0;
+			memcpy(&val, &s[4ull * t], sizeof(val));
+			const __m128i px = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(val));
+			acc = _mm_add_epi32(acc, _mm_mullo_epi32(px, _mm_set1_epi32(w[t])));
+		}
+
+		const __m128i res = sse41_scale_round(acc);
+		const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(res, res), res);
+		const INT32 val = _mm_cvtsi128_si32(packed);
+		memcpy(&dst[4ull * x], &val, sizeof(val));
+	}
+}
+
+static void sse41_scale_row_v(const BYTE* const* WINPR_RESTRICT rows,
+                              const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                              BYTE* WINPR_RESTRICT dst, size_t len)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i acc0 = _mm_setzero_si128();
+		__m128i acc1 = _mm_setzero_si128();
+		__m128i acc2 = _mm_setzero_si128();
+		__m128i acc3 = _mm_setzero_si128();
+
+		for (UINT32 t = 0; t < taps; t += 2)
+		{
+			/* an odd last tap is paired with zeros */
+			const BOOL pair = (t + 1 < taps);
+			const __m128i weight = sse41_weight_pair(weights[t], pair ? weights[t + 1] : 0);
+			const __m128i a = LOAD_SI128(&rows[t][i]);
+			const __m128i b = pair ? LOAD_SI128(&rows[t + 1][i]) : zero;
+			const __m128i lo = _mm_unpacklo_epi8(a, b);
+			const __m128i hi = _mm_unpackhi_epi8(a, b);
+
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), weight));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), weight));
+			acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), weight));
+			acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), weight));
+		}
+
+		const __m128i lo = _mm_packs_epi32(sse41_scale_round(acc0), sse41_scale_round(acc1));
+		const __m128i hi = _mm_packs_epi32(sse41_scale_round(acc2), sse41_scale_round(acc3));
+		STORE_SI128(&dst[i], _mm_packus_epi16(lo, hi));
+	}
+
+	generic_scale_row_v(rows, weights, taps, dst, i, len);
+}
+
+static pstatus_t sse41_scale_8u_C4R(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                    UINT32 srcWidth, UINT32 srcHeight, BYTE* WINPR_RESTRICT pDst,
+                                    UINT32 dstStep, UINT32 dstWidth, UINT32 dstHeight,
+                                    const RECTANGLE_16* WINPR_RESTRICT rect,
+                                    prim_scale_filter filter)
+{
+	return generic_scale_8u_C4R_ex(pSrc, srcStep, srcWidth, srcHeight, pDst, dstStep, dstWidth,
+	                               dstHeight, rect, filter, sse41_scale_row_h, sse41_scale_row_v);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_scale_sse41_int(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(PRIM_TAG, "SSE4.1 optimizations");
+	prims->scale_8u_C4R = sse41_scale_8u_C4R;
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or SSE4.1 intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
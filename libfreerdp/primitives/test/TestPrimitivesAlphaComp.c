@@ -182,6 +182,78 @@ static int test_alphaComp_speed(void)
 	return TRUE;
 }
 
+/* ------------------------------------------------------------------------- */
+static BOOL test_alphaMask_func(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 67;
+	const UINT32 height = 9;
+	const UINT32 maskStep = 80;
+	const UINT32 dstStep = 4 * 70;
+	const size_t dstSize = 1ull * height * dstStep;
+	UINT32 color = 0;
+	BYTE* mask = calloc(1ull * height, maskStep);
+	BYTE* src = calloc(1ull * height, dstStep);
+	BYTE* dst1 = calloc(1ull * height, dstStep);
+	BYTE* dst2 = calloc(1ull * height, dstStep);
+
+	if (!mask || !src || !dst1 || !dst2)
+		goto fail;
+
+	winpr_RAND(&color, sizeof(color));
+	winpr_RAND(mask, 1ull * height * maskStep);
+	winpr_RAND(src, dstSize);
+	memcpy(dst1, src, dstSize);
+	memcpy(dst2, src, dstSize);
+
+	/* glyph like rows of empty and fully covered pixels */
+	for (UINT32 y = 0; y < height; y += 2)
+	{
+		for (UINT32 x = 0; x < width; x++)
+			mask[y * maskStep + x] = (x % 7 < 3) ? 0x00 : 0xFF;
+	}
+
+	if (generic->alphaMask_8u_C4R(mask, maskStep, color, dst1, dstStep, width, height) !=
+	    PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (optimized->alphaMask_8u_C4R(mask, maskStep, color, dst2, dstStep, width, height) !=
+	    PRIMITIVES_SUCCESS)
+		goto fail;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < dstStep; x++)
+		{
+			const size_t pos = 1ull * y * dstStep + x;
+			BYTE expect = src[pos];
+
+			if (x < 4 * width)
+			{
+				const UINT32 alpha = mask[y * maskStep + x / 4];
+				const UINT32 c = ((const BYTE*)&color)[x % 4];
+				expect = (BYTE)((c * alpha + src[pos] * (255 - alpha) + 127) / 255);
+			}
+
+			if ((dst1[pos] != expect) || (dst2[pos] != expect))
+			{
+				printf("alphaMask: mismatch at %" PRIu32 "x%" PRIu32 ": generic=0x%02" PRIx8
+				       ", optimized=0x%02" PRIx8 ", expected=0x%02" PRIx8 "\n",
+				       x, y, dst1[pos], dst2[pos], expect);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(mask);
+	free(src);
+	free(dst1);
+	free(dst2);
+	return rc;
+}
+
 int TestPrimitivesAlphaComp(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -192,6 +264,9 @@ int TestPrimitivesAlphaComp(int argc, char* argv[])
 	if (!test_alphaComp_func())
 		return -1;
 
+	if (!test_alphaMask_func())
+		return -1;
+
 	if (g_TestPrimitivesPerformance)
 	{
 		if (!test_alphaComp_speed())
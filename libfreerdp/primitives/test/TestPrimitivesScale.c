@@ -0,0 +1,265 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image scaling primitives test
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <freerdp/config.h>
+
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#include "prim_test.h"
+
+typedef struct
+{
+	UINT32 srcWidth;
+	UINT32 srcHeight;
+	UINT32 dstWidth;
+	UINT32 dstHeight;
+} scale_test_size;
+
+static const char* filter_name(prim_scale_filter filter)
+{
+	switch (filter)
+	{
+		case PRIM_SCALE_BILINEAR:
+			return "bilinear";
+		case PRIM_SCALE_BICUBIC:
+			return "bicubic";
+		case PRIM_SCALE_BOX:
+			return "box";
+		default:
+			return "unknown";
+	}
+}
+
+static BOOL compare_images(const char* what, prim_scale_filter filter, const scale_test_size* size,
+                           const BYTE* expect, const BYTE* actual, UINT32 step)
+{
+	for (UINT32 y = 0; y < size->dstHeight; y++)
+	{
+		for (UINT32 x = 0; x < size->dstWidth * 4; x++)
+		{
+			const BYTE e = expect[1ull * y * step + x];
+			const BYTE a = actual[1ull * y * step + x];
+			if (e != a)
+			{
+				printf("%s [%s %" PRIu32 "x%" PRIu32 " -> %" PRIu32 "x%" PRIu32 "] byte %" PRIu32
+				       ",%" PRIu32 ": expected 0x%02" PRIx8 ", got 0x%02" PRIx8 "\n",
+				       what, filter_name(filter), size->srcWidth, size->srcHeight,
+				       size->dstWidth, size->dstHeight, x, y, e, a);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/* flat areas must keep their color whatever filter is used */
+static BOOL test_scale_flat(primitives_t* prims, prim_scale_filter filter,
+                            const scale_test_size* size)
+{
+	BOOL rc = FALSE;
+	const UINT32 srcStep = size->srcWidth * 4;
+	const UINT32 dstStep = size->dstWidth * 4;
+	BYTE* src = malloc(1ull * srcStep * size->srcHeight);
+	BYTE* dst = calloc(size->dstHeight, dstStep);
+	if (!src || !dst)
+		goto fail;
+
+	for (size_t x = 0; x < 1ull * srcStep * size->srcHeight; x += 4)
+	{
+		src[x + 0] = 0x12;
+		src[x + 1] = 0x80;
+		src[x + 2] = 0xFE;
+		src[x + 3] = 0xFF;
+	}
+
+	if (prims->scale_8u_C4R(src, srcStep, size->srcWidth, size->srcHeight, dst, dstStep,
+	                        size->dstWidth, size->dstHeight, NULL, filter) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	for (size_t x = 0; x < 1ull * dstStep * size->dstHeight; x += 4)
+	{
+		if ((dst[x + 0] != 0x12) || (dst[x + 1] != 0x80) || (dst[x + 2] != 0xFE) ||
+		    (dst[x + 3] != 0xFF))
+		{
+			printf("flat [%s %" PRIu32 "x%" PRIu32 " -> %" PRIu32 "x%" PRIu32 "] pixel %" PRIuz
+			       " changed\n",
+			       filter_name(filter), size->srcWidth, size->srcHeight, size->dstWidth,
+			       size->dstHeight, x / 4);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(dst);
+	return rc;
+}
+
+static BOOL test_scale(prim_scale_filter filter, const scale_test_size* size)
+{
+	BOOL rc = FALSE;
+	const UINT32 srcStep = size->srcWidth * 4 + 12;
+	const UINT32 dstStep = size->dstWidth * 4 + 8;
+	BYTE* src = malloc(1ull * srcStep * size->srcHeight);
+	BYTE* whole = calloc(size->dstHeight, dstStep);
+	BYTE* opt = calloc(size->dstHeight, dstStep);
+	BYTE* tiled = calloc(size->dstHeight, dstStep);
+	if (!src || !whole || !opt || !tiled)
+		goto fail;
+
+	winpr_RAND(src, 1ull * srcStep * size->srcHeight);
+
+	if (generic->scale_8u_C4R(src, srcStep, size->srcWidth, size->srcHeight, whole, dstStep,
+	                          size->dstWidth, size->dstHeight, NULL,
+	                          filter) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (optimized->scale_8u_C4R(src, srcStep, size->srcWidth, size->srcHeight, opt, dstStep,
+	                            size->dstWidth, size->dstHeight, NULL,
+	                            filter) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (!compare_images("optimized", filter, size, whole, opt, dstStep))
+		goto fail;
+
+	/* scaling the image in tiles must not differ at the tile borders */
+	const UINT32 tile = 13;
+	for (UINT32 y = 0; y < size->dstHeight; y += tile)
+	{
+		for (UINT32 x = 0; x < size->dstWidth; x += tile)
+		{
+			const RECTANGLE_16 rect = { (UINT16)x, (UINT16)y,
+				                        (UINT16)MIN(x + tile, size->dstWidth),
+				                        (UINT16)MIN(y + tile, size->dstHeight) };
+			if (optimized->scale_8u_C4R(src, srcStep, size->srcWidth, size->srcHeight, tiled,
+			                            dstStep, size->dstWidth, size->dstHeight, &rect,
+			                            filter) != PRIMITIVES_SUCCESS)
+				goto fail;
+		}
+	}
+
+	if (!compare_images("tiled", filter, size, whole, tiled, dstStep))
+		goto fail;
+
+	if (!test_scale_flat(generic, filter, size) || !test_scale_flat(optimized, filter, size))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(whole);
+	free(opt);
+	free(tiled);
+	return rc;
+}
+
+/* scaling to the same size with the bilinear filter is a copy */
+static BOOL test_scale_identity(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 37;
+	const UINT32 height = 19;
+	const UINT32 step = width * 4;
+	BYTE* src = malloc(1ull * step * height);
+	BYTE* dst = calloc(height, step);
+	if (!src || !dst)
+		goto fail;
+
+	winpr_RAND(src, 1ull * step * height);
+	if (optimized->scale_8u_C4R(src, step, width, height, dst, step, width, height, NULL,
+	                            PRIM_SCALE_BILINEAR) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (memcmp(src, dst, 1ull * step * height) != 0)
+	{
+		printf("identity scale changed the image\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(dst);
+	return rc;
+}
+
+static BOOL test_scale_speed(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 srcWidth = 1920;
+	const UINT32 srcHeight = 1080;
+	const UINT32 dstWidth = 1366;
+	const UINT32 dstHeight = 768;
+	BYTE* src = malloc(4ull * srcWidth * srcHeight);
+	BYTE* dst = malloc(4ull * dstWidth * dstHeight);
+	if (!src || !dst)
+		goto fail;
+
+	winpr_RAND(src, 4ull * srcWidth * srcHeight);
+	rc = speed_test("scale_8u_C4R", "bilinear", g_Iterations,
+	                (speed_test_fkt)generic->scale_8u_C4R, (speed_test_fkt)optimized->scale_8u_C4R,
+	                src, srcWidth * 4, srcWidth, srcHeight, dst, dstWidth * 4, dstWidth, dstHeight,
+	                NULL, PRIM_SCALE_BILINEAR);
+fail:
+	free(src);
+	free(dst);
+	return rc;
+}
+
+int TestPrimitivesScale(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	const scale_test_size sizes[] = {
+		{ 97, 61, 211, 133 }, /* up */
+		{ 97, 61, 40, 23 },   /* down */
+		{ 64, 64, 64, 64 },   /* same */
+		{ 53, 31, 97, 17 },   /* mixed */
+		{ 3, 2, 45, 37 },     /* fewer pixels than taps */
+		{ 300, 5, 7, 1 },
+	};
+	const prim_scale_filter filters[] = { PRIM_SCALE_BILINEAR, PRIM_SCALE_BICUBIC,
+		                                  PRIM_SCALE_BOX };
+
+	prim_test_setup(FALSE);
+
+	for (size_t x = 0; x < ARRAYSIZE(filters); x++)
+	{
+		for (size_t y = 0; y < ARRAYSIZE(sizes); y++)
+		{
+			if (!test_scale(filters[x], &sizes[y]))
+				return 1;
+		}
+	}
+
+	if (!test_scale_identity())
+		return 1;
+
+	if (g_TestPrimitivesPerformance)
+	{
+		if (!test_scale_speed())
+			return 1;
+	}
+
+	return 0;
+}
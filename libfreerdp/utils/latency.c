@@ -0,0 +1,315 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Input to display latency statistics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/types.h>
+#include <freerdp/log.h>
+#include <freerdp/utils/latency.h>
+
+#define TAG FREERDP_TAG("utils.latency")
+
+/* frames in flight that are tracked at the same time */
+#define LATENCY_FRAMES 32
+
+typedef struct
+{
+	BOOL valid;
+	UINT32 frameId;
+	UINT64 sequence;
+	UINT64 input;
+	UINT32 stages;
+} rdpLatencyFrame;
+
+struct rdp_latency_stats
+{
+	CRITICAL_SECTION lock;
+	char* name;
+	wLog* log;
+	UINT64 logInterval;
+	UINT64 lastLog;
+
+	UINT64 pendingInput;
+	UINT64 sequence;
+	rdpLatencyFrame frames[LATENCY_FRAMES];
+	FREERDP_LATENCY_HISTOGRAM histograms[FREERDP_LATENCY_STAGE_COUNT];
+};
+
+const char* freerdp_latency_stage_string(FREERDP_LATENCY_STAGE stage)
+{
+	switch (stage)
+	{
+		case FREERDP_LATENCY_STAGE_RECEIVE:
+			return "receive";
+		case FREERDP_LATENCY_STAGE_DECODE_START:
+			return "decode-start";
+		case FREERDP_LATENCY_STAGE_DECODE_END:
+			return "decode-end";
+		case FREERDP_LATENCY_STAGE_PRESENT:
+			return "present";
+		case FREERDP_LATENCY_STAGE_CAPTURE:
+			return "capture";
+		case FREERDP_LATENCY_STAGE_ENCODE:
+			return "encode";
+		case FREERDP_LATENCY_STAGE_SEND:
+			return "send";
+		default:
+			return "unknown";
+	}
+}
+
+/* the stage a frame passes before stage, FREERDP_LATENCY_STAGE_COUNT for the first ones */
+static FREERDP_LATENCY_STAGE latency_previous_stage(FREERDP_LATENCY_STAGE stage)
+{
+	switch (stage)
+	{
+		case FREERDP_LATENCY_STAGE_DECODE_START:
+			return FREERDP_LATENCY_STAGE_RECEIVE;
+		case FREERDP_LATENCY_STAGE_DECODE_END:
+			return FREERDP_LATENCY_STAGE_DECODE_START;
+		case FREERDP_LATENCY_STAGE_PRESENT:
+			return FREERDP_LATENCY_STAGE_DECODE_END;
+		case FREERDP_LATENCY_STAGE_ENCODE:
+			return FREERDP_LATENCY_STAGE_CAPTURE;
+		case FREERDP_LATENCY_STAGE_SEND:
+			return FREERDP_LATENCY_STAGE_ENCODE;
+		default:
+			return FREERDP_LATENCY_STAGE_COUNT;
+	}
+}
+
+static void latency_histogram_add(FREERDP_LATENCY_HISTOGRAM* histogram, UINT64 latency)
+{
+	size_t bucket = 0;
+
+	WINPR_ASSERT(histogram);
+
+	while ((bucket < FREERDP_LATENCY_HISTOGRAM_BUCKETS - 1) && (latency >= (250ull << bucket)))
+		bucket++;
+
+	if ((histogram->count == 0) || (latency < histogram->min))
+		histogram->min = latency;
+	if (latency > histogram->max)
+		histogram->max = latency;
+
+	histogram->count++;
+	histogram->sum += latency;
+	histogram->buckets[bucket]++;
+}
+
+/* upper bound of the bucket the given share of the latencies is in, an estimate in us */
+static UINT64 latency_histogram_percentile(const FREERDP_LATENCY_HISTOGRAM* histogram,
+                                           UINT32 percent)
+{
+	UINT64 sum = 0;
+
+	WINPR_ASSERT(histogram);
+
+	const UINT64 limit = (histogram->count * percent + 99) / 100;
+	for (size_t x = 0; x < FREERDP_LATENCY_HISTOGRAM_BUCKETS - 1; x++)
+	{
+		sum += histogram->buckets[x];
+		if (sum >= limit)
+			return MIN(250ull << x, histogram->max);
+	}
+
+	return histogram->max;
+}
+
+static rdpLatencyFrame* latency_find_frame(rdpLatencyStats* stats, UINT32 frameId,
+                                           FREERDP_LATENCY_STAGE stage)
+{
+	rdpLatencyFrame* found = NULL;
+	const UINT32 bit = 1u << stage;
+
+	WINPR_ASSERT(stats);
+
+	if (frameId != FREERDP_LATENCY_FRAME_LAST)
+	{
+		for (size_t x = 0; x < LATENCY_FRAMES; x++)
+		{
+			rdpLatencyFrame* frame = &stats->frames[x];
+			if (frame->valid && (frame->frameId == frameId))
+			{
+				if (!found || (frame->sequence > found->sequence))
+					found = frame;
+			}
+		}
+
+		return found;
+	}
+
+	const FREERDP_LATENCY_STAGE previous = latency_previous_stage(stage);
+	for (size_t x = 0; x < LATENCY_FRAMES; x++)
+	{
+		rdpLatencyFrame* frame = &stats->frames[x];
+		if (!frame->valid || ((frame->stages & bit) != 0))
+			continue;
+
+		if ((previous != FREERDP_LATENCY_STAGE_COUNT) && ((frame->stages & (1u << previous)) == 0))
+			continue;
+
+		if (!found || (frame->sequence > found->sequence))
+			found = frame;
+	}
+
+	return found;
+}
+
+static rdpLatencyFrame* latency_new_frame(rdpLatencyStats* stats, UINT32 frameId)
+{
+	WINPR_ASSERT(stats);
+
+	rdpLatencyFrame* frame = &stats->frames[stats->sequence % LATENCY_FRAMES];
+	frame->valid = TRUE;
+	frame->frameId = frameId;
+	frame->sequence = stats->sequence++;
+	frame->input = stats->pendingInput;
+	frame->stages = 0;
+	stats->pendingInput = 0;
+	return frame;
+}
+
+void freerdp_latency_stats_input(rdpLatencyStats* stats, UINT64 timestamp)
+{
+	if (!stats || (timestamp == 0))
+		return;
+
+	EnterCriticalSection(&stats->lock);
+	if (stats->pendingInput == 0)
+		stats->pendingInput = timestamp;
+	LeaveCriticalSection(&stats->lock);
+}
+
+void freerdp_latency_stats_frame(rdpLatencyStats* stats, UINT32 frameId,
+                                 FREERDP_LATENCY_STAGE stage, UINT64 timestamp)
+{
+	if (!stats || (stage >= FREERDP_LATENCY_STAGE_COUNT))
+		return;
+
+	EnterCriticalSection(&stats->lock);
+
+	rdpLatencyFrame* frame = latency_find_frame(stats, frameId, stage);
+	if (!frame && (frameId != FREERDP_LATENCY_FRAME_LAST))
+		frame = latency_new_frame(stats, frameId);
+
+	if (frame && ((frame->stages & (1u << stage)) == 0))
+	{
+		frame->stages |= 1u << stage;
+		if ((frame->input != 0) && (timestamp >= frame->input))
+			latency_histogram_add(&stats->histograms[stage], (timestamp - frame->input) / 1000ull);
+	}
+
+	const BOOL dump = (stats->logInterval > 0) &&
+	                  (timestamp / 1000000ull - stats->lastLog >= stats->logInterval) &&
+	                  WLog_IsLevelActive(stats->log, WLOG_DEBUG);
+	if (dump)
+		stats->lastLog = timestamp / 1000000ull;
+
+	LeaveCriticalSection(&stats->lock);
+
+	if (dump)
+		freerdp_latency_stats_log(stats, stats->log, WLOG_DEBUG);
+}
+
+BOOL freerdp_latency_stats_get(rdpLatencyStats* stats, FREERDP_LATENCY_STAGE stage,
+                               FREERDP_LATENCY_HISTOGRAM* histogram)
+{
+	if (!stats || !histogram || (stage >= FREERDP_LATENCY_STAGE_COUNT))
+		return FALSE;
+
+	EnterCriticalSection(&stats->lock);
+	*histogram = stats->histograms[stage];
+	LeaveCriticalSection(&stats->lock);
+	return TRUE;
+}
+
+void freerdp_latency_stats_reset(rdpLatencyStats* stats)
+{
+	if (!stats)
+		return;
+
+	EnterCriticalSection(&stats->lock);
+	stats->pendingInput = 0;
+	ZeroMemory(stats->frames, sizeof(stats->frames));
+	ZeroMemory(stats->histograms, sizeof(stats->histograms));
+	LeaveCriticalSection(&stats->lock);
+}
+
+void freerdp_latency_stats_log(rdpLatencyStats* stats, wLog* log, DWORD level)
+{
+	FREERDP_LATENCY_HISTOGRAM histograms[FREERDP_LATENCY_STAGE_COUNT] = { 0 };
+
+	if (!stats || !log)
+		return;
+
+	EnterCriticalSection(&stats->lock);
+	memcpy(histograms, stats->histograms, sizeof(histograms));
+	LeaveCriticalSection(&stats->lock);
+
+	for (size_t x = 0; x < ARRAYSIZE(histograms); x++)
+	{
+		const FREERDP_LATENCY_HISTOGRAM* histogram = &histograms[x];
+		if (histogram->count == 0)
+			continue;
+
+		WLog_Print(log, level,
+		           "[%s] input to %s: frames=%" PRIu64 ", avg=%" PRIu64 "us, min=%" PRIu64
+		           "us, p50<=%" PRIu64 "us, p95<=%" PRIu64 "us, max=%" PRIu64 "us",
+		           stats->name, freerdp_latency_stage_string((FREERDP_LATENCY_STAGE)x),
+		           histogram->count, histogram->sum / histogram->count, histogram->min,
+		           latency_histogram_percentile(histogram, 50),
+		           latency_histogram_percentile(histogram, 95), histogram->max);
+	}
+}
+
+void freerdp_latency_stats_free(rdpLatencyStats* stats)
+{
+	if (!stats)
+		return;
+
+	DeleteCriticalSection(&stats->lock);
+	free(stats->name);
+	free(stats);
+}
+
+rdpLatencyStats* freerdp_latency_stats_new(const char* name, UINT32 logInterval)
+{
+	rdpLatencyStats* stats = (rdpLatencyStats*)calloc(1, sizeof(rdpLatencyStats));
+
+	if (!stats)
+		return NULL;
+
+	InitializeCriticalSection(&stats->lock);
+	stats->name = _strdup(name ? name : "latency");
+	stats->log = WLog_Get(TAG);
+	stats->logInterval = logInterval;
+	stats->lastLog = winpr_GetTickCount64NS() / 1000000ull;
+
+	if (!stats->name || !stats->log)
+	{
+		freerdp_latency_stats_free(stats);
+		return NULL;
+	}
+
+	return stats;
+}
@@ -0,0 +1,162 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Input to display latency statistics test
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <freerdp/utils/latency.h>
+
+#define MS(x) ((x) * 1000000ull)
+
+static BOOL test_histogram(rdpLatencyStats* stats, FREERDP_LATENCY_STAGE stage, UINT64 count,
+                           UINT64 min, UINT64 max)
+{
+	FREERDP_LATENCY_HISTOGRAM histogram = { 0 };
+	UINT64 sum = 0;
+
+	if (!freerdp_latency_stats_get(stats, stage, &histogram))
+		return FALSE;
+
+	for (size_t x = 0; x < FREERDP_LATENCY_HISTOGRAM_BUCKETS; x++)
+		sum += histogram.buckets[x];
+
+	if ((histogram.count != count) || (sum != count) ||
+	    ((count > 0) && ((histogram.min != min) || (histogram.max != max))))
+	{
+		printf("%s: count=%" PRIu64 ", min=%" PRIu64 ", max=%" PRIu64 ", expected count=%" PRIu64
+		       ", min=%" PRIu64 ", max=%" PRIu64 "\n",
+		       freerdp_latency_stage_string(stage), histogram.count, histogram.min, histogram.max,
+		       count, min, max);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_client_frames(rdpLatencyStats* stats)
+{
+	/* a frame is accounted to the input event before it */
+	freerdp_latency_stats_input(stats, MS(1));
+	freerdp_latency_stats_frame(stats, 7, FREERDP_LATENCY_STAGE_RECEIVE, MS(3));
+	freerdp_latency_stats_frame(stats, 7, FREERDP_LATENCY_STAGE_DECODE_START, MS(4));
+	freerdp_latency_stats_frame(stats, 7, FREERDP_LATENCY_STAGE_DECODE_START, MS(9));
+	freerdp_latency_stats_frame(stats, 7, FREERDP_LATENCY_STAGE_DECODE_END, MS(5));
+
+	/* a frame without input event, not yet decoded when the display is updated */
+	freerdp_latency_stats_frame(stats, 8, FREERDP_LATENCY_STAGE_RECEIVE, MS(5));
+	freerdp_latency_stats_frame(stats, FREERDP_LATENCY_FRAME_LAST, FREERDP_LATENCY_STAGE_PRESENT,
+	                            MS(6));
+	freerdp_latency_stats_frame(stats, FREERDP_LATENCY_FRAME_LAST, FREERDP_LATENCY_STAGE_PRESENT,
+	                            MS(7));
+
+	/* the oldest of several input events counts */
+	freerdp_latency_stats_input(stats, MS(20));
+	freerdp_latency_stats_input(stats, MS(21));
+	freerdp_latency_stats_frame(stats, 9, FREERDP_LATENCY_STAGE_RECEIVE, MS(25));
+
+	if (!test_histogram(stats, FREERDP_LATENCY_STAGE_RECEIVE, 2, 2000, 5000))
+		return FALSE;
+	if (!test_histogram(stats, FREERDP_LATENCY_STAGE_DECODE_START, 1, 3000, 3000))
+		return FALSE;
+	if (!test_histogram(stats, FREERDP_LATENCY_STAGE_DECODE_END, 1, 4000, 4000))
+		return FALSE;
+	if (!test_histogram(stats, FREERDP_LATENCY_STAGE_PRESENT, 1, 5000, 5000))
+		return FALSE;
+
+	FREERDP_LATENCY_HISTOGRAM histogram = { 0 };
+	if (!freerdp_latency_stats_get(stats, FREERDP_LATENCY_STAGE_RECEIVE, &histogram))
+		return FALSE;
+
+	/* 2000us is below 250us << 4, 5000us below 250us << 5 */
+	if ((histogram.sum != 7000) || (histogram.buckets[4] != 1) || (histogram.buckets[5] != 1))
+	{
+		printf("receive: unexpected sum %" PRIu64 " or buckets\n", histogram.sum);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_server_frames(rdpLatencyStats* stats)
+{
+	freerdp_latency_stats_input(stats, MS(100));
+	freerdp_latency_stats_frame(stats, 1, FREERDP_LATENCY_STAGE_CAPTURE, MS(116));
+	freerdp_latency_stats_frame(stats, 1, FREERDP_LATENCY_STAGE_ENCODE, MS(120));
+	freerdp_latency_stats_frame(stats, 1, FREERDP_LATENCY_STAGE_SEND, MS(121));
+
+	/* the frames of a long session end in the last bucket */
+	freerdp_latency_stats_input(stats, MS(200));
+	freerdp_latency_stats_frame(stats, 2, FREERDP_LATENCY_STAGE_CAPTURE, MS(20200));
+
+	if (!test_histogram(stats, FREERDP_LATENCY_STAGE_CAPTURE, 2, 16000, 20000000))
+		return FALSE;
+	if (!test_histogram(stats, FREERDP_LATENCY_STAGE_ENCODE, 1, 20000, 20000))
+		return FALSE;
+	if (!test_histogram(stats, FREERDP_LATENCY_STAGE_SEND, 1, 21000, 21000))
+		return FALSE;
+
+	FREERDP_LATENCY_HISTOGRAM histogram = { 0 };
+	if (!freerdp_latency_stats_get(stats, FREERDP_LATENCY_STAGE_CAPTURE, &histogram))
+		return FALSE;
+
+	return histogram.buckets[FREERDP_LATENCY_HISTOGRAM_BUCKETS - 1] == 1;
+}
+
+int TestLatencyStats(int argc, char* argv[])
+{
+	int rc = -1;
+	FREERDP_LATENCY_HISTOGRAM histogram = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	/* no statistics, nothing to record */
+	freerdp_latency_stats_input(NULL, MS(1));
+	freerdp_latency_stats_frame(NULL, 1, FREERDP_LATENCY_STAGE_RECEIVE, MS(2));
+
+	rdpLatencyStats* stats = freerdp_latency_stats_new("test", 0);
+	if (!stats)
+		goto fail;
+
+	if (freerdp_latency_stats_get(stats, FREERDP_LATENCY_STAGE_COUNT, &histogram))
+		goto fail;
+
+	if (!test_client_frames(stats))
+		goto fail;
+
+	if (!test_server_frames(stats))
+		goto fail;
+
+	freerdp_latency_stats_log(stats, WLog_GetRoot(), WLOG_INFO);
+
+	freerdp_latency_stats_input(stats, MS(250));
+	freerdp_latency_stats_reset(stats);
+	for (size_t x = 0; x < FREERDP_LATENCY_STAGE_COUNT; x++)
+	{
+		if (!test_histogram(stats, (FREERDP_LATENCY_STAGE)x, 0, 0, 0))
+			goto fail;
+	}
+
+	/* a frame after a reset does not use the input events from before */
+	freerdp_latency_stats_frame(stats, 10, FREERDP_LATENCY_STAGE_RECEIVE, MS(300));
+	if (!test_histogram(stats, FREERDP_LATENCY_STAGE_RECEIVE, 0, 0, 0))
+		goto fail;
+
+	rc = 0;
+fail:
+	freerdp_latency_stats_free(stats);
+	return rc;
+}
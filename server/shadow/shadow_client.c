@@ -1140,6 +1140,28 @@ static INLINE UINT32 rdpgfx_estimate_h264_avc420(RDPGFX_AVC420_BITMAP_STREAM* ha
 	       havc420->length;
 }
 
+/* Send an encoded frame and account the encode and send stages to its input event */
+static UINT shadow_client_send_surface_frame_command(rdpShadowClient* client,
+                                                     const RDPGFX_SURFACE_COMMAND* cmd,
+                                                     const RDPGFX_START_FRAME_PDU* startFrame,
+                                                     const RDPGFX_END_FRAME_PDU* endFrame)
+{
+	UINT error = CHANNEL_RC_OK;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(startFrame);
+
+	rdpLatencyStats* latency = freerdp_get_latency_stats(&client->context);
+	freerdp_latency_stats_frame(latency, startFrame->frameId, FREERDP_LATENCY_STAGE_ENCODE,
+	                            winpr_GetTickCount64NS());
+	IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, cmd, startFrame,
+	          endFrame);
+	if (error == CHANNEL_RC_OK)
+		freerdp_latency_stats_frame(latency, startFrame->frameId, FREERDP_LATENCY_STAGE_SEND,
+		                            winpr_GetTickCount64NS());
+	return error;
+}
+
 /**
  * Function description
  *
@@ -1179,6 +1201,8 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	cmdstart.timestamp = (UINT32)(sTime.wHour << 22U | sTime.wMinute << 16U | sTime.wSecond << 10U |
 	                              sTime.wMilliseconds);
 	cmdend.frameId = cmdstart.frameId;
+	freerdp_latency_stats_frame(freerdp_get_latency_stats(&client->context), cmdstart.frameId,
+	                            FREERDP_LATENCY_STAGE_CAPTURE, winpr_GetTickCount64NS());
 	cmd.surfaceId = client->surfaceId;
 	cmd.format = PIXEL_FORMAT_BGRX32;
 	cmd.left = nXSrc;
@@ -1231,8 +1255,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			avc444.cbAvc420EncodedBitstream1 = rdpgfx_estimate_h264_avc420(&avc444.bitstream[0]);
 			cmd.codecId = GfxAVC444v2 ? RDPGFX_CODECID_AVC444v2 : RDPGFX_CODECID_AVC444;
 			cmd.extra = (void*)&avc444;
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
+			error = shadow_client_send_surface_frame_command(client, &cmd, &cmdstart, &cmdend);
 		}
 
 		free_h264_metablock(&avc444.bitstream[0].meta);
@@ -1277,8 +1300,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			cmd.codecId = RDPGFX_CODECID_AVC420;
 			cmd.extra = (void*)&avc420;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
+			error = shadow_client_send_surface_frame_command(client, &cmd, &cmdstart, &cmdend);
 		}
 		free_h264_metablock(&avc420.meta);
 
@@ -1333,8 +1355,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			cmd.data = Stream_Buffer(s);
 			cmd.length = (UINT32)pos;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
+			error = shadow_client_send_surface_frame_command(client, &cmd, &cmdstart, &cmdend);
 		}
 
 		Stream_Free(s, TRUE);
@@ -1380,8 +1401,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		{
 			cmd.codecId = RDPGFX_CODECID_CAPROGRESSIVE;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
+			error = shadow_client_send_surface_frame_command(client, &cmd, &cmdstart, &cmdend);
 		}
 
 		if (error)
@@ -1414,8 +1434,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 
 		cmd.codecId = RDPGFX_CODECID_PLANAR;
 
-		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-		          &cmdend);
+		error = shadow_client_send_surface_frame_command(client, &cmd, &cmdstart, &cmdend);
 		free(cmd.data);
 		if (error)
 		{
@@ -1445,8 +1464,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		cmd.length = length;
 		cmd.codecId = RDPGFX_CODECID_UNCOMPRESSED;
 
-		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-		          &cmdend);
+		error = shadow_client_send_surface_frame_command(client, &cmd, &cmdstart, &cmdend);
 		free(data);
 		if (error)
 		{
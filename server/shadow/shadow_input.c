@@ -17,6 +17,7 @@
  */
 
 #include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 #include <freerdp/config.h>
 
 #include <freerdp/log.h>
@@ -24,6 +25,14 @@
 
 #define TAG SERVER_TAG("shadow.input")
 
+/* the next frame captured for the client is accounted to this input event */
+static void shadow_input_record_latency(rdpShadowClient* client)
+{
+	WINPR_ASSERT(client);
+	freerdp_latency_stats_input(freerdp_get_latency_stats(&client->context),
+	                            winpr_GetTickCount64NS());
+}
+
 static BOOL shadow_input_synchronize_event(rdpInput* input, UINT32 flags)
 {
 	WINPR_ASSERT(input);
@@ -53,6 +62,7 @@ static BOOL shadow_input_keyboard_event(rdpInput* input, UINT16 flags, UINT8 cod
 	if (!client->mayInteract)
 		return TRUE;
 
+	shadow_input_record_latency(client);
 	return IFCALLRESULT(TRUE, subsystem->KeyboardEvent, subsystem, client, flags, code);
 }
 
@@ -69,6 +79,7 @@ static BOOL shadow_input_unicode_keyboard_event(rdpInput* input, UINT16 flags, U
 	if (!client->mayInteract)
 		return TRUE;
 
+	shadow_input_record_latency(client);
 	return IFCALLRESULT(TRUE, subsystem->UnicodeKeyboardEvent, subsystem, client, flags, code);
 }
 
@@ -106,6 +117,7 @@ static BOOL shadow_input_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UI
 	if (!client->mayInteract)
 		return TRUE;
 
+	shadow_input_record_latency(client);
 	return IFCALLRESULT(TRUE, subsystem->MouseEvent, subsystem, client, flags, x, y);
 }
 
@@ -131,6 +143,7 @@ static BOOL shadow_input_rel_mouse_event(rdpInput* input, UINT16 flags, INT16 xD
 	if (!client->mayInteract)
 		return TRUE;
 
+	shadow_input_record_latency(client);
 	return IFCALLRESULT(TRUE, subsystem->RelMouseEvent, subsystem, client, flags, xDelta, yDelta);
 }
 
@@ -157,6 +170,7 @@ static BOOL shadow_input_extended_mouse_event(rdpInput* input, UINT16 flags, UIN
 	if (!client->mayInteract)
 		return TRUE;
 
+	shadow_input_record_latency(client);
 	return IFCALLRESULT(TRUE, subsystem->ExtendedMouseEvent, subsystem, client, flags, x, y);
 }
 
@@ -667,6 +667,21 @@ extern "C"
 	/* Utility function to setup hash table for strings */
 	WINPR_API BOOL HashTable_SetupForStringData(wHashTable* table, BOOL stringValues);
 
+	/** @brief Optimize a synchronized table for concurrent lookups
+	 *
+	 *  Lookups (\b HashTable_GetItemValue, \b HashTable_Contains, \b HashTable_ContainsKey) no
+	 *  longer take the table lock but retry if a modification happened while they were
+	 *  running. This only applies to tables that do not own their keys (no key
+	 *  \b fnObjectFree), key objects passed to \b fnObjectEquals must stay valid after removal.
+	 *  Memory of the table is not released before \b HashTable_Free while enabled.
+	 *
+	 *  @param table The table to modify, must have been created with \b synchronized
+	 *  @param readMostly \b TRUE to enable lock free lookups
+	 *  @return \b TRUE for success, \b FALSE if the table is not synchronized
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL HashTable_SetReadMostly(wHashTable* table, BOOL readMostly);
+
 	/* BufferPool */
 
 	typedef struct s_wBufferPool wBufferPool;
@@ -240,6 +240,19 @@ extern "C"
 	WINPR_API BOOL WLog_CloseAppender(wLog* log);
 	WINPR_API BOOL WLog_ConfigureAppender(wLogAppender* appender, const char* setting, void* value);
 
+	/** @brief Get the number of messages an asynchronous appender had to drop.
+	 *
+	 *  An appender is switched to asynchronous mode with the \b async setting (value \b drop or
+	 *  \b block selects the policy for a full queue, optionally followed by \b :size to set the
+	 *  queue size) or the \b WLOG_ASYNC environment variable.
+	 *
+	 *  @param appender The appender to query
+	 *
+	 *  @return The number of dropped messages, \b 0 for synchronous appenders
+	 *  @since version 3.16.0
+	 */
+	WINPR_API size_t WLog_GetAppenderDroppedMessages(wLogAppender* appender);
+
 	WINPR_API wLogLayout* WLog_GetLogLayout(wLog* log);
 	WINPR_API BOOL WLog_Layout_SetPrefixFormat(wLog* log, wLogLayout* layout, const char* format);
 
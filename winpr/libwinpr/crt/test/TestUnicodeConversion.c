@@ -6,6 +6,7 @@
 #include <winpr/error.h>
 #include <winpr/print.h>
 #include <winpr/windows.h>
+#include <winpr/sysinfo.h>
 
 #define TESTCASE_BUFFER_SIZE 8192
 
@@ -13,6 +14,10 @@
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #endif
 
+#ifndef MAX
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#endif
+
 typedef struct
 {
 	const char* utf8;
@@ -1157,6 +1162,303 @@ fail:
 }
 #endif
 
+static UINT32 test_rand(UINT32* state)
+{
+	*state = *state * 1103515245u + 12345u;
+	return *state >> 8;
+}
+
+static void append_codepoint(UINT32 cp, char* utf8, size_t* utf8len, WCHAR* utf16,
+                             size_t* utf16len)
+{
+	if (cp < 0x80)
+		utf8[(*utf8len)++] = (char)cp;
+	else if (cp < 0x800)
+	{
+		utf8[(*utf8len)++] = (char)(0xC0 | (cp >> 6));
+		utf8[(*utf8len)++] = (char)(0x80 | (cp & 0x3F));
+	}
+	else if (cp < 0x10000)
+	{
+		utf8[(*utf8len)++] = (char)(0xE0 | (cp >> 12));
+		utf8[(*utf8len)++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		utf8[(*utf8len)++] = (char)(0x80 | (cp & 0x3F));
+	}
+	else
+	{
+		utf8[(*utf8len)++] = (char)(0xF0 | (cp >> 18));
+		utf8[(*utf8len)++] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		utf8[(*utf8len)++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		utf8[(*utf8len)++] = (char)(0x80 | (cp & 0x3F));
+	}
+
+	if (cp < 0x10000)
+		utf16[(*utf16len)++] = (WCHAR)cp;
+	else
+	{
+		utf16[(*utf16len)++] = (WCHAR)(0xD800 | ((cp - 0x10000) >> 10));
+		utf16[(*utf16len)++] = (WCHAR)(0xDC00 | ((cp - 0x10000) & 0x3FF));
+	}
+}
+
+/* Mix long ASCII runs (vectorized path), BMP characters (scalar fast path) and supplementary
+ * characters (backend) to check the transitions between the paths. */
+static void create_mixed_string(UINT32* state, size_t count, char* utf8, size_t* utf8len,
+                                WCHAR* utf16, size_t* utf16len)
+{
+	*utf8len = 0;
+	*utf16len = 0;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const UINT32 kind = test_rand(state) % 10;
+		if (kind < 6)
+		{
+			const size_t run = test_rand(state) % 70;
+			for (size_t y = 0; y < run; y++)
+				append_codepoint(0x20 + test_rand(state) % 0x5F, utf8, utf8len, utf16, utf16len);
+		}
+		else if (kind < 8)
+			append_codepoint(0x80 + test_rand(state) % (0x800 - 0x80), utf8, utf8len, utf16,
+			                 utf16len);
+		else if (kind < 9)
+		{
+			UINT32 cp = 0x800 + test_rand(state) % (0x10000 - 0x800);
+			if ((cp >= 0xD800) && (cp <= 0xDFFF))
+				cp -= 0x800;
+			append_codepoint(cp, utf8, utf8len, utf16, utf16len);
+		}
+		else
+			append_codepoint(0x10000 + test_rand(state) % 0x100000, utf8, utf8len, utf16,
+			                 utf16len);
+	}
+}
+
+static BOOL test_fast_path_mixed(void)
+{
+	BOOL rc = FALSE;
+	UINT32 state = 0x1234;
+	const size_t maxcount = 128;
+	char* utf8 = calloc(maxcount * 70 * 4 + 1, sizeof(char));
+	WCHAR* utf16 = calloc(maxcount * 70 * 2 + 1, sizeof(WCHAR));
+	char* out8 = calloc(maxcount * 70 * 4 + 1, sizeof(char));
+	WCHAR* out16 = calloc(maxcount * 70 * 2 + 1, sizeof(WCHAR));
+
+	if (!utf8 || !utf16 || !out8 || !out16)
+		goto fail;
+
+	for (size_t x = 0; x < 500; x++)
+	{
+		size_t utf8len = 0;
+		size_t utf16len = 0;
+		create_mixed_string(&state, 1 + test_rand(&state) % maxcount, utf8, &utf8len, utf16,
+		                    &utf16len);
+		if (utf16len == 0)
+			continue;
+
+		const SSIZE_T wlen = ConvertUtf8NToWChar(utf8, utf8len, NULL, 0);
+		const SSIZE_T wrc = ConvertUtf8NToWChar(utf8, utf8len, out16, utf16len);
+		if ((wlen != (SSIZE_T)utf16len) || (wrc != (SSIZE_T)utf16len) ||
+		    (memcmp(out16, utf16, utf16len * sizeof(WCHAR)) != 0))
+		{
+			(void)fprintf(stderr,
+			              "[%" PRIuz "] UTF-8 -> UTF-16 mismatch: expected %" PRIuz
+			              ", got %" PRIdz " / %" PRIdz "\n",
+			              x, utf16len, wlen, wrc);
+			goto fail;
+		}
+
+		const SSIZE_T len = ConvertWCharNToUtf8(utf16, utf16len, NULL, 0);
+		const SSIZE_T crc = ConvertWCharNToUtf8(utf16, utf16len, out8, utf8len);
+		if ((len != (SSIZE_T)utf8len) || (crc != (SSIZE_T)utf8len) ||
+		    (memcmp(out8, utf8, utf8len) != 0))
+		{
+			(void)fprintf(stderr,
+			              "[%" PRIuz "] UTF-16 -> UTF-8 mismatch: expected %" PRIuz
+			              ", got %" PRIdz " / %" PRIdz "\n",
+			              x, utf8len, len, crc);
+			goto fail;
+		}
+
+		/* The output buffer ends inside the converted string */
+		if (ConvertUtf8NToWChar(utf8, utf8len, out16, utf16len - 1) >= 0)
+		{
+			(void)fprintf(stderr, "[%" PRIuz "] UTF-8 -> UTF-16 short buffer not detected\n", x);
+			goto fail;
+		}
+		if (ConvertWCharNToUtf8(utf16, utf16len, out8, utf8len - 1) >= 0)
+		{
+			(void)fprintf(stderr, "[%" PRIuz "] UTF-16 -> UTF-8 short buffer not detected\n", x);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(utf8);
+	free(utf16);
+	free(out8);
+	free(out16);
+	return rc;
+}
+
+/* Invalid input behind a long ASCII run must be handled exactly like invalid input alone */
+static BOOL test_fast_path_invalid(void)
+{
+	static const char* invalid_utf8[] = { "\xC0\x80", "\xE0\x80\x80", "\xED\xA0\x80",
+		                                  "\xC3",     "\xFF",         "\xE4\xBD" };
+	static const WCHAR invalid_utf16[][2] = {
+		{ 0xD800, 'a' }, { 0xDC00, 'a' }, { 0xDBFF, 0xDBFF }
+	};
+	const char prefix[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	const size_t prefixlen = strlen(prefix);
+
+	for (size_t x = 0; x < ARRAYSIZE(invalid_utf8); x++)
+	{
+		char str[128] = { 0 };
+		WCHAR alone[32] = { 0 };
+		WCHAR full[128] = { 0 };
+
+		const size_t len = strlen(invalid_utf8[x]);
+		memcpy(str, prefix, prefixlen);
+		memcpy(&str[prefixlen], invalid_utf8[x], len);
+
+		const SSIZE_T arc = ConvertUtf8NToWChar(invalid_utf8[x], len, alone, ARRAYSIZE(alone));
+		const SSIZE_T frc = ConvertUtf8NToWChar(str, prefixlen + len, full, ARRAYSIZE(full));
+		if (arc < 0)
+		{
+			if (frc >= 0)
+				goto fail_utf8;
+			continue;
+		}
+
+		if ((frc != arc + (SSIZE_T)prefixlen) ||
+		    (memcmp(&full[prefixlen], alone, (size_t)arc * sizeof(WCHAR)) != 0))
+			goto fail_utf8;
+		for (size_t y = 0; y < prefixlen; y++)
+		{
+			if (full[y] != (WCHAR)prefix[y])
+				goto fail_utf8;
+		}
+		continue;
+
+	fail_utf8:
+		(void)fprintf(stderr, "[%" PRIuz "] invalid UTF-8 handled differently: %" PRIdz
+		                      " vs %" PRIdz "\n",
+		              x, arc, frc);
+		return FALSE;
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(invalid_utf16); x++)
+	{
+		WCHAR wstr[128] = { 0 };
+		char alone[32] = { 0 };
+		char full[128] = { 0 };
+
+		for (size_t y = 0; y < prefixlen; y++)
+			wstr[y] = (WCHAR)prefix[y];
+		memcpy(&wstr[prefixlen], invalid_utf16[x], sizeof(invalid_utf16[x]));
+
+		const SSIZE_T arc = ConvertWCharNToUtf8(invalid_utf16[x], 2, alone, sizeof(alone));
+		const SSIZE_T frc = ConvertWCharNToUtf8(wstr, prefixlen + 2, full, sizeof(full));
+		if (arc < 0)
+		{
+			if (frc >= 0)
+				goto fail_utf16;
+			continue;
+		}
+
+		if ((frc != arc + (SSIZE_T)prefixlen) || (memcmp(full, prefix, prefixlen) != 0) ||
+		    (memcmp(&full[prefixlen], alone, (size_t)arc) != 0))
+			goto fail_utf16;
+		continue;
+
+	fail_utf16:
+		(void)fprintf(stderr, "[%" PRIuz "] invalid UTF-16 handled differently: %" PRIdz
+		                      " vs %" PRIdz "\n",
+		              x, arc, frc);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL bench_fast_path(const char* name, const char* utf8, size_t utf8len,
+                            const WCHAR* utf16, size_t utf16len)
+{
+	BOOL rc = FALSE;
+	const size_t rounds = 16;
+	char* out8 = calloc(utf8len + 1, sizeof(char));
+	WCHAR* out16 = calloc(utf16len + 1, sizeof(WCHAR));
+	if (!out8 || !out16)
+		goto fail;
+
+	const UINT64 start8 = winpr_GetTickCount64NS();
+	for (size_t x = 0; x < rounds; x++)
+	{
+		if (ConvertUtf8NToWChar(utf8, utf8len, out16, utf16len + 1) != (SSIZE_T)utf16len)
+			goto fail;
+	}
+	const UINT64 start16 = winpr_GetTickCount64NS();
+	for (size_t x = 0; x < rounds; x++)
+	{
+		if (ConvertWCharNToUtf8(utf16, utf16len, out8, utf8len + 1) != (SSIZE_T)utf8len)
+			goto fail;
+	}
+	const UINT64 end = winpr_GetTickCount64NS();
+
+	const double mb = 1.0 * (double)(rounds * utf8len) / 1024.0 / 1024.0;
+	printf("%-8s UTF-8 -> UTF-16: %8.1f MiB/s, UTF-16 -> UTF-8: %8.1f MiB/s\n", name,
+	       mb * 1e9 / (double)MAX(start16 - start8, 1),
+	       mb * 1e9 / (double)MAX(end - start16, 1));
+	rc = TRUE;
+fail:
+	free(out8);
+	free(out16);
+	return rc;
+}
+
+static BOOL bench_fast_paths(void)
+{
+	BOOL rc = FALSE;
+	const size_t count = 256 * 1024;
+	char* utf8 = calloc(count * 3 + 1, sizeof(char));
+	WCHAR* utf16 = calloc(count + 1, sizeof(WCHAR));
+	if (!utf8 || !utf16)
+		goto fail;
+
+	const struct
+	{
+		const char* name;
+		UINT32 base;
+		UINT32 range;
+	} cases[] = { { "ASCII", 0x20, 0x5F }, { "Cyrillic", 0x410, 0x40 }, { "CJK", 0x4E00, 0x5000 } };
+
+	for (size_t x = 0; x < ARRAYSIZE(cases); x++)
+	{
+		UINT32 state = 42;
+		size_t utf8len = 0;
+		size_t utf16len = 0;
+		for (size_t y = 0; y < count; y++)
+		{
+			/* keep spaces in, like real text */
+			UINT32 cp = cases[x].base + test_rand(&state) % cases[x].range;
+			if ((y % 8) == 7)
+				cp = ' ';
+			append_codepoint(cp, utf8, &utf8len, utf16, &utf16len);
+		}
+
+		if (!bench_fast_path(cases[x].name, utf8, utf8len, utf16, utf16len))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(utf8);
+	free(utf16);
+	return rc;
+}
+
 int TestUnicodeConversion(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -1165,6 +1467,15 @@ int TestUnicodeConversion(int argc, char* argv[])
 	if (!test_conversion(unit_testcases, ARRAYSIZE(unit_testcases)))
 		return -1;
 
+	if (!test_fast_path_mixed())
+		return -1;
+
+	if (!test_fast_path_invalid())
+		return -1;
+
+	if (!bench_fast_paths())
+		return -1;
+
 #if defined(WITH_WINPR_DEPRECATED)
 	if (!test_win_conversion(unit_testcases, ARRAYSIZE(unit_testcases)))
 		return -1;
@@ -32,6 +32,125 @@
 #ifndef _WIN32
 
 #include "unicode.h"
+#include "unicode_simd.h"
+
+/* The fast paths produce native endian WCHAR, the backends UTF-16LE */
+#if !defined(__BIG_ENDIAN__)
+#define WITH_UNICODE_FAST_PATH
+#endif
+
+#if defined(WITH_UNICODE_FAST_PATH)
+static BOOL unicode_fast_path_supported(UINT CodePage, const void* input, int inputlen,
+                                        const void* output, int outputlen)
+{
+	switch (CodePage)
+	{
+		case CP_ACP:
+		case CP_UTF8:
+			break;
+		default:
+			return FALSE;
+	}
+
+	if (!input || (inputlen == 0) || (inputlen < -1) || (outputlen < 0))
+		return FALSE;
+	if ((outputlen > 0) && !output)
+		return FALSE;
+	return TRUE;
+}
+
+/** @brief Convert ASCII and BMP runs with the vectorized fast path and hand the rest to the
+ * backend, which handles surrogates, invalid input and error reporting.
+ */
+static int unicode_utf8_to_utf16(UINT CodePage, DWORD dwFlags, LPCSTR lpMultiByteStr,
+                                 int cbMultiByte, LPWSTR lpWideCharStr, int cchWideChar)
+{
+	size_t len = 0;
+	if (cbMultiByte < 0)
+		len = strlen(lpMultiByteStr) + 1;
+	else
+		len = WINPR_ASSERTING_INT_CAST(size_t, cbMultiByte);
+
+	if (len >= INT_MAX)
+		return int_MultiByteToWideChar(CodePage, dwFlags, lpMultiByteStr, cbMultiByte,
+		                               lpWideCharStr, cchWideChar);
+
+	const size_t capacity = WINPR_ASSERTING_INT_CAST(size_t, cchWideChar);
+	WCHAR* dst = (capacity > 0) ? lpWideCharStr : NULL;
+	size_t written = 0;
+	const size_t done =
+	    winpr_unicode_utf8_to_utf16_fast(lpMultiByteStr, len, dst, capacity, &written);
+	if (done == len)
+		return WINPR_ASSERTING_INT_CAST(int, written);
+
+	if (dst && (written >= capacity))
+	{
+		SetLastError(ERROR_INSUFFICIENT_BUFFER);
+		return 0;
+	}
+
+	const int rc = int_MultiByteToWideChar(
+	    CodePage, dwFlags, &lpMultiByteStr[done], WINPR_ASSERTING_INT_CAST(int, len - done),
+	    dst ? &dst[written] : NULL, WINPR_ASSERTING_INT_CAST(int, dst ? capacity - written : 0));
+	if (rc <= 0)
+		return rc;
+
+	const size_t total = written + WINPR_ASSERTING_INT_CAST(size_t, rc);
+	if (total > INT_MAX)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 0;
+	}
+	return WINPR_ASSERTING_INT_CAST(int, total);
+}
+
+static int unicode_utf16_to_utf8(UINT CodePage, DWORD dwFlags, LPCWSTR lpWideCharStr,
+                                 int cchWideChar, LPSTR lpMultiByteStr, int cbMultiByte,
+                                 LPCSTR lpDefaultChar, LPBOOL lpUsedDefaultChar)
+{
+	size_t len = 0;
+	if (cchWideChar < 0)
+		len = _wcslen(lpWideCharStr) + 1;
+	else
+		len = WINPR_ASSERTING_INT_CAST(size_t, cchWideChar);
+
+	if (len >= INT32_MAX)
+		return int_WideCharToMultiByte(CodePage, dwFlags, lpWideCharStr, cchWideChar,
+		                               lpMultiByteStr, cbMultiByte, lpDefaultChar,
+		                               lpUsedDefaultChar);
+
+	const size_t capacity = WINPR_ASSERTING_INT_CAST(size_t, cbMultiByte);
+	char* dst = (capacity > 0) ? lpMultiByteStr : NULL;
+	size_t written = 0;
+	const size_t done =
+	    winpr_unicode_utf16_to_utf8_fast(lpWideCharStr, len, dst, capacity, &written);
+	if ((done < len) && dst && (written >= capacity))
+	{
+		SetLastError(ERROR_INSUFFICIENT_BUFFER);
+		return 0;
+	}
+
+	int rc = 0;
+	if (done < len)
+	{
+		rc = int_WideCharToMultiByte(CodePage, dwFlags, &lpWideCharStr[done],
+		                             WINPR_ASSERTING_INT_CAST(int, len - done),
+		                             dst ? &dst[written] : NULL,
+		                             WINPR_ASSERTING_INT_CAST(int, dst ? capacity - written : 0),
+		                             lpDefaultChar, lpUsedDefaultChar);
+		if (rc <= 0)
+			return rc;
+	}
+
+	const size_t total = written + WINPR_ASSERTING_INT_CAST(size_t, rc);
+	if (total > INT_MAX)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 0;
+	}
+	return WINPR_ASSERTING_INT_CAST(int, total);
+}
+#endif
 
 /**
  * Notes on cross-platform Unicode portability:
@@ -153,6 +272,12 @@ static
     MultiByteToWideChar(UINT CodePage, DWORD dwFlags, LPCSTR lpMultiByteStr, int cbMultiByte,
                         LPWSTR lpWideCharStr, int cchWideChar)
 {
+#if defined(WITH_UNICODE_FAST_PATH)
+	if (unicode_fast_path_supported(CodePage, lpMultiByteStr, cbMultiByte, lpWideCharStr,
+	                                cchWideChar))
+		return unicode_utf8_to_utf16(CodePage, dwFlags, lpMultiByteStr, cbMultiByte,
+		                             lpWideCharStr, cchWideChar);
+#endif
 	return int_MultiByteToWideChar(CodePage, dwFlags, lpMultiByteStr, cbMultiByte, lpWideCharStr,
 	                               cchWideChar);
 }
@@ -204,6 +329,13 @@ static
                         LPSTR lpMultiByteStr, int cbMultiByte, LPCSTR lpDefaultChar,
                         LPBOOL lpUsedDefaultChar)
 {
+#if defined(WITH_UNICODE_FAST_PATH)
+	if (unicode_fast_path_supported(CodePage, lpWideCharStr, cchWideChar, lpMultiByteStr,
+	                                cbMultiByte))
+		return unicode_utf16_to_utf8(CodePage, dwFlags, lpWideCharStr, cchWideChar,
+		                             lpMultiByteStr, cbMultiByte, lpDefaultChar,
+		                             lpUsedDefaultChar);
+#endif
 	return int_WideCharToMultiByte(CodePage, dwFlags, lpWideCharStr, cchWideChar, lpMultiByteStr,
 	                               cbMultiByte, lpDefaultChar, lpUsedDefaultChar);
 }
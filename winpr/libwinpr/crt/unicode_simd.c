@@ -0,0 +1,266 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Unicode Conversion (CRT), vectorized fast paths
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+#include <winpr/synch.h>
+#include <winpr/endian.h>
+
+#include "unicode_simd.h"
+
+#ifndef MIN
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#define ASCII_MASK_8 0x8080808080808080ULL
+#define ASCII_MASK_16 0xFF80FF80FF80FF80ULL
+
+static size_t utf8_to_utf16_ascii_generic(const char* WINPR_RESTRICT src,
+                                          WCHAR* WINPR_RESTRICT dst, size_t len)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= len; x += 8)
+	{
+		const UINT64 v = winpr_Data_Get_UINT64_NE(&src[x]);
+		if (v & ASCII_MASK_8)
+			break;
+		if (dst)
+		{
+			for (size_t y = 0; y < 8; y++)
+				dst[x + y] = (BYTE)src[x + y];
+		}
+	}
+
+	for (; x < len; x++)
+	{
+		const BYTE c = (BYTE)src[x];
+		if (c & 0x80)
+			break;
+		if (dst)
+			dst[x] = c;
+	}
+	return x;
+}
+
+static size_t utf16_to_utf8_ascii_generic(const WCHAR* WINPR_RESTRICT src,
+                                          char* WINPR_RESTRICT dst, size_t len)
+{
+	size_t x = 0;
+
+	for (; x + 4 <= len; x += 4)
+	{
+		const UINT64 v = winpr_Data_Get_UINT64_NE(&src[x]);
+		if (v & ASCII_MASK_16)
+			break;
+		for (size_t y = 0; y < 4; y++)
+			dst[x + y] = (char)src[x + y];
+	}
+
+	for (; x < len; x++)
+	{
+		const WCHAR c = src[x];
+		if (c & 0xFF80)
+			break;
+		dst[x] = (char)c;
+	}
+	return x;
+}
+
+static size_t utf16_to_utf8_length_generic(const WCHAR* WINPR_RESTRICT src, size_t len,
+                                           size_t* WINPR_RESTRICT bytes)
+{
+	size_t count = 0;
+	size_t x = 0;
+
+	for (; x < len; x++)
+	{
+		const WCHAR c = src[x];
+		if (c < 0x80)
+			count += 1;
+		else if (c < 0x800)
+			count += 2;
+		else if ((c & 0xF800) == 0xD800)
+			break;
+		else
+			count += 3;
+	}
+
+	*bytes += count;
+	return x;
+}
+
+static winpr_unicode_kernels_t g_kernels = { utf8_to_utf16_ascii_generic,
+	                                         utf16_to_utf8_ascii_generic,
+	                                         utf16_to_utf8_length_generic };
+static INIT_ONCE g_kernels_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK winpr_unicode_kernels_init(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                                WINPR_ATTR_UNUSED PVOID param,
+                                                WINPR_ATTR_UNUSED PVOID* context)
+{
+#if defined(WINPR_UNICODE_SSE_AVX_ENABLED)
+	if (IsProcessorFeaturePresent(PF_SSE4_1_INSTRUCTIONS_AVAILABLE))
+		winpr_unicode_kernels_init_sse41(&g_kernels);
+#if defined(WITH_AVX2)
+	if (IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE))
+		winpr_unicode_kernels_init_avx2(&g_kernels);
+#endif
+#elif defined(WINPR_UNICODE_NEON_ENABLED)
+	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+		winpr_unicode_kernels_init_neon(&g_kernels);
+#endif
+	return TRUE;
+}
+
+static const winpr_unicode_kernels_t* winpr_unicode_kernels(void)
+{
+	(void)InitOnceExecuteOnce(&g_kernels_once, winpr_unicode_kernels_init, NULL, NULL);
+	return &g_kernels;
+}
+
+static INLINE BOOL is_continuation(BYTE c)
+{
+	return (c & 0xC0) == 0x80;
+}
+
+size_t winpr_unicode_utf8_to_utf16_fast(const char* WINPR_RESTRICT src, size_t len,
+                                        WCHAR* WINPR_RESTRICT dst, size_t dstlen,
+                                        size_t* WINPR_RESTRICT written)
+{
+	const winpr_unicode_kernels_t* kernels = winpr_unicode_kernels();
+	const BYTE* str = (const BYTE*)src;
+	size_t x = 0;
+	size_t y = 0;
+
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(written);
+
+	if (!dst)
+		dstlen = SIZE_MAX;
+
+	while ((x < len) && (y < dstlen))
+	{
+		const BYTE c = str[x];
+		WCHAR ch = c;
+
+		if (c < 0x80)
+		{
+			/* Single ASCII characters (spaces, punctuation) are cheaper inline */
+			if ((len - x > 1) && (str[x + 1] < 0x80))
+			{
+				const size_t count = MIN(len - x, dstlen - y);
+				const size_t ascii =
+				    kernels->utf8_to_utf16_ascii(&src[x], dst ? &dst[y] : NULL, count);
+				x += ascii;
+				y += ascii;
+				continue;
+			}
+			x++;
+		}
+		else if ((c >= 0xC2) && (c <= 0xDF))
+		{
+			if ((len - x < 2) || !is_continuation(str[x + 1]))
+				break;
+			ch = (WCHAR)(((c & 0x1F) << 6) | (str[x + 1] & 0x3F));
+			x += 2;
+		}
+		else if ((c >= 0xE0) && (c <= 0xEF))
+		{
+			if ((len - x < 3) || !is_continuation(str[x + 1]) || !is_continuation(str[x + 2]))
+				break;
+			/* overlong encodings and surrogates are left to the full converter */
+			if ((c == 0xE0) && (str[x + 1] < 0xA0))
+				break;
+			if ((c == 0xED) && (str[x + 1] >= 0xA0))
+				break;
+			ch = (WCHAR)(((c & 0x0F) << 12) | ((str[x + 1] & 0x3F) << 6) | (str[x + 2] & 0x3F));
+			x += 3;
+		}
+		else
+			break;
+
+		if (dst)
+			dst[y] = ch;
+		y++;
+	}
+
+	*written = y;
+	return x;
+}
+
+size_t winpr_unicode_utf16_to_utf8_fast(const WCHAR* WINPR_RESTRICT src, size_t len,
+                                        char* WINPR_RESTRICT dst, size_t dstlen,
+                                        size_t* WINPR_RESTRICT written)
+{
+	const winpr_unicode_kernels_t* kernels = winpr_unicode_kernels();
+	size_t x = 0;
+	size_t y = 0;
+
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(written);
+
+	if (!dst)
+	{
+		x = kernels->utf16_to_utf8_length(src, len, &y);
+		*written = y;
+		return x;
+	}
+
+	while (x < len)
+	{
+		const WCHAR c = src[x];
+		if (c < 0x80)
+		{
+			if (y >= dstlen)
+				break;
+			/* Single ASCII characters (spaces, punctuation) are cheaper inline */
+			if ((len - x > 1) && (src[x + 1] < 0x80))
+			{
+				const size_t count = MIN(len - x, dstlen - y);
+				const size_t ascii = kernels->utf16_to_utf8_ascii(&src[x], &dst[y], count);
+				x += ascii;
+				y += ascii;
+				continue;
+			}
+			dst[y++] = (char)c;
+		}
+		else if (c < 0x800)
+		{
+			if (dstlen - y < 2)
+				break;
+			dst[y++] = (char)(0xC0 | (c >> 6));
+			dst[y++] = (char)(0x80 | (c & 0x3F));
+		}
+		else if ((c & 0xF800) == 0xD800)
+			break;
+		else
+		{
+			if (dstlen - y < 3)
+				break;
+			dst[y++] = (char)(0xE0 | (c >> 12));
+			dst[y++] = (char)(0x80 | ((c >> 6) & 0x3F));
+			dst[y++] = (char)(0x80 | (c & 0x3F));
+		}
+		x++;
+	}
+
+	*written = y;
+	return x;
+}
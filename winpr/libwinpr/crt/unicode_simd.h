@@ -0,0 +1,88 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Unicode Conversion (CRT), vectorized fast paths
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WINPR_CRT_UNICODE_SIMD_INTERNAL
+#define WINPR_CRT_UNICODE_SIMD_INTERNAL
+
+#include <winpr/wtypes.h>
+#include <winpr/platform.h>
+
+#if defined(WITH_SIMD)
+#if defined(_M_X64) || defined(__x86_64__) || defined(__i386__) || defined(_M_IX86)
+#define WINPR_UNICODE_SSE_AVX_ENABLED
+#endif
+#if defined(_M_ARM64) || defined(__aarch64__) || defined(_M_ARM) || defined(__arm__)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define WINPR_UNICODE_NEON_ENABLED
+#endif
+#endif
+#endif
+
+/** @brief Kernels used by the UTF-8 / UTF-16 fast paths.
+ *
+ *  All kernels process at most \b len units from the start of \b src and return the number of
+ *  units handled. They stop early at the first unit they do not handle, the caller continues
+ *  from there.
+ */
+typedef struct
+{
+	/** Convert ASCII bytes to UTF-16, \b dst may be \b NULL to only count */
+	size_t (*utf8_to_utf16_ascii)(const char* WINPR_RESTRICT src, WCHAR* WINPR_RESTRICT dst,
+	                              size_t len);
+	/** Convert ASCII UTF-16 units to UTF-8 */
+	size_t (*utf16_to_utf8_ascii)(const WCHAR* WINPR_RESTRICT src, char* WINPR_RESTRICT dst,
+	                              size_t len);
+	/** Add the UTF-8 length of BMP units to \b bytes, stops at surrogates */
+	size_t (*utf16_to_utf8_length)(const WCHAR* WINPR_RESTRICT src, size_t len,
+	                               size_t* WINPR_RESTRICT bytes);
+} winpr_unicode_kernels_t;
+
+void winpr_unicode_kernels_init_sse41(winpr_unicode_kernels_t* kernels);
+void winpr_unicode_kernels_init_avx2(winpr_unicode_kernels_t* kernels);
+void winpr_unicode_kernels_init_neon(winpr_unicode_kernels_t* kernels);
+
+/** @brief Convert the leading ASCII and BMP part of a UTF-8 string to UTF-16.
+ *
+ *  Stops at 4 byte sequences, invalid or truncated input and when \b dst is full.
+ *
+ *  @param src The UTF-8 input
+ *  @param len The number of bytes in \b src
+ *  @param dst The output buffer or \b NULL to only count the result length
+ *  @param dstlen The number of WCHAR available in \b dst
+ *  @param written Returns the number of WCHAR (to be) written
+ *  @return The number of bytes consumed from \b src
+ */
+size_t winpr_unicode_utf8_to_utf16_fast(const char* WINPR_RESTRICT src, size_t len,
+                                        WCHAR* WINPR_RESTRICT dst, size_t dstlen,
+                                        size_t* WINPR_RESTRICT written);
+
+/** @brief Convert the leading ASCII and BMP part of a UTF-16 string to UTF-8.
+ *
+ *  Stops at surrogates and when \b dst is full.
+ *
+ *  @param src The UTF-16 input
+ *  @param len The number of WCHAR in \b src
+ *  @param dst The output buffer or \b NULL to only count the result length
+ *  @param dstlen The number of bytes available in \b dst
+ *  @param written Returns the number of bytes (to be) written
+ *  @return The number of WCHAR consumed from \b src
+ */
+size_t winpr_unicode_utf16_to_utf8_fast(const WCHAR* WINPR_RESTRICT src, size_t len,
+                                        char* WINPR_RESTRICT dst, size_t dstlen,
+                                        size_t* WINPR_RESTRICT written);
+
+#endif /* WINPR_CRT_UNICODE_SIMD_INTERNAL */
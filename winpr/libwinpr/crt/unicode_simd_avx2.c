@@ -0,0 +1,154 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Unicode Conversion (CRT), AVX2 fast paths
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+#include <winpr/assert.h>
+
+#include "unicode_simd.h"
+
+#if defined(WINPR_UNICODE_SSE_AVX_ENABLED)
+#include <immintrin.h>
+
+static size_t utf8_to_utf16_ascii_avx2(const char* WINPR_RESTRICT src, WCHAR* WINPR_RESTRICT dst,
+                                       size_t len)
+{
+	size_t x = 0;
+
+	for (; x + 32 <= len; x += 32)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i*)&src[x]);
+		if (_mm256_movemask_epi8(v) != 0)
+			break;
+		if (dst)
+		{
+			_mm256_storeu_si256((__m256i*)&dst[x],
+			                    _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+			_mm256_storeu_si256((__m256i*)&dst[x + 16],
+			                    _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+		}
+	}
+
+	for (; x < len; x++)
+	{
+		const BYTE c = (BYTE)src[x];
+		if (c & 0x80)
+			break;
+		if (dst)
+			dst[x] = c;
+	}
+	return x;
+}
+
+static size_t utf16_to_utf8_ascii_avx2(const WCHAR* WINPR_RESTRICT src, char* WINPR_RESTRICT dst,
+                                       size_t len)
+{
+	const __m256i mask = _mm256_set1_epi16((short)0xFF80);
+	size_t x = 0;
+
+	for (; x + 32 <= len; x += 32)
+	{
+		const __m256i a = _mm256_loadu_si256((const __m256i*)&src[x]);
+		const __m256i b = _mm256_loadu_si256((const __m256i*)&src[x + 16]);
+		if (!_mm256_testz_si256(_mm256_or_si256(a, b), mask))
+			break;
+		/* packus works per 128 bit lane, restore the order of the 64 bit quarters */
+		const __m256i packed = _mm256_packus_epi16(a, b);
+		_mm256_storeu_si256((__m256i*)&dst[x], _mm256_permute4x64_epi64(packed, 0xD8));
+	}
+
+	for (; x < len; x++)
+	{
+		const WCHAR c = src[x];
+		if (c & 0xFF80)
+			break;
+		dst[x] = (char)c;
+	}
+	return x;
+}
+
+static size_t utf16_to_utf8_length_avx2(const WCHAR* WINPR_RESTRICT src, size_t len,
+                                        size_t* WINPR_RESTRICT bytes)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i three = _mm256_set1_epi16(3);
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i m80 = _mm256_set1_epi16((short)0xFF80);
+	const __m256i m800 = _mm256_set1_epi16((short)0xF800);
+	const __m256i surrogate = _mm256_set1_epi16((short)0xD800);
+	size_t count = 0;
+	size_t x = 0;
+
+	while (x + 16 <= len)
+	{
+		/* 16 bit lanes count at most 3 per round, flush before they can overflow */
+		__m256i acc = zero;
+		size_t rounds = 0;
+
+		for (; (x + 16 <= len) && (rounds < 0x2000); x += 16, rounds++)
+		{
+			const __m256i v = _mm256_loadu_si256((const __m256i*)&src[x]);
+			const __m256i hi = _mm256_and_si256(v, m800);
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(hi, surrogate)) != 0)
+				break;
+			const __m256i lt80 = _mm256_cmpeq_epi16(_mm256_and_si256(v, m80), zero);
+			const __m256i lt800 = _mm256_cmpeq_epi16(hi, zero);
+			acc = _mm256_add_epi16(acc, _mm256_add_epi16(three, _mm256_add_epi16(lt80, lt800)));
+		}
+
+		const __m256i sum32 = _mm256_madd_epi16(acc, ones);
+		__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sum32),
+		                            _mm256_extracti128_si256(sum32, 1));
+		sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+		sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 4));
+		count += (UINT32)_mm_cvtsi128_si32(sum);
+
+		if (rounds < 0x2000)
+			break;
+	}
+
+	*bytes += count;
+
+	for (; x < len; x++)
+	{
+		const WCHAR c = src[x];
+		if (c < 0x80)
+			*bytes += 1;
+		else if (c < 0x800)
+			*bytes += 2;
+		else if ((c & 0xF800) == 0xD800)
+			break;
+		else
+			*bytes += 3;
+	}
+	return x;
+}
+
+void winpr_unicode_kernels_init_avx2(winpr_unicode_kernels_t* kernels)
+{
+	WINPR_ASSERT(kernels);
+	kernels->utf8_to_utf16_ascii = utf8_to_utf16_ascii_avx2;
+	kernels->utf16_to_utf8_ascii = utf16_to_utf8_ascii_avx2;
+	kernels->utf16_to_utf8_length = utf16_to_utf8_length_avx2;
+}
+
+#else
+
+void winpr_unicode_kernels_init_avx2(WINPR_ATTR_UNUSED winpr_unicode_kernels_t* kernels)
+{
+}
+
+#endif
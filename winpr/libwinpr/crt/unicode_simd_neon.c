@@ -0,0 +1,156 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Unicode Conversion (CRT), NEON fast paths
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+#include <winpr/assert.h>
+
+#include "unicode_simd.h"
+
+#if defined(WINPR_UNICODE_NEON_ENABLED)
+#include <arm_neon.h>
+
+static INLINE BOOL any_set_u8(uint8x16_t v)
+{
+	const uint8x8_t m = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+	return vget_lane_u64(vreinterpret_u64_u8(m), 0) != 0;
+}
+
+static INLINE BOOL any_set_u16(uint16x8_t v)
+{
+	return any_set_u8(vreinterpretq_u8_u16(v));
+}
+
+static size_t utf8_to_utf16_ascii_neon(const char* WINPR_RESTRICT src, WCHAR* WINPR_RESTRICT dst,
+                                       size_t len)
+{
+	const uint8x16_t mask = vdupq_n_u8(0x80);
+	size_t x = 0;
+
+	for (; x + 16 <= len; x += 16)
+	{
+		const uint8x16_t v = vld1q_u8((const uint8_t*)&src[x]);
+		if (any_set_u8(vandq_u8(v, mask)))
+			break;
+		if (dst)
+		{
+			vst1q_u16((uint16_t*)&dst[x], vmovl_u8(vget_low_u8(v)));
+			vst1q_u16((uint16_t*)&dst[x + 8], vmovl_u8(vget_high_u8(v)));
+		}
+	}
+
+	for (; x < len; x++)
+	{
+		const BYTE c = (BYTE)src[x];
+		if (c & 0x80)
+			break;
+		if (dst)
+			dst[x] = c;
+	}
+	return x;
+}
+
+static size_t utf16_to_utf8_ascii_neon(const WCHAR* WINPR_RESTRICT src, char* WINPR_RESTRICT dst,
+                                       size_t len)
+{
+	const uint16x8_t mask = vdupq_n_u16(0xFF80);
+	size_t x = 0;
+
+	for (; x + 16 <= len; x += 16)
+	{
+		const uint16x8_t a = vld1q_u16((const uint16_t*)&src[x]);
+		const uint16x8_t b = vld1q_u16((const uint16_t*)&src[x + 8]);
+		if (any_set_u16(vandq_u16(vorrq_u16(a, b), mask)))
+			break;
+		vst1q_u8((uint8_t*)&dst[x], vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+	}
+
+	for (; x < len; x++)
+	{
+		const WCHAR c = src[x];
+		if (c & 0xFF80)
+			break;
+		dst[x] = (char)c;
+	}
+	return x;
+}
+
+static size_t utf16_to_utf8_length_neon(const WCHAR* WINPR_RESTRICT src, size_t len,
+                                        size_t* WINPR_RESTRICT bytes)
+{
+	const uint16x8_t m800 = vdupq_n_u16(0xF800);
+	const uint16x8_t surrogate = vdupq_n_u16(0xD800);
+	const uint16x8_t c80 = vdupq_n_u16(0x80);
+	const uint16x8_t c800 = vdupq_n_u16(0x800);
+	size_t count = 0;
+	size_t x = 0;
+
+	while (x + 8 <= len)
+	{
+		/* 16 bit lanes count at most 2 extra bytes per round, flush before they overflow */
+		uint16x8_t acc = vdupq_n_u16(0);
+		size_t rounds = 0;
+
+		for (; (x + 8 <= len) && (rounds < 0x4000); x += 8, rounds++)
+		{
+			const uint16x8_t v = vld1q_u16((const uint16_t*)&src[x]);
+			if (any_set_u16(vceqq_u16(vandq_u16(v, m800), surrogate)))
+				break;
+			const uint16x8_t ge80 = vshrq_n_u16(vcgeq_u16(v, c80), 15);
+			const uint16x8_t ge800 = vshrq_n_u16(vcgeq_u16(v, c800), 15);
+			acc = vaddq_u16(acc, vaddq_u16(ge80, ge800));
+		}
+
+		const uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(acc));
+		count += rounds * 8;
+		count += vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+
+		if (rounds < 0x4000)
+			break;
+	}
+
+	*bytes += count;
+
+	for (; x < len; x++)
+	{
+		const WCHAR c = src[x];
+		if (c < 0x80)
+			*bytes += 1;
+		else if (c < 0x800)
+			*bytes += 2;
+		else if ((c & 0xF800) == 0xD800)
+			break;
+		else
+			*bytes += 3;
+	}
+	return x;
+}
+
+void winpr_unicode_kernels_init_neon(winpr_unicode_kernels_t* kernels)
+{
+	WINPR_ASSERT(kernels);
+	kernels->utf8_to_utf16_ascii = utf8_to_utf16_ascii_neon;
+	kernels->utf16_to_utf8_ascii = utf16_to_utf8_ascii_neon;
+	kernels->utf16_to_utf8_length = utf16_to_utf8_length_neon;
+}
+
+#else
+
+void winpr_unicode_kernels_init_neon(WINPR_ATTR_UNUSED winpr_unicode_kernels_t* kernels)
+{
+}
+
+#endif
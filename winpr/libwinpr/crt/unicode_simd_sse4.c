@@ -0,0 +1,148 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Unicode Conversion (CRT), SSE4.1 fast paths
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+#include <winpr/assert.h>
+
+#include "unicode_simd.h"
+
+#if defined(WINPR_UNICODE_SSE_AVX_ENABLED)
+#include <smmintrin.h>
+
+static size_t utf8_to_utf16_ascii_sse41(const char* WINPR_RESTRICT src, WCHAR* WINPR_RESTRICT dst,
+                                        size_t len)
+{
+	size_t x = 0;
+
+	for (; x + 16 <= len; x += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)&src[x]);
+		if (_mm_movemask_epi8(v) != 0)
+			break;
+		if (dst)
+		{
+			_mm_storeu_si128((__m128i*)&dst[x], _mm_cvtepu8_epi16(v));
+			_mm_storeu_si128((__m128i*)&dst[x + 8], _mm_cvtepu8_epi16(_mm_srli_si128(v, 8)));
+		}
+	}
+
+	for (; x < len; x++)
+	{
+		const BYTE c = (BYTE)src[x];
+		if (c & 0x80)
+			break;
+		if (dst)
+			dst[x] = c;
+	}
+	return x;
+}
+
+static size_t utf16_to_utf8_ascii_sse41(const WCHAR* WINPR_RESTRICT src, char* WINPR_RESTRICT dst,
+                                        size_t len)
+{
+	const __m128i mask = _mm_set1_epi16((short)0xFF80);
+	size_t x = 0;
+
+	for (; x + 16 <= len; x += 16)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)&src[x]);
+		const __m128i b = _mm_loadu_si128((const __m128i*)&src[x + 8]);
+		if (!_mm_testz_si128(_mm_or_si128(a, b), mask))
+			break;
+		_mm_storeu_si128((__m128i*)&dst[x], _mm_packus_epi16(a, b));
+	}
+
+	for (; x < len; x++)
+	{
+		const WCHAR c = src[x];
+		if (c & 0xFF80)
+			break;
+		dst[x] = (char)c;
+	}
+	return x;
+}
+
+static size_t utf16_to_utf8_length_sse41(const WCHAR* WINPR_RESTRICT src, size_t len,
+                                         size_t* WINPR_RESTRICT bytes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i three = _mm_set1_epi16(3);
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i m80 = _mm_set1_epi16((short)0xFF80);
+	const __m128i m800 = _mm_set1_epi16((short)0xF800);
+	const __m128i surrogate = _mm_set1_epi16((short)0xD800);
+	size_t count = 0;
+	size_t x = 0;
+
+	while (x + 8 <= len)
+	{
+		/* 16 bit lanes count at most 3 per round, flush before they can overflow */
+		__m128i acc = zero;
+		size_t rounds = 0;
+
+		for (; (x + 8 <= len) && (rounds < 0x2000); x += 8, rounds++)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*)&src[x]);
+			const __m128i hi = _mm_and_si128(v, m800);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(hi, surrogate)) != 0)
+				break;
+			const __m128i lt80 = _mm_cmpeq_epi16(_mm_and_si128(v, m80), zero);
+			const __m128i lt800 = _mm_cmpeq_epi16(hi, zero);
+			acc = _mm_add_epi16(acc, _mm_add_epi16(three, _mm_add_epi16(lt80, lt800)));
+		}
+
+		const __m128i sum32 = _mm_madd_epi16(acc, ones);
+		const __m128i sum64 = _mm_add_epi32(sum32, _mm_srli_si128(sum32, 8));
+		const __m128i sum = _mm_add_epi32(sum64, _mm_srli_si128(sum64, 4));
+		count += (UINT32)_mm_cvtsi128_si32(sum);
+
+		if (rounds < 0x2000)
+			break;
+	}
+
+	*bytes += count;
+
+	for (; x < len; x++)
+	{
+		const WCHAR c = src[x];
+		if (c < 0x80)
+			*bytes += 1;
+		else if (c < 0x800)
+			*bytes += 2;
+		else if ((c & 0xF800) == 0xD800)
+			break;
+		else
+			*bytes += 3;
+	}
+	return x;
+}
+
+void winpr_unicode_kernels_init_sse41(winpr_unicode_kernels_t* kernels)
+{
+	WINPR_ASSERT(kernels);
+	kernels->utf8_to_utf16_ascii = utf8_to_utf16_ascii_sse41;
+	kernels->utf16_to_utf8_ascii = utf16_to_utf8_ascii_sse41;
+	kernels->utf16_to_utf8_length = utf16_to_utf8_length_sse41;
+}
+
+#else
+
+void winpr_unicode_kernels_init_sse41(WINPR_ATTR_UNUSED winpr_unicode_kernels_t* kernels)
+{
+}
+
+#endif
@@ -40,6 +40,7 @@
 #include <winpr/string.h>
 
 #include "file.h"
+#include "overlapped.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/file.h>
@@ -90,6 +91,8 @@ static BOOL FileCloseHandleInt(HANDLE handle, BOOL force)
 		}
 	}
 
+	winpr_file_overlapped_drain(file);
+
 	if (file->fp)
 	{
 		/* Don't close stdin/stdout/stderr */
@@ -218,6 +221,29 @@ static BOOL FileSetFilePointerEx(HANDLE hFile, LARGE_INTEGER liDistanceToMove,
 	return TRUE;
 }
 
+/* Handles opened without FILE_FLAG_OVERLAPPED use the offset of lpOverlapped synchronously */
+static BOOL FileSeekOverlapped(WINPR_FILE* file, const OVERLAPPED* lpOverlapped)
+{
+	const INT64 offset =
+	    (INT64)(((UINT64)lpOverlapped->DUMMYUNIONNAME.DUMMYSTRUCTNAME.OffsetHigh << 32) |
+	            lpOverlapped->DUMMYUNIONNAME.DUMMYSTRUCTNAME.Offset);
+
+	if (_fseeki64(file->fp, offset, SEEK_SET))
+	{
+		SetLastError(map_posix_err(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void FileCompleteOverlapped(LPOVERLAPPED lpOverlapped, BOOL success, size_t transferred)
+{
+	lpOverlapped->InternalHigh = transferred;
+	winpr_overlapped_set_status(lpOverlapped, success ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL);
+	if (lpOverlapped->hEvent)
+		(void)SetEvent(lpOverlapped->hEvent);
+}
+
 static BOOL FileRead(PVOID Object, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
                      LPDWORD lpNumberOfBytesRead, LPOVERLAPPED lpOverlapped)
 {
@@ -225,17 +251,24 @@ static BOOL FileRead(PVOID Object, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
 	WINPR_FILE* file = NULL;
 	BOOL status = TRUE;
 
-	if (lpOverlapped)
-	{
-		WLog_ERR(TAG, "WinPR does not support the lpOverlapped parameter");
-		SetLastError(ERROR_NOT_SUPPORTED);
-		return FALSE;
-	}
-
 	if (!Object)
 		return FALSE;
 
 	file = (WINPR_FILE*)Object;
+
+	if (lpOverlapped)
+	{
+		if (file->dwFlagsAndAttributes & FILE_FLAG_OVERLAPPED)
+		{
+			if (lpNumberOfBytesRead)
+				*lpNumberOfBytesRead = 0;
+			return winpr_file_overlapped_io(file, FALSE, lpBuffer, nNumberOfBytesToRead,
+			                                lpOverlapped);
+		}
+		if (!FileSeekOverlapped(file, lpOverlapped))
+			return FALSE;
+	}
+
 	clearerr(file->fp);
 	io_status = fread(lpBuffer, 1, nNumberOfBytesToRead, file->fp);
 
@@ -256,6 +289,9 @@ static BOOL FileRead(PVOID Object, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
 	if (lpNumberOfBytesRead)
 		*lpNumberOfBytesRead = (DWORD)io_status;
 
+	if (lpOverlapped)
+		FileCompleteOverlapped(lpOverlapped, status, io_status);
+
 	return status;
 }
 
@@ -265,27 +301,38 @@ static BOOL FileWrite(PVOID Object, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrit
 	size_t io_status = 0;
 	WINPR_FILE* file = NULL;
 
-	if (lpOverlapped)
-	{
-		WLog_ERR(TAG, "WinPR does not support the lpOverlapped parameter");
-		SetLastError(ERROR_NOT_SUPPORTED);
-		return FALSE;
-	}
-
 	if (!Object)
 		return FALSE;
 
 	file = (WINPR_FILE*)Object;
 
+	if (lpOverlapped)
+	{
+		if (file->dwFlagsAndAttributes & FILE_FLAG_OVERLAPPED)
+		{
+			if (lpNumberOfBytesWritten)
+				*lpNumberOfBytesWritten = 0;
+			return winpr_file_overlapped_io(file, TRUE, WINPR_CAST_CONST_PTR_AWAY(lpBuffer, void*),
+			                                nNumberOfBytesToWrite, lpOverlapped);
+		}
+		if (!FileSeekOverlapped(file, lpOverlapped))
+			return FALSE;
+	}
+
 	clearerr(file->fp);
 	io_status = fwrite(lpBuffer, 1, nNumberOfBytesToWrite, file->fp);
 	if (io_status == 0 && ferror(file->fp))
 	{
 		SetLastError(map_posix_err(errno));
+		if (lpOverlapped)
+			FileCompleteOverlapped(lpOverlapped, FALSE, 0);
 		return FALSE;
 	}
 
-	*lpNumberOfBytesWritten = (DWORD)io_status;
+	if (lpNumberOfBytesWritten)
+		*lpNumberOfBytesWritten = (DWORD)io_status;
+	if (lpOverlapped)
+		FileCompleteOverlapped(lpOverlapped, TRUE, io_status);
 	return TRUE;
 }
 
@@ -848,13 +895,6 @@ static HANDLE FileCreateFileA(LPCSTR lpFileName, DWORD dwDesiredAccess, DWORD dw
 	FILE* fp = NULL;
 	struct stat st;
 
-	if (dwFlagsAndAttributes & FILE_FLAG_OVERLAPPED)
-	{
-		WLog_ERR(TAG, "WinPR does not support the FILE_FLAG_OVERLAPPED flag");
-		SetLastError(ERROR_NOT_SUPPORTED);
-		return INVALID_HANDLE_VALUE;
-	}
-
 	pFile = (WINPR_FILE*)calloc(1, sizeof(WINPR_FILE));
 	if (!pFile)
 	{
@@ -54,6 +54,7 @@ struct winpr_file
 	HANDLE hTemplateFile;
 
 	BOOL bLocked;
+	LONG pendingIo;
 };
 typedef struct winpr_file WINPR_FILE;
 
@@ -0,0 +1,566 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * File Functions, overlapped I/O
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/pool.h>
+#include <winpr/collections.h>
+#include <winpr/environment.h>
+#include <winpr/interlocked.h>
+#include <winpr/string.h>
+#include <winpr/wlog.h>
+
+#include "overlapped.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "../log.h"
+#define TAG WINPR_TAG("file.overlapped")
+
+#ifndef MAX
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#endif
+
+#if defined(WINPR_HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define WINPR_IO_URING_ENTRIES 128
+#define WINPR_IO_URING_STOP_TIMEOUT 5000
+#endif
+
+typedef struct
+{
+	WINPR_FILE* file;
+	LPOVERLAPPED overlapped;
+	BOOL write;
+	int fd;
+	UINT64 offset;
+	struct iovec iov;
+} WINPR_FILE_IO_REQUEST;
+
+#if defined(WINPR_HAVE_LINUX_IO_URING_H)
+typedef struct
+{
+	int fd;
+	unsigned entries;
+	LONG inflight;
+	LONG stop; /* set by io_uring_free, the thread exits once inflight dropped to 0 */
+
+	unsigned* sq_head;
+	unsigned* sq_tail;
+	unsigned sq_mask;
+	unsigned* sq_array;
+	struct io_uring_sqe* sqes;
+
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe* cqes;
+
+	void* sq_ring;
+	size_t sq_ring_size;
+	void* cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+
+	CRITICAL_SECTION lock;
+	HANDLE thread;
+} WINPR_IO_URING;
+#endif
+
+typedef struct
+{
+	PTP_WORK work;
+	wQueue* queue;
+#if defined(WINPR_HAVE_LINUX_IO_URING_H)
+	WINPR_IO_URING* ring;
+#endif
+} WINPR_FILE_IO;
+
+static WINPR_FILE_IO g_file_io = { 0 };
+static INIT_ONCE g_file_io_once = INIT_ONCE_STATIC_INIT;
+
+static NTSTATUS file_io_errno_to_status(int err)
+{
+	switch (err)
+	{
+		case EACCES:
+		case EPERM:
+		case EROFS:
+			return STATUS_ACCESS_DENIED;
+		case ENOSPC:
+#if defined(EDQUOT)
+		case EDQUOT:
+#endif
+			return STATUS_DISK_FULL;
+		case EBADF:
+			return STATUS_INVALID_HANDLE;
+		case EINVAL:
+		case EFAULT:
+			return STATUS_INVALID_PARAMETER;
+		case ENOMEM:
+			return STATUS_NO_MEMORY;
+		case ECANCELED:
+			return STATUS_CANCELLED;
+		default:
+			return STATUS_UNSUCCESSFUL;
+	}
+}
+
+/* res is the number of bytes transferred or a negative errno */
+static void file_io_complete(WINPR_FILE_IO_REQUEST* request, INT64 res)
+{
+	WINPR_ASSERT(request);
+
+	LPOVERLAPPED overlapped = request->overlapped;
+	WINPR_FILE* file = request->file;
+	HANDLE event = overlapped->hEvent;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (res < 0)
+	{
+		status = file_io_errno_to_status((int)-res);
+		res = 0;
+	}
+	else if ((res == 0) && !request->write && (request->iov.iov_len > 0))
+		status = STATUS_END_OF_FILE;
+
+	free(request);
+
+	/* The caller may close the event and reuse the OVERLAPPED as soon as the status is no
+	 * longer pending, so the event is signaled first. A waiter woken early sees the status
+	 * still pending and waits again. The file is valid until pendingIo dropped. */
+	if (event)
+		(void)SetEvent(event);
+	overlapped->InternalHigh = (ULONG_PTR)res;
+	winpr_overlapped_set_status(overlapped, status);
+	(void)InterlockedDecrement(&file->pendingIo);
+}
+
+static INT64 file_io_execute(const WINPR_FILE_IO_REQUEST* request)
+{
+	ssize_t rc = 0;
+
+	do
+	{
+		if (request->write)
+			rc = pwrite(request->fd, request->iov.iov_base, request->iov.iov_len,
+			            (off_t)request->offset);
+		else
+			rc = pread(request->fd, request->iov.iov_base, request->iov.iov_len,
+			           (off_t)request->offset);
+	} while ((rc < 0) && (errno == EINTR));
+
+	if (rc < 0)
+		return -errno;
+	return rc;
+}
+
+static VOID CALLBACK file_io_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
+                                           WINPR_ATTR_UNUSED PVOID context,
+                                           WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	/* Every submission of the work item serves one queued request */
+	WINPR_FILE_IO_REQUEST* request = Queue_Dequeue(g_file_io.queue);
+	if (!request)
+		return;
+
+	file_io_complete(request, file_io_execute(request));
+}
+
+static BOOL file_io_submit_threadpool(WINPR_FILE_IO_REQUEST* request)
+{
+	if (!g_file_io.work || !g_file_io.queue)
+		return FALSE;
+
+	if (!Queue_Enqueue(g_file_io.queue, request))
+		return FALSE;
+
+	SubmitThreadpoolWork(g_file_io.work);
+	return TRUE;
+}
+
+#if defined(WINPR_HAVE_LINUX_IO_URING_H)
+static int io_uring_setup_syscall(unsigned entries, struct io_uring_params* params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter_syscall(int fd, unsigned to_submit, unsigned min_complete,
+                                  unsigned flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static DWORD WINAPI io_uring_completion_thread(LPVOID arg)
+{
+	WINPR_IO_URING* ring = arg;
+	WINPR_ASSERT(ring);
+
+	while (!InterlockedCompareExchange(&ring->stop, 0, 0) ||
+	       (InterlockedCompareExchange(&ring->inflight, 0, 0) > 0))
+	{
+		unsigned head = *ring->cq_head;
+		const unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+		if (head == tail)
+		{
+			const int rc = io_uring_enter_syscall(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+			if ((rc < 0) && (errno != EINTR))
+			{
+				char ebuffer[256] = { 0 };
+				WLog_ERR(TAG, "io_uring_enter failed with %s [%d]",
+				         winpr_strerror(errno, ebuffer, sizeof(ebuffer)), errno);
+				Sleep(10);
+			}
+			continue;
+		}
+
+		for (; head != tail; head++)
+		{
+			const struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+			WINPR_FILE_IO_REQUEST* request = (WINPR_FILE_IO_REQUEST*)(uintptr_t)cqe->user_data;
+			const INT64 res = cqe->res;
+
+			__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+			/* The NOP of io_uring_free only wakes the thread up */
+			if (!request)
+				continue;
+
+			(void)InterlockedDecrement(&ring->inflight);
+			file_io_complete(request, res);
+		}
+	}
+
+	return 0;
+}
+
+/* Queue sqe and hand it to the kernel, the caller accounts for the completion */
+static BOOL io_uring_push(WINPR_IO_URING* ring, const struct io_uring_sqe* sqe)
+{
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(ring);
+	WINPR_ASSERT(sqe);
+
+	EnterCriticalSection(&ring->lock);
+
+	const unsigned tail = *ring->sq_tail;
+	const unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (tail - head >= ring->entries)
+		goto out;
+
+	const unsigned index = tail & ring->sq_mask;
+	ring->sqes[index] = *sqe;
+	ring->sq_array[index] = index;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	for (;;)
+	{
+		const unsigned consumed = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+		if (consumed == tail + 1)
+		{
+			rc = TRUE;
+			break;
+		}
+
+		const int status = io_uring_enter_syscall(ring->fd, tail + 1 - consumed, 0, 0);
+		if ((status < 0) && (errno != EINTR))
+		{
+			/* Without SQPOLL the kernel only consumes entries in io_uring_enter, so an entry
+			 * it did not take can be withdrawn and handed to the fallback. */
+			if (__atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == tail)
+				__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+			else
+				rc = TRUE;
+			break;
+		}
+	}
+
+out:
+	LeaveCriticalSection(&ring->lock);
+	return rc;
+}
+
+static void io_uring_free(WINPR_IO_URING* ring)
+{
+	if (!ring)
+		return;
+
+	if (ring->thread)
+	{
+		/* Wake the completion thread up, it finishes the requests still in flight */
+		struct io_uring_sqe sqe = { 0 };
+		sqe.opcode = IORING_OP_NOP;
+
+		(void)InterlockedExchange(&ring->stop, TRUE);
+		if (!io_uring_push(ring, &sqe) ||
+		    (WaitForSingleObject(ring->thread, WINPR_IO_URING_STOP_TIMEOUT) != WAIT_OBJECT_0))
+		{
+			/* The thread still uses the ring, e.g. a read of a pipe that never completes */
+			WLog_WARN(TAG, "the io_uring completion thread did not stop, keeping the ring");
+			return;
+		}
+		(void)CloseHandle(ring->thread);
+	}
+
+	if (ring->sqes && (ring->sqes != MAP_FAILED))
+		(void)munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring && (ring->cq_ring != MAP_FAILED) && (ring->cq_ring != ring->sq_ring))
+		(void)munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring && (ring->sq_ring != MAP_FAILED))
+		(void)munmap(ring->sq_ring, ring->sq_ring_size);
+	if (ring->fd >= 0)
+		(void)close(ring->fd);
+	DeleteCriticalSection(&ring->lock);
+	free(ring);
+}
+
+static WINPR_IO_URING* io_uring_new(void)
+{
+	struct io_uring_params params = { 0 };
+	WINPR_IO_URING* ring = calloc(1, sizeof(WINPR_IO_URING));
+	if (!ring)
+		return NULL;
+
+	ring->fd = -1;
+	if (!InitializeCriticalSectionAndSpinCount(&ring->lock, 4000))
+	{
+		free(ring);
+		return NULL;
+	}
+
+	ring->fd = io_uring_setup_syscall(WINPR_IO_URING_ENTRIES, &params);
+	if (ring->fd < 0)
+	{
+		char ebuffer[256] = { 0 };
+		WLog_DBG(TAG, "io_uring not available: %s [%d]",
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)), errno);
+		goto fail;
+	}
+
+	ring->entries = params.sq_entries;
+	ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		ring->sq_ring_size = MAX(ring->sq_ring_size, ring->cq_ring_size);
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+	                     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto fail;
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cq_ring = ring->sq_ring;
+	else
+	{
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+		                     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED)
+			goto fail;
+	}
+
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                  ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto fail;
+
+	BYTE* sq = ring->sq_ring;
+	BYTE* cq = ring->cq_ring;
+	ring->sq_head = (unsigned*)&sq[params.sq_off.head];
+	ring->sq_tail = (unsigned*)&sq[params.sq_off.tail];
+	ring->sq_mask = *(unsigned*)&sq[params.sq_off.ring_mask];
+	ring->sq_array = (unsigned*)&sq[params.sq_off.array];
+	ring->cq_head = (unsigned*)&cq[params.cq_off.head];
+	ring->cq_tail = (unsigned*)&cq[params.cq_off.tail];
+	ring->cq_mask = *(unsigned*)&cq[params.cq_off.ring_mask];
+	ring->cqes = (struct io_uring_cqe*)&cq[params.cq_off.cqes];
+
+	ring->thread = CreateThread(NULL, 0, io_uring_completion_thread, ring, 0, NULL);
+	if (!ring->thread)
+		goto fail;
+
+	return ring;
+
+fail:
+	io_uring_free(ring);
+	return NULL;
+}
+
+static BOOL file_io_submit_io_uring(WINPR_IO_URING* ring, WINPR_FILE_IO_REQUEST* request)
+{
+	struct io_uring_sqe sqe = { 0 };
+
+	WINPR_ASSERT(request);
+
+	if (!ring)
+		return FALSE;
+
+	/* Never have more requests in flight than the completion queue can hold */
+	if ((InterlockedIncrement(&ring->inflight) > (LONG)ring->entries) ||
+	    InterlockedCompareExchange(&ring->stop, 0, 0))
+	{
+		(void)InterlockedDecrement(&ring->inflight);
+		return FALSE;
+	}
+
+	sqe.opcode = request->write ? IORING_OP_WRITEV : IORING_OP_READV;
+	sqe.fd = request->fd;
+	sqe.off = request->offset;
+	sqe.addr = (UINT64)(uintptr_t)&request->iov;
+	sqe.len = 1;
+	sqe.user_data = (UINT64)(uintptr_t)request;
+
+	if (!io_uring_push(ring, &sqe))
+	{
+		(void)InterlockedDecrement(&ring->inflight);
+		return FALSE;
+	}
+	return TRUE;
+}
+#endif
+
+/* The thread pool work is left to the pool, its callbacks may still run at exit */
+static void file_io_uninit(void)
+{
+#if defined(WINPR_HAVE_LINUX_IO_URING_H)
+	/* Later requests use the thread pool */
+	WINPR_IO_URING* ring = g_file_io.ring;
+	g_file_io.ring = NULL;
+	io_uring_free(ring);
+#endif
+}
+
+static BOOL CALLBACK file_io_init(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                  WINPR_ATTR_UNUSED PVOID param,
+                                  WINPR_ATTR_UNUSED PVOID* context)
+{
+	BOOL useIoUring = TRUE;
+	char backend[32] = { 0 };
+
+	/* WINPR_FILE_IO_BACKEND=threadpool disables io_uring */
+	const DWORD len = GetEnvironmentVariableA("WINPR_FILE_IO_BACKEND", backend, sizeof(backend));
+	if ((len > 0) && (len < sizeof(backend)) && (_stricmp(backend, "threadpool") == 0))
+		useIoUring = FALSE;
+
+#if defined(WINPR_HAVE_LINUX_IO_URING_H)
+	if (useIoUring)
+		g_file_io.ring = io_uring_new();
+	WLog_DBG(TAG, "using %s for overlapped file I/O", g_file_io.ring ? "io_uring" : "threadpool");
+#else
+	WINPR_UNUSED(useIoUring);
+#endif
+
+	/* The thread pool is also used if io_uring is saturated */
+	g_file_io.queue = Queue_New(TRUE, -1, -1);
+	g_file_io.work = CreateThreadpoolWork(file_io_work_callback, NULL, NULL);
+	if (!g_file_io.queue || !g_file_io.work)
+	{
+		WLog_ERR(TAG, "failed to initialize the overlapped I/O thread pool");
+		Queue_Free(g_file_io.queue);
+		g_file_io.queue = NULL;
+		if (g_file_io.work)
+			CloseThreadpoolWork(g_file_io.work);
+		g_file_io.work = NULL;
+	}
+
+	(void)atexit(file_io_uninit);
+	return TRUE;
+}
+
+BOOL winpr_file_overlapped_io(WINPR_FILE* file, BOOL write, void* buffer, DWORD length,
+                              LPOVERLAPPED lpOverlapped)
+{
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(file->fp);
+	WINPR_ASSERT(lpOverlapped);
+
+	if (!InitOnceExecuteOnce(&g_file_io_once, file_io_init, NULL, NULL))
+	{
+		SetLastError(ERROR_INTERNAL_ERROR);
+		return FALSE;
+	}
+
+	WINPR_FILE_IO_REQUEST* request = calloc(1, sizeof(WINPR_FILE_IO_REQUEST));
+	if (!request)
+	{
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+
+	request->file = file;
+	request->overlapped = lpOverlapped;
+	request->write = write;
+	request->fd = fileno(file->fp);
+	request->offset =
+	    ((UINT64)lpOverlapped->DUMMYUNIONNAME.DUMMYSTRUCTNAME.OffsetHigh << 32) |
+	    lpOverlapped->DUMMYUNIONNAME.DUMMYSTRUCTNAME.Offset;
+	request->iov.iov_base = buffer;
+	request->iov.iov_len = length;
+
+	lpOverlapped->InternalHigh = 0;
+	winpr_overlapped_set_status(lpOverlapped, STATUS_PENDING);
+	if (lpOverlapped->hEvent)
+		(void)ResetEvent(lpOverlapped->hEvent);
+
+	(void)InterlockedIncrement(&file->pendingIo);
+
+#if defined(WINPR_HAVE_LINUX_IO_URING_H)
+	if (file_io_submit_io_uring(g_file_io.ring, request))
+	{
+		SetLastError(ERROR_IO_PENDING);
+		return FALSE;
+	}
+#endif
+
+	if (file_io_submit_threadpool(request))
+	{
+		SetLastError(ERROR_IO_PENDING);
+		return FALSE;
+	}
+
+	(void)InterlockedDecrement(&file->pendingIo);
+	free(request);
+	winpr_overlapped_set_status(lpOverlapped, STATUS_UNSUCCESSFUL);
+	SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+	return FALSE;
+}
+
+void winpr_file_overlapped_drain(WINPR_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	while (InterlockedCompareExchange(&file->pendingIo, 0, 0) > 0)
+		Sleep(1);
+}
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * File Functions, overlapped I/O
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WINPR_FILE_OVERLAPPED_PRIV_H
+#define WINPR_FILE_OVERLAPPED_PRIV_H
+
+#include <winpr/wtypes.h>
+#include <winpr/io.h>
+#include <winpr/nt.h>
+
+#ifndef _WIN32
+
+#include "file.h"
+
+/** @brief Start an overlapped read or write of \b file at the offset of \b lpOverlapped.
+ *
+ *  The request is queued to io_uring if available, to the thread pool otherwise.
+ *  On completion lpOverlapped->InternalHigh holds the number of bytes transferred,
+ *  lpOverlapped->Internal the NTSTATUS of the operation and lpOverlapped->hEvent is signaled.
+ *
+ *  @return \b FALSE with ERROR_IO_PENDING if the request was queued, \b FALSE with another
+ *  error if it could not be started.
+ */
+BOOL winpr_file_overlapped_io(WINPR_FILE* file, BOOL write, void* buffer, DWORD length,
+                              LPOVERLAPPED lpOverlapped);
+
+/** @brief Wait until all overlapped requests of \b file completed. */
+void winpr_file_overlapped_drain(WINPR_FILE* file);
+
+static INLINE NTSTATUS winpr_overlapped_get_status(const OVERLAPPED* lpOverlapped)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (NTSTATUS)__atomic_load_n(&lpOverlapped->Internal, __ATOMIC_ACQUIRE);
+#else
+	return (NTSTATUS)(*(volatile const ULONG_PTR*)&lpOverlapped->Internal);
+#endif
+}
+
+static INLINE void winpr_overlapped_set_status(OVERLAPPED* lpOverlapped, NTSTATUS status)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__atomic_store_n(&lpOverlapped->Internal, (ULONG_PTR)status, __ATOMIC_RELEASE);
+#else
+	*(volatile ULONG_PTR*)&lpOverlapped->Internal = (ULONG_PTR)status;
+#endif
+}
+
+#endif /* _WIN32 */
+
+#endif /* WINPR_FILE_OVERLAPPED_PRIV_H */
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <winpr/crt.h>
+#include <winpr/io.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/synch.h>
+#include <winpr/handle.h>
+#include <winpr/windows.h>
+#include <winpr/sysinfo.h>
+
+#define TEST_REQUESTS 32
+#define TEST_BLOCK_SIZE 4096
+
+static void fill_block(BYTE* block, size_t index)
+{
+	for (size_t x = 0; x < TEST_BLOCK_SIZE; x++)
+		block[x] = (BYTE)((index * 31 + x) & 0xFF);
+}
+
+static void set_offset(OVERLAPPED* overlapped, UINT64 offset)
+{
+	overlapped->DUMMYUNIONNAME.DUMMYSTRUCTNAME.Offset = (DWORD)(offset & 0xFFFFFFFF);
+	overlapped->DUMMYUNIONNAME.DUMMYSTRUCTNAME.OffsetHigh = (DWORD)(offset >> 32);
+}
+
+static char* create_name(const char* prefix)
+{
+	char sname[8192] = { 0 };
+	SYSTEMTIME systemTime = { 0 };
+
+	GetSystemTime(&systemTime);
+	(void)sprintf_s(sname, sizeof(sname),
+	                "%s-%04" PRIu16 "%02" PRIu16 "%02" PRIu16 "%02" PRIu16 "%02" PRIu16
+	                "%02" PRIu16 "%04" PRIu16 "-%" PRIu32,
+	                prefix, systemTime.wYear, systemTime.wMonth, systemTime.wDay,
+	                systemTime.wHour, systemTime.wMinute, systemTime.wSecond,
+	                systemTime.wMilliseconds, GetCurrentProcessId());
+	return GetKnownSubPath(KNOWN_PATH_TEMP, sname);
+}
+
+static BOOL test_overlapped_requests(HANDLE handle)
+{
+	BOOL rc = FALSE;
+	OVERLAPPED overlapped[TEST_REQUESTS] = { 0 };
+	BYTE* blocks = calloc(TEST_REQUESTS, TEST_BLOCK_SIZE);
+	BYTE* cmp = calloc(TEST_REQUESTS, TEST_BLOCK_SIZE);
+	BYTE expect[TEST_BLOCK_SIZE] = { 0 };
+
+	if (!blocks || !cmp)
+		goto fail;
+
+	for (size_t x = 0; x < TEST_REQUESTS; x++)
+	{
+		overlapped[x].hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+		if (!overlapped[x].hEvent)
+			goto fail;
+	}
+
+	/* issue all writes at once, in reverse order to create holes while in flight */
+	for (size_t x = 0; x < TEST_REQUESTS; x++)
+	{
+		const size_t index = TEST_REQUESTS - x - 1;
+		BYTE* block = &blocks[index * TEST_BLOCK_SIZE];
+
+		fill_block(block, index);
+		set_offset(&overlapped[index], 1ull * index * TEST_BLOCK_SIZE);
+		if (WriteFile(handle, block, TEST_BLOCK_SIZE, NULL, &overlapped[index]))
+			continue;
+		if (GetLastError() != ERROR_IO_PENDING)
+		{
+			(void)fprintf(stderr, "WriteFile [%" PRIuz "] failed with %" PRIu32 "\n", index,
+			              GetLastError());
+			goto fail;
+		}
+	}
+
+	for (size_t x = 0; x < TEST_REQUESTS; x++)
+	{
+		DWORD transferred = 0;
+		if (!GetOverlappedResult(handle, &overlapped[x], &transferred, TRUE))
+			goto fail;
+		if (transferred != TEST_BLOCK_SIZE)
+			goto fail;
+	}
+
+	for (size_t x = 0; x < TEST_REQUESTS; x++)
+	{
+		(void)ResetEvent(overlapped[x].hEvent);
+		set_offset(&overlapped[x], 1ull * x * TEST_BLOCK_SIZE);
+		if (ReadFile(handle, &cmp[x * TEST_BLOCK_SIZE], TEST_BLOCK_SIZE, NULL, &overlapped[x]))
+			continue;
+		if (GetLastError() != ERROR_IO_PENDING)
+		{
+			(void)fprintf(stderr, "ReadFile [%" PRIuz "] failed with %" PRIu32 "\n", x,
+			              GetLastError());
+			goto fail;
+		}
+	}
+
+	for (size_t x = 0; x < TEST_REQUESTS; x++)
+	{
+		DWORD transferred = 0;
+		if (!GetOverlappedResult(handle, &overlapped[x], &transferred, TRUE))
+			goto fail;
+		if (transferred != TEST_BLOCK_SIZE)
+			goto fail;
+
+		fill_block(expect, x);
+		if (memcmp(&cmp[x * TEST_BLOCK_SIZE], expect, TEST_BLOCK_SIZE) != 0)
+		{
+			(void)fprintf(stderr, "block [%" PRIuz "] does not match\n", x);
+			goto fail;
+		}
+	}
+
+	/* reading at the end of the file must report ERROR_HANDLE_EOF */
+	{
+		DWORD transferred = 0;
+
+		(void)ResetEvent(overlapped[0].hEvent);
+		set_offset(&overlapped[0], 1ull * TEST_REQUESTS * TEST_BLOCK_SIZE);
+		if (!ReadFile(handle, cmp, TEST_BLOCK_SIZE, NULL, &overlapped[0]))
+		{
+			if ((GetLastError() != ERROR_IO_PENDING) && (GetLastError() != ERROR_HANDLE_EOF))
+				goto fail;
+		}
+		if (GetOverlappedResult(handle, &overlapped[0], &transferred, TRUE))
+			goto fail;
+		if ((GetLastError() != ERROR_HANDLE_EOF) || (transferred != 0))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < TEST_REQUESTS; x++)
+	{
+		if (overlapped[x].hEvent)
+			(void)CloseHandle(overlapped[x].hEvent);
+	}
+	free(blocks);
+	free(cmp);
+	return rc;
+}
+
+static BOOL test_overlapped_close_pending(const char* name)
+{
+	BOOL rc = FALSE;
+	OVERLAPPED overlapped = { 0 };
+	BYTE block[TEST_BLOCK_SIZE] = { 0 };
+	HANDLE handle = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING,
+	                            FILE_FLAG_OVERLAPPED, NULL);
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (!overlapped.hEvent)
+		goto fail;
+
+	/* closing the handle must wait for the request in flight */
+	if (!ReadFile(handle, block, sizeof(block), NULL, &overlapped) &&
+	    (GetLastError() != ERROR_IO_PENDING))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	(void)CloseHandle(handle);
+	if (overlapped.hEvent)
+	{
+		if (rc && (WaitForSingleObject(overlapped.hEvent, 0) != WAIT_OBJECT_0))
+			rc = FALSE;
+		(void)CloseHandle(overlapped.hEvent);
+	}
+	return rc;
+}
+
+/* the event may be closed as soon as polling saw the request complete */
+static BOOL test_overlapped_poll_close(HANDLE handle)
+{
+	BYTE block[TEST_BLOCK_SIZE] = { 0 };
+
+	for (size_t x = 0; x < TEST_REQUESTS; x++)
+	{
+		DWORD transferred = 0;
+		OVERLAPPED overlapped = { 0 };
+
+		overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+		if (!overlapped.hEvent)
+			return FALSE;
+
+		set_offset(&overlapped, 1ull * x * TEST_BLOCK_SIZE);
+		if (!ReadFile(handle, block, sizeof(block), NULL, &overlapped) &&
+		    (GetLastError() != ERROR_IO_PENDING))
+		{
+			(void)CloseHandle(overlapped.hEvent);
+			return FALSE;
+		}
+
+		BOOL done = FALSE;
+		while (!(done = GetOverlappedResult(handle, &overlapped, &transferred, FALSE)) &&
+		       (GetLastError() == ERROR_IO_INCOMPLETE))
+			;
+
+		(void)CloseHandle(overlapped.hEvent);
+		if (!done || (transferred != TEST_BLOCK_SIZE))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_synchronous_offset(const char* name)
+{
+	BOOL rc = FALSE;
+	DWORD transferred = 0;
+	OVERLAPPED overlapped = { 0 };
+	BYTE expect[TEST_BLOCK_SIZE] = { 0 };
+	BYTE block[TEST_BLOCK_SIZE] = { 0 };
+	HANDLE handle =
+	    CreateFileA(name, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	/* without FILE_FLAG_OVERLAPPED the offset is honored but the call completes immediately */
+	set_offset(&overlapped, 3ull * TEST_BLOCK_SIZE);
+	if (!ReadFile(handle, block, sizeof(block), &transferred, &overlapped))
+		goto fail;
+	if ((transferred != sizeof(block)) || (overlapped.InternalHigh != sizeof(block)))
+		goto fail;
+
+	fill_block(expect, 3);
+	if (memcmp(block, expect, sizeof(block)) != 0)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	(void)CloseHandle(handle);
+	return rc;
+}
+
+int TestFileOverlapped(int argc, char* argv[])
+{
+	int rc = -1;
+	HANDLE handle = INVALID_HANDLE_VALUE;
+	char* name = create_name("FileOverlapped");
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!name)
+		return -1;
+
+	handle = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_NEW,
+	                     FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		(void)fprintf(stderr, "CreateFileA(%s) failed with %" PRIu32 "\n", name, GetLastError());
+		goto fail;
+	}
+
+	if (!test_overlapped_requests(handle))
+		goto fail;
+
+	if (!test_overlapped_poll_close(handle))
+		goto fail;
+
+	(void)CloseHandle(handle);
+	handle = INVALID_HANDLE_VALUE;
+
+	if (!test_overlapped_close_pending(name))
+		goto fail;
+
+	if (!test_synchronous_offset(name))
+		goto fail;
+
+	rc = 0;
+fail:
+	if (handle != INVALID_HANDLE_VALUE)
+		(void)CloseHandle(handle);
+	(void)DeleteFileA(name);
+	free(name);
+	return rc;
+}
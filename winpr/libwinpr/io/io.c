@@ -44,29 +44,92 @@
 
 #include "../handle/handle.h"
 #include "../pipe/pipe.h"
+#include "../file/overlapped.h"
 #include "../log.h"
 
 #define TAG WINPR_TAG("io")
 
-BOOL GetOverlappedResult(WINPR_ATTR_UNUSED HANDLE hFile,
-                         WINPR_ATTR_UNUSED LPOVERLAPPED lpOverlapped,
-                         WINPR_ATTR_UNUSED LPDWORD lpNumberOfBytesTransferred,
-                         WINPR_ATTR_UNUSED BOOL bWait)
+static DWORD overlapped_status_to_error(NTSTATUS status)
 {
-	WLog_ERR(TAG, "Not implemented");
-	SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
-	return FALSE;
+	switch (status)
+	{
+		case STATUS_END_OF_FILE:
+			return ERROR_HANDLE_EOF;
+		case STATUS_ACCESS_DENIED:
+			return ERROR_ACCESS_DENIED;
+		case STATUS_DISK_FULL:
+			return ERROR_DISK_FULL;
+		case STATUS_INVALID_HANDLE:
+			return ERROR_INVALID_HANDLE;
+		case STATUS_INVALID_PARAMETER:
+			return ERROR_INVALID_PARAMETER;
+		case STATUS_NO_MEMORY:
+			return ERROR_NOT_ENOUGH_MEMORY;
+		case STATUS_CANCELLED:
+			return ERROR_OPERATION_ABORTED;
+		default:
+			return ERROR_GEN_FAILURE;
+	}
 }
 
-BOOL GetOverlappedResultEx(WINPR_ATTR_UNUSED HANDLE hFile,
-                           WINPR_ATTR_UNUSED LPOVERLAPPED lpOverlapped,
-                           WINPR_ATTR_UNUSED LPDWORD lpNumberOfBytesTransferred,
-                           WINPR_ATTR_UNUSED DWORD dwMilliseconds,
-                           WINPR_ATTR_UNUSED BOOL bAlertable)
+BOOL GetOverlappedResult(HANDLE hFile, LPOVERLAPPED lpOverlapped,
+                         LPDWORD lpNumberOfBytesTransferred, BOOL bWait)
 {
-	WLog_ERR(TAG, "Not implemented");
-	SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
-	return FALSE;
+	return GetOverlappedResultEx(hFile, lpOverlapped, lpNumberOfBytesTransferred,
+	                             bWait ? INFINITE : 0, FALSE);
+}
+
+BOOL GetOverlappedResultEx(WINPR_ATTR_UNUSED HANDLE hFile, LPOVERLAPPED lpOverlapped,
+                           LPDWORD lpNumberOfBytesTransferred, DWORD dwMilliseconds,
+                           BOOL bAlertable)
+{
+	if (!lpOverlapped || !lpNumberOfBytesTransferred)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	NTSTATUS status = winpr_overlapped_get_status(lpOverlapped);
+	while (status == STATUS_PENDING)
+	{
+		if (dwMilliseconds == 0)
+		{
+			SetLastError(ERROR_IO_INCOMPLETE);
+			return FALSE;
+		}
+
+		/* Waiting on the file handle itself is not supported */
+		if (!lpOverlapped->hEvent)
+		{
+			SetLastError(ERROR_INVALID_PARAMETER);
+			return FALSE;
+		}
+
+		const DWORD rc = WaitForSingleObjectEx(lpOverlapped->hEvent, dwMilliseconds, bAlertable);
+		switch (rc)
+		{
+			case WAIT_OBJECT_0:
+				break;
+			case WAIT_TIMEOUT:
+			case WAIT_IO_COMPLETION:
+				SetLastError(rc);
+				return FALSE;
+			default:
+				return FALSE;
+		}
+
+		/* The event might be shared with other requests */
+		status = winpr_overlapped_get_status(lpOverlapped);
+	}
+
+	*lpNumberOfBytesTransferred = (DWORD)lpOverlapped->InternalHigh;
+	/* Success and informational codes are not negative */
+	if (status < 0)
+	{
+		SetLastError(overlapped_status_to_error(status));
+		return FALSE;
+	}
+	return TRUE;
 }
 
 BOOL DeviceIoControl(WINPR_ATTR_UNUSED HANDLE hDevice, WINPR_ATTR_UNUSED DWORD dwIoControlCode,
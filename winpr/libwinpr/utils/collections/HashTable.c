@@ -24,36 +24,80 @@
 
 #include <winpr/collections.h>
 
+#include <winpr/endian.h>
+#include <winpr/interlocked.h>
+
 /**
- * This implementation is based on the public domain
- * hash table implementation made by Keith Pomakis:
+ * Open addressing hash table.
+ *
+ * The key/value pairs are stored densely in insertion order, the index maps a
+ * hash to an entry. Every slot of the index has a control byte which is either
+ * EMPTY, DELETED or holds the lower 7 bits of the hash of the entry. Lookups
+ * probe groups of 8 control bytes at once and only compare keys of slots whose
+ * control byte matches.
  *
- * http://www.pomakis.com/hashtable/hashtable.c
- * http://www.pomakis.com/hashtable/hashtable.h
+ * Tables set up with HashTable_SetReadMostly do lookups without taking the lock:
+ * writers increment a sequence counter before and after each modification,
+ * readers retry (or fall back to the lock) if the counter changed while they
+ * were reading. Index blocks replaced by a resize are kept until the table is
+ * freed, so a reader never accesses released memory of the table itself.
+ * All fields such a reader looks at are accessed with relaxed atomic loads and
+ * stores, the fences around the sequence counter order them.
  */
 
-typedef struct s_wKeyValuePair wKeyValuePair;
+#define HASHTABLE_GROUP_WIDTH 8
+#define HASHTABLE_MIN_CAPACITY 16
+#define HASHTABLE_OPTIMISTIC_RETRIES 4
+
+#define HASHTABLE_CTRL_EMPTY 0x80
+#define HASHTABLE_CTRL_DELETED 0xFE
+
+#define HASHTABLE_LSB 0x0101010101010101ULL
+#define HASHTABLE_MSB 0x8080808080808080ULL
+
+#if defined(__GNUC__) || defined(__clang__)
+typedef UINT64 __attribute__((may_alias)) wHashTableGroup;
+#define HASHTABLE_LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define HASHTABLE_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#else
+#define HASHTABLE_LOAD(x) (x)
+#define HASHTABLE_STORE(x, v) ((x) = (v))
+#endif
 
-struct s_wKeyValuePair
+typedef struct
 {
 	void* key;
 	void* value;
 
-	wKeyValuePair* next;
+	UINT32 hash;
 	BOOL markedForRemove;
+} wKeyValuePair;
+
+typedef struct s_wHashTableIndex wHashTableIndex;
+
+struct s_wHashTableIndex
+{
+	size_t capacity;
+	size_t maxEntries;
+	BYTE* ctrl;
+	UINT32* slots;
+	wKeyValuePair* entries;
+
+	wHashTableIndex* retired;
 };
 
 struct s_wHashTable
 {
 	BOOL synchronized;
+	BOOL readMostly;
 	CRITICAL_SECTION lock;
+	volatile LONG sequence;
 
-	size_t numOfBuckets;
+	wHashTableIndex* volatile index;
+	wHashTableIndex* retired;
+	size_t numOfEntries;
+	size_t numOfUsedSlots;
 	size_t numOfElements;
-	float idealRatio;
-	float lowerRehashThreshold;
-	float upperRehashThreshold;
-	wKeyValuePair** bucketArray;
 
 	HASH_TABLE_HASH_FN hash;
 	wObject key;
@@ -70,7 +114,8 @@ BOOL HashTable_PointerCompare(const void* pointer1, const void* pointer2)
 
 UINT32 HashTable_PointerHash(const void* pointer)
 {
-	return ((UINT32)(UINT_PTR)pointer) >> 4;
+	const UINT64 value = (UINT64)(UINT_PTR)pointer;
+	return (UINT32)(value ^ (value >> 32));
 }
 
 BOOL HashTable_StringCompare(const void* string1, const void* string2)
@@ -104,105 +149,410 @@ void HashTable_StringFree(void* str)
 	winpr_ObjectStringFree(str);
 }
 
-static INLINE BOOL HashTable_IsProbablePrime(size_t oddNumber)
+static INLINE UINT32 HashTable_Hash(wHashTable* table, const void* key)
 {
-	for (size_t i = 3; i < 51; i += 2)
+	/* murmur3 finalizer, the probing uses all bits of the hash */
+	UINT32 hash = table->hash(key);
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+static INLINE BYTE HashTable_HashTag(UINT32 hash)
+{
+	return (BYTE)(hash & 0x7F);
+}
+
+/* Groups are 8 byte aligned, HashTable_FirstMatch takes care of the byte order */
+static INLINE UINT64 HashTable_LoadGroup(const wHashTableIndex* index, size_t group)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	const BYTE* ctrl = &index->ctrl[group * HASHTABLE_GROUP_WIDTH];
+	return __atomic_load_n((const wHashTableGroup*)ctrl, __ATOMIC_RELAXED);
+#else
+	return winpr_Data_Get_UINT64_NE(&index->ctrl[group * HASHTABLE_GROUP_WIDTH]);
+#endif
+}
+
+/* All returned masks have the most significant bit of the matching bytes set */
+static INLINE UINT64 HashTable_MatchTag(UINT64 group, BYTE tag)
+{
+	const UINT64 x = group ^ (HASHTABLE_LSB * tag);
+	return (x - HASHTABLE_LSB) & ~x & HASHTABLE_MSB;
+}
+
+static INLINE UINT64 HashTable_MatchEmpty(UINT64 group)
+{
+	return group & ~(group << 6) & HASHTABLE_MSB;
+}
+
+static INLINE UINT64 HashTable_MatchEmptyOrDeleted(UINT64 group)
+{
+	return group & HASHTABLE_MSB;
+}
+
+static INLINE size_t HashTable_FirstMatch(UINT64 mask)
+{
+#if defined(__BIG_ENDIAN__)
+	size_t pos = 0;
+	while ((mask & 0x8000000000000000ULL) == 0)
 	{
-		if (oddNumber == i)
-			return TRUE;
-		else if (oddNumber % i == 0)
-			return FALSE;
+		mask <<= 8;
+		pos++;
+	}
+	return pos;
+#elif defined(__GNUC__) || defined(__clang__)
+	return (size_t)__builtin_ctzll(mask) / 8;
+#else
+	size_t pos = 0;
+	while ((mask & 0x80) == 0)
+	{
+		mask >>= 8;
+		pos++;
 	}
+	return pos;
+#endif
+}
 
-	return TRUE; /* maybe */
+static INLINE size_t HashTable_FirstGroup(const wHashTableIndex* index, UINT32 hash)
+{
+	return (hash >> 7) & ((index->capacity / HASHTABLE_GROUP_WIDTH) - 1);
 }
 
-static INLINE size_t HashTable_CalculateIdealNumOfBuckets(wHashTable* table)
+static INLINE size_t HashTable_NextGroup(const wHashTableIndex* index, size_t group, size_t step)
 {
-	WINPR_ASSERT(table);
+	/* triangular probing visits every group of a power of 2 sized index */
+	return (group + step) & ((index->capacity / HASHTABLE_GROUP_WIDTH) - 1);
+}
 
-	const float numOfElements = (float)table->numOfElements;
-	const float tmp = (numOfElements / table->idealRatio);
-	size_t idealNumOfBuckets = (size_t)tmp;
+static INLINE void HashTable_SetCtrl(wHashTableIndex* index, size_t slot, BYTE ctrl)
+{
+	WINPR_ASSERT(index);
+	WINPR_ASSERT(slot < index->capacity);
+	HASHTABLE_STORE(index->ctrl[slot], ctrl);
+}
 
-	if (idealNumOfBuckets < 5)
-		idealNumOfBuckets = 5;
-	else
-		idealNumOfBuckets |= 0x01;
+static void HashTable_ResetCtrl(wHashTableIndex* index)
+{
+	WINPR_ASSERT(index);
+
+#if defined(__GNUC__) || defined(__clang__)
+	for (size_t x = 0; x < index->capacity; x += HASHTABLE_GROUP_WIDTH)
+	{
+		wHashTableGroup* ctrl = (wHashTableGroup*)&index->ctrl[x];
+		__atomic_store_n(ctrl, HASHTABLE_LSB * HASHTABLE_CTRL_EMPTY, __ATOMIC_RELAXED);
+	}
+#else
+	memset(index->ctrl, HASHTABLE_CTRL_EMPTY, index->capacity);
+#endif
+}
+
+static INLINE void HashTable_StorePair(wKeyValuePair* dst, const wKeyValuePair* src)
+{
+	WINPR_ASSERT(dst);
+	WINPR_ASSERT(src);
+
+	HASHTABLE_STORE(dst->key, src->key);
+	HASHTABLE_STORE(dst->value, src->value);
+	HASHTABLE_STORE(dst->hash, src->hash);
+	HASHTABLE_STORE(dst->markedForRemove, src->markedForRemove);
+}
+
+static void HashTable_FreeIndex(wHashTableIndex* index)
+{
+	while (index)
+	{
+		wHashTableIndex* next = index->retired;
+		free(index);
+		index = next;
+	}
+}
 
-	while (!HashTable_IsProbablePrime(idealNumOfBuckets))
-		idealNumOfBuckets += 2;
+static wHashTableIndex* HashTable_NewIndex(size_t capacity)
+{
+	WINPR_ASSERT(capacity >= HASHTABLE_MIN_CAPACITY);
+	WINPR_ASSERT((capacity & (capacity - 1)) == 0);
 
-	return idealNumOfBuckets;
+	if (capacity > UINT32_MAX)
+		return NULL;
+
+	const size_t maxEntries = capacity - capacity / 8;
+	const size_t size = sizeof(wHashTableIndex) + capacity * (sizeof(BYTE) + sizeof(UINT32)) +
+	                    maxEntries * sizeof(wKeyValuePair);
+	BYTE* data = (BYTE*)calloc(1, size);
+	if (!data)
+		return NULL;
+
+	/* capacity is a multiple of 16, so all arrays are properly aligned */
+	wHashTableIndex* index = (wHashTableIndex*)data;
+	index->capacity = capacity;
+	index->maxEntries = maxEntries;
+	index->ctrl = &data[sizeof(wHashTableIndex)];
+	index->slots = (UINT32*)&index->ctrl[capacity];
+	index->entries = (wKeyValuePair*)&index->slots[capacity];
+	HashTable_ResetCtrl(index);
+	return index;
+}
+
+static INLINE BOOL HashTable_Equals(wHashTable* table, const wKeyValuePair* pair, const void* key)
+{
+	const void* pairKey = HASHTABLE_LOAD(pair->key);
+	if (!pairKey)
+		return FALSE;
+	return table->key.fnObjectEquals(key, pairKey);
 }
 
-static INLINE void HashTable_Rehash(wHashTable* table, size_t numOfBuckets)
+/* Returns the slot of \b key or -1 if not found. May be called without holding the lock,
+ * all array accesses are bounds checked then. */
+static INLINE SSIZE_T HashTable_FindSlot(wHashTable* table, const wHashTableIndex* index,
+                                         const void* key, UINT32 hash)
 {
-	UINT32 hashValue = 0;
-	wKeyValuePair* nextPair = NULL;
-	wKeyValuePair** newBucketArray = NULL;
+	const BYTE tag = HashTable_HashTag(hash);
+	const size_t groups = index->capacity / HASHTABLE_GROUP_WIDTH;
+	size_t group = HashTable_FirstGroup(index, hash);
 
+	for (size_t step = 1; step <= groups; step++)
+	{
+		const UINT64 ctrl = HashTable_LoadGroup(index, group);
+		UINT64 match = HashTable_MatchTag(ctrl, tag);
+
+		while (match)
+		{
+			const size_t slot = group * HASHTABLE_GROUP_WIDTH + HashTable_FirstMatch(match);
+			const UINT32 entry = HASHTABLE_LOAD(index->slots[slot]);
+
+			if (entry < index->maxEntries)
+			{
+				const wKeyValuePair* pair = &index->entries[entry];
+				if ((HASHTABLE_LOAD(pair->hash) == hash) && HashTable_Equals(table, pair, key))
+					return (SSIZE_T)slot;
+			}
+			match &= match - 1;
+		}
+
+		if (HashTable_MatchEmpty(ctrl))
+			break;
+
+		group = HashTable_NextGroup(index, group, step);
+	}
+
+	return -1;
+}
+
+static INLINE wKeyValuePair* HashTable_Get(wHashTable* table, const void* key)
+{
 	WINPR_ASSERT(table);
-	if (numOfBuckets == 0)
-		numOfBuckets = HashTable_CalculateIdealNumOfBuckets(table);
+	if (!key)
+		return NULL;
 
-	if (numOfBuckets == table->numOfBuckets)
-		return; /* already the right size! */
+	wHashTableIndex* index = table->index;
+	const SSIZE_T slot = HashTable_FindSlot(table, index, key, HashTable_Hash(table, key));
+	if (slot < 0)
+		return NULL;
+	return &index->entries[index->slots[slot]];
+}
 
-	newBucketArray = (wKeyValuePair**)calloc(numOfBuckets, sizeof(wKeyValuePair*));
+static INLINE size_t HashTable_FindFreeSlot(const wHashTableIndex* index, UINT32 hash)
+{
+	const size_t groups = index->capacity / HASHTABLE_GROUP_WIDTH;
+	size_t group = HashTable_FirstGroup(index, hash);
 
-	if (!newBucketArray)
+	for (size_t step = 1; step <= groups; step++)
 	{
-		/*
-		 * Couldn't allocate memory for the new array.
-		 * This isn't a fatal error; we just can't perform the rehash.
-		 */
-		return;
+		const UINT64 match = HashTable_MatchEmptyOrDeleted(HashTable_LoadGroup(index, group));
+		if (match)
+			return group * HASHTABLE_GROUP_WIDTH + HashTable_FirstMatch(match);
+		group = HashTable_NextGroup(index, group, step);
 	}
 
-	for (size_t index = 0; index < table->numOfBuckets; index++)
+	/* the index always has free slots */
+	WINPR_ASSERT(FALSE);
+	return 0;
+}
+
+static INLINE size_t HashTable_FindEntrySlot(const wHashTableIndex* index, UINT32 hash,
+                                             size_t entry)
+{
+	const BYTE tag = HashTable_HashTag(hash);
+	const size_t groups = index->capacity / HASHTABLE_GROUP_WIDTH;
+	size_t group = HashTable_FirstGroup(index, hash);
+
+	for (size_t step = 1; step <= groups; step++)
 	{
-		wKeyValuePair* pair = table->bucketArray[index];
+		UINT64 match = HashTable_MatchTag(HashTable_LoadGroup(index, group), tag);
 
-		while (pair)
+		while (match)
 		{
-			nextPair = pair->next;
-			hashValue = table->hash(pair->key) % numOfBuckets;
-			pair->next = newBucketArray[hashValue];
-			newBucketArray[hashValue] = pair;
-			pair = nextPair;
+			const size_t slot = group * HASHTABLE_GROUP_WIDTH + HashTable_FirstMatch(match);
+			if (index->slots[slot] == entry)
+				return slot;
+			match &= match - 1;
 		}
+		group = HashTable_NextGroup(index, group, step);
 	}
 
-	free((void*)table->bucketArray);
-	table->bucketArray = newBucketArray;
-	table->numOfBuckets = numOfBuckets;
+	/* every entry is referenced by the index */
+	WINPR_ASSERT(FALSE);
+	return 0;
 }
 
-static INLINE BOOL HashTable_Equals(wHashTable* table, const wKeyValuePair* pair, const void* key)
+static INLINE void HashTable_BeginWrite(wHashTable* table)
 {
 	WINPR_ASSERT(table);
-	WINPR_ASSERT(pair);
-	WINPR_ASSERT(key);
-	return table->key.fnObjectEquals(key, pair->key);
+	if (table->readMostly)
+	{
+		(void)InterlockedIncrement(&table->sequence);
+#if defined(__GNUC__) || defined(__clang__)
+		/* the odd sequence must be visible before any of the following stores */
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+#endif
+	}
 }
 
-static INLINE wKeyValuePair* HashTable_Get(wHashTable* table, const void* key)
+static INLINE void HashTable_EndWrite(wHashTable* table)
 {
-	UINT32 hashValue = 0;
-	wKeyValuePair* pair = NULL;
+	WINPR_ASSERT(table);
+	if (table->readMostly)
+		(void)InterlockedIncrement(&table->sequence);
+}
+
+/* Lock free readers must not write to the table, so the sequence is read with plain loads
+ * where the compiler allows to express the required ordering */
+static INLINE LONG HashTable_ReadBegin(wHashTable* table)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __atomic_load_n(&table->sequence, __ATOMIC_ACQUIRE);
+#else
+	return InterlockedCompareExchange(&table->sequence, 0, 0);
+#endif
+}
+
+static INLINE BOOL HashTable_ReadValidate(wHashTable* table, LONG sequence)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&table->sequence, __ATOMIC_RELAXED) == sequence;
+#else
+	return InterlockedCompareExchange(&table->sequence, 0, 0) == sequence;
+#endif
+}
 
+static INLINE BOOL HashTable_LockFreeReads(wHashTable* table)
+{
 	WINPR_ASSERT(table);
-	if (!key)
-		return NULL;
 
-	hashValue = table->hash(key) % table->numOfBuckets;
-	pair = table->bucketArray[hashValue];
+	/* Keys freed by the table might be released while a reader compares them */
+	return table->readMostly && !table->key.fnObjectFree;
+}
+
+/* Lookup without taking the lock, returns FALSE if no consistent state could be read */
+static BOOL HashTable_TryGetOptimistic(wHashTable* table, const void* key, void** pvalue,
+                                       BOOL* pfound)
+{
+	const UINT32 hash = HashTable_Hash(table, key);
+
+	for (size_t attempt = 0; attempt < HASHTABLE_OPTIMISTIC_RETRIES; attempt++)
+	{
+		void* value = NULL;
+		BOOL found = FALSE;
+
+		const LONG sequence = HashTable_ReadBegin(table);
+		if (sequence & 1)
+			continue;
+
+		const wHashTableIndex* index = HASHTABLE_LOAD(table->index);
+		const SSIZE_T slot = HashTable_FindSlot(table, index, key, hash);
+		if (slot >= 0)
+		{
+			const UINT32 entry = HASHTABLE_LOAD(index->slots[slot]);
+			if (entry < index->maxEntries)
+			{
+				const wKeyValuePair* pair = &index->entries[entry];
+				found = !HASHTABLE_LOAD(pair->markedForRemove);
+				if (found)
+					value = HASHTABLE_LOAD(pair->value);
+			}
+		}
+
+		if (HashTable_ReadValidate(table, sequence))
+		{
+			*pvalue = value;
+			*pfound = found;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void HashTable_PublishIndex(wHashTable* table, wHashTableIndex* index)
+{
+	WINPR_ASSERT(table);
+	WINPR_ASSERT(index);
+
+	/* writers are serialized by the lock, the exchange only acts as barrier */
+	wHashTableIndex* old = table->index;
+	(void)InterlockedCompareExchangePointer((PVOID volatile*)&table->index, index, old);
+	if (!old)
+		return;
+
+	if (table->readMostly)
+	{
+		old->retired = table->retired;
+		table->retired = old;
+	}
+	else
+		HashTable_FreeIndex(old);
+}
 
-	while (pair && !HashTable_Equals(table, pair, key))
-		pair = pair->next;
+/* Recreates the slots of all entries, drops deleted slots */
+static void HashTable_RebuildSlots(wHashTable* table, wHashTableIndex* index)
+{
+	WINPR_ASSERT(table);
+	WINPR_ASSERT(index);
 
-	return pair;
+	HashTable_ResetCtrl(index);
+	for (size_t x = 0; x < table->numOfEntries; x++)
+	{
+		const wKeyValuePair* pair = &index->entries[x];
+		const size_t slot = HashTable_FindFreeSlot(index, pair->hash);
+		HASHTABLE_STORE(index->slots[slot], (UINT32)x);
+		HashTable_SetCtrl(index, slot, HashTable_HashTag(pair->hash));
+	}
+	table->numOfUsedSlots = table->numOfEntries;
+}
+
+static BOOL HashTable_Rehash(wHashTable* table, size_t capacity)
+{
+	WINPR_ASSERT(table);
+
+	wHashTableIndex* index = HashTable_NewIndex(capacity);
+	if (!index)
+		return FALSE;
+
+	WINPR_ASSERT(table->numOfEntries <= index->maxEntries);
+	memcpy(index->entries, table->index->entries, table->numOfEntries * sizeof(wKeyValuePair));
+	HashTable_RebuildSlots(table, index);
+	HashTable_PublishIndex(table, index);
+	return TRUE;
+}
+
+static BOOL HashTable_Reserve(wHashTable* table)
+{
+	WINPR_ASSERT(table);
+
+	wHashTableIndex* index = table->index;
+	if (table->numOfEntries >= index->maxEntries)
+		return HashTable_Rehash(table, index->capacity * 2);
+
+	/* too many deleted slots, clean up in place */
+	if (table->numOfUsedSlots >= index->maxEntries)
+		HashTable_RebuildSlots(table, index);
+
+	return TRUE;
 }
 
 static INLINE void disposeKey(wHashTable* table, void* key)
@@ -226,7 +576,6 @@ static INLINE void disposePair(wHashTable* table, wKeyValuePair* pair)
 		return;
 	disposeKey(table, pair->key);
 	disposeValue(table, pair->value);
-	free(pair);
 }
 
 static INLINE void setKey(wHashTable* table, wKeyValuePair* pair, const void* key)
@@ -236,7 +585,7 @@ static INLINE void setKey(wHashTable* table, wKeyValuePair* pair, const void* ke
 		return;
 	disposeKey(table, pair->key);
 	if (table->key.fnObjectNew)
-		pair->key = table->key.fnObjectNew(key);
+		HASHTABLE_STORE(pair->key, table->key.fnObjectNew(key));
 	else
 	{
 		union
@@ -245,7 +594,7 @@ static INLINE void setKey(wHashTable* table, wKeyValuePair* pair, const void* ke
 			void* pv;
 		} cnv;
 		cnv.cpv = key;
-		pair->key = cnv.pv;
+		HASHTABLE_STORE(pair->key, cnv.pv);
 	}
 }
 
@@ -256,7 +605,7 @@ static INLINE void setValue(wHashTable* table, wKeyValuePair* pair, const void*
 		return;
 	disposeValue(table, pair->value);
 	if (table->value.fnObjectNew)
-		pair->value = table->value.fnObjectNew(value);
+		HASHTABLE_STORE(pair->value, table->value.fnObjectNew(value));
 	else
 	{
 		union
@@ -265,8 +614,59 @@ static INLINE void setValue(wHashTable* table, wKeyValuePair* pair, const void*
 			void* pv;
 		} cnv;
 		cnv.cpv = value;
-		pair->value = cnv.pv;
+		HASHTABLE_STORE(pair->value, cnv.pv);
+	}
+}
+
+/* Removes the entry referenced by \b slot, the last entry is moved to its place */
+static void HashTable_Erase(wHashTable* table, size_t slot)
+{
+	WINPR_ASSERT(table);
+
+	wHashTableIndex* index = table->index;
+	const size_t entry = index->slots[slot];
+	const size_t last = table->numOfEntries - 1;
+	const size_t group = slot / HASHTABLE_GROUP_WIDTH;
+
+	/* A group that still has an empty slot was never full, so no probe sequence
+	 * continued past it and the slot can be marked empty again. */
+	if (HashTable_MatchEmpty(HashTable_LoadGroup(index, group)))
+	{
+		HashTable_SetCtrl(index, slot, HASHTABLE_CTRL_EMPTY);
+		table->numOfUsedSlots--;
+	}
+	else
+		HashTable_SetCtrl(index, slot, HASHTABLE_CTRL_DELETED);
+
+	const wKeyValuePair empty = { 0 };
+	wKeyValuePair pair = index->entries[entry];
+	if (entry != last)
+	{
+		const size_t lastSlot = HashTable_FindEntrySlot(index, index->entries[last].hash, last);
+		HashTable_StorePair(&index->entries[entry], &index->entries[last]);
+		HASHTABLE_STORE(index->slots[lastSlot], (UINT32)entry);
+	}
+
+	HashTable_StorePair(&index->entries[last], &empty);
+	table->numOfEntries--;
+	disposePair(table, &pair);
+}
+
+static void HashTable_PurgeRemoved(wHashTable* table)
+{
+	WINPR_ASSERT(table);
+
+	HashTable_BeginWrite(table);
+	for (size_t x = table->numOfEntries; x > 0; x--)
+	{
+		const wHashTableIndex* index = table->index;
+		const wKeyValuePair* pair = &index->entries[x - 1];
+
+		if (pair->markedForRemove)
+			HashTable_Erase(table, HashTable_FindEntrySlot(index, pair->hash, x - 1));
 	}
+	table->pendingRemoves = 0;
+	HashTable_EndWrite(table);
 }
 
 /**
@@ -307,9 +707,6 @@ int HashTable_Add(wHashTable* table, const void* key, const void* value)
 BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 {
 	BOOL rc = FALSE;
-	UINT32 hashValue = 0;
-	wKeyValuePair* pair = NULL;
-	wKeyValuePair* newPair = NULL;
 
 	WINPR_ASSERT(table);
 	if (!key || !value)
@@ -318,11 +715,9 @@ BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	hashValue = table->hash(key) % table->numOfBuckets;
-	pair = table->bucketArray[hashValue];
+	HashTable_BeginWrite(table);
 
-	while (pair && !HashTable_Equals(table, pair, key))
-		pair = pair->next;
+	wKeyValuePair* pair = HashTable_Get(table, key);
 
 	if (pair)
 	{
@@ -330,7 +725,7 @@ BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 		{
 			/* this entry was set to be removed but will be recycled instead */
 			table->pendingRemoves--;
-			pair->markedForRemove = FALSE;
+			HASHTABLE_STORE(pair->markedForRemove, FALSE);
 			table->numOfElements++;
 		}
 
@@ -345,31 +740,30 @@ BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 		}
 		rc = TRUE;
 	}
-	else
+	else if (HashTable_Reserve(table))
 	{
-		newPair = (wKeyValuePair*)calloc(1, sizeof(wKeyValuePair));
-
-		if (newPair)
-		{
-			setKey(table, newPair, key);
-			setValue(table, newPair, value);
-			newPair->next = table->bucketArray[hashValue];
-			newPair->markedForRemove = FALSE;
-			table->bucketArray[hashValue] = newPair;
-			table->numOfElements++;
-
-			if (!table->foreachRecursionLevel && table->upperRehashThreshold > table->idealRatio)
-			{
-				float elementToBucketRatio =
-				    (float)table->numOfElements / (float)table->numOfBuckets;
+		const UINT32 hash = HashTable_Hash(table, key);
+		wHashTableIndex* index = table->index;
+		const size_t slot = HashTable_FindFreeSlot(index, hash);
+		const size_t entry = table->numOfEntries;
 
-				if (elementToBucketRatio > table->upperRehashThreshold)
-					HashTable_Rehash(table, 0);
-			}
-			rc = TRUE;
-		}
+		pair = &index->entries[entry];
+		setKey(table, pair, key);
+		setValue(table, pair, value);
+		HASHTABLE_STORE(pair->hash, hash);
+		HASHTABLE_STORE(pair->markedForRemove, FALSE);
+
+		if (index->ctrl[slot] == HASHTABLE_CTRL_EMPTY)
+			table->numOfUsedSlots++;
+		HASHTABLE_STORE(index->slots[slot], (UINT32)entry);
+		HashTable_SetCtrl(index, slot, HashTable_HashTag(hash));
+		table->numOfEntries++;
+		table->numOfElements++;
+		rc = TRUE;
 	}
 
+	HashTable_EndWrite(table);
+
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
 
@@ -382,10 +776,7 @@ BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 
 BOOL HashTable_Remove(wHashTable* table, const void* key)
 {
-	UINT32 hashValue = 0;
 	BOOL status = TRUE;
-	wKeyValuePair* pair = NULL;
-	wKeyValuePair* previousPair = NULL;
 
 	WINPR_ASSERT(table);
 	if (!key)
@@ -394,47 +785,33 @@ BOOL HashTable_Remove(wHashTable* table, const void* key)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	hashValue = table->hash(key) % table->numOfBuckets;
-	pair = table->bucketArray[hashValue];
+	HashTable_BeginWrite(table);
 
-	while (pair && !HashTable_Equals(table, pair, key))
-	{
-		previousPair = pair;
-		pair = pair->next;
-	}
+	const SSIZE_T slot =
+	    HashTable_FindSlot(table, table->index, key, HashTable_Hash(table, key));
+	wKeyValuePair* pair = (slot < 0) ? NULL : &table->index->entries[table->index->slots[slot]];
 
-	if (!pair)
+	if (!pair || pair->markedForRemove)
 	{
 		status = FALSE;
 		goto out;
 	}
 
+	table->numOfElements--;
+
 	if (table->foreachRecursionLevel)
 	{
 		/* if we are running a HashTable_Foreach, just mark the entry for removal */
-		pair->markedForRemove = TRUE;
+		HASHTABLE_STORE(pair->markedForRemove, TRUE);
 		table->pendingRemoves++;
-		table->numOfElements--;
 		goto out;
 	}
 
-	if (previousPair)
-		previousPair->next = pair->next;
-	else
-		table->bucketArray[hashValue] = pair->next;
-
-	disposePair(table, pair);
-	table->numOfElements--;
-
-	if (!table->foreachRecursionLevel && table->lowerRehashThreshold > 0.0f)
-	{
-		float elementToBucketRatio = (float)table->numOfElements / (float)table->numOfBuckets;
-
-		if (elementToBucketRatio < table->lowerRehashThreshold)
-			HashTable_Rehash(table, 0);
-	}
+	HashTable_Erase(table, (size_t)slot);
 
 out:
+	HashTable_EndWrite(table);
+
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
 
@@ -454,6 +831,13 @@ void* HashTable_GetItemValue(wHashTable* table, const void* key)
 	if (!key)
 		return NULL;
 
+	if (HashTable_LockFreeReads(table))
+	{
+		BOOL found = FALSE;
+		if (HashTable_TryGetOptimistic(table, key, &value, &found))
+			return value;
+	}
+
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
@@ -484,6 +868,8 @@ BOOL HashTable_SetItemValue(wHashTable* table, const void* key, const void* valu
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
+	HashTable_BeginWrite(table);
+
 	pair = HashTable_Get(table, key);
 
 	if (!pair || pair->markedForRemove)
@@ -493,6 +879,8 @@ BOOL HashTable_SetItemValue(wHashTable* table, const void* key, const void* valu
 		setValue(table, pair, value);
 	}
 
+	HashTable_EndWrite(table);
+
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
 
@@ -505,40 +893,50 @@ BOOL HashTable_SetItemValue(wHashTable* table, const void* key, const void* valu
 
 void HashTable_Clear(wHashTable* table)
 {
-	wKeyValuePair* nextPair = NULL;
-
 	WINPR_ASSERT(table);
 
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	for (size_t index = 0; index < table->numOfBuckets; index++)
-	{
-		wKeyValuePair* pair = table->bucketArray[index];
+	HashTable_BeginWrite(table);
 
-		while (pair)
+	if (table->foreachRecursionLevel)
+	{
+		/* if we're in a foreach we just mark the entries for removal */
+		for (size_t x = 0; x < table->numOfEntries; x++)
 		{
-			nextPair = pair->next;
+			wKeyValuePair* pair = &table->index->entries[x];
 
-			if (table->foreachRecursionLevel)
+			if (!pair->markedForRemove)
 			{
-				/* if we're in a foreach we just mark the entry for removal */
-				pair->markedForRemove = TRUE;
+				HASHTABLE_STORE(pair->markedForRemove, TRUE);
 				table->pendingRemoves++;
 			}
-			else
-			{
-				disposePair(table, pair);
-				pair = nextPair;
-			}
 		}
+	}
+	else
+	{
+		const wKeyValuePair empty = { 0 };
+		wHashTableIndex* index = table->index;
+
+		for (size_t x = 0; x < table->numOfEntries; x++)
+		{
+			disposePair(table, &index->entries[x]);
+			HashTable_StorePair(&index->entries[x], &empty);
+		}
+
+		HashTable_ResetCtrl(index);
+		table->numOfEntries = 0;
+		table->numOfUsedSlots = 0;
 
-		table->bucketArray[index] = NULL;
+		/* lock free readers might still use the old index, only shrink if there are none */
+		if (!table->readMostly && (index->capacity > HASHTABLE_MIN_CAPACITY))
+			(void)HashTable_Rehash(table, HASHTABLE_MIN_CAPACITY);
 	}
 
 	table->numOfElements = 0;
-	if (table->foreachRecursionLevel == 0)
-		HashTable_Rehash(table, 5);
+
+	HashTable_EndWrite(table);
 
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
@@ -553,7 +951,6 @@ size_t HashTable_GetKeys(wHashTable* table, ULONG_PTR** ppKeys)
 	size_t iKey = 0;
 	size_t count = 0;
 	ULONG_PTR* pKeys = NULL;
-	wKeyValuePair* nextPair = NULL;
 
 	WINPR_ASSERT(table);
 
@@ -583,17 +980,12 @@ size_t HashTable_GetKeys(wHashTable* table, ULONG_PTR** ppKeys)
 		return 0;
 	}
 
-	for (size_t index = 0; index < table->numOfBuckets; index++)
+	for (size_t x = 0; x < table->numOfEntries; x++)
 	{
-		wKeyValuePair* pair = table->bucketArray[index];
+		const wKeyValuePair* pair = &table->index->entries[x];
 
-		while (pair)
-		{
-			nextPair = pair->next;
-			if (!pair->markedForRemove)
-				pKeys[iKey++] = (ULONG_PTR)pair->key;
-			pair = nextPair;
-		}
+		if (!pair->markedForRemove)
+			pKeys[iKey++] = (ULONG_PTR)pair->key;
 	}
 
 	if (table->synchronized)
@@ -616,48 +1008,25 @@ BOOL HashTable_Foreach(wHashTable* table, HASH_TABLE_FOREACH_FN fn, VOID* arg)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
+	/* The callback may insert (growing the index) or remove entries, so
+	 * always access the entries through the current index. Removed entries are
+	 * only marked and cleaned up by the outermost foreach. */
 	table->foreachRecursionLevel++;
-	for (size_t index = 0; index < table->numOfBuckets; index++)
+	for (size_t x = 0; x < table->numOfEntries; x++)
 	{
-		for (wKeyValuePair* pair = table->bucketArray[index]; pair; pair = pair->next)
+		const wKeyValuePair* pair = &table->index->entries[x];
+
+		if (!pair->markedForRemove && !fn(pair->key, pair->value, arg))
 		{
-			if (!pair->markedForRemove && !fn(pair->key, pair->value, arg))
-			{
-				ret = FALSE;
-				goto out;
-			}
+			ret = FALSE;
+			break;
 		}
 	}
 	table->foreachRecursionLevel--;
 
 	if (!table->foreachRecursionLevel && table->pendingRemoves)
-	{
-		/* if we're the last recursive foreach call, let's do the cleanup if needed */
-		wKeyValuePair** prevPtr = NULL;
-		for (size_t index = 0; index < table->numOfBuckets; index++)
-		{
-			wKeyValuePair* nextPair = NULL;
-			prevPtr = &table->bucketArray[index];
-			for (wKeyValuePair* pair = table->bucketArray[index]; pair;)
-			{
-				nextPair = pair->next;
-
-				if (pair->markedForRemove)
-				{
-					disposePair(table, pair);
-					*prevPtr = nextPair;
-				}
-				else
-				{
-					prevPtr = &pair->next;
-				}
-				pair = nextPair;
-			}
-		}
-		table->pendingRemoves = 0;
-	}
+		HashTable_PurgeRemoved(table);
 
-out:
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
 	return ret;
@@ -676,6 +1045,13 @@ BOOL HashTable_Contains(wHashTable* table, const void* key)
 	if (!key)
 		return FALSE;
 
+	if (HashTable_LockFreeReads(table))
+	{
+		void* value = NULL;
+		if (HashTable_TryGetOptimistic(table, key, &value, &status))
+			return status;
+	}
+
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
@@ -694,23 +1070,7 @@ BOOL HashTable_Contains(wHashTable* table, const void* key)
 
 BOOL HashTable_ContainsKey(wHashTable* table, const void* key)
 {
-	BOOL status = 0;
-	wKeyValuePair* pair = NULL;
-
-	WINPR_ASSERT(table);
-	if (!key)
-		return FALSE;
-
-	if (table->synchronized)
-		EnterCriticalSection(&table->lock);
-
-	pair = HashTable_Get(table, key);
-	status = (pair && !pair->markedForRemove);
-
-	if (table->synchronized)
-		LeaveCriticalSection(&table->lock);
-
-	return status;
+	return HashTable_Contains(table, key);
 }
 
 /**
@@ -728,23 +1088,16 @@ BOOL HashTable_ContainsValue(wHashTable* table, const void* value)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	for (size_t index = 0; index < table->numOfBuckets; index++)
+	for (size_t x = 0; x < table->numOfEntries; x++)
 	{
-		wKeyValuePair* pair = table->bucketArray[index];
+		const wKeyValuePair* pair = &table->index->entries[x];
 
-		while (pair)
+		if (!pair->markedForRemove && pair->value &&
+		    table->value.fnObjectEquals(value, pair->value))
 		{
-			if (!pair->markedForRemove && HashTable_Equals(table, pair, value))
-			{
-				status = TRUE;
-				break;
-			}
-
-			pair = pair->next;
-		}
-
-		if (status)
+			status = TRUE;
 			break;
+		}
 	}
 
 	if (table->synchronized)
@@ -766,16 +1119,11 @@ wHashTable* HashTable_New(BOOL synchronized)
 
 	table->synchronized = synchronized;
 	InitializeCriticalSectionAndSpinCount(&(table->lock), 4000);
-	table->numOfBuckets = 64;
-	table->numOfElements = 0;
-	table->bucketArray = (wKeyValuePair**)calloc(table->numOfBuckets, sizeof(wKeyValuePair*));
+	table->index = HashTable_NewIndex(HASHTABLE_MIN_CAPACITY);
 
-	if (!table->bucketArray)
+	if (!table->index)
 		goto fail;
 
-	table->idealRatio = 3.0f;
-	table->lowerRehashThreshold = 0.0f;
-	table->upperRehashThreshold = 15.0f;
 	table->hash = HashTable_PointerHash;
 	table->key.fnObjectEquals = HashTable_PointerCompare;
 	table->value.fnObjectEquals = HashTable_PointerCompare;
@@ -791,33 +1139,35 @@ fail:
 
 void HashTable_Free(wHashTable* table)
 {
-	wKeyValuePair* pair = NULL;
-	wKeyValuePair* nextPair = NULL;
-
 	if (!table)
 		return;
 
-	if (table->bucketArray)
+	if (table->index)
 	{
-		for (size_t index = 0; index < table->numOfBuckets; index++)
-		{
-			pair = table->bucketArray[index];
-
-			while (pair)
-			{
-				nextPair = pair->next;
-
-				disposePair(table, pair);
-				pair = nextPair;
-			}
-		}
-		free((void*)table->bucketArray);
+		for (size_t x = 0; x < table->numOfEntries; x++)
+			disposePair(table, &table->index->entries[x]);
+		HashTable_FreeIndex(table->index);
 	}
+	HashTable_FreeIndex(table->retired);
 	DeleteCriticalSection(&(table->lock));
 
 	free(table);
 }
 
+BOOL HashTable_SetReadMostly(wHashTable* table, BOOL readMostly)
+{
+	WINPR_ASSERT(table);
+
+	/* without the lock writers are not serialized */
+	if (readMostly && !table->synchronized)
+		return FALSE;
+
+	EnterCriticalSection(&table->lock);
+	table->readMostly = readMostly;
+	LeaveCriticalSection(&table->lock);
+	return TRUE;
+}
+
 void HashTable_Lock(wHashTable* table)
 {
 	WINPR_ASSERT(table);
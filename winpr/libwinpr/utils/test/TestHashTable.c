@@ -1,6 +1,8 @@
 
 #include <winpr/crt.h>
 #include <winpr/tchar.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
 #include <winpr/collections.h>
 
 static char* key1 = "key1";
@@ -431,10 +433,278 @@ out:
 	return retCode;
 }
 
+#define TEST_MANY_KEYS 4096
+
+static void* key_for(size_t x)
+{
+	/* keys like surface or channel ids, 0 is not a valid key */
+	return (void*)(UINT_PTR)(x + 1);
+}
+
+static int test_hash_table_many(void)
+{
+	int rc = -1;
+	wHashTable* table = HashTable_New(FALSE);
+	if (!table)
+		return -1;
+
+	for (size_t round = 0; round < 3; round++)
+	{
+		for (size_t x = 0; x < TEST_MANY_KEYS; x++)
+		{
+			if (!HashTable_Insert(table, key_for(x), key_for(x * 3)))
+				goto fail;
+		}
+
+		/* remove every second key, leaves deleted slots behind */
+		for (size_t x = 0; x < TEST_MANY_KEYS; x += 2)
+		{
+			if (!HashTable_Remove(table, key_for(x)))
+				goto fail;
+		}
+
+		if (HashTable_Count(table) != TEST_MANY_KEYS / 2)
+		{
+			printf("HashTable_Count: Expected : %d, Actual: %" PRIuz "\n", TEST_MANY_KEYS / 2,
+			       HashTable_Count(table));
+			goto fail;
+		}
+
+		for (size_t x = 0; x < TEST_MANY_KEYS; x++)
+		{
+			const void* value = HashTable_GetItemValue(table, key_for(x));
+			const void* expected = (x % 2) ? key_for(x * 3) : NULL;
+			if (value != expected)
+			{
+				printf("HashTable_GetItemValue: key %" PRIuz " has wrong value\n", x);
+				goto fail;
+			}
+		}
+
+		if (!HashTable_ContainsValue(table, key_for(3)) ||
+		    HashTable_ContainsValue(table, key_for(0)))
+			goto fail;
+
+		ULONG_PTR* keys = NULL;
+		const size_t count = HashTable_GetKeys(table, &keys);
+		free(keys);
+		if (count != TEST_MANY_KEYS / 2)
+			goto fail;
+
+		HashTable_Clear(table);
+		if ((HashTable_Count(table) != 0) || HashTable_Contains(table, key_for(1)))
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	HashTable_Free(table);
+	return rc;
+}
+
+static BOOL foreachGrowFn(const void* key, void* value, void* arg)
+{
+	wHashTable* table = (wHashTable*)arg;
+	const size_t x = (size_t)(UINT_PTR)key - 1;
+
+	WINPR_UNUSED(value);
+
+	/* insertions from the callback grow the table while iterating */
+	if (x < TEST_MANY_KEYS)
+	{
+		if (!HashTable_Insert(table, key_for(x + TEST_MANY_KEYS), key_for(x)))
+			return FALSE;
+	}
+
+	return HashTable_Remove(table, key);
+}
+
+static int test_hash_foreach_modify(void)
+{
+	int rc = -1;
+	wHashTable* table = HashTable_New(TRUE);
+	if (!table)
+		return -1;
+
+	for (size_t x = 0; x < 16; x++)
+	{
+		if (!HashTable_Insert(table, key_for(x), key_for(x)))
+			goto fail;
+	}
+
+	/* every visited entry adds another one, the new entries are visited as well */
+	if (!HashTable_Foreach(table, foreachGrowFn, table))
+		goto fail;
+
+	if (HashTable_Count(table) != 0)
+	{
+		printf("HashTable_Count: Expected : 0, Actual: %" PRIuz "\n", HashTable_Count(table));
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	HashTable_Free(table);
+	return rc;
+}
+
+typedef struct
+{
+	wHashTable* table;
+	volatile LONG stop;
+	BOOL error;
+} ReaderData;
+
+static DWORD WINAPI reader_thread(LPVOID arg)
+{
+	ReaderData* d = (ReaderData*)arg;
+
+	while (!InterlockedCompareExchange(&d->stop, 0, 0))
+	{
+		/* the even keys are never removed, the odd keys come and go */
+		for (size_t x = 0; x < TEST_MANY_KEYS; x++)
+		{
+			const void* value = HashTable_GetItemValue(d->table, key_for(x));
+			if ((value && (value != key_for(x * 3))) || (!value && (x % 2 == 0)))
+			{
+				d->error = TRUE;
+				return 0;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int test_hash_table_read_mostly(void)
+{
+	int rc = -1;
+	HANDLE threads[2] = { 0 };
+	ReaderData data = { 0 };
+
+	data.table = HashTable_New(TRUE);
+	if (!data.table)
+		return -1;
+
+	if (!HashTable_SetReadMostly(data.table, TRUE))
+		goto fail;
+
+	for (size_t x = 0; x < TEST_MANY_KEYS; x += 2)
+	{
+		if (!HashTable_Insert(data.table, key_for(x), key_for(x * 3)))
+			goto fail;
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(threads); x++)
+	{
+		threads[x] = CreateThread(NULL, 0, reader_thread, &data, 0, NULL);
+		if (!threads[x])
+			goto fail;
+	}
+
+	for (size_t round = 0; round < 50; round++)
+	{
+		for (size_t x = 1; x < TEST_MANY_KEYS; x += 2)
+		{
+			if (!HashTable_Insert(data.table, key_for(x), key_for(x * 3)))
+				goto fail;
+		}
+		for (size_t x = 1; x < TEST_MANY_KEYS; x += 2)
+		{
+			if (!HashTable_Remove(data.table, key_for(x)))
+				goto fail;
+		}
+	}
+
+	rc = 0;
+fail:
+	(void)InterlockedExchange(&data.stop, 1);
+	for (size_t x = 0; x < ARRAYSIZE(threads); x++)
+	{
+		if (threads[x])
+		{
+			(void)WaitForSingleObject(threads[x], INFINITE);
+			(void)CloseHandle(threads[x]);
+		}
+	}
+
+	if (data.error)
+	{
+		printf("HashTable_GetItemValue: inconsistent result with concurrent writer\n");
+		rc = -1;
+	}
+
+	HashTable_Free(data.table);
+	return rc;
+}
+
+static int bench_hash_lookup(const char* name, BOOL synchronized, BOOL readMostly, size_t count)
+{
+	int rc = -1;
+	const size_t lookups = 1000000;
+	size_t found = 0;
+	size_t expected = 0;
+	wHashTable* table = HashTable_New(synchronized);
+	if (!table)
+		return -1;
+
+	if (readMostly && !HashTable_SetReadMostly(table, TRUE))
+		goto fail;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		if (!HashTable_Insert(table, key_for(x), key_for(x)))
+			goto fail;
+	}
+
+	const UINT64 start = winpr_GetTickCount64NS();
+	for (size_t x = 0; x < lookups; x++)
+	{
+		/* every second lookup is a miss */
+		if (HashTable_GetItemValue(table, key_for((x * 7) % (count * 2))))
+			found++;
+	}
+	const UINT64 stop = winpr_GetTickCount64NS();
+
+	printf("[%s] %" PRIuz " entries: %" PRIuz " lookups in %" PRIu64 "ms (%" PRIu64
+	       "ns per lookup)\n",
+	       name, count, lookups, (stop - start) / 1000000ull, (stop - start) / lookups);
+
+	for (size_t x = 0; x < lookups; x++)
+	{
+		if ((x * 7) % (count * 2) < count)
+			expected++;
+	}
+
+	if (found != expected)
+		goto fail;
+
+	rc = 0;
+fail:
+	HashTable_Free(table);
+	return rc;
+}
+
+static int test_hash_table_bench(void)
+{
+	const size_t sizes[] = { 16, 1024, 65536 };
+
+	for (size_t x = 0; x < ARRAYSIZE(sizes); x++)
+	{
+		if (bench_hash_lookup("unsynchronized", FALSE, FALSE, sizes[x]) < 0)
+			return -1;
+		if (bench_hash_lookup("synchronized", TRUE, FALSE, sizes[x]) < 0)
+			return -1;
+		if (bench_hash_lookup("read mostly", TRUE, TRUE, sizes[x]) < 0)
+			return -1;
+	}
+	return 0;
+}
+
 int TestHashTable(int argc, char* argv[])
 {
-	WINPR_UNUSED(argc);
-	WINPR_UNUSED(argv);
+	/* the lookup timings are only run on request: TestWinPRUtils TestHashTable benchmark */
+	const BOOL benchmark = (argc > 1) && (strcmp(argv[1], "benchmark") == 0);
 
 	if (test_hash_table_pointer() < 0)
 		return 1;
@@ -444,5 +714,17 @@ int TestHashTable(int argc, char* argv[])
 
 	if (test_hash_foreach() < 0)
 		return 3;
+
+	if (test_hash_table_many() < 0)
+		return 4;
+
+	if (test_hash_foreach_modify() < 0)
+		return 5;
+
+	if (test_hash_table_read_mostly() < 0)
+		return 6;
+
+	if (benchmark && (test_hash_table_bench() < 0))
+		return 7;
 	return 0;
 }
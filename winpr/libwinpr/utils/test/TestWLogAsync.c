@@ -0,0 +1,191 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+#include <winpr/thread.h>
+#include <winpr/environment.h>
+#include <winpr/wlog.h>
+
+#define TEST_THREADS 4
+#define TEST_MESSAGES 2000
+
+static DWORD WINAPI test_log_thread(LPVOID arg)
+{
+	wLog* log = (wLog*)arg;
+
+	for (size_t x = 0; x < TEST_MESSAGES; x++)
+		WLog_Print(log, WLOG_INFO, "message %" PRIuz " from thread %" PRIu32, x,
+		           GetCurrentThreadId());
+
+	return 0;
+}
+
+static size_t count_lines(const char* path)
+{
+	size_t lines = 0;
+	FILE* fp = winpr_fopen(path, "r");
+	if (!fp)
+		return 0;
+
+	int c = 0;
+	while ((c = fgetc(fp)) != EOF)
+	{
+		if (c == '\n')
+			lines++;
+	}
+
+	(void)fclose(fp);
+	return lines;
+}
+
+static BOOL test_async(const char* tmp_path, const char* policy, const char* queueSize)
+{
+	BOOL rc = FALSE;
+	HANDLE threads[TEST_THREADS] = { 0 };
+	char name[64] = { 0 };
+	char* wlog_file = NULL;
+	wLog* root = WLog_GetRoot();
+
+	(void)_snprintf(name, sizeof(name), "test_w_async_%s.log", policy);
+
+	if (!SetEnvironmentVariableA("WLOG_ASYNC", policy))
+		return FALSE;
+	if (!SetEnvironmentVariableA("WLOG_ASYNC_QUEUE_SIZE", queueSize))
+		return FALSE;
+	if (!WLog_SetLogAppenderType(root, WLOG_APPENDER_FILE))
+		return FALSE;
+
+	wLogAppender* appender = WLog_GetLogAppender(root);
+	if (!WLog_ConfigureAppender(appender, "outputfilename", name))
+		goto out;
+	if (!WLog_ConfigureAppender(appender, "outputfilepath", (void*)tmp_path))
+		goto out;
+
+	wlog_file = GetCombinedPath(tmp_path, name);
+	if (!wlog_file)
+		goto out;
+	winpr_DeleteFile(wlog_file);
+
+	if (!WLog_OpenAppender(root))
+		goto out;
+
+	wLog* log = WLog_Get("com.test.async");
+	if (!WLog_SetLogLevel(log, WLOG_INFO))
+		goto out;
+
+	for (size_t x = 0; x < TEST_THREADS; x++)
+	{
+		threads[x] = CreateThread(NULL, 0, test_log_thread, log, 0, NULL);
+		if (!threads[x])
+			goto out;
+	}
+
+	for (size_t x = 0; x < TEST_THREADS; x++)
+	{
+		(void)WaitForSingleObject(threads[x], INFINITE);
+		(void)CloseHandle(threads[x]);
+		threads[x] = NULL;
+	}
+
+	WLog_CloseAppender(root);
+
+	const size_t dropped = WLog_GetAppenderDroppedMessages(appender);
+	const size_t lines = count_lines(wlog_file);
+	if (lines + dropped != TEST_THREADS * TEST_MESSAGES)
+	{
+		(void)fprintf(stderr, "[%s] expected %d messages, got %" PRIuz " written, %" PRIuz
+		                      " dropped\n",
+		              policy, TEST_THREADS * TEST_MESSAGES, lines, dropped);
+		goto out;
+	}
+
+	if ((strcmp(policy, "block") == 0) && (dropped != 0))
+	{
+		(void)fprintf(stderr, "[%s] dropped %" PRIuz " messages\n", policy, dropped);
+		goto out;
+	}
+
+	rc = TRUE;
+out:
+	for (size_t x = 0; x < TEST_THREADS; x++)
+	{
+		if (threads[x])
+		{
+			(void)WaitForSingleObject(threads[x], INFINITE);
+			(void)CloseHandle(threads[x]);
+		}
+	}
+
+	if (wlog_file)
+		winpr_DeleteFile(wlog_file);
+	free(wlog_file);
+	return rc;
+}
+
+static BOOL test_async_setting(void)
+{
+	struct
+	{
+		const char* value;
+		BOOL expected;
+	} settings[] = {
+		{ "block:0", FALSE }, { "block:", FALSE }, { "block:8x", FALSE },
+		{ "fast:8", FALSE },  { "block:8", TRUE }, { "drop:5", TRUE }, /* same queue size */
+		{ "block", TRUE },    { "drop:64", FALSE } /* running queue */, { "drop:8", TRUE }
+	};
+	wLog* root = WLog_GetRoot();
+
+	if (!SetEnvironmentVariableA("WLOG_ASYNC", NULL))
+		return FALSE;
+	if (!WLog_SetLogAppenderType(root, WLOG_APPENDER_FILE))
+		return FALSE;
+
+	wLogAppender* appender = WLog_GetLogAppender(root);
+	for (size_t x = 0; x < ARRAYSIZE(settings); x++)
+	{
+		char value[32] = { 0 };
+		(void)_snprintf(value, sizeof(value), "%s", settings[x].value);
+
+		if (WLog_ConfigureAppender(appender, "async", value) != settings[x].expected)
+		{
+			(void)fprintf(stderr, "[%s] async setting '%s' should %s\n", __func__, value,
+			              settings[x].expected ? "succeed" : "fail");
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+int TestWLogAsync(int argc, char* argv[])
+{
+	int result = -1;
+	char* tmp_path = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!(tmp_path = GetKnownPath(KNOWN_PATH_TEMP)))
+	{
+		(void)fprintf(stderr, "Failed to get temporary directory!\n");
+		goto out;
+	}
+
+	if (!test_async(tmp_path, "block", "16"))
+		goto out;
+
+	if (!test_async(tmp_path, "drop", "16"))
+		goto out;
+
+	if (!test_async_setting())
+		goto out;
+
+	result = 0;
+out:
+	(void)SetEnvironmentVariableA("WLOG_ASYNC", NULL);
+	(void)SetEnvironmentVariableA("WLOG_ASYNC_QUEUE_SIZE", NULL);
+	(void)WLog_SetLogAppenderType(WLog_GetRoot(), WLOG_APPENDER_CONSOLE);
+	free(tmp_path);
+	return result;
+}
@@ -0,0 +1,280 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+#include <winpr/stream.h>
+#include <winpr/wlog.h>
+
+/* see winpr/libwinpr/utils/wlog/BinaryTrace.h */
+#define WLOG_TRACE_RECORD_SESSION 0x57540000
+#define WLOG_TRACE_RECORD_FORMAT 0x57540001
+#define WLOG_TRACE_RECORD_EVENT 0x57540002
+#define WLOG_TRACE_RECORD_TEXT 0x57540003
+
+#define WLOG_TRACE_ARG_INTEGER 1
+#define WLOG_TRACE_ARG_DOUBLE 2
+#define WLOG_TRACE_ARG_STRING 4
+
+#define TEST_MESSAGES 3
+
+static void log_messages(wLog* log)
+{
+	/* strings with a precision do not need to be terminated */
+	const char unterminated[6] = { 'u', 'r', 'i', ':', '/', '/' };
+
+	for (INT32 x = 0; x < TEST_MESSAGES; x++)
+		WLog_Print(log, WLOG_INFO, "value %" PRId32 " name %s ratio %f", -x, "test", 0.5);
+
+	WLog_Print(log, WLOG_WARN, "%-*s|", 8, "aligned");
+	WLog_Print(log, WLOG_WARN, "processing %.*s", 3, unterminated);
+	WLog_Print(log, WLOG_WARN, "processing %.4s", unterminated);
+	WLog_Print(log, WLOG_ERROR, "plain text");
+}
+
+static BYTE* read_file(const char* path, size_t* plength)
+{
+	BYTE* data = NULL;
+	FILE* fp = winpr_fopen(path, "rb");
+	if (!fp)
+		return NULL;
+
+	if (_fseeki64(fp, 0, SEEK_END) != 0)
+		goto fail;
+	const INT64 size = _ftelli64(fp);
+	if ((size <= 0) || (_fseeki64(fp, 0, SEEK_SET) != 0))
+		goto fail;
+
+	data = (BYTE*)malloc((size_t)size);
+	if (!data)
+		goto fail;
+	if (fread(data, 1, (size_t)size, fp) != (size_t)size)
+	{
+		free(data);
+		data = NULL;
+		goto fail;
+	}
+
+	*plength = (size_t)size;
+fail:
+	(void)fclose(fp);
+	return data;
+}
+
+static BOOL check_string(wStream* s, const char* expected)
+{
+	UINT32 len = 0;
+
+	if (!Stream_CheckAndLogRequiredLength("test", s, 4))
+		return FALSE;
+	Stream_Read_UINT32(s, len);
+	if (!Stream_CheckAndLogRequiredLength("test", s, len + 1ull))
+		return FALSE;
+
+	const char* str = Stream_ConstPointer(s);
+	Stream_Seek(s, len + 1ull);
+	if (expected && ((strlen(expected) != len) || (strncmp(str, expected, len) != 0)))
+	{
+		(void)fprintf(stderr, "expected string '%s', got '%.*s'\n", expected, (int)len, str);
+		return FALSE;
+	}
+	return str[len] == '\0';
+}
+
+static BOOL check_event(wStream* s, UINT32 id, INT32 x)
+{
+	UINT32 eventId = 0;
+	UINT32 argc = 0;
+	BYTE type = 0;
+	UINT64 value = 0;
+	double ratio = 0;
+
+	if (!Stream_CheckAndLogRequiredLength("test", s, 24))
+		return FALSE;
+	Stream_Read_UINT32(s, eventId);
+	Stream_Seek(s, 16); /* level, time, thread id */
+	Stream_Read_UINT32(s, argc);
+	if ((eventId != id) || (argc != 3))
+		return FALSE;
+
+	if (!Stream_CheckAndLogRequiredLength("test", s, 9))
+		return FALSE;
+	Stream_Read_UINT8(s, type);
+	Stream_Read_UINT64(s, value);
+	if ((type != WLOG_TRACE_ARG_INTEGER) || ((INT64)value != -x))
+		return FALSE;
+
+	if (!Stream_CheckAndLogRequiredLength("test", s, 1))
+		return FALSE;
+	Stream_Read_UINT8(s, type);
+	if ((type != WLOG_TRACE_ARG_STRING) || !check_string(s, "test"))
+		return FALSE;
+
+	if (!Stream_CheckAndLogRequiredLength("test", s, 9))
+		return FALSE;
+	Stream_Read_UINT8(s, type);
+	Stream_Read_UINT64(s, value);
+	memcpy(&ratio, &value, sizeof(ratio));
+	return (type == WLOG_TRACE_ARG_DOUBLE) && (ratio == 0.5);
+}
+
+/* checks the arguments of the %.*s and %.4s events */
+static BOOL check_precision(wStream* s, UINT32 expectedArgc, const char* expected)
+{
+	UINT32 argc = 0;
+	BYTE type = 0;
+
+	if (!Stream_CheckAndLogRequiredLength("test", s, 24))
+		return FALSE;
+	Stream_Seek(s, 20); /* id, level, time, thread id */
+	Stream_Read_UINT32(s, argc);
+	if (argc != expectedArgc)
+		return FALSE;
+
+	if (argc > 1)
+	{
+		if (!Stream_CheckAndLogRequiredLength("test", s, 9))
+			return FALSE;
+		Stream_Read_UINT8(s, type);
+		Stream_Seek(s, 8);
+		if (type != WLOG_TRACE_ARG_INTEGER)
+			return FALSE;
+	}
+
+	if (!Stream_CheckAndLogRequiredLength("test", s, 1))
+		return FALSE;
+	Stream_Read_UINT8(s, type);
+	return (type == WLOG_TRACE_ARG_STRING) && check_string(s, expected);
+}
+
+static BOOL check_trace(const BYTE* data, size_t length)
+{
+	size_t formats = 0;
+	size_t events = 0;
+	size_t texts = 0;
+	UINT32 firstId = UINT32_MAX;
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, data, length);
+
+	while (Stream_GetRemainingLength(s) > 0)
+	{
+		UINT32 recordLength = 0;
+		UINT32 type = 0;
+
+		if (!Stream_CheckAndLogRequiredLength("test", s, 8))
+			return FALSE;
+
+		const size_t start = Stream_GetPosition(s);
+		Stream_Read_UINT32(s, recordLength);
+		Stream_Read_UINT32(s, type);
+		if ((recordLength < 8) || !Stream_CheckAndLogRequiredLength("test", s, recordLength - 8))
+			return FALSE;
+
+		switch (type)
+		{
+			case WLOG_TRACE_RECORD_SESSION:
+				if ((start != 0) || (recordLength != 24))
+					return FALSE;
+				break;
+			case WLOG_TRACE_RECORD_FORMAT:
+			{
+				UINT32 id = 0;
+				Stream_Read_UINT32(s, id);
+				Stream_Seek(s, 4);
+				if (!check_string(s, "com.test.trace") || !check_string(s, NULL) ||
+				    !check_string(s, "log_messages") || !check_string(s, NULL))
+					return FALSE;
+				if (formats++ == 0)
+					firstId = id;
+			}
+			break;
+			case WLOG_TRACE_RECORD_EVENT:
+				/* The repeated message must reuse the announced format */
+				if ((events < TEST_MESSAGES) && !check_event(s, firstId, (INT32)events))
+					return FALSE;
+				if ((events == TEST_MESSAGES + 1) && !check_precision(s, 2, "uri"))
+					return FALSE;
+				if ((events == TEST_MESSAGES + 2) && !check_precision(s, 1, "uri:"))
+					return FALSE;
+				events++;
+				break;
+			case WLOG_TRACE_RECORD_TEXT:
+				texts++;
+				break;
+			default:
+				return FALSE;
+		}
+
+		Stream_SetPosition(s, start + recordLength);
+	}
+
+	if ((formats != 5) || (events != TEST_MESSAGES + 4) || (texts != 0))
+	{
+		(void)fprintf(stderr,
+		              "expected 5 formats and %d events, got %" PRIuz " formats, %" PRIuz
+		              " events, %" PRIuz " texts\n",
+		              TEST_MESSAGES + 4, formats, events, texts);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+int TestWLogBinaryTrace(int argc, char* argv[])
+{
+	int result = -1;
+	char* tmp_path = NULL;
+	char* wlog_file = NULL;
+	BYTE* data = NULL;
+	size_t length = 0;
+	const char* name = "test_w_binary_trace.wlog";
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!(tmp_path = GetKnownPath(KNOWN_PATH_TEMP)))
+	{
+		(void)fprintf(stderr, "Failed to get temporary directory!\n");
+		goto out;
+	}
+
+	wlog_file = GetCombinedPath(tmp_path, name);
+	if (!wlog_file)
+		goto out;
+	winpr_DeleteFile(wlog_file);
+
+	wLog* root = WLog_GetRoot();
+	if (!WLog_SetLogAppenderType(root, WLOG_APPENDER_BINARY))
+		goto out;
+
+	wLogAppender* appender = WLog_GetLogAppender(root);
+	if (!WLog_ConfigureAppender(appender, "outputfilename", (void*)name))
+		goto out;
+	if (!WLog_ConfigureAppender(appender, "outputfilepath", tmp_path))
+		goto out;
+	if (!WLog_ConfigureAppender(appender, "format", "trace"))
+		goto out;
+
+	if (!WLog_OpenAppender(root))
+		goto out;
+
+	wLog* log = WLog_Get("com.test.trace");
+	if (!WLog_SetLogLevel(log, WLOG_INFO))
+		goto out;
+
+	log_messages(log);
+	WLog_CloseAppender(root);
+
+	data = read_file(wlog_file, &length);
+	if (!data || !check_trace(data, length))
+		goto out;
+
+	result = 0;
+out:
+	(void)WLog_SetLogAppenderType(WLog_GetRoot(), WLOG_APPENDER_CONSOLE);
+	if (wlog_file)
+		winpr_DeleteFile(wlog_file);
+	free(data);
+	free(wlog_file);
+	free(tmp_path);
+	return result;
+}
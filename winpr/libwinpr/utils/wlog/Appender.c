@@ -19,13 +19,22 @@
 
 #include <winpr/config.h>
 
+#include <errno.h>
+
+#include <winpr/crt.h>
+#include <winpr/environment.h>
+
 #include "Appender.h"
+#include "AsyncQueue.h"
 
 void WLog_Appender_Free(wLog* log, wLogAppender* appender)
 {
 	if (!appender)
 		return;
 
+	WLog_AsyncQueue_Free(appender->AsyncQueue);
+	appender->AsyncQueue = NULL;
+
 	if (appender->Layout)
 	{
 		WLog_Layout_Free(log, appender->Layout);
@@ -84,13 +93,101 @@ BOOL WLog_CloseAppender(wLog* log)
 
 	if (appender->active)
 	{
+		WLog_AsyncQueue_Flush(appender->AsyncQueue);
+
+		EnterCriticalSection(&appender->lock);
 		status = appender->Close(log, appender);
 		appender->active = FALSE;
+		LeaveCriticalSection(&appender->lock);
 	}
 
 	return status;
 }
 
+static BOOL WLog_Appender_SupportsAsync(const wLogAppender* appender)
+{
+	switch (appender->Type)
+	{
+		case WLOG_APPENDER_FILE:
+		case WLOG_APPENDER_JOURNALD:
+		case WLOG_APPENDER_UDP:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/* value is the overflow policy, optionally followed by ':' and the queue size overriding size */
+static BOOL WLog_Appender_SetAsync(wLogAppender* appender, const char* value, size_t size)
+{
+	wLogAsyncOverflowPolicy policy = WLOG_ASYNC_OVERFLOW_DROP;
+
+	if (!WLog_Appender_SupportsAsync(appender))
+		return FALSE;
+
+	const char* sep = strchr(value, ':');
+	const size_t len = sep ? (size_t)(sep - value) : strlen(value);
+
+	if (sep)
+	{
+		char* end = NULL;
+		errno = 0;
+		const unsigned long val = strtoul(sep + 1, &end, 0);
+		if ((errno != 0) || (end == sep + 1) || (*end != '\0') || (val == 0))
+			return FALSE;
+		size = val;
+	}
+
+	if ((len == 4) && (_strnicmp(value, "drop", len) == 0))
+		policy = WLOG_ASYNC_OVERFLOW_DROP;
+	else if ((len == 5) && (_strnicmp(value, "block", len) == 0))
+		policy = WLOG_ASYNC_OVERFLOW_BLOCK;
+	else
+		return FALSE;
+
+	if (appender->AsyncQueue)
+	{
+		/* The queue of a running writer can not be resized */
+		if (sep && !WLog_AsyncQueue_HasSize(appender->AsyncQueue, size))
+			return FALSE;
+
+		WLog_AsyncQueue_SetPolicy(appender->AsyncQueue, policy);
+		return TRUE;
+	}
+
+	appender->AsyncQueue = WLog_AsyncQueue_New(appender, size, policy);
+	return appender->AsyncQueue != NULL;
+}
+
+static BOOL WLog_Appender_ConfigureAsyncFromEnv(wLogAppender* appender)
+{
+	size_t size = WLOG_ASYNC_DEFAULT_QUEUE_SIZE;
+
+	if (!WLog_Appender_SupportsAsync(appender))
+		return TRUE;
+
+	char* env = GetEnvAlloc("WLOG_ASYNC");
+	if (!env)
+		return TRUE;
+
+	char* envsize = GetEnvAlloc("WLOG_ASYNC_QUEUE_SIZE");
+	if (envsize)
+	{
+		errno = 0;
+		const unsigned long val = strtoul(envsize, NULL, 0);
+		if ((errno == 0) && (val > 0))
+			size = val;
+		free(envsize);
+	}
+
+	const BOOL rc = WLog_Appender_SetAsync(appender, env, size);
+	if (!rc)
+		(void)fprintf(stderr, "%s: invalid WLOG_ASYNC=%s, expected 'drop' or 'block'[:size]\n",
+		              __func__, env);
+	free(env);
+	return rc;
+}
+
 static wLogAppender* WLog_Appender_New(wLog* log, DWORD logAppenderType)
 {
 	wLogAppender* appender = NULL;
@@ -146,6 +243,9 @@ static wLogAppender* WLog_Appender_New(wLog* log, DWORD logAppenderType)
 
 	InitializeCriticalSectionAndSpinCount(&appender->lock, 4000);
 
+	/* A broken async setting is reported but the appender stays usable synchronously */
+	(void)WLog_Appender_ConfigureAsyncFromEnv(appender);
+
 	return appender;
 }
 
@@ -170,8 +270,26 @@ BOOL WLog_ConfigureAppender(wLogAppender* appender, const char* setting, void* v
 	if (!appender || !setting || (strnlen(setting, 2) == 0))
 		return FALSE;
 
+	if (strcmp("async", setting) == 0)
+	{
+		/* Just check the value string is not empty */
+		if (!value || (strnlen(value, 2) == 0))
+			return FALSE;
+
+		return WLog_Appender_SetAsync(appender, (const char*)value,
+		                              WLOG_ASYNC_DEFAULT_QUEUE_SIZE);
+	}
+
 	if (appender->Set)
 		return appender->Set(appender, setting, value);
 	else
 		return FALSE;
 }
+
+size_t WLog_GetAppenderDroppedMessages(wLogAppender* appender)
+{
+	if (!appender)
+		return 0;
+
+	return WLog_AsyncQueue_GetDropped(appender->AsyncQueue);
+}
@@ -0,0 +1,407 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * WinPR Logger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+
+#include "AsyncQueue.h"
+
+/**
+ * Bounded multi producer / single consumer ring.
+ *
+ * Every slot carries a sequence number: a producer claims the slot at position pos once its
+ * sequence equals pos, formats the message into it and publishes it with sequence pos + 1.
+ * The writer thread consumes it and hands the slot back with sequence pos + size.
+ * Producers never take a lock, the writer batches everything available into a single
+ * appender lock / flush cycle.
+ *
+ * Producers blocked on a full queue and flushing threads wait on the manual reset event
+ * drained, which the writer sets after every batch. Waiters reset it before rechecking their
+ * condition, drainedLock keeps a reset from racing with the writer setting it.
+ */
+
+typedef struct
+{
+	LONG volatile sequence;
+	wLog* log;
+	DWORD Level;
+	size_t LineNumber;
+	LPCSTR FileName;
+	LPCSTR FunctionName;
+	char* text;
+	char prefix[WLOG_MAX_PREFIX_SIZE];
+	char inlineText[WLOG_ASYNC_INLINE_TEXT_SIZE];
+} wLogAsyncSlot;
+
+struct s_wLogAsyncQueue
+{
+	wLogAppender* appender;
+	wLogAsyncSlot* slots;
+	ULONG size;
+	ULONG mask;
+	LONG volatile enqueuePos;
+	LONG volatile dequeuePos;
+	LONG volatile dropped;
+	LONG volatile policy;
+	LONG volatile sleeping;
+	LONG volatile stop;
+	HANDLE event;
+	HANDLE drained;
+	CRITICAL_SECTION drainedLock;
+	HANDLE thread;
+	DWORD threadId;
+};
+
+static LONG WLog_AsyncQueue_Load(LONG volatile* value)
+{
+	return InterlockedCompareExchange(value, 0, 0);
+}
+
+static LONG WLog_AsyncQueue_Distance(LONG a, LONG b)
+{
+	return (LONG)((ULONG)a - (ULONG)b);
+}
+
+static void WLog_AsyncQueue_Wakeup(wLogAsyncQueue* queue)
+{
+	WINPR_ASSERT(queue);
+
+	if (InterlockedCompareExchange(&queue->sleeping, 0, 1) == 1)
+		(void)SetEvent(queue->event);
+}
+
+static void WLog_AsyncQueue_SetDrained(wLogAsyncQueue* queue, BOOL drained)
+{
+	WINPR_ASSERT(queue);
+
+	EnterCriticalSection(&queue->drainedLock);
+	if (drained)
+		(void)SetEvent(queue->drained);
+	else
+		(void)ResetEvent(queue->drained);
+	LeaveCriticalSection(&queue->drainedLock);
+}
+
+static wLogAsyncSlot* WLog_AsyncQueue_Claim(wLogAsyncQueue* queue)
+{
+	LONG pos = queue->enqueuePos;
+
+	for (;;)
+	{
+		wLogAsyncSlot* slot = &queue->slots[(ULONG)pos & queue->mask];
+		const LONG seq = WLog_AsyncQueue_Load(&slot->sequence);
+		const LONG diff = WLog_AsyncQueue_Distance(seq, pos);
+
+		if (diff == 0)
+		{
+			const LONG cur = InterlockedCompareExchange(&queue->enqueuePos,
+			                                            (LONG)((ULONG)pos + 1), pos);
+			if (cur == pos)
+				return slot;
+			pos = cur;
+		}
+		else if (diff < 0)
+			return NULL;
+		else
+			pos = queue->enqueuePos;
+	}
+}
+
+BOOL WLog_AsyncQueue_Push(wLogAsyncQueue* queue, wLog* log, const wLogMessage* message)
+{
+	wLogAsyncSlot* slot = NULL;
+
+	WINPR_ASSERT(queue);
+	WINPR_ASSERT(message);
+
+	while (!(slot = WLog_AsyncQueue_Claim(queue)))
+	{
+		/* Never wait on ourselves if an appender logs from the writer thread */
+		if ((WLog_AsyncQueue_Load(&queue->policy) == WLOG_ASYNC_OVERFLOW_DROP) ||
+		    (GetCurrentThreadId() == queue->threadId))
+		{
+			InterlockedIncrement(&queue->dropped);
+			return FALSE;
+		}
+
+		/* Recheck after the reset, the writer might have made room in between */
+		WLog_AsyncQueue_SetDrained(queue, FALSE);
+		if ((slot = WLog_AsyncQueue_Claim(queue)))
+			break;
+
+		WLog_AsyncQueue_Wakeup(queue);
+		(void)WaitForSingleObject(queue->drained, INFINITE);
+	}
+
+	wLogMessage copy = *message;
+	copy.PrefixString = slot->prefix;
+	WLog_Layout_GetMessagePrefix(log, queue->appender->Layout, &copy);
+
+	const size_t len = strnlen(message->TextString, WLOG_MAX_STRING_SIZE);
+	if (len < sizeof(slot->inlineText))
+	{
+		memcpy(slot->inlineText, message->TextString, len);
+		slot->inlineText[len] = '\0';
+		slot->text = slot->inlineText;
+	}
+	else
+	{
+		slot->text = (char*)malloc(len + 1);
+		if (slot->text)
+		{
+			memcpy(slot->text, message->TextString, len);
+			slot->text[len] = '\0';
+		}
+		else
+		{
+			/* Out of memory, queue the message truncated */
+			slot->text = slot->inlineText;
+			memcpy(slot->text, message->TextString, sizeof(slot->inlineText) - 1);
+			slot->text[sizeof(slot->inlineText) - 1] = '\0';
+		}
+	}
+
+	slot->log = log;
+	slot->Level = message->Level;
+	slot->LineNumber = message->LineNumber;
+	slot->FileName = message->FileName;
+	slot->FunctionName = message->FunctionName;
+
+	(void)InterlockedIncrement(&slot->sequence);
+	WLog_AsyncQueue_Wakeup(queue);
+	return TRUE;
+}
+
+static BOOL WLog_AsyncQueue_Peek(wLogAsyncQueue* queue, wLogAsyncSlot** pslot)
+{
+	const LONG pos = queue->dequeuePos;
+	wLogAsyncSlot* slot = &queue->slots[(ULONG)pos & queue->mask];
+	const LONG seq = WLog_AsyncQueue_Load(&slot->sequence);
+
+	if (WLog_AsyncQueue_Distance(seq, pos) != 1)
+		return FALSE;
+
+	*pslot = slot;
+	return TRUE;
+}
+
+static void WLog_AsyncQueue_Release(wLogAsyncQueue* queue, wLogAsyncSlot* slot)
+{
+	const LONG pos = queue->dequeuePos;
+
+	if (slot->text != slot->inlineText)
+		free(slot->text);
+	slot->text = NULL;
+
+	(void)InterlockedExchange(&slot->sequence, (LONG)((ULONG)pos + queue->size));
+	(void)InterlockedExchange(&queue->dequeuePos, (LONG)((ULONG)pos + 1));
+}
+
+static size_t WLog_AsyncQueue_Drain(wLogAsyncQueue* queue)
+{
+	size_t count = 0;
+	wLogAsyncSlot* slot = NULL;
+	wLogAppender* appender = queue->appender;
+
+	if (!WLog_AsyncQueue_Peek(queue, &slot))
+		return 0;
+
+	EnterCriticalSection(&appender->lock);
+	appender->recursive = TRUE;
+
+	do
+	{
+		wLogMessage message = { 0 };
+		message.Type = WLOG_MESSAGE_TEXT;
+		message.Level = slot->Level;
+		message.LineNumber = slot->LineNumber;
+		message.FileName = slot->FileName;
+		message.FunctionName = slot->FunctionName;
+		message.PrefixString = slot->prefix;
+		message.TextString = slot->text;
+
+		if (appender->active && appender->WriteMessage)
+			(void)appender->WriteMessage(slot->log, appender, &message);
+
+		WLog_AsyncQueue_Release(queue, slot);
+		count++;
+	} while ((count < queue->size) && WLog_AsyncQueue_Peek(queue, &slot));
+
+	if (appender->active && appender->Flush)
+		(void)appender->Flush(appender);
+
+	appender->recursive = FALSE;
+	LeaveCriticalSection(&appender->lock);
+	return count;
+}
+
+static DWORD WINAPI WLog_AsyncQueue_Thread(LPVOID arg)
+{
+	wLogAsyncQueue* queue = (wLogAsyncQueue*)arg;
+
+	WINPR_ASSERT(queue);
+
+	for (;;)
+	{
+		if (WLog_AsyncQueue_Drain(queue) > 0)
+		{
+			WLog_AsyncQueue_SetDrained(queue, TRUE);
+			continue;
+		}
+
+		if (WLog_AsyncQueue_Load(&queue->stop))
+			break;
+
+		(void)ResetEvent(queue->event);
+		(void)InterlockedExchange(&queue->sleeping, 1);
+
+		/* Recheck after announcing we sleep, a producer might have raced us */
+		wLogAsyncSlot* slot = NULL;
+		if (WLog_AsyncQueue_Peek(queue, &slot) || WLog_AsyncQueue_Load(&queue->stop))
+		{
+			if (InterlockedCompareExchange(&queue->sleeping, 0, 1) == 1)
+				continue;
+		}
+
+		(void)WaitForSingleObject(queue->event, INFINITE);
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+void WLog_AsyncQueue_SetPolicy(wLogAsyncQueue* queue, wLogAsyncOverflowPolicy policy)
+{
+	WINPR_ASSERT(queue);
+	(void)InterlockedExchange(&queue->policy, (LONG)policy);
+}
+
+void WLog_AsyncQueue_Flush(wLogAsyncQueue* queue)
+{
+	if (!queue)
+		return;
+
+	if (GetCurrentThreadId() == queue->threadId)
+		return;
+
+	const LONG target = WLog_AsyncQueue_Load(&queue->enqueuePos);
+
+	for (;;)
+	{
+		WLog_AsyncQueue_SetDrained(queue, FALSE);
+		if (WLog_AsyncQueue_Distance(WLog_AsyncQueue_Load(&queue->dequeuePos), target) >= 0)
+			break;
+
+		WLog_AsyncQueue_Wakeup(queue);
+		(void)WaitForSingleObject(queue->drained, INFINITE);
+	}
+}
+
+size_t WLog_AsyncQueue_GetDropped(const wLogAsyncQueue* queue)
+{
+	if (!queue)
+		return 0;
+
+	return (ULONG)queue->dropped;
+}
+
+static ULONG WLog_AsyncQueue_Capacity(size_t size)
+{
+	ULONG capacity = 2;
+
+	while (capacity < size)
+		capacity <<= 1;
+	return capacity;
+}
+
+BOOL WLog_AsyncQueue_HasSize(const wLogAsyncQueue* queue, size_t size)
+{
+	if (!queue || (size == 0) || (size > WLOG_ASYNC_MAX_QUEUE_SIZE))
+		return FALSE;
+
+	return WLog_AsyncQueue_Capacity(size) == queue->size;
+}
+
+wLogAsyncQueue* WLog_AsyncQueue_New(wLogAppender* appender, size_t size,
+                                    wLogAsyncOverflowPolicy policy)
+{
+	if (!appender || (size == 0) || (size > WLOG_ASYNC_MAX_QUEUE_SIZE))
+		return NULL;
+
+	const ULONG capacity = WLog_AsyncQueue_Capacity(size);
+
+	wLogAsyncQueue* queue = (wLogAsyncQueue*)calloc(1, sizeof(wLogAsyncQueue));
+	if (!queue)
+		return NULL;
+
+	queue->appender = appender;
+	queue->size = capacity;
+	queue->mask = capacity - 1;
+	queue->policy = (LONG)policy;
+	InitializeCriticalSection(&queue->drainedLock);
+	queue->slots = (wLogAsyncSlot*)calloc(capacity, sizeof(wLogAsyncSlot));
+	if (!queue->slots)
+		goto fail;
+
+	for (ULONG x = 0; x < capacity; x++)
+		queue->slots[x].sequence = (LONG)x;
+
+	queue->event = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (!queue->event)
+		goto fail;
+
+	queue->drained = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (!queue->drained)
+		goto fail;
+
+	queue->thread = CreateThread(NULL, 0, WLog_AsyncQueue_Thread, queue, 0, &queue->threadId);
+	if (!queue->thread)
+		goto fail;
+
+	return queue;
+fail:
+	WLog_AsyncQueue_Free(queue);
+	return NULL;
+}
+
+void WLog_AsyncQueue_Free(wLogAsyncQueue* queue)
+{
+	if (!queue)
+		return;
+
+	if (queue->thread)
+	{
+		(void)InterlockedExchange(&queue->stop, 1);
+		(void)SetEvent(queue->event);
+		(void)WaitForSingleObject(queue->thread, INFINITE);
+		(void)CloseHandle(queue->thread);
+	}
+
+	if (queue->event)
+		(void)CloseHandle(queue->event);
+	if (queue->drained)
+		(void)CloseHandle(queue->drained);
+
+	DeleteCriticalSection(&queue->drainedLock);
+	free(queue->slots);
+	free(queue);
+}
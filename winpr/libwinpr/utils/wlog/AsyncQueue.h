@@ -0,0 +1,58 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * WinPR Logger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WINPR_WLOG_ASYNC_QUEUE_PRIVATE_H
+#define WINPR_WLOG_ASYNC_QUEUE_PRIVATE_H
+
+#include "wlog.h"
+
+#define WLOG_ASYNC_DEFAULT_QUEUE_SIZE 1024
+#define WLOG_ASYNC_MAX_QUEUE_SIZE (1u << 20)
+#define WLOG_ASYNC_INLINE_TEXT_SIZE 512
+
+typedef enum
+{
+	WLOG_ASYNC_OVERFLOW_DROP,
+	WLOG_ASYNC_OVERFLOW_BLOCK
+} wLogAsyncOverflowPolicy;
+
+void WLog_AsyncQueue_Free(wLogAsyncQueue* queue);
+
+WINPR_ATTR_MALLOC(WLog_AsyncQueue_Free, 1)
+wLogAsyncQueue* WLog_AsyncQueue_New(wLogAppender* appender, size_t size,
+                                    wLogAsyncOverflowPolicy policy);
+
+void WLog_AsyncQueue_SetPolicy(wLogAsyncQueue* queue, wLogAsyncOverflowPolicy policy);
+
+/** @brief Check if a queue created for size messages would have the size of this one. */
+BOOL WLog_AsyncQueue_HasSize(const wLogAsyncQueue* queue, size_t size);
+
+/** @brief Format the message prefix and enqueue the message for the background writer.
+ *
+ *  Lock free for producers. Depending on the overflow policy a full queue either drops the
+ *  message (and counts it) or waits for the writer thread to make room.
+ *
+ *  @return \b TRUE if the message was queued, \b FALSE if it was dropped.
+ */
+BOOL WLog_AsyncQueue_Push(wLogAsyncQueue* queue, wLog* log, const wLogMessage* message);
+
+/** @brief Wait until every message queued before this call has been written. */
+void WLog_AsyncQueue_Flush(wLogAsyncQueue* queue);
+
+size_t WLog_AsyncQueue_GetDropped(const wLogAsyncQueue* queue);
+
+#endif /* WINPR_WLOG_ASYNC_QUEUE_PRIVATE_H */
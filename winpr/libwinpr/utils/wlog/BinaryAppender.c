@@ -22,11 +22,13 @@
 #include <winpr/config.h>
 
 #include "BinaryAppender.h"
+#include "BinaryTrace.h"
 #include <winpr/crt.h>
 #include <winpr/assert.h>
 #include <winpr/file.h>
 #include <winpr/path.h>
 #include <winpr/stream.h>
+#include <winpr/environment.h>
 
 typedef struct
 {
@@ -36,6 +38,7 @@ typedef struct
 	char* FilePath;
 	char* FullFileName;
 	FILE* FileDescriptor;
+	wLogBinaryTrace* Trace;
 } wLogBinaryAppender;
 
 static BOOL WLog_BinaryAppender_Open(wLog* log, wLogAppender* appender)
@@ -81,6 +84,9 @@ static BOOL WLog_BinaryAppender_Open(wLog* log, wLogAppender* appender)
 	if (!binaryAppender->FileDescriptor)
 		return FALSE;
 
+	if (binaryAppender->Trace)
+		return WLog_BinaryTrace_WriteSession(binaryAppender->Trace, binaryAppender->FileDescriptor);
+
 	return TRUE;
 }
 
@@ -167,6 +173,49 @@ static BOOL WLog_BinaryAppender_WriteMessage(wLog* log, wLogAppender* appender,
 	return ret;
 }
 
+static BOOL WLog_BinaryAppender_WriteTraceMessage(wLog* log, wLogAppender* appender,
+                                                  wLogMessage* message, va_list args)
+{
+	wLogBinaryAppender* binaryAppender = (wLogBinaryAppender*)appender;
+
+	if (!log || !appender || !message)
+		return FALSE;
+
+	if (!binaryAppender->FileDescriptor || !binaryAppender->Trace)
+		return FALSE;
+
+	return WLog_BinaryTrace_WriteMessage(binaryAppender->Trace, binaryAppender->FileDescriptor, log,
+	                                     message, args);
+}
+
+static BOOL WLog_BinaryAppender_SetFormat(wLogBinaryAppender* binaryAppender, const char* format)
+{
+	/* Text and trace records can not be mixed in one session */
+	if (binaryAppender->FileDescriptor)
+		return FALSE;
+
+	if (_stricmp(format, "trace") == 0)
+	{
+		if (!binaryAppender->Trace)
+		{
+			binaryAppender->Trace = WLog_BinaryTrace_New();
+			if (!binaryAppender->Trace)
+				return FALSE;
+		}
+		binaryAppender->WriteTraceMessage = WLog_BinaryAppender_WriteTraceMessage;
+	}
+	else if (_stricmp(format, "text") == 0)
+	{
+		WLog_BinaryTrace_Free(binaryAppender->Trace);
+		binaryAppender->Trace = NULL;
+		binaryAppender->WriteTraceMessage = NULL;
+	}
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
 static BOOL WLog_BinaryAppender_WriteDataMessage(WINPR_ATTR_UNUSED wLog* log,
                                                  WINPR_ATTR_UNUSED wLogAppender* appender,
                                                  WINPR_ATTR_UNUSED wLogMessage* message)
@@ -201,6 +250,8 @@ static BOOL WLog_BinaryAppender_Set(wLogAppender* appender, const char* setting,
 		if (!binaryAppender->FilePath)
 			return FALSE;
 	}
+	else if (!strcmp("format", setting))
+		return WLog_BinaryAppender_SetFormat(binaryAppender, (const char*)value);
 	else
 		return FALSE;
 
@@ -216,6 +267,7 @@ static void WLog_BinaryAppender_Free(wLogAppender* appender)
 		free(binaryAppender->FileName);
 		free(binaryAppender->FilePath);
 		free(binaryAppender->FullFileName);
+		WLog_BinaryTrace_Free(binaryAppender->Trace);
 		free(binaryAppender);
 	}
 }
@@ -237,5 +289,17 @@ wLogAppender* WLog_BinaryAppender_New(WINPR_ATTR_UNUSED wLog* log)
 	BinaryAppender->Free = WLog_BinaryAppender_Free;
 	BinaryAppender->Set = WLog_BinaryAppender_Set;
 
+	char* format = GetEnvAlloc("WLOG_BINARYAPPENDER_FORMAT");
+	if (format)
+	{
+		const BOOL rc = WLog_BinaryAppender_SetFormat(BinaryAppender, format);
+		free(format);
+		if (!rc)
+		{
+			WLog_BinaryAppender_Free((wLogAppender*)BinaryAppender);
+			return NULL;
+		}
+	}
+
 	return (wLogAppender*)BinaryAppender;
 }
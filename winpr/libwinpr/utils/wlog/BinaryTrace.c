@@ -0,0 +1,630 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * WinPR Logger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/stream.h>
+#include <winpr/sysinfo.h>
+#include <winpr/thread.h>
+
+#include "BinaryTrace.h"
+
+#ifndef MIN
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+typedef enum
+{
+	WLOG_TRACE_KIND_INT,
+	WLOG_TRACE_KIND_LONG,
+	WLOG_TRACE_KIND_LONGLONG,
+	WLOG_TRACE_KIND_INTMAX,
+	WLOG_TRACE_KIND_SIZE,
+	WLOG_TRACE_KIND_PTRDIFF,
+	WLOG_TRACE_KIND_DOUBLE,
+	WLOG_TRACE_KIND_LONGDOUBLE,
+	WLOG_TRACE_KIND_STRING,
+	WLOG_TRACE_KIND_POINTER
+} wLogTraceArgKind;
+
+typedef struct
+{
+	wLogTraceArgKind kind;
+	BOOL sign;
+	size_t bits; /* 8 for hh, 16 for h, 0 for no truncation */
+	int precision; /* of %s, -1 if none, WLOG_TRACE_PRECISION_ARG if given by the previous one */
+} wLogTraceArg;
+
+#define WLOG_TRACE_PRECISION_ARG (-2)
+
+typedef struct
+{
+	const char* key;
+	const char* file;
+	size_t line;
+	const wLog* log;
+	char* format;
+	UINT32 id;
+	BOOL raw;
+	size_t argCount;
+	wLogTraceArg* args;
+} wLogTraceFormat;
+
+struct s_wLogBinaryTrace
+{
+	wStream* s;
+	wLogTraceFormat* formats;
+	size_t formatCount;
+	size_t formatSize;
+	UINT32 nextId;
+};
+
+static BOOL WLog_BinaryTrace_AddArg(wLogTraceArg* args, size_t* count, wLogTraceArgKind kind,
+                                    BOOL sign, size_t bits)
+{
+	if (*count >= WLOG_TRACE_MAX_ARGS)
+		return FALSE;
+
+	args[*count].kind = kind;
+	args[*count].sign = sign;
+	args[*count].bits = bits;
+	args[*count].precision = -1;
+	(*count)++;
+	return TRUE;
+}
+
+/* Collect the argument types of a printf style format string.
+ * Returns FALSE for anything that can not be recorded raw (%n, %m, wide strings, ...) */
+static BOOL WLog_BinaryTrace_ParseFormat(const char* fmt, wLogTraceArg* args, size_t* count)
+{
+	const char* cur = fmt;
+
+	*count = 0;
+
+	while ((cur = strchr(cur, '%')) != NULL)
+	{
+		wLogTraceArgKind kind = WLOG_TRACE_KIND_INT;
+		size_t bits = 0;
+		int precision = -1;
+		BOOL isLong = FALSE;
+		BOOL isLongDouble = FALSE;
+
+		cur++;
+		if (*cur == '%')
+		{
+			cur++;
+			continue;
+		}
+
+		while ((*cur != '\0') && strchr("-+ #0'", *cur))
+			cur++;
+
+		if (*cur == '*')
+		{
+			if (!WLog_BinaryTrace_AddArg(args, count, WLOG_TRACE_KIND_INT, TRUE, 0))
+				return FALSE;
+			cur++;
+		}
+		else
+		{
+			while ((*cur >= '0') && (*cur <= '9'))
+				cur++;
+		}
+
+		if (*cur == '.')
+		{
+			cur++;
+			if (*cur == '*')
+			{
+				if (!WLog_BinaryTrace_AddArg(args, count, WLOG_TRACE_KIND_INT, TRUE, 0))
+					return FALSE;
+				precision = WLOG_TRACE_PRECISION_ARG;
+				cur++;
+			}
+			else
+			{
+				precision = 0;
+				while ((*cur >= '0') && (*cur <= '9'))
+				{
+					precision = MIN(precision * 10 + (*cur - '0'), WLOG_MAX_STRING_SIZE);
+					cur++;
+				}
+			}
+		}
+
+		switch (*cur)
+		{
+			case 'h':
+				cur++;
+				bits = 16;
+				if (*cur == 'h')
+				{
+					cur++;
+					bits = 8;
+				}
+				break;
+			case 'l':
+				cur++;
+				isLong = TRUE;
+				kind = WLOG_TRACE_KIND_LONG;
+				if (*cur == 'l')
+				{
+					cur++;
+					kind = WLOG_TRACE_KIND_LONGLONG;
+				}
+				break;
+			case 'q':
+				cur++;
+				kind = WLOG_TRACE_KIND_LONGLONG;
+				break;
+			case 'j':
+				cur++;
+				kind = WLOG_TRACE_KIND_INTMAX;
+				break;
+			case 'z':
+				cur++;
+				kind = WLOG_TRACE_KIND_SIZE;
+				break;
+			case 't':
+				cur++;
+				kind = WLOG_TRACE_KIND_PTRDIFF;
+				break;
+			case 'L':
+				cur++;
+				isLongDouble = TRUE;
+				break;
+			default:
+				break;
+		}
+
+		switch (*cur)
+		{
+			case 'd':
+			case 'i':
+				if (!WLog_BinaryTrace_AddArg(args, count, kind, TRUE, bits))
+					return FALSE;
+				break;
+			case 'u':
+			case 'o':
+			case 'x':
+			case 'X':
+				if (!WLog_BinaryTrace_AddArg(args, count, kind, FALSE, bits))
+					return FALSE;
+				break;
+			case 'c':
+				if (isLong)
+					return FALSE;
+				if (!WLog_BinaryTrace_AddArg(args, count, WLOG_TRACE_KIND_INT, TRUE, 0))
+					return FALSE;
+				break;
+			case 'e':
+			case 'E':
+			case 'f':
+			case 'F':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+				if (!WLog_BinaryTrace_AddArg(
+				        args, count,
+				        isLongDouble ? WLOG_TRACE_KIND_LONGDOUBLE : WLOG_TRACE_KIND_DOUBLE, TRUE,
+				        0))
+					return FALSE;
+				break;
+			case 's':
+				if (isLong)
+					return FALSE;
+				if (!WLog_BinaryTrace_AddArg(args, count, WLOG_TRACE_KIND_STRING, FALSE, 0))
+					return FALSE;
+				args[*count - 1].precision = precision;
+				break;
+			case 'p':
+				if (!WLog_BinaryTrace_AddArg(args, count, WLOG_TRACE_KIND_POINTER, FALSE, 0))
+					return FALSE;
+				break;
+			default:
+				return FALSE;
+		}
+
+		cur++;
+	}
+
+	return TRUE;
+}
+
+static UINT64 WLog_BinaryTrace_Truncate(UINT64 value, BOOL sign, size_t bits)
+{
+	switch (bits)
+	{
+		case 8:
+			return sign ? (UINT64)(INT64)(INT8)value : (UINT8)value;
+		case 16:
+			return sign ? (UINT64)(INT64)(INT16)value : (UINT16)value;
+		default:
+			return value;
+	}
+}
+
+/* The string does not need to be terminated within maxLength */
+static BOOL WLog_BinaryTrace_WriteStringN(wStream* s, const char* str, size_t maxLength)
+{
+	const size_t len = strnlen(str, MIN(maxLength, WLOG_MAX_STRING_SIZE));
+
+	if (!Stream_EnsureRemainingCapacity(s, 4ull + len + 1ull))
+		return FALSE;
+
+	Stream_Write_UINT32(s, (UINT32)len);
+	Stream_Write(s, str, len);
+	Stream_Write_UINT8(s, 0);
+	return TRUE;
+}
+
+static BOOL WLog_BinaryTrace_WriteString(wStream* s, const char* str)
+{
+	return WLog_BinaryTrace_WriteStringN(s, str, WLOG_MAX_STRING_SIZE);
+}
+
+static BOOL WLog_BinaryTrace_WriteArgs(wStream* s, const wLogTraceArg* args, size_t count,
+                                       va_list ap)
+{
+	if (!Stream_EnsureRemainingCapacity(s, 4ull + 9ull * count))
+		return FALSE;
+
+	Stream_Write_UINT32(s, (UINT32)count);
+
+	/* The int of a %.*s precision */
+	int previous = -1;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const wLogTraceArg* arg = &args[x];
+		UINT64 value = 0;
+		BYTE type = WLOG_TRACE_ARG_INTEGER;
+
+		switch (arg->kind)
+		{
+			case WLOG_TRACE_KIND_INT:
+				value = arg->sign ? (UINT64)(INT64)va_arg(ap, int) : va_arg(ap, unsigned int);
+				value = WLog_BinaryTrace_Truncate(value, arg->sign, arg->bits);
+				previous = (int)value;
+				break;
+			case WLOG_TRACE_KIND_LONG:
+				value = arg->sign ? (UINT64)(INT64)va_arg(ap, long) : va_arg(ap, unsigned long);
+				break;
+			case WLOG_TRACE_KIND_LONGLONG:
+				value = arg->sign ? (UINT64)va_arg(ap, long long) : va_arg(ap, unsigned long long);
+				break;
+			case WLOG_TRACE_KIND_INTMAX:
+				value = arg->sign ? (UINT64)va_arg(ap, intmax_t) : (UINT64)va_arg(ap, uintmax_t);
+				break;
+			case WLOG_TRACE_KIND_SIZE:
+				value = arg->sign ? (UINT64)(INT64)va_arg(ap, SSIZE_T) : va_arg(ap, size_t);
+				break;
+			case WLOG_TRACE_KIND_PTRDIFF:
+				value = (UINT64)(INT64)va_arg(ap, ptrdiff_t);
+				break;
+			case WLOG_TRACE_KIND_DOUBLE:
+			case WLOG_TRACE_KIND_LONGDOUBLE:
+			{
+				const double d = (arg->kind == WLOG_TRACE_KIND_DOUBLE)
+				                     ? va_arg(ap, double)
+				                     : (double)va_arg(ap, long double);
+				type = WLOG_TRACE_ARG_DOUBLE;
+				memcpy(&value, &d, sizeof(value));
+			}
+			break;
+			case WLOG_TRACE_KIND_POINTER:
+				type = WLOG_TRACE_ARG_POINTER;
+				value = (UINT64)(uintptr_t)va_arg(ap, void*);
+				break;
+			case WLOG_TRACE_KIND_STRING:
+			{
+				const char* str = va_arg(ap, const char*);
+				if (!str)
+				{
+					Stream_Write_UINT8(s, WLOG_TRACE_ARG_NULL_STRING);
+					continue;
+				}
+
+				if (!Stream_EnsureRemainingCapacity(s, 1))
+					return FALSE;
+				/* A negative precision is taken as if it was omitted */
+				int precision = arg->precision;
+				if (precision == WLOG_TRACE_PRECISION_ARG)
+					precision = previous;
+
+				Stream_Write_UINT8(s, WLOG_TRACE_ARG_STRING);
+				if (!WLog_BinaryTrace_WriteStringN(
+				        s, str, (precision < 0) ? WLOG_MAX_STRING_SIZE : (size_t)precision))
+					return FALSE;
+
+				/* Reserve room for the remaining fixed size arguments again */
+				if (!Stream_EnsureRemainingCapacity(s, 9ull * (count - x)))
+					return FALSE;
+				continue;
+			}
+			default:
+				return FALSE;
+		}
+
+		Stream_Write_UINT8(s, type);
+		Stream_Write_UINT64(s, value);
+	}
+
+	return TRUE;
+}
+
+static void WLog_BinaryTrace_BeginRecord(wStream* s, UINT32 type)
+{
+	Stream_SetPosition(s, 0);
+	Stream_Write_UINT32(s, 0); /* length, filled in by WLog_BinaryTrace_EndRecord */
+	Stream_Write_UINT32(s, type);
+}
+
+static BOOL WLog_BinaryTrace_EndRecord(wStream* s, FILE* fp)
+{
+	const size_t length = Stream_GetPosition(s);
+
+	if (length > UINT32_MAX)
+		return FALSE;
+
+	Stream_SetPosition(s, 0);
+	Stream_Write_UINT32(s, (UINT32)length);
+	Stream_SetPosition(s, length);
+
+	return fwrite(Stream_Buffer(s), length, 1, fp) == 1;
+}
+
+static size_t WLog_BinaryTrace_Hash(const wLogMessage* message, const wLog* log)
+{
+	size_t hash = (size_t)(uintptr_t)message->FormatString;
+	hash = hash * 31 + (size_t)(uintptr_t)message->FileName;
+	hash = hash * 31 + message->LineNumber;
+	hash = hash * 31 + (size_t)(uintptr_t)log;
+	return hash ^ (hash >> 17);
+}
+
+static BOOL WLog_BinaryTrace_Grow(wLogBinaryTrace* trace)
+{
+	const size_t size = trace->formatSize ? trace->formatSize * 2 : 64;
+	wLogTraceFormat* formats = (wLogTraceFormat*)calloc(size, sizeof(wLogTraceFormat));
+
+	if (!formats)
+		return FALSE;
+
+	for (size_t x = 0; x < trace->formatSize; x++)
+	{
+		const wLogTraceFormat* cur = &trace->formats[x];
+		if (!cur->key)
+			continue;
+
+		const wLogMessage message = { .FormatString = cur->key,
+			                          .FileName = cur->file,
+			                          .LineNumber = cur->line };
+		size_t index = WLog_BinaryTrace_Hash(&message, cur->log) & (size - 1);
+		while (formats[index].key)
+			index = (index + 1) & (size - 1);
+		formats[index] = *cur;
+	}
+
+	free(trace->formats);
+	trace->formats = formats;
+	trace->formatSize = size;
+	return TRUE;
+}
+
+static BOOL WLog_BinaryTrace_WriteFormat(wLogBinaryTrace* trace, FILE* fp, const wLog* log,
+                                         const wLogMessage* message, UINT32 id)
+{
+	wStream* s = trace->s;
+
+	WINPR_ASSERT(message->LineNumber <= UINT32_MAX);
+
+	WLog_BinaryTrace_BeginRecord(s, WLOG_TRACE_RECORD_FORMAT);
+	Stream_Write_UINT32(s, id);
+	Stream_Write_UINT32(s, (UINT32)message->LineNumber);
+
+	if (!WLog_BinaryTrace_WriteString(s, log->Name ? log->Name : ""))
+		return FALSE;
+	if (!WLog_BinaryTrace_WriteString(s, message->FileName ? message->FileName : ""))
+		return FALSE;
+	if (!WLog_BinaryTrace_WriteString(s, message->FunctionName ? message->FunctionName : ""))
+		return FALSE;
+	if (!WLog_BinaryTrace_WriteString(s, message->FormatString))
+		return FALSE;
+
+	return WLog_BinaryTrace_EndRecord(s, fp);
+}
+
+/* (Re)initialize a call site entry: parse the format once and announce it to the file */
+static BOOL WLog_BinaryTrace_SetFormat(wLogBinaryTrace* trace, FILE* fp, const wLog* log,
+                                       const wLogMessage* message, wLogTraceFormat* format)
+{
+	size_t count = 0;
+	wLogTraceArg args[WLOG_TRACE_MAX_ARGS] = { 0 };
+
+	char* copy = _strdup(message->FormatString);
+	if (!copy)
+		return FALSE;
+
+	free(format->format);
+	free(format->args);
+	format->format = copy;
+	format->args = NULL;
+	format->argCount = 0;
+	format->raw = WLog_BinaryTrace_ParseFormat(message->FormatString, args, &count);
+
+	if (format->raw && (count > 0))
+	{
+		format->args = (wLogTraceArg*)calloc(count, sizeof(wLogTraceArg));
+		if (!format->args)
+			return FALSE;
+		memcpy(format->args, args, count * sizeof(wLogTraceArg));
+		format->argCount = count;
+	}
+
+	format->key = message->FormatString;
+	format->file = message->FileName;
+	format->line = message->LineNumber;
+	format->log = log;
+	format->id = trace->nextId++;
+	return WLog_BinaryTrace_WriteFormat(trace, fp, log, message, format->id);
+}
+
+/* Look up a call site, announcing it if it was not seen before in this session.
+ * Format strings are usually literals, but since they do not have to be the content is
+ * compared as well. */
+static const wLogTraceFormat* WLog_BinaryTrace_GetFormat(wLogBinaryTrace* trace, FILE* fp,
+                                                         const wLog* log,
+                                                         const wLogMessage* message)
+{
+	if ((trace->formatCount + 1) * 2 > trace->formatSize)
+	{
+		if (!WLog_BinaryTrace_Grow(trace))
+			return NULL;
+	}
+
+	const size_t mask = trace->formatSize - 1;
+	size_t index = WLog_BinaryTrace_Hash(message, log) & mask;
+	wLogTraceFormat* cur = &trace->formats[index];
+
+	while (cur->key)
+	{
+		if ((cur->key == message->FormatString) && (cur->file == message->FileName) &&
+		    (cur->line == message->LineNumber) && (cur->log == log))
+		{
+			if (strcmp(cur->format, message->FormatString) == 0)
+				return cur;
+
+			/* Same buffer, different content: announce it again with a new id */
+			if (!WLog_BinaryTrace_SetFormat(trace, fp, log, message, cur))
+				return NULL;
+			return cur;
+		}
+
+		index = (index + 1) & mask;
+		cur = &trace->formats[index];
+	}
+
+	trace->formatCount++;
+	if (!WLog_BinaryTrace_SetFormat(trace, fp, log, message, cur))
+		return NULL;
+	return cur;
+}
+
+static void WLog_BinaryTrace_ClearFormats(wLogBinaryTrace* trace)
+{
+	for (size_t x = 0; x < trace->formatSize; x++)
+	{
+		free(trace->formats[x].format);
+		free(trace->formats[x].args);
+	}
+
+	free(trace->formats);
+	trace->formats = NULL;
+	trace->formatSize = 0;
+	trace->formatCount = 0;
+	trace->nextId = 0;
+}
+
+BOOL WLog_BinaryTrace_WriteSession(wLogBinaryTrace* trace, FILE* fp)
+{
+	WINPR_ASSERT(trace);
+	WINPR_ASSERT(fp);
+
+	WLog_BinaryTrace_ClearFormats(trace);
+
+	wStream* s = trace->s;
+	WLog_BinaryTrace_BeginRecord(s, WLOG_TRACE_RECORD_SESSION);
+	Stream_Write_UINT32(s, WLOG_TRACE_VERSION);
+	Stream_Write_UINT64(s, winpr_GetUnixTimeNS());
+	Stream_Write_UINT32(s, GetCurrentProcessId());
+	return WLog_BinaryTrace_EndRecord(s, fp);
+}
+
+BOOL WLog_BinaryTrace_WriteMessage(wLogBinaryTrace* trace, FILE* fp, wLog* log,
+                                   const wLogMessage* message, va_list args)
+{
+	WINPR_ASSERT(trace);
+	WINPR_ASSERT(fp);
+	WINPR_ASSERT(message);
+	WINPR_ASSERT(message->FormatString);
+
+	const wLogTraceFormat* format = WLog_BinaryTrace_GetFormat(trace, fp, log, message);
+	if (!format)
+		return FALSE;
+
+	wStream* s = trace->s;
+	WLog_BinaryTrace_BeginRecord(s,
+	                             format->raw ? WLOG_TRACE_RECORD_EVENT : WLOG_TRACE_RECORD_TEXT);
+	Stream_Write_UINT32(s, format->id);
+	Stream_Write_UINT32(s, message->Level);
+	Stream_Write_UINT64(s, winpr_GetUnixTimeNS());
+	Stream_Write_UINT32(s, GetCurrentThreadId());
+
+	if (format->raw)
+	{
+		if (!WLog_BinaryTrace_WriteArgs(s, format->args, format->argCount, args))
+			return FALSE;
+	}
+	else
+	{
+		char formatted[WLOG_MAX_STRING_SIZE] = { 0 };
+
+		WINPR_PRAGMA_DIAG_PUSH
+		WINPR_PRAGMA_DIAG_IGNORED_FORMAT_NONLITERAL
+		if (vsnprintf(formatted, sizeof(formatted) - 1, message->FormatString, args) < 0)
+			return FALSE;
+		WINPR_PRAGMA_DIAG_POP
+
+		if (!WLog_BinaryTrace_WriteString(s, formatted))
+			return FALSE;
+	}
+
+	return WLog_BinaryTrace_EndRecord(s, fp);
+}
+
+wLogBinaryTrace* WLog_BinaryTrace_New(void)
+{
+	wLogBinaryTrace* trace = (wLogBinaryTrace*)calloc(1, sizeof(wLogBinaryTrace));
+	if (!trace)
+		return NULL;
+
+	trace->s = Stream_New(NULL, 1024);
+	if (!trace->s)
+	{
+		WLog_BinaryTrace_Free(trace);
+		return NULL;
+	}
+
+	return trace;
+}
+
+void WLog_BinaryTrace_Free(wLogBinaryTrace* trace)
+{
+	if (!trace)
+		return;
+
+	WLog_BinaryTrace_ClearFormats(trace);
+	Stream_Free(trace->s, TRUE);
+	free(trace);
+}
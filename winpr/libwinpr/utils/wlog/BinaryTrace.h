@@ -0,0 +1,81 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * WinPR Logger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WINPR_WLOG_BINARY_TRACE_PRIVATE_H
+#define WINPR_WLOG_BINARY_TRACE_PRIVATE_H
+
+#include <stdio.h>
+
+#include "wlog.h"
+
+/**
+ * Binary trace file layout, all values little endian.
+ *
+ * The file is a sequence of records, each starting with
+ *   UINT32 length (of the whole record), UINT32 type
+ *
+ * WLOG_TRACE_RECORD_SESSION: UINT32 version, UINT64 start time (unix ns), UINT32 process id
+ *   Starts a new session, format ids of previous sessions are no longer valid.
+ * WLOG_TRACE_RECORD_FORMAT: UINT32 id, UINT32 line, string module, string file,
+ *   string function, string format
+ * WLOG_TRACE_RECORD_EVENT: UINT32 id, UINT32 level, UINT64 time (unix ns), UINT32 thread id,
+ *   UINT32 argument count, arguments
+ * WLOG_TRACE_RECORD_TEXT: UINT32 id, UINT32 level, UINT64 time (unix ns), UINT32 thread id,
+ *   string text (formatted at the call site, used for formats not supported as event)
+ *
+ * Strings are stored as UINT32 length followed by the characters and a '\0'.
+ * Arguments are stored as UINT8 type followed by the value:
+ *   WLOG_TRACE_ARG_INTEGER: UINT64 (signed values are sign extended)
+ *   WLOG_TRACE_ARG_DOUBLE: UINT64 holding the IEEE 754 representation
+ *   WLOG_TRACE_ARG_POINTER: UINT64
+ *   WLOG_TRACE_ARG_STRING: string
+ *   WLOG_TRACE_ARG_NULL_STRING: no value
+ */
+
+#define WLOG_TRACE_VERSION 1
+#define WLOG_TRACE_MAX_ARGS 32
+
+#define WLOG_TRACE_RECORD_SESSION 0x57540000
+#define WLOG_TRACE_RECORD_FORMAT 0x57540001
+#define WLOG_TRACE_RECORD_EVENT 0x57540002
+#define WLOG_TRACE_RECORD_TEXT 0x57540003
+
+#define WLOG_TRACE_ARG_INTEGER 1
+#define WLOG_TRACE_ARG_DOUBLE 2
+#define WLOG_TRACE_ARG_POINTER 3
+#define WLOG_TRACE_ARG_STRING 4
+#define WLOG_TRACE_ARG_NULL_STRING 5
+
+typedef struct s_wLogBinaryTrace wLogBinaryTrace;
+
+void WLog_BinaryTrace_Free(wLogBinaryTrace* trace);
+
+WINPR_ATTR_MALLOC(WLog_BinaryTrace_Free, 1)
+wLogBinaryTrace* WLog_BinaryTrace_New(void);
+
+/** @brief Start a new trace session in \b fp, forgets all previously announced formats. */
+BOOL WLog_BinaryTrace_WriteSession(wLogBinaryTrace* trace, FILE* fp);
+
+/** @brief Write a text message to \b fp without formatting it.
+ *
+ *  The format string is announced once per session, afterwards only its id, timestamp, thread
+ *  id and the raw arguments taken from \b args are written.
+ */
+BOOL WLog_BinaryTrace_WriteMessage(wLogBinaryTrace* trace, FILE* fp, wLog* log,
+                                   const wLogMessage* message, va_list args);
+
+#endif /* WINPR_WLOG_BINARY_TRACE_PRIVATE_H */
@@ -141,13 +141,30 @@ static BOOL WLog_FileAppender_WriteMessage(wLog* log, wLogAppender* appender, wL
 	if (!fp)
 		return FALSE;
 
-	message->PrefixString = prefix;
-	WLog_Layout_GetMessagePrefix(log, appender->Layout, message);
+	/* Messages from the async queue arrive with the prefix already formatted */
+	if (!message->PrefixString)
+	{
+		message->PrefixString = prefix;
+		WLog_Layout_GetMessagePrefix(log, appender->Layout, message);
+	}
 	(void)fprintf(fp, "%s%s\n", message->PrefixString, message->TextString);
-	(void)fflush(fp); /* slow! */
+
+	/* The async writer flushes once per batch */
+	if (!appender->AsyncQueue)
+		(void)fflush(fp); /* slow! */
 	return TRUE;
 }
 
+static BOOL WLog_FileAppender_Flush(wLogAppender* appender)
+{
+	wLogFileAppender* fileAppender = (wLogFileAppender*)appender;
+
+	if (!fileAppender || !fileAppender->FileDescriptor)
+		return FALSE;
+
+	return fflush(fileAppender->FileDescriptor) == 0;
+}
+
 static int g_DataId = 0;
 
 static BOOL WLog_FileAppender_WriteDataMessage(wLog* log, wLogAppender* appender,
@@ -233,6 +250,7 @@ wLogAppender* WLog_FileAppender_New(WINPR_ATTR_UNUSED wLog* log)
 	FileAppender->WriteMessage = WLog_FileAppender_WriteMessage;
 	FileAppender->WriteDataMessage = WLog_FileAppender_WriteDataMessage;
 	FileAppender->WriteImageMessage = WLog_FileAppender_WriteImageMessage;
+	FileAppender->Flush = WLog_FileAppender_Flush;
 	FileAppender->Free = WLog_FileAppender_Free;
 	FileAppender->Set = WLog_FileAppender_Set;
 	name = "WLOG_FILEAPPENDER_OUTPUT_FILE_PATH";
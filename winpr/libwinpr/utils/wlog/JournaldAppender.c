@@ -108,8 +108,12 @@ static BOOL WLog_JournaldAppender_WriteMessage(wLog* log, wLogAppender* appender
 			return FALSE;
 	}
 
-	message->PrefixString = prefix;
-	WLog_Layout_GetMessagePrefix(log, appender->Layout, message);
+	/* Messages from the async queue arrive with the prefix already formatted */
+	if (!message->PrefixString)
+	{
+		message->PrefixString = prefix;
+		WLog_Layout_GetMessagePrefix(log, appender->Layout, message);
+	}
 
 	if (message->Level != WLOG_OFF)
 	{
@@ -96,8 +96,12 @@ static BOOL WLog_UdpAppender_WriteMessage(wLog* log, wLogAppender* appender, wLo
 		return FALSE;
 
 	udpAppender = (wLogUdpAppender*)appender;
-	message->PrefixString = prefix;
-	WLog_Layout_GetMessagePrefix(log, appender->Layout, message);
+	/* Messages from the async queue arrive with the prefix already formatted */
+	if (!message->PrefixString)
+	{
+		message->PrefixString = prefix;
+		WLog_Layout_GetMessagePrefix(log, appender->Layout, message);
+	}
 	(void)_sendto(udpAppender->sock, message->PrefixString,
 	              (int)strnlen(message->PrefixString, INT_MAX), 0, &udpAppender->targetAddr,
 	              udpAppender->targetAddrLen);
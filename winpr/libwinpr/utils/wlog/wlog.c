@@ -37,6 +37,7 @@
 #endif
 
 #include "wlog.h"
+#include "AsyncQueue.h"
 
 typedef struct
 {
@@ -84,6 +85,10 @@ static void WLog_Uninit_(void)
 	if (!root)
 		return;
 
+	/* Queued messages may still reference child loggers, write them out first */
+	if (root->Appender)
+		WLog_AsyncQueue_Flush(root->Appender->AsyncQueue);
+
 	for (DWORD index = 0; index < root->ChildrenCount; index++)
 	{
 		child = root->Children[index];
@@ -238,6 +243,9 @@ static BOOL WLog_Write(wLog* log, wLogMessage* message)
 		if (!WLog_OpenAppender(log))
 			return FALSE;
 
+	if (appender->AsyncQueue)
+		return WLog_AsyncQueue_Push(appender->AsyncQueue, log, message);
+
 	EnterCriticalSection(&appender->lock);
 
 	if (appender->WriteMessage)
@@ -349,6 +357,47 @@ static BOOL WLog_WritePacket(wLog* log, wLogMessage* message)
 	return status;
 }
 
+static BOOL WLog_HasTraceAppender(wLog* log)
+{
+	const wLogAppender* appender = WLog_GetLogAppender(log);
+
+	if (!appender)
+		return FALSE;
+
+	return appender->WriteTraceMessage != NULL;
+}
+
+static BOOL WLog_WriteTrace(wLog* log, wLogMessage* message, va_list args)
+{
+	BOOL status = 0;
+	wLogAppender* appender = NULL;
+	appender = WLog_GetLogAppender(log);
+
+	if (!appender)
+		return FALSE;
+
+	if (!appender->active)
+		if (!WLog_OpenAppender(log))
+			return FALSE;
+
+	if (!appender->WriteTraceMessage)
+		return FALSE;
+
+	EnterCriticalSection(&appender->lock);
+
+	if (appender->recursive)
+		status = log_recursion(message->FileName, message->FunctionName, message->LineNumber);
+	else
+	{
+		appender->recursive = TRUE;
+		status = appender->WriteTraceMessage(log, appender, message, args);
+		appender->recursive = FALSE;
+	}
+
+	LeaveCriticalSection(&appender->lock);
+	return status;
+}
+
 BOOL WLog_PrintMessageVA(wLog* log, DWORD type, DWORD level, size_t line, const char* file,
                          const char* function, va_list args)
 {
@@ -365,7 +414,10 @@ BOOL WLog_PrintMessageVA(wLog* log, DWORD type, DWORD level, size_t line, const
 		case WLOG_MESSAGE_TEXT:
 			message.FormatString = va_arg(args, const char*);
 
-			if (!strchr(message.FormatString, '%'))
+			/* Binary trace mode records the raw arguments, no need to format anything here */
+			if (WLog_HasTraceAppender(log))
+				status = WLog_WriteTrace(log, &message, args);
+			else if (!strchr(message.FormatString, '%'))
 			{
 				message.TextString = message.FormatString;
 				status = WLog_Write(log, &message);
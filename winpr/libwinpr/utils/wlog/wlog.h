@@ -35,9 +35,14 @@ typedef BOOL (*WLOG_APPENDER_WRITE_IMAGE_MESSAGE_FN)(wLog* log, wLogAppender* ap
                                                      wLogMessage* message);
 typedef BOOL (*WLOG_APPENDER_WRITE_PACKET_MESSAGE_FN)(wLog* log, wLogAppender* appender,
                                                       wLogMessage* message);
+typedef BOOL (*WLOG_APPENDER_WRITE_TRACE_MESSAGE_FN)(wLog* log, wLogAppender* appender,
+                                                     wLogMessage* message, va_list args);
+typedef BOOL (*WLOG_APPENDER_FLUSH_FN)(wLogAppender* appender);
 typedef BOOL (*WLOG_APPENDER_SET)(wLogAppender* appender, const char* setting, void* value);
 typedef void (*WLOG_APPENDER_FREE)(wLogAppender* appender);
 
+typedef struct s_wLogAsyncQueue wLogAsyncQueue;
+
 #define WLOG_APPENDER_COMMON()                                \
 	DWORD Type;                                               \
 	BOOL active;                                              \
@@ -48,12 +53,15 @@ typedef void (*WLOG_APPENDER_FREE)(wLogAppender* appender);
 	void* DataMessageContext;                                 \
 	void* ImageMessageContext;                                \
 	void* PacketMessageContext;                               \
+	wLogAsyncQueue* AsyncQueue;                               \
 	WLOG_APPENDER_OPEN_FN Open;                               \
 	WLOG_APPENDER_CLOSE_FN Close;                             \
 	WLOG_APPENDER_WRITE_MESSAGE_FN WriteMessage;              \
 	WLOG_APPENDER_WRITE_DATA_MESSAGE_FN WriteDataMessage;     \
 	WLOG_APPENDER_WRITE_IMAGE_MESSAGE_FN WriteImageMessage;   \
 	WLOG_APPENDER_WRITE_PACKET_MESSAGE_FN WritePacketMessage; \
+	WLOG_APPENDER_WRITE_TRACE_MESSAGE_FN WriteTraceMessage;   \
+	WLOG_APPENDER_FLUSH_FN Flush;                             \
 	WLOG_APPENDER_FREE Free;                                  \
 	WLOG_APPENDER_SET Set
 
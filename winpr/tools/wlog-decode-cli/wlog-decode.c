@@ -0,0 +1,556 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * WLog binary trace decoder
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/stream.h>
+#include <winpr/wlog.h>
+
+/* Record layout written by the WLog binary appender in trace mode,
+ * see winpr/libwinpr/utils/wlog/BinaryTrace.h */
+#define WLOG_TRACE_VERSION 1
+
+#define WLOG_TRACE_RECORD_SESSION 0x57540000
+#define WLOG_TRACE_RECORD_FORMAT 0x57540001
+#define WLOG_TRACE_RECORD_EVENT 0x57540002
+#define WLOG_TRACE_RECORD_TEXT 0x57540003
+
+#define WLOG_TRACE_ARG_INTEGER 1
+#define WLOG_TRACE_ARG_DOUBLE 2
+#define WLOG_TRACE_ARG_POINTER 3
+#define WLOG_TRACE_ARG_STRING 4
+#define WLOG_TRACE_ARG_NULL_STRING 5
+
+static const char* levels[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL", "OFF" };
+
+typedef struct
+{
+	BOOL valid;
+	UINT32 line;
+	char* module;
+	char* file;
+	char* function;
+	char* format;
+} trace_format;
+
+typedef struct
+{
+	UINT8 type;
+	UINT64 value;
+	const char* str;
+} trace_arg;
+
+typedef struct
+{
+	trace_format* formats;
+	size_t count;
+	UINT32 pid;
+	FILE* out;
+} trace_decoder;
+
+static int usage_and_exit(void)
+{
+	printf("winpr-wlog-decode: decode WLog binary trace files\n");
+	printf("Usage: winpr-wlog-decode [-o <output file>] <trace file>\n");
+	return 1;
+}
+
+static void clear_formats(trace_decoder* dec)
+{
+	for (size_t x = 0; x < dec->count; x++)
+	{
+		trace_format* fmt = &dec->formats[x];
+		free(fmt->module);
+		free(fmt->file);
+		free(fmt->function);
+		free(fmt->format);
+	}
+
+	free(dec->formats);
+	dec->formats = NULL;
+	dec->count = 0;
+}
+
+static BOOL read_string(wStream* s, const char** str)
+{
+	UINT32 len = 0;
+
+	if (Stream_GetRemainingLength(s) < 4)
+		return FALSE;
+	Stream_Read_UINT32(s, len);
+
+	if (Stream_GetRemainingLength(s) < len + 1ull)
+		return FALSE;
+
+	*str = Stream_ConstPointer(s);
+	Stream_Seek(s, len);
+
+	/* The terminating '\0' is part of the record */
+	const char* end = Stream_ConstPointer(s);
+	Stream_Seek(s, 1);
+	return *end == '\0';
+}
+
+static BOOL read_format(trace_decoder* dec, wStream* s)
+{
+	UINT32 id = 0;
+	UINT32 line = 0;
+	const char* module = NULL;
+	const char* file = NULL;
+	const char* function = NULL;
+	const char* format = NULL;
+
+	if (Stream_GetRemainingLength(s) < 8)
+		return FALSE;
+
+	Stream_Read_UINT32(s, id);
+	Stream_Read_UINT32(s, line);
+	if (!read_string(s, &module) || !read_string(s, &file) || !read_string(s, &function) ||
+	    !read_string(s, &format))
+		return FALSE;
+
+	if (id >= dec->count)
+	{
+		trace_format* tmp =
+		    (trace_format*)realloc(dec->formats, (id + 1ull) * sizeof(trace_format));
+		if (!tmp)
+			return FALSE;
+		memset(&tmp[dec->count], 0, (id + 1ull - dec->count) * sizeof(trace_format));
+		dec->formats = tmp;
+		dec->count = id + 1ull;
+	}
+
+	trace_format* fmt = &dec->formats[id];
+	free(fmt->module);
+	free(fmt->file);
+	free(fmt->function);
+	free(fmt->format);
+
+	fmt->line = line;
+	fmt->module = _strdup(module);
+	fmt->file = _strdup(file);
+	fmt->function = _strdup(function);
+	fmt->format = _strdup(format);
+	fmt->valid = fmt->module && fmt->file && fmt->function && fmt->format;
+	return fmt->valid;
+}
+
+static BOOL read_args(wStream* s, trace_arg* args, size_t maxargs, size_t* pcount)
+{
+	UINT32 count = 0;
+
+	if (Stream_GetRemainingLength(s) < 4)
+		return FALSE;
+	Stream_Read_UINT32(s, count);
+	if (count > maxargs)
+		return FALSE;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		trace_arg* arg = &args[x];
+
+		if (Stream_GetRemainingLength(s) < 1)
+			return FALSE;
+		Stream_Read_UINT8(s, arg->type);
+
+		switch (arg->type)
+		{
+			case WLOG_TRACE_ARG_INTEGER:
+			case WLOG_TRACE_ARG_DOUBLE:
+			case WLOG_TRACE_ARG_POINTER:
+				if (Stream_GetRemainingLength(s) < 8)
+					return FALSE;
+				Stream_Read_UINT64(s, arg->value);
+				break;
+			case WLOG_TRACE_ARG_STRING:
+				if (!read_string(s, &arg->str))
+					return FALSE;
+				break;
+			case WLOG_TRACE_ARG_NULL_STRING:
+				arg->str = NULL;
+				break;
+			default:
+				return FALSE;
+		}
+	}
+
+	*pcount = count;
+	return TRUE;
+}
+
+static const trace_arg* next_arg(const trace_arg* args, size_t count, size_t* index)
+{
+	if (*index >= count)
+		return NULL;
+	return &args[(*index)++];
+}
+
+/* Copy a field width or precision, a '*' is replaced by the recorded value */
+static size_t append_width(const char** pcur, char* spec, size_t size, size_t len,
+                           const trace_arg* args, size_t count, size_t* index)
+{
+	const char* cur = *pcur;
+
+	if (*cur == '*')
+	{
+		const trace_arg* arg = next_arg(args, count, index);
+		const INT64 val = arg ? (INT64)arg->value : 0;
+		const int rc = _snprintf(&spec[len], size - len - 4, "%" PRId64, val);
+		if (rc > 0)
+			len += (size_t)rc;
+		cur++;
+	}
+	else
+	{
+		while ((*cur >= '0') && (*cur <= '9') && (len < size - 8))
+			spec[len++] = *cur++;
+	}
+
+	*pcur = cur;
+	return len;
+}
+
+/* Replay a printf style format with the recorded arguments. Length modifiers are replaced
+ * since all integers were widened to 64 bit and long doubles were stored as double */
+static void print_formatted(FILE* out, const char* format, const trace_arg* args, size_t count)
+{
+	size_t index = 0;
+	const char* cur = format;
+
+	while (*cur != '\0')
+	{
+		char spec[64] = { 0 };
+		size_t len = 0;
+
+		if (*cur != '%')
+		{
+			(void)fputc(*cur++, out);
+			continue;
+		}
+
+		if (cur[1] == '%')
+		{
+			(void)fputc('%', out);
+			cur += 2;
+			continue;
+		}
+
+		spec[len++] = *cur++;
+		while ((*cur != '\0') && strchr("-+ #0'", *cur) && (len < 16))
+			spec[len++] = *cur++;
+
+		len = append_width(&cur, spec, sizeof(spec), len, args, count, &index);
+		if (*cur == '.')
+		{
+			spec[len++] = *cur++;
+			len = append_width(&cur, spec, sizeof(spec), len, args, count, &index);
+		}
+
+		while ((*cur != '\0') && strchr("hlqjztL", *cur))
+			cur++;
+
+		const char conv = *cur;
+		if (conv == '\0')
+			break;
+		cur++;
+
+		const trace_arg* arg = next_arg(args, count, &index);
+		if (!arg)
+		{
+			(void)fprintf(out, "<missing>");
+			continue;
+		}
+
+		WINPR_PRAGMA_DIAG_PUSH
+		WINPR_PRAGMA_DIAG_IGNORED_FORMAT_NONLITERAL
+		switch (conv)
+		{
+			case 'd':
+			case 'i':
+			case 'u':
+			case 'o':
+			case 'x':
+			case 'X':
+				if (arg->type != WLOG_TRACE_ARG_INTEGER)
+					goto mismatch;
+				spec[len++] = 'l';
+				spec[len++] = 'l';
+				spec[len++] = conv;
+				if ((conv == 'd') || (conv == 'i'))
+					(void)fprintf(out, spec, (long long)arg->value);
+				else
+					(void)fprintf(out, spec, (unsigned long long)arg->value);
+				break;
+			case 'c':
+				if (arg->type != WLOG_TRACE_ARG_INTEGER)
+					goto mismatch;
+				spec[len++] = conv;
+				(void)fprintf(out, spec, (int)arg->value);
+				break;
+			case 'e':
+			case 'E':
+			case 'f':
+			case 'F':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+			{
+				double d = 0;
+				if (arg->type != WLOG_TRACE_ARG_DOUBLE)
+					goto mismatch;
+				memcpy(&d, &arg->value, sizeof(d));
+				spec[len++] = conv;
+				(void)fprintf(out, spec, d);
+			}
+			break;
+			case 's':
+				if (arg->type == WLOG_TRACE_ARG_NULL_STRING)
+				{
+					(void)fprintf(out, "(null)");
+					break;
+				}
+				if (arg->type != WLOG_TRACE_ARG_STRING)
+					goto mismatch;
+				spec[len++] = conv;
+				(void)fprintf(out, spec, arg->str);
+				break;
+			case 'p':
+				if (arg->type != WLOG_TRACE_ARG_POINTER)
+					goto mismatch;
+				(void)fprintf(out, "0x%" PRIx64, arg->value);
+				break;
+			default:
+			mismatch:
+				(void)fprintf(out, "<invalid %c>", conv);
+				break;
+		}
+		WINPR_PRAGMA_DIAG_POP
+	}
+}
+
+static void print_prefix(trace_decoder* dec, const trace_format* fmt, UINT32 level, UINT64 ts,
+                         UINT32 tid)
+{
+	const time_t sec = (time_t)(ts / 1000000000ull);
+	const UINT64 ms = (ts / 1000000ull) % 1000ull;
+	const struct tm* t = localtime(&sec);
+	const char* lvl = (level < ARRAYSIZE(levels)) ? levels[level] : "UNKNOWN";
+
+	if (t)
+		(void)fprintf(dec->out, "[%02d:%02d:%02d:%03" PRIu64 "] ", t->tm_hour, t->tm_min,
+		              t->tm_sec, ms);
+	(void)fprintf(dec->out, "[%" PRIu32 ":%08" PRIx32 "] [%s][%s] - [%s]: ", dec->pid, tid, lvl,
+	              fmt->module, fmt->function);
+}
+
+static BOOL read_message(trace_decoder* dec, wStream* s, BOOL text)
+{
+	UINT32 id = 0;
+	UINT32 level = 0;
+	UINT64 ts = 0;
+	UINT32 tid = 0;
+	trace_arg args[32] = { 0 };
+	size_t count = 0;
+	const char* str = NULL;
+
+	if (Stream_GetRemainingLength(s) < 20)
+		return FALSE;
+
+	Stream_Read_UINT32(s, id);
+	Stream_Read_UINT32(s, level);
+	Stream_Read_UINT64(s, ts);
+	Stream_Read_UINT32(s, tid);
+
+	if ((id >= dec->count) || !dec->formats[id].valid)
+	{
+		(void)fprintf(stderr, "unknown format id %" PRIu32 "\n", id);
+		return FALSE;
+	}
+
+	const trace_format* fmt = &dec->formats[id];
+	if (text)
+	{
+		if (!read_string(s, &str))
+			return FALSE;
+	}
+	else if (!read_args(s, args, ARRAYSIZE(args), &count))
+		return FALSE;
+
+	print_prefix(dec, fmt, level, ts, tid);
+	if (text)
+		(void)fputs(str, dec->out);
+	else
+		print_formatted(dec->out, fmt->format, args, count);
+	(void)fputc('\n', dec->out);
+	return TRUE;
+}
+
+static BOOL read_session(trace_decoder* dec, wStream* s)
+{
+	UINT32 version = 0;
+
+	if (Stream_GetRemainingLength(s) < 16)
+		return FALSE;
+
+	Stream_Read_UINT32(s, version);
+	if (version != WLOG_TRACE_VERSION)
+	{
+		(void)fprintf(stderr, "unsupported trace version %" PRIu32 "\n", version);
+		return FALSE;
+	}
+
+	Stream_Seek_UINT64(s); /* start time */
+	Stream_Read_UINT32(s, dec->pid);
+	clear_formats(dec);
+	return TRUE;
+}
+
+static BOOL decode(trace_decoder* dec, FILE* fp)
+{
+	BOOL rc = FALSE;
+	BOOL haveSession = FALSE;
+	BYTE* buffer = NULL;
+
+	for (;;)
+	{
+		BYTE header[8] = { 0 };
+		const size_t read = fread(header, 1, sizeof(header), fp);
+		if (read == 0)
+			break;
+		if (read != sizeof(header))
+			goto fail;
+
+		wStream sbuffer = { 0 };
+		wStream* s = Stream_StaticConstInit(&sbuffer, header, sizeof(header));
+		UINT32 length = 0;
+		UINT32 type = 0;
+		Stream_Read_UINT32(s, length);
+		Stream_Read_UINT32(s, type);
+		if ((length < sizeof(header)) || (length > 16ull * 1024ull * 1024ull))
+			goto fail;
+
+		BYTE* tmp = (BYTE*)realloc(buffer, length);
+		if (!tmp)
+			goto fail;
+		buffer = tmp;
+
+		const size_t remaining = length - sizeof(header);
+		if (fread(buffer, 1, remaining, fp) != remaining)
+			goto fail;
+
+		s = Stream_StaticConstInit(&sbuffer, buffer, remaining);
+		if (!haveSession && (type != WLOG_TRACE_RECORD_SESSION))
+		{
+			(void)fprintf(stderr, "not a WLog trace file\n");
+			goto fail;
+		}
+
+		switch (type)
+		{
+			case WLOG_TRACE_RECORD_SESSION:
+				haveSession = read_session(dec, s);
+				if (!haveSession)
+					goto fail;
+				break;
+			case WLOG_TRACE_RECORD_FORMAT:
+				if (!read_format(dec, s))
+					goto fail;
+				break;
+			case WLOG_TRACE_RECORD_EVENT:
+			case WLOG_TRACE_RECORD_TEXT:
+				if (!read_message(dec, s, type == WLOG_TRACE_RECORD_TEXT))
+					goto fail;
+				break;
+			default:
+				/* Skip unknown records, they carry their length */
+				break;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		(void)fprintf(stderr, "corrupt trace record\n");
+	free(buffer);
+	return rc;
+}
+
+int main(int argc, char* argv[])
+{
+	int rc = 1;
+	const char* input = NULL;
+	const char* output = NULL;
+	FILE* fp = NULL;
+	trace_decoder dec = { 0 };
+
+	for (int index = 1; index < argc; index++)
+	{
+		if (strcmp("-o", argv[index]) == 0)
+		{
+			index++;
+			if (index == argc)
+			{
+				printf("missing output file\n\n");
+				return usage_and_exit();
+			}
+			output = argv[index];
+		}
+		else if ((strcmp("-h", argv[index]) == 0) || (strcmp("--help", argv[index]) == 0))
+			return usage_and_exit();
+		else if (!input)
+			input = argv[index];
+		else
+			return usage_and_exit();
+	}
+
+	if (!input)
+		return usage_and_exit();
+
+	fp = winpr_fopen(input, "rb");
+	if (!fp)
+	{
+		(void)fprintf(stderr, "failed to open %s\n", input);
+		return 1;
+	}
+
+	dec.out = stdout;
+	if (output)
+	{
+		dec.out = winpr_fopen(output, "w");
+		if (!dec.out)
+		{
+			(void)fprintf(stderr, "failed to open %s\n", output);
+			goto fail;
+		}
+	}
+
+	if (decode(&dec, fp))
+		rc = 0;
+
+fail:
+	clear_formats(&dec);
+	if (dec.out && (dec.out != stdout))
+		(void)fclose(dec.out);
+	(void)fclose(fp);
+	return rc;
+}